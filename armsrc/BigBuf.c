@@ -24,6 +24,10 @@ Pointer to highest available memory: BigBuf_hi
 	high BIGBUF_SIZE
 	reserved = BigBuf_malloc()  subtracts amount from BigBuf_hi,
 	low  0x00
+
+Each reservation is additionally tracked in the regions[] table so that a
+single allocation can be handed back with BigBuf_release() and reused by a
+later BigBuf_malloc() of fitting size, without resetting the whole buffer.
 */
 
 // declare it as uint32_t to achieve alignment to 4 Byte boundary
@@ -32,13 +36,40 @@ static uint32_t BigBuf[BIGBUF_SIZE/sizeof(uint32_t)];
 // High memory mark
 static uint16_t BigBuf_hi = BIGBUF_SIZE;
 
+// region bookkeeping for BigBuf_malloc()/BigBuf_release()
+#define BIGBUF_MAX_REGIONS	16
+
+typedef struct {
+	uint16_t start;		// offset into BigBuf. Valid only if size != 0
+	uint16_t size;
+	bool used;
+} bigbuf_region_t;
+
+static bigbuf_region_t regions[BIGBUF_MAX_REGIONS];
+
+// lowest value BigBuf_hi ever reached, i.e. the peak allocation
+static uint16_t BigBuf_lowater = BIGBUF_SIZE;
+
 // pointer to the emulator memory.
 static uint8_t *emulator_memory = NULL;
 
+// copy-on-write persona storage for the emulator memory (see emlPersonaStore)
+static uint8_t *em_base = NULL;		// base image shared by all personas
+static uint8_t *em_pool = NULL;		// pool of copied delta pages
+static uint8_t em_pool_used[EM_POOL_PAGES];
+static uint8_t em_ptable[EM_PERSONA_SLOTS][EM_PAGES];	// pool index or EM_PAGE_SHARED
+static bool em_slot_used[EM_PERSONA_SLOTS];
+
 // trace related variables
 static uint32_t traceLen = 0;
 static bool tracing = true;
 
+// streaming trace: completed entries are pushed to the client while the
+// operation keeps running, instead of stopping when the buffer is full
+static bool trace_streaming = false;
+static uint32_t trace_stream_sent = 0;      // bytes already delivered
+static uint32_t trace_stream_dropped = 0;   // entries lost because the buffer was full
+
 
 // get the address of BigBuf
 uint8_t *BigBuf_get_addr(void)
@@ -89,12 +120,68 @@ void BigBuf_Clear_keep_EM(void)
 // at the beginning of BigBuf is always for traces/samples
 uint8_t *BigBuf_malloc(uint16_t chunksize)
 {
+	chunksize = (chunksize + 3) & 0xfffc;       // round to next multiple of 4
+
+	// prefer reusing a released region of fitting size (best fit)
+	int best = -1;
+	for (int i = 0; i < BIGBUF_MAX_REGIONS; i++) {
+		if (regions[i].size >= chunksize && !regions[i].used) {
+			if (best < 0 || regions[i].size < regions[best].size)
+				best = i;
+		}
+	}
+	if (best >= 0) {
+		regions[best].used = true;
+		return (uint8_t *)BigBuf + regions[best].start;
+	}
+
 	if (BigBuf_hi - chunksize < 0) {
 		return NULL;                            // no memory left
-	} else {
-		chunksize = (chunksize + 3) & 0xfffc;   // round to next multiple of 4
-		BigBuf_hi -= chunksize;                 // aligned to 4 Byte boundary
-		return (uint8_t *)BigBuf + BigBuf_hi;
+	}
+	for (int i = 0; i < BIGBUF_MAX_REGIONS; i++) {
+		if (regions[i].size == 0) {
+			BigBuf_hi -= chunksize;             // aligned to 4 Byte boundary
+			if (BigBuf_hi < BigBuf_lowater)
+				BigBuf_lowater = BigBuf_hi;
+			regions[i].start = BigBuf_hi;
+			regions[i].size = chunksize;
+			regions[i].used = true;
+			return (uint8_t *)BigBuf + BigBuf_hi;
+		}
+	}
+	return NULL;                                // region table full
+}
+
+
+// hand back a single allocation. The region is reusable by a following
+// BigBuf_malloc() immediately; the trace/sample area only grows again once
+// all regions down to it have been released.
+void BigBuf_release(uint8_t *mem)
+{
+	if (mem == NULL) return;
+
+	uint16_t start = mem - (uint8_t *)BigBuf;
+	for (int i = 0; i < BIGBUF_MAX_REGIONS; i++) {
+		if (regions[i].size != 0 && regions[i].start == start) {
+			regions[i].used = false;
+			break;
+		}
+	}
+	if (mem == emulator_memory) {
+		emulator_memory = NULL;
+	}
+
+	// merge released regions bordering the unallocated area back into it
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (int i = 0; i < BIGBUF_MAX_REGIONS; i++) {
+			if (regions[i].size != 0 && !regions[i].used && regions[i].start == BigBuf_hi) {
+				BigBuf_hi += regions[i].size;
+				regions[i].size = 0;
+				merged = true;
+			}
+		}
 	}
 }
 
@@ -104,24 +191,49 @@ void BigBuf_free(void)
 {
 	BigBuf_hi = BIGBUF_SIZE;
 	emulator_memory = NULL;
+	em_base = NULL;
+	em_pool = NULL;
+	memset(em_pool_used, 0, sizeof(em_pool_used));
+	memset(em_slot_used, 0, sizeof(em_slot_used));
+	memset(regions, 0, sizeof(regions));
 }
 
 
-// free allocated chunks EXCEPT the emulator memory
+// free allocated chunks EXCEPT the emulator memory (and the persona storage
+// deltaing against it, if any personas have been stored)
 void BigBuf_free_keep_EM(void)
 {
-	if (emulator_memory != NULL) {
-		BigBuf_hi = emulator_memory - (uint8_t *)BigBuf;
-	} else {
-		BigBuf_hi = BIGBUF_SIZE;
+	uint16_t keep_lo = BIGBUF_SIZE;
+	if (emulator_memory != NULL)
+		keep_lo = emulator_memory - (uint8_t *)BigBuf;
+	if (em_base != NULL && em_base - (uint8_t *)BigBuf < keep_lo)
+		keep_lo = em_base - (uint8_t *)BigBuf;
+	if (em_pool != NULL && em_pool - (uint8_t *)BigBuf < keep_lo)
+		keep_lo = em_pool - (uint8_t *)BigBuf;
+	BigBuf_hi = keep_lo;
+	for (int i = 0; i < BIGBUF_MAX_REGIONS; i++) {
+		uint8_t *start = (uint8_t *)BigBuf + regions[i].start;
+		if (regions[i].start < BigBuf_hi) {
+			regions[i].size = 0;
+		} else if (start != emulator_memory && start != em_base && start != em_pool) {
+			regions[i].used = false;	// reusable gap above the new low mark
+		}
 	}
 }
 
+
+// return the peak number of bytes ever allocated from BigBuf
+uint16_t BigBuf_hi_watermark(void)
+{
+	return BIGBUF_SIZE - BigBuf_lowater;
+}
+
 void BigBuf_print_status(void)
 {
 	Dbprintf("Memory");
 	Dbprintf("  BIGBUF_SIZE.............%d", BIGBUF_SIZE);
 	Dbprintf("  Available memory........%d", BigBuf_hi);
+	Dbprintf("  High water mark.........%d", BigBuf_hi_watermark());
 	Dbprintf("Tracing");
 	Dbprintf("  tracing ................%d", tracing);
 	Dbprintf("  traceLen ...............%d", traceLen);
@@ -140,6 +252,45 @@ void clear_trace() {
 }
 
 
+void trace_stream_start(void) {
+	trace_streaming = true;
+	trace_stream_sent = 0;
+	trace_stream_dropped = 0;
+}
+
+
+void trace_stream_stop(void) {
+	trace_streaming = false;
+}
+
+
+uint32_t trace_stream_sent_total(void) {
+	return trace_stream_sent;
+}
+
+
+uint32_t trace_stream_dropped_total(void) {
+	return trace_stream_dropped;
+}
+
+
+// push the used part of the trace buffer to the client and make the space
+// available for new entries again. Blocks for the duration of the USB
+// transfer, so callers must pick a quiet moment
+void trace_stream_flush(void)
+{
+	uint8_t *trace = BigBuf_get_addr();
+	uint32_t pos = 0;
+	while (pos < traceLen) {
+		uint32_t len = MIN(traceLen - pos, USB_CMD_DATA_SIZE);
+		cmd_send(CMD_DOWNLOADED_TRACE, trace_stream_sent, len, trace_stream_dropped, trace + pos, len);
+		trace_stream_sent += len;
+		pos += len;
+	}
+	traceLen = 0;
+}
+
+
 void set_tracing(bool enable) {
 	tracing = enable;
 }
@@ -180,6 +331,10 @@ bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_
 	uint16_t max_traceLen = BigBuf_max_traceLen();
 
 	if (traceLen + sizeof(iLen) + sizeof(timestamp_start) + sizeof(duration) + num_paritybytes + iLen >= max_traceLen) {
+		if (trace_streaming) {
+			trace_stream_dropped++; // the flush didn't keep up. Drop the entry but keep going
+			return true;
+		}
 		tracing = false;    // don't trace any more
 		return false;
 	}
@@ -294,6 +449,109 @@ uint8_t emlSet(uint8_t *data, uint32_t offset, uint32_t length){
 	}
 }
 
+// Copy-on-write persona storage. The active card image stays the flat
+// CARD_MEMORY_SIZE region handed out by BigBuf_get_EM_addr(), so the
+// simulator keeps addressing it directly. The first store snapshots the
+// active image as the base shared by all personas; every stored persona
+// records, per EM_PAGE_SIZE page, either "same as base" or an index into a
+// small pool of copied pages. Restoring rebuilds the flat image with at most
+// CARD_MEMORY_SIZE of memcpy - microseconds, against the multi-second USB
+// upload a persona switch used to cost.
+
+// release the delta pages a slot holds and mark it free
+static void emlPersonaDropPages(uint8_t slot)
+{
+	for (int p = 0; p < EM_PAGES; p++) {
+		if (em_ptable[slot][p] != EM_PAGE_SHARED)
+			em_pool_used[em_ptable[slot][p]] = 0;
+		em_ptable[slot][p] = EM_PAGE_SHARED;
+	}
+	em_slot_used[slot] = false;
+}
+
+// snapshot the active image into a persona slot
+// 0 = ok, 1 = bad slot, 2 = out of BigBuf memory, 3 = delta pool exhausted
+uint8_t emlPersonaStore(uint8_t slot)
+{
+	if (slot >= EM_PERSONA_SLOTS) return 1;
+
+	uint8_t *em = BigBuf_get_EM_addr();
+	if (em_base == NULL) {
+		em_base = BigBuf_malloc(CARD_MEMORY_SIZE);
+		em_pool = BigBuf_malloc(EM_POOL_PAGES * EM_PAGE_SIZE);
+		if (em_base == NULL || em_pool == NULL) {
+			BigBuf_release(em_base);
+			BigBuf_release(em_pool);
+			em_base = NULL;
+			em_pool = NULL;
+			return 2;
+		}
+		// the first stored image defines the base everything else deltas against
+		memcpy(em_base, em, CARD_MEMORY_SIZE);
+		memset(em_ptable, EM_PAGE_SHARED, sizeof(em_ptable));
+	}
+
+	emlPersonaDropPages(slot);
+
+	for (int p = 0; p < EM_PAGES; p++) {
+		if (memcmp(em + p*EM_PAGE_SIZE, em_base + p*EM_PAGE_SIZE, EM_PAGE_SIZE) == 0)
+			continue;
+		int free_pg = -1;
+		for (int i = 0; i < EM_POOL_PAGES; i++) {
+			if (!em_pool_used[i]) {
+				free_pg = i;
+				break;
+			}
+		}
+		if (free_pg < 0) {		// pool exhausted, roll this slot back
+			emlPersonaDropPages(slot);
+			return 3;
+		}
+		memcpy(em_pool + free_pg*EM_PAGE_SIZE, em + p*EM_PAGE_SIZE, EM_PAGE_SIZE);
+		em_pool_used[free_pg] = 1;
+		em_ptable[slot][p] = free_pg;
+	}
+	em_slot_used[slot] = true;
+	return 0;
+}
+
+// rebuild the active image from a persona slot
+// 0 = ok, 1 = bad slot, 2 = slot empty
+uint8_t emlPersonaRestore(uint8_t slot)
+{
+	if (slot >= EM_PERSONA_SLOTS) return 1;
+	if (!em_slot_used[slot]) return 2;
+
+	uint8_t *em = BigBuf_get_EM_addr();
+	for (int p = 0; p < EM_PAGES; p++) {
+		uint8_t *src = (em_ptable[slot][p] == EM_PAGE_SHARED)
+			? em_base + p*EM_PAGE_SIZE
+			: em_pool + em_ptable[slot][p]*EM_PAGE_SIZE;
+		memcpy(em + p*EM_PAGE_SIZE, src, EM_PAGE_SIZE);
+	}
+	return 0;
+}
+
+void emlPersonaStatus(void)
+{
+	int pool_free = 0;
+	for (int i = 0; i < EM_POOL_PAGES; i++)
+		if (!em_pool_used[i]) pool_free++;
+
+	Dbprintf("Emulator personas (%d byte pages, pool %d/%d pages free)",
+			EM_PAGE_SIZE, pool_free, EM_POOL_PAGES);
+	for (int s = 0; s < EM_PERSONA_SLOTS; s++) {
+		if (!em_slot_used[s]) {
+			Dbprintf("  slot %d: free", s);
+			continue;
+		}
+		int delta = 0;
+		for (int p = 0; p < EM_PAGES; p++)
+			if (em_ptable[s][p] != EM_PAGE_SHARED) delta++;
+		Dbprintf("  slot %d: stored, %d delta pages", s, delta);
+	}
+}
+
 // Get Emulator memory
 uint8_t emlGet(uint32_t offset, uint32_t length){
 	uint8_t* mem = BigBuf_get_EM_addr();
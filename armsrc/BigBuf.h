@@ -23,6 +23,13 @@
 #define CARD_MEMORY_SIZE		4096
 #define DMA_BUFFER_SIZE    		128
 
+// copy-on-write persona storage for the emulator memory
+// (the slot count EM_PERSONA_SLOTS lives in usb_cmd.h, the client needs it)
+#define EM_PAGE_SIZE			64
+#define EM_PAGES				(CARD_MEMORY_SIZE / EM_PAGE_SIZE)
+#define EM_POOL_PAGES			64		// shared pool of delta pages (4kB)
+#define EM_PAGE_SHARED			0xff	// page table entry: same as base image
+
 extern uint8_t *BigBuf_get_addr(void);
 extern uint8_t *BigBuf_get_EM_addr(void);
 extern uint16_t BigBuf_max_traceLen(void);
@@ -31,15 +38,25 @@ extern void BigBuf_Clear_ext(bool verbose);
 extern void BigBuf_Clear_keep_EM(void);
 extern void BigBuf_Clear_EM(void);
 extern uint8_t *BigBuf_malloc(uint16_t);
+extern void BigBuf_release(uint8_t *mem);
 extern void BigBuf_free(void);
 extern void BigBuf_free_keep_EM(void);
+extern uint16_t BigBuf_hi_watermark(void);
 extern void BigBuf_print_status(void);
 extern uint16_t BigBuf_get_traceLen(void);
 extern void clear_trace(void);
 extern void set_tracing(bool enable);
 extern bool get_tracing(void);
+extern void trace_stream_start(void);
+extern void trace_stream_stop(void);
+extern void trace_stream_flush(void);
+extern uint32_t trace_stream_sent_total(void);
+extern uint32_t trace_stream_dropped_total(void);
 extern bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_start, uint32_t timestamp_end, uint8_t *parity, bool readerToTag);
 extern int LogTraceHitag(const uint8_t * btBytes, int iBits, int iSamples, uint32_t dwParity, int bReader);
 extern uint8_t emlSet(uint8_t *data, uint32_t offset, uint32_t length);
 extern uint8_t emlGet(uint32_t offset, uint32_t length);
+extern uint8_t emlPersonaStore(uint8_t slot);
+extern uint8_t emlPersonaRestore(uint8_t slot);
+extern void emlPersonaStatus(void);
 #endif /* __BIGBUF_H */
@@ -25,10 +25,13 @@
 #include "hitag2.h"
 #include "hitagS.h"
 #include "iclass.h"
+#include "iso14443a.h"
 #include "iso14443b.h"
 #include "iso15693.h"
 #include "lfsampling.h"
 #include "BigBuf.h"
+#include "crc32.h"
+#include "eventjournal.h"
 #include "mifarecmd.h"
 #include "mifareutil.h"
 #include "mifaresim.h"
@@ -36,6 +39,8 @@
 #include "i2c.h"
 #include "hfsnoop.h"
 #include "fpgaloader.h"
+#include "flashstore.h"
+#include "rle.h"
 #ifdef WITH_LCD
  #include "LCD.h"
 #endif
@@ -87,12 +92,56 @@ void ToSendStuffBit(int b)
 
 //=============================================================================
 // Debug print functions, to go out over USB, to the usual PC-side client.
+// Lines are staged in a ring buffer and drained by the main loop between
+// commands, so printing inside a protocol loop costs a formatting pass and a
+// copy but never a synchronous USB transfer that would distort reply timing.
+// If the ring fills up before the next drain, whole lines are dropped and
+// counted; the count is reported on the next drain.
 //=============================================================================
 
+#define DBG_RING_SIZE 2048	// must be a power of two
+
+static char dbg_ring[DBG_RING_SIZE];
+static volatile uint16_t dbg_ring_head = 0;	// consumer index, only moved by DbDrain()
+static volatile uint16_t dbg_ring_tail = 0;	// producer index, only moved by DbpString()
+static volatile uint16_t dbg_ring_dropped = 0;	// lines lost to a full ring
+
 void DbpString(char *str)
 {
   byte_t len = strlen(str);
-  cmd_send(CMD_DEBUG_PRINT_STRING,len,0,0,(byte_t*)str,len);
+  // one record = 1 length byte + payload. Indices run free and are only
+  // masked on access, so used space is a plain difference.
+  if ((uint16_t)(DBG_RING_SIZE - (uint16_t)(dbg_ring_tail - dbg_ring_head)) < len + 1) {
+    dbg_ring_dropped++;
+    return;
+  }
+  uint16_t tail = dbg_ring_tail;
+  dbg_ring[tail++ & (DBG_RING_SIZE - 1)] = len;
+  for (byte_t i = 0; i < len; i++) {
+    dbg_ring[tail++ & (DBG_RING_SIZE - 1)] = str[i];
+  }
+  dbg_ring_tail = tail;	// publish the record only once it is complete
+}
+
+// Push queued debug lines to the client. Call only when the RF state machine
+// is idle - this does synchronous USB transfers.
+static void DbDrain(void)
+{
+  if (dbg_ring_dropped) {
+    uint16_t dropped = dbg_ring_dropped;
+    dbg_ring_dropped = 0;
+    Dbprintf("!!! debug ring overflowed, %u lines lost", dropped);
+  }
+  while (dbg_ring_head != dbg_ring_tail) {
+    char line[256];
+    uint16_t head = dbg_ring_head;
+    byte_t len = dbg_ring[head++ & (DBG_RING_SIZE - 1)];
+    for (byte_t i = 0; i < len; i++) {
+      line[i] = dbg_ring[head++ & (DBG_RING_SIZE - 1)];
+    }
+    dbg_ring_head = head;
+    cmd_send(CMD_DEBUG_PRINT_STRING,len,0,0,(byte_t*)line,len);
+  }
 }
 
 #if 0
@@ -114,6 +163,29 @@ void Dbprintf(const char *fmt, ...) {
 	DbpString(output_string);
 }
 
+// Rate-limited progress reports for long-running loops, so the client can
+// tell slow progress from a hang. One unsolicited CMD_PROGRESS_REPORT every
+// couple of seconds is plenty and keeps the USB path clear for the work
+// itself; the client renders them through its shared progress printer.
+#define PROGRESS_REPORT_INTERVAL_MS 2000
+static uint32_t progress_start_time = 0;
+static uint32_t progress_last_sent = 0;
+
+void SendProgressStart(void)
+{
+	progress_start_time = GetTickCount();
+	progress_last_sent = 0;
+}
+
+void SendProgress(uint32_t done, uint32_t total)
+{
+	uint32_t now = GetTickCount();
+	if (progress_last_sent != 0 && now - progress_last_sent < PROGRESS_REPORT_INTERVAL_MS)
+		return;
+	progress_last_sent = now;
+	cmd_send(CMD_PROGRESS_REPORT, done, total, now - progress_start_time, 0, 0);
+}
+
 // prints HEX & ASCII
 void Dbhexdump(int len, uint8_t *d, bool bAsci) {
 	int l=0,i;
@@ -400,6 +472,67 @@ void printUSBSpeed(void)
 
 }
 	
+//-----------------------------------------------------------------------------
+// Lightweight profiling counters. Regions are wrapped with PROF_ENTER/
+// PROF_LEAVE (see apps.h) and accumulate runtime in RTT millisecond ticks.
+// The table lives in static RAM rather than BigBuf: almost every command
+// claims and clears BigBuf, which would wipe the counters before the client
+// gets a chance to read them.
+//-----------------------------------------------------------------------------
+
+typedef struct {
+	uint32_t calls;
+	uint32_t total_ms;
+	uint32_t max_ms;
+	uint32_t enter_ms;
+} prof_region_t;
+
+static prof_region_t prof_regions[PROF_NUM_REGIONS];
+
+static const char * const prof_region_names[PROF_NUM_REGIONS] = {
+	"14a reader",
+	"epa nonce",
+	"mf darkside",
+	"mf sync",
+	"user4",
+	"user5",
+	"user6",
+	"user7"
+};
+
+void ProfEnter(int region)
+{
+	if (region < 0 || region >= PROF_NUM_REGIONS) return;
+	prof_regions[region].enter_ms = GetTickCount();
+}
+
+void ProfLeave(int region)
+{
+	if (region < 0 || region >= PROF_NUM_REGIONS) return;
+	prof_region_t *r = &prof_regions[region];
+	uint32_t elapsed = GetTickCount() - r->enter_ms;
+	r->calls++;
+	r->total_ms += elapsed;
+	if (elapsed > r->max_ms) r->max_ms = elapsed;
+}
+
+void ProfReset(void)
+{
+	memset(prof_regions, 0, sizeof(prof_regions));
+}
+
+void ProfPrint(void)
+{
+	Dbprintf("Profiling (ms)");
+	for (int i = 0; i < PROF_NUM_REGIONS; i++) {
+		prof_region_t *r = &prof_regions[i];
+		if (!r->calls) continue;
+		Dbprintf("  %-12s calls: %5d  total: %7d  avg: %5d  max: %5d",
+			prof_region_names[i], r->calls, r->total_ms,
+			r->total_ms / r->calls, r->max_ms);
+	}
+}
+
 /**
   * Prints runtime information about the PM3.
 **/
@@ -412,12 +545,13 @@ void SendStatus(void)
 #endif
 	printConfig(); //LF Sampling config
 	printUSBSpeed();
+	ProfPrint();
 	Dbprintf("Various");
 	Dbprintf("  MF_DBGLEVEL........%d", MF_DBGLEVEL);
 	Dbprintf("  ToSendMax..........%d", ToSendMax);
 	Dbprintf("  ToSendBit..........%d", ToSendBit);
 
-	cmd_send(CMD_ACK,1,0,0,0,0);
+	cmd_send(CMD_ACK,1,BigBuf_hi_watermark(),0,0,0);
 }
 
 #if defined(WITH_ISO14443a_StandAlone) || defined(WITH_LF_StandAlone)
@@ -465,6 +599,7 @@ void StandAloneMode14a()
 	for (;;)
 	{
 		usb_poll();
+		DbDrain();
 		WDT_HIT();
 		SpinDelay(300);
 
@@ -706,6 +841,7 @@ void SamyRun()
 	for (;;)
 	{
 		usb_poll();
+		DbDrain();
 		WDT_HIT();
 
 		// Was our button held down or pressed?
@@ -989,6 +1125,187 @@ void ListenReaderField(int limit)
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Background tag presence polling. When enabled the main loop briefly powers
+// the field at the configured cadence, tries to select a tag and reports
+// arrival/departure transitions as unsolicited CMD_TAG_POLL_EVENT messages.
+// Events go through a small ring first so a burst of transitions never
+// blocks the detection pass itself.
+//-----------------------------------------------------------------------------
+#ifdef WITH_ISO14443a
+
+#define TAG_POLL_RING_LEN	8
+
+typedef struct {
+	uint32_t timestamp;
+	uint8_t arrival;
+	uint8_t uidlen;
+	uint8_t uid[10];
+} tag_poll_event_t;
+
+static tag_poll_event_t tag_poll_ring[TAG_POLL_RING_LEN];
+static uint8_t tag_poll_ring_head = 0;
+static uint8_t tag_poll_ring_count = 0;
+static uint32_t tag_poll_period = 0;		// ms between polls, 0 = polling disabled
+static uint32_t tag_poll_last_check = 0;
+static bool tag_poll_present = false;
+static uint8_t tag_poll_uid[10];
+static uint8_t tag_poll_uidlen = 0;
+
+static void tag_poll_enqueue(bool arrival, uint8_t *uid, uint8_t uidlen)
+{
+	if (tag_poll_ring_count == TAG_POLL_RING_LEN) {		// ring full: drop the oldest event
+		tag_poll_ring_head = (tag_poll_ring_head + 1) % TAG_POLL_RING_LEN;
+		tag_poll_ring_count--;
+	}
+	tag_poll_event_t *ev = &tag_poll_ring[(tag_poll_ring_head + tag_poll_ring_count) % TAG_POLL_RING_LEN];
+	ev->timestamp = GetTickCount();
+	ev->arrival = arrival;
+	ev->uidlen = (uidlen > sizeof(ev->uid)) ? sizeof(ev->uid) : uidlen;
+	memset(ev->uid, 0, sizeof(ev->uid));
+	memcpy(ev->uid, uid, ev->uidlen);
+	tag_poll_ring_count++;
+}
+
+static void TagPollCheck(void)
+{
+	if (tag_poll_period == 0) return;
+	if (GetTickCount() - tag_poll_last_check < tag_poll_period) return;
+	tag_poll_last_check = GetTickCount();
+
+	iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+	iso14a_card_select_t card;
+	bool present = (iso14443a_select_card(NULL, &card, NULL, true, 0, true) != 0);
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	LEDsoff();
+
+	if (present && tag_poll_present
+			&& (card.uidlen != tag_poll_uidlen || memcmp(card.uid, tag_poll_uid, tag_poll_uidlen) != 0)) {
+		// tag swapped between two polls: report both transitions
+		tag_poll_enqueue(false, tag_poll_uid, tag_poll_uidlen);
+		tag_poll_present = false;
+	}
+	if (present && !tag_poll_present) {
+		memcpy(tag_poll_uid, card.uid, sizeof(tag_poll_uid));
+		tag_poll_uidlen = (card.uidlen > sizeof(tag_poll_uid)) ? sizeof(tag_poll_uid) : card.uidlen;
+		tag_poll_enqueue(true, tag_poll_uid, tag_poll_uidlen);
+	} else if (!present && tag_poll_present) {
+		tag_poll_enqueue(false, tag_poll_uid, tag_poll_uidlen);
+	}
+	tag_poll_present = present;
+
+	// push the queued events to the client
+	while (tag_poll_ring_count > 0) {
+		tag_poll_event_t *ev = &tag_poll_ring[tag_poll_ring_head];
+		cmd_send(CMD_TAG_POLL_EVENT, ev->arrival, ev->timestamp, ev->uidlen, ev->uid, ev->uidlen);
+		tag_poll_ring_head = (tag_poll_ring_head + 1) % TAG_POLL_RING_LEN;
+		tag_poll_ring_count--;
+	}
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// Time-sliced LF/HF triage scan for unknown tags. Alternates a short
+// ISO14443a wakeup+select with a brief 125 kHz acquisition until one side
+// sees a tag, so front-desk triage of an unknown card doesn't have to run
+// 'lf search' and 'hf search' back to back. Each slice still pays a
+// bitstream switch (both images can't stay resident, see FpgaDownloadAndGo),
+// which is why the LF window is kept short and the HF probe is a single
+// select. The LF side only does a cheap modulation-swing check here; the
+// captured samples stay in the big buffer and the client runs its full
+// demod chain over them.
+//-----------------------------------------------------------------------------
+#if defined(WITH_ISO14443a) && defined(WITH_LF)
+
+#define ISCAN_DEFAULT_ROUNDS	10
+#define ISCAN_LF_SAMPLES	30000
+#define ISCAN_LF_MIN_SWING	30	// peak-to-peak ADC counts; bare carrier stays well below this
+
+static void InterleavedScan(uint16_t rounds)
+{
+	if (rounds == 0)
+		rounds = ISCAN_DEFAULT_ROUNDS;
+
+	iso14a_card_select_t card;
+	uint16_t round;
+
+	for (round = 0; round < rounds; round++) {
+		WDT_HIT();
+		if (BUTTON_PRESS() || usb_poll_validate_length())
+			break;
+
+		// HF slice: one wakeup + select
+		iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+		if (iso14443a_select_card(NULL, &card, NULL, true, 0, true)) {
+			FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+			LEDsoff();
+			cmd_send(CMD_ACK, ISCAN_FOUND_14A, round + 1, 0, (uint8_t *)&card, sizeof(card));
+			return;
+		}
+		FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+		// LF slice: power the 125 kHz field and grab a short raw window
+		LFSetupFPGAForADC(95, true);
+		uint32_t n = DoPartialAcquisition(0, true, ISCAN_LF_SAMPLES, 0) >> 3;
+		FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+		uint8_t *buf = BigBuf_get_addr();
+		uint8_t smin = 0xff, smax = 0x00;
+		for (uint32_t i = 0; i < n; i++) {
+			if (buf[i] < smin) smin = buf[i];
+			if (buf[i] > smax) smax = buf[i];
+		}
+		if (n > 0 && (uint8_t)(smax - smin) >= ISCAN_LF_MIN_SWING) {
+			LEDsoff();
+			cmd_send(CMD_ACK, ISCAN_FOUND_LF, round + 1, n, 0, 0);
+			return;
+		}
+	}
+
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	LEDsoff();
+	cmd_send(CMD_ACK, ISCAN_FOUND_NOTHING, round, 0, 0, 0);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// Continuous antenna telemetry. When enabled the main loop drives the chosen
+// antenna and pushes one averaged voltage reading at the configured cadence
+// as an unsolicited CMD_ANTENNA_TELEMETRY_SAMPLE message, so the client can
+// watch tuning drift live instead of re-running 'hw tune'. The field stays
+// powered between samples; disabling the telemetry switches it back off.
+//-----------------------------------------------------------------------------
+static uint32_t ant_telem_period = 0;		// ms between samples, 0 = disabled
+static uint32_t ant_telem_last = 0;
+static bool ant_telem_hf = false;
+static uint8_t ant_telem_divisor = 95;		// 125 kHz
+
+static void AntennaTelemetryCheck(void)
+{
+	if (ant_telem_period == 0) return;
+	uint32_t now = GetTickCount();
+	if (now - ant_telem_last < ant_telem_period) return;
+	ant_telem_last = now;
+
+	// re-assert the field every sample - another command may have touched
+	// the FPGA in between
+	int mv;
+	if (ant_telem_hf) {
+		FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+		FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER);
+		SpinDelay(20);
+		mv = AvgAdc_Voltage_HF();
+	} else {
+		FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
+		FpgaWriteConfWord(FPGA_MAJOR_MODE_LF_ADC | FPGA_LF_ADC_READER_FIELD);
+		FpgaSendCommand(FPGA_CMD_SET_DIVISOR, ant_telem_divisor);
+		SpinDelay(20);
+		mv = AvgAdc_Voltage_LF();
+	}
+	LED_D_ON();
+	cmd_send(CMD_ANTENNA_TELEMETRY_SAMPLE, mv, ant_telem_hf, now, 0, 0);
+}
+
 void UsbPacketReceived(uint8_t *packet, int len)
 {
 	UsbCommand *c = (UsbCommand *)packet;
@@ -998,20 +1315,37 @@ void UsbPacketReceived(uint8_t *packet, int len)
 	switch(c->cmd) {
 #ifdef WITH_LF
 		case CMD_SET_LF_SAMPLING_CONFIG:
-			setSamplingConfig(c->d.asBytes);
+			// arg[0] = 1: just report the current config generation without
+			// applying anything, so the client can detect a stale cache
+			if (c->arg[0] & 1) {
+				cmd_send(CMD_ACK,getSamplingConfigGeneration(),0,0,getSamplingConfig(),sizeof(sample_config));
+			} else {
+				cmd_send(CMD_ACK,setSamplingConfig(c->d.asBytes),0,0,0,0);
+			}
 			break;
-		case CMD_ACQUIRE_RAW_ADC_SAMPLES_125K:
-			cmd_send(CMD_ACK,SampleLF(c->arg[0], c->arg[1]),0,0,0,0);
+		case CMD_ACQUIRE_RAW_ADC_SAMPLES_125K: {
+			uint32_t bits = SampleLF(c->arg[0], c->arg[1]);
+			cmd_send(CMD_ACK,bits,getLFSignalStats(),0,0,0);
 			break;
+		}
 		case CMD_MOD_THEN_ACQUIRE_RAW_ADC_SAMPLES_125K:
 			ModThenAcquireRawAdcSamples125k(c->arg[0],c->arg[1],c->arg[2],c->d.asBytes);
 			break;
 		case CMD_LF_SNOOP_RAW_ADC_SAMPLES:
 			cmd_send(CMD_ACK,SnoopLF(),0,0,0,0);
 			break;
+		case CMD_LF_SNOOP_SMART_ADC_SAMPLES:
+			cmd_send(CMD_ACK,SnoopLFSmart(c->arg[0]),0,0,0,0);
+			break;
+		case CMD_LF_STREAM_RAW_ADC_SAMPLES:
+			StreamLF(c->arg[0], c->arg[1]);	// sends its own ACK when done
+			break;
 		case CMD_HID_DEMOD_FSK:
 			CmdHIDdemodFSK(c->arg[0], 0, 0, 0, 1);
 			break;
+		case CMD_HID_BEACON:
+			CmdHIDbeaconFSK();
+			break;
 		case CMD_HID_SIM_TAG:
 			CmdHIDsimTAG(c->arg[0], c->arg[1], c->arg[2], 1);
 			break;
@@ -1024,6 +1358,9 @@ void UsbPacketReceived(uint8_t *packet, int len)
 		case CMD_PSK_SIM_TAG:
 			CmdPSKsimTag(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
 			break;
+		case CMD_LF_SYNTH_SIM:
+			CmdLFSynthSim(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
+			break;
 		case CMD_HID_CLONE_TAG:
 			CopyHIDtoT55x7(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes[0], 0x1D);
 			break;
@@ -1069,12 +1406,18 @@ void UsbPacketReceived(uint8_t *packet, int len)
 		case CMD_T55XX_WRITE_BLOCK:
 			T55xxWriteBlock(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes[0]);
 			break;
+		case CMD_T55XX_WRITE_BLOCK_BULK:
+			T55xxWriteBlockBulk(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
+			break;
 		case CMD_T55XX_WAKEUP:
 			T55xxWakeUp(c->arg[0]);
 			break;
 		case CMD_T55XX_RESET_READ:
 			T55xxResetRead();
 			break;
+		case CMD_T55XX_CHK_PWDS:
+			T55xxChkPwds(c->arg[0], c->arg[1], c->d.asBytes);
+			break;
 		case CMD_PCF7931_READ:
 			ReadPCF7931();
 			break;
@@ -1142,7 +1485,7 @@ void UsbPacketReceived(uint8_t *packet, int len)
 			break;
 			
 		case CMD_SNOOP_ISO_15693:
-			SnoopIso15693();
+			SnoopIso15693(c->arg[0]);
 			break;
 			
 		case CMD_ISO_15693_COMMAND:
@@ -1161,6 +1504,10 @@ void UsbPacketReceived(uint8_t *packet, int len)
 			ReaderIso15693(c->arg[0]);
 			break;
 
+		case CMD_ISO_15693_INVENTORY:
+			Iso15693Inventory16();
+			break;
+
 		case CMD_SIMTAG_ISO_15693:
 			SimTagIso15693(c->arg[0], c->d.asBytes);
 			break;
@@ -1208,28 +1555,52 @@ void UsbPacketReceived(uint8_t *packet, int len)
 		case CMD_ISO_14443B_COMMAND:
 			SendRawCommand14443B(c->arg[0],c->arg[1],c->arg[2],c->d.asBytes);
 			break;
+		case CMD_READER_ISO_14443B_INVENTORY:
+			Iso14443bInventory(c);
+			break;
 #endif
 
 #ifdef WITH_ISO14443a
 		case CMD_SNOOP_ISO_14443a:
-			SnoopIso14443a(c->arg[0]);
+			SnoopIso14443a(c);
 			break;
 		case CMD_READER_ISO_14443a:
+			PROF_ENTER(PROF_14A_READER);
 			ReaderIso14443a(c);
+			PROF_LEAVE(PROF_14A_READER);
+			break;
+		case CMD_READER_ISO_14443A_APDU_BATCH:
+			ReaderIso14443aBatch(c);
+			break;
+		case CMD_READER_ISO_14443A_INVENTORY:
+			Iso14443aInventory(c);
+			break;
+		case CMD_TOPAZ_READ_ALL:
+			ReaderTopazReadAll(c);
+			break;
+		case CMD_READER_ISO_14443A_TIMING:
+			ReaderIso14443aTiming(c->arg[0]);
 			break;
 		case CMD_SIMULATE_TAG_ISO_14443a:
 			SimulateIso14443aTag(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);  // ## Simulate iso14443a tag - pass tag type & UID
 			break;
 			
 		case CMD_EPA_PACE_COLLECT_NONCE:
+			PROF_ENTER(PROF_EPA_NONCE);
 			EPA_PACE_Collect_Nonce(c);
+			PROF_LEAVE(PROF_EPA_NONCE);
+			break;
+		case CMD_EPA_PACE_COLLECT_NONCE_BATCH:
+			EPA_PACE_Collect_Nonce_Batch(c);
 			break;
 		case CMD_EPA_PACE_REPLAY:
 			EPA_PACE_Replay(c);
 			break;
 			
 		case CMD_READER_MIFARE:
+			PROF_ENTER(PROF_MF_DARKSIDE);
 			ReaderMifare(c->arg[0]);
+			PROF_LEAVE(PROF_MF_DARKSIDE);
 			break;
 		case CMD_MIFARE_READBL:
 			MifareReadBlock(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
@@ -1240,6 +1611,9 @@ void UsbPacketReceived(uint8_t *packet, int len)
 		case CMD_MIFAREUC_AUTH:
 			MifareUC_Auth(c->arg[0],c->d.asBytes);
 			break;
+		case CMD_MIFAREU_EV1_PWD_CHECK:
+			MifareUEv1CheckPwds(c->arg[0], c->d.asBytes);
+			break;
 		case CMD_MIFAREU_READCARD:
 			MifareUReadCard(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
 			break;
@@ -1249,6 +1623,9 @@ void UsbPacketReceived(uint8_t *packet, int len)
 		case CMD_MIFARE_READSC:
 			MifareReadSector(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
 			break;
+		case CMD_MIFARE_READCARD:
+			MifareReadCard(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
+			break;
 		case CMD_MIFARE_WRITEBL:
 			MifareWriteBlock(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
 			break;
@@ -1270,9 +1647,18 @@ void UsbPacketReceived(uint8_t *packet, int len)
 		case CMD_MIFARE_CHKKEYS:
 			MifareChkKeys(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
 			break;
+		case CMD_MIFARE_CHKKEYS_LOAD:
+			MifareChkKeysLoad(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
+			break;
+		case CMD_MIFARE_CHKKEYS_CACHED:
+			MifareChkKeysCached(c->arg[0], c->arg[1]);
+			break;
 		case CMD_SIMULATE_MIFARE_CARD:
 			MifareSim(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
 			break;
+		case CMD_MIFARE_SIM_HOOKS:
+			cmd_send(CMD_ACK, MifareSimSetHooks(c->arg[0], c->d.asBytes), 0, 0, 0, 0);
+			break;
 		
 		// emulator
 		case CMD_MIFARE_SET_DBGMODE:
@@ -1284,9 +1670,15 @@ void UsbPacketReceived(uint8_t *packet, int len)
 		case CMD_MIFARE_EML_MEMSET:
 			MifareEMemSet(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
 			break;
+		case CMD_MIFARE_EML_LOAD:
+			MifareEMemLoad(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
+			break;
 		case CMD_MIFARE_EML_MEMGET:
 			MifareEMemGet(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
 			break;
+		case CMD_MIFARE_EML_PERSONA:
+			MifareEMemPersona(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
+			break;
 		case CMD_MIFARE_EML_CARDLOAD:
 			MifareECardLoad(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
 			break;
@@ -1309,6 +1701,9 @@ void UsbPacketReceived(uint8_t *packet, int len)
 		case CMD_MIFARE_SNIFFER:
 			SniffMifare(c->arg[0]);
 			break;
+		case CMD_MIFARE_COMM_STATS:
+			MifareCommStats(c->arg[0]);
+			break;
 
 #endif
 
@@ -1351,7 +1746,7 @@ void UsbPacketReceived(uint8_t *packet, int len)
 
 #ifdef WITH_HFSNOOP
 		case CMD_HF_SNIFFER:
-			HfSnoop(c->arg[0], c->arg[1]);
+			HfSnoop(c->arg[0], c->arg[1], c->arg[2]);
 			break;
 		case CMD_HF_PLOT:
 			HfPlot();
@@ -1396,6 +1791,19 @@ void UsbPacketReceived(uint8_t *packet, int len)
 			MeasureAntennaTuningHf();
 			break;
 
+		case CMD_ANTENNA_TELEMETRY:
+			ant_telem_period = c->arg[0];
+			ant_telem_hf = c->arg[1] & 1;
+			if (c->arg[2] >= 19 && c->arg[2] <= 255)
+				ant_telem_divisor = c->arg[2];
+			ant_telem_last = 0;
+			if (ant_telem_period == 0) {
+				FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+				LED_D_OFF();
+			}
+			cmd_send(CMD_ACK, 1, ant_telem_period, ant_telem_hf, 0, 0);
+			break;
+
 		case CMD_LISTEN_READER_FIELD:
 			ListenReaderField(c->arg[0]);
 			break;
@@ -1409,9 +1817,20 @@ void UsbPacketReceived(uint8_t *packet, int len)
 		case CMD_DOWNLOAD_RAW_ADC_SAMPLES_125K:
 			LED_B_ON();
 			uint8_t *BigBuf = BigBuf_get_addr();
-			for(size_t i=0; i<c->arg[1]; i += USB_CMD_DATA_SIZE) {
-				size_t len = MIN((c->arg[1] - i),USB_CMD_DATA_SIZE);
-				cmd_send(CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K,i,len,BigBuf_get_traceLen(),BigBuf+c->arg[0]+i,len);
+			size_t chunk_size = cmd_max_payload_size();
+			bool compress = (c->arg[2] & FLAG_DOWNLOAD_COMPRESS);
+			for(size_t i=0; i<c->arg[1]; i += chunk_size) {
+				size_t len = MIN((c->arg[1] - i),chunk_size);
+				if (compress) {
+					static uint8_t rle_buf[USB_CMD_DATA_SIZE_EXT];
+					// send compressed only when the chunk actually shrinks
+					size_t encoded = rle_encode(BigBuf+c->arg[0]+i, len, rle_buf, MIN(len, sizeof(rle_buf)) - 1);
+					if (encoded) {
+						cmd_send_ng(CMD_DOWNLOADED_COMPRESSED_ADC_SAMPLES_125K,i,encoded,len,rle_buf,encoded);
+						continue;
+					}
+				}
+				cmd_send_ng(CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K,i,len,BigBuf_get_traceLen(),BigBuf+c->arg[0]+i,len);
 			}
 			// Trigger a finish downloading signal with an ACK frame
 			cmd_send(CMD_ACK,1,0,BigBuf_get_traceLen(),getSamplingConfig(),sizeof(sample_config));
@@ -1460,6 +1879,100 @@ void UsbPacketReceived(uint8_t *packet, int len)
 		case CMD_PING:
 			cmd_send(CMD_ACK,0,0,0,0,0);
 			break;
+
+		case CMD_EML_GET_HASHES: {
+			// per-block CRC32 of emulator memory so the client can upload
+			// only the blocks that actually changed
+			uint8_t *em = BigBuf_get_EM_addr();
+			uint8_t hashes[USB_CMD_DATA_SIZE];
+			uint32_t offset = c->arg[0] & ~15;
+			uint32_t count = c->arg[1];
+			if (offset > CARD_MEMORY_SIZE)
+				offset = CARD_MEMORY_SIZE;
+			if (count > (CARD_MEMORY_SIZE - offset) / 16)
+				count = (CARD_MEMORY_SIZE - offset) / 16;
+			if (count > USB_CMD_DATA_SIZE / 4)
+				count = USB_CMD_DATA_SIZE / 4;
+			for (uint32_t i = 0; i < count; i++) {
+				crc32(em + offset + i * 16, 16, hashes + i * 4);
+			}
+			cmd_send(CMD_ACK, count, 0, 0, hashes, count * 4);
+			break;
+		}
+
+		case CMD_STANDALONE_PROG:
+			StandAloneSeqLoad(c);
+			break;
+		case CMD_STANDALONE_RESULT:
+			StandAloneSeqResult();
+			break;
+
+		case CMD_EVENT_JOURNAL:
+			EventJournalSend(c->arg[0] & 1);
+			break;
+
+		case CMD_FLASHSTORE_WRITE:
+			FlashStoreWrite(c->arg[0], c->arg[1], c->arg[2], c->d.asBytes);
+			break;
+		case CMD_FLASHSTORE_READ:
+			FlashStoreRead(c->arg[0], c->arg[1]);
+			break;
+		case CMD_FLASHSTORE_INFO:
+#ifdef WITH_ISO14443a
+			if (c->arg[0] == 4) {
+				MifareChkKeysFromStore();
+				break;
+			}
+#endif
+			FlashStoreInfo(c->arg[0], c->arg[1]);
+			break;
+		case CMD_EXEC_BATCH: {
+			// unpack and dispatch the sub-commands back-to-back; each one
+			// sends its usual responses, the final ACK terminates the batch
+			static UsbCommand sub_cmd;
+			uint8_t *p = c->d.asBytes;
+			uint8_t *end = c->d.asBytes + USB_CMD_DATA_SIZE;
+			uint64_t executed = 0;
+			for (uint64_t i = 0; i < c->arg[0]; i++) {
+				uint16_t sub, sub_len;
+				if (p + 4 + sizeof(sub_cmd.arg) > end) break;
+				memcpy(&sub, p, sizeof(sub));
+				memcpy(&sub_len, p + 2, sizeof(sub_len));
+				if (sub_len > USB_CMD_DATA_SIZE || p + 4 + sizeof(sub_cmd.arg) + sub_len > end) break;
+				if (sub == CMD_EXEC_BATCH) break;	// no nesting
+				sub_cmd.cmd = sub;
+				memcpy(sub_cmd.arg, p + 4, sizeof(sub_cmd.arg));	// records are packed, args may be unaligned
+				memcpy(sub_cmd.d.asBytes, p + 4 + sizeof(sub_cmd.arg), sub_len);
+				UsbPacketReceived((uint8_t *)&sub_cmd, sizeof(UsbCommand));
+				executed++;
+				p += 4 + sizeof(sub_cmd.arg) + sub_len;
+			}
+			cmd_send(CMD_ACK,executed,c->arg[0],0,0,0);
+			break;
+		}
+		case CMD_FRAME_NEGOTIATE:
+			cmd_ng_enable(c->arg[0] != 0);
+			cmd_send(CMD_ACK,USB_CMD_DATA_SIZE_EXT,0,0,0,0);
+			break;
+		case CMD_TAG_POLL_CONFIG:
+#ifdef WITH_ISO14443a
+			tag_poll_period = c->arg[0];
+			tag_poll_last_check = GetTickCount();
+			tag_poll_present = false;
+			tag_poll_ring_head = 0;
+			tag_poll_ring_count = 0;
+			cmd_send(CMD_ACK,1,0,0,0,0);
+#else
+			cmd_send(CMD_ACK,0,0,0,0,0);
+#endif
+			break;
+		case CMD_INTERLEAVED_SCAN:
+#if defined(WITH_ISO14443a) && defined(WITH_LF)
+			InterleavedScan(c->arg[0]);
+#else
+			cmd_send(CMD_ACK,ISCAN_FOUND_NOTHING,0,0,0,0);
+#endif
+			break;
 #ifdef WITH_LCD
 		case CMD_LCD_RESET:
 			LCDReset();
@@ -1552,8 +2065,20 @@ void  __attribute__((noreturn)) AppMain(void)
         UsbPacketReceived(rx,rx_len);
       }
     }
+		DbDrain();
 		WDT_HIT();
 
+#ifdef WITH_ISO14443a
+		TagPollCheck();
+#endif
+		AntennaTelemetryCheck();
+
+		// an uploaded op sequence takes the long button press over the
+		// hardcoded stand-alone flows
+		if (StandAloneSeqLoaded()) {
+			if (BUTTON_HELD(1000) > 0)
+				StandAloneSeqRun();
+		} else {
 #ifdef WITH_LF_StandAlone
 #ifndef WITH_ISO14443a_StandAlone
 		if (BUTTON_HELD(1000) > 0)
@@ -1566,5 +2091,6 @@ void  __attribute__((noreturn)) AppMain(void)
 			StandAloneMode14a();
 #endif
 #endif
+		}
 	}
 }
@@ -32,8 +32,27 @@ void SamyRun(void);
 //void DbpIntegers(int a, int b, int c);
 void DbpString(char *str);
 void Dbprintf(const char *fmt, ...);
+void SendProgressStart(void);
+void SendProgress(uint32_t done, uint32_t total);
 void Dbhexdump(int len, uint8_t *d, bool bAsci);
 
+// Lightweight profiling counters (appmain.c). Wrap a region of interest with
+// PROF_ENTER/PROF_LEAVE and call count, total and worst-case runtime show up
+// in the 'hw status' output. Timebase is the RTT millisecond tick - the only
+// clock that protocol code never reconfigures.
+#define PROF_14A_READER		0
+#define PROF_EPA_NONCE		1
+#define PROF_MF_DARKSIDE	2
+#define PROF_MF_SYNC		3
+// slots 4..7 are free for ad-hoc measurements
+#define PROF_NUM_REGIONS	8
+void ProfEnter(int region);
+void ProfLeave(int region);
+void ProfReset(void);
+void ProfPrint(void);
+#define PROF_ENTER(r)	ProfEnter(r)
+#define PROF_LEAVE(r)	ProfLeave(r)
+
 // ADC Vref = 3300mV, and an (10M+1M):1M voltage divider on the HF input can measure voltages up to 36300 mV
 #define MAX_ADC_HF_VOLTAGE_LOW   36300
 // ADC Vref = 3300mV, and an (10000k+240k):240k voltage divider on the LF input can measure voltages up to 140800 mV
@@ -66,7 +85,9 @@ void CmdHIDsimTAG(int hi2, int hi, int lo, int ledcontrol);
 void CmdFSKsimTAG(uint16_t arg1, uint16_t arg2, size_t size, uint8_t *BitStream);
 void CmdASKsimTag(uint16_t arg1, uint16_t arg2, size_t size, uint8_t *BitStream);
 void CmdPSKsimTag(uint16_t arg1, uint16_t arg2, size_t size, uint8_t *BitStream);
+void CmdLFSynthSim(uint32_t arg0, uint32_t arg1, uint32_t seed, uint8_t *data);
 void CmdHIDdemodFSK(int findone, int *high2, int *high, int *low, int ledcontrol);
+void CmdHIDbeaconFSK(void);
 void CmdAWIDdemodFSK(int findone, int *high, int *low, int ledcontrol); // Realtime demodulation mode for AWID26
 void CmdEM410xdemod(int findone, int *high, int *low, int ledcontrol);
 void CmdIOdemodFSK(int findone, int *high, int *low, int ledcontrol);
@@ -78,8 +99,10 @@ void CopyIndala64toT55x7(uint32_t hi, uint32_t lo); // Clone Indala 64-bit tag b
 void CopyIndala224toT55x7(uint32_t uid1, uint32_t uid2, uint32_t uid3, uint32_t uid4, uint32_t uid5, uint32_t uid6, uint32_t uid7); // Clone Indala 224-bit tag by UID to T55x7
 void T55xxResetRead(void);
 void T55xxWriteBlock(uint32_t Data, uint32_t Block, uint32_t Pwd, uint8_t PwdMode);
+void T55xxWriteBlockBulk(uint8_t arg0, uint8_t num_blocks, uint32_t Pwd, uint8_t *data);
 void T55xxReadBlock(uint16_t arg0, uint8_t Block, uint32_t Pwd);
 void T55xxWakeUp(uint32_t Pwd);
+void T55xxChkPwds(uint8_t arg0, uint32_t num_pwds, uint8_t *pwds);
 void TurnReadLFOn();
 //void T55xxReadTrace(void);
 void EM4xReadWord(uint8_t Address, uint32_t Pwd, uint8_t PwdMode);
@@ -93,6 +116,13 @@ void AcquireRawAdcSamplesIso14443b(uint32_t parameter);
 void ReadSTMemoryIso14443b(uint32_t);
 void RAMFUNC SnoopIso14443b(void);
 void SendRawCommand14443B(uint32_t, uint32_t, uint8_t, uint8_t[]);
+void Iso14443bInventory(UsbCommand *c);
+
+/// standalone_seq.c
+void StandAloneSeqLoad(UsbCommand *c);
+void StandAloneSeqResult(void);
+bool StandAloneSeqLoaded(void);
+void StandAloneSeqRun(void);
 
 // Also used in iclass.c
 void GetParity(const uint8_t *pbtCmd, uint16_t len, uint8_t *parity);
@@ -101,6 +131,7 @@ void RAMFUNC SniffMifare(uint8_t param);
 
 /// epa.h
 void EPA_PACE_Collect_Nonce(UsbCommand * c);
+void EPA_PACE_Collect_Nonce_Batch(UsbCommand *c);
 void EPA_PACE_Replay(UsbCommand *c);
 
 // mifaredesfire.h
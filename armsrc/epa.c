@@ -11,6 +11,7 @@
 // functions, You need to do the setup before calling them!
 //-----------------------------------------------------------------------------
 
+#include "proxmark3.h"
 #include "apps.h"
 #include "iso14443a.h"
 #include "iso14443b.h"
@@ -19,6 +20,7 @@
 #include "fpgaloader.h"
 #include "string.h"
 #include "util.h"
+#include "BigBuf.h"
 
 // Protocol and Parameter Selection Request for ISO 14443 type A cards
 // use regular (1x) speed in both directions
@@ -345,6 +347,126 @@ void EPA_PACE_Collect_Nonce(UsbCommand *c)
 	cmd_send(CMD_ACK,0,func_return,0,nonce,func_return);
 }
 
+//-----------------------------------------------------------------------------
+// Acquire many encrypted PACE nonces in one command. Every cycle runs the
+// full reset-collect sequence (field off, card select, MSE Set AT, GA Get
+// Nonce) autonomously; the EF.CardAccess file is only read and parsed on the
+// first successful cycle since the PACE info does not change across resets.
+// Records of [1 byte nonce length, 0 for a failed cycle][arg[0] nonce bytes]
+// accumulate in BigBuf and stream up whenever a USB frame fills or 2 seconds
+// pass, as CMD_ACK with arg[0] = number of records and arg[2] = 0. A final
+// CMD_ACK with arg[2] = 1 carries the collected/failed cycle totals.
+//
+// arg[0] = requested nonce size, arg[1] = number of cycles,
+// arg[2] = pause between cycles in seconds
+//-----------------------------------------------------------------------------
+void EPA_PACE_Collect_Nonce_Batch(UsbCommand *c)
+{
+#define EPA_BATCH_FLUSH_INTERVAL_MS 2000
+	uint8_t requested_size = (uint8_t)c->arg[0];
+	uint32_t num_cycles = c->arg[1];
+	uint32_t pause_s = c->arg[2];
+	if (requested_size == 0) {
+		requested_size = 1;
+	}
+	// fixed-size records keep the client side unpacking trivial
+	uint16_t record_size = requested_size + 1;
+	uint32_t collected = 0, failed = 0;
+	uint32_t streamed = 0;	// bytes already sent to the client
+	uint32_t written = 0;	// bytes accumulated in BigBuf
+	uint16_t packet_bytes = (USB_CMD_DATA_SIZE / record_size) * record_size;
+	uint32_t last_flush = GetTickCount();
+
+	pace_version_info_t pace_version_info;
+	bool have_pace_info = false;
+
+	if (num_cycles == 0) {
+		num_cycles = 1;
+	}
+
+	BigBuf_free();
+	uint32_t max_cycles = BigBuf_max_traceLen() / record_size;
+	if (num_cycles > max_cycles) {
+		num_cycles = max_cycles;
+	}
+	uint8_t *records = BigBuf_malloc(num_cycles * record_size);
+
+	SendProgressStart();
+
+	for (uint32_t i = 0; i < num_cycles; i++) {
+		if (BUTTON_PRESS()) {
+			break;
+		}
+		WDT_HIT();
+
+		uint8_t nonce[256] = {0};
+		int nonce_length = 0;
+
+		// set up communication - powering the field back up resets the card
+		if (EPA_Setup() == 0) {
+			if (!have_pace_info) {
+				uint8_t card_access[256] = {0};
+				int card_access_length = EPA_Read_CardAccess(card_access, 256);
+				// the response has to be at least this big to hold the OID
+				if (card_access_length >= 18
+				    && EPA_Parse_CardAccess(card_access, card_access_length, &pace_version_info) == 0
+				    && pace_version_info.version != 0) {
+					have_pace_info = true;
+				}
+			}
+			if (have_pace_info) {
+				// use the CAN for the password since that doesn't change
+				EPA_PACE_MSE_Set_AT(pace_version_info, 2);
+				nonce_length = EPA_PACE_Get_Nonce(requested_size, nonce);
+			}
+		}
+
+		// power down the field so the next cycle starts from a card reset
+		EPA_Finish();
+
+		uint8_t *record = records + written;
+		memset(record, 0, record_size);
+		if (nonce_length > 0) {
+			record[0] = nonce_length < requested_size ? nonce_length : requested_size;
+			memcpy(record + 1, nonce, record[0]);
+			collected++;
+		} else {
+			failed++;
+		}
+		written += record_size;
+
+		// stream up whatever is pending once a frame fills or enough time
+		// passed, so the client sees nonces while the run is still going
+		if (written - streamed >= packet_bytes
+		    || (written > streamed && GetTickCount() - last_flush >= EPA_BATCH_FLUSH_INTERVAL_MS)) {
+			uint32_t chunk = written - streamed;
+			if (chunk > packet_bytes) {
+				chunk = packet_bytes;
+			}
+			cmd_send(CMD_ACK, chunk / record_size, 0, 0, records + streamed, chunk);
+			streamed += chunk;
+			last_flush = GetTickCount();
+		}
+
+		SendProgress(i + 1, num_cycles);
+
+		if (pause_s && i < num_cycles - 1) {
+			SpinDelay(pause_s * 1000);
+		}
+	}
+
+	// flush the remainder and report the totals
+	while (streamed < written) {
+		uint32_t chunk = written - streamed;
+		if (chunk > packet_bytes) {
+			chunk = packet_bytes;
+		}
+		cmd_send(CMD_ACK, chunk / record_size, 0, 0, records + streamed, chunk);
+		streamed += chunk;
+	}
+	cmd_send(CMD_ACK, collected, failed, 1, 0, 0);
+}
+
 //-----------------------------------------------------------------------------
 // Performs the "Get Nonce" step of the PACE protocol and saves the returned
 // nonce. The caller is responsible for allocating enough memory to store the
@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Compact field-event journal. Protocol code drops fixed-size timestamped
+// records here instead of Dbprintf'ing them, so a failed emulation or reader
+// session leaves a complete, ordered trail that the client downloads in one
+// go afterwards. A record is a handful of stores - cheap enough to stay
+// enabled inside the emulation loops it is meant to observe.
+//-----------------------------------------------------------------------------
+
+#include "apps.h"
+#include "util.h"
+#include "string.h"
+#include "cmd.h"
+#include "eventjournal.h"
+
+// 128 records x 12 bytes; the journal is circular, the seq field in each
+// entry tells the client when it wrapped
+#define EVT_JOURNAL_ENTRIES		128
+
+static event_journal_entry_t evt_journal[EVT_JOURNAL_ENTRIES];
+
+// total records ever written; head slot is evt_count % EVT_JOURNAL_ENTRIES.
+// Single writer context per event site (the protocol loops all run in the
+// main command context), so a plain counter is sufficient.
+static uint32_t evt_count = 0;
+
+void EventJournalReset(void)
+{
+	evt_count = 0;
+}
+
+void EventJournalLog(uint16_t id, uint32_t arg)
+{
+	event_journal_entry_t *e = &evt_journal[evt_count % EVT_JOURNAL_ENTRIES];
+	e->ts = GetCountSspClk();
+	e->arg = arg;
+	e->id = id;
+	e->seq = (uint16_t)evt_count;
+	evt_count++;
+}
+
+// download the journal, oldest record first, as chunked CMD_ACK frames
+// (arg[0] = first entry index, arg[1] = entries in frame, arg[2] = total);
+// a final frame with arg[1] = 0 terminates the transfer
+void EventJournalSend(bool clear)
+{
+	uint8_t frame[USB_CMD_DATA_SIZE];
+	uint16_t per_frame = USB_CMD_DATA_SIZE / sizeof(event_journal_entry_t);
+	uint16_t total = (evt_count > EVT_JOURNAL_ENTRIES) ? EVT_JOURNAL_ENTRIES : evt_count;
+	uint32_t oldest = (evt_count > EVT_JOURNAL_ENTRIES) ? evt_count - EVT_JOURNAL_ENTRIES : 0;
+
+	for (uint16_t sent = 0; sent < total; ) {
+		uint16_t n = total - sent;
+		if (n > per_frame) n = per_frame;
+		for (uint16_t k = 0; k < n; k++) {
+			memcpy(frame + k * sizeof(event_journal_entry_t),
+					&evt_journal[(oldest + sent + k) % EVT_JOURNAL_ENTRIES],
+					sizeof(event_journal_entry_t));
+		}
+		cmd_send(CMD_ACK, sent, n, total, frame, n * sizeof(event_journal_entry_t));
+		sent += n;
+	}
+	cmd_send(CMD_ACK, total, 0, total, 0, 0);
+
+	if (clear) {
+		EventJournalReset();
+	}
+}
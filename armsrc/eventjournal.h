@@ -0,0 +1,21 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Compact field-event journal, see eventjournal.c. Event IDs and the record
+// layout are shared with the client through usb_cmd.h.
+//-----------------------------------------------------------------------------
+
+#ifndef __EVENTJOURNAL_H
+#define __EVENTJOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usb_cmd.h"
+
+void EventJournalReset(void);
+void EventJournalLog(uint16_t id, uint32_t arg);
+void EventJournalSend(bool clear);
+
+#endif
@@ -0,0 +1,359 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Persistent key-value store in the last 16kB of on-chip flash.
+//
+// The linker reserves the flashstore region beyond _flash_end, so the
+// flasher never writes it and stored values survive firmware updates.
+// Values are kept as an append-only log of page-aligned records; a later
+// record with the same id supersedes earlier ones, and when the region
+// fills up the live records are compacted back to the front through a
+// BigBuf staging copy. Appending rotates through the whole region before
+// any page is rewritten, which spreads the wear without a mapping table.
+//
+// Programming a page stalls all flash reads, so the low-level write runs
+// from RAM with interrupts masked (the handlers execute from flash).
+// Writes are not power-fail atomic: pulling the plug mid-put can leave a
+// truncated record, but never corrupts earlier ones.
+//-----------------------------------------------------------------------------
+
+#include "flashstore.h"
+
+#include "proxmark3.h"
+#include "apps.h"
+#include "string.h"
+#include "util.h"
+#include "BigBuf.h"
+
+// reserved region, see common/ldscript.common
+extern uint8_t _flashstore_start, _flashstore_end;
+
+#define FS_BASE			((uint8_t *)&_flashstore_start)
+#define FS_SIZE			((uint32_t)(&_flashstore_end - &_flashstore_start))
+#define FS_PAGES		(FS_SIZE / AT91C_IFLASH_PAGE_SIZE)
+
+#define FLASHSTORE_MAGIC	0x464c4b31
+
+typedef struct {
+	uint32_t magic;
+	uint8_t id;
+	uint8_t unused;		// left erased (0xff)
+	uint16_t len;		// value length in bytes, 0 = deleted
+} flashstore_rec_t;
+
+// pages a record of 'len' value bytes occupies
+#define FS_REC_PAGES(len)	((sizeof(flashstore_rec_t) + (len) + AT91C_IFLASH_PAGE_SIZE - 1) / AT91C_IFLASH_PAGE_SIZE)
+
+static const flashstore_rec_t *flashstore_rec_at(uint32_t page)
+{
+	return (const flashstore_rec_t *)(FS_BASE + page * AT91C_IFLASH_PAGE_SIZE);
+}
+
+static bool flashstore_rec_valid(const flashstore_rec_t *rec)
+{
+	return rec->magic == FLASHSTORE_MAGIC && rec->len <= FS_SIZE - sizeof(flashstore_rec_t);
+}
+
+// first page of the free area (i.e. the log tail)
+static uint32_t flashstore_tail(void)
+{
+	uint32_t page = 0;
+	while (page < FS_PAGES) {
+		const flashstore_rec_t *rec = flashstore_rec_at(page);
+		if (!flashstore_rec_valid(rec))
+			break;
+		page += FS_REC_PAGES(rec->len);
+	}
+	return page < FS_PAGES ? page : FS_PAGES;
+}
+
+// latest record for an id, including deletion markers. NULL if never written
+static const flashstore_rec_t *flashstore_latest(uint8_t id)
+{
+	const flashstore_rec_t *found = NULL;
+	uint32_t page = 0;
+	while (page < FS_PAGES) {
+		const flashstore_rec_t *rec = flashstore_rec_at(page);
+		if (!flashstore_rec_valid(rec))
+			break;
+		if (rec->id == id)
+			found = rec;
+		page += FS_REC_PAGES(rec->len);
+	}
+	return found;
+}
+
+// Copy a page into the write latch and program it. Flash is unreadable
+// while the command runs, hence RAMFUNC + masked interrupts. A locked
+// sector is unlocked and the write retried once. Returns the final FSR.
+static uint32_t RAMFUNC flashstore_program_page(uint32_t *dst, const uint32_t *src)
+{
+	uint32_t imr = AT91C_BASE_AIC->AIC_IMR;
+	AT91C_BASE_AIC->AIC_IDCR = imr;
+
+	uint32_t page_n = ((uint32_t)dst - AT91C_IFLASH) / AT91C_IFLASH_PAGE_SIZE;
+	uint32_t sr;
+
+	for (uint32_t i = 0; i < AT91C_IFLASH_PAGE_SIZE / 4; i++)
+		dst[i] = src[i];
+	AT91C_BASE_EFC0->EFC_FCR = MC_FLASH_COMMAND_KEY | MC_FLASH_COMMAND_PAGEN(page_n) | AT91C_MC_FCMD_START_PROG;
+	while (!((sr = AT91C_BASE_EFC0->EFC_FSR) & AT91C_MC_FRDY));
+
+	if (sr & AT91C_MC_LOCKE) {
+		AT91C_BASE_EFC0->EFC_FCR = MC_FLASH_COMMAND_KEY | MC_FLASH_COMMAND_PAGEN(page_n) | AT91C_MC_FCMD_UNLOCK;
+		while (!(AT91C_BASE_EFC0->EFC_FSR & AT91C_MC_FRDY));
+
+		for (uint32_t i = 0; i < AT91C_IFLASH_PAGE_SIZE / 4; i++)
+			dst[i] = src[i];
+		AT91C_BASE_EFC0->EFC_FCR = MC_FLASH_COMMAND_KEY | MC_FLASH_COMMAND_PAGEN(page_n) | AT91C_MC_FCMD_START_PROG;
+		while (!((sr = AT91C_BASE_EFC0->EFC_FSR) & AT91C_MC_FRDY));
+	}
+
+	AT91C_BASE_AIC->AIC_IECR = imr;
+	return sr;
+}
+
+// make sure the page at 'page' does not parse as a record, so the log
+// scan stops there (stale data may be left behind by compaction)
+static int flashstore_terminate(uint32_t page)
+{
+	if (page >= FS_PAGES)
+		return 0;
+	if (!flashstore_rec_valid(flashstore_rec_at(page)))
+		return 0;
+
+	uint32_t pagebuf[AT91C_IFLASH_PAGE_SIZE / 4];
+	memset(pagebuf, 0xff, sizeof(pagebuf));
+	uint32_t sr = flashstore_program_page((uint32_t *)(FS_BASE + page * AT91C_IFLASH_PAGE_SIZE), pagebuf);
+	return (sr & (AT91C_MC_LOCKE | AT91C_MC_PROGE)) ? -2 : 0;
+}
+
+// append one record at 'tail'. The caller has checked that it fits
+static int flashstore_append(uint32_t tail, uint8_t id, const uint8_t *data, uint16_t len)
+{
+	uint32_t need = FS_REC_PAGES(len);
+	uint32_t pagebuf[AT91C_IFLASH_PAGE_SIZE / 4];
+	uint32_t done = 0;
+
+	// keep the scan-stop invariant before the new record becomes visible
+	int res = flashstore_terminate(tail + need);
+	if (res)
+		return res;
+
+	for (uint32_t p = 0; p < need; p++) {
+		memset(pagebuf, 0xff, sizeof(pagebuf));
+		uint8_t *body = (uint8_t *)pagebuf;
+		uint32_t space = AT91C_IFLASH_PAGE_SIZE;
+		if (p == 0) {
+			flashstore_rec_t *rec = (flashstore_rec_t *)pagebuf;
+			rec->magic = FLASHSTORE_MAGIC;
+			rec->id = id;
+			rec->len = len;
+			body += sizeof(*rec);
+			space -= sizeof(*rec);
+		}
+		uint32_t n = MIN(len - done, space);
+		memcpy(body, data + done, n);
+		done += n;
+
+		uint32_t sr = flashstore_program_page((uint32_t *)(FS_BASE + (tail + p) * AT91C_IFLASH_PAGE_SIZE), pagebuf);
+		if (sr & (AT91C_MC_LOCKE | AT91C_MC_PROGE))
+			return -2;
+	}
+	return 0;
+}
+
+// rewrite the log with only the latest live record of every id
+static int flashstore_compact(void)
+{
+	uint8_t *stage = BigBuf_malloc(FS_SIZE);
+	if (stage == NULL)
+		return -3;
+
+	memset(stage, 0xff, FS_SIZE);
+
+	// gather live records, already laid out as the new log
+	uint32_t out = 0;
+	uint32_t page = 0;
+	while (page < FS_PAGES) {
+		const flashstore_rec_t *rec = flashstore_rec_at(page);
+		if (!flashstore_rec_valid(rec))
+			break;
+		if (rec->len > 0 && flashstore_latest(rec->id) == rec) {
+			memcpy(stage + out, rec, sizeof(*rec) + rec->len);
+			out += FS_REC_PAGES(rec->len) * AT91C_IFLASH_PAGE_SIZE;
+		}
+		page += FS_REC_PAGES(rec->len);
+	}
+
+	int res = 0;
+	for (uint32_t p = 0; p < out / AT91C_IFLASH_PAGE_SIZE; p++) {
+		uint32_t sr = flashstore_program_page((uint32_t *)(FS_BASE + p * AT91C_IFLASH_PAGE_SIZE),
+				(uint32_t *)(stage + p * AT91C_IFLASH_PAGE_SIZE));
+		if (sr & (AT91C_MC_LOCKE | AT91C_MC_PROGE)) {
+			res = -2;
+			break;
+		}
+	}
+	if (res == 0)
+		res = flashstore_terminate(out / AT91C_IFLASH_PAGE_SIZE);
+
+	BigBuf_release(stage);
+	return res;
+}
+
+// store a value. 0 = ok, -1 = store full, -2 = flash error, -3 = no staging memory
+int flashstore_put(uint8_t id, const uint8_t *data, uint16_t len)
+{
+	uint32_t need = FS_REC_PAGES(len);
+	uint32_t tail = flashstore_tail();
+
+	if (tail + need > FS_PAGES) {
+		int res = flashstore_compact();
+		if (res)
+			return res;
+		tail = flashstore_tail();
+		if (tail + need > FS_PAGES)
+			return -1;
+	}
+
+	return flashstore_append(tail, id, data, len);
+}
+
+// pointer to the latest value of an id (flash is memory mapped), NULL if absent
+const uint8_t *flashstore_find(uint8_t id, uint16_t *len)
+{
+	const flashstore_rec_t *rec = flashstore_latest(id);
+	if (rec == NULL || rec->len == 0)
+		return NULL;
+	if (len)
+		*len = rec->len;
+	return (const uint8_t *)(rec + 1);
+}
+
+int flashstore_delete(uint8_t id)
+{
+	if (flashstore_find(id, NULL) == NULL)
+		return 0;
+	return flashstore_put(id, NULL, 0);
+}
+
+void flashstore_status(void)
+{
+	uint32_t tail = flashstore_tail();
+	Dbprintf("Flash store at 0x%08x: %d/%d pages used", (uint32_t)FS_BASE, tail, FS_PAGES);
+
+	uint32_t page = 0;
+	while (page < FS_PAGES) {
+		const flashstore_rec_t *rec = flashstore_rec_at(page);
+		if (!flashstore_rec_valid(rec))
+			break;
+		if (rec->len > 0 && flashstore_latest(rec->id) == rec)
+			Dbprintf("  id %3d: %4d bytes", rec->id, rec->len);
+		page += FS_REC_PAGES(rec->len);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// USB command handlers. Values can exceed USB_CMD_DATA_SIZE, so writes are
+// staged in BigBuf chunk by chunk (like MifareEMemLoad) and committed to
+// flash with the final chunk; reads hand out windows of the mapped value.
+//-----------------------------------------------------------------------------
+
+static uint8_t *fs_stage = NULL;
+static uint16_t fs_stage_total = 0;
+
+// arg0 = id, arg1 = chunk offset, arg2 = total length << 16 | chunk length
+void FlashStoreWrite(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain)
+{
+	uint8_t id = arg0 & 0xff;
+	uint32_t offset = arg1;
+	uint16_t total = arg2 >> 16;
+	uint16_t chunk = arg2 & 0xffff;
+
+	if (offset == 0) {
+		if (fs_stage != NULL) {
+			BigBuf_release(fs_stage);
+			fs_stage = NULL;
+		}
+		if (total == 0 || FS_REC_PAGES(total) > FS_PAGES) {
+			cmd_send(CMD_ACK, 0, 0, 0, 0, 0);
+			return;
+		}
+		fs_stage = BigBuf_malloc(total);
+		if (fs_stage == NULL) {
+			Dbprintf("FlashStoreWrite: no room to stage %d bytes", total);
+			cmd_send(CMD_ACK, 0, 0, 0, 0, 0);
+			return;
+		}
+		fs_stage_total = total;
+	}
+
+	if (fs_stage == NULL || chunk > USB_CMD_DATA_SIZE || total != fs_stage_total
+			|| offset + chunk > fs_stage_total) {
+		cmd_send(CMD_ACK, 0, 0, 0, 0, 0);
+		return;
+	}
+
+	memcpy(fs_stage + offset, datain, chunk);
+
+	if (offset + chunk < fs_stage_total) {	// intermediate chunk
+		cmd_send(CMD_ACK, 1, offset + chunk, 0, 0, 0);
+		return;
+	}
+
+	int res = flashstore_put(id, fs_stage, fs_stage_total);
+	BigBuf_release(fs_stage);
+	fs_stage = NULL;
+	cmd_send(CMD_ACK, res == 0, -res, 0, 0, 0);
+}
+
+// arg0 = id, arg1 = offset; response arg1 = total length, data = chunk
+void FlashStoreRead(uint32_t id, uint32_t offset)
+{
+	uint16_t len = 0;
+	const uint8_t *val = flashstore_find(id & 0xff, &len);
+
+	if (val == NULL || offset >= len) {
+		cmd_send(CMD_ACK, 0, 0, 0, 0, 0);
+		return;
+	}
+	uint32_t chunk = MIN(len - offset, USB_CMD_DATA_SIZE);
+	cmd_send(CMD_ACK, 1, len, offset, (uint8_t *)val + offset, chunk);
+}
+
+// op 0 = status, 1 = delete id, 2 = save emulator memory into the store,
+// 3 = load emulator memory from the store (op 4, loading the mifare key
+// cache, lives in mifarecmd.c next to the cache it fills)
+void FlashStoreInfo(uint32_t op, uint32_t id)
+{
+	int res = 0;
+	uint16_t len = 0;
+	const uint8_t *val;
+
+	switch (op) {
+		case 0:
+			flashstore_status();
+			break;
+		case 1:
+			res = flashstore_delete(id & 0xff);
+			break;
+		case 2:
+			res = flashstore_put(FLASHSTORE_ID_EMIMAGE, BigBuf_get_EM_addr(), CARD_MEMORY_SIZE);
+			break;
+		case 3:
+			val = flashstore_find(FLASHSTORE_ID_EMIMAGE, &len);
+			if (val == NULL) {
+				res = -4;
+				break;
+			}
+			memcpy(BigBuf_get_EM_addr(), val, MIN(len, CARD_MEMORY_SIZE));
+			break;
+		default:
+			res = -5;
+			break;
+	}
+	cmd_send(CMD_ACK, res == 0, -res, 0, 0, 0);
+}
@@ -0,0 +1,24 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Persistent key-value store in the last 16kB of on-chip flash
+//-----------------------------------------------------------------------------
+
+#ifndef __FLASHSTORE_H
+#define __FLASHSTORE_H
+
+#include <stdint.h>
+
+extern int flashstore_put(uint8_t id, const uint8_t *data, uint16_t len);
+extern const uint8_t *flashstore_find(uint8_t id, uint16_t *len);
+extern int flashstore_delete(uint8_t id);
+extern void flashstore_status(void);
+
+// USB command handlers
+extern void FlashStoreWrite(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
+extern void FlashStoreRead(uint32_t id, uint32_t offset);
+extern void FlashStoreInfo(uint32_t op, uint32_t id);
+
+#endif
@@ -26,11 +26,22 @@
 // remember which version of the bitstream we have already downloaded to the FPGA
 static int downloaded_bitstream = 0;
 
+// last values written to the FPGA, so that callers can skip redundant
+// reconfiguration (and in particular the antenna settling delay after it).
+// 0xffff = unknown, e.g. after a new bitstream was loaded.
+static uint16_t fpga_conf_word = 0xffff;
+static uint16_t fpga_lf_divisor = 0xffff;
+
 // this is where the bitstreams are located in memory:
 extern uint8_t _binary_obj_fpga_all_bit_z_start, _binary_obj_fpga_all_bit_z_end;
 
 static uint8_t *fpga_image_ptr = NULL;
-static uint32_t uncompressed_bytes_cnt;
+
+// position within the interleaved combined stream, tracked incrementally.
+// The ARM7TDMI has no divide instruction, so computing the owning bitstream
+// of each byte with / and % would add a software division per config byte.
+static uint32_t interleave_chunk_remaining = 0;
+static int interleave_chunk_owner = 0;		// 1-based bitstream version the current chunk belongs to
 
 #define OUTPUT_BUFFER_LEN 		80
 
@@ -190,8 +201,6 @@ static int get_from_fpga_combined_stream(z_streamp compressed_fpga_stream, uint8
 			return res;
 	}
 
-	uncompressed_bytes_cnt++;
-	
 	return *fpga_image_ptr++;
 }
 
@@ -202,13 +211,18 @@ static int get_from_fpga_combined_stream(z_streamp compressed_fpga_stream, uint8
 //----------------------------------------------------------------------------
 static int get_from_fpga_stream(int bitstream_version, z_streamp compressed_fpga_stream, uint8_t *output_buffer)
 {
-	while((uncompressed_bytes_cnt / FPGA_INTERLEAVE_SIZE) % fpga_bitstream_num != (bitstream_version - 1)) {
+	for (;;) {
+		if (interleave_chunk_remaining == 0) {
+			interleave_chunk_remaining = FPGA_INTERLEAVE_SIZE;
+			interleave_chunk_owner = interleave_chunk_owner % fpga_bitstream_num + 1;
+		}
+		interleave_chunk_remaining--;
+		int b = get_from_fpga_combined_stream(compressed_fpga_stream, output_buffer);
 		// skip undesired data belonging to other bitstream_versions
-		get_from_fpga_combined_stream(compressed_fpga_stream, output_buffer);
+		if (interleave_chunk_owner == bitstream_version || b < 0) {
+			return b;
+		}
 	}
-
-	return get_from_fpga_combined_stream(compressed_fpga_stream, output_buffer);
-	
 }
 
 
@@ -230,9 +244,10 @@ static void fpga_inflate_free(voidpf opaque, voidpf address)
 static bool reset_fpga_stream(int bitstream_version, z_streamp compressed_fpga_stream, uint8_t *output_buffer)
 {
 	uint8_t header[FPGA_BITSTREAM_FIXED_HEADER_SIZE];
-	
-	uncompressed_bytes_cnt = 0;
-	
+
+	interleave_chunk_remaining = 0;
+	interleave_chunk_owner = 0;
+
 	// initialize z_stream structure for inflate:
 	compressed_fpga_stream->next_in = &_binary_obj_fpga_all_bit_z_start;
 	compressed_fpga_stream->avail_in = &_binary_obj_fpga_all_bit_z_end - &_binary_obj_fpga_all_bit_z_start;
@@ -281,9 +296,12 @@ static void DownloadFPGA(int bitstream_version, int FpgaImageLen, z_streamp comp
 
 	AT91C_BASE_PIOA->PIO_OER = GPIO_FPGA_ON;
 	AT91C_BASE_PIOA->PIO_PER = GPIO_FPGA_ON;
-	HIGH(GPIO_FPGA_ON);		// ensure everything is powered on
-
-	SpinDelay(50);
+	// power everything up. The 50ms settling time is only needed when the FPGA
+	// was actually off - power stays on between bitstream switches.
+	if (!(AT91C_BASE_PIOA->PIO_ODSR & GPIO_FPGA_ON)) {
+		HIGH(GPIO_FPGA_ON);
+		SpinDelay(50);
+	}
 
 	LED_D_ON();
 
@@ -416,7 +434,9 @@ void FpgaDownloadAndGo(int bitstream_version)
 	z_stream compressed_fpga_stream;
 	uint8_t output_buffer[OUTPUT_BUFFER_LEN] = {0x00};
 	
-	// check whether or not the bitstream is already loaded
+	// check whether or not the bitstream is already loaded. This is the only
+	// cache we can afford: a decompressed image (42k) doesn't even fit into
+	// BigBuf, let alone keeping both images resident in 64k of total RAM.
 	if (downloaded_bitstream == bitstream_version) {
 		FpgaEnableTracing();
 		return;
@@ -433,6 +453,8 @@ void FpgaDownloadAndGo(int bitstream_version)
 	if (bitparse_find_section(bitstream_version, 'e', &bitstream_length, &compressed_fpga_stream, output_buffer)) {
 		DownloadFPGA(bitstream_version, bitstream_length, &compressed_fpga_stream, output_buffer);
 		downloaded_bitstream = bitstream_version;
+		fpga_conf_word = 0xffff;	// fresh image, configuration is unknown
+		fpga_lf_divisor = 0xffff;
 	}
 
 	inflateEnd(&compressed_fpga_stream);
@@ -455,6 +477,21 @@ void FpgaSendCommand(uint16_t cmd, uint16_t v)
 	SetupSpi(SPI_FPGA_MODE);
 	while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_TXEMPTY) == 0);		// wait for the transfer to complete
 	AT91C_BASE_SPI->SPI_TDR = AT91C_SPI_LASTXFER | cmd | v;		// send the data
+	if (cmd == FPGA_CMD_SET_CONFREG) {
+		fpga_conf_word = v;
+	} else if (cmd == FPGA_CMD_SET_DIVISOR) {
+		fpga_lf_divisor = v;
+	}
+}
+
+uint16_t FpgaGetConfWord(void)
+{
+	return fpga_conf_word;
+}
+
+uint16_t FpgaGetLFDivisor(void)
+{
+	return fpga_lf_divisor;
 }
 
 //-----------------------------------------------------------------------------
@@ -18,6 +18,8 @@
 
 void FpgaSendCommand(uint16_t cmd, uint16_t v);
 void FpgaWriteConfWord(uint16_t v);
+uint16_t FpgaGetConfWord(void);
+uint16_t FpgaGetLFDivisor(void);
 void FpgaDownloadAndGo(int bitstream_version);
 void FpgaSetupSsc(uint8_t mode);
 void SetupSpi(int mode);
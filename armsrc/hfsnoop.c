@@ -18,32 +18,91 @@
 #include "fpga.h"
 #include "fpgaloader.h"
 
-static void RAMFUNC optimizedSnoop(void)
-{
-	int n = BigBuf_max_traceLen() / sizeof(uint16_t); // take all memory
+// raw bytes kept from before the trigger point (power of two, ring buffer
+// at the start of BigBuf). The client receives the ring head offset and
+// linearizes the ring itself - rotating it here would lose samples between
+// the trigger and the start of the main capture.
+#define HFSNOOP_PRETRIG_BYTES	4096
+
+// compressed stream tokens. The stream opens with one absolute sample, then
+// every token is either a non-zero signed delta to the previous sample, a
+// run (the previous sample repeated <count> times) or an escaped absolute
+// sample for deltas a signed byte can't carry.
+#define HFSNOOP_TOK_RUN			0x00	// followed by a repeat count
+#define HFSNOOP_TOK_LIT			0x80	// followed by an absolute sample
 
-	uint16_t *dest = (uint16_t *)BigBuf_get_addr();
-	uint16_t *destend = dest + n;
+// read sample pairs from the SSC and commit them delta/RLE compressed, until
+// the output region is full or the button ends the capture. Returns the
+// number of compressed bytes; *decoded receives the raw sample count.
+static int RAMFUNC optimizedSnoopCompressed(uint8_t *out, int maxlen, uint32_t *decoded)
+{
+	uint8_t *p = out;
+	uint8_t *end = out + maxlen - 4;	// worst case one word costs 4 bytes
+	uint8_t prev = 0;
+	uint32_t run = 0;
+	uint32_t in = 0;
 
 	AT91C_BASE_SSC->SSC_RFMR = SSC_FRAME_MODE_BITS_IN_WORD(16); // Setting Frame mode, 16 bits per word
 	// Reading data loop
-	while(dest <= destend)
-	{
-		if(AT91C_BASE_SSC->SSC_SR & AT91C_SSC_RXRDY)
-		{
-			*dest = (uint16_t)(AT91C_BASE_SSC->SSC_RHR);
-			dest++;
+	while (p < end) {
+		if (!(AT91C_BASE_SSC->SSC_SR & AT91C_SSC_RXRDY))
+			continue;
+		uint16_t w = (uint16_t)(AT91C_BASE_SSC->SSC_RHR);
+		uint8_t b = w & 0xff;
+		for (int half = 0; half < 2; half++, b = w >> 8) {
+			if (in == 0) {			// seed the stream with an absolute sample
+				prev = b;
+				*p++ = b;
+			} else if (b == prev) {
+				if (++run == 255) {
+					*p++ = HFSNOOP_TOK_RUN;
+					*p++ = 255;
+					run = 0;
+				}
+			} else {
+				if (run) {
+					*p++ = HFSNOOP_TOK_RUN;
+					*p++ = run;
+					run = 0;
+				}
+				int16_t d = (int16_t)b - (int16_t)prev;
+				if (d >= -127 && d <= 127) {	// never 0x00 or 0x80
+					*p++ = (uint8_t)d;
+				} else {
+					*p++ = HFSNOOP_TOK_LIT;
+					*p++ = b;
+				}
+				prev = b;
+			}
+			in++;
 		}
+		// a quiet field compresses so well that the capture can run for a
+		// long time - let the button end it
+		if ((in & 0x7ff) == 0) {
+			WDT_HIT();
+			if (BUTTON_PRESS())
+				break;
+		}
+	}
+	if (run) {
+		*p++ = HFSNOOP_TOK_RUN;
+		*p++ = run;
 	}
 	//Resetting Frame mode (First set in fpgaloader.c)
 	AT91C_BASE_SSC->SSC_RFMR = SSC_FRAME_MODE_BITS_IN_WORD(8) | AT91C_SSC_MSBF | SSC_FRAME_MODE_WORDS_PER_TRANSFER(0);
+
+	*decoded = in;
+	return p - out;
 }
 
-void HfSnoop(int samplesToSkip, int triggersToSkip)
+void HfSnoop(int samplesToSkip, int triggersToSkip, int triggerThreshold)
 {
 	BigBuf_free(); BigBuf_Clear();
-	
-	Dbprintf("Skipping first %d sample pairs, Skipping %d triggers.\n", samplesToSkip, triggersToSkip);
+
+	if (triggerThreshold <= 0 || triggerThreshold > 255)
+		triggerThreshold = 240;
+
+	Dbprintf("Skipping first %d sample pairs, skipping %d triggers, trigger threshold %d.\n", samplesToSkip, triggersToSkip, triggerThreshold);
 	int trigger_cnt;
 	LED_D_ON();
 	// Select correct configs
@@ -57,33 +116,47 @@ void HfSnoop(int samplesToSkip, int triggersToSkip)
 
 	AT91C_BASE_SSC->SSC_RFMR = SSC_FRAME_MODE_BITS_IN_WORD(16); // Setting Frame Mode For better performance on high speed data transfer.
 
+	// while waiting for the trigger, keep the most recent samples in a ring
+	// at the start of BigBuf so the capture includes the reader's lead-in
+	uint8_t *ring = BigBuf_get_addr();
+	uint32_t ring_head = 0;
+
 	trigger_cnt = 0;
 	uint16_t r = 0;
 	while(!BUTTON_PRESS() && !usb_poll_validate_length()) {
 		WDT_HIT();
 		if(AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
 			r = (uint16_t)AT91C_BASE_SSC->SSC_RHR;
-			r = MAX(r & 0xff, r >> 8); 
-			if (r >= 240) {
+			ring[ring_head] = r & 0xff;
+			ring[ring_head + 1] = r >> 8;
+			ring_head = (ring_head + 2) & (HFSNOOP_PRETRIG_BYTES - 1);
+			r = MAX(r & 0xff, r >> 8);
+			if (r >= triggerThreshold) {
 				if (++trigger_cnt > triggersToSkip)
 					break;
-			} 
+			}
 		}
 	}
 
+	int compressed = 0;
+	uint32_t decoded = 0;
 	if(!BUTTON_PRESS()) {
 		int waitcount = samplesToSkip; // lets wait 40000 ticks of pck0
 		while(waitcount != 0) {
 			if(AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY))
 				waitcount--;
 		}
-		optimizedSnoop();
-		Dbprintf("Trigger kicked! Value: %d, Dumping Samples Hispeed now.", r);
+		compressed = optimizedSnoopCompressed(ring + HFSNOOP_PRETRIG_BYTES,
+				BigBuf_max_traceLen() - HFSNOOP_PRETRIG_BYTES, &decoded);
+		Dbprintf("Trigger kicked! Value: %d, %u samples in %d compressed bytes.", r, decoded, compressed);
 	}
 
 	DbpString("HF Snoop end");
 	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
 	LED_D_OFF();
+
+	// ring layout and head for the client, which rotates and decompresses
+	cmd_send(CMD_ACK, ((uint32_t)HFSNOOP_PRETRIG_BYTES << 16) | ring_head, compressed, decoded, 0, 0);
 }
 
 void HfPlot(void)
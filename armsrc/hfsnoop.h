@@ -11,7 +11,7 @@
 #ifndef HFSNOOP_H__
 #define HFSNOOP_H__
 
-void HfSnoop(int samplesToSkip, int triggersToSkip);
+void HfSnoop(int samplesToSkip, int triggersToSkip, int triggerThreshold);
 void HfPlot(void);
 
 #endif
@@ -1841,6 +1841,15 @@ void ReadHitagSintern(hitag_function htf, hitag_data* htd, stype tagMode, int st
 		// Disable timer 1 with external trigger to avoid triggers during our own modulation
 		AT91C_BASE_TC1->TC_CCR = AT91C_TC_CLKDIS;
 
+		// Once the tag is selected, consecutive read commands only need the
+		// short inter-frame gap (as the hitag2 reader uses); the conservative
+		// wait is kept for the anti-collision and authentication frames.
+		if (tag.pstate == SELECTED) {
+			t_wait = HITAG_T_WAIT_2;
+		} else {
+			t_wait = 200;
+		}
+
 		// Wait for HITAG_T_WAIT_2 carrier periods after the last tag bit before transmitting,
 		// Since the clock counts since the last falling edge, a 'one' means that the
 		// falling edge occured halfway the period. with respect to this falling edge,
@@ -1872,7 +1881,16 @@ void ReadHitagSintern(hitag_function htf, hitag_data* htd, stype tagMode, int st
 	AT91C_BASE_TC1->TC_CCR = AT91C_TC_CLKDIS;
 	AT91C_BASE_TC0->TC_CCR = AT91C_TC_CLKDIS;
 	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-	cmd_send(CMD_ACK, bSuccessful, 0, 0, 0, 0);
+	// Stream the dumped pages back to the client; 64 pages of 4 bytes fit
+	// comfortably in a single USB response
+	int num_pages = 0;
+	if (bSuccessful && sendNum > startPage) {
+		num_pages = sendNum - startPage;
+		if (startPage + num_pages > 64) {
+			num_pages = 64 - startPage;
+		}
+	}
+	cmd_send(CMD_ACK, bSuccessful, startPage, num_pages, (byte_t*)tag.pages[startPage], num_pages * 4);
 }
 
 void ReadHitagSCmd(hitag_function htf, hitag_data* htd, uint64_t startPage, uint64_t tagMode, bool readBlock) {
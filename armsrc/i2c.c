@@ -40,7 +40,7 @@
 
 static volatile unsigned long c;
 
-//	ֱ��ʹ��ѭ������ʱ��һ��ѭ�� 6 ��ָ�48M�� Delay=1 ���Ϊ 200kbps
+//	ֱ��ʹ��ѭ������ʱ��һ��ѭ�� 6 ��ָ�48M�� Delay=1 ���Ϊ 200kbps
 // timer.
 // I2CSpinDelayClk(4) = 12.31us
 // I2CSpinDelayClk(1) = 3.07us
@@ -166,6 +166,18 @@ bool WaitSCL_L(void) {
 	return WaitSCL_L_delay(15000);
 }
 
+// Clock-edge polls used inside the byte loops. The pin is sampled
+// back-to-back for a short burst first - a slave rarely stretches the
+// clock mid-byte - and only then do we fall back to the delay-stepped
+// wait, which covers genuine clock stretching. Shaves the fixed 3us
+// poll granularity off every bit of a burst transfer.
+static bool WaitSCL_H_fast(void) {
+	for (volatile uint16_t i = 64; i; i--) {
+		if (SCL_read) return true;
+	}
+	return WaitSCL_H();
+}
+
 static bool I2C_Start(void) {
 
 	I2C_DELAY_XCLK(4);
@@ -226,7 +238,7 @@ static void I2C_SendByte(uint8_t data) {
 		I2C_DELAY_1CLK;
 
 		SCL_H;
-		if (!WaitSCL_H())
+		if (!WaitSCL_H_fast())
 			return;
 
 		I2C_DELAY_2CLK;
@@ -249,7 +261,7 @@ bool I2C_is_available(void) {
 
 #ifdef WITH_SMARTCARD
 // Reset the SIM_Adapter, then enter the bootloader program
-// Reserve��For firmware update.
+// Reserve��For firmware update.
 static void I2C_Reset_EnterBootloader(void) {
 	I2C_SetResetStatus(0, 1, 1);
 	WaitMS(100);
@@ -304,19 +316,26 @@ static void I2C_NoAck(void) {
 	SCL_L; I2C_DELAY_2CLK;
 }
 
+static bool WaitSCL_L_fast(void) {
+	for (volatile uint16_t i = 64; i; i--) {
+		if (!SCL_read) return true;
+	}
+	return WaitSCL_L();
+}
+
 static int16_t I2C_ReadByte(void) {
 	uint8_t bits = 8, b = 0;
 
 	SDA_H;
 	while (bits--) {
 		b <<= 1;
-		SCL_L; 
-		if (!WaitSCL_L()) return -2;
-		
+		SCL_L;
+		if (!WaitSCL_L_fast()) return -2;
+
 		I2C_DELAY_1CLK;
 
 		SCL_H;
-		if (!WaitSCL_H()) return -1;
+		if (!WaitSCL_H_fast()) return -1;
 
 		I2C_DELAY_1CLK;
 		if (SDA_read)
@@ -471,7 +490,7 @@ static int16_t I2C_BufferRead(uint8_t *data, uint8_t len, uint8_t device_cmd, ui
 		
 		len--;
 
-		// ��ȡ�ĵ�һ���ֽ�Ϊ��������	
+		// ��ȡ�ĵ�һ���ֽ�Ϊ��������	
 		// The first byte in response is the message length
 		if (!readcount && (len > *data)) {
 			len = *data;
@@ -629,11 +648,61 @@ static bool sc_rx_bytes(uint8_t* dest, uint8_t *destlen) {
  	// after three
 	if ( len <= 1 )
 		return false;
-	
+
 	*destlen = (uint8_t)len & 0xFF;
 	return true;
 }
 
+// Runs a T=0 exchange to completion on this side of the USB link. The APDU
+// is staged in a device buffer and the 61xx (response waiting) / 6Cxx
+// (wrong Le) procedure bytes are answered here with GET RESPONSE resp. a
+// corrected Le, so the client gets the assembled response in one round trip.
+static uint16_t sc_tpdu_exchange(uint8_t *apdu, uint8_t apdu_len, uint8_t device_cmd, uint8_t *resp, uint16_t resp_max) {
+
+	uint8_t chunk[ISO7618_MAX_FRAME];
+	uint16_t total = 0;
+
+	// hard cap on procedure byte rounds, in case of a misbehaving card
+	for (uint8_t rounds = 8; rounds; rounds--) {
+
+		LogTrace(apdu, apdu_len, 0, 0, NULL, true);
+
+		bool res = I2C_BufferWrite(apdu, apdu_len, device_cmd, I2C_DEVICE_ADDRESS_MAIN);
+		if ( !res && MF_DBGLEVEL > 3 ) DbpString(I2C_ERROR);
+
+		uint8_t len = sizeof(chunk);
+		if ( !sc_rx_bytes(chunk, &len) )
+			break;
+
+		LogTrace(chunk, len, 0, 0, NULL, false);
+
+		// wrong Le - reissue the pending command with the length the card announced
+		if (len == 2 && chunk[0] == 0x6C && apdu_len == 5) {
+			apdu[4] = chunk[1];
+			continue;
+		}
+
+		if (total + len > resp_max)
+			len = resp_max - total;
+		memcpy(resp + total, chunk, len);
+		total += len;
+
+		// response (or more of it) waiting on the card - fetch it
+		if (len >= 2 && chunk[len - 2] == 0x61) {
+			total -= 2;      // drop the intermediate status word
+			apdu[0] = 0x00;
+			apdu[1] = 0xC0;  // GET RESPONSE
+			apdu[2] = 0x00;
+			apdu[3] = 0x00;
+			apdu[4] = chunk[len - 1];
+			apdu_len = 5;
+			continue;
+		}
+		break;
+	}
+	return total;
+}
+
 static bool GetATR(smart_card_atr_t *card_ptr) {
 
 	if ( !card_ptr ) {
@@ -679,8 +748,8 @@ void SmartCardRaw( uint64_t arg0, uint64_t arg1, uint8_t *data ) {
 
 	LED_D_ON();
 
-	uint8_t len = 0;
-	uint8_t *resp = BigBuf_malloc(ISO7618_MAX_FRAME);
+	uint16_t len = 0;
+	uint8_t *resp = BigBuf_malloc(USB_CMD_DATA_SIZE);
 	smartcard_command_t flags = arg0;
 
 	if ((flags & SC_CONNECT))
@@ -703,21 +772,27 @@ void SmartCardRaw( uint64_t arg0, uint64_t arg1, uint8_t *data ) {
 
 	if ((flags & SC_RAW) || (flags & SC_RAW_T0)) {
 
-		LogTrace(data, arg1, 0, 0, NULL, true);
-
-		// Send raw bytes
-		// asBytes = A0 A4 00 00 02
-		// arg1 = len 5
-		bool res = I2C_BufferWrite(data, arg1, ((flags & SC_RAW_T0) ? I2C_DEVICE_CMD_SEND_T0 : I2C_DEVICE_CMD_SEND), I2C_DEVICE_ADDRESS_MAIN);
-		if ( !res && MF_DBGLEVEL > 3 ) DbpString(I2C_ERROR);
+		uint8_t device_cmd = ((flags & SC_RAW_T0) ? I2C_DEVICE_CMD_SEND_T0 : I2C_DEVICE_CMD_SEND);
 
-		// read bytes from module
-		len = ISO7618_MAX_FRAME;
-		res = sc_rx_bytes(resp, &len);
-		if ( res ) {
-			LogTrace(resp, len, 0, 0, NULL, false);
+		if ((flags & SC_T0_GETRESP)) {
+			// drive the procedure bytes here and return the assembled response
+			len = sc_tpdu_exchange(data, arg1, device_cmd, resp, USB_CMD_DATA_SIZE);
 		} else {
-			len = 0;
+
+			LogTrace(data, arg1, 0, 0, NULL, true);
+
+			// Send raw bytes
+			// asBytes = A0 A4 00 00 02
+			// arg1 = len 5
+			bool res = I2C_BufferWrite(data, arg1, device_cmd, I2C_DEVICE_ADDRESS_MAIN);
+			if ( !res && MF_DBGLEVEL > 3 ) DbpString(I2C_ERROR);
+
+			// read bytes from module
+			uint8_t rlen = ISO7618_MAX_FRAME;
+			if ( sc_rx_bytes(resp, &rlen) ) {
+				LogTrace(resp, rlen, 0, 0, NULL, false);
+				len = rlen;
+			}
 		}
 	}
 OUT:
@@ -774,10 +774,58 @@ static void AppendCrc(uint8_t *data, int len) {
 }
 
 
+/**
+ * Precomputed per-CSN simulation material for the multi-CSN reader attack
+ * (hf iclass sim 2). The anticollision rotation, CRCs, air-format frames and
+ * the cipher states only depend on the CSN (the e-purse and keys are the
+ * defaults in that mode), so they are all computed once when the CSN list is
+ * loaded instead of once per round against the reader.
+ *
+ * The table lives in the upper part of the emulator memory: that area
+ * survives the BigBuf_free_keep_EM() at every simulation entry, and the
+ * attack mode only uses the first 8 bytes of it for the active CSN.
+ */
+typedef struct {
+	uint8_t csn_data[10];		// CSN + CRC
+	uint8_t anticoll_data[10];	// rotated CSN + CRC
+	uint8_t resp_csn[22];		// modulated CSN frame
+	uint8_t resp_anticoll[22];	// modulated anticollision frame
+	uint8_t resp_csn_len;
+	uint8_t resp_anticoll_len;
+	State cipher_state_KD;
+	State cipher_state_KC;
+} iclass_sim_slot_t;
+
+#define ICLASS_SIM_SLOT_OFFSET	128
+
+static void iClassSimPrecomputeSlot(uint8_t *csn, iclass_sim_slot_t *slot) {
+	// same defaults as doIClassSimulation uses outside full simulation
+	uint8_t card_challenge_data[8] = { 0xfe, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+	uint8_t diversified_key_d[8] = { 0x00 };
+	uint8_t diversified_key_c[8] = { 0x00 };
+
+	memcpy(slot->csn_data, csn, 8);
+	rotateCSN(slot->csn_data, slot->anticoll_data);
+	AppendCrc(slot->anticoll_data, 8);
+	AppendCrc(slot->csn_data, 8);
+
+	CodeIso15693AsTag(slot->anticoll_data, sizeof(slot->anticoll_data));
+	memcpy(slot->resp_anticoll, ToSend, ToSendMax);
+	slot->resp_anticoll_len = ToSendMax;
+
+	CodeIso15693AsTag(slot->csn_data, sizeof(slot->csn_data));
+	memcpy(slot->resp_csn, ToSend, ToSendMax);
+	slot->resp_csn_len = ToSendMax;
+
+	slot->cipher_state_KD = opt_doTagMAC_1(card_challenge_data, diversified_key_d);
+	slot->cipher_state_KC = opt_doTagMAC_1(card_challenge_data, diversified_key_c);
+}
+
 /**
  * @brief Does the actual simulation
+ * @param slot optional precomputed per-CSN material (multi-CSN attack mode)
  */
-int doIClassSimulation(int simulationMode, uint8_t *reader_mac_buf) {
+int doIClassSimulation(int simulationMode, uint8_t *reader_mac_buf, const iclass_sim_slot_t *slot) {
 
 	// free eventually allocated BigBuf memory
 	BigBuf_free_keep_EM();
@@ -796,15 +844,22 @@ int doIClassSimulation(int simulationMode, uint8_t *reader_mac_buf) {
 	// CSN followed by two CRC bytes
 	uint8_t anticoll_data[10];
 	uint8_t csn_data[10];
-	memcpy(csn_data, csn, sizeof(csn_data));
 	Dbprintf("Simulating CSN %02x%02x%02x%02x%02x%02x%02x%02x", csn[0], csn[1], csn[2], csn[3], csn[4], csn[5], csn[6], csn[7]);
 
-	// Construct anticollision-CSN
-	rotateCSN(csn_data, anticoll_data);
+	if (slot != NULL) {
+		// rotation and CRCs were computed when the CSN list was loaded
+		memcpy(csn_data, slot->csn_data, sizeof(csn_data));
+		memcpy(anticoll_data, slot->anticoll_data, sizeof(anticoll_data));
+	} else {
+		memcpy(csn_data, csn, sizeof(csn_data));
 
-	// Compute CRC on both CSNs
-	AppendCrc(anticoll_data, 8);
-	AppendCrc(csn_data, 8);
+		// Construct anticollision-CSN
+		rotateCSN(csn_data, anticoll_data);
+
+		// Compute CRC on both CSNs
+		AppendCrc(anticoll_data, 8);
+		AppendCrc(csn_data, 8);
+	}
 
 	uint8_t diversified_key_d[8] = { 0x00 };
 	uint8_t diversified_key_c[8] = { 0x00 };
@@ -845,8 +900,13 @@ int doIClassSimulation(int simulationMode, uint8_t *reader_mac_buf) {
 	uint8_t max_page = conf_block[4] & 0x10 ? 0 : 7;
 
 	// Precalculate the cipher states, feeding it the CC
-	cipher_state_KD[0] = opt_doTagMAC_1(card_challenge_data, diversified_key_d);
-	cipher_state_KC[0] = opt_doTagMAC_1(card_challenge_data, diversified_key_c);
+	if (slot != NULL) {
+		cipher_state_KD[0] = slot->cipher_state_KD;
+		cipher_state_KC[0] = slot->cipher_state_KC;
+	} else {
+		cipher_state_KD[0] = opt_doTagMAC_1(card_challenge_data, diversified_key_d);
+		cipher_state_KC[0] = opt_doTagMAC_1(card_challenge_data, diversified_key_c);
+	}
 	if (simulationMode == ICLASS_SIM_MODE_FULL) {
 		for (int i = 1; i < max_page; i++) {
 			uint8_t *epurse = emulator + i*page_size + 8*2;
@@ -915,15 +975,23 @@ int doIClassSimulation(int simulationMode, uint8_t *reader_mac_buf) {
 	memcpy(resp_sof, ToSend, ToSendMax);
 	resp_sof_Len = ToSendMax;
 
-	// Anticollision CSN
-	CodeIso15693AsTag(anticoll_data, sizeof(anticoll_data));
-	memcpy(resp_anticoll, ToSend, ToSendMax);
-	resp_anticoll_len = ToSendMax;
-
-	// CSN (block 0)
-	CodeIso15693AsTag(csn_data, sizeof(csn_data));
-	memcpy(resp_csn, ToSend, ToSendMax);
-	resp_csn_len = ToSendMax;
+	if (slot != NULL) {
+		// CSN and anticollision frames were modulated at load time
+		memcpy(resp_anticoll, slot->resp_anticoll, slot->resp_anticoll_len);
+		resp_anticoll_len = slot->resp_anticoll_len;
+		memcpy(resp_csn, slot->resp_csn, slot->resp_csn_len);
+		resp_csn_len = slot->resp_csn_len;
+	} else {
+		// Anticollision CSN
+		CodeIso15693AsTag(anticoll_data, sizeof(anticoll_data));
+		memcpy(resp_anticoll, ToSend, ToSendMax);
+		resp_anticoll_len = ToSendMax;
+
+		// CSN (block 0)
+		CodeIso15693AsTag(csn_data, sizeof(csn_data));
+		memcpy(resp_csn, ToSend, ToSendMax);
+		resp_csn_len = ToSendMax;
+	}
 
 	// Configuration (block 1)
 	CodeIso15693AsTag(conf_block, sizeof(conf_block));
@@ -1279,24 +1347,30 @@ void SimulateIClass(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain
 	if (simType == ICLASS_SIM_MODE_CSN) {
 		// Use the CSN from commandline
 		memcpy(emulator, datain, 8);
-		doIClassSimulation(ICLASS_SIM_MODE_CSN, NULL);
+		doIClassSimulation(ICLASS_SIM_MODE_CSN, NULL, NULL);
 	} else if (simType == ICLASS_SIM_MODE_CSN_DEFAULT) {
 		//Default CSN
 		uint8_t csn_crc[] = { 0x03, 0x1f, 0xec, 0x8a, 0xf7, 0xff, 0x12, 0xe0, 0x00, 0x00 };
 		// Use the CSN from commandline
 		memcpy(emulator, csn_crc, 8);
-		doIClassSimulation(ICLASS_SIM_MODE_CSN, NULL);
+		doIClassSimulation(ICLASS_SIM_MODE_CSN, NULL, NULL);
 	} else if (simType == ICLASS_SIM_MODE_READER_ATTACK) {
 		uint8_t mac_responses[USB_CMD_DATA_SIZE] = { 0 };
 		Dbprintf("Going into attack mode, %d CSNS sent", numberOfCSNS);
 		// In this mode, a number of csns are within datain. We'll simulate each one, one at a time
 		// in order to collect MAC's from the reader. This can later be used in an offline-attack
 		// in order to obtain the keys, as in the "dismantling iclass"-paper.
+		// Precompute the per-CSN responses into the upper part of the emulator
+		// memory so every round starts with ready-made frames and cipher states.
+		iclass_sim_slot_t *slots = (iclass_sim_slot_t *)(emulator + ICLASS_SIM_SLOT_OFFSET);
 		int i;
+		for (i = 0; i < numberOfCSNS && i*16+16 <= USB_CMD_DATA_SIZE; i++) {
+			iClassSimPrecomputeSlot(datain+(i*8), &slots[i]);
+		}
 		for (i = 0; i < numberOfCSNS && i*16+16 <= USB_CMD_DATA_SIZE; i++) {
 			// The usb data is 512 bytes, fitting 32 responses (8 byte CC + 4 Byte NR + 4 Byte MAC = 16 Byte response).
 			memcpy(emulator, datain+(i*8), 8);
-			if (doIClassSimulation(ICLASS_SIM_MODE_EXIT_AFTER_MAC, mac_responses+i*16)) {
+			if (doIClassSimulation(ICLASS_SIM_MODE_EXIT_AFTER_MAC, mac_responses+i*16, &slots[i])) {
 				 // Button pressed
 				 break;
 			}
@@ -1311,7 +1385,7 @@ void SimulateIClass(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain
 		cmd_send(CMD_ACK, CMD_SIMULATE_TAG_ICLASS, i, 0, mac_responses, i*16);
 	} else if (simType == ICLASS_SIM_MODE_FULL) {
 		//This is 'full sim' mode, where we use the emulator storage for data.
-		doIClassSimulation(ICLASS_SIM_MODE_FULL, NULL);
+		doIClassSimulation(ICLASS_SIM_MODE_FULL, NULL, NULL);
 	} else {
 		// We may want a mode here where we hardcode the csns to use (from proxclone).
 		// That will speed things up a little, but not required just yet.
@@ -1660,6 +1734,25 @@ static bool iClass_ReadBlock(uint8_t blockNo, uint8_t *readdata) {
 }
 
 
+// read 4 consecutive blocks in one air round trip (32 bytes data + 2 bytes CRC)
+static bool iClass_ReadBlock4(uint8_t blockNo, uint8_t *readdata) {
+	uint8_t readcmd[] = {ICLASS_CMD_READ4, blockNo, 0x00, 0x00};
+	char bl = blockNo;
+	uint16_t rdCrc = iclass_crc16(&bl, 1);
+	readcmd[2] = rdCrc >> 8;
+	readcmd[3] = rdCrc & 0xff;
+	uint8_t resp[34];
+	uint32_t eof_time;
+
+	bool isOK = sendCmdGetResponseWithRetries(readcmd, sizeof(readcmd), resp, sizeof(resp), 34, 10, 0, &eof_time);
+	if (isOK) {
+		memcpy(readdata, resp, 32);
+	}
+
+	return isOK;
+}
+
+
 void iClass_ReadBlk(uint8_t blockno) {
 
 	LED_A_ON();
@@ -1694,7 +1787,20 @@ void iClass_Dump(uint8_t blockno, uint8_t numblks) {
 	}
 	memset(dataout, 0xFF, 255*8);
 
-	for ( ; blkCnt < numblks; blkCnt++) {
+	bool useRead4 = true;
+	while (blkCnt < numblks) {
+		// whole groups of 4 blocks are fetched with READ4: one air round
+		// trip (and one response CRC) per 4 blocks instead of per block
+		if (useRead4 && blkCnt + 4 <= numblks) {
+			if (iClass_ReadBlock4(blockno+blkCnt, dataout + (blkCnt*8))) {
+				isOK = true;
+				blkCnt += 4;
+				continue;
+			}
+			// no answer to READ4 (older chips and the simulator don't
+			// support it) - fall back to single block reads for the rest
+			useRead4 = false;
+		}
 		isOK = iClass_ReadBlock(blockno+blkCnt, readblockdata);
 		if (!isOK || (readblockdata[0] == 0xBB || readblockdata[7] == 0xBB || readblockdata[2] == 0xBB)) { //try again
 			isOK = iClass_ReadBlock(blockno+blkCnt, readblockdata);
@@ -1704,6 +1810,7 @@ void iClass_Dump(uint8_t blockno, uint8_t numblks) {
 			}
 		}
 		memcpy(dataout + (blkCnt*8), readblockdata, 8);
+		blkCnt++;
 	}
 	//return pointer to dump memory in arg3
 	cmd_send(CMD_ACK, isOK, blkCnt, BigBuf_max_traceLen(), 0, 0);
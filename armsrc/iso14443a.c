@@ -26,6 +26,7 @@
 #include "protocols.h"
 #include "parity.h"
 #include "fpgaloader.h"
+#include "eventjournal.h"
 
 typedef struct {
 	enum {
@@ -88,6 +89,9 @@ int rsamples = 0;
 uint8_t trigger = 0;
 // the block number for the ISO14443-4 PCB
 static uint8_t iso14_pcb_blocknum = 0;
+// maximum frame size the card accepts (FSC), taken from the ATS format byte
+// at select time. 32 bytes is the ISO14443-4 default for a missing FSCI.
+static uint16_t iso14_fsc = 32;
 
 //
 // ISO14443 timing:
@@ -206,25 +210,19 @@ uint32_t iso14a_get_timeout(void) {
 //-----------------------------------------------------------------------------
 void GetParity(const uint8_t *pbtCmd, uint16_t iLen, uint8_t *par)
 {
-	uint16_t paritybit_cnt = 0;
-	uint16_t paritybyte_cnt = 0;
-	uint8_t parityBits = 0;
-
-	for (uint16_t i = 0; i < iLen; i++) {
-		// Generate the parity bits
-		parityBits |= ((oddparity8(pbtCmd[i])) << (7-paritybit_cnt));
-		if (paritybit_cnt == 7) {
-			par[paritybyte_cnt] = parityBits;   // save 8 Bits parity
-			parityBits = 0;                     // and advance to next Parity Byte
-			paritybyte_cnt++;
-			paritybit_cnt = 0;
-		} else {
-			paritybit_cnt++;
-		}
+	// batched: each full group of 8 bytes yields one parity byte
+	uint16_t i = 0;
+	for (; i + 8 <= iLen; i += 8) {
+		par[i / 8] = paritybits8x4(oddparity8x4(pbtCmd + i)) << 4
+		           | paritybits8x4(oddparity8x4(pbtCmd + i + 4));
 	}
 
-	// save remaining parity bits
-	par[paritybyte_cnt] = parityBits;
+	// save remaining parity bits, left aligned as before
+	uint8_t parityBits = 0;
+	for (uint16_t j = 0; i + j < iLen; j++) {
+		parityBits |= oddparity8(pbtCmd[i + j]) << (7 - j);
+	}
+	par[i / 8] = parityBits;
 
 }
 
@@ -257,18 +255,44 @@ static void AppendCrc14443b(uint8_t* data, int len)
 //-----------------------------------------------------------------------------
 static tUart Uart;
 
-// Lookup-Table to decide if 4 raw bits are a modulation.
-// We accept the following:
+// Modulation events, one per bit period (= 8 raw FPGA bits). Both decoders
+// classify a full period with a single lookup in a 256 entry table indexed
+// by the sync-aligned raw byte, instead of testing each nibble separately
+// and branching on the two results. The tables are deliberately non-const
+// so they are linked into .data and served from single-cycle on-chip SRAM -
+// they sit in the DMA drain loops of the RAMFUNC sniffer handlers, where a
+// flash wait state per lookup is what made us drop back-to-back frames.
+#define EV_NO_MOD		0x00	// no modulation in either half
+#define EV_1ST_HALF		0x01	// modulation in the first half only
+#define EV_2ND_HALF		0x02	// modulation in the second half only
+#define EV_BOTH_HALVES	0x03	// modulation in both halves
+
+// Miller: a nibble is a modulation (a pause) for:
 // 0001  -   a 3 tick wide pause
 // 0011  -   a 2 tick wide pause, or a three tick wide pause shifted left
 // 0111  -   a 2 tick wide pause shifted left
 // 1001  -   a 2 tick wide pause shifted right
-const bool Mod_Miller_LUT[] = {
-	false,  true, false, true,  false, false, false, true,
-	false,  true, false, false, false, false, false, false
-};
-#define IsMillerModulationNibble1(b) (Mod_Miller_LUT[(b & 0x000000F0) >> 4])
-#define IsMillerModulationNibble2(b) (Mod_Miller_LUT[(b & 0x0000000F)])
+// i.e. nibbles 1, 3, 7 and 9:
+#define MILLER_MOD(n)		((0x028A >> (n)) & 1)
+// Manchester: a nibble is a modulation for three or four "1" in any
+// position, i.e. nibbles 7, 11, 13, 14 and 15:
+#define MANCHESTER_MOD(n)	((0xE880 >> (n)) & 1)
+
+#define MILLER_EVENT(b)		(uint8_t)(MILLER_MOD((b) >> 4) | (MILLER_MOD((b) & 0x0F) << 1))
+#define MANCHESTER_EVENT(b)	(uint8_t)(MANCHESTER_MOD((b) >> 4) | (MANCHESTER_MOD((b) & 0x0F) << 1))
+
+#define EVENT_ROW(f, hi) \
+	f((hi)+ 0), f((hi)+ 1), f((hi)+ 2), f((hi)+ 3), f((hi)+ 4), f((hi)+ 5), f((hi)+ 6), f((hi)+ 7), \
+	f((hi)+ 8), f((hi)+ 9), f((hi)+10), f((hi)+11), f((hi)+12), f((hi)+13), f((hi)+14), f((hi)+15)
+
+#define EVENT_TABLE(f) \
+	EVENT_ROW(f, 0x00), EVENT_ROW(f, 0x10), EVENT_ROW(f, 0x20), EVENT_ROW(f, 0x30), \
+	EVENT_ROW(f, 0x40), EVENT_ROW(f, 0x50), EVENT_ROW(f, 0x60), EVENT_ROW(f, 0x70), \
+	EVENT_ROW(f, 0x80), EVENT_ROW(f, 0x90), EVENT_ROW(f, 0xA0), EVENT_ROW(f, 0xB0), \
+	EVENT_ROW(f, 0xC0), EVENT_ROW(f, 0xD0), EVENT_ROW(f, 0xE0), EVENT_ROW(f, 0xF0)
+
+static uint8_t Miller_Event_LUT[256] = { EVENT_TABLE(MILLER_EVENT) };
+static uint8_t Manchester_Event_LUT[256] = { EVENT_TABLE(MANCHESTER_EVENT) };
 
 static void UartReset()
 {
@@ -324,11 +348,9 @@ static RAMFUNC bool MillerDecoding(uint8_t bit, uint32_t non_real_time)
 
 	} else {
 
-		if (IsMillerModulationNibble1(Uart.fourBits >> Uart.syncBit)) {
-			if (IsMillerModulationNibble2(Uart.fourBits >> Uart.syncBit)) {     // Modulation in both halves - error
-				LED_B_OFF();
-				UartReset();
-			} else {                                                            // Modulation in first half = Sequence Z = logic "0"
+		switch (Miller_Event_LUT[(Uart.fourBits >> Uart.syncBit) & 0xff]) {
+
+			case EV_1ST_HALF:                                                   // pause in first half = Sequence Z = logic "0"
 				if (Uart.state == STATE_MILLER_X) {                             // error - must not follow after X
 					LED_B_OFF();
 					UartReset();
@@ -349,9 +371,9 @@ static RAMFUNC bool MillerDecoding(uint8_t bit, uint32_t non_real_time)
 						}
 					}
 				}
-			}
-		} else {
-			if (IsMillerModulationNibble2(Uart.fourBits >> Uart.syncBit)) {     // Modulation second half = Sequence X = logic "1"
+				break;
+
+			case EV_2ND_HALF:                                                   // pause in second half = Sequence X = logic "1"
 				Uart.bitCount++;
 				Uart.shiftReg = (Uart.shiftReg >> 1) | 0x100;                   // add a 1 to the shiftreg
 				Uart.state = STATE_MILLER_X;
@@ -367,7 +389,14 @@ static RAMFUNC bool MillerDecoding(uint8_t bit, uint32_t non_real_time)
 						Uart.parityBits = 0;
 					}
 				}
-			} else {                                                            // no modulation in both halves - Sequence Y
+				break;
+
+			case EV_BOTH_HALVES:                                                // pauses in both halves - error
+				LED_B_OFF();
+				UartReset();
+				break;
+
+			default:                                                            // no pause in both halves - Sequence Y
 				if (Uart.state == STATE_MILLER_Z || Uart.state == STATE_MILLER_Y) { // Y after logic "0" - End of Communication
 					LED_B_OFF();
 					Uart.state = STATE_UNSYNCD;
@@ -409,7 +438,7 @@ static RAMFUNC bool MillerDecoding(uint8_t bit, uint32_t non_real_time)
 						}
 					}
 				}
-			}
+				break;
 		}
 
 	}
@@ -436,17 +465,6 @@ static RAMFUNC bool MillerDecoding(uint8_t bit, uint32_t non_real_time)
 // Note 2: parameter offset is used to determine the position of the parity bits (required for the anticollision command only)
 static tDemod Demod;
 
-// Lookup-Table to decide if 4 raw bits are a modulation.
-// We accept three or four "1" in any position
-const bool Mod_Manchester_LUT[] = {
-	false, false, false, false, false, false, false, true,
-	false, false, false, true,  false, true,  true,  true
-};
-
-#define IsManchesterModulationNibble1(b) (Mod_Manchester_LUT[(b & 0x00F0) >> 4])
-#define IsManchesterModulationNibble2(b) (Mod_Manchester_LUT[(b & 0x000F)])
-
-
 static void DemodReset()
 {
 	Demod.state = DEMOD_UNSYNCD;
@@ -503,28 +521,31 @@ static RAMFUNC int ManchesterDecoding(uint8_t bit, uint16_t offset, uint32_t non
 
 	} else {
 
-		if (IsManchesterModulationNibble1(Demod.twoBits >> Demod.syncBit)) {        // modulation in first half
-			if (IsManchesterModulationNibble2(Demod.twoBits >> Demod.syncBit)) {    // ... and in second half = collision
+		switch (Manchester_Event_LUT[(Demod.twoBits >> Demod.syncBit) & 0xff]) {
+
+			case EV_BOTH_HALVES:                                        // modulation in both halves = collision
 				if (!Demod.collisionPos) {
 					Demod.collisionPos = (Demod.len << 3) + Demod.bitCount;
 				}
-			}                                                           // modulation in first half only - Sequence D = 1
-			Demod.bitCount++;
-			Demod.shiftReg = (Demod.shiftReg >> 1) | 0x100;             // in both cases, add a 1 to the shiftreg
-			if(Demod.bitCount == 9) {                                   // if we decoded a full byte (including parity)
-				Demod.output[Demod.len++] = (Demod.shiftReg & 0xff);
-				Demod.parityBits <<= 1;                                 // make room for the parity bit
-				Demod.parityBits |= ((Demod.shiftReg >> 8) & 0x01);     // store parity bit
-				Demod.bitCount = 0;
-				Demod.shiftReg = 0;
-				if((Demod.len&0x0007) == 0) {                           // every 8 data bytes
-					Demod.parity[Demod.parityLen++] = Demod.parityBits; // store 8 parity bits
-					Demod.parityBits = 0;
+				// fall through - a collision is treated like Sequence D
+			case EV_1ST_HALF:                                           // modulation in first half - Sequence D = 1
+				Demod.bitCount++;
+				Demod.shiftReg = (Demod.shiftReg >> 1) | 0x100;         // in both cases, add a 1 to the shiftreg
+				if(Demod.bitCount == 9) {                               // if we decoded a full byte (including parity)
+					Demod.output[Demod.len++] = (Demod.shiftReg & 0xff);
+					Demod.parityBits <<= 1;                             // make room for the parity bit
+					Demod.parityBits |= ((Demod.shiftReg >> 8) & 0x01); // store parity bit
+					Demod.bitCount = 0;
+					Demod.shiftReg = 0;
+					if((Demod.len&0x0007) == 0) {                       // every 8 data bytes
+						Demod.parity[Demod.parityLen++] = Demod.parityBits; // store 8 parity bits
+						Demod.parityBits = 0;
+					}
 				}
-			}
-			Demod.endTime = Demod.startTime + 8*(9*Demod.len + Demod.bitCount + 1) - 4;
-		} else {                                                        // no modulation in first half
-			if (IsManchesterModulationNibble2(Demod.twoBits >> Demod.syncBit)) {    // and modulation in second half = Sequence E = 0
+				Demod.endTime = Demod.startTime + 8*(9*Demod.len + Demod.bitCount + 1) - 4;
+				break;
+
+			case EV_2ND_HALF:                                           // modulation in second half only = Sequence E = 0
 				Demod.bitCount++;
 				Demod.shiftReg = (Demod.shiftReg >> 1);                 // add a 0 to the shiftreg
 				if(Demod.bitCount >= 9) {                               // if we decoded a full byte (including parity)
@@ -539,7 +560,9 @@ static RAMFUNC int ManchesterDecoding(uint8_t bit, uint16_t offset, uint32_t non
 					}
 				}
 				Demod.endTime = Demod.startTime + 8*(9*Demod.len + Demod.bitCount + 1);
-			} else {                                                    // no modulation in both halves - End of communication
+				break;
+
+			default:                                                    // no modulation in both halves - End of communication
 				LED_C_OFF();
 				if(Demod.bitCount > 0) {                                // there are some remaining data bits
 					Demod.shiftReg >>= (9 - Demod.bitCount);            // right align the decoded bits
@@ -557,7 +580,7 @@ static RAMFUNC int ManchesterDecoding(uint8_t bit, uint16_t offset, uint32_t non
 				} else {                                                // nothing received. Start over
 					DemodReset();
 				}
-			}
+				break;
 		}
 
 	}
@@ -570,15 +593,145 @@ static RAMFUNC int ManchesterDecoding(uint8_t bit, uint16_t offset, uint32_t non
 // Both sides of communication!
 //=============================================================================
 
+// The PDC only holds two descriptors (current + next), so a longer ring is
+// built from chunks of DMA_BUFFER_SIZE: whenever the next-descriptor slot
+// runs empty it is re-armed with the following chunk. The decoders consume
+// bytes anywhere behind the hardware write pointer, so falling behind by up
+// to SNIFF_DMA_CHUNKS-2 chunks is absorbed instead of overwriting unread
+// samples.
+#define SNIFF_DMA_CHUNKS 8
+#define SNIFF_DMA_RING (SNIFF_DMA_CHUNKS * DMA_BUFFER_SIZE)
+
+static int sniff_next_chunk;
+
+static void SniffDmaStart(uint8_t *ring)
+{
+	AT91C_BASE_PDC_SSC->PDC_PTCR = AT91C_PDC_RXTDIS;
+	AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) ring;
+	AT91C_BASE_PDC_SSC->PDC_RCR = DMA_BUFFER_SIZE;
+	AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t) (ring + DMA_BUFFER_SIZE);
+	AT91C_BASE_PDC_SSC->PDC_RNCR = DMA_BUFFER_SIZE;
+	sniff_next_chunk = 2 % SNIFF_DMA_CHUNKS;
+	AT91C_BASE_PDC_SSC->PDC_PTCR = AT91C_PDC_RXTEN;
+}
+
+//-----------------------------------------------------------------------------
+// Device-side sniff filters ('hf 14a snoop u/w'): at a busy gate most of the
+// trace is other cards' traffic, so frames can be dropped before LogTrace
+// commits them. The UID filter follows the anticollision state machine and
+// suppresses everything after a SELECT that diverges from the target UID,
+// until the next REQA/WUPA opens a new session.
+//-----------------------------------------------------------------------------
+#define SNIFF_UID_PENDING	0	// new session, cascade not walked yet
+#define SNIFF_UID_MATCH		1
+#define SNIFF_UID_NOMATCH	2
+
+static uint8_t sniff_exp_uid[3][4];		// expected SELECT payload per cascade level
+static uint8_t sniff_exp_levels = 0;	// 0 = UID filter off
+static uint8_t sniff_uid_state;
+static uint8_t sniff_wl[16];			// reader command byte whitelist
+static uint8_t sniff_wl_len = 0;		// 0 = whitelist off
+static bool sniff_last_cmd_wanted;
+static uint32_t sniff_filtered;
+
+static void SniffFilterInit(const uint8_t *uid, uint8_t uidlen, const uint8_t *wl, uint8_t wllen)
+{
+	sniff_exp_levels = 0;
+	sniff_uid_state = SNIFF_UID_PENDING;
+	sniff_last_cmd_wanted = true;
+	sniff_filtered = 0;
+
+	sniff_wl_len = (wllen > sizeof(sniff_wl)) ? sizeof(sniff_wl) : wllen;
+	memcpy(sniff_wl, wl, sniff_wl_len);
+
+	// lay the UID out as the cascade levels a reader will select with
+	if (uidlen == 4) {
+		memcpy(sniff_exp_uid[0], uid, 4);
+		sniff_exp_levels = 1;
+	} else if (uidlen == 7) {
+		sniff_exp_uid[0][0] = 0x88;	// CT
+		memcpy(&sniff_exp_uid[0][1], uid, 3);
+		memcpy(sniff_exp_uid[1], uid + 3, 4);
+		sniff_exp_levels = 2;
+	} else if (uidlen == 10) {
+		sniff_exp_uid[0][0] = 0x88;	// CT
+		memcpy(&sniff_exp_uid[0][1], uid, 3);
+		sniff_exp_uid[1][0] = 0x88;	// CT
+		memcpy(&sniff_exp_uid[1][1], uid + 3, 3);
+		memcpy(sniff_exp_uid[2], uid + 6, 4);
+		sniff_exp_levels = 3;
+	}
+}
+
+// decide whether a completed frame goes into the trace
+static bool RAMFUNC SniffFrameWanted(const uint8_t *frame, uint16_t len, bool reader)
+{
+	bool wanted = true;
+
+	if (sniff_exp_levels) {
+		if (reader && len == 1) {
+			// REQA/WUPA opens a new session
+			sniff_uid_state = SNIFF_UID_PENDING;
+		} else if (reader && len == 9 && frame[1] == 0x70 &&
+		           (frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT ||
+		            frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 ||
+		            frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_3)) {
+			// full SELECT: check this cascade level against the target
+			uint8_t level = (frame[0] - ISO14443A_CMD_ANTICOLL_OR_SELECT) / 2;
+			if (sniff_uid_state != SNIFF_UID_NOMATCH) {
+				if (level >= sniff_exp_levels || memcmp(&frame[2], sniff_exp_uid[level], 4) != 0)
+					sniff_uid_state = SNIFF_UID_NOMATCH;
+				else if (level == sniff_exp_levels - 1)
+					sniff_uid_state = SNIFF_UID_MATCH;
+			}
+		}
+		wanted = (sniff_uid_state != SNIFF_UID_NOMATCH);
+	}
+
+	if (wanted && sniff_wl_len && reader) {
+		// short frames and anticollision always pass, or the select
+		// preamble would vanish from every filtered trace
+		if (len > 1 && frame[0] != ISO14443A_CMD_ANTICOLL_OR_SELECT &&
+		    frame[0] != ISO14443A_CMD_ANTICOLL_OR_SELECT_2 &&
+		    frame[0] != ISO14443A_CMD_ANTICOLL_OR_SELECT_3) {
+			wanted = false;
+			for (uint8_t k = 0; k < sniff_wl_len; k++) {
+				if (sniff_wl[k] == frame[0]) {
+					wanted = true;
+					break;
+				}
+			}
+		}
+	}
+
+	// a tag answer shares the verdict of the command it responds to
+	if (reader)
+		sniff_last_cmd_wanted = wanted;
+	else
+		wanted = wanted && sniff_last_cmd_wanted;
+
+	if (!wanted)
+		sniff_filtered++;
+	return wanted;
+}
+
 //-----------------------------------------------------------------------------
 // Record the sequence of commands sent by the reader to the tag, with
 // triggering so that we start recording at the point that the tag is moved
 // near the reader.
 //-----------------------------------------------------------------------------
-void RAMFUNC SnoopIso14443a(uint8_t param) {
-	// param:
+void RAMFUNC SnoopIso14443a(UsbCommand *c) {
+	// arg[0] (param):
 	// bit 0 - trigger from first card answer
 	// bit 1 - trigger from first reader 7-bit request
+	// bit 2 - stream completed trace entries to the client while sniffing
+	// arg[1] - UID filter length in bytes (0 = off), UID in d.asBytes[0..9]
+	// arg[2] - command whitelist length (0 = off), bytes in d.asBytes[10..]
+
+	uint8_t param = c->arg[0];
+	bool streaming = (param & 0x04);
+
+	SniffFilterInit(c->d.asBytes, c->arg[1], c->d.asBytes + 10, c->arg[2]);
 
 	LEDsoff();
 	LED_A_ON();
@@ -597,19 +750,23 @@ void RAMFUNC SnoopIso14443a(uint8_t param) {
 	uint8_t *receivedResponse = BigBuf_malloc(MAX_FRAME_SIZE);
 	uint8_t *receivedResponsePar = BigBuf_malloc(MAX_PARITY_SIZE);
 
-	// The DMA buffer, used to stream samples from the FPGA
-	uint8_t *dmaBuf = BigBuf_malloc(DMA_BUFFER_SIZE);
+	// The DMA ring, used to stream samples from the FPGA
+	uint8_t *dmaRing = BigBuf_malloc(SNIFF_DMA_RING);
 
 	// init trace buffer
 	clear_trace();
 	set_tracing(true);
+	if (streaming) trace_stream_start();
 
-	uint8_t *data = dmaBuf;
+	uint8_t *data = dmaRing;
 	uint8_t previous_data = 0;
 	int maxDataLen = 0;
 	int dataLen = 0;
 	bool TagIsActive = false;
 	bool ReaderIsActive = false;
+	uint32_t dropEvents = 0;		// backlog discarded at a frame boundary
+	uint32_t droppedBytes = 0;
+	uint32_t stallEvents = 0;		// both PDC descriptors ran dry
 
 	// Set up the demodulator for tag -> reader responses.
 	DemodInit(receivedResponse, receivedResponsePar);
@@ -618,7 +775,7 @@ void RAMFUNC SnoopIso14443a(uint8_t param) {
 	UartInit(receivedCmd, receivedCmdPar);
 
 	// Setup and start DMA.
-	FpgaSetupSscDma((uint8_t *)dmaBuf, DMA_BUFFER_SIZE);
+	SniffDmaStart(dmaRing);
 
 	// We won't start recording the frames that we acquire until we trigger;
 	// a good trigger condition to get started is probably when we see a
@@ -636,34 +793,58 @@ void RAMFUNC SnoopIso14443a(uint8_t param) {
 
 		WDT_HIT();
 
-		int register readBufDataP = data - dmaBuf;
-		int register dmaBufDataP = DMA_BUFFER_SIZE - AT91C_BASE_PDC_SSC->PDC_RCR;
-		if (readBufDataP <= dmaBufDataP){
-			dataLen = dmaBufDataP - readBufDataP;
-		} else {
-			dataLen = DMA_BUFFER_SIZE - readBufDataP + dmaBufDataP;
-		}
-		// test for length of buffer
-		if(dataLen > maxDataLen) {
+		// In streaming mode, deliver the trace while the air interface is
+		// quiet. The USB transfer takes far longer than the 128 byte DMA
+		// buffer lasts, so the DMA and the decoders are re-armed afterwards -
+		// frames starting mid-flush are lost, which is why we wait for a
+		// quiet moment and flush well before the trace is full.
+		if (streaming && !TagIsActive && !ReaderIsActive
+				&& BigBuf_get_traceLen() > BigBuf_max_traceLen() / 2) {
+			trace_stream_flush();
+			SniffDmaStart(dmaRing);
+			data = dmaRing;
+			previous_data = 0;
+			UartInit(receivedCmd, receivedCmdPar);
+			DemodReset();
+		}
+
+		// the hardware write pointer chases the read pointer around the ring
+		dataLen = ((uint8_t *)AT91C_BASE_PDC_SSC->PDC_RPR - data) & (SNIFF_DMA_RING - 1);
+		if (dataLen > maxDataLen)
 			maxDataLen = dataLen;
-			if(dataLen > (9 * DMA_BUFFER_SIZE / 10)) {
-				Dbprintf("blew circular buffer! dataLen=%d", dataLen);
-				break;
-			}
-		}
-		if(dataLen < 1) continue;
 
-		// primary buffer was stopped( <-- we lost data!
-		if (!AT91C_BASE_PDC_SSC->PDC_RCR) {
-			AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) dmaBuf;
-			AT91C_BASE_PDC_SSC->PDC_RCR = DMA_BUFFER_SIZE;
-			Dbprintf("RxEmpty ERROR!!! data length:%d", dataLen); // temporary
+		// watermark: less than two chunks of headroom left. Discard the
+		// whole backlog between frames instead of letting the PDC
+		// overwrite it under the decoders mid-frame, and account for it.
+		if (dataLen > SNIFF_DMA_RING - 2 * DMA_BUFFER_SIZE) {
+			dropEvents++;
+			droppedBytes += dataLen;
+			data = (uint8_t *)AT91C_BASE_PDC_SSC->PDC_RPR;
+			previous_data = 0;
+			UartInit(receivedCmd, receivedCmdPar);
+			DemodReset();
+			continue;
 		}
-		// secondary buffer sets as primary, secondary buffer was stopped
+
+		// the next-descriptor slot ran empty: hand it the chunk after the
+		// one the PDC is filling now
 		if (!AT91C_BASE_PDC_SSC->PDC_RNCR) {
-			AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t) dmaBuf;
+			AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t) (dmaRing + sniff_next_chunk * DMA_BUFFER_SIZE);
 			AT91C_BASE_PDC_SSC->PDC_RNCR = DMA_BUFFER_SIZE;
+			sniff_next_chunk = (sniff_next_chunk + 1) % SNIFF_DMA_CHUNKS;
 		}
+		// both descriptors ran dry - the PDC stalled and samples are gone,
+		// so restart the ring cleanly rather than decode across the gap
+		if (!AT91C_BASE_PDC_SSC->PDC_RCR) {
+			stallEvents++;
+			SniffDmaStart(dmaRing);
+			data = dmaRing;
+			previous_data = 0;
+			UartInit(receivedCmd, receivedCmdPar);
+			DemodReset();
+			continue;
+		}
+		if(dataLen < 1) continue;
 
 		if (rsamples & 0x01) {              // Need two samples to feed Miller and Manchester-Decoder
 
@@ -674,7 +855,7 @@ void RAMFUNC SnoopIso14443a(uint8_t param) {
 					if ((!triggered) && (param & 0x02) && (Uart.len == 1) && (Uart.bitCount == 7)) {
 						triggered = true;
 					}
-					if(triggered) {
+					if(triggered && SniffFrameWanted(receivedCmd, Uart.len, true)) {
 						if (!LogTrace(receivedCmd,
 										Uart.len,
 										Uart.startTime*16 - DELAY_READER_AIR2ARM_AS_SNIFFER,
@@ -694,12 +875,14 @@ void RAMFUNC SnoopIso14443a(uint8_t param) {
 			if (!ReaderIsActive) {      // no need to try decoding tag data if the reader is sending - and we cannot afford the time
 				uint8_t tagdata = (previous_data << 4) | (*data & 0x0F);
 				if (ManchesterDecoding(tagdata, 0, (rsamples-1)*4)) {
-					if (!LogTrace(receivedResponse,
+					if (SniffFrameWanted(receivedResponse, Demod.len, false)) {
+						if (!LogTrace(receivedResponse,
 									Demod.len,
 									Demod.startTime*16 - DELAY_TAG_AIR2ARM_AS_SNIFFER,
 									Demod.endTime*16 - DELAY_TAG_AIR2ARM_AS_SNIFFER,
 									Demod.parity,
 									false)) break;
+					}
 					if ((!triggered) && (param & 0x01)) triggered = true;
 					// And ready to receive another response.
 					DemodReset();
@@ -713,8 +896,8 @@ void RAMFUNC SnoopIso14443a(uint8_t param) {
 		previous_data = *data;
 		rsamples++;
 		data++;
-		if(data == dmaBuf + DMA_BUFFER_SIZE) {
-			data = dmaBuf;
+		if(data == dmaRing + SNIFF_DMA_RING) {
+			data = dmaRing;
 		}
 	} // main cycle
 
@@ -724,6 +907,20 @@ void RAMFUNC SnoopIso14443a(uint8_t param) {
 	DbpString("COMMAND FINISHED");
 	Dbprintf("maxDataLen=%d, Uart.state=%x, Uart.len=%d", maxDataLen, Uart.state, Uart.len);
 	Dbprintf("traceLen=%d, Uart.output[0]=%08x", BigBuf_get_traceLen(), (uint32_t)Uart.output[0]);
+	if (dropEvents || stallEvents)
+		Dbprintf("overrun: dropped backlog %d times (%d bytes), DMA stalled %d times - the capture has gaps there",
+				dropEvents, droppedBytes, stallEvents);
+	else
+		DbpString("no overruns - capture is gap-free");
+	if (sniff_exp_levels || sniff_wl_len)
+		Dbprintf("filter: %d frames suppressed", sniff_filtered);
+
+	if (streaming) {
+		trace_stream_flush();
+		Dbprintf("streamed %d trace bytes, %d entries dropped", trace_stream_sent_total(), trace_stream_dropped_total());
+		cmd_send(CMD_ACK, trace_stream_sent_total(), trace_stream_dropped_total(), dropEvents + stallEvents, 0, 0);
+		trace_stream_stop();
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -1097,6 +1294,7 @@ void SimulateIso14443aTag(int tagType, int uid_1st, int uid_2nd, byte_t* data)
 	tag_response_info_t* p_response;
 
 	LED_A_ON();
+	EventJournalLog(EVT_SIM_START, tagType);
 	for (;;) {
 		// Clean receive command buffer
 		if(!GetIso14443aCommandFromReader(receivedCmd, receivedCmdPar, &len)) {
@@ -1126,6 +1324,7 @@ void SimulateIso14443aTag(int tagType, int uid_1st, int uid_2nd, byte_t* data)
 			// We already responded, do not send anything with the EmSendCmd14443aRaw() that is called below
 			p_response = NULL;
 		} else if(receivedCmd[0] == 0x50) { // Received a HALT
+			EventJournalLog(EVT_SIM_HALT, uid_1st);
 			p_response = NULL;
 		} else if(receivedCmd[0] == 0x60 || receivedCmd[0] == 0x61) {   // Received an authentication request
 			p_response = &responses[5]; order = 7;
@@ -1223,6 +1422,7 @@ void SimulateIso14443aTag(int tagType, int uid_1st, int uid_2nd, byte_t* data)
 		}
 	}
 
+	EventJournalLog(EVT_SIM_STOP, cmdsRecvd);
 	Dbprintf("%x %x %x", happened, happened2, cmdsRecvd);
 	LED_A_OFF();
 	BigBuf_free_keep_EM();
@@ -1275,8 +1475,9 @@ static void TransmitFor14443a(const uint8_t *cmd, uint16_t len, uint32_t *timing
 		} else {
 			PrepareDelayedTransfer(*timing & 0x00000007);       // Delay transfer (fine tuning - up to 7 MF clock ticks)
 		}
-		if(MF_DBGLEVEL >= 4 && GetCountSspClk() >= (*timing & 0xfffffff8)) Dbprintf("TransmitFor14443a: Missed timing");
-		while (GetCountSspClk() < (*timing & 0xfffffff8));      // Delay transfer (multiple of 8 MF clock ticks)
+		uint32_t transfer_time = *timing & 0xfffffff8;
+		if(MF_DBGLEVEL >= 4 && GetCountSspClk() >= transfer_time) Dbprintf("TransmitFor14443a: Missed timing");
+		while (GetCountSspClk() < transfer_time);               // Delay transfer (multiple of 8 MF clock ticks)
 		LastTimeProxToAirStart = *timing;
 	} else {
 		ThisTransferTime = ((MAX(NextTransferTime, GetCountSspClk()) & 0xfffffff8) + 8);
@@ -1306,17 +1507,51 @@ static void TransmitFor14443a(const uint8_t *cmd, uint16_t len, uint32_t *timing
 //-----------------------------------------------------------------------------
 // Prepare reader command (in bits, support short frames) to send to FPGA
 //-----------------------------------------------------------------------------
+
+// Miller sequences for one data nibble. A 1 is always Sequence X, a 0 after
+// a 0 is Sequence Z, a 0 after a 1 is Sequence Y - so each sequence depends
+// only on the bit and its predecessor. Precomputing all (previous bit, nibble)
+// combinations turns the per-bit branching of frame assembly into four table
+// stores per nibble. Parity stays a separate lookup: it is supplied by the
+// caller and deliberately wrong at times (crypto1), so it cannot be folded
+// into a pure data table.
+typedef struct {
+	uint8_t seq[4];
+	uint8_t last;	// value of the nibble's top bit, the next lookup's index
+} miller_nibble_t;
+
+static miller_nibble_t miller_nibble[2][16];
+static bool miller_nibble_init_done = false;
+
+static void MillerNibbleInit(void)
+{
+	for (int last = 0; last < 2; last++) {
+		for (int nib = 0; nib < 16; nib++) {
+			int prev = last;
+			for (int j = 0; j < 4; j++) {
+				int bit = (nib >> j) & 1;
+				miller_nibble[last][nib].seq[j] = bit ? SEC_X : (prev ? SEC_Y : SEC_Z);
+				prev = bit;
+			}
+			miller_nibble[last][nib].last = prev;
+		}
+	}
+	miller_nibble_init_done = true;
+}
+
 static void CodeIso14443aBitsAsReaderPar(const uint8_t *cmd, uint16_t bits, const uint8_t *parity)
 {
 	int i, j;
 	int last;
 	uint8_t b;
 
+	if (!miller_nibble_init_done)
+		MillerNibbleInit();
+
 	ToSendReset();
 
 	// Start of Communication (Seq. Z)
 	ToSend[++ToSendMax] = SEC_Z;
-	LastProxToAirDuration = 8 * (ToSendMax+1) - 6;
 	last = 0;
 
 	size_t bytecount = nbytes(bits);
@@ -1326,45 +1561,51 @@ static void CodeIso14443aBitsAsReaderPar(const uint8_t *cmd, uint16_t bits, cons
 		b = cmd[i];
 		size_t bitsleft = MIN((bits-(i*8)),8);
 
-		for (j = 0; j < bitsleft; j++) {
-			if (b & 1) {
-				// Sequence X
-				ToSend[++ToSendMax] = SEC_X;
-				LastProxToAirDuration = 8 * (ToSendMax+1) - 2;
-				last = 1;
-			} else {
-				if (last == 0) {
-				// Sequence Z
-				ToSend[++ToSendMax] = SEC_Z;
-				LastProxToAirDuration = 8 * (ToSendMax+1) - 6;
+		if (bitsleft == 8) {
+			// whole byte: two nibble lookups plus the parity sequence
+			uint8_t *p = &ToSend[ToSendMax + 1];
+			const miller_nibble_t *t = &miller_nibble[last][b & 0x0f];
+			p[0] = t->seq[0];
+			p[1] = t->seq[1];
+			p[2] = t->seq[2];
+			p[3] = t->seq[3];
+			t = &miller_nibble[t->last][b >> 4];
+			p[4] = t->seq[0];
+			p[5] = t->seq[1];
+			p[6] = t->seq[2];
+			p[7] = t->seq[3];
+			last = t->last;
+			ToSendMax += 8;
+
+			if (parity != NULL) {
+				if (parity[i>>3] & (0x80 >> (i&0x0007))) {
+					ToSend[++ToSendMax] = SEC_X;
+					last = 1;
 				} else {
-					// Sequence Y
-					ToSend[++ToSendMax] = SEC_Y;
+					ToSend[++ToSendMax] = last ? SEC_Y : SEC_Z;
 					last = 0;
 				}
 			}
-			b >>= 1;
+			continue;
 		}
 
-		// Only transmit parity bit if we transmitted a complete byte
-		if (j == 8 && parity != NULL) {
-			// Get the parity bit
-			if (parity[i>>3] & (0x80 >> (i&0x0007))) {
+		// partial byte of a short frame: no parity, walk the bits
+		for (j = 0; j < bitsleft; j++) {
+			if (b & 1) {
 				// Sequence X
 				ToSend[++ToSendMax] = SEC_X;
-				LastProxToAirDuration = 8 * (ToSendMax+1) - 2;
 				last = 1;
 			} else {
 				if (last == 0) {
-					// Sequence Z
-					ToSend[++ToSendMax] = SEC_Z;
-					LastProxToAirDuration = 8 * (ToSendMax+1) - 6;
+				// Sequence Z
+				ToSend[++ToSendMax] = SEC_Z;
 				} else {
 					// Sequence Y
 					ToSend[++ToSendMax] = SEC_Y;
 					last = 0;
 				}
 			}
+			b >>= 1;
 		}
 	}
 
@@ -1372,7 +1613,6 @@ static void CodeIso14443aBitsAsReaderPar(const uint8_t *cmd, uint16_t bits, cons
 	if (last == 0) {
 		// Sequence Z
 		ToSend[++ToSendMax] = SEC_Z;
-		LastProxToAirDuration = 8 * (ToSendMax+1) - 6;
 	} else {
 		// Sequence Y
 		ToSend[++ToSendMax] = SEC_Y;
@@ -1380,6 +1620,19 @@ static void CodeIso14443aBitsAsReaderPar(const uint8_t *cmd, uint16_t bits, cons
 	}
 	ToSend[++ToSendMax] = SEC_Y;
 
+	// The air duration ends with the last modulation: find the last sequence
+	// that is not the unmodulated Y (the SOC Z bounds the search).
+	for (i = ToSendMax; i >= 0; i--) {
+		if (ToSend[i] == SEC_X) {
+			LastProxToAirDuration = 8 * (i+1) - 2;
+			break;
+		}
+		if (ToSend[i] == SEC_Z) {
+			LastProxToAirDuration = 8 * (i+1) - 6;
+			break;
+		}
+	}
+
 	// Convert to length of command:
 	ToSendMax++;
 }
@@ -1407,8 +1660,10 @@ int EmGetCmd(uint8_t *received, uint16_t *len, uint8_t *parity)
 	// start ADC
 	AT91C_BASE_ADC->ADC_CR = AT91C_ADC_START;
 
-	// Ensure that the FPGA Delay Queue is empty before we switch to TAGSIM_LISTEN
-	while (GetCountSspClk() < LastTimeProxToAirStart + LastProxToAirDuration + (FpgaSendQueueDelay>>3) - 8 - 3) /* wait */ ;
+	// Ensure that the FPGA Delay Queue is empty before we switch to TAGSIM_LISTEN.
+	// The deadline is loop-invariant; computing it once keeps the polling loop tight.
+	uint32_t fpga_queue_empty_time = LastTimeProxToAirStart + LastProxToAirDuration + (FpgaSendQueueDelay>>3) - 8 - 3;
+	while (GetCountSspClk() < fpga_queue_empty_time) /* wait */ ;
 
 	// Set FPGA mode to "simulated ISO 14443 tag", no modulation (listen
 	// only, since we are receiving, not transmitting).
@@ -1536,8 +1791,23 @@ static int EmSendCmd14443aRaw(uint8_t *resp, uint16_t respLen)
 
 
 int EmSend4bit(uint8_t resp){
-	Code4bitAnswerAsTag(resp);
-	int res = EmSendCmd14443aRaw(ToSend, ToSendMax);
+	// The 16 possible 4-bit answers (ACK/NAK) have a fixed 7 byte modulation
+	// pattern. Encode each answer only on its first use and cache it, so the
+	// time-critical reply path doesn't run the encoder - same idea as the
+	// precompiled responses in SimulateIso14443aTag().
+	static uint8_t modulation_cache[16][7];
+	static uint8_t modulation_cache_n[16];
+	static uint16_t duration_cache[16];
+
+	resp &= 0x0f;
+	if (modulation_cache_n[resp] == 0) {
+		Code4bitAnswerAsTag(resp);
+		memcpy(modulation_cache[resp], ToSend, ToSendMax);
+		modulation_cache_n[resp] = ToSendMax;
+		duration_cache[resp] = LastProxToAirDuration;
+	}
+	LastProxToAirDuration = duration_cache[resp];
+	int res = EmSendCmd14443aRaw(modulation_cache[resp], modulation_cache_n[resp]);
 	// Log this tag answer and fix timing of previous reader command:
 	EmLogTraceTag(&resp, 1, NULL, LastProxToAirDuration);
 	return res;
@@ -1670,8 +1940,13 @@ static void iso14a_set_ATS_times(uint8_t *ats) {
 	uint8_t tb1;
 	uint8_t fwi, sfgi;
 	uint32_t fwt, sfgt;
+	static const uint16_t fsc_table[] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+
+	iso14_fsc = 32;                             // default when the ATS has no T0
 
 	if (ats[0] > 1) {                           // there is a format byte T0
+		uint8_t fsci = ats[1] & 0x0f;           // frame size for the card integer (FSCI)
+		iso14_fsc = fsc_table[MIN(fsci, 8)];
 		if ((ats[1] & 0x20) == 0x20) {          // there is an interface byte TB(1)
 			if ((ats[1] & 0x10) == 0x10) {      // there is an interface byte TA(1) preceding TB(1)
 				tb1 = ats[3];
@@ -1693,10 +1968,14 @@ static void iso14a_set_ATS_times(uint8_t *ats) {
 }
 
 
+// probe with REQA instead of WUPA, so that halted cards stay silent. Used by
+// Iso14443aInventory() to take already enumerated cards out of the tree walk.
+static bool iso14a_inventory_reqa = false;
+
 static int GetATQA(uint8_t *resp, uint8_t *resp_par) {
 
 #define WUPA_RETRY_TIMEOUT  10  // 10ms
-	uint8_t wupa[]       = { 0x52 };  // 0x26 - REQA  0x52 - WAKE-UP
+	uint8_t wupa[]       = { iso14a_inventory_reqa ? 0x26 : 0x52 };  // 0x26 - REQA  0x52 - WAKE-UP
 
 	uint32_t save_iso14a_timeout = iso14a_get_timeout();
 	iso14a_set_timeout(1236/(16*8)+1);      // response to WUPA is expected at exactly 1236/fc. No need to wait longer.
@@ -1774,6 +2053,7 @@ int iso14443a_select_card(byte_t *uid_ptr, iso14a_card_select_t *p_hi14a_card, u
 			// SELECT_ALL
 			ReaderTransmit(sel_all, sizeof(sel_all), NULL);
 			if (!ReaderReceive(resp, resp_par)) {
+				EventJournalLog(EVT_14A_SELECT_FAIL, 1);	// anticollision broke off
 				return 0;
 			}
 
@@ -1798,6 +2078,7 @@ int iso14443a_select_card(byte_t *uid_ptr, iso14a_card_select_t *p_hi14a_card, u
 					collision_answer_offset = uid_resp_bits%8;
 					ReaderTransmitBits(sel_uid, 16 + uid_resp_bits, NULL);
 					if (!ReaderReceiveOffset(resp, collision_answer_offset, resp_par)) {
+						EventJournalLog(EVT_14A_SELECT_FAIL, 1);	// anticollision broke off
 						return 0;
 					}
 				}
@@ -1834,6 +2115,7 @@ int iso14443a_select_card(byte_t *uid_ptr, iso14a_card_select_t *p_hi14a_card, u
 
 		// Receive the SAK
 		if (!ReaderReceive(resp, resp_par)) {
+			EventJournalLog(EVT_14A_SELECT_FAIL, 2);	// no SAK
 			return 0;
 		}
 		sak = resp[0];
@@ -1871,6 +2153,7 @@ int iso14443a_select_card(byte_t *uid_ptr, iso14a_card_select_t *p_hi14a_card, u
 		ReaderTransmit(rats, sizeof(rats), NULL);
 
 		if (!(len = ReaderReceive(resp, resp_par))) {
+			EventJournalLog(EVT_14A_SELECT_FAIL, 4);	// no answer to RATS
 			return 0;
 		}
 
@@ -1886,6 +2169,7 @@ int iso14443a_select_card(byte_t *uid_ptr, iso14a_card_select_t *p_hi14a_card, u
 		iso14a_set_ATS_times(resp);
 
 	}
+	EventJournalLog(EVT_14A_SELECT, bytes_to_num(uid_resp, 4));
 	return 1;
 }
 
@@ -1905,6 +2189,7 @@ void iso14443a_setup(uint8_t fpga_minor_mode) {
 		LED_D_OFF();
 	}
 	FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_ISO14443A | fpga_minor_mode);
+	EventJournalLog(EVT_FIELD_ON, FPGA_MAJOR_MODE_HF_ISO14443A | fpga_minor_mode);
 
 	// Set ADC to read field strength
 	AT91C_BASE_ADC->ADC_CR = AT91C_ADC_SWRST;
@@ -2030,6 +2315,57 @@ int iso14_apdu(uint8_t *cmd, uint16_t cmd_len, bool send_chaining, void *data, u
 }
 
 
+//-----------------------------------------------------------------------------
+// Exchange one complete ISO14443-4 APDU: split the command into chained
+// I-blocks sized to the card's FSC, answer WTX requests (done in iso14_apdu)
+// and reassemble a chained response - all without returning to the host in
+// between. That keeps the inter-block timing on the device, so slow cards
+// can't run into a frame waiting time overrun caused by USB round trips.
+// Returns the assembled response length (data + SW, CRCs stripped), 0 on a
+// data link error, -1 on a CRC error, -2 on a block sequence error and -3
+// when the response doesn't fit the buffer.
+//-----------------------------------------------------------------------------
+static int iso14_apdu_full(uint8_t *cmd, uint16_t cmd_len, uint8_t *resp, uint16_t resp_maxlen)
+{
+	uint8_t res = 0;
+	uint16_t sent = 0;
+	int resplen = 0;
+	int len = 0;
+
+	if (!cmd_len) return -2;
+
+	// send, chaining into FSC-sized I-blocks when the APDU doesn't fit one frame
+	do {
+		uint16_t chunk = MIN(cmd_len - sent, iso14_fsc - 3);	// 3 = PCB + CRC
+		bool chaining = (sent + chunk < cmd_len);
+
+		// a data link error may be transient - resending the I-block (same
+		// block number, so it counts as a retransmission) asks the card again
+		for (uint8_t retry = 0; retry < 3; retry++) {
+			len = iso14_apdu(cmd + sent, chunk, chaining, resp, &res);
+			if (len > 0) break;
+		}
+		if (len <= 0) return len;
+		sent += chunk;
+
+		// an intermediate block must be acknowledged with an R(ACK)
+		if (chaining && (res & 0xF2) != 0xA2) return -2;
+	} while (sent < cmd_len);
+
+	// collect the (possibly chained) response
+	for (;;) {
+		if (len < 3) return -1;	// PCB got cut already, this is less than SW + CRC
+		resplen += len - 2;	// strip the per-frame CRC
+		if ((res & 0x10) == 0) break;	// no more chained I-blocks
+		if (resplen + ISO7816_MAX_FRAME_SIZE > resp_maxlen) return -3;
+		// fetch the next part of the chained response (R-block ACK)
+		len = iso14_apdu(NULL, 0, false, resp + resplen, &res);
+	}
+
+	return resplen;
+}
+
+
 //-----------------------------------------------------------------------------
 // Read an ISO 14443a tag. Send out commands and store answers.
 //
@@ -2088,6 +2424,14 @@ void ReaderIso14443a(UsbCommand *c)
 		LED_B_OFF();
 	}
 
+	if(param & ISO14A_APDU_FULL && !cantSELECT) {
+		int resplen = iso14_apdu_full(cmd, len, buf, sizeof(buf));
+		FpgaDisableTracing();
+		LED_B_ON();
+		cmd_send(CMD_ACK, resplen, 0, 0, buf, resplen > 0 ? resplen : 0);
+		LED_B_OFF();
+	}
+
 	if(param & ISO14A_RAW && !cantSELECT) {
 		if(param & ISO14A_APPEND_CRC) {
 			if(param & ISO14A_TOPAZMODE) {
@@ -2144,6 +2488,317 @@ void ReaderIso14443a(UsbCommand *c)
 }
 
 
+//-----------------------------------------------------------------------------
+// Execute a list of ISO14443-4 APDUs back to back, without a USB round trip
+// between them. The card must already be selected (ISO14A_CONNECT with
+// ISO14A_NO_DISCONNECT) and the field is left up afterwards. datain carries
+// arg[0] entries of [1 byte length][APDU]; every response is streamed back as
+// its own CMD_ACK (arg0 = entry index, arg1 = response length incl. SW, or
+// 0xffff on an exchange error, which also aborts the rest of the list).
+//-----------------------------------------------------------------------------
+void ReaderIso14443aBatch(UsbCommand *c)
+{
+	uint16_t count = c->arg[0] & 0xffff;
+	uint8_t *in = c->d.asBytes;
+	byte_t resp[USB_CMD_DATA_SIZE] = {0};
+
+	set_tracing(true);
+
+	for (uint16_t i = 0; i < count; i++) {
+		uint8_t apdu_len = *in++;
+		uint8_t res = 0;
+		int resplen = 0;
+		bool error = false;
+
+		int len = iso14_apdu(in, apdu_len, false, resp, &res);
+		in += apdu_len;
+
+		for (;;) {
+			if (len < 3) {	// PCB got cut already, this is less than SW + CRC
+				error = true;
+				break;
+			}
+			resplen += len - 2;	// strip the per-frame CRC
+			if ((res & 0x10) == 0) {	// no more chained I-blocks
+				break;
+			}
+			if (resplen + ISO7816_MAX_FRAME_SIZE > (int)sizeof(resp)) {
+				error = true;
+				break;
+			}
+			// fetch the next part of the chained response (R-block ACK)
+			len = iso14_apdu(NULL, 0, false, resp + resplen, &res);
+		}
+
+		FpgaDisableTracing();
+		LED_B_ON();
+		if (error) {
+			cmd_send(CMD_ACK, i, 0xffff, 0, NULL, 0);
+			LED_B_OFF();
+			break;
+		}
+		cmd_send(CMD_ACK, i, resplen, 0, resp, resplen);
+		LED_B_OFF();
+		set_tracing(true);
+	}
+}
+
+
+// transmit one Topaz command frame (7 bit opcode byte, then plain 8 bit
+// bytes, no parity) with its CRC appended and collect the answer. Returns
+// the response length in bytes.
+static int TopazExchange(uint8_t *cmd, uint16_t len, uint8_t *resp)
+{
+	uint8_t par[MAX_PARITY_SIZE];
+
+	AppendCrc14443b(cmd, len);
+	len += 2;
+
+	uint16_t i = 0;
+	ReaderTransmitBitsPar(&cmd[i++], 7, NULL, NULL);
+	while (i < len) {
+		ReaderTransmitBitsPar(&cmd[i++], 8, NULL, NULL);
+	}
+	return ReaderReceive(resp, par);
+}
+
+//-----------------------------------------------------------------------------
+// Read the complete dynamic memory of a Topaz (NFC Type 1) tag in one field
+// session: READ8 of block 0x0f (the rest of segment 0), then RSEG of every
+// remaining segment. The client used to issue these one USB round trip at a
+// time; here the next segment request goes on the air before the previous
+// response is committed to the output buffer. arg[0] = tag memory size in
+// bytes, datain = the 4 uid bytes every Topaz command carries. The field must
+// already be up (select + RALL done); it is left up afterwards.
+//-----------------------------------------------------------------------------
+void ReaderTopazReadAll(UsbCommand *c)
+{
+	uint16_t size = c->arg[0] & 0xffff;
+	uint8_t *uid = c->d.asBytes;
+	uint8_t dataout[USB_CMD_DATA_SIZE] = {0};
+	uint8_t cmdbuf[16];
+	uint8_t resp[2][140];
+	uint16_t collected = 0;
+	bool error = false;
+
+	set_tracing(true);
+
+	// block 0x0f completes segment 0
+	memset(cmdbuf, 0, sizeof(cmdbuf));
+	cmdbuf[0] = TOPAZ_READ8;
+	cmdbuf[1] = 0x0f;
+	memcpy(&cmdbuf[10], uid, 4);
+	if (TopazExchange(cmdbuf, 14, resp[0]) != 11) {
+		error = true;
+	} else {
+		memcpy(dataout, &resp[0][1], 8);
+		collected = 8;
+	}
+
+	// the remaining segments, with the next request transmitted while the
+	// previous response is copied out
+	uint8_t max_segment = (size >= 256) ? (size / 128 - 1) : 0;
+	int prev = -1;
+	for (uint8_t segment = 1; segment <= max_segment + 1 && !error; segment++) {
+		int cur = segment & 1;
+		if (segment <= max_segment) {
+			memset(cmdbuf, 0, sizeof(cmdbuf));
+			cmdbuf[0] = TOPAZ_RSEG;
+			cmdbuf[1] = segment << 4;
+			memcpy(&cmdbuf[10], uid, 4);
+			AppendCrc14443b(cmdbuf, 14);
+			uint16_t i = 0;
+			ReaderTransmitBitsPar(&cmdbuf[i++], 7, NULL, NULL);
+			while (i < 16) {
+				ReaderTransmitBitsPar(&cmdbuf[i++], 8, NULL, NULL);
+			}
+		}
+		if (prev >= 0) {	// commit the previous response during air time
+			memcpy(dataout + collected, &resp[prev][1], 128);
+			collected += 128;
+		}
+		if (segment <= max_segment) {
+			uint8_t par[MAX_PARITY_SIZE];
+			if (ReaderReceive(resp[cur], par) != 131) {
+				error = true;
+				break;
+			}
+			prev = cur;
+		}
+	}
+
+	FpgaDisableTracing();
+	LED_B_ON();
+	cmd_send(CMD_ACK, error ? 0 : collected, 0, 0, dataout, error ? 0 : collected);
+	LED_B_OFF();
+	set_tracing(true);
+}
+
+
+//-----------------------------------------------------------------------------
+// Inventory all ISO14443a tags in the field in one command. Each round wakes
+// the field, resolves one tag through the anticollision tree (the binary
+// search over the UID bits in iso14443a_select_card(), which always follows
+// the '1' branch of a collision) and halts it with HLTA; halted tags ignore
+// the REQA probes of the following rounds, so every round resolves the next
+// tag of the tree. The UID list goes back in a single response as arg[0]
+// entries of [1 byte uidlen][10 byte uid][2 byte ATQA][1 byte SAK].
+//-----------------------------------------------------------------------------
+void Iso14443aInventory(UsbCommand *c)
+{
+#define INVENTORY_ENTRY_SIZE	14
+	uint16_t maxTags = c->arg[0] & 0xffff;
+	uint8_t results[USB_CMD_DATA_SIZE];
+	uint8_t hlta[] = { 0x50, 0x00, 0x00, 0x00 };
+	iso14a_card_select_t card;
+	uint16_t count = 0;
+
+	if (maxTags == 0 || maxTags > USB_CMD_DATA_SIZE / INVENTORY_ENTRY_SIZE) {
+		maxTags = USB_CMD_DATA_SIZE / INVENTORY_ENTRY_SIZE;
+	}
+
+	AppendCrc14443a(hlta, 2);
+
+	iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+	clear_trace();
+	set_tracing(true);
+
+	LED_A_ON();
+
+	// the first round uses WUPA to also catch cards halted by an earlier command
+	iso14a_inventory_reqa = false;
+
+	while (count < maxTags) {
+		if (!iso14443a_select_card(NULL, &card, NULL, true, 0, true)) {
+			break;
+		}
+
+		// a tag ignoring HLTA would be resolved forever - stop on a repeated UID
+		if (count > 0 && memcmp(results + (count-1) * INVENTORY_ENTRY_SIZE + 1, card.uid, 10) == 0) {
+			break;
+		}
+
+		uint8_t *entry = results + count * INVENTORY_ENTRY_SIZE;
+		entry[0] = card.uidlen;
+		memcpy(entry + 1, card.uid, 10);
+		memcpy(entry + 11, card.atqa, 2);
+		entry[13] = card.sak;
+		count++;
+
+		// halt the resolved tag. No response is expected
+		ReaderTransmit(hlta, sizeof(hlta), NULL);
+
+		iso14a_inventory_reqa = true;
+	}
+
+	iso14a_inventory_reqa = false;
+
+	LED_B_ON();
+	cmd_send(CMD_ACK, count, 0, 0, results, count * INVENTORY_ENTRY_SIZE);
+	LED_B_OFF();
+
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	LEDsoff();
+}
+
+
+// Frame delay time of the last tag answer in carrier cycles (1/fc), derived
+// from the same timestamps the trace entries are built from. 0 is reserved
+// for "no answer", so a (theoretical) zero delay reports as 1.
+static uint16_t GetFrameDelayTime(void)
+{
+	uint32_t reader_end = (LastTimeProxToAirStart + LastProxToAirDuration) * 16 + DELAY_ARM2AIR_AS_READER;
+	uint32_t tag_start = Demod.startTime * 16 - DELAY_AIR2ARM_AS_READER;
+	if (tag_start <= reader_end) {
+		return 1;
+	}
+	uint32_t fdt = tag_start - reader_end;
+	return (fdt > 0xffff) ? 0xffff : fdt;
+}
+
+
+//-----------------------------------------------------------------------------
+// Timing harness for card/reader fingerprinting research: run many
+// WUPA / anticollision / select cycles back to back and record the frame
+// delay time of every card answer with carrier cycle resolution. Each cycle
+// stores three little endian uint16 values in BigBuf - the delay of the
+// ATQA, of the cascade level 1 anticollision answer and of the SAK
+// (0 = step failed, 0xffff = saturated) - for the client to download.
+// Collecting the samples on the device avoids the per-cycle USB round trip
+// and the USB timing jitter.
+//-----------------------------------------------------------------------------
+void ReaderIso14443aTiming(uint32_t cycles)
+{
+#define TIMING_REC_SIZE		6
+	uint8_t wupa[]    = { ISO14443A_CMD_WUPA };
+	uint8_t sel_all[] = { ISO14443A_CMD_ANTICOLL_OR_SELECT, 0x20 };
+	uint8_t sel_uid[] = { ISO14443A_CMD_ANTICOLL_OR_SELECT, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	uint8_t hlta[]    = { 0x50, 0x00, 0x00, 0x00 };
+	uint8_t resp[MAX_FRAME_SIZE];
+	uint8_t resp_par[MAX_PARITY_SIZE];
+
+	AppendCrc14443a(hlta, 2);
+
+	iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+	// the records take the place of the trace
+	set_tracing(false);
+	BigBuf_free();
+	uint8_t *results = BigBuf_get_addr();
+	uint32_t max_cycles = BigBuf_max_traceLen() / TIMING_REC_SIZE;
+	if (cycles == 0 || cycles > max_cycles) {
+		cycles = max_cycles;
+	}
+
+	LED_A_ON();
+
+	uint32_t done = 0;
+	while (done < cycles) {
+		uint16_t fdt_atqa = 0, fdt_uid = 0, fdt_sak = 0;
+
+		ReaderTransmitBitsPar(wupa, 7, NULL, NULL);
+		if (ReaderReceive(resp, resp_par)) {
+			fdt_atqa = GetFrameDelayTime();
+			ReaderTransmit(sel_all, sizeof(sel_all), NULL);
+			if (ReaderReceive(resp, resp_par) == 5) {
+				fdt_uid = GetFrameDelayTime();
+				memcpy(&sel_uid[2], resp, 5);
+				AppendCrc14443a(sel_uid, 7);
+				ReaderTransmit(sel_uid, sizeof(sel_uid), NULL);
+				if (ReaderReceive(resp, resp_par)) {
+					fdt_sak = GetFrameDelayTime();
+				}
+			}
+		}
+
+		uint8_t *rec = results + done * TIMING_REC_SIZE;
+		rec[0] = fdt_atqa & 0xff;
+		rec[1] = fdt_atqa >> 8;
+		rec[2] = fdt_uid & 0xff;
+		rec[3] = fdt_uid >> 8;
+		rec[4] = fdt_sak & 0xff;
+		rec[5] = fdt_sak >> 8;
+		done++;
+
+		// back to idle for the next cycle; WUPA wakes the halted card again
+		ReaderTransmit(hlta, sizeof(hlta), NULL);
+
+		WDT_HIT();
+		if (BUTTON_PRESS()) {
+			break;
+		}
+	}
+
+	LED_B_ON();
+	cmd_send(CMD_ACK, done, done * TIMING_REC_SIZE, 0, NULL, 0);
+	LED_B_OFF();
+
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	LEDsoff();
+}
+
+
 // Determine the distance between two nonces.
 // Assume that the difference is small, but we don't know which is first.
 // Therefore try in alternating directions.
@@ -2273,10 +2928,13 @@ void ReaderMifare(bool first_try)
 			SpinDelay(100);
 		}
 
+		PROF_ENTER(PROF_MF_SYNC);
 		if(!iso14443a_select_card(uid, NULL, &cuid, true, 0, true)) {
+			PROF_LEAVE(PROF_MF_SYNC);
 			if (MF_DBGLEVEL >= 1)   Dbprintf("Mifare: Can't select card");
 			continue;
 		}
+		PROF_LEAVE(PROF_MF_SYNC);
 		select_time = GetCountSspClk();
 
 		elapsed_prng_sequences = 1;
@@ -30,9 +30,13 @@ typedef struct {
 extern void GetParity(const uint8_t *pbtCmd, uint16_t len, uint8_t *par);
 extern void AppendCrc14443a(uint8_t *data, int len);
 
-extern void RAMFUNC SnoopIso14443a(uint8_t param);
+extern void RAMFUNC SnoopIso14443a(UsbCommand *c);
 extern void SimulateIso14443aTag(int tagType, int uid_1st, int uid_2nd, byte_t *data);
 extern void ReaderIso14443a(UsbCommand *c);
+extern void ReaderIso14443aBatch(UsbCommand *c);
+extern void ReaderTopazReadAll(UsbCommand *c);
+extern void Iso14443aInventory(UsbCommand *c);
+extern void ReaderIso14443aTiming(uint32_t cycles);
 extern void ReaderTransmit(uint8_t *frame, uint16_t len, uint32_t *timing);
 extern void ReaderTransmitBitsPar(uint8_t *frame, uint16_t bits, uint8_t *par, uint32_t *timing);
 extern void ReaderTransmitPar(uint8_t *frame, uint16_t len, uint8_t *par, uint32_t *timing);
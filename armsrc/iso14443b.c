@@ -1066,21 +1066,31 @@ void ReadSTMemoryIso14443b(uint32_t dwLast)
 			i = 0xff;
 		}
 		cmd1[1] = i;
-		ComputeCrc14443(CRC_14443_B, cmd1, 2, &cmd1[2], &cmd1[3]);
-		CodeAndTransmit14443bAsReader(cmd1, sizeof(cmd1));
-		ret = GetSamplesFor14443bDemod(RECEIVE_SAMPLES_TIMEOUT, true);
-		if (ret != 6) { // Check if we got an answer from the tag
-			FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-			DbpString("Expected 6 bytes from tag, got less...");
-			LEDsoff();
-			return;
-		}
-		// The check the CRC of the answer (use cmd1 as temporary variable):
-		ComputeCrc14443(CRC_14443_B, Demod.output, 4, &cmd1[2], &cmd1[3]);
-		if (cmd1[2] != Demod.output[4] || cmd1[3] != Demod.output[5]) {
-			Dbprintf("CRC Error reading block! Expected: %04x got: %04x",
-					(cmd1[2]<<8)+cmd1[3], (Demod.output[4]<<8)+Demod.output[5]);
-			// Do not return;, let's go on... (we should retry, maybe ?)
+		// A corrupt answer is retried right here at field timescales -
+		// far cheaper than handing the client a bad frame and paying a
+		// full USB round trip before the retry.
+		for (uint8_t tries = 0; ; tries++) {
+			ComputeCrc14443(CRC_14443_B, cmd1, 2, &cmd1[2], &cmd1[3]);
+			CodeAndTransmit14443bAsReader(cmd1, sizeof(cmd1));
+			ret = GetSamplesFor14443bDemod(RECEIVE_SAMPLES_TIMEOUT, true);
+			if (ret != 6) { // Check if we got an answer from the tag
+				FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+				DbpString("Expected 6 bytes from tag, got less...");
+				LEDsoff();
+				return;
+			}
+			// The check the CRC of the answer (use cmd1 as temporary variable):
+			ComputeCrc14443(CRC_14443_B, Demod.output, 4, &cmd1[2], &cmd1[3]);
+			if (cmd1[2] == Demod.output[4] && cmd1[3] == Demod.output[5]) {
+				if (tries)
+					Dbprintf("Block %02x ok after %d retries", i, tries);
+				break;
+			}
+			if (tries == 3) {
+				Dbprintf("CRC Error reading block, giving up after %d tries! Expected: %04x got: %04x",
+						tries + 1, (cmd1[2]<<8)+cmd1[3], (Demod.output[4]<<8)+Demod.output[5]);
+				break; // keep the block in the dump, flagged by the message
+			}
 		}
 		// Now print out the memory location:
 		Dbprintf("Address=%02x, Contents=%08x, CRC=%04x", i,
@@ -1285,7 +1295,137 @@ void SendRawCommand14443B(uint32_t datalen, uint32_t recv, uint8_t powerfield, u
 		FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
 		LED_D_OFF();
 	}
-	
+
+	LED_A_OFF();
+}
+
+//-----------------------------------------------------------------------------
+// Enumerate all ISO14443B tags in the field in one command. Each round probes
+// with REQB asking for 8 anticollision slots (the first round uses WUPB to
+// also catch tags halted by an earlier command), walks the slot markers, and
+// halts every tag that produced a clean ATQB with HLTB; halted tags ignore
+// the REQB of the following rounds, so tags that collided in a slot get a
+// fresh random pick next round. The list goes back in a single response as
+// arg[0] entries of [4 byte PUPI][4 byte App Data][3 byte Prot Info][1 pad].
+// When arg[1]&1 is set and at least one tag was found, the first tag is woken
+// up again and ATTRIB'ed, and the field stays on for higher-layer commands
+// (resp arg[1] = 1 when that session was established).
+//-----------------------------------------------------------------------------
+void Iso14443bInventory(UsbCommand *c)
+{
+#define INVENTORY_14B_ENTRY_SIZE	12
+#define INVENTORY_14B_SLOT_CODE		3	// 2^3 = 8 slots
+	uint16_t maxTags = c->arg[0] & 0xffff;
+	bool keepField = c->arg[1] & 1;
+	uint8_t results[USB_CMD_DATA_SIZE];
+	uint8_t reqb[] = { 0x05, 0x00, INVENTORY_14B_SLOT_CODE, 0x00, 0x00 };
+	uint8_t hltb[] = { 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	uint16_t count = 0;
+	bool sessionUp = false;
+
+	if (maxTags == 0 || maxTags > USB_CMD_DATA_SIZE / INVENTORY_14B_ENTRY_SIZE) {
+		maxTags = USB_CMD_DATA_SIZE / INVENTORY_14B_ENTRY_SIZE;
+	}
+
+	FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+	SetAdcMuxFor(GPIO_MUXSEL_HIPKD);
+
+	// switch field on and give the tags some time to power up
+	LED_D_ON();
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_MODE_SEND_SHALLOW_MOD);
+	FpgaSetupSsc(FPGA_MAJOR_MODE_HF_READER);
+	SpinDelay(20);
+
+	clear_trace();
+	set_tracing(true);
+
+	LED_A_ON();
+
+	bool wakeup = true;
+	bool progress = true;
+	while (count < maxTags && progress) {
+		progress = false;
+		uint16_t roundStart = count;
+
+		for (uint8_t slot = 1; slot <= (1 << INVENTORY_14B_SLOT_CODE) && count < maxTags; slot++) {
+			int ret;
+			if (slot == 1) {
+				// REQB/WUPB opens the round and doubles as slot 1
+				reqb[2] = (wakeup ? 0x08 : 0x00) | INVENTORY_14B_SLOT_CODE;
+				ComputeCrc14443(CRC_14443_B, reqb, 3, reqb + 3, reqb + 4);
+				CodeAndTransmit14443bAsReader(reqb, sizeof(reqb));
+			} else {
+				uint8_t marker[3] = { (uint8_t)((slot << 4) | 0x05), 0x00, 0x00 };
+				ComputeCrc14443(CRC_14443_B, marker, 1, marker + 1, marker + 2);
+				CodeAndTransmit14443bAsReader(marker, sizeof(marker));
+			}
+			ret = GetSamplesFor14443bDemod(RECEIVE_SAMPLES_TIMEOUT, true);
+			// ATQB too short (empty slot) or garbled by a collision?
+			if (ret < 14 || Demod.output[0] != 0x50) {
+				continue;
+			}
+
+			// a tag ignoring HLTB answers every round - drop re-reads
+			bool known = false;
+			for (uint16_t j = 0; j < count; j++) {
+				if (memcmp(results + j * INVENTORY_14B_ENTRY_SIZE, Demod.output + 1, 4) == 0) {
+					known = true;
+					break;
+				}
+			}
+			if (known) {
+				continue;
+			}
+
+			uint8_t *entry = results + count * INVENTORY_14B_ENTRY_SIZE;
+			memcpy(entry, Demod.output + 1, 4);		// PUPI
+			memcpy(entry + 4, Demod.output + 5, 4);	// Application Data
+			memcpy(entry + 8, Demod.output + 9, 3);	// Protocol Info
+			entry[11] = 0;
+			count++;
+			progress = true;
+		}
+
+		// halt this round's tags so they sit out the following rounds
+		for (uint16_t j = roundStart; j < count; j++) {
+			memcpy(hltb + 1, results + j * INVENTORY_14B_ENTRY_SIZE, 4);
+			ComputeCrc14443(CRC_14443_B, hltb, 5, hltb + 5, hltb + 6);
+			CodeAndTransmit14443bAsReader(hltb, sizeof(hltb));
+			GetSamplesFor14443bDemod(RECEIVE_SAMPLES_TIMEOUT, true);
+		}
+
+		wakeup = false;
+	}
+
+	if (keepField && count > 0) {
+		// wake the halted tags back up and ATTRIB the first PUPI; the
+		// others stay in READY and ignore the mismatching ATTRIB
+		uint8_t attrib[] = { 0x1D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00 };
+		reqb[2] = 0x08 | INVENTORY_14B_SLOT_CODE;
+		ComputeCrc14443(CRC_14443_B, reqb, 3, reqb + 3, reqb + 4);
+		CodeAndTransmit14443bAsReader(reqb, sizeof(reqb));
+		GetSamplesFor14443bDemod(RECEIVE_SAMPLES_TIMEOUT, true);
+
+		memcpy(attrib + 1, results, 4);
+		attrib[7] = results[9] & 0x0F;	// Protocol_Type from the stored ATQB
+		ComputeCrc14443(CRC_14443_B, attrib, 9, attrib + 9, attrib + 10);
+		CodeAndTransmit14443bAsReader(attrib, sizeof(attrib));
+		if (GetSamplesFor14443bDemod(RECEIVE_SAMPLES_TIMEOUT, true) >= 3) {
+			pcb_blocknum = 0;
+			sessionUp = true;
+		}
+	}
+
+	FpgaDisableTracing();
+
+	LED_B_ON();
+	cmd_send(CMD_ACK, count, sessionUp, 0, results, count * INVENTORY_14B_ENTRY_SIZE);
+	LED_B_OFF();
+
+	if (!sessionUp) {
+		FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+		LED_D_OFF();
+	}
 	LED_A_OFF();
 }
 
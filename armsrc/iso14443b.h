@@ -16,6 +16,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "usb_cmd.h"
+
 extern int iso14443b_apdu(uint8_t const *message, size_t message_length, uint8_t *response);
 extern void iso14443b_setup();
 extern int iso14443b_select_card();
@@ -23,5 +25,6 @@ extern void SimulateIso14443bTag(void);
 extern void ReadSTMemoryIso14443b(uint32_t);
 extern void SnoopIso14443b(void);
 extern void SendRawCommand14443B(uint32_t, uint32_t, uint8_t, uint8_t[]);
+extern void Iso14443bInventory(UsbCommand *c);
 
 #endif /* __ISO14443B_H */
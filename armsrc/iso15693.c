@@ -1451,15 +1451,21 @@ void AcquireRawAdcSamplesIso15693(void)
 }
 
 
-void SnoopIso15693(void)
+void SnoopIso15693(uint8_t param)
 {
+	// param:
+	// bit 0 - stream completed trace entries to the client while sniffing
+
+	bool streaming = (param & 0x01);
+
 	LED_A_ON();
-	
+
 	FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
 	BigBuf_free();
 
 	clear_trace();
 	set_tracing(true);
+	if (streaming) trace_stream_start();
 
 	// The DMA buffer, used to stream samples from the FPGA
 	uint16_t* dmaBuf = (uint16_t*)BigBuf_malloc(ISO15693_DMA_BUFFER_SIZE*sizeof(uint16_t));
@@ -1498,8 +1504,12 @@ void SnoopIso15693(void)
 	bool TagIsActive = false;
 	bool ReaderIsActive = false;
 	bool ExpectTagAnswer = false;
+	bool TraceFull = false;
 
-	// And now we loop, receiving samples.
+	// And now we loop, receiving samples. The DMA keeps streaming across
+	// decoded frames - tearing it down and restarting it after every frame
+	// (as this loop used to) discards the samples already in flight, which
+	// is enough to miss the next command of a fast inventory round.
 	for(;;) {
 		uint16_t behindBy = ((uint16_t*)AT91C_BASE_PDC_SSC->PDC_RPR - upTo) & (ISO15693_DMA_BUFFER_SIZE-1);
 
@@ -1527,47 +1537,59 @@ void SnoopIso15693(void)
 
 		if (!TagIsActive) {                                            // no need to try decoding reader data if the tag is sending
 			if (Handle15693SampleFromReader(snoopdata & 0x02, &DecodeReader)) {
-				FpgaDisableSscDma();
 				ExpectTagAnswer = true;
-				LogTrace_ISO15693(DecodeReader.output, DecodeReader.byteCount, samples*64, samples*64, NULL, true);
+				TraceFull = !LogTrace_ISO15693(DecodeReader.output, DecodeReader.byteCount, samples*64, samples*64, NULL, true);
 				/* And ready to receive another command. */
 				DecodeReaderReset(&DecodeReader);
 				/* And also reset the demod code, which might have been */
 				/* false-triggered by the commands from the reader. */
 				DecodeTagReset(&DecodeTag);
-				upTo = dmaBuf;
-				FpgaSetupSscDma((uint8_t*) dmaBuf, ISO15693_DMA_BUFFER_SIZE);
 			}
 			if (Handle15693SampleFromReader(snoopdata & 0x01, &DecodeReader)) {
-				FpgaDisableSscDma();
 				ExpectTagAnswer = true;
-				LogTrace_ISO15693(DecodeReader.output, DecodeReader.byteCount, samples*64, samples*64, NULL, true);
+				TraceFull = !LogTrace_ISO15693(DecodeReader.output, DecodeReader.byteCount, samples*64, samples*64, NULL, true);
 				/* And ready to receive another command. */
 				DecodeReaderReset(&DecodeReader);
 				/* And also reset the demod code, which might have been */
 				/* false-triggered by the commands from the reader. */
 				DecodeTagReset(&DecodeTag);
-				upTo = dmaBuf;
-				FpgaSetupSscDma((uint8_t*) dmaBuf, ISO15693_DMA_BUFFER_SIZE);
 			}
 			ReaderIsActive = (DecodeReader.state >= STATE_READER_AWAIT_2ND_RISING_EDGE_OF_SOF);
 		}
 
 		if (!ReaderIsActive && ExpectTagAnswer) {                       // no need to try decoding tag data if the reader is currently sending or no answer expected yet
 			if (Handle15693SamplesFromTag(snoopdata >> 2, &DecodeTag, true)) {
-				FpgaDisableSscDma();
 				//Use samples as a time measurement
-				LogTrace_ISO15693(DecodeTag.output, DecodeTag.len, samples*64, samples*64, NULL, false);
+				TraceFull = !LogTrace_ISO15693(DecodeTag.output, DecodeTag.len, samples*64, samples*64, NULL, false);
 				// And ready to receive another response.
 				DecodeTagReset(&DecodeTag);
 				DecodeReaderReset(&DecodeReader);
 				ExpectTagAnswer = false;
-				upTo = dmaBuf;
-				FpgaSetupSscDma((uint8_t*) dmaBuf, ISO15693_DMA_BUFFER_SIZE);
 			}
 			TagIsActive = (DecodeTag.state >= STATE_TAG_RECEIVING_DATA);
 		}
 
+		if (TraceFull) {                                               // no point in sampling on; the frames can no longer be stored
+			DbpString("Trace buffer full. Snoop stopped.");
+			break;
+		}
+
+		// In streaming mode, deliver the trace while the air interface is
+		// quiet. The USB transfer blocks far longer than the DMA buffer
+		// lasts, so the DMA and the decoders are re-armed afterwards -
+		// frames starting mid-flush are lost, which is why we wait for a
+		// quiet moment and flush well before the trace is full.
+		if (streaming && !TagIsActive && !ReaderIsActive && !ExpectTagAnswer
+				&& BigBuf_get_traceLen() > BigBuf_max_traceLen() / 2) {
+			FpgaDisableSscDma();
+			trace_stream_flush();
+			WDT_HIT();
+			DecodeReaderReset(&DecodeReader);
+			DecodeTagReset(&DecodeTag);
+			upTo = dmaBuf;
+			FpgaSetupSscDma((uint8_t*) dmaBuf, ISO15693_DMA_BUFFER_SIZE);
+		}
+
 	}
 
 	FpgaDisableSscDma();
@@ -1582,6 +1604,13 @@ void SnoopIso15693(void)
 	Dbprintf("  DecodeReader State: %d", DecodeReader.state);
 	Dbprintf("  DecodeReader byteCnt: %d", DecodeReader.byteCount);
 	Dbprintf("  Trace length: %d", BigBuf_get_traceLen());
+
+	if (streaming) {
+		trace_stream_flush();
+		Dbprintf("streamed %d trace bytes, %d entries dropped", trace_stream_sent_total(), trace_stream_dropped_total());
+		cmd_send(CMD_ACK, trace_stream_sent_total(), trace_stream_dropped_total(), 0, 0, 0);
+		trace_stream_stop();
+	}
 }
 
 
@@ -1883,6 +1912,114 @@ void ReaderIso15693(uint32_t parameter) {
 }
 
 
+// encode just an EOF - the reader sends this to close a slot and move the
+// tags on to the next one during a 16-slot inventory round
+static void CodeIso15693AsReaderEOF(void) {
+	ToSendReset();
+	ToSend[++ToSendMax] = 0x20; //0010 + 0000 padding
+	ToSendMax++;
+}
+
+// Full 16-slot anticollision inventory, resolved on the device (ISO15693-3
+// mask descent): fire one inventory round, listen in all 16 slots, push a
+// longer mask prefix for every slot that collided, and keep descending
+// until the field is enumerated. A multi-tag field is walked in a few
+// rounds of air time instead of one client round trip per tag.
+#define INV15_MAX_UIDS     64  // 64 * 8 bytes = one USB response
+#define INV15_MAX_PENDING  32  // unresolved mask prefixes; bounded by tag count
+
+void Iso15693Inventory16(void) {
+	LED_A_ON();
+
+	uint8_t recv[ISO15693_MAX_RESPONSE_LENGTH];
+	uint8_t cmd[13];  // flags, command, mask length, up to 8 mask bytes, crc
+
+	BigBuf_free();
+	uint8_t *uids = BigBuf_malloc(INV15_MAX_UIDS * 8);
+	uint8_t *pending = BigBuf_malloc(INV15_MAX_PENDING * 9); // 8 mask bytes + length
+
+	uint16_t nuids = 0;
+	uint16_t collisions = 0;
+	uint16_t rounds = 0;
+	uint8_t npend = 1;
+	bool first = true;
+	memset(pending, 0, 9);  // start with the empty mask
+
+	while (npend > 0 && nuids < INV15_MAX_UIDS) {
+		npend--;
+		uint8_t *mask = pending + npend * 9;
+		uint8_t masklen = mask[8];
+		uint8_t mbytes = (masklen + 7) / 8;
+
+		// inventory, high data rate, 16 slots (SLOT1 flag not set)
+		cmd[0] = ISO15693_REQ_DATARATE_HIGH | ISO15693_REQ_INVENTORY;
+		cmd[1] = ISO15693_INVENTORY;
+		cmd[2] = masklen;
+		memcpy(cmd + 3, mask, mbytes);
+		int datalen = Iso15693AddCrc(cmd, 3 + mbytes);
+		rounds++;
+
+		uint32_t eof_time = 0;
+		uint32_t start_time = 0;
+		int recvlen = SendDataTag(cmd, datalen, first, 1, recv, sizeof(recv), 0, &eof_time);
+		first = false;
+
+		for (uint8_t slot = 0; ; slot++) {
+			if (recvlen >= 12) {
+				uint16_t crc = Iso15693Crc(recv, recvlen - 2);
+				if (!(recv[0] & ISO15693_RES_ERROR)
+						&& recv[recvlen-2] == (crc & 0xff) && recv[recvlen-1] == (crc >> 8)) {
+					// valid response, store the UID unless already seen
+					bool dup = false;
+					for (uint16_t i = 0; i < nuids && !dup; i++)
+						dup = (memcmp(uids + i*8, recv + 2, 8) == 0);
+					if (!dup && nuids < INV15_MAX_UIDS) {
+						memcpy(uids + nuids*8, recv + 2, 8);
+						nuids++;
+					}
+				} else {
+					recvlen = -3; // broken frame: treat as collision below
+				}
+			}
+			if ((recvlen > 0 && recvlen < 12) || recvlen == -2 || recvlen == -3) {
+				// a tag answered but the frame did not decode: collision.
+				// descend: this slot's nibble extends the mask
+				collisions++;
+				if (masklen <= 60 && npend < INV15_MAX_PENDING) {
+					uint8_t *next = pending + npend * 9;
+					memcpy(next, mask, 8);
+					for (uint8_t b = 0; b < 4; b++)
+						if (slot & (1 << b))
+							next[(masklen + b) / 8] |= 1 << ((masklen + b) % 8);
+					next[8] = masklen + 4;
+					npend++;
+				}
+			}
+			if (slot == 15)
+				break;
+
+			// close this slot: a bare EOF moves the tags to the next one
+			start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+			CodeIso15693AsReaderEOF();
+			TransmitTo15693Tag(ToSend, ToSendMax, &start_time);
+			recvlen = GetIso15693AnswerFromTag(recv, sizeof(recv), ISO15693_READER_TIMEOUT, &eof_time, true);
+			if (recvlen == -1) // timeout: nobody home in this slot
+				eof_time = GetCountSspClk();
+		}
+
+		WDT_HIT();
+		if (BUTTON_PRESS())
+			break;
+	}
+
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	LED_D_OFF();
+	LED_A_OFF();
+
+	Dbprintf("inventory: %d tags, %d rounds, %d collisions", nuids, rounds, collisions);
+	cmd_send(CMD_ACK, nuids, collisions, rounds, uids, nuids * 8);
+}
+
 // Simulate an ISO15693 TAG.
 // Tag Data and infos are taken from emulator memory
 // Support all basic ISO15693 commands currently (11/2019) defined in common/protocols.h
@@ -32,9 +32,10 @@ int GetIso15693CommandFromReader(uint8_t *received, size_t max_len, uint32_t *eo
 void TransmitTo15693Tag(const uint8_t *cmd, int len, uint32_t *start_time);
 int GetIso15693AnswerFromTag(uint8_t* response, uint16_t max_len, uint16_t timeout, uint32_t *eof_time, bool recv_speed);
 int GetIso15693FAnswerFromTagFSK(uint8_t* response, uint16_t max_len, uint16_t timeout, uint32_t *eof_time, bool recv_speed);
-void SnoopIso15693(void);
+void SnoopIso15693(uint8_t param);
 void AcquireRawAdcSamplesIso15693(void);
 void ReaderIso15693(uint32_t parameter);
+void Iso15693Inventory16(void);
 void SimTagIso15693(uint32_t parameter, uint8_t *uid);
 void BruteforceIso15693Afi(uint32_t speed);
 void DirectTag15693Command(uint32_t datalen, uint32_t speed, uint32_t recv, uint8_t data[]);
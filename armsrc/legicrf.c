@@ -154,15 +154,17 @@ static inline void tx_bit(bool bit) {
 static void tx_frame(uint32_t frame, uint8_t len) {
   FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_MODE_SEND_FULL_MOD);
 
+  // obfuscate the whole frame during the tx wait so the timed loop below
+  // only has to shift bits out
+  frame ^= legic_prng_get_bits(len);
+
   // wait for next tx timeslot
   last_frame_end += RWD_FRAME_WAIT;
   while(GET_TICKS < last_frame_end) { };
 
   // transmit frame, MSB first
   for(uint8_t i = 0; i < len; ++i) {
-    bool bit = (frame >> i) & 0x01;
-    tx_bit(bit ^ legic_prng_get_bit());
-    legic_prng_forward(1);
+    tx_bit((frame >> i) & 0x01);
   };
 
   // add pause to mark end of the frame
@@ -175,21 +177,24 @@ static void tx_frame(uint32_t frame, uint8_t len) {
 static uint32_t rx_frame(uint8_t len) {
   FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_SUBCARRIER_212_KHZ | FPGA_HF_READER_MODE_RECEIVE_IQ);
 
+  // the keystream doesn't depend on the received bits, so draw it during
+  // the rx wait and deobfuscate the frame in one go afterwards
+  uint32_t keystream = legic_prng_get_bits(len);
+
   // hold sampling until card is expected to respond
   last_frame_end += TAG_FRAME_WAIT;
   while(GET_TICKS < last_frame_end) { };
 
   uint32_t frame = 0;
   for(uint8_t i = 0; i < len; ++i) {
-    frame |= (rx_bit() ^ legic_prng_get_bit()) << i;
-    legic_prng_forward(1);
+    frame |= (uint32_t)rx_bit() << i;
 
     // rx_bit runs only 95us, resync to TAG_BIT_PERIOD
     last_frame_end += TAG_BIT_PERIOD;
     while(GET_TICKS < last_frame_end) { };
   }
 
-  return frame;
+  return frame ^ keystream;
 }
 
 static bool rx_ack() {
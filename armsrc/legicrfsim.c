@@ -153,16 +153,17 @@ static inline void tx_bit(bool bit) {
 //-----------------------------------------------------------------------------
 
 static void tx_frame(uint32_t frame, uint8_t len) {
-  // wait for next tx timeslot
+  // wait for next tx timeslot; the prng forward and the obfuscation of the
+  // whole frame happen during the wait, so the timed loop below only has
+  // to shift bits out
   last_frame_end += TAG_FRAME_WAIT;
   legic_prng_forward(TAG_FRAME_WAIT/TAG_BIT_PERIOD - 1);
+  frame ^= legic_prng_get_bits(len);
   while(GetCountSspClk() < last_frame_end) { };
 
   // transmit frame, MSB first
   for(uint8_t i = 0; i < len; ++i) {
-    bool bit = (frame >> i) & 0x01;
-    tx_bit(bit ^ legic_prng_get_bit());
-    legic_prng_forward(1);
+    tx_bit((frame >> i) & 0x01);
   };
 
   // disable subcarrier
@@ -435,6 +435,11 @@ void WriteTItag(uint32_t idhi, uint32_t idlo, uint16_t crc)
 	DbpString("Now use `lf ti read` to check");
 }
 
+// Optional per-repetition hook: called between two replays of the buffer
+// (coil shorted), may rewrite BigBuf and return the new period, or 0 to keep
+// the current one. Used by CmdLFSynthSim for dynamic (rolling code) tags.
+static int (*lf_sim_refill)(void) = NULL;
+
 void SimulateTagLowFrequency(int period, int gap, int ledcontrol)
 {
 	int i;
@@ -499,6 +504,12 @@ void SimulateTagLowFrequency(int period, int gap, int ledcontrol)
 		if(i == period) {
 
 			i = 0;
+			if (lf_sim_refill) {
+				SHORT_COIL();
+				int refilled = lf_sim_refill();
+				if (refilled > 0)
+					period = refilled;
+			}
 			if (gap) {
 				SHORT_COIL();
 				SpinDelayUs(gap);
@@ -861,6 +872,156 @@ void CmdPSKsimTag(uint16_t arg1, uint16_t arg2, size_t size, uint8_t *BitStream)
 	if (ledcontrol) LED_A_OFF();
 }
 
+// On-device waveform synthesis (CMD_LF_SYNTH_SIM). The client uploads a
+// packed bit template plus modulation parameters in a single command and the
+// device expands it into BigBuf, instead of pushing tens of KB of raw
+// samples. An optional field of the template (mutate offset/width) is
+// refilled from a seeded xorshift32 PRNG before every repetition, so rolling
+// code style simulations stay dynamic without further USB traffic.
+#define LF_SYNTH_HDR_LEN  4
+#define LF_SYNTH_MAX_BITS ((USB_CMD_DATA_SIZE - LF_SYNTH_HDR_LEN) * 8)
+
+static struct {
+	uint8_t modulation;		// 0=ask/man 1=ask/raw(nrz) 2=biphase 3=psk 4=fsk
+	uint8_t clock;
+	uint8_t carrier;		// psk: wave length, fsk: fcHigh<<4 | fcLow
+	uint8_t invert;
+	uint16_t bitlen;
+	uint16_t mutate_offset;
+	uint8_t mutate_width;		// 0 = static simulation
+	uint32_t prng;
+	uint8_t bits[USB_CMD_DATA_SIZE - LF_SYNTH_HDR_LEN];
+} synth;
+
+static uint8_t SynthGetBit(uint16_t i)
+{
+	return (synth.bits[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+static void SynthSetBit(uint16_t i, uint8_t v)
+{
+	uint8_t mask = 1 << (7 - (i & 7));
+	if (v)
+		synth.bits[i >> 3] |= mask;
+	else
+		synth.bits[i >> 3] &= ~mask;
+}
+
+// expand the bit template into BigBuf, returns the number of samples
+static int SynthExpand(void)
+{
+	int n = 0;
+	uint8_t phase = 0;
+	uint8_t curPhase = 0;
+	uint16_t modCnt = 0;
+	uint8_t fcHigh = synth.carrier >> 4;
+	uint8_t fcLow = synth.carrier & 0x0F;
+	// worst case samples appended per bit: a clock, plus a psk phase change
+	// wave, plus a fsk modifier wave; biphase may need a full second pass
+	size_t maxlen = BigBuf_max_traceLen();
+	size_t reserve = 2 * synth.clock + synth.carrier;
+	if (synth.modulation == 2)
+		maxlen /= 2;
+
+	for (uint16_t i = 0; i < synth.bitlen; i++) {
+		if ((size_t)n + reserve > maxlen) {
+			Dbprintf("Synth sim: waveform truncated at bit %d", i);
+			break;
+		}
+		uint8_t b = SynthGetBit(i) ^ synth.invert;
+		switch (synth.modulation) {
+			case 0:
+				askSimBit(b, &n, synth.clock, 1);
+				break;
+			case 1:
+				askSimBit(b, &n, synth.clock, 0);
+				break;
+			case 2:
+				biphaseSimBit(b, &n, synth.clock, &phase);
+				break;
+			case 3:
+				if (b == curPhase)
+					pskSimBit(synth.carrier, &n, synth.clock, &curPhase, false);
+				else
+					pskSimBit(synth.carrier, &n, synth.clock, &curPhase, true);
+				break;
+			case 4:
+				fcAll(b ? fcHigh : fcLow, &n, synth.clock, &modCnt);
+				break;
+			default:
+				return 0;
+		}
+	}
+	// as in CmdASKsimTag: run a second, inverted biphase pass so the phase
+	// lines up when the buffer repeats
+	if (synth.modulation == 2 && phase == 1) {
+		for (uint16_t i = 0; i < synth.bitlen; i++) {
+			biphaseSimBit(SynthGetBit(i) ^ synth.invert, &n, synth.clock, &phase);
+		}
+	}
+	return n;
+}
+
+// per-repetition hook: roll the PRNG, rewrite the mutating field, re-expand
+static int SynthRefill(void)
+{
+	uint32_t x = synth.prng;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	synth.prng = x;
+	for (uint8_t i = 0; i < synth.mutate_width; i++) {
+		SynthSetBit(synth.mutate_offset + i, (x >> (synth.mutate_width - 1 - i)) & 1);
+	}
+	return SynthExpand();
+}
+
+// args: arg0 = modulation | clock<<8 | carrier<<16 | invert<<24,
+//       arg1 = bit count | mutate offset<<16, arg2 = PRNG seed.
+// data[0] = mutate width in bits, template packed MSB first from data[4]
+void CmdLFSynthSim(uint32_t arg0, uint32_t arg1, uint32_t seed, uint8_t *data)
+{
+	int ledcontrol = 1;
+
+	synth.modulation = arg0 & 0xFF;
+	synth.clock = (arg0 >> 8) & 0xFF;
+	synth.carrier = (arg0 >> 16) & 0xFF;
+	synth.invert = (arg0 >> 24) & 1;
+	synth.bitlen = arg1 & 0xFFFF;
+	synth.mutate_offset = (arg1 >> 16) & 0xFFFF;
+	synth.mutate_width = data[0];
+	synth.prng = seed;
+
+	if (synth.bitlen > LF_SYNTH_MAX_BITS)
+		synth.bitlen = LF_SYNTH_MAX_BITS;
+	if (synth.mutate_width > 32)
+		synth.mutate_width = 32;
+	if (synth.mutate_offset + synth.mutate_width > synth.bitlen)
+		synth.mutate_width = 0;
+	memcpy(synth.bits, data + LF_SYNTH_HDR_LEN, sizeof(synth.bits));
+
+	// set LF so we don't kill the bigbuf we are setting with simulation data.
+	FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
+
+	int n = SynthExpand();
+	if (n == 0) {
+		DbpString("Synth sim: nothing to simulate");
+		return;
+	}
+	Dbprintf("Synth sim: mod %d, clk %d, carrier %d, invert %d, %d bits (mutating %d @ %d), n: %d",
+		synth.modulation, synth.clock, synth.carrier, synth.invert,
+		synth.bitlen, synth.mutate_width, synth.mutate_offset, n);
+
+	if (synth.mutate_width > 0)
+		lf_sim_refill = SynthRefill;
+	if (ledcontrol)
+		LED_A_ON();
+	SimulateTagLowFrequency(n, 0, ledcontrol);
+	lf_sim_refill = NULL;
+	if (ledcontrol)
+		LED_A_OFF();
+}
+
 // loop to get raw HID waveform then FSK demodulate the TAG ID from it
 void CmdHIDdemodFSK(int findone, int *high2, int *high, int *low, int ledcontrol)
 {
@@ -966,6 +1127,63 @@ void CmdHIDdemodFSK(int findone, int *high2, int *high, int *low, int ledcontrol
 	if (ledcontrol) LED_A_OFF();
 }
 
+// Continuous HID beacon logger: like CmdHIDdemodFSK, but every decode is
+// pushed to the client as a timestamped CMD_HID_BEACON_EVENT instead of a
+// debug print, so a walk-around logger only ever sees one small packet per
+// read. A tag sitting in the field repeats its frame every few tens of ms;
+// identical decodes within HID_BEACON_DEDUP_MS of the last pushed event are
+// suppressed (and counted), so a badge held in the field shows up as one
+// event per second rather than thirty. Runs until the button is pressed or
+// the client sends a command; the final ACK reports the suppressed count.
+#define HID_BEACON_DEDUP_MS	1000
+
+void CmdHIDbeaconFSK(void)
+{
+	uint8_t *dest = BigBuf_get_addr();
+	size_t size;
+	uint32_t hi2 = 0, hi = 0, lo = 0;
+	int idx = 0;
+	int dummyIdx = 0;
+	uint32_t last_hi2 = 0, last_hi = 0, last_lo = 0;
+	uint32_t last_sent = 0;
+	uint32_t suppressed = 0;
+	bool have_last = false;
+
+	LFSetupFPGAForADC(95, true);
+	BigBuf_Clear_keep_EM();
+
+	while(!BUTTON_PRESS() && !usb_poll_validate_length()) {
+		WDT_HIT();
+		LED_A_ON();
+
+		DoAcquisition_default(-1,true);
+		size = 50*128*2; //big enough to catch 2 sequences of largest format
+		idx = HIDdemodFSK(dest, &size, &hi2, &hi, &lo, &dummyIdx);
+
+		if (idx>0 && lo>0 && (size==96 || size==192)){
+			uint32_t now = GetTickCount();
+			if (have_last && hi2 == last_hi2 && hi == last_hi && lo == last_lo
+					&& now - last_sent < HID_BEACON_DEDUP_MS) {
+				suppressed++;
+			} else {
+				cmd_send(CMD_HID_BEACON_EVENT, now,
+						((uint64_t)hi2 << 32) | hi, lo, 0, 0);
+				last_hi2 = hi2;
+				last_hi = hi;
+				last_lo = lo;
+				last_sent = now;
+				have_last = true;
+			}
+		}
+		hi2 = hi = lo = idx = 0;
+	}
+
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	LED_A_OFF();
+	cmd_send(CMD_ACK, 0, 0, suppressed, 0, 0);
+	DbpString("Stopped");
+}
+
 // loop to get raw HID waveform then FSK demodulate the TAG ID from it
 void CmdAWIDdemodFSK(int findone, int *high, int *low, int ledcontrol)
 {
@@ -1063,6 +1281,7 @@ void CmdEM410xdemod(int findone, int *high, int *low, int ledcontrol)
 
 	size_t size=0, idx=0;
 	int clk=0, invert=0, errCnt=0, maxErr=20;
+	int found=0;
 	uint32_t hi=0;
 	uint64_t lo=0;
 	//clear read buffer
@@ -1105,8 +1324,9 @@ void CmdEM410xdemod(int findone, int *high, int *low, int ledcontrol)
 
 			if (findone){
 				if (ledcontrol) LED_A_OFF();
-				*high=lo>>32;
-				*low=lo & 0xFFFFFFFF;
+				if (high) *high=lo>>32;
+				if (low) *low=lo & 0xFFFFFFFF;
+				found = 1;
 				break;
 			}
 		}
@@ -1117,6 +1337,10 @@ void CmdEM410xdemod(int findone, int *high, int *low, int ledcontrol)
 	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
 	DbpString("Stopped");
 	if (ledcontrol) LED_A_OFF();
+	// in findone mode the client waits for the decoded ID instead of
+	// downloading and demodulating the sample buffer itself
+	if (findone)
+		cmd_send(CMD_ACK, found, hi, lo, NULL, 0);
 }
 
 void CmdIOdemodFSK(int findone, int *high, int *low, int ledcontrol)
@@ -1515,6 +1739,58 @@ void T55xxWriteBlock(uint32_t Data, uint32_t Block, uint32_t Pwd, uint8_t arg) {
 	LED_A_OFF ();
 }
 
+// Write several blocks back-to-back in one field session ('lf t55xx wipe'
+// and cloning flows). Each entry in data is 1 byte block number followed by
+// 4 bytes of block data. After each write the block is read back and the
+// modulation depth of the response measured - a block that stayed silent
+// never got programmed. The per-block metrics are returned for the client
+// to judge; checking the data content needs the full demodulator there.
+void T55xxWriteBlockBulk(uint8_t arg0, uint8_t num_blocks, uint32_t Pwd, uint8_t *data) {
+
+	LED_A_ON();
+
+	uint32_t metrics[USB_CMD_DATA_SIZE / 5];
+
+	uint8_t wr_arg = arg0 & (0x01 | 0x02 | 0x18);	// pwdmode, page, downlink mode
+	uint8_t rd_arg = wr_arg | 0x40;			// read call, no data packet
+
+	if (num_blocks > USB_CMD_DATA_SIZE / 5)
+		num_blocks = USB_CMD_DATA_SIZE / 5;
+
+	for (uint8_t b = 0; b < num_blocks; b++) {
+		WDT_HIT();
+
+		uint8_t block = data[5*b] & 0x7;
+		uint32_t blockdata = (uint32_t)data[5*b+1] << 24 | (uint32_t)data[5*b+2] << 16 |
+		                     (uint32_t)data[5*b+3] << 8 | (uint32_t)data[5*b+4];
+
+		T55xx_SendCMD(blockdata, block, Pwd, wr_arg);
+
+		// programming takes ~5.6ms for a T5577 and ~18ms for an E5550;
+		// keep the field on with the same margin as the single write
+		TurnReadLFOn(20 * 1000);
+
+		// read the block back and measure the response
+		BigBuf_Clear_ext(false);
+		T55xx_SendCMD(0, block, Pwd, rd_arg);
+		TurnReadLFOn(210*8);
+		DoPartialAcquisition(0, true, 4096, 0);
+		FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+		uint8_t *buf = BigBuf_get_addr();
+		uint32_t metric = 0;
+		for (uint32_t i = 0; i < 4096; i++) {
+			int v = (int)buf[i] - 128;
+			metric += (v < 0) ? -v : v;
+		}
+		metrics[b] = metric;
+	}
+
+	cmd_send(CMD_ACK, num_blocks, 0, 0, (uint8_t*)metrics, num_blocks * sizeof(uint32_t));
+
+	LED_A_OFF();
+}
+
 // Read one card block in page [page]
 void T55xxReadBlock (uint16_t arg0, uint8_t Block, uint32_t Pwd) {//, struct T55xx_Timing *Timing) {
 
@@ -1587,6 +1863,69 @@ void T55xxWakeUp(uint32_t Pwd){
 	TurnReadLFOn(20*1000);
 }
 
+// On-device batched password check for 'lf t55xx bruteforce'. For each
+// candidate we issue a password read of the configuration block and measure
+// the modulation depth of the response: a wrong password leaves the tag
+// silent while a correct one has it stream block data. The candidate with
+// the strongest response is reported back for the client to verify with a
+// full demodulation, avoiding one USB round trip per password.
+void T55xxChkPwds(uint8_t arg0, uint32_t num_pwds, uint8_t *pwds) {
+
+	LED_A_ON();
+
+	uint32_t best_metric = 0;
+	uint32_t best_idx = 0;
+	uint32_t checked = 0;
+
+	if (num_pwds > USB_CMD_DATA_SIZE / 4)
+		num_pwds = USB_CMD_DATA_SIZE / 4;
+
+	// Password read call, no data packet, plus the downlink mode bits
+	// (see bit layout in T55xx_SendCMD)
+	uint8_t arg = 0x01 | 0x40 | (arg0 & 0x18);
+
+	SendProgressStart();
+
+	for (uint32_t c = 0; c < num_pwds; c++) {
+		if (BUTTON_PRESS()) break;
+		WDT_HIT();
+
+		SendProgress(c, num_pwds);
+
+		uint32_t pwd = (uint32_t)pwds[4*c] << 24 | (uint32_t)pwds[4*c+1] << 16 |
+		               (uint32_t)pwds[4*c+2] << 8 | (uint32_t)pwds[4*c+3];
+
+		BigBuf_Clear_ext(false);
+
+		T55xx_SendCMD(0, 0, pwd, arg);
+
+		// Same field-on delay and sample count as T55xxReadBlock
+		TurnReadLFOn(210*8);
+		DoPartialAcquisition(0, true, 6000, 0);
+		FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+		uint8_t *buf = BigBuf_get_addr();
+		uint32_t metric = 0;
+		for (uint32_t i = 0; i < 4096; i++) {
+			int v = (int)buf[i] - 128;
+			metric += (v < 0) ? -v : v;
+		}
+		if (metric > best_metric) {
+			best_metric = metric;
+			best_idx = c;
+		}
+		checked++;
+
+		// let the tag power down between candidates so a wrong password
+		// does not leave it in a half-started state
+		WaitMS(5);
+	}
+
+	cmd_send(CMD_ACK, best_metric, best_idx, checked, 0, 0);
+
+	LED_A_OFF();
+}
+
 /*-------------- Cloning routines -----------*/
 
 void WriteT55xx(uint32_t *blockdata, uint8_t startblock, uint8_t numblocks) {
@@ -16,6 +16,11 @@
 
 sample_config config = { 1, 8, 1, 95, 0, 0 } ;
 
+// Bumped whenever the effective sampling config changes. The client caches
+// the generation it last acknowledged and skips re-sending an identical
+// config instead of round-tripping the full sample_config every time.
+static uint32_t config_generation = 1;
+
 void printConfig()
 {
 	Dbprintf("LF Sampling config: ");
@@ -36,22 +41,37 @@ void printConfig()
  * such as functions to read the UID from a prox tag or similar.
  *
  * Values set to '0' implies no change (except for averaging, threshold, samples_to_skip)
+ * Applying a config identical to the active one is a no-op.
  * @brief setSamplingConfig
  * @param sc
+ * @return the config generation number (increments on every actual change)
  */
-void setSamplingConfig(uint8_t *config_data) {
+uint32_t setSamplingConfig(uint8_t *config_data) {
 	sample_config *sc = (sample_config *)config_data;
-	if (sc->divisor != 0) config.divisor = sc->divisor;
-	if (sc->bits_per_sample != 0) config.bits_per_sample = sc->bits_per_sample;
-	if (sc->decimation != 0) config.decimation = sc->decimation;
-	if (sc->trigger_threshold != -1) config.trigger_threshold = sc->trigger_threshold;
-	if (sc->samples_to_skip != -1) config.samples_to_skip = sc->samples_to_skip;
+	sample_config new_config = config;
+
+	if (sc->divisor != 0) new_config.divisor = sc->divisor;
+	if (sc->bits_per_sample != 0) new_config.bits_per_sample = sc->bits_per_sample;
+	if (sc->decimation != 0) new_config.decimation = sc->decimation;
+	if (sc->trigger_threshold != -1) new_config.trigger_threshold = sc->trigger_threshold;
+	if (sc->samples_to_skip != -1) new_config.samples_to_skip = sc->samples_to_skip;
+
+	new_config.averaging = sc->averaging;
+	if (new_config.bits_per_sample > 8)	new_config.bits_per_sample = 8;
+	if (new_config.decimation < 1)	new_config.decimation = 1;
 
-	config.averaging= sc->averaging;
-	if (config.bits_per_sample > 8)	config.bits_per_sample = 8;
-	if (config.decimation < 1)	config.decimation = 1;
+	if (memcmp(&new_config, &config, sizeof(sample_config)) == 0) {
+		return config_generation;	// nothing changed
+	}
 
+	config = new_config;
+	config_generation++;
 	printConfig();
+	return config_generation;
+}
+
+uint32_t getSamplingConfigGeneration(void) {
+	return config_generation;
 }
 
 sample_config* getSamplingConfig()
@@ -89,19 +109,30 @@ void pushBit( BitstreamOut* stream, uint8_t bit)
 void LFSetupFPGAForADC(int divisor, bool lf_field)
 {
 	FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
+
+	uint16_t fpga_divisor;
 	if ( (divisor == 1) || (divisor < 0) || (divisor > 255) )
-		FpgaSendCommand(FPGA_CMD_SET_DIVISOR, 88); //134.8Khz
+		fpga_divisor = 88; //134.8Khz
 	else if (divisor == 0)
-		FpgaSendCommand(FPGA_CMD_SET_DIVISOR, 95); //125Khz
+		fpga_divisor = 95; //125Khz
 	else
-		FpgaSendCommand(FPGA_CMD_SET_DIVISOR, divisor);
-
-	FpgaWriteConfWord(FPGA_MAJOR_MODE_LF_ADC | (lf_field ? FPGA_LF_ADC_READER_FIELD : 0));
-
-	// Connect the A/D to the peak-detected low-frequency path.
-	SetAdcMuxFor(GPIO_MUXSEL_LOPKD);
-	// Give it a bit of time for the resonant antenna to settle.
-	SpinDelay(50);
+		fpga_divisor = divisor;
+
+	uint16_t conf_word = FPGA_MAJOR_MODE_LF_ADC | (lf_field ? FPGA_LF_ADC_READER_FIELD : 0);
+
+	// If the FPGA is already in exactly this configuration the field never
+	// dropped, so there is nothing to settle: skip the reconfiguration and
+	// its delay. Saves ~50ms per read in multi-read LF sequences.
+	if (fpga_divisor != FpgaGetLFDivisor() || conf_word != FpgaGetConfWord()) {
+		FpgaSendCommand(FPGA_CMD_SET_DIVISOR, fpga_divisor);
+		FpgaWriteConfWord(conf_word);
+		// Connect the A/D to the peak-detected low-frequency path.
+		SetAdcMuxFor(GPIO_MUXSEL_LOPKD);
+		// Give it a bit of time for the resonant antenna to settle.
+		SpinDelay(50);
+	} else {
+		SetAdcMuxFor(GPIO_MUXSEL_LOPKD);
+	}
 	// Now set up the SSC to get the ADC samples that are now streaming at us.
 	FpgaSetupSsc(FPGA_MAJOR_MODE_LF_ADC);
 }
@@ -251,6 +282,61 @@ uint32_t ReadLF(bool activeField, bool silent, int sample_size)
 	return DoAcquisition_config(silent, sample_size);
 }
 
+/**
+* Cheap post-acquisition signal statistics for the client's demod scheduler:
+* the dominant interval between zero crossings (in stored samples) and the
+* number of crossings seen, packed as (interval << 16) | crossings. Costs one
+* pass over the buffer right after acquisition while the samples are still
+* warm. Only meaningful for full 8-bit samples; zero means "no stats".
+**/
+static uint32_t lf_signal_stats = 0;
+
+uint32_t getLFSignalStats(void)
+{
+	return lf_signal_stats;
+}
+
+static void computeLFSignalStats(uint8_t *dest, uint32_t n)
+{
+	lf_signal_stats = 0;
+	if (n < 256) return;
+
+	uint32_t mean = 0;
+	for (uint32_t i = 0; i < n; i++)
+		mean += dest[i];
+	mean /= n;
+
+	// schmitt-trigger the samples around the mean and histogram the
+	// intervals between state flips
+	uint16_t hist[128] = {0};
+	uint32_t crossings = 0;
+	uint32_t last = 0;
+	int state = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		int newstate = state;
+		if (dest[i] > mean + 4) newstate = 1;
+		else if (dest[i] + 4 < mean) newstate = -1;
+		if (newstate == state) continue;
+		if (state != 0) {
+			crossings++;
+			uint32_t len = i - last;
+			if (len < 128) hist[len]++;
+		}
+		last = i;
+		state = newstate;
+	}
+
+	uint32_t best = 0, bestcnt = 0;
+	for (uint32_t k = 1; k < 128; k++) {
+		if (hist[k] > bestcnt) {
+			bestcnt = hist[k];
+			best = k;
+		}
+	}
+	if (crossings > 0xFFFF) crossings = 0xFFFF;
+	lf_signal_stats = (best << 16) | crossings;
+}
+
 /**
 * Initializes the FPGA for reader-mode (field on), and acquires the samples.
 * @return number of bits sampled
@@ -258,6 +344,10 @@ uint32_t ReadLF(bool activeField, bool silent, int sample_size)
 uint32_t SampleLF(bool printCfg, int sample_size)
 {
 	uint32_t ret = ReadLF(true, printCfg, sample_size);
+	if (config.bits_per_sample == 8)
+		computeLFSignalStats(BigBuf_get_addr(), ret >> 3);
+	else
+		lf_signal_stats = 0;
 	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
 	return ret;
 }
@@ -273,6 +363,190 @@ uint32_t SnoopLF()
 	return ret;
 }
 
+/**
+* Streaming acquisition: the SSC is read by the PDC into two DMA buffers used
+* ping-pong fashion, and each completed buffer is pushed to the client over USB
+* while the other one fills. Capture length is therefore not capped by BigBuf
+* and there are no gaps between chunks. Samples are streamed raw (8 bits per
+* sample, no decimation/averaging) at the configured divisor.
+* @param activeField - true for reader mode (field on), false for snoop mode
+* @param max_samples - stop after this many samples, 0 = run until button press
+* @return total number of samples streamed
+**/
+uint32_t StreamLF(bool activeField, uint32_t max_samples)
+{
+	uint32_t total = 0;
+
+	uint8_t *buf = BigBuf_malloc(2 * USB_CMD_DATA_SIZE);
+	if (buf == NULL) {
+		Dbprintf("StreamLF: no memory for DMA buffers");
+		cmd_send(CMD_ACK, 0, 0, 0, 0, 0);
+		return 0;
+	}
+	uint8_t *this_buf = buf;
+
+	LFSetupFPGAForADC(config.divisor, activeField);
+
+	AT91C_BASE_PDC_SSC->PDC_PTCR = AT91C_PDC_RXTDIS;   // Disable DMA Transfer
+	AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t)this_buf;  // start transfer to this memory address
+	AT91C_BASE_PDC_SSC->PDC_RCR = USB_CMD_DATA_SIZE;   // transfer this many samples
+	buf[0] = (uint8_t)AT91C_BASE_SSC->SSC_RHR;         // clear receive register
+	AT91C_BASE_PDC_SSC->PDC_PTCR = AT91C_PDC_RXTEN;    // Start DMA transfer
+
+	LED_B_ON();
+	for (;;) {
+		// prepare the next DMA transfer into the other buffer
+		uint8_t *next_buf = (this_buf == buf) ? buf + USB_CMD_DATA_SIZE : buf;
+		AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t)next_buf;
+		AT91C_BASE_PDC_SSC->PDC_RNCR = USB_CMD_DATA_SIZE;
+
+		// wait until the PDC has switched buffers, i.e. this_buf is full
+		bool aborted = false;
+		while (AT91C_BASE_PDC_SSC->PDC_RNCR != 0) {
+			WDT_HIT();
+			if (BUTTON_PRESS() || usb_poll_validate_length()) {
+				aborted = true;
+				break;
+			}
+		}
+		if (aborted) break;	// a partially filled buffer is discarded
+
+		// ship the filled buffer while the DMA keeps sampling into the other
+		cmd_send(CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K, total, USB_CMD_DATA_SIZE, 0, this_buf, USB_CMD_DATA_SIZE);
+		total += USB_CMD_DATA_SIZE;
+		this_buf = next_buf;
+
+		if (max_samples != 0 && total >= max_samples) break;
+	}
+	AT91C_BASE_PDC_SSC->PDC_PTCR = AT91C_PDC_RXTDIS;
+	LED_B_OFF();
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	BigBuf_release(buf);
+
+	Dbprintf("StreamLF: streamed %d samples", total);
+	cmd_send(CMD_ACK, total, 0, 0, 0, 0);
+	return total;
+}
+
+// number of consecutive quiescent samples at the current rate before the
+// decimation doubles, and the ceiling it ramps towards
+#define SMART_QUIET_RAMP	256
+#define SMART_DECIMATION_MAX	32
+
+static void reverse_bytes(uint8_t *buf, uint32_t len)
+{
+	for (uint32_t i = 0, j = len - 1; i < j; i++, j--) {
+		uint8_t tmp = buf[i];
+		buf[i] = buf[j];
+		buf[j] = tmp;
+	}
+}
+
+/**
+ * Triggered acquisition for sparse LF traffic (e.g. access control polling
+ * bursts). Differences to DoAcquisition():
+ * - before the trigger fires, samples go into a circular pre-trigger window
+ *   at the start of BigBuf, so the capture includes the signal leading up to
+ *   the edge that fired the trigger instead of starting on it
+ * - once triggered, quiescent stretches (samples within trigger_threshold of
+ *   the 128 midpoint) ramp the decimation up stepwise; activity snaps it back
+ *   to full rate. Idle gaps between bursts therefore cost a fraction of the
+ *   buffer, at the price of a compressed time axis inside those gaps.
+ * Samples are stored at 8 bits, no averaging.
+ * @param trigger_threshold - as in DoAcquisition(). <= 0 records immediately.
+ * @param pretrig_len - size of the pre-trigger window in samples
+ * @return the number of bits occupied by the samples.
+ */
+uint32_t DoAcquisitionSmart(int trigger_threshold, uint32_t pretrig_len, bool silent, int bufsize)
+{
+	uint8_t *dest = BigBuf_get_addr();
+	bufsize = (bufsize > 0 && bufsize < BigBuf_max_traceLen()) ? bufsize : BigBuf_max_traceLen();
+
+	if (pretrig_len > (uint32_t)bufsize / 4) pretrig_len = bufsize / 4;
+
+	bool triggered = (trigger_threshold <= 0);
+	uint32_t n = 0;			// samples stored
+	uint32_t pre_fill = 0, pre_pos = 0;
+	uint32_t decimation = 1, decim_counter = 0;
+	uint32_t quiet_run = 0;
+	uint8_t sample;
+
+	while (!BUTTON_PRESS() && !usb_poll_validate_length()) {
+		WDT_HIT();
+		if (AT91C_BASE_SSC->SSC_SR & AT91C_SSC_TXRDY) {
+			AT91C_BASE_SSC->SSC_THR = 0x43;
+			LED_D_ON();
+		}
+		if (!(AT91C_BASE_SSC->SSC_SR & AT91C_SSC_RXRDY)) continue;
+
+		sample = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
+		LED_D_OFF();
+		bool quiescent = (sample < (trigger_threshold + 128)) && (sample > (128 - trigger_threshold));
+
+		if (!triggered) {
+			if (quiescent) {
+				// keep the most recent pretrig_len samples, circularly
+				if (pretrig_len) {
+					dest[pre_pos++] = sample;
+					if (pre_pos == pretrig_len) pre_pos = 0;
+					if (pre_fill < pretrig_len) pre_fill++;
+				}
+				continue;
+			}
+			triggered = true;
+			// linearize the window: rotate so the oldest sample comes first
+			if (pre_fill == pretrig_len && pre_pos != 0) {
+				reverse_bytes(dest, pre_pos);
+				reverse_bytes(dest + pre_pos, pre_fill - pre_pos);
+				reverse_bytes(dest, pre_fill);
+			}
+			n = pre_fill;
+		}
+
+		// ramp the decimation while the signal stays quiescent, snap back
+		// to full rate on activity
+		if (quiescent) {
+			if (++quiet_run >= SMART_QUIET_RAMP && decimation < SMART_DECIMATION_MAX) {
+				decimation <<= 1;
+				quiet_run = 0;
+			}
+		} else {
+			decimation = 1;
+			decim_counter = 0;
+			quiet_run = 0;
+		}
+
+		if (decimation > 1) {
+			if (++decim_counter < decimation) continue;
+			decim_counter = 0;
+		}
+
+		dest[n++] = sample;
+		if (n >= (uint32_t)bufsize) break;
+	}
+
+	if (!silent) {
+		Dbprintf("Done, saved %d samples (%d pre-trigger), final decimation 1:%d",
+					n, pre_fill, decimation);
+	}
+	return n << 3;
+}
+
+/**
+* Initializes the FPGA for snoop-mode (field off) and does a triggered
+* acquisition with a pre-trigger window, using divisor and trigger threshold
+* from the sample_config.
+* @return number of bits sampled
+**/
+uint32_t SnoopLFSmart(uint32_t pretrig_len)
+{
+	printConfig();
+	LFSetupFPGAForADC(config.divisor, false);
+	uint32_t ret = DoAcquisitionSmart(config.trigger_threshold, pretrig_len, false, 0);
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	return ret;
+}
+
 /**
 * acquisition of Cotag LF signal. Similar to other LF,  since the Cotag has such long datarate RF/384
 * and is Manchester?,  we directly gather the manchester data into bigbuff
@@ -14,12 +14,34 @@ uint32_t doCotagAcquisitionManchester(void);
 **/
 uint32_t SampleLF(bool silent, int sample_size);
 
+/**
+* Signal statistics from the last SampleLF() acquisition, for the client's
+* demod scheduler: (dominant zero-crossing interval in samples << 16) |
+* number of crossings. Zero when no stats were collected.
+**/
+uint32_t getLFSignalStats(void);
+
 /**
 * Initializes the FPGA for snoop-mode (field off), and acquires the samples.
 * @return number of bits sampled
 **/
 uint32_t SnoopLF();
 
+/**
+* Initializes the FPGA for snoop-mode (field off) and does a triggered
+* acquisition: circular pre-trigger window, and decimation that ramps up
+* while the signal is quiescent. See DoAcquisitionSmart().
+* @return number of bits sampled
+**/
+uint32_t SnoopLFSmart(uint32_t pretrig_len);
+
+/**
+* Streams samples to the client while the capture keeps running, using two
+* ping-pong DMA buffers. Not bounded by BigBuf.
+* @return number of samples streamed
+**/
+uint32_t StreamLF(bool activeField, uint32_t max_samples);
+
 // adds sample size to default options
 uint32_t DoPartialAcquisition(int trigger_threshold, bool silent, int sample_size, int cancel_after);
 
@@ -60,11 +82,14 @@ void LFSetupFPGAForADC(int divisor, bool lf_field);
  * Values set to '0' implies no change (except for averaging)
  * @brief setSamplingConfig
  * @param sc
+ * @return the config generation number (increments on every actual change)
  */
-void setSamplingConfig(uint8_t *config_data);
+uint32_t setSamplingConfig(uint8_t *config_data);
 
 sample_config *getSamplingConfig();
 
+uint32_t getSamplingConfigGeneration(void);
+
 void printConfig();
 
 
@@ -29,6 +29,8 @@
 #include "parity.h"
 #include "crc.h"
 #include "fpgaloader.h"
+#include "flashstore.h"
+#include "zlib.h"
 
 #define HARDNESTED_AUTHENTICATION_TIMEOUT 848           // card times out 1ms after wrong authentication (according to NXP documentation)
 #define HARDNESTED_PRE_AUTHENTICATION_LEADTIME 400      // some (non standard) cards need a pause after select before they are ready for first authentication
@@ -73,6 +75,7 @@ void MifareReadBlock(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain)
 	byte_t dataoutbuf[16];
 	uint8_t uid[10];
 	uint32_t cuid;
+	uint32_t retrans = mf_comm_stats.retransmissions;
 	struct Crypto1State mpcs = {0, 0};
 	struct Crypto1State *pcs;
 	pcs = &mpcs;
@@ -92,7 +95,7 @@ void MifareReadBlock(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain)
 			break;
 		};
 
-		if(mifare_classic_readblock(pcs, cuid, blockNo, dataoutbuf)) {
+		if(mifare_classic_readblock_retry(pcs, cuid, blockNo, dataoutbuf)) {
 			if (MF_DBGLEVEL >= 1)   Dbprintf("Read block error");
 			break;
 		};
@@ -112,7 +115,7 @@ void MifareReadBlock(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain)
 	if (MF_DBGLEVEL >= 2)   DbpString("READ BLOCK FINISHED");
 
 	LED_B_ON();
-	cmd_send(CMD_ACK,isOK,0,0,dataoutbuf,16);
+	cmd_send(CMD_ACK,isOK,mf_comm_stats.retransmissions - retrans,0,dataoutbuf,16);
 	LED_B_OFF();
 
 	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
@@ -147,6 +150,44 @@ void MifareUC_Auth(uint8_t arg0, uint8_t *keybytes){
 	LED_A_OFF();
 }
 
+//-----------------------------------------------------------------------------
+// Try a batch of UL-EV1/NTAG PWD_AUTH candidates against the tag without a
+// USB round trip per attempt. datain holds arg0 4-byte passwords (up to 128
+// per call); the tag is re-selected after every failed attempt. Responds
+// with arg0 = 1 and arg1 = index of the working password (PACK in the data)
+// on success, arg0 = 0 after exhausting the batch.
+//-----------------------------------------------------------------------------
+void MifareUEv1CheckPwds(uint8_t arg0, uint8_t *datain)
+{
+	uint16_t count = arg0;
+	uint8_t pack[4] = {0x00};
+
+	LED_A_ON();
+	iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+	for (uint16_t i = 0; i < count; i++) {
+		if (BUTTON_PRESS())
+			break;
+		WDT_HIT();
+
+		if (!iso14443a_select_card(NULL, NULL, NULL, true, 0, true)) {
+			if (MF_DBGLEVEL >= MF_DBG_ERROR) Dbprintf("Can't select card");
+			break;
+		}
+
+		if (mifare_ul_ev1_auth(datain + i * 4, pack)) {
+			cmd_send(CMD_ACK, 1, i, 0, pack, sizeof(pack));
+			FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+			LEDsoff();
+			return;
+		}
+	}
+
+	cmd_send(CMD_ACK, 0, 0, 0, 0, 0);
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	LEDsoff();
+}
+
 // Arg0 = BlockNo,
 // Arg1 = UsePwd bool
 // datain = PWD bytes,
@@ -225,6 +266,7 @@ void MifareReadSector(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain)
 	byte_t dataoutbuf[16 * 16];
 	uint8_t uid[10];
 	uint32_t cuid;
+	uint32_t retrans = mf_comm_stats.retransmissions;
 	struct Crypto1State mpcs = {0, 0};
 	struct Crypto1State *pcs;
 	pcs = &mpcs;
@@ -249,12 +291,9 @@ void MifareReadSector(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain)
 		if (MF_DBGLEVEL >= 1)   Dbprintf("Auth error");
 	}
 
-	for (uint8_t blockNo = 0; isOK && blockNo < NumBlocksPerSector(sectorNo); blockNo++) {
-		if(mifare_classic_readblock(pcs, cuid, FirstBlockOfSector(sectorNo) + blockNo, dataoutbuf + 16 * blockNo)) {
-			isOK = 0;
-			if (MF_DBGLEVEL >= 1)   Dbprintf("Read sector %2d block %2d error", sectorNo, blockNo);
-			break;
-		}
+	if(isOK && mifare_classic_readsector(pcs, cuid, FirstBlockOfSector(sectorNo), NumBlocksPerSector(sectorNo), dataoutbuf)) {
+		isOK = 0;
+		if (MF_DBGLEVEL >= 1)   Dbprintf("Read sector %2d error", sectorNo);
 	}
 
 	if(mifare_classic_halt(pcs, cuid)) {
@@ -267,7 +306,7 @@ void MifareReadSector(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain)
 	if (MF_DBGLEVEL >= 2) DbpString("READ SECTOR FINISHED");
 
 	LED_B_ON();
-	cmd_send(CMD_ACK,isOK,0,0,dataoutbuf,16*NumBlocksPerSector(sectorNo));
+	cmd_send(CMD_ACK,isOK,mf_comm_stats.retransmissions - retrans,0,dataoutbuf,16*NumBlocksPerSector(sectorNo));
 	LED_B_OFF();
 
 	// Thats it...
@@ -275,6 +314,125 @@ void MifareReadSector(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain)
 	LEDsoff();
 }
 
+//-----------------------------------------------------------------------------
+// Select, Authenticate, Read an entire MIFARE tag in one pass.
+// arg0 = number of sectors
+// datain = 6 byte key A entries for each sector, followed by the key B entries
+// Key A is tried first, key B for whatever blocks of the sector remain. The
+// card data is buffered in BigBuf for a bulk download; the answer carries a
+// per block read bitmap.
+//-----------------------------------------------------------------------------
+void MifareReadCard(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain)
+{
+	// params
+	uint8_t numSectors = arg0;
+
+	// variables
+	byte_t isOK = 1;
+	uint8_t readok[32] = {0};
+	uint8_t uid[10];
+	uint32_t cuid = 0;
+	struct Crypto1State mpcs = {0, 0};
+	struct Crypto1State *pcs;
+	pcs = &mpcs;
+
+	if (numSectors == 0 || numSectors > 40) {
+		OnError(0);
+		return;
+	}
+	uint16_t numBlocks = FirstBlockOfSector(numSectors - 1) + NumBlocksPerSector(numSectors - 1);
+
+	LED_A_ON();
+	iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+	clear_trace();
+
+	// free eventually allocated BigBuf memory
+	BigBuf_free();
+	uint8_t *dataout = BigBuf_malloc(numBlocks * 16);
+	if (dataout == NULL) {
+		Dbprintf("out of memory");
+		OnError(1);
+		return;
+	}
+	memset(dataout, 0, numBlocks * 16);
+
+	bool selected = false;
+	bool authenticated = false;
+	bool cardGone = false;
+
+	for (uint8_t sectorNo = 0; sectorNo < numSectors && !cardGone; sectorNo++) {
+		uint8_t firstBlock = FirstBlockOfSector(sectorNo);
+		uint8_t sectorBlocks = NumBlocksPerSector(sectorNo);
+		uint8_t sectorDone = 0;
+
+		for (uint8_t keyType = 0; keyType < 2 && sectorDone < sectorBlocks; keyType++) {
+			uint64_t ui64Key = bytes_to_num(datain + (keyType * numSectors + sectorNo) * 6, 6);
+
+			if (!selected) {
+				if (!iso14443a_select_card(uid, NULL, &cuid, true, 0, true)) {
+					if (MF_DBGLEVEL >= 1)   Dbprintf("Can't select card");
+					cardGone = true;
+					break;
+				}
+				selected = true;
+				authenticated = false;
+			}
+
+			if (mifare_classic_auth(pcs, cuid, firstBlock, keyType, ui64Key, authenticated ? AUTH_NESTED : AUTH_FIRST)) {
+				// a failed authentication mutes the card - reselect before the next attempt
+				selected = false;
+				authenticated = false;
+				continue;
+			}
+			authenticated = true;
+
+			// untouched sector: pipelined whole-sector read; on failure fall
+			// back to stepping block-wise below
+			if (sectorDone == 0 &&
+					mifare_classic_readsector(pcs, cuid, firstBlock, sectorBlocks, dataout + 16 * firstBlock) == 0) {
+				for (uint8_t blockNo = 0; blockNo < sectorBlocks; blockNo++) {
+					uint16_t block = firstBlock + blockNo;
+					readok[block / 8] |= 1 << (block % 8);
+				}
+				sectorDone = sectorBlocks;
+				continue;
+			}
+
+			for (uint8_t blockNo = 0; blockNo < sectorBlocks; blockNo++) {
+				uint16_t block = firstBlock + blockNo;
+				if (readok[block / 8] & (1 << (block % 8)))
+					continue;
+				if (mifare_classic_readblock_retry(pcs, cuid, block, dataout + 16 * block)) {
+					if (MF_DBGLEVEL >= 1)   Dbprintf("Read sector %2d block %2d error", sectorNo, blockNo);
+				} else {
+					readok[block / 8] |= 1 << (block % 8);
+					sectorDone++;
+				}
+			}
+		}
+
+		if (sectorDone < sectorBlocks)
+			isOK = 0;
+	}
+
+	if (selected && mifare_classic_halt(pcs, cuid)) {
+		if (MF_DBGLEVEL >= 1)   Dbprintf("Halt error");
+	}
+
+	//  ----------------------------- crypto1 destroy
+	crypto1_destroy(pcs);
+
+	if (MF_DBGLEVEL >= 2) DbpString("READ CARD FINISHED");
+
+	LED_B_ON();
+	cmd_send(CMD_ACK, isOK, numBlocks * 16, BigBuf_max_traceLen(), readok, sizeof(readok));
+	LED_B_OFF();
+
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	LEDsoff();
+}
+
 // arg0 = blockNo (start)
 // arg1 = Pages (number of blocks)
 // arg2 = useKey
@@ -290,8 +448,9 @@ void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain)
 	// params
 	uint8_t blockNo = arg0;
 	uint16_t blocks = arg1;
-	bool useKey = (arg2 == 1); //UL_C
-	bool usePwd = (arg2 == 2); //UL_EV1/NTAG
+	bool useKey = ((arg2 & 0x03) == 1); //UL_C
+	bool usePwd = ((arg2 & 0x03) == 2); //UL_EV1/NTAG
+	bool useFastRead = (arg2 & 0x04); //UL_EV1/NTAG FAST_READ
 	uint32_t countblocks = 0;
 	uint8_t *dataout = BigBuf_malloc(CARD_MEMORY_SIZE);
 	if (dataout == NULL){
@@ -330,26 +489,56 @@ void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain)
 		}
 	}
 
-	for (int i = 0; i < blocks; i++){
-		if ((i*4) + 4 >= CARD_MEMORY_SIZE) {
-			Dbprintf("Data exceeds buffer!!");
-			break;
-		}
+	if (useFastRead) {
+		// EV1/NTAG: grab as many blocks per air round trip as fit in one
+		// ISO14443a frame (4 bytes per block plus CRC)
+		uint16_t maxbatch = (MAX_FRAME_SIZE - 2) / 4;
+		while (countblocks < blocks) {
+			uint16_t batch = blocks - countblocks;
+			if (batch > maxbatch) batch = maxbatch;
+			if ((countblocks + batch) * 4 > CARD_MEMORY_SIZE) {
+				Dbprintf("Data exceeds buffer!!");
+				break;
+			}
 
-		len = mifare_ultra_readblock(blockNo + i, dataout + 4 * i);
+			len = mifare_ultra_fastread(blockNo + countblocks, blockNo + countblocks + batch - 1, dataout + 4 * countblocks);
 
-		if (len) {
-			if (MF_DBGLEVEL >= MF_DBG_ERROR) Dbprintf("Read block %d error",i);
-			// if no blocks read - error out
-			if (i==0){
-				OnError(2);
-				return;
+			if (len) {
+				if (MF_DBGLEVEL >= MF_DBG_ERROR) Dbprintf("Fast read blocks %d-%d error", countblocks, countblocks + batch - 1);
+				// if no blocks read - error out, the client retries without FAST_READ
+				if (countblocks == 0) {
+					OnError(2);
+					return;
+				} else {
+					//stop at last successful read batch and return what we got
+					break;
+				}
 			} else {
-				//stop at last successful read block and return what we got
+				countblocks += batch;
+			}
+		}
+	} else {
+		for (int i = 0; i < blocks; i++){
+			if ((i*4) + 4 >= CARD_MEMORY_SIZE) {
+				Dbprintf("Data exceeds buffer!!");
 				break;
 			}
-		} else {
-			countblocks++;
+
+			len = mifare_ultra_readblock(blockNo + i, dataout + 4 * i);
+
+			if (len) {
+				if (MF_DBGLEVEL >= MF_DBG_ERROR) Dbprintf("Read block %d error",i);
+				// if no blocks read - error out
+				if (i==0){
+					OnError(2);
+					return;
+				} else {
+					//stop at last successful read block and return what we got
+					break;
+				}
+			} else {
+				countblocks++;
+			}
 		}
 	}
 
@@ -668,6 +857,9 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
 
 	LED_C_ON();
 
+	if (initialize)
+		SendProgressStart();
+
 	uint16_t num_nonces = 0;
 	bool have_uid = false;
 	for (uint16_t i = 0; i <= USB_CMD_DATA_SIZE - 9; ) {
@@ -679,6 +871,9 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
 			break;
 		}
 
+		// let the client tell a slow tag from a hang
+		SendProgress(num_nonces, (USB_CMD_DATA_SIZE - 9) / 9);
+
 		if (!have_uid) { // need a full select cycle to get the uid first
 			iso14a_card_select_t card_info;
 			if(!iso14443a_select_card(uid, &card_info, &cuid, true, 0, true)) {
@@ -1032,7 +1227,147 @@ void MifareChkKeys(uint16_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain)
 
 	// restore debug level
 	MF_DBGLEVEL = OLD_MF_DBGLEVEL;
-	
+
+	LED_A_OFF();
+}
+
+//-----------------------------------------------------------------------------
+// MIFARE check keys from a BigBuf resident dictionary. The dictionary is
+// uploaded once in USB_CMD_DATA_SIZE sized chunks with CMD_MIFARE_CHKKEYS_LOAD
+// and then checked against all sectors and key types in a single
+// CMD_MIFARE_CHKKEYS_CACHED round trip.
+//-----------------------------------------------------------------------------
+
+static uint8_t *chkKeyCache = NULL;
+static uint16_t chkKeyCacheCount = 0;
+
+void MifareChkKeysLoad(uint16_t arg0, uint16_t arg1, uint16_t arg2, uint8_t *datain)
+{
+	uint16_t offset = arg0;		// position of this chunk (in keys)
+	uint16_t count = arg1;		// keys in this chunk
+	uint16_t total = arg2;		// size of the whole dictionary (in keys)
+
+	if (offset == 0) {			// first chunk (re)allocates the cache
+		if (chkKeyCache != NULL) {
+			BigBuf_release(chkKeyCache);
+			chkKeyCache = NULL;
+		}
+		chkKeyCacheCount = 0;
+		if (total == 0 || total > BIGBUF_SIZE / 6) {
+			cmd_send(CMD_ACK, 0, 0, 0, NULL, 0);
+			return;
+		}
+		chkKeyCache = BigBuf_malloc(total * 6);
+		if (chkKeyCache == NULL) {
+			if (MF_DBGLEVEL >= 1) Dbprintf("ChkKeysLoad: no room for %d keys", total);
+			cmd_send(CMD_ACK, 0, 0, 0, NULL, 0);
+			return;
+		}
+	}
+
+	if (chkKeyCache == NULL || count > USB_CMD_DATA_SIZE / 6 || offset + count > total) {
+		cmd_send(CMD_ACK, 0, 0, 0, NULL, 0);
+		return;
+	}
+
+	memcpy(chkKeyCache + offset * 6, datain, count * 6);
+	chkKeyCacheCount = offset + count;
+	cmd_send(CMD_ACK, 1, chkKeyCacheCount, 0, NULL, 0);
+}
+
+// source the key cache from the flash store instead of a USB upload, so a
+// cached check works right after power-up without re-sending the dictionary
+void MifareChkKeysFromStore(void)
+{
+	uint16_t len = 0;
+	const uint8_t *keys = flashstore_find(FLASHSTORE_ID_MFKEYS, &len);
+
+	if (chkKeyCache != NULL) {
+		BigBuf_release(chkKeyCache);
+		chkKeyCache = NULL;
+	}
+	chkKeyCacheCount = 0;
+
+	if (keys == NULL || len < 6) {
+		cmd_send(CMD_ACK, 0, 0, 0, NULL, 0);
+		return;
+	}
+
+	chkKeyCache = BigBuf_malloc(len - len % 6);
+	if (chkKeyCache == NULL) {
+		if (MF_DBGLEVEL >= 1) Dbprintf("ChkKeysFromStore: no room for %d keys", len / 6);
+		cmd_send(CMD_ACK, 0, 0, 0, NULL, 0);
+		return;
+	}
+	memcpy(chkKeyCache, keys, len - len % 6);
+	chkKeyCacheCount = len / 6;
+	cmd_send(CMD_ACK, 1, chkKeyCacheCount, 0, NULL, 0);
+}
+
+void MifareChkKeysCached(uint16_t arg0, uint16_t arg1)
+{
+	uint8_t sectorCnt = arg0 & 0xff;
+	uint8_t keyType = (arg0 >> 8) & 0xff;
+	bool clearTrace = arg1 & 0x01;
+	uint8_t set14aTimeout = (arg1 >> 8) & 0xff;
+	uint8_t buf[10 + 2 * 40 * 6];	// found bitmap (bit = keyAB*40+sector) + found keys
+	bool aborted = false;
+
+	if (chkKeyCache == NULL || chkKeyCacheCount == 0 || sectorCnt > 40) {
+		cmd_send(CMD_ACK, 0, 0, 0, NULL, 0);
+		return;
+	}
+
+	LED_A_ON();
+
+	// clear debug level
+	int OLD_MF_DBGLEVEL = MF_DBGLEVEL;
+	MF_DBGLEVEL = MF_DBG_NONE;
+
+	iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+	if (clearTrace) {
+		clear_trace();
+	}
+	set_tracing(true);
+
+	if (set14aTimeout){
+		iso14a_set_timeout(set14aTimeout * 10); // timeout: ms = x/106  35-minimum, 50-OK 106-recommended 500-safe
+	}
+
+	memset(buf, 0, sizeof(buf));
+
+	for (uint8_t sc = 0; sc < sectorCnt && !aborted; sc++) {
+		WDT_HIT();
+		int keyAB = keyType;
+		do {
+			for (uint16_t c = 0; c < chkKeyCacheCount; c += 255) {
+				uint8_t cnt = (chkKeyCacheCount - c > 255) ? 255 : chkKeyCacheCount - c;
+				int res = MifareChkBlockKeys(chkKeyCache + c * 6, cnt, FirstBlockOfSector(sc), keyAB & 0x01, OLD_MF_DBGLEVEL);
+				if (res < 0) {		// button pressed or card gone
+					aborted = true;
+					break;
+				}
+				if (res > 0) {
+					uint16_t idx = (keyAB & 0x01) * 40 + sc;
+					buf[idx >> 3] |= 1 << (idx & 0x07);
+					memcpy(buf + 10 + idx * 6, chkKeyCache + (c + res - 1) * 6, 6);
+					break;
+				}
+			}
+		} while(--keyAB > 0 && !aborted);
+	}
+
+	LED_B_ON();
+	cmd_send(CMD_ACK, aborted ? 0 : 1, chkKeyCacheCount, 0, buf, sizeof(buf));
+	LED_B_OFF();
+
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	LED_D_OFF();
+
+	// restore debug level
+	MF_DBGLEVEL = OLD_MF_DBGLEVEL;
+
 	LED_A_OFF();
 }
 
@@ -1099,6 +1434,17 @@ void MifareSetDbgLvl(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datai
 	Dbprintf("Debug level: %d", MF_DBGLEVEL);
 }
 
+//-----------------------------------------------------------------------------
+// MIFARE communication statistics. Report the counters accumulated since the
+// last reset; arg0 != 0 resets them afterwards. Lets the client tell a
+// marginal field (timeouts, CRC errors, retries) from a merely slow protocol.
+//-----------------------------------------------------------------------------
+void MifareCommStats(uint32_t arg0){
+	cmd_send(CMD_ACK, 0, 0, 0, (uint8_t *)&mf_comm_stats, sizeof(mf_comm_stats));
+	if (arg0)
+		mf_comm_stats_reset();
+}
+
 //-----------------------------------------------------------------------------
 // Work with emulator memory
 //
@@ -1117,6 +1463,91 @@ void MifareEMemSet(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain)
 	emlSetMem(datain, arg0, arg1); // data, block num, blocks count
 }
 
+// Streamed emulator memory upload. The client pushes a whole image in
+// USB_CMD_DATA_SIZE chunks, optionally as one zlib stream which is inflated
+// on the fly straight into the emulator memory. The inflate state lives in
+// BigBuf next to the emulator memory and persists between chunks; only the
+// final chunk is acknowledged.
+static z_stream em_load_stream;
+static bool em_load_active = false;
+
+static voidpf em_inflate_malloc(voidpf opaque, uInt items, uInt size)
+{
+	return BigBuf_malloc(items * size);
+}
+
+static void em_inflate_free(voidpf opaque, voidpf address)
+{
+	BigBuf_release(address);
+}
+
+void MifareEMemLoad(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain){
+	FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+
+	uint32_t flags = arg0;
+	uint32_t offset = arg1;
+	uint32_t len = arg2;
+	uint8_t *em = BigBuf_get_EM_addr();
+	uint32_t written = 0;
+	bool isOK = true;
+
+	if (len > USB_CMD_DATA_SIZE) len = USB_CMD_DATA_SIZE;
+
+	if (!(flags & EML_LOAD_COMPRESSED)) {
+		isOK = (emlSet(datain, offset, len) == 0);
+		written = offset + len;
+	} else {
+		if (flags & EML_LOAD_FIRST) {
+			if (em_load_active) inflateEnd(&em_load_stream);
+			memset(&em_load_stream, 0, sizeof(em_load_stream));
+			em_load_stream.zalloc = &em_inflate_malloc;
+			em_load_stream.zfree = &em_inflate_free;
+			em_load_active = (inflateInit2(&em_load_stream, 0) == Z_OK);
+			em_load_stream.next_out = em;
+			em_load_stream.avail_out = CARD_MEMORY_SIZE;
+		}
+		if (!em_load_active) {
+			isOK = false;
+		} else {
+			em_load_stream.next_in = datain;
+			em_load_stream.avail_in = len;
+			int res = inflate(&em_load_stream, Z_SYNC_FLUSH);
+			if (res != Z_OK && res != Z_STREAM_END) {
+				Dbprintf("inflate returned: %d, %s", res, em_load_stream.msg);
+				inflateEnd(&em_load_stream);
+				em_load_active = false;
+				isOK = false;
+			}
+		}
+		written = em_load_active ? em_load_stream.total_out : 0;
+		if ((flags & EML_LOAD_FINAL) && em_load_active) {
+			inflateEnd(&em_load_stream);
+			em_load_active = false;
+		}
+	}
+
+	if (flags & EML_LOAD_FINAL) {
+		LED_B_ON();
+		cmd_send(CMD_ACK, isOK, written, 0, 0, 0);
+		LED_B_OFF();
+	}
+}
+
+// store/restore the emulator memory as a persona slot (see BigBuf.c)
+// arg0: 0 = store, 1 = restore, 2 = status; arg1: slot
+void MifareEMemPersona(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain){
+	FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+	uint8_t res = 0;
+	switch (arg0) {
+		case 0: res = emlPersonaStore(arg1); break;
+		case 1: res = emlPersonaRestore(arg1); break;
+		default: emlPersonaStatus(); break;
+	}
+	LED_B_ON();
+	cmd_send(CMD_ACK, res == 0, res, 0, 0, 0);
+	LED_B_OFF();
+}
+
 void MifareEMemGet(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain){
 	FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
 	byte_t buf[USB_CMD_DATA_SIZE];
@@ -1177,7 +1608,7 @@ void MifareECardLoad(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datai
 		}
 
 		for (uint8_t blockNo = 0; isOK && blockNo < NumBlocksPerSector(sectorNo); blockNo++) {
-			if(isOK && mifare_classic_readblock(pcs, cuid, FirstBlockOfSector(sectorNo) + blockNo, dataoutbuf)) {
+			if(isOK && mifare_classic_readblock_retry(pcs, cuid, FirstBlockOfSector(sectorNo) + blockNo, dataoutbuf)) {
 				isOK = false;
 				if (MF_DBGLEVEL >= 1)   Dbprintf("Error reading sector %2d block %2d", sectorNo, blockNo);
 				break;
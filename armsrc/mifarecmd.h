@@ -18,18 +18,26 @@
 extern void MifareReadBlock(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *data);
 extern void MifareUReadBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 extern void MifareUC_Auth(uint8_t arg0, uint8_t *datain);
+extern void MifareUEv1CheckPwds(uint8_t arg0, uint8_t *datain);
 extern void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain);
 extern void MifareReadSector(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain);
+extern void MifareReadCard(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain);
 extern void MifareWriteBlock(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain);
 //extern void MifareUWriteBlockCompat(uint8_t arg0,uint8_t *datain);
 extern void MifareUWriteBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 extern void MifareNested(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
 extern void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags, uint8_t *datain);
 extern void MifareChkKeys(uint16_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain);
+extern void MifareChkKeysLoad(uint16_t arg0, uint16_t arg1, uint16_t arg2, uint8_t *datain);
+extern void MifareChkKeysFromStore(void);
+extern void MifareChkKeysCached(uint16_t arg0, uint16_t arg1);
 extern void MifareSetDbgLvl(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
+extern void MifareCommStats(uint32_t arg0);
 extern void MifareEMemClr(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
 extern void MifareEMemSet(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
+extern void MifareEMemLoad(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
 extern void MifareEMemGet(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
+extern void MifareEMemPersona(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
 extern void MifareECardLoad(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
 extern void MifareCWipe(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);       // Work with "magic Chinese" card
 extern void MifareCSetBlock(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
@@ -11,6 +11,7 @@
 //-----------------------------------------------------------------------------
 
 #include "mifaresim.h"
+#include "mifaresim_frames.h"
 #include "iso14443a.h"
 #include "iso14443crc.h"
 #include "crapto1/crapto1.h"
@@ -22,7 +23,9 @@
 #include "usb_cdc.h"
 #include "cmd.h"
 #include "protocols.h"
+#include "flashstore.h"
 #include "apps.h"
+#include "eventjournal.h"
 
 //mifare emulator states
 #define MFEMUL_NOFIELD           0
@@ -186,6 +189,86 @@ static bool IsAccessAllowed(uint8_t blockNo, uint8_t keytype, uint8_t action) {
 }
 
 
+// Precomputed read responses, built at simulation start: for every block one
+// 18 byte plaintext answer (data + CRC) per authentication key, with the
+// access conditions already applied. Assembling these inside the emulator
+// loop (three emulator memory reads plus a CRC per READ) made us miss the
+// frame delay time against fast readers; with the table, only the nonce
+// dependent crypto1 stream and its parity remain for the critical path.
+static uint8_t *block_responses = NULL;
+
+static uint8_t *BlockResponse(uint8_t blockNo, uint8_t keytype) {
+	return block_responses + (blockNo * 2 + keytype) * 18;
+}
+
+static void MifareSimBuildBlockResponse(uint8_t blockNo) {
+	for (uint8_t keytype = AUTHKEYA; keytype <= AUTHKEYB; keytype++) {
+		uint8_t *response = BlockResponse(blockNo, keytype);
+		emlGetMem(response, blockNo, 1);
+		if (IsSectorTrailer(blockNo)) {
+			memset(response, 0x00, 6);  // keyA can never be read
+			if (!IsAccessAllowed(blockNo, keytype, AC_KEYB_READ)) {
+				memset(response+10, 0x00, 6);   // keyB cannot be read
+			}
+			if (!IsAccessAllowed(blockNo, keytype, AC_AC_READ)) {
+				memset(response+6, 0x00, 4);    // AC bits cannot be read
+			}
+		} else {
+			if (!IsAccessAllowed(blockNo, keytype, AC_DATA_READ)) {
+				memset(response, 0x00, 16);     // datablock cannot be read
+			}
+		}
+		AppendCrc14443a(response, 16);
+	}
+}
+
+// refresh the table after the reader has written a block. A write into the
+// sector trailer changes the access conditions of the whole sector
+static void MifareSimUpdateBlockResponse(uint8_t blockNo, int num_blocks) {
+	if (IsSectorTrailer(blockNo)) {
+		for (int b = 0; b < num_blocks; b++) {
+			if (SectorTrailer(b) == blockNo) {
+				MifareSimBuildBlockResponse(b);
+			}
+		}
+	} else {
+		MifareSimBuildBlockResponse(blockNo);
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Scripted behavior overrides ('hf mf simhooks', CMD_MIFARE_SIM_HOOKS): a
+// small uploadable table of per-command deviations - delayed NACK, silence,
+// a precompiled response frame - for probing reader error handling. The
+// dispatch cost is one 256-entry index lookup, so the timing path stays at
+// full field rate.
+//-----------------------------------------------------------------------------
+static mfsim_hook_t mfsim_hooks[MFSIM_MAX_HOOKS];
+static uint8_t mfsim_hook_count = 0;
+static uint8_t mfsim_hook_index[256];	// cmd byte -> table entry + 1, 0 = none
+static uint16_t mfsim_hook_seen[MFSIM_MAX_HOOKS];
+
+int MifareSimSetHooks(uint8_t count, uint8_t *datain) {
+	if (count == 0) {
+		mfsim_hook_count = 0;
+		memset(mfsim_hook_index, 0, sizeof(mfsim_hook_index));
+		return 0;
+	}
+	for (uint8_t i = 0; i < count && mfsim_hook_count < MFSIM_MAX_HOOKS; i++) {
+		mfsim_hook_t *h = &mfsim_hooks[mfsim_hook_count];
+		memcpy(h, datain + i * sizeof(mfsim_hook_t), sizeof(mfsim_hook_t));
+		if (h->resp_len > sizeof(h->resp))
+			h->resp_len = sizeof(h->resp);
+		mfsim_hook_index[h->cmd] = ++mfsim_hook_count;
+	}
+	return mfsim_hook_count;
+}
+
+static void MifareSimResetHookCounters(void) {
+	memset(mfsim_hook_seen, 0, sizeof(mfsim_hook_seen));
+}
+
 static void MifareSimInit(uint8_t flags, uint8_t *datain, tag_response_info_t **responses, uint32_t *cuid, uint8_t *uid_len, uint8_t cardsize) {
 
 	#define TAG_RESPONSE_COUNT 5                                // number of precompiled responses
@@ -239,21 +322,19 @@ static void MifareSimInit(uint8_t flags, uint8_t *datain, tag_response_info_t **
 			break;
 	}
 
-	// set SAK based on cardsize
+	// set SAK based on cardsize - frames with precomputed CRC
 	switch (cardsize) {
-		case '0': rSAKfinal[0] = 0x09; break; // Mifare Mini
-		case '2': rSAKfinal[0] = 0x10; break; // Mifare 2K
-		case '4': rSAKfinal[0] = 0x18; break; // Mifare 4K
-		default: rSAKfinal[0] = 0x08;         // Mifare 1K
+		case '0': memcpy(rSAKfinal, rSAK_MINI, sizeof(rSAKfinal)); break; // Mifare Mini
+		case '2': memcpy(rSAKfinal, rSAK_2K, sizeof(rSAKfinal)); break;   // Mifare 2K
+		case '4': memcpy(rSAKfinal, rSAK_4K, sizeof(rSAKfinal)); break;   // Mifare 4K
+		default:  memcpy(rSAKfinal, rSAK_1K, sizeof(rSAKfinal));          // Mifare 1K
 	}
-	ComputeCrc14443(CRC_14443_A, rSAKfinal, 1, rSAKfinal + 1, rSAKfinal + 2);
 	if (MF_DBGLEVEL >= MF_DBG_INFO)   {
 		Dbprintf("SAK:    %02x", rSAKfinal[0]);
 	}
 
-	// set SAK for incomplete UID
-	rSAK1[0] = 0x04;                          // Bit 3 indicates incomplete UID
-	ComputeCrc14443(CRC_14443_A, rSAK1, 1, rSAK1 + 1, rSAK1 + 2);
+	// set SAK for incomplete UID (bit 3 indicates incomplete UID)
+	memcpy(rSAK1, rSAK_INCOMPLETE, sizeof(rSAK1));
 
 	// set ATQA based on cardsize and UIDlen
 	if (cardsize == '4') {
@@ -336,6 +417,8 @@ void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t
 	struct Crypto1State mpcs = {0, 0};
 	struct Crypto1State *pcs = &mpcs;
 	uint32_t numReads = 0; //Counts numer of times reader reads a block
+
+	MifareSimResetHookCounters();
 	uint8_t receivedCmd[MAX_MIFARE_FRAME_SIZE];
 	uint8_t receivedCmd_dec[MAX_MIFARE_FRAME_SIZE];
 	uint8_t receivedCmd_par[MAX_MIFARE_PARITY_SIZE];
@@ -346,6 +429,18 @@ void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t
 
 	int num_blocks = ParamCardSizeBlocks(cardsize);
 
+	if (flags & FLAG_EML_FROM_FLASH) {
+		// simulate the card image persisted in the flash store, so a sim can
+		// start right after power-up without re-uploading the dump
+		uint16_t img_len = 0;
+		const uint8_t *img = flashstore_find(FLASHSTORE_ID_EMIMAGE, &img_len);
+		if (img != NULL) {
+			memcpy(BigBuf_get_EM_addr(), img, MIN(img_len, CARD_MEMORY_SIZE));
+		} else {
+			Dbprintf("No emulator image in the flash store");
+		}
+	}
+
 	// Here we collect UID, sector, keytype, NT, AR, NR, NT2, AR2, NR2
 	// This will be used in the reader-only attack.
 
@@ -375,6 +470,18 @@ void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t
 
 	MifareSimInit(flags, datain, &responses, &cuid, &uid_len, cardsize);
 
+	// precompute the read responses for all blocks. There will not be enough
+	// time for the emulator memory reads and the CRC once the reader asks
+	block_responses = BigBuf_malloc(num_blocks * 2 * 18);
+	if (block_responses == NULL) {
+		Dbprintf("out of memory");
+		LED_A_OFF();
+		return;
+	}
+	for (int b = 0; b < num_blocks; b++) {
+		MifareSimBuildBlockResponse(b);
+	}
+
 	// We need to listen to the high-frequency, peak-detected path.
 	iso14443a_setup(FPGA_HF_ISO14443A_TAGSIM_LISTEN);
 
@@ -503,6 +610,41 @@ void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t
 					break;
 				}
 
+				// scripted deviations, if a hook is loaded for this command
+				uint8_t hook_slot = mfsim_hook_index[receivedCmd_dec[0]];
+				if (hook_slot) {
+					mfsim_hook_t *hook = &mfsim_hooks[hook_slot - 1];
+					if (++mfsim_hook_seen[hook_slot - 1] > hook->after_n) {
+						if (hook->delay_us)
+							SpinDelayUs(hook->delay_us);
+						if (hook->action == MFSIM_HOOK_SILENT) {
+							if (MF_DBGLEVEL >= MF_DBG_EXTENDED) Dbprintf("hook: staying silent on 0x%02x", receivedCmd_dec[0]);
+							break;
+						}
+						if (hook->action == MFSIM_HOOK_NACK) {
+							EmSend4bit(mf_crypto1_encrypt4bit(pcs, CARD_NACK_NA));
+							FpgaDisableTracing();
+							if (MF_DBGLEVEL >= MF_DBG_EXTENDED) Dbprintf("hook: nacking 0x%02x", receivedCmd_dec[0]);
+							break;
+						}
+						if (hook->action == MFSIM_HOOK_ACK) {
+							EmSend4bit(mf_crypto1_encrypt4bit(pcs, CARD_ACK));
+							FpgaDisableTracing();
+							if (MF_DBGLEVEL >= MF_DBG_EXTENDED) Dbprintf("hook: acking 0x%02x", receivedCmd_dec[0]);
+							break;
+						}
+						if (hook->action == MFSIM_HOOK_RESPONSE) {
+							memcpy(response, hook->resp, hook->resp_len);
+							mf_crypto1_encrypt(pcs, response, hook->resp_len, response_par);
+							EmSendCmdPar(response, hook->resp_len, response_par);
+							FpgaDisableTracing();
+							if (MF_DBGLEVEL >= MF_DBG_EXTENDED) Dbprintf("hook: %d byte canned response to 0x%02x", hook->resp_len, receivedCmd_dec[0]);
+							break;
+						}
+						// MFSIM_HOOK_PASS: scripted delay only, continue normally
+					}
+				}
+
 				if (receivedCmd_dec[0] == MIFARE_AUTH_KEYA || receivedCmd_dec[0] == MIFARE_AUTH_KEYB) {
 					// if authenticating to a block that shouldn't exist - as long as we are not doing the reader attack
 					if (receivedCmd_dec[1] >= num_blocks && !(flags & FLAG_NR_AR_ATTACK)) {
@@ -531,6 +673,7 @@ void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t
 						FpgaDisableTracing();
 						if (MF_DBGLEVEL >= MF_DBG_EXTENDED) Dbprintf("Reader doing nested authentication for block %d (0x%02x) with key %d", receivedCmd_dec[1], receivedCmd_dec[1], cardAUTHKEY);
 					}
+					EventJournalLog(EVT_MF_AUTH_START, receivedCmd_dec[1] | (cardAUTHKEY << 8));
 					cardSTATE = MFEMUL_AUTH1;
 					break;
 				}
@@ -564,21 +707,13 @@ void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t
 
 				if (receivedCmd_dec[0] == MIFARE_CMD_READBLOCK) {
 					uint8_t blockNo = receivedCmd_dec[1];
-					emlGetMem(response, blockNo, 1);
-					if (IsSectorTrailer(blockNo)) {
-						memset(response, 0x00, 6);  // keyA can never be read
-						if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_KEYB_READ)) {
-							memset(response+10, 0x00, 6);   // keyB cannot be read
-						}
-						if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_AC_READ)) {
-							memset(response+6, 0x00, 4);    // AC bits cannot be read
-						}
+					if (cardAUTHKEY == AUTHKEYNONE) {
+						// no key, no access - canned all-zero frame
+						memcpy(response, rZERO_BLOCK, 18);
 					} else {
-						if (!IsAccessAllowed(blockNo, cardAUTHKEY, AC_DATA_READ)) {
-							memset(response, 0x00, 16);     // datablock cannot be read
-						}
+						// data, access conditions and CRC were precomputed
+						memcpy(response, BlockResponse(blockNo, cardAUTHKEY), 18);
 					}
-					AppendCrc14443a(response, 16);
 					mf_crypto1_encrypt(pcs, response, 18, response_par);
 					EmSendCmdPar(response, 18, response_par);
 					FpgaDisableTracing();
@@ -631,10 +766,12 @@ void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t
 
 				if (receivedCmd_dec[0] == MIFARE_CMD_TRANSFER) {
 					uint8_t blockNo = receivedCmd_dec[1];
-					if (emlSetValBl(cardINTREG, cardINTBLOCK, receivedCmd_dec[1]))
+					if (emlSetValBl(cardINTREG, cardINTBLOCK, receivedCmd_dec[1])) {
 						EmSend4bit(mf_crypto1_encrypt4bit(pcs, CARD_NACK_NA));
-					else
+					} else {
 						EmSend4bit(mf_crypto1_encrypt4bit(pcs, CARD_ACK));
+						MifareSimUpdateBlockResponse(blockNo, num_blocks);
+					}
 					FpgaDisableTracing();
 					if (MF_DBGLEVEL >= MF_DBG_EXTENDED) Dbprintf("RECV 0x%02x transfer block %d (%02x)",receivedCmd_dec[0], blockNo, blockNo);
 					break;
@@ -733,6 +870,7 @@ void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t
 					// Right now, we don't nack or anything, which causes the
 					// reader to do a WUPA after a while. /Martin
 					// -- which is the correct response. /piwi
+					EventJournalLog(EVT_MF_AUTH_FAIL, cardAUTHSC | (cardAUTHKEY << 8));
 					cardAUTHKEY = AUTHKEYNONE;  // not authenticated
 					cardSTATE = MFEMUL_IDLE;
 					break;
@@ -743,6 +881,7 @@ void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t
 				EmSendCmdPar(response, 4, response_par);
 				FpgaDisableTracing();
 				if (MF_DBGLEVEL >= MF_DBG_EXTENDED)   Dbprintf("AUTH COMPLETED for sector %d with key %c.", cardAUTHSC, cardAUTHKEY == AUTHKEYA ? 'A' : 'B');
+				EventJournalLog(EVT_MF_AUTH_OK, cardAUTHSC | (cardAUTHKEY << 8));
 				cardSTATE = MFEMUL_WORK;
 				break;
 			}
@@ -769,6 +908,7 @@ void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t
 						}
 						emlSetMem(receivedCmd_dec, cardWRBL, 1);
 						EmSend4bit(mf_crypto1_encrypt4bit(pcs, CARD_ACK));  // always ACK?
+						MifareSimUpdateBlockResponse(cardWRBL, num_blocks);
 						cardSTATE = MFEMUL_WORK;
 						break;
 					}
@@ -16,5 +16,6 @@
 #include <stdint.h>
 
 extern void MifareSim(uint8_t flags, uint8_t exitAfterNReads, uint8_t cardsize, uint8_t *datain);
+extern int MifareSimSetHooks(uint8_t count, uint8_t *datain);
 
 #endif
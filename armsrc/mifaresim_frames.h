@@ -0,0 +1,31 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Fixed MIFARE Classic air-format response frames with the CRC-A already
+// woven in at build time, so the emulator loop doesn't burn frame delay
+// time recomputing checksums of constants on every round. The CRC bytes
+// match ComputeCrc14443(CRC_14443_A, ...) over the leading payload bytes.
+//-----------------------------------------------------------------------------
+
+#ifndef MIFARESIM_FRAMES_H
+#define MIFARESIM_FRAMES_H
+
+#include <stdint.h>
+
+// SAK frames: SAK byte + CRC-A
+static const uint8_t rSAK_MINI[3]  = {0x09, 0x3f, 0xcc};	// Mifare Mini
+static const uint8_t rSAK_1K[3]    = {0x08, 0xb6, 0xdd};	// Mifare 1K
+static const uint8_t rSAK_2K[3]    = {0x10, 0x7f, 0x41};	// Mifare 2K
+static const uint8_t rSAK_4K[3]    = {0x18, 0x37, 0xcd};	// Mifare 4K
+static const uint8_t rSAK_INCOMPLETE[3] = {0x04, 0xda, 0x17};	// cascade not finished
+
+// READ response when no key is authenticated: 16 zero bytes + CRC-A
+static const uint8_t rZERO_BLOCK[18] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x37, 0x49
+};
+
+#endif // MIFARESIM_FRAMES_H
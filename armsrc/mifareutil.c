@@ -26,6 +26,20 @@
 
 int MF_DBGLEVEL = MF_DBG_INFO;
 
+// Per-session communication statistics. Accumulated across all mifare
+// operations until the client resets them, so a long run of commands can be
+// checked for marginal coupling (timeouts, CRC errors, retries) afterwards.
+mf_comm_stats_t mf_comm_stats = {0, 0, 0, 0, 0};
+
+void mf_comm_stats_reset(void)
+{
+	mf_comm_stats.auth_attempts = 0;
+	mf_comm_stats.auth_failures = 0;
+	mf_comm_stats.crc_errors = 0;
+	mf_comm_stats.timeouts = 0;
+	mf_comm_stats.retransmissions = 0;
+}
+
 // crypto1 helpers
 void mf_crypto1_decryptEx(struct Crypto1State *pcs, uint8_t *data_in, int len, uint8_t *data_out){
 	uint8_t bt = 0;
@@ -87,6 +101,7 @@ int mifare_sendcmd(uint8_t cmd, uint8_t* data, uint8_t data_size, uint8_t* answe
 	ReaderTransmit(dcmd, sizeof(dcmd), timing);
 	int len = ReaderReceive(answer, answer_parity);
 	if(!len) {
+		mf_comm_stats.timeouts++;
 		if (MF_DBGLEVEL >= MF_DBG_ERROR)   Dbprintf("%02X Cmd failed. Card timeout.", cmd);
 			len = ReaderReceive(answer,answer_parity);
 		//return 0;
@@ -164,9 +179,14 @@ int mifare_classic_authex(struct Crypto1State *pcs, uint32_t uid, uint8_t blockN
 	uint8_t receivedAnswerPar[MAX_MIFARE_PARITY_SIZE];
 
 	// Transmit MIFARE_CLASSIC_AUTH
+	mf_comm_stats.auth_attempts++;
 	len = mifare_sendcmd_short(pcs, isNested, keyType & 0x01 ? MIFARE_AUTH_KEYB : MIFARE_AUTH_KEYA, blockNo, receivedAnswer, receivedAnswerPar, timing);
 	if (MF_DBGLEVEL >= 4)   Dbprintf("rand tag nonce len: %x", len);
-	if (len != 4) return 1;
+	if (len != 4) {
+		if (!len) mf_comm_stats.timeouts++;
+		mf_comm_stats.auth_failures++;
+		return 1;
+	}
 
 	// "random" reader nonce:
 	nr[0] = 0x55;
@@ -226,6 +246,8 @@ int mifare_classic_authex(struct Crypto1State *pcs, uint32_t uid, uint8_t blockN
 	len = ReaderReceive(receivedAnswer, receivedAnswerPar);
 	if (!len)
 	{
+		mf_comm_stats.timeouts++;
+		mf_comm_stats.auth_failures++;
 		if (MF_DBGLEVEL >= 1)   Dbprintf("Authentication failed. Card timeout.");
 		return 2;
 	}
@@ -234,6 +256,7 @@ int mifare_classic_authex(struct Crypto1State *pcs, uint32_t uid, uint8_t blockN
 	ntpp = prng_successor(nt, 32) ^ crypto1_word(pcs, 0,0);
 
 	if (ntpp != bytes_to_num(tmp4, 4)) {
+		mf_comm_stats.auth_failures++;
 		if (MF_DBGLEVEL >= 1)   Dbprintf("Authentication failed. Error card response.");
 		return 3;
 	}
@@ -257,6 +280,7 @@ int mifare_classic_readblock(struct Crypto1State *pcs, uint32_t uid, uint8_t blo
 		return 1;
 	}
 	if (len != 18) {
+		if (!len) mf_comm_stats.timeouts++;
 		if (MF_DBGLEVEL >= 1)   Dbprintf("Cmd Error: card timeout. len: %x", len);
 		return 2;
 	}
@@ -264,6 +288,7 @@ int mifare_classic_readblock(struct Crypto1State *pcs, uint32_t uid, uint8_t blo
 	memcpy(bt, receivedAnswer + 16, 2);
 	AppendCrc14443a(receivedAnswer, 16);
 	if (bt[0] != receivedAnswer[16] || bt[1] != receivedAnswer[17]) {
+		mf_comm_stats.crc_errors++;
 		if (MF_DBGLEVEL >= 1)   Dbprintf("Cmd CRC response error.");
 		return 3;
 	}
@@ -272,6 +297,118 @@ int mifare_classic_readblock(struct Crypto1State *pcs, uint32_t uid, uint8_t blo
 	return 0;
 }
 
+// Retrying wrapper for bulk read paths. A timeout or CRC error is usually
+// marginal coupling, so retry right away at field timescales instead of
+// failing the whole USB command and paying a host round trip per corrupt
+// frame. A NACK is the card refusing the read - no amount of retrying
+// changes that, so fail fast on it.
+int mifare_classic_readblock_retry(struct Crypto1State *pcs, uint32_t uid, uint8_t blockNo, uint8_t *blockData)
+{
+	int res = mifare_classic_readblock(pcs, uid, blockNo, blockData);
+	for (uint8_t try = 0; try < MF_READBLOCK_RETRIES && res >= 2; try++) {
+		mf_comm_stats.retransmissions++;
+		res = mifare_classic_readblock(pcs, uid, blockNo, blockData);
+	}
+	return res;
+}
+
+// encrypt a READBLOCK command without transmitting it (pipelined sector read)
+static void mf_prepare_read_cmd(struct Crypto1State *pcs, uint8_t blockNo, uint8_t *ecmd, uint8_t *par)
+{
+	uint8_t dcmd[4];
+	dcmd[0] = MIFARE_CMD_READBLOCK;
+	dcmd[1] = blockNo;
+	AppendCrc14443a(dcmd, 2);
+
+	par[0] = 0;
+	for (uint16_t pos = 0; pos < 4; pos++) {
+		ecmd[pos] = crypto1_byte(pcs, 0x00, 0) ^ dcmd[pos];
+		par[0] |= (((filter(pcs->odd) ^ oddparity8(dcmd[pos])) & 0x01) << (7 - pos));
+	}
+}
+
+// Pipelined read of consecutive blocks under one authentication. The crypto1
+// keystream depends only on the cipher state, never on the card's data, so
+// while a response is still in the air we already generate its 18 keystream
+// bytes and encrypt the READBLOCK for the following block. Once the response
+// lands, decrypting is a plain XOR and the next command goes straight out -
+// no keystream generation sits between receive and the next transmit, which
+// is where the serial per-block path idles the field.
+//
+// If a response is not a clean 18-byte frame the pre-generated keystream is
+// rolled back, the cipher is advanced by exactly what the card consumed
+// (mirroring what the serial path would have done) and the block is handed to
+// the retry wrapper; a NACK fails fast as usual.
+int mifare_classic_readsector(struct Crypto1State *pcs, uint32_t uid, uint8_t firstBlock, uint8_t numBlocks, uint8_t *dataout)
+{
+	uint8_t receivedAnswer[MAX_MIFARE_FRAME_SIZE];
+	uint8_t receivedAnswerPar[MAX_MIFARE_PARITY_SIZE];
+	uint8_t ecmd[4], par[1];
+	uint8_t ecmd_next[4], par_next[1];
+	uint8_t ks[18], plain[18];
+	struct Crypto1State rollback;
+	bool inflight = false;
+
+	for (uint8_t b = 0; b < numBlocks; b++) {
+		if (!inflight) {
+			mf_prepare_read_cmd(pcs, firstBlock + b, ecmd, par);
+			ReaderTransmitPar(ecmd, sizeof(ecmd), par, NULL);
+		}
+
+		// overlappable CPU work: keystream for the answer now in the air,
+		// plus the already-encrypted command for the next block
+		rollback = *pcs;
+		for (uint16_t i = 0; i < 18; i++)
+			ks[i] = crypto1_byte(pcs, 0x00, 0);
+		if (b + 1 < numBlocks)
+			mf_prepare_read_cmd(pcs, firstBlock + b + 1, ecmd_next, par_next);
+
+		int len = ReaderReceive(receivedAnswer, receivedAnswerPar);
+		if (len == 18) {
+			for (uint16_t i = 0; i < 18; i++)
+				plain[i] = ks[i] ^ receivedAnswer[i];
+
+			uint8_t bt[2] = { plain[16], plain[17] };
+			AppendCrc14443a(plain, 16);
+			if (bt[0] == plain[16] && bt[1] == plain[17]) {
+				if (b + 1 < numBlocks) {
+					ReaderTransmitPar(ecmd_next, sizeof(ecmd_next), par_next, NULL);
+					inflight = true;
+				}
+				memcpy(dataout + 16 * b, plain, 16);
+				continue;
+			}
+			mf_comm_stats.crc_errors++;
+			if (MF_DBGLEVEL >= 1)	Dbprintf("Cmd CRC response error.");
+		}
+
+		// anomaly: rewind the pre-generated keystream, then consume exactly
+		// what the card's answer did so the retry wrapper stays in step
+		*pcs = rollback;
+		if (len == 1) {
+			uint16_t res = 0;
+			for (uint16_t pos = 0; pos < 4; pos++)
+				res |= (crypto1_bit(pcs, 0, 0) ^ BIT(receivedAnswer[0], pos)) << pos;
+			if (MF_DBGLEVEL >= 1)	Dbprintf("Cmd Error: %02x", res);
+			return 1;
+		}
+		if (!len)
+			mf_comm_stats.timeouts++;
+		for (int i = 0; i < len; i++)
+			crypto1_byte(pcs, 0x00, 0);
+
+		mf_comm_stats.retransmissions++;
+		int res = mifare_classic_readblock_retry(pcs, uid, firstBlock + b, dataout + 16 * b);
+		if (res) {
+			if (res == 1)
+				return 1;
+			return 2;
+		}
+		inflight = false;
+	}
+	return 0;
+}
+
 // mifare ultralight commands
 int mifare_ul_ev1_auth(uint8_t *keybytes, uint8_t *pack){
 
@@ -422,6 +559,7 @@ int mifare_ultra_readblock(uint8_t blockNo, uint8_t *blockData)
 	int result = 0;
 
 	for (retries = 0; retries < MFU_MAX_RETRIES; retries++) {
+		if (retries) mf_comm_stats.retransmissions++;
 		len = mifare_sendcmd_short(NULL, 1, MIFARE_CMD_READBLOCK, blockNo, receivedAnswer, receivedAnswerPar, NULL);
 		if (len == 1) {
 			if (MF_DBGLEVEL >= MF_DBG_ERROR) Dbprintf("Cmd Error: %02x", receivedAnswer[0]);
@@ -429,6 +567,7 @@ int mifare_ultra_readblock(uint8_t blockNo, uint8_t *blockData)
 			continue;
 		}
 		if (len != 18) {
+			if (!len) mf_comm_stats.timeouts++;
 			if (MF_DBGLEVEL >= MF_DBG_ERROR) Dbprintf("Cmd Error: card timeout. len: %x", len);
 			result = 2;
 			continue;
@@ -437,6 +576,7 @@ int mifare_ultra_readblock(uint8_t blockNo, uint8_t *blockData)
 		memcpy(bt, receivedAnswer + 16, 2);
 		AppendCrc14443a(receivedAnswer, 16);
 		if (bt[0] != receivedAnswer[16] || bt[1] != receivedAnswer[17]) {
+			mf_comm_stats.crc_errors++;
 			if (MF_DBGLEVEL >= MF_DBG_ERROR) Dbprintf("Cmd CRC response error.");
 			result = 3;
 			continue;
@@ -456,6 +596,58 @@ int mifare_ultra_readblock(uint8_t blockNo, uint8_t *blockData)
 	return 0;
 }
 
+// read a run of consecutive blocks with one FAST_READ command (EV1/NTAG only).
+// The response carries 4 bytes per block plus CRC, so the run must fit in
+// MAX_FRAME_SIZE - 2 bytes.
+int mifare_ultra_fastread(uint8_t startBlock, uint8_t endBlock, uint8_t *blockData)
+{
+	uint16_t len;
+	uint16_t num_bytes = (endBlock - startBlock + 1) * 4;
+	uint8_t blockRange[2] = {startBlock, endBlock};
+	uint8_t bt[2];
+	uint8_t receivedAnswer[MAX_FRAME_SIZE];
+	uint8_t receivedAnswerPar[MAX_PARITY_SIZE];
+	uint8_t retries;
+	int result = 0;
+
+	for (retries = 0; retries < MFU_MAX_RETRIES; retries++) {
+		if (retries) mf_comm_stats.retransmissions++;
+		len = mifare_sendcmd(MIFARE_ULEV1_FASTREAD, blockRange, sizeof(blockRange), receivedAnswer, receivedAnswerPar, NULL);
+		if (len == 1) {
+			// NAK drops the tag back to IDLE; retrying is pointless. Let the
+			// caller fall back to single block reads.
+			if (MF_DBGLEVEL >= MF_DBG_ERROR) Dbprintf("Cmd Error: %02x", receivedAnswer[0]);
+			return 1;
+		}
+		if (len != num_bytes + 2) {
+			if (MF_DBGLEVEL >= MF_DBG_ERROR) Dbprintf("Cmd Error: card timeout. len: %x", len);
+			result = 2;
+			continue;
+		}
+
+		memcpy(bt, receivedAnswer + num_bytes, 2);
+		AppendCrc14443a(receivedAnswer, num_bytes);
+		if (bt[0] != receivedAnswer[num_bytes] || bt[1] != receivedAnswer[num_bytes + 1]) {
+			mf_comm_stats.crc_errors++;
+			if (MF_DBGLEVEL >= MF_DBG_ERROR) Dbprintf("Cmd CRC response error.");
+			result = 3;
+			continue;
+		}
+
+		// No errors encountered; don't retry
+		result = 0;
+		break;
+	}
+
+	if (result != 0) {
+		Dbprintf("Cmd Error: too many retries; fast read failed");
+		return result;
+	}
+
+	memcpy(blockData, receivedAnswer, num_bytes);
+	return 0;
+}
+
 int mifare_classic_writeblock(struct Crypto1State *pcs, uint32_t uid, uint8_t blockNo, uint8_t *blockData)
 {
 	// variables
@@ -876,6 +1068,7 @@ int MifareChkBlockKeys(uint8_t *keys, uint8_t keyCount, uint8_t blockNo, uint8_t
 
 		// can't select
 		if (res == 1) {
+			mf_comm_stats.retransmissions++;
 			retryCount++;
 			if (retryCount >= 5) {
 				Dbprintf("ChkKeys: block=%d key=%d. Can't select. Exit...", blockNo, keyType);
@@ -37,6 +37,19 @@
 
 extern int MF_DBGLEVEL;
 
+// per-session communication statistics, accumulated across mifare operations
+// until the client resets them. Fetched with CMD_MIFARE_COMM_STATS.
+typedef struct {
+	uint32_t auth_attempts;
+	uint32_t auth_failures;
+	uint32_t crc_errors;
+	uint32_t timeouts;
+	uint32_t retransmissions;
+} mf_comm_stats_t;
+
+extern mf_comm_stats_t mf_comm_stats;
+void mf_comm_stats_reset(void);
+
 //functions
 int mifare_sendcmd(uint8_t cmd, uint8_t *data, uint8_t data_size, uint8_t* answer, uint8_t *answer_parity, uint32_t *timing);
 int mifare_sendcmd_short(struct Crypto1State *pcs, uint8_t crypted, uint8_t cmd, uint8_t data, uint8_t* answer, uint8_t *answer_parity, uint32_t *timing);
@@ -45,6 +58,11 @@ int mifare_sendcmd_short(struct Crypto1State *pcs, uint8_t crypted, uint8_t cmd,
 int mifare_classic_auth(struct Crypto1State *pcs, uint32_t uid, uint8_t blockNo, uint8_t keyType, uint64_t ui64Key, uint8_t isNested);
 int mifare_classic_authex(struct Crypto1State *pcs, uint32_t uid, uint8_t blockNo, uint8_t keyType, uint64_t ui64Key, uint8_t isNested, uint32_t * ntptr, uint32_t *timing);
 int mifare_classic_readblock(struct Crypto1State *pcs, uint32_t uid, uint8_t blockNo, uint8_t *blockData);
+// immediate air-interface retries on timeout/CRC error before a read is
+// reported as failed; a NACK still fails on the first attempt
+#define MF_READBLOCK_RETRIES 3
+int mifare_classic_readblock_retry(struct Crypto1State *pcs, uint32_t uid, uint8_t blockNo, uint8_t *blockData);
+int mifare_classic_readsector(struct Crypto1State *pcs, uint32_t uid, uint8_t firstBlock, uint8_t numBlocks, uint8_t *dataout);
 int mifare_classic_halt(struct Crypto1State *pcs, uint32_t uid); 
 int mifare_classic_writeblock(struct Crypto1State *pcs, uint32_t uid, uint8_t blockNo, uint8_t *blockData);
 
@@ -52,6 +70,7 @@ int mifare_classic_writeblock(struct Crypto1State *pcs, uint32_t uid, uint8_t bl
 int mifare_ul_ev1_auth(uint8_t *key, uint8_t *pack);
 int mifare_ultra_auth(uint8_t *key);
 int mifare_ultra_readblock(uint8_t blockNo, uint8_t *blockData);
+int mifare_ultra_fastread(uint8_t startBlock, uint8_t endBlock, uint8_t *blockData);
 //int mifare_ultra_writeblock_compat(uint8_t blockNo, uint8_t *blockData);
 int mifare_ultra_writeblock(uint8_t blockNo, uint8_t *blockData);
 int mifare_ultra_halt();
@@ -165,10 +165,49 @@ bool IsBlock1PCF7931(uint8_t *block) {
 	return false;
 }
 
+// Per-position majority voting: every read pass that places a block at a
+// position records a vote, distinct values are tracked side by side and the
+// value with the most votes wins. A single corrupted pass can no longer
+// poison a position the way the old first-write-wins merge could.
+#define PCF7931_MAX_CANDIDATES 4 // distinct values tracked per block position
+#define PCF7931_TARGET_VOTES   3 // passes to fuse before a position counts as settled
+
+typedef struct {
+	uint8_t data[16];
+	uint8_t votes;
+} pcf7931_candidate_t;
+
+static void pcf7931_vote(pcf7931_candidate_t table[][PCF7931_MAX_CANDIDATES], int pos, uint8_t *data) {
+	int i;
+	for (i = 0; i < PCF7931_MAX_CANDIDATES; ++i) {
+		if (table[pos][i].votes && !memcmp(table[pos][i].data, data, 16)) {
+			if (table[pos][i].votes < 0xFF)
+				table[pos][i].votes++;
+			return;
+		}
+	}
+	for (i = 0; i < PCF7931_MAX_CANDIDATES; ++i) {
+		if (!table[pos][i].votes) {
+			memcpy(table[pos][i].data, data, 16);
+			table[pos][i].votes = 1;
+			return;
+		}
+	}
+	// table full: yet another damaged variant, drop it
+}
+
+static pcf7931_candidate_t *pcf7931_consensus(pcf7931_candidate_t table[][PCF7931_MAX_CANDIDATES], int pos) {
+	pcf7931_candidate_t *best = NULL;
+	for (int i = 0; i < PCF7931_MAX_CANDIDATES; ++i) {
+		if (table[pos][i].votes && (!best || table[pos][i].votes > best->votes))
+			best = &table[pos][i];
+	}
+	return best;
+}
+
 void ReadPCF7931() {
-	int found_blocks = 0; // successfully read blocks
 	int max_blocks = 8; // readable blocks
-	uint8_t memory_blocks[8][17]; // PCF content
+	pcf7931_candidate_t block_votes[8][PCF7931_MAX_CANDIDATES]; // fused PCF content
 
 	uint8_t single_blocks[8][17]; // PFC blocks with unknown position
 	int single_blocks_cnt = 0;
@@ -180,11 +219,16 @@ void ReadPCF7931() {
 	int errors = 0; // error counter
 	int tries = 0; // tries counter
 
-	memset(memory_blocks, 0, 8*17*sizeof(uint8_t));
+	memset(block_votes, 0, sizeof(block_votes));
 	memset(single_blocks, 0, 8*17*sizeof(uint8_t));
 
 	int i = 0, j = 0;
+	pcf7931_candidate_t *cons;
 
+	// The passes below run back-to-back in one field session:
+	// LFSetupFPGAForADC() inside DemodPCF7931() keeps the field up when the
+	// configuration is unchanged, so only the first pass pays the antenna
+	// settling delay.
 	do {
 		i = 0;
 
@@ -194,7 +238,7 @@ void ReadPCF7931() {
 			++errors;
 
 		// exit if no block is received
-		if (errors >= 10 && found_blocks == 0 && single_blocks_cnt == 0) {
+		if (errors >= 10 && !found_0_1 && single_blocks_cnt == 0) {
 			Dbprintf("Error, no tag or bad tag");
 			return;
 		}
@@ -231,7 +275,7 @@ void ReadPCF7931() {
 			continue;
 		}
 
-		Dbprintf("(dbg) got %d blocks (%d/%d found) (%d tries, %d errors)", n, found_blocks, (max_blocks == 0 ? found_blocks : max_blocks), tries, errors);
+		Dbprintf("(dbg) got %d blocks (%d tries, %d errors)", n, tries, errors);
 		for (i = 0; i < n; ++i)
 		{
 			print_result("got consecutive blocks", tmp_blocks[i], 16);
@@ -242,77 +286,96 @@ void ReadPCF7931() {
 			while (i < n - 1) {
 				if (IsBlock0PCF7931(tmp_blocks[i]) && IsBlock1PCF7931(tmp_blocks[i+1])) {
 					found_0_1 = 1;
-					memcpy(memory_blocks[0], tmp_blocks[i], 16);
-					memcpy(memory_blocks[1], tmp_blocks[i+1], 16);
-					memory_blocks[0][ALLOC] = memory_blocks[1][ALLOC] = 1;
+					pcf7931_vote(block_votes, 0, tmp_blocks[i]);
+					pcf7931_vote(block_votes, 1, tmp_blocks[i+1]);
 					// block 1 tells how many blocks are going to be sent
-					max_blocks = MAX((memory_blocks[1][14] & 0x7f), memory_blocks[1][15]) + 1;
-					found_blocks = 2;
+					max_blocks = MAX((tmp_blocks[i+1][14] & 0x7f), tmp_blocks[i+1][15]) + 1;
 
 					Dbprintf("Found blocks 0 and 1. PCF is transmitting %d blocks.", max_blocks);
 
 					// handle the following blocks
-					for (j = i + 2; j < n; ++j) {
-						memcpy(memory_blocks[found_blocks], tmp_blocks[j], 16);
-						memory_blocks[found_blocks][ALLOC] = 1;
-						++found_blocks;
-					}
+					for (j = i + 2; j < n; ++j)
+						pcf7931_vote(block_votes, 2 + (j - i - 2), tmp_blocks[j]);
 					break;
 				}
 				++i;
 			}
 		} else {
-			// Trying to re-order blocks
-			// Look for identical block in memory blocks
+			// Re-order the blocks: a block matching the consensus at a known
+			// position anchors its neighbour to the adjacent position. The
+			// placements are resolved first and each block votes at most
+			// once per pass, so a vote count reads as "seen in n passes".
+			int placed[4] = { -1, -1, -1, -1 };
+
 			while (i < n-1) {
 				// skip all zeroes blocks
 				if (memcmp(tmp_blocks[i], "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", 16)) {
 					for (j = 1; j < max_blocks - 1; ++j) {
-						if (!memcmp(tmp_blocks[i], memory_blocks[j], 16) && !memory_blocks[j+1][ALLOC]) {
-							memcpy(memory_blocks[j+1], tmp_blocks[i+1], 16);
-							memory_blocks[j+1][ALLOC] = 1;
-							if (++found_blocks >= max_blocks) goto end;
+						cons = pcf7931_consensus(block_votes, j);
+						if (cons && !memcmp(tmp_blocks[i], cons->data, 16)) {
+							if (placed[i] < 0) placed[i] = j;
+							if (placed[i+1] < 0) placed[i+1] = j+1;
+							break;
 						}
 					}
 				}
 				if (memcmp(tmp_blocks[i+1], "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", 16)) {
 					for (j = 0; j < max_blocks; ++j) {
-						if (!memcmp(tmp_blocks[i+1], memory_blocks[j], 16) && !memory_blocks[(j == 0 ? max_blocks : j) -1][ALLOC]) {
-							if (j == 0) {
-								memcpy(memory_blocks[max_blocks - 1], tmp_blocks[i], 16);
-								memory_blocks[max_blocks - 1][ALLOC] = 1;
-							} else {
-								memcpy(memory_blocks[j-1], tmp_blocks[i], 16);
-								memory_blocks[j-1][ALLOC] = 1;
-							}
-							if (++found_blocks >= max_blocks) goto end;
+						cons = pcf7931_consensus(block_votes, j);
+						if (cons && !memcmp(tmp_blocks[i+1], cons->data, 16)) {
+							if (placed[i+1] < 0) placed[i+1] = j;
+							if (placed[i] < 0) placed[i] = (j == 0 ? max_blocks : j) - 1;
+							break;
 						}
 					}
 				}
 				++i;
 			}
+
+			for (i = 0; i < n; ++i) {
+				if (placed[i] >= 0 && placed[i] < max_blocks)
+					pcf7931_vote(block_votes, placed[i], tmp_blocks[i]);
+			}
 		}
 		++tries;
 		if (BUTTON_PRESS()) {
 			Dbprintf("Button pressed, stopping.");
 			goto end;
 		}
+
+		// done once every position has a settled consensus
+		if (found_0_1) {
+			j = 1;
+			for (i = 0; i < max_blocks; ++i) {
+				cons = pcf7931_consensus(block_votes, i);
+				if (!cons || cons->votes < PCF7931_TARGET_VOTES) {
+					j = 0;
+					break;
+				}
+			}
+			if (j) break;
+		}
 	}
-	while (found_blocks < max_blocks);
+	while (tries <= 50);
 
  end:
 	Dbprintf("-----------------------------------------");
-	Dbprintf("Memory content:");
+	Dbprintf("Memory content (consensus of %d passes):", tries);
 	Dbprintf("-----------------------------------------");
+	j = 1;
 	for (i = 0; i < max_blocks; ++i) {
-		if (memory_blocks[i][ALLOC])
-			print_result("Block", memory_blocks[i], 16);
-		else
+		cons = pcf7931_consensus(block_votes, i);
+		if (cons) {
+			print_result("Block", cons->data, 16);
+			Dbprintf("  block %d confidence: %d vote(s)", i, cons->votes);
+		} else {
 			Dbprintf("<missing block %d>", i);
+			j = 0;
+		}
 	}
 	Dbprintf("-----------------------------------------");
 
-	if (found_blocks < max_blocks) {
+	if (!j) {
 		Dbprintf("-----------------------------------------");
 		Dbprintf("Blocks with unknown position:");
 		Dbprintf("-----------------------------------------");
@@ -0,0 +1,281 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Stand-alone operation sequencer. A small table of operations (read a card,
+// check keys from the flash store dictionary, simulate the last card, delay,
+// log a marker) is uploaded over USB and then executed untethered on a long
+// button press, with the per-step results collected into a log the client
+// fetches after reconnecting.
+//-----------------------------------------------------------------------------
+
+#include "proxmark3.h"
+#include "apps.h"
+#include "util.h"
+#include "string.h"
+#include "cmd.h"
+#include "fpgaloader.h"
+#include "iso14443a.h"
+#include "mifareutil.h"
+#include "flashstore.h"
+#include "BigBuf.h"
+
+// one uploaded table entry; op codes and the result log format are shared
+// with the client through usb_cmd.h
+typedef struct {
+	uint8_t op;
+	uint8_t flags;
+	uint16_t arg16;
+	uint32_t arg32;
+} seq_op_t;
+
+#define SEQ_MAX_OPS		(USB_CMD_DATA_SIZE / sizeof(seq_op_t))
+#define SEQ_LOG_SIZE	USB_CMD_DATA_SIZE
+
+static seq_op_t seq_prog[SEQ_MAX_OPS];
+static uint8_t seq_len = 0;
+static uint16_t seq_repeat = 1;
+
+// result log: entries of [step][op][status][len][len bytes of data]
+static uint8_t seq_log[SEQ_LOG_SIZE];
+static uint16_t seq_log_len = 0;
+static uint16_t seq_runs_done = 0;
+
+static void SeqLog(uint8_t step, uint8_t op, uint8_t status, const uint8_t *data, uint8_t len)
+{
+	if (seq_log_len + 4 + len > SEQ_LOG_SIZE) {
+		return;		// log full - keep the early results
+	}
+	seq_log[seq_log_len++] = step;
+	seq_log[seq_log_len++] = op;
+	seq_log[seq_log_len++] = status;
+	seq_log[seq_log_len++] = len;
+	if (len) {
+		memcpy(seq_log + seq_log_len, data, len);
+		seq_log_len += len;
+	}
+}
+
+// upload a program. arg[0] = number of ops, arg[1] = repeat count for the
+// whole sequence, data = the op table
+void StandAloneSeqLoad(UsbCommand *c)
+{
+	uint32_t count = c->arg[0];
+
+	if (count > SEQ_MAX_OPS) {
+		cmd_send(CMD_ACK, 0, 0, 0, NULL, 0);
+		return;
+	}
+	memcpy(seq_prog, c->d.asBytes, count * sizeof(seq_op_t));
+	seq_len = count;
+	seq_repeat = c->arg[1] ? c->arg[1] : 1;
+	seq_log_len = 0;
+	seq_runs_done = 0;
+	cmd_send(CMD_ACK, seq_len, seq_repeat, 0, NULL, 0);
+}
+
+// fetch the result log of the last run
+void StandAloneSeqResult(void)
+{
+	cmd_send(CMD_ACK, seq_log_len, seq_runs_done, seq_len, seq_log, seq_log_len);
+}
+
+bool StandAloneSeqLoaded(void)
+{
+	return seq_len > 0;
+}
+
+// read one 14a card, remember it for later SIM steps. arg32 = give-up
+// timeout in ms, 0 = keep trying until the button is pressed
+static bool SeqOpRead14a(seq_op_t *op, uint8_t step, iso14a_card_select_t *card,
+                         uint32_t *uid_1st, uint32_t *uid_2nd)
+{
+	uint8_t uid[10] = {0};
+	uint32_t start = GetTickCount();
+	bool found = false;
+
+	iso14443a_setup(FPGA_HF_ISO14443A_READER_MOD);
+	while (!BUTTON_PRESS()) {
+		WDT_HIT();
+		if (iso14443a_select_card(uid, card, NULL, true, 0, true)) {
+			found = true;
+			break;
+		}
+		if (op->arg32 && GetTickCount() - start > op->arg32) {
+			break;
+		}
+	}
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+	if (!found) {
+		SeqLog(step, op->op, 0, NULL, 0);
+		return false;
+	}
+
+	// set UID byte order for the simulator, as in StandAloneMode14a
+	uint32_t uid_tmp1 = 0, uid_tmp2 = 0;
+	uint8_t *dst = (uint8_t *)&uid_tmp1;
+	for (int i = 0; i < 4; i++)
+		dst[i] = uid[3-i];
+	dst = (uint8_t *)&uid_tmp2;
+	for (int i = 0; i < 4; i++)
+		dst[i] = uid[7-i];
+	if (uid_tmp2) {
+		*uid_1st = (uid_tmp1) >> 8;
+		*uid_2nd = (uid_tmp1 << 24) + (uid_tmp2 >> 8);
+	} else {
+		*uid_1st = uid_tmp1;
+		*uid_2nd = uid_tmp2;
+	}
+
+	uint8_t entry[13];
+	memcpy(entry, uid, 10);
+	memcpy(entry + 10, card->atqa, 2);
+	entry[12] = card->sak;
+	SeqLog(step, op->op, 1, entry, sizeof(entry));
+	Dbprintf("seq[%u]: read UID %02x%02x%02x%02x", step, uid[0], uid[1], uid[2], uid[3]);
+	return true;
+}
+
+// check the flash store key dictionary against the card in the field.
+// arg16 = sector count | key type << 8 (0 = A, 1 = B, 2 = both)
+static void SeqOpChkKeys(seq_op_t *op, uint8_t step)
+{
+	uint16_t len = 0;
+	const uint8_t *keys = flashstore_find(FLASHSTORE_ID_MFKEYS, &len);
+	uint16_t keyCount = len / 6;
+	uint8_t sectorCnt = op->arg16 & 0xff;
+	uint8_t keyType = (op->arg16 >> 8) & 0xff;
+	uint8_t found = 0;
+
+	if (sectorCnt == 0 || sectorCnt > 40) {
+		sectorCnt = 16;
+	}
+	if (keys == NULL || keyCount == 0) {
+		Dbprintf("seq[%u]: no key dictionary in the flash store", step);
+		SeqLog(step, op->op, 0, NULL, 0);
+		return;
+	}
+
+	int OLD_MF_DBGLEVEL = MF_DBGLEVEL;
+	MF_DBGLEVEL = MF_DBG_NONE;
+
+	iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+	set_tracing(false);
+
+	bool aborted = false;
+	for (uint8_t sc = 0; sc < sectorCnt && !aborted; sc++) {
+		WDT_HIT();
+		int keyAB = keyType;
+		do {
+			for (uint16_t c = 0; c < keyCount; c += 255) {
+				uint8_t cnt = (keyCount - c > 255) ? 255 : keyCount - c;
+				int res = MifareChkBlockKeys((uint8_t *)keys + c * 6, cnt, FirstBlockOfSector(sc), keyAB & 0x01, OLD_MF_DBGLEVEL);
+				if (res < 0) {		// button pressed or card gone
+					aborted = true;
+					break;
+				}
+				if (res > 0) {
+					// log entry data: [sector][key type][6 byte key]
+					uint8_t entry[8];
+					entry[0] = sc;
+					entry[1] = keyAB & 0x01;
+					memcpy(entry + 2, keys + (c + res - 1) * 6, 6);
+					SeqLog(step, op->op, 1, entry, sizeof(entry));
+					found++;
+					break;
+				}
+			}
+		} while (--keyAB > 0 && !aborted);
+	}
+
+	if (found == 0) {
+		SeqLog(step, op->op, 0, NULL, 0);
+	}
+	Dbprintf("seq[%u]: key check done, %u hit(s)", step, found);
+
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	MF_DBGLEVEL = OLD_MF_DBGLEVEL;
+}
+
+// simulate the last read card until the button is pressed
+static void SeqOpSim14a(seq_op_t *op, uint8_t step, iso14a_card_select_t *card,
+                        uint32_t uid_1st, uint32_t uid_2nd)
+{
+	uint8_t data[512] = {0};
+	int tagType = 1;	// default to Mifare Classic, as StandAloneMode14a does
+
+	if (card->sak == 0 && card->atqa[0] == 0x44 && card->atqa[1] == 0) {
+		tagType = 2;	// Mifare Ultralight
+	} else if (card->sak == 20 && card->atqa[0] == 0x44 && card->atqa[1] == 3) {
+		tagType = 3;	// Mifare DESFire
+	}
+	Dbprintf("seq[%u]: simulating tag type %d, uid %08x %08x", step, tagType, uid_1st, uid_2nd);
+	SimulateIso14443aTag(tagType, uid_1st, uid_2nd, data);
+	SeqLog(step, op->op, 1, NULL, 0);
+	// the button press that ended the simulation must not abort the run
+	SpinDelay(500);
+}
+
+// execute the uploaded sequence; called from the main loop on a long button
+// press. A button press between steps aborts the run.
+void StandAloneSeqRun(void)
+{
+	iso14a_card_select_t card;
+	uint32_t uid_1st = 0, uid_2nd = 0;
+	bool haveCard = false;
+
+	DbpString("Stand-alone sequence! No PC necessary.");
+	seq_log_len = 0;
+	seq_runs_done = 0;
+
+	for (uint16_t run = 0; run < seq_repeat; run++) {
+		for (uint8_t step = 0; step < seq_len; step++) {
+			WDT_HIT();
+			if (BUTTON_PRESS()) {
+				Dbprintf("seq: aborted at run %u step %u", run, step);
+				goto done;
+			}
+			// LED progress: one of the four LEDs per step, round robin
+			LEDsoff();
+			LED(step % 4 + 1, 0);
+
+			seq_op_t *op = &seq_prog[step];
+			switch (op->op) {
+				case SEQ_OP_READ_14A:
+					haveCard = SeqOpRead14a(op, step, &card, &uid_1st, &uid_2nd) || haveCard;
+					break;
+				case SEQ_OP_CHK_KEYS:
+					SeqOpChkKeys(op, step);
+					break;
+				case SEQ_OP_SIM_14A:
+					if (haveCard) {
+						SeqOpSim14a(op, step, &card, uid_1st, uid_2nd);
+					} else {
+						Dbprintf("seq[%u]: no card read yet, skipping simulation", step);
+						SeqLog(step, op->op, 0, NULL, 0);
+					}
+					break;
+				case SEQ_OP_DELAY:
+					// chunked so the watchdog stays fed and the button works
+					for (uint32_t left = op->arg32; left > 0 && !BUTTON_PRESS(); left -= left > 100 ? 100 : left) {
+						SpinDelay(left > 100 ? 100 : left);
+						WDT_HIT();
+					}
+					break;
+				case SEQ_OP_LOG:
+					SeqLog(step, op->op, 1, (uint8_t *)&op->arg32, 4);
+					break;
+				default:
+					Dbprintf("seq[%u]: unknown op %u, skipping", step, op->op);
+					break;
+			}
+		}
+		seq_runs_done++;
+	}
+done:
+	FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+	LEDsoff();
+	Dbprintf("seq: %u run(s) done, %u log bytes collected", seq_runs_done, seq_log_len);
+}
@@ -9,6 +9,7 @@
 #include <proxmark3.h>
 #include "usb_cdc.h"
 #include "cmd.h"
+#include "crc32.h"
 //#include "usb_hid.h"
 
 void DbpString(char *str) {
@@ -89,6 +90,102 @@ static void Fatal(void)
   for(;;);
 }
 
+/* CMD_WRITE_LZ decoder state. The client streams one LZSS stream per run of
+ * dirty blocks; we inflate byte by byte and program every completed 0x200
+ * byte block in place, so no more than one block of output is ever buffered.
+ * zlib inflate does not fit in the bootrom flash budget, hence the tiny
+ * hand-rolled format (documented in usb_cmd.h).
+ */
+static uint8_t lz_win[LZSS_WIN_SIZE];
+static uint32_t lz_block[0x200 / sizeof(uint32_t)];
+static uint32_t lz_win_pos, lz_fill, lz_addr;
+static uint32_t lz_ctl, lz_ctl_bits;
+static int lz_match_b0;
+
+/* program the completed block in lz_block at lz_addr, same sequence as
+ * CMD_FINISH_WRITE */
+static int lz_program(void)
+{
+  uint32_t* flash_mem = (uint32_t*)(&_flash_start);
+  for (size_t j=0; j<2; j++) {
+    for(int i = 0+(64*j); i < 64+(64*j); i++) {
+      flash_mem[i] = lz_block[i];
+    }
+
+    uint32_t flash_address = lz_addr + (0x100*j);
+
+    if( ((flash_address+AT91C_IFLASH_PAGE_SIZE-1) >= end_addr) || (flash_address < start_addr) ) {
+      return -1;
+    }
+    uint32_t page_n = (flash_address - ((uint32_t)flash_mem)) / AT91C_IFLASH_PAGE_SIZE;
+    AT91C_BASE_EFC0->EFC_FCR = MC_FLASH_COMMAND_KEY |
+    MC_FLASH_COMMAND_PAGEN(page_n) |
+    AT91C_MC_FCMD_START_PROG;
+
+    uint32_t sr;
+    while(!((sr = AT91C_BASE_EFC0->EFC_FSR) & AT91C_MC_FRDY));
+    if(sr & (AT91C_MC_LOCKE | AT91C_MC_PROGE)) {
+      return -1;
+    }
+  }
+  lz_addr += 0x200;
+  return 0;
+}
+
+static int lz_output(uint8_t b)
+{
+  ((uint8_t *)lz_block)[lz_fill++] = b;
+  lz_win[lz_win_pos] = b;
+  lz_win_pos = (lz_win_pos + 1) & (LZSS_WIN_SIZE - 1);
+  if (lz_fill == 0x200) {
+    lz_fill = 0;
+    return lz_program();
+  }
+  return 0;
+}
+
+/* feed compressed bytes into the decoder; tokens may straddle frames */
+static int lz_feed(const uint8_t *in, uint32_t len)
+{
+  for (uint32_t n = 0; n < len; n++) {
+    uint8_t b = in[n];
+    /* a pending match byte outranks a control byte refill: the match may
+     * have been the eighth token of its group */
+    if (lz_match_b0 >= 0) {
+      uint32_t off = lz_match_b0 | (((uint32_t)b & 0xF0) << 4);
+      uint32_t mlen = (b & 0x0F) + LZSS_MIN_MATCH;
+      lz_match_b0 = -1;
+      if (off == 0) {
+        return -1;
+      }
+      uint32_t src = (lz_win_pos - off) & (LZSS_WIN_SIZE - 1);
+      while (mlen--) {
+        if (lz_output(lz_win[src])) {
+          return -1;
+        }
+        src = (src + 1) & (LZSS_WIN_SIZE - 1);
+      }
+      continue;
+    }
+    if (lz_ctl_bits == 0) {
+      lz_ctl = b;
+      lz_ctl_bits = 8;
+      continue;
+    }
+    uint32_t literal = lz_ctl & 1;
+    lz_ctl >>= 1;
+    lz_ctl_bits--;
+    if (literal) {
+      if (lz_output(b)) {
+        return -1;
+      }
+    } else {
+      lz_match_b0 = b;
+    }
+  }
+  return 0;
+}
+
 void UsbPacketReceived(uint8_t *packet, int len) {
   int i, dont_ack=0;
   UsbCommand* c = (UsbCommand *)packet;
@@ -104,7 +201,8 @@ void UsbPacketReceived(uint8_t *packet, int len) {
     case CMD_DEVICE_INFO: {
       dont_ack = 1;
       arg0 = DEVICE_INFO_FLAG_BOOTROM_PRESENT | DEVICE_INFO_FLAG_CURRENT_MODE_BOOTROM |
-      DEVICE_INFO_FLAG_UNDERSTANDS_START_FLASH;
+      DEVICE_INFO_FLAG_UNDERSTANDS_START_FLASH | DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC |
+      DEVICE_INFO_FLAG_UNDERSTANDS_WRITE_LZ;
       if(common_area.flags.osimage_present) {
         arg0 |= DEVICE_INFO_FLAG_OSIMAGE_PRESENT;
       }
@@ -153,6 +251,53 @@ void UsbPacketReceived(uint8_t *packet, int len) {
       }
     } break;
       
+    case CMD_FLASH_CRC: {
+      /* Report CRCs of the current flash contents, so the flasher can skip
+       * blocks that are identical already. arg0 = address, arg1 = number of
+       * 0x200 byte blocks (at most 128, one response worth of CRCs).
+       */
+      dont_ack = 1;
+      uint32_t num_blocks = (uint32_t)c->arg[1];
+      static uint32_t block_crcs[USB_CMD_DATA_SIZE / sizeof(uint32_t)];
+      if (num_blocks > USB_CMD_DATA_SIZE / sizeof(uint32_t)) {
+        num_blocks = USB_CMD_DATA_SIZE / sizeof(uint32_t);
+      }
+      if (arg0 < (uint32_t)&_flash_start || arg0 + num_blocks * 0x200 > (uint32_t)&_flash_end) {
+        cmd_send(CMD_NACK,0,0,0,0,0);
+      } else {
+        for (uint32_t b = 0; b < num_blocks; b++) {
+          crc32((uint8_t *)(arg0 + b * 0x200), 0x200, (uint8_t *)&block_crcs[b]);
+        }
+        cmd_send(CMD_ACK,arg0,num_blocks,0,block_crcs,num_blocks * sizeof(uint32_t));
+      }
+    } break;
+
+    case CMD_WRITE_LZ: {
+      uint32_t zlen = (uint32_t)c->arg[1];
+      uint32_t flags = (uint32_t)c->arg[2];
+      if (flags & WRITE_LZ_FIRST) {
+        lz_addr = arg0;
+        lz_fill = 0;
+        lz_win_pos = 0;
+        lz_ctl_bits = 0;
+        lz_match_b0 = -1;
+      }
+      if (zlen > USB_CMD_DATA_SIZE) {
+        zlen = USB_CMD_DATA_SIZE;
+      }
+      int fail = lz_feed(c->d.asBytes, zlen);
+      if (!fail && (flags & WRITE_LZ_LAST)) {
+        /* pad a trailing partial block out to erased-flash bytes */
+        while (lz_fill != 0 && !fail) {
+          fail = lz_output(0xFF);
+        }
+      }
+      if (fail) {
+        dont_ack = 1;
+        cmd_send(CMD_NACK,0,0,0,0,0);
+      }
+    } break;
+
     case CMD_HARDWARE_RESET: {
       usb_disable();
       AT91C_BASE_RSTC->RSTC_RCR = RST_CONTROL_KEY | AT91C_RSTC_PROCRST;
@@ -0,0 +1,215 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Heap allocation audit: wraps malloc/calloc/realloc/free (via the linker's
+// --wrap mechanism, see 'make ALLOC_AUDIT=1') and attributes every heap
+// operation to the command that is currently executing. That makes allocator
+// churn in hot paths - per-trace mallocs in annotation loops, statelist
+// (re)allocations mid-attack - visible via 'hw allocaudit', so pool/arena
+// conversions can be targeted where they actually matter.
+//
+// Counters are updated with atomics so multi-threaded attacks are measured
+// too; allocations from worker threads are counted separately per site as a
+// proxy for allocator contention. Blocks are sized via malloc_usable_size(),
+// so no header is prepended and pointers may cross the wrap boundary freely.
+//-----------------------------------------------------------------------------
+
+#include "allocaudit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <malloc.h>	// malloc_usable_size
+#include <pthread.h>
+
+#include "ui.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+#define MAX_SITES       128
+#define MAX_SITE_PATH   64
+#define MAX_SITE_DEPTH  8
+
+typedef struct {
+	char path[MAX_SITE_PATH];
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t bytes;			// total bytes handed out
+	int64_t net_live;		// bytes allocated minus bytes freed under this site
+	uint64_t thread_allocs;	// allocations from threads other than the command thread
+} alloc_site_t;
+
+// site 0 catches everything outside a command (comms thread idle work etc.)
+static alloc_site_t sites[MAX_SITES] = {{.path = "(idle)"}};
+static int num_sites = 1;
+static pthread_mutex_t sites_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// current attribution state - only the command thread pushes/pops
+static volatile int current_site = 0;
+static int site_stack[MAX_SITE_DEPTH];
+static int path_len_stack[MAX_SITE_DEPTH];
+static int site_depth = 0;
+static char site_path[MAX_SITE_PATH];
+static int site_path_len = 0;
+static pthread_t command_thread;
+static bool command_thread_set = false;
+
+static uint64_t global_live = 0;
+static uint64_t global_peak = 0;
+
+static int site_lookup(const char *path)
+{
+	pthread_mutex_lock(&sites_mutex);
+	for (int i = 1; i < num_sites; i++) {
+		if (strcmp(sites[i].path, path) == 0) {
+			pthread_mutex_unlock(&sites_mutex);
+			return i;
+		}
+	}
+	if (num_sites == MAX_SITES) {	// table full - fall back to the catch-all
+		pthread_mutex_unlock(&sites_mutex);
+		return 0;
+	}
+	int i = num_sites++;
+	strncpy(sites[i].path, path, MAX_SITE_PATH - 1);
+	pthread_mutex_unlock(&sites_mutex);
+	return i;
+}
+
+void alloc_audit_push_site(const char *name)
+{
+	if (site_depth == MAX_SITE_DEPTH)
+		return;
+
+	if (site_depth == 0) {
+		command_thread = pthread_self();
+		command_thread_set = true;
+		site_path_len = 0;
+	}
+
+	site_stack[site_depth] = current_site;
+	path_len_stack[site_depth] = site_path_len;
+	site_depth++;
+
+	site_path_len += snprintf(site_path + site_path_len,
+	                          sizeof(site_path) - site_path_len,
+	                          "%s%s", site_path_len ? " " : "", name);
+	if (site_path_len >= (int)sizeof(site_path))
+		site_path_len = sizeof(site_path) - 1;
+
+	current_site = site_lookup(site_path);
+}
+
+void alloc_audit_pop_site(void)
+{
+	if (site_depth == 0)
+		return;
+	site_depth--;
+	current_site = site_stack[site_depth];
+	site_path_len = path_len_stack[site_depth];
+	site_path[site_path_len] = '\0';
+}
+
+static void record_alloc(size_t size)
+{
+	alloc_site_t *site = &sites[current_site];
+
+	__atomic_fetch_add(&site->allocs, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&site->bytes, size, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&site->net_live, size, __ATOMIC_RELAXED);
+	if (command_thread_set && !pthread_equal(pthread_self(), command_thread))
+		__atomic_fetch_add(&site->thread_allocs, 1, __ATOMIC_RELAXED);
+
+	uint64_t live = __atomic_add_fetch(&global_live, size, __ATOMIC_RELAXED);
+	uint64_t peak = __atomic_load_n(&global_peak, __ATOMIC_RELAXED);
+	while (live > peak
+	       && !__atomic_compare_exchange_n(&global_peak, &peak, live, false,
+	                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static void record_free(size_t size)
+{
+	alloc_site_t *site = &sites[current_site];
+
+	__atomic_fetch_add(&site->frees, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&site->net_live, size, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&global_live, size, __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size)
+{
+	void *p = __real_malloc(size);
+	if (p)
+		record_alloc(malloc_usable_size(p));
+	return p;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	void *p = __real_calloc(nmemb, size);
+	if (p)
+		record_alloc(malloc_usable_size(p));
+	return p;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	size_t old_size = ptr ? malloc_usable_size(ptr) : 0;
+	void *p = __real_realloc(ptr, size);
+	if (p) {
+		if (ptr)
+			record_free(old_size);
+		record_alloc(malloc_usable_size(p));
+	}
+	return p;
+}
+
+void __wrap_free(void *ptr)
+{
+	if (ptr)
+		record_free(malloc_usable_size(ptr));
+	__real_free(ptr);
+}
+
+void alloc_audit_report(void)
+{
+	PrintAndLog("%-32s %10s %10s %10s %11s %10s", "command",
+	            "allocs", "frees", "KB", "net live KB", "thread");
+	for (int i = 0; i < num_sites; i++) {
+		alloc_site_t *site = &sites[i];
+		if (!site->allocs && !site->frees)
+			continue;
+		PrintAndLog("%-32s %10llu %10llu %10llu %11lld %10llu",
+		            site->path,
+		            (unsigned long long)site->allocs,
+		            (unsigned long long)site->frees,
+		            (unsigned long long)(site->bytes >> 10),
+		            (long long)(site->net_live / 1024),
+		            (unsigned long long)site->thread_allocs);
+	}
+	PrintAndLog("heap: %llu KB live, %llu KB peak",
+	            (unsigned long long)(__atomic_load_n(&global_live, __ATOMIC_RELAXED) >> 10),
+	            (unsigned long long)(global_peak >> 10));
+}
+
+void alloc_audit_reset(void)
+{
+	pthread_mutex_lock(&sites_mutex);
+	for (int i = 0; i < num_sites; i++) {
+		sites[i].allocs = 0;
+		sites[i].frees = 0;
+		sites[i].bytes = 0;
+		sites[i].net_live = 0;
+		sites[i].thread_allocs = 0;
+	}
+	global_peak = __atomic_load_n(&global_live, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&sites_mutex);
+}
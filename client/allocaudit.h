@@ -0,0 +1,21 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Heap allocation audit (opt-in, build with 'make ALLOC_AUDIT=1')
+//-----------------------------------------------------------------------------
+
+#ifndef ALLOCAUDIT_H__
+#define ALLOCAUDIT_H__
+
+// Attribute subsequent allocations to a command site. The command parser
+// pushes one level per dispatch step, so sites are full command paths
+// ("hf mf hardnested"). Only compiled in ALLOC_AUDIT builds.
+void alloc_audit_push_site(const char *name);
+void alloc_audit_pop_site(void);
+
+void alloc_audit_report(void);
+void alloc_audit_reset(void);
+
+#endif
@@ -0,0 +1,97 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Autocorrelation kernel for AutoCorrelate() in cmddata.c.
+//
+// This file is compiled several times, once per instruction set (see
+// MULTIARCHSRCS in the Makefile), and the widest set the CPU supports is
+// selected at runtime - the same scheme as hardnested_bf_core. The kernel
+// itself is written so the compiler can auto-vectorize the multiply-
+// accumulate loop for each target.
+//-----------------------------------------------------------------------------
+
+#include "autocorr_core.h"
+
+#include "hardnested/hardnested_bf_core.h"		// SIMDExecInstr, GetSIMDInstrAuto()
+
+// For each instruction set, define a dedicated function name:
+#if defined (__AVX512F__)
+#define AUTOCORRELATE autocorrelate_AVX512
+#elif defined (__AVX2__)
+#define AUTOCORRELATE autocorrelate_AVX2
+#elif defined (__AVX__)
+#define AUTOCORRELATE autocorrelate_AVX
+#elif defined (__SSE2__)
+#define AUTOCORRELATE autocorrelate_SSE2
+#elif defined (__MMX__)
+#define AUTOCORRELATE autocorrelate_MMX
+#else
+#define AUTOCORRELATE autocorrelate_NOSIMD
+#endif
+
+// typedefs and declaration of functions:
+typedef void autocorrelate_t(const int*, int*, size_t, int);
+autocorrelate_t autocorrelate_AVX512;
+autocorrelate_t autocorrelate_AVX2;
+autocorrelate_t autocorrelate_AVX;
+autocorrelate_t autocorrelate_SSE2;
+autocorrelate_t autocorrelate_MMX;
+autocorrelate_t autocorrelate_NOSIMD;
+
+void AUTOCORRELATE(const int *in, int *correl, size_t len, int window)
+{
+	if (window <= 0 || (size_t)window >= len) {
+		return;
+	}
+	for (size_t i = 0; i < len - window; ++i) {
+		int sum = 0;
+		// same arithmetic as the old scalar loop in AutoCorrelate(),
+		// including the truncating per-term division
+		for (int j = 0; j < window; ++j) {
+			sum += (in[j] * in[i + j]) / 256;
+		}
+		correl[i] = sum;
+	}
+}
+
+
+#ifndef __MMX__
+
+// determine the available instruction set at runtime and call the correct function
+void autocorrelate_core(const int *in, int *correl, size_t len, int window)
+{
+	autocorrelate_t *autocorrelate_function_p;
+
+	switch(GetSIMDInstrAuto()) {
+#if defined (__i386__) || defined (__x86_64__)
+#if !defined(__APPLE__) || (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1))
+#if (__GNUC__ >= 5) && (__GNUC__ > 5 || __GNUC_MINOR__ > 2)
+		case SIMD_AVX512:
+			autocorrelate_function_p = &autocorrelate_AVX512;
+			break;
+#endif
+		case SIMD_AVX2:
+			autocorrelate_function_p = &autocorrelate_AVX2;
+			break;
+		case SIMD_AVX:
+			autocorrelate_function_p = &autocorrelate_AVX;
+			break;
+		case SIMD_SSE2:
+			autocorrelate_function_p = &autocorrelate_SSE2;
+			break;
+		case SIMD_MMX:
+			autocorrelate_function_p = &autocorrelate_MMX;
+			break;
+#endif
+#endif
+		default:
+			autocorrelate_function_p = &autocorrelate_NOSIMD;
+			break;
+	}
+
+	(*autocorrelate_function_p)(in, correl, len, window);
+}
+
+#endif
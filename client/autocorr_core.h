@@ -0,0 +1,19 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Autocorrelation kernel, compiled per instruction set with runtime CPU
+// dispatch (same scheme as hardnested_bf_core).
+//-----------------------------------------------------------------------------
+
+#ifndef AUTOCORR_CORE_H__
+#define AUTOCORR_CORE_H__
+
+#include <stddef.h>
+
+// Fill correl[0 .. len-window-1] with the windowed autocorrelation of in[],
+// using the widest instruction set the CPU supports.
+extern void autocorrelate_core(const int *in, int *correl, size_t len, int window);
+
+#endif
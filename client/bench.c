@@ -0,0 +1,298 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Client-side benchmark suite ('make bench'). Runs the compute kernels that
+// dominate client CPU time - LF demodulation, autocorrelation, crapto1 state
+// recovery and the hardnested bitflip table load - over canned inputs and
+// prints one JSON object for regression tracking. The JSON is the last line
+// of output, so trackers can simply take the line starting with '{'.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "proxmark3.h"
+#include "whereami.h"
+#include "util_posix.h"
+#include "lfdemod.h"
+#include "cmddata.h"
+#include "cmdhfmfhard.h"
+#include "crapto1/crapto1.h"
+#include "crc16.h"
+#include "iso14443crc.h"
+
+#define MAX_TRACE_SAMPLES	40000
+#define MIN_BENCH_TIME		300		// ms; repeat fast kernels at least this long
+
+typedef struct {
+	const char *name;
+	double ms;				// time per iteration
+	const char *unit;		// what "rate" measures
+	double rate;
+} bench_result_t;
+
+static bench_result_t results[16];
+static int num_results = 0;
+
+static void add_result(const char *name, double ms, const char *unit, double rate)
+{
+	results[num_results].name = name;
+	results[num_results].ms = ms;
+	results[num_results].unit = unit;
+	results[num_results].rate = rate;
+	num_results++;
+}
+
+
+// The executable path accessors normally live in proxmark3.c, which brings
+// its own main(). Provide them here for the code under test.
+static char *my_executable_path = NULL;
+static char *my_executable_directory = NULL;
+
+const char *get_my_executable_path(void)
+{
+	return my_executable_path;
+}
+
+const char *get_my_executable_directory(void)
+{
+	return my_executable_directory;
+}
+
+static void set_my_executable_path(void)
+{
+	int path_length = wai_getExecutablePath(NULL, 0, NULL);
+	if (path_length != -1) {
+		my_executable_path = (char*)malloc(path_length + 1);
+		int dirname_length = 0;
+		if (wai_getExecutablePath(my_executable_path, path_length, &dirname_length) != -1) {
+			my_executable_path[path_length] = '\0';
+			my_executable_directory = (char *)malloc(dirname_length + 2);
+			strncpy(my_executable_directory, my_executable_path, dirname_length+1);
+			my_executable_directory[dirname_length+1] = '\0';
+		}
+	}
+}
+
+// referenced by the GUI objects; the benchmarks never enter the main loop
+void main_loop(char *script_cmds_file, char *script_cmd, bool usb_present)
+{
+	(void)script_cmds_file; (void)script_cmd; (void)usb_present;
+}
+
+
+// load one sample-per-line trace as the demodulators expect it (0-255, as
+// produced by getFromGraphBuf()); returns the number of samples or 0
+static size_t load_trace(const char *filename, uint8_t *dest, size_t max_len)
+{
+	char path[strlen(get_my_executable_directory()) + strlen("../traces/") + strlen(filename) + 1];
+	strcpy(path, get_my_executable_directory());
+	strcat(path, "../traces/");
+	strcat(path, filename);
+
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "benchmark trace %s not found, skipping\n", path);
+		return 0;
+	}
+	size_t n = 0;
+	int sample;
+	while (n < max_len && fscanf(f, "%d", &sample) == 1) {
+		if (sample > 127) sample = 127;
+		if (sample < -127) sample = -127;
+		dest[n++] = (uint8_t)(sample + 128);
+	}
+	fclose(f);
+	return n;
+}
+
+
+static void bench_askdemod(void)
+{
+	static uint8_t trace[MAX_TRACE_SAMPLES];
+	static uint8_t work[MAX_TRACE_SAMPLES];
+	size_t trace_len = load_trace("EM4102-1.pm3", trace, MAX_TRACE_SAMPLES);
+	if (trace_len == 0) return;
+
+	uint32_t iter = 0;
+	uint64_t start = msclock();
+	do {
+		memcpy(work, trace, trace_len);
+		size_t size = trace_len;
+		int clk = 0, invert = 0, startIdx = 0;
+		askdemod_ext(work, &size, &clk, &invert, 100, 0, 1, &startIdx);
+		iter++;
+	} while (msclock() - start < MIN_BENCH_TIME);
+	double ms = (double)(msclock() - start) / iter;
+	add_result("askdemod_ext", ms, "Msamples/s", trace_len / ms / 1000.0);
+}
+
+
+static void bench_fskdemod(void)
+{
+	static uint8_t trace[MAX_TRACE_SAMPLES];
+	static uint8_t work[MAX_TRACE_SAMPLES];
+	size_t trace_len = load_trace("HID-weak-fob-11647.pm3", trace, MAX_TRACE_SAMPLES);
+	if (trace_len == 0) return;
+
+	uint32_t iter = 0;
+	uint64_t start = msclock();
+	do {
+		memcpy(work, trace, trace_len);
+		int startIdx = 0;
+		fskdemod(work, trace_len, 50, 0, 10, 8, &startIdx);
+		iter++;
+	} while (msclock() - start < MIN_BENCH_TIME);
+	double ms = (double)(msclock() - start) / iter;
+	add_result("fskdemod", ms, "Msamples/s", trace_len / ms / 1000.0);
+}
+
+
+static void bench_lfsr_recovery32(void)
+{
+	uint32_t iter = 0;
+	uint64_t start = msclock();
+	do {
+		// generate a genuine keystream word so the recovery does real work
+		struct Crypto1State *cs = crypto1_create(0x112233445566 + iter * 0x10001);
+		crypto1_word(cs, 0xdeadbeef, 0);
+		uint32_t ks2 = crypto1_word(cs, 0, 0);
+		crypto1_destroy(cs);
+		struct Crypto1State *candidates = lfsr_recovery32(ks2, 0);
+		free(candidates);
+		iter++;
+	} while (msclock() - start < MIN_BENCH_TIME);
+	double ms = (double)(msclock() - start) / iter;
+	add_result("lfsr_recovery32", ms, "recoveries/s", 1000.0 / ms);
+}
+
+
+// The bitwise CRC step the table in crc16.c replaced, kept as the reference:
+// the CRCs guard every 14443 frame, so verify the table against the original
+// closed form before timing it - a wrong table would make the throughput
+// number meaningless.
+static uint16_t crc16_reference(uint16_t crc, uint8_t c)
+{
+	uint16_t i, v, tcrc = 0;
+	v = (crc ^ c) & 0xff;
+	for (i = 0; i < 8; i++) {
+		tcrc = ((tcrc ^ v) & 1) ? (tcrc >> 1) ^ 0x8408 : tcrc >> 1;
+		v >>= 1;
+	}
+	return ((crc >> 8) ^ tcrc) & 0xffff;
+}
+
+static void bench_crc16(void)
+{
+	static const uint16_t presets[] = { 0x0000, CRC_14443_A, CRC_14443_B, CRC_ICLASS };
+	static uint8_t frame[256];
+
+	// every table entry, under each preset in use
+	for (size_t p = 0; p < sizeof(presets)/sizeof(presets[0]); p++) {
+		for (int c = 0; c < 256; c++) {
+			if (update_crc16(presets[p], c) != crc16_reference(presets[p], c)) {
+				fprintf(stderr, "crc16 table mismatch at preset %04x byte %02x, skipping\n", presets[p], c);
+				return;
+			}
+		}
+	}
+
+	// both 14443 flavours over a full frame, against the reference loop
+	for (size_t i = 0; i < sizeof(frame); i++) {
+		frame[i] = (uint8_t)(i * 7 + 3);
+	}
+	for (int type = 0; type < 2; type++) {
+		uint16_t preset = type ? CRC_14443_B : CRC_14443_A;
+		uint16_t ref = preset;
+		for (size_t i = 0; i < sizeof(frame); i++) {
+			ref = crc16_reference(ref, frame[i]);
+		}
+		if (preset == CRC_14443_B) {
+			ref = ~ref;
+		}
+		unsigned char b1, b2;
+		ComputeCrc14443(preset, frame, sizeof(frame), &b1, &b2);
+		if (b1 != (ref & 0xff) || b2 != (ref >> 8)) {
+			fprintf(stderr, "ComputeCrc14443 mismatch for preset %04x, skipping\n", preset);
+			return;
+		}
+	}
+
+	uint32_t iter = 0;
+	uint64_t start = msclock();
+	do {
+		unsigned char b1, b2;
+		ComputeCrc14443(CRC_14443_A, frame, sizeof(frame), &b1, &b2);
+		iter++;
+	} while (msclock() - start < MIN_BENCH_TIME);
+	double ms = (double)(msclock() - start) / iter;
+	add_result("crc16_14443", ms, "MB/s", sizeof(frame) / ms / 1000.0);
+}
+
+
+static void bench_autocorrelate(void)
+{
+	static const struct { const char *name; size_t len; } sizes[] = {
+		{ "autocorrelate_8k", 8192 },
+		{ "autocorrelate_32k", 32768 },
+		{ "autocorrelate_128k", 131072 },
+	};
+	for (size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+		int *in = malloc(sizes[s].len * sizeof(int));
+		int *out = malloc(sizes[s].len * sizeof(int));
+		if (in == NULL || out == NULL) {
+			free(in);
+			free(out);
+			return;
+		}
+		for (size_t i = 0; i < sizes[s].len; i++) {	// periodic square wave
+			in[i] = (i % 163 < 82) ? 80 : -80;
+		}
+		uint32_t iter = 0;
+		uint64_t start = msclock();
+		do {
+			AutoCorrelate(in, out, sizes[s].len, 4000, false, false);
+			iter++;
+		} while (msclock() - start < MIN_BENCH_TIME);
+		add_result(sizes[s].name, (double)(msclock() - start) / iter, NULL, 0);
+		free(in);
+		free(out);
+	}
+}
+
+
+static void bench_bitflip_table_load(void)
+{
+	// one cold load/free cycle; needs the state tables next to the executable
+	add_result("bitflip_table_load", hardnested_benchmark_table_load(), NULL, 0);
+}
+
+
+int main(int argc, char *argv[])
+{
+	(void)argc; (void)argv;
+	set_my_executable_path();
+
+	bench_askdemod();
+	bench_fskdemod();
+	bench_lfsr_recovery32();
+	bench_crc16();
+	bench_autocorrelate();
+	bench_bitflip_table_load();
+
+	printf("{\"bench_version\":1,\"results\":[");
+	for (int i = 0; i < num_results; i++) {
+		printf("%s{\"name\":\"%s\",\"ms\":%.3f", i ? "," : "", results[i].name, results[i].ms);
+		if (results[i].unit != NULL) {
+			printf(",\"unit\":\"%s\",\"rate\":%.3f", results[i].unit, results[i].rate);
+		}
+		printf("}");
+	}
+	printf("]}\n");
+	return 0;
+}
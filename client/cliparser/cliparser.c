@@ -10,6 +10,7 @@
 
 #include "cliparser.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 void **argtable = NULL;
@@ -19,17 +20,76 @@ char *programHint = NULL;
 char *programHelp = NULL;
 char buf[500] = {0};
 
+// constructed argtables kept for the process lifetime, one per command.
+// the arg_xxx constructors malloc on every call, so commands that get
+// invoked a lot (scripts, batch key testing) rebuild the same grammar
+// over and over. arg_parse() resets all per-entry state before parsing,
+// so a table built once can safely be parsed again.
+#define MAX_CACHED_PARSERS 64
+
+typedef struct {
+	const char *name;
+	void **argtable;
+	size_t argtableLen;
+} parserCacheEntry;
+
+static parserCacheEntry parserCache[MAX_CACHED_PARSERS] = {{0}};
+static size_t parserCacheLen = 0;
+static bool argtableCached = false;
+
 int CLIParserInit(char *vprogramName, char *vprogramHint, char *vprogramHelp) {
 	argtable = NULL;
 	argtableLen = 0;
+	argtableCached = false;
 	programName = vprogramName;
 	programHint = vprogramHint;
 	programHelp = vprogramHelp;
 	memset(buf, 0x00, 500);
-	
+
 	return 0;
 }
 
+void **CLIParserCachedArgtable(void) {
+	for (size_t i = 0; i < parserCacheLen; i++) {
+		if (!strcmp(parserCache[i].name, programName)) {
+			argtable = parserCache[i].argtable;
+			argtableLen = parserCache[i].argtableLen;
+			argtableCached = true;
+			return argtable;
+		}
+	}
+
+	return NULL;
+}
+
+void **CLIParserCacheArgtable(void *vargtable[], size_t vargtableLen) {
+	argtable = vargtable;
+	argtableLen = vargtableLen;
+	argtableCached = false;
+
+	if (parserCacheLen >= MAX_CACHED_PARSERS)
+		return argtable;
+
+	// the caller's table lives on its stack, keep a copy of the entry pointers
+	void **tbl = calloc(vargtableLen, sizeof(void *));
+	if (!tbl)
+		return argtable;
+	memcpy(tbl, vargtable, vargtableLen * sizeof(void *));
+
+	parserCache[parserCacheLen].name = programName;
+	parserCache[parserCacheLen].argtable = tbl;
+	parserCache[parserCacheLen].argtableLen = vargtableLen;
+	parserCacheLen++;
+
+	argtable = tbl;
+	argtableCached = true;
+	return argtable;
+}
+
+size_t CLIParserArgtableLen(void) {
+	return argtableLen;
+}
+
 int CLIParserParseArg(int argc, char **argv, void* vargtable[], size_t vargtableLen, bool allowEmptyExec) { 
 	int nerrors;
 	
@@ -144,9 +204,11 @@ int CLIParserParseStringEx(const char* str, void* vargtable[], size_t vargtableL
 }
 
 void CLIParserFree() {
-	arg_freetable(argtable, argtableLen);
+	// cached tables stay allocated for the next invocation of the command
+	if (!argtableCached)
+		arg_freetable(argtable, argtableLen);
 	argtable = NULL;
-	
+
 	return;
 }
 
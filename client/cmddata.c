@@ -22,6 +22,9 @@
 #include "cmdparser.h"// already included in cmdmain.h
 #include "usb_cmd.h"  // already included in cmdmain.h and proxmark3.h
 #include "lfdemod.h"  // for demod code
+#include "autocorr_core.h" // for SIMD autocorrelation kernel
+#include "sigkernel.h" // for 'data sigstat' analytics kernels
+#include "workqueue.h" // for 'data demodtune' parallel search
 #include "loclass/cipherutils.h" // for decimating samples in getsamples
 #include "cmdlfem4x.h"// for em410x demod
 
@@ -182,6 +185,7 @@ int CmdPrintDemodBuff(const char *Cmd)
 int CmdGetBitStream(const char *Cmd)
 {
 	int i;
+	graph_push_undo();
 	CmdHpf(Cmd);
 	for (i = 0; i < GraphTraceLen; i++) {
 		if (GraphBuffer[i] >= 1) {
@@ -522,12 +526,12 @@ int AutoCorrelate(const int *in, int *out, size_t len, int window, bool SaveGrph
 	int maxSum = 0;
 	int lastMax = 0;
 	if (verbose) PrintAndLog("performing %d correlations", GraphTraceLen - window);
+
+	// compute the correlation buffer with the widest SIMD kernel the CPU supports
+	autocorrelate_core(in, CorrelBuffer, len, window);
+
 	for (int i = 0; i < len - window; ++i) {
-		int sum = 0;
-		for (int j = 0; j < window; ++j) {
-			sum += (in[j]*in[i + j]) / 256;
-		}
-		CorrelBuffer[i] = sum;
+		int sum = CorrelBuffer[i];
 		if (sum >= maxSum-100 && sum <= maxSum+100) {
 			//another max
 			Correlation = i-lastMax;
@@ -584,7 +588,10 @@ int CmdAutoCorr(const char *Cmd)
 			GraphTraceLen);
 		return 0;
 	}
-	if (grph == 'g') updateGrph=true;
+	if (grph == 'g') {
+		updateGrph = true;
+		graph_push_undo();
+	}
 	return AutoCorrelate(GraphBuffer, GraphBuffer, GraphTraceLen, window, updateGrph, true);
 }
 
@@ -619,6 +626,7 @@ int CmdBuffClear(const char *Cmd)
 
 int CmdDec(const char *Cmd)
 {
+	graph_push_undo();
 	for (int i = 0; i < (GraphTraceLen / 2); ++i)
 		GraphBuffer[i] = GraphBuffer[i * 2];
 	GraphTraceLen /= 2;
@@ -647,6 +655,7 @@ int CmdUndec(const char *Cmd)
 	}
 
 	uint8_t factor = param_get8ex(Cmd, 0,2, 10);
+	graph_push_undo();
 	//We have memory, don't we?
 	int swap[MAX_GRAPH_TRACE_LEN] = { 0 };
 	uint32_t g_index = 0, s_index = 0;
@@ -666,6 +675,18 @@ int CmdUndec(const char *Cmd)
 	return 0;
 }
 
+// step back to the graph buffer state saved before the last destructive
+// operation (see graph_push_undo in graph.c)
+int CmdGraphUndo(const char *Cmd)
+{
+	if (!graph_pop_undo()) {
+		PrintAndLog("nothing to undo");
+		return 0;
+	}
+	PrintAndLog("restored %d samples", GraphTraceLen);
+	return 0;
+}
+
 //by marshmellow
 //shift graph zero up or down based on input + or -
 int CmdGraphShiftZero(const char *Cmd)
@@ -674,6 +695,7 @@ int CmdGraphShiftZero(const char *Cmd)
 	int shift=0;
 	//set options from parameters entered with the command
 	sscanf(Cmd, "%i", &shift);
+	graph_push_undo();
 	int shiftedVal=0;
 	for(int i = 0; i<GraphTraceLen; i++){
 		shiftedVal=GraphBuffer[i]+shift;
@@ -707,13 +729,74 @@ int CmdAskEdgeDetect(const char *Cmd)
 {
 	int thresLen = 25;
 	int ans = 0;
-	sscanf(Cmd, "%i", &thresLen); 
+	sscanf(Cmd, "%i", &thresLen);
 
+	graph_push_undo();
 	ans = AskEdgeDetect(GraphBuffer, GraphBuffer, GraphTraceLen, thresLen);
 	RepaintGraphWindow();
 	return ans;
 }
 
+// quick signal statistics over the GraphBuffer, built on the analytics
+// kernels in sigkernel.c (threaded/vectorized for large captures)
+int CmdSigStat(const char *Cmd)
+{
+	int threshold = 0;
+	char cmdp = param_getchar(Cmd, 0);
+	if (cmdp == 'h' || cmdp == 'H') {
+		PrintAndLog("Usage:  data sigstat [threshold]");
+		PrintAndLog("     [threshold]  level for edge/run analysis - default: 0");
+		PrintAndLog("");
+		PrintAndLog("Prints min/max, RMS, threshold crossings and the dominant run");
+		PrintAndLog("length (~ half the clock for a square modulation) of the GraphBuffer.");
+		return 0;
+	}
+	sscanf(Cmd, "%i", &threshold);
+
+	if (GraphTraceLen == 0) {
+		PrintAndLog("No samples in GraphBuffer");
+		return 1;
+	}
+
+	uint32_t hist[SIG_HIST_BINS];
+	sig_histogram(GraphBuffer, GraphTraceLen, hist);
+	int min = 127, max = -128;
+	for (int b = 0; b < SIG_HIST_BINS; b++) {
+		if (hist[b] == 0) continue;
+		if (b - 128 < min) min = b - 128;
+		if (b - 128 > max) max = b - 128;
+	}
+
+	uint32_t edges = sig_count_edges(GraphBuffer, GraphTraceLen, threshold);
+	double rms = sig_rms(GraphBuffer, GraphTraceLen);
+
+	uint32_t dominant = 0, numruns = 0;
+	uint32_t *runs = malloc(GraphTraceLen * sizeof(uint32_t));
+	if (runs != NULL) {
+		numruns = sig_run_lengths(GraphBuffer, GraphTraceLen, threshold, runs, GraphTraceLen);
+		uint32_t runhist[512] = {0};
+		for (uint32_t i = 0; i < numruns; i++) {
+			if (runs[i] < 512)
+				runhist[runs[i]]++;
+		}
+		uint32_t best = 0;
+		for (uint32_t r = 1; r < 512; r++) {
+			if (runhist[r] > best) {
+				best = runhist[r];
+				dominant = r;
+			}
+		}
+		free(runs);
+	}
+
+	PrintAndLog("Samples: %d", GraphTraceLen);
+	PrintAndLog("Min/Max: %d / %d", min, max);
+	PrintAndLog("RMS: %.1f", rms);
+	PrintAndLog("Crossings of level %d: %u", threshold, edges);
+	PrintAndLog("Dominant run length: %u samples (%u runs total)", dominant, numruns);
+	return 0;
+}
+
 /* Print our clock rate */
 // uses data from graphbuffer
 // adjusted to take char parameter for type of modulation to find the clock - by marshmellow.
@@ -856,8 +939,9 @@ int CmdFSKrawdemod(const char *Cmd)
 }
 
 //by marshmellow
-//attempt to psk1 demod graph buffer
-int PSKDemod(const char *Cmd, bool verbose)
+//attempt to psk demod graph buffer - psk2 fuses the psk1->psk2 conversion
+//into the demod output pass instead of rewalking the bitstream afterwards
+static int PSKDemodInt(const char *Cmd, bool verbose, bool psk2)
 {
 	int invert=0;
 	int clk=0;
@@ -876,7 +960,10 @@ int PSKDemod(const char *Cmd, bool verbose)
 	if (BitLen==0) return 0;
 	int errCnt=0;
 	int startIdx = 0;
-	errCnt = pskRawDemod_ext(BitStream, &BitLen, &clk, &invert, &startIdx);
+	if (psk2)
+		errCnt = psk2RawDemod_ext(BitStream, &BitLen, &clk, &invert, &startIdx);
+	else
+		errCnt = pskRawDemod_ext(BitStream, &BitLen, &clk, &invert, &startIdx);
 	if (errCnt > maxErr){
 		if (g_debugMode || verbose) PrintAndLog("Too many errors found, clk: %d, invert: %d, numbits: %d, errCnt: %d",clk,invert,BitLen,errCnt);
 		return 0;
@@ -898,6 +985,19 @@ int PSKDemod(const char *Cmd, bool verbose)
 	return 1;
 }
 
+//by marshmellow
+//attempt to psk1 demod graph buffer
+int PSKDemod(const char *Cmd, bool verbose)
+{
+	return PSKDemodInt(Cmd, verbose, false);
+}
+
+//attempt to psk2 demod graph buffer (psk1 demod with fused conversion)
+int PSK2Demod(const char *Cmd, bool verbose)
+{
+	return PSKDemodInt(Cmd, verbose, true);
+}
+
 // by marshmellow
 // takes 3 arguments - clock, invert, maxErr as integers
 // attempts to demodulate nrz only
@@ -1017,12 +1117,11 @@ int CmdPSK2rawDemod(const char *Cmd)
 		PrintAndLog("          : data rawdemod p2 64 1 0  = demod a psk2 tag from GraphBuffer using a clock of RF/64, inverting output and allowing 0 demod errors");
 		return 0;
 	}
-	ans=PSKDemod(Cmd, true);
+	ans=PSK2Demod(Cmd, true);
 	if (!ans){
-		if (g_debugMode) PrintAndLog("Error demoding: %d",ans);  
+		if (g_debugMode) PrintAndLog("Error demoding: %d",ans);
 		return 0;
-	} 
-	psk1TOpsk2(DemodBuffer, DemodBufferLen);
+	}
 	PrintAndLog("PSK2 demoded bitstream:");
 	// Now output the bitstream to the scrollback by line of 16 bits
 	printDemodBuff();  
@@ -1160,12 +1259,117 @@ int CmdHide(const char *Cmd)
 	return 0;
 }
 
+// Fused filter pipeline over the graph buffer. The spec is a space-separated
+// chain of hpf/norm/dec stages; each stage's reduction (mean or min/max) is
+// computed on the fly against the still-untouched buffer by replaying the
+// earlier stages per sample, and the samples are rewritten in one final pass
+// with a single undo snapshot and repaint. Results match running the
+// individual commands in sequence.
+#define GRAPH_CHAIN_MAX 16
+
+enum { GC_HPF, GC_NORM };
+
+typedef struct {
+	uint8_t op;
+	int p1, p2;		// hpf: mean / norm: min, max
+} graph_chain_stage_t;
+
+static int graphChainValue(const graph_chain_stage_t *stages, int count, int v)
+{
+	for (int k = 0; k < count; ++k) {
+		if (stages[k].op == GC_HPF)
+			v -= stages[k].p1;
+		else if (stages[k].p2 != stages[k].p1)
+			v = ((long)(v - ((stages[k].p2 + stages[k].p1) / 2)) * 256) / (stages[k].p2 - stages[k].p1);
+	}
+	return v;
+}
+
+int GraphChain(const char *spec)
+{
+	graph_chain_stage_t stages[GRAPH_CHAIN_MAX];
+	int nstages = 0;
+	int stride = 1;
+	int len = GraphTraceLen;
+	int nops = 0;
+
+	char token[16];
+	for (int n = 0; param_getstr(spec, n, token, sizeof(token)) > 0; ++n) {
+		if (!strcmp(token, "dec")) {
+			stride *= 2;
+			len /= 2;
+			++nops;
+		} else if (!strcmp(token, "hpf")) {
+			if (nstages == GRAPH_CHAIN_MAX) {
+				PrintAndLog("filter chain too long (max %d value stages)", GRAPH_CHAIN_MAX);
+				return 1;
+			}
+			int accum = 0;
+			for (int i = 10; i < len; ++i)
+				accum += graphChainValue(stages, nstages, GraphBuffer[i * stride]);
+			if (len > 10)
+				accum /= (len - 10);
+			stages[nstages].op = GC_HPF;
+			stages[nstages].p1 = accum;
+			++nstages;
+			++nops;
+		} else if (!strcmp(token, "norm")) {
+			if (nstages == GRAPH_CHAIN_MAX) {
+				PrintAndLog("filter chain too long (max %d value stages)", GRAPH_CHAIN_MAX);
+				return 1;
+			}
+			int max = INT_MIN, min = INT_MAX;
+			for (int i = 10; i < len; ++i) {
+				int v = graphChainValue(stages, nstages, GraphBuffer[i * stride]);
+				if (v > max) max = v;
+				if (v < min) min = v;
+			}
+			stages[nstages].op = GC_NORM;
+			stages[nstages].p1 = min;
+			stages[nstages].p2 = max;
+			++nstages;
+			++nops;
+		} else {
+			PrintAndLog("unknown filter '%s' (expected hpf, norm or dec)", token);
+			return 1;
+		}
+	}
+	if (nops == 0)
+		return 1;
+
+	graph_push_undo();
+	for (int i = 0; i < len; ++i)
+		GraphBuffer[i] = graphChainValue(stages, nstages, GraphBuffer[i * stride]);
+	GraphTraceLen = len;
+	RepaintGraphWindow();
+	return 0;
+}
+
+int CmdChain(const char *Cmd)
+{
+	char token[16] = {0};
+	param_getstr(Cmd, 0, token, sizeof(token));
+	if (token[0] == 0 || !strcmp(token, "h") || !strcmp(token, "H")) {
+		PrintAndLog("Usage: data chain <filter> [<filter> ...]");
+		PrintAndLog("Runs a chain of graph filters fused into a single buffer pass with one repaint.");
+		PrintAndLog("Filters:");
+		PrintAndLog("       hpf          Remove DC offset from trace");
+		PrintAndLog("       norm         Normalize max/min to +/-128");
+		PrintAndLog("       dec          Decimate samples by 2");
+		PrintAndLog("Example: 'data chain hpf norm dec dec'");
+		return 0;
+	}
+	return GraphChain(Cmd);
+}
+
 //zero mean GraphBuffer
 int CmdHpf(const char *Cmd)
 {
 	int i;
 	int accum = 0;
 
+	graph_push_undo();
+
 	for (i = 10; i < GraphTraceLen; ++i)
 		accum += GraphBuffer[i];
 	accum /= (GraphTraceLen - 10);
@@ -1324,6 +1528,68 @@ int CmdTuneSamples(const char *Cmd)
 }
 
 
+// Binary sample container for 'data load' / 'data bsave': a small header
+// followed by the raw int32 samples. Text traces have to be parsed line by
+// line; the container is mapped (or block-read) straight into GraphBuffer,
+// which makes re-loading multi-megabyte captures effectively free. Load a
+// text trace once and 'data bsave' it to convert.
+#define PM3_SAMPLES_MAGIC   0x53334d50  // "PM3S"
+#define PM3_SAMPLES_VERSION 1
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+} pm3_samples_header_t;
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// returns the number of samples copied into GraphBuffer, or -1 if the file
+// is not a (valid) binary sample container
+static int loadSamplesBinary(const char *filename)
+{
+	int loaded = -1;
+#ifndef _WIN32
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return -1;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(pm3_samples_header_t)) {
+		close(fd);
+		return -1;
+	}
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) return -1;
+	pm3_samples_header_t *header = (pm3_samples_header_t *)base;
+	if (header->magic == PM3_SAMPLES_MAGIC
+			&& header->version == PM3_SAMPLES_VERSION
+			&& header->count <= MAX_GRAPH_TRACE_LEN
+			&& sizeof(*header) + header->count * sizeof(int32_t) <= (size_t)st.st_size) {
+		memcpy(GraphBuffer, header + 1, header->count * sizeof(int32_t));
+		loaded = header->count;
+	}
+	munmap(base, st.st_size);
+#else
+	// no mmap() on mingw, plain block reads
+	FILE *f = fopen(filename, "rb");
+	if (!f) return -1;
+	pm3_samples_header_t header;
+	if (fread(&header, sizeof(header), 1, f) == 1
+			&& header.magic == PM3_SAMPLES_MAGIC
+			&& header.version == PM3_SAMPLES_VERSION
+			&& header.count <= MAX_GRAPH_TRACE_LEN) {
+		loaded = fread(GraphBuffer, sizeof(int32_t), header.count, f);
+	}
+	fclose(f);
+#endif
+	return loaded;
+}
+
 int CmdLoad(const char *Cmd)
 {
 	char filename[FILE_PATH_SIZE] = {0x00};
@@ -1332,7 +1598,18 @@ int CmdLoad(const char *Cmd)
 	len = strlen(Cmd);
 	if (len > FILE_PATH_SIZE) len = FILE_PATH_SIZE;
 	memcpy(filename, Cmd, len);
-	
+
+	// binary sample container first, no parsing needed
+	int loaded = loadSamplesBinary(filename);
+	if (loaded >= 0) {
+		GraphTraceLen = loaded;
+		PrintAndLog("loaded %d samples", GraphTraceLen);
+		setClockGrid(0,0);
+		DemodBufferLen = 0;
+		RepaintGraphWindow();
+		return 0;
+	}
+
 	FILE *f = fopen(filename, "r");
 	if (!f) {
 		 PrintAndLog("couldn't open '%s'", filename);
@@ -1357,6 +1634,7 @@ int CmdLtrim(const char *Cmd)
 {
 	int ds = atoi(Cmd);
 	if (GraphTraceLen<=0) return 0;
+	graph_push_undo();
 	for (int i = ds; i < GraphTraceLen; ++i)
 		GraphBuffer[i-ds] = GraphBuffer[i];
 	GraphTraceLen -= ds;
@@ -1370,6 +1648,7 @@ int CmdRtrim(const char *Cmd)
 {
 	int ds = atoi(Cmd);
 
+	graph_push_undo();
 	GraphTraceLen = ds;
 
 	RepaintGraphWindow();
@@ -1382,6 +1661,7 @@ int CmdMtrim(const char *Cmd) {
 	sscanf(Cmd, "%i %i", &start, &stop);
 
 	if (start > GraphTraceLen	|| stop > GraphTraceLen || start > stop) return 0;
+	graph_push_undo();
 	start++; //leave start position sample
 
 	GraphTraceLen = stop - start;
@@ -1397,6 +1677,8 @@ int CmdNorm(const char *Cmd)
 	int i;
 	int max = INT_MIN, min = INT_MAX;
 
+	graph_push_undo();
+
 	for (i = 10; i < GraphTraceLen; ++i) {
 		if (GraphBuffer[i] > max)
 			max = GraphBuffer[i];
@@ -1420,6 +1702,33 @@ int CmdPlot(const char *Cmd)
 	return 0;
 }
 
+// save the graph buffer as a binary sample container (see loadSamplesBinary)
+int CmdBSave(const char *Cmd)
+{
+	char filename[FILE_PATH_SIZE] = {0x00};
+	int len = 0;
+
+	len = strlen(Cmd);
+	if (len > FILE_PATH_SIZE) len = FILE_PATH_SIZE;
+	memcpy(filename, Cmd, len);
+
+	FILE *f = fopen(filename, "wb");
+	if (!f) {
+		PrintAndLog("couldn't open '%s'", filename);
+		return 0;
+	}
+	pm3_samples_header_t header = {PM3_SAMPLES_MAGIC, PM3_SAMPLES_VERSION, GraphTraceLen};
+	if (fwrite(&header, sizeof(header), 1, f) != 1
+			|| fwrite(GraphBuffer, sizeof(int32_t), GraphTraceLen, f) != (size_t)GraphTraceLen) {
+		PrintAndLog("couldn't write '%s'", filename);
+		fclose(f);
+		return 0;
+	}
+	fclose(f);
+	PrintAndLog("saved %d samples to '%s'", GraphTraceLen, Cmd);
+	return 0;
+}
+
 int CmdSave(const char *Cmd)
 {
 	char filename[FILE_PATH_SIZE] = {0x00};
@@ -1490,6 +1799,7 @@ int CmdDirectionalThreshold(const char *Cmd)
 
 	printf("Applying Up Threshold: %d, Down Threshold: %d\n", upThres, downThres);
 
+	graph_push_undo();
 	directionalThreshold(GraphBuffer, GraphBuffer,GraphTraceLen, upThres, downThres);
 	RepaintGraphWindow();
 	return 0;
@@ -1498,6 +1808,7 @@ int CmdDirectionalThreshold(const char *Cmd)
 int CmdZerocrossings(const char *Cmd)
 {
 	// Zero-crossings aren't meaningful unless the signal is zero-mean.
+	graph_push_undo();
 	CmdHpf("");
 
 	int sign = 1;
@@ -1808,6 +2119,7 @@ int CmdFSKToNRZ(const char *Cmd) {
 
 	setClockGrid(0,0);
 	DemodBufferLen = 0;
+	graph_push_undo();
 	int ans = FSKToNRZ(GraphBuffer, &GraphTraceLen, clk, fc_low, fc_high);
 	CmdNorm("");
 	RepaintGraphWindow();
@@ -1815,6 +2127,113 @@ int CmdFSKToNRZ(const char *Cmd) {
 }
 
 
+//-----------------------------------------------------------------------------
+// 'data demodtune' - parallel ASK demod parameter search. One grid cell per
+// clock/invert/amplify combination; every worker copies the published sample
+// view into a private buffer because the demod routines modify the samples
+// they are handed.
+//-----------------------------------------------------------------------------
+typedef struct {
+	// parameters in
+	int clock;
+	int invert;
+	bool amp;
+	int maxErr;
+	// results out
+	bool ok;
+	int errCnt;
+	size_t bits;
+} demodtune_cell_t;
+
+static void demodtune_task(void *arg)
+{
+	demodtune_cell_t *cell = (demodtune_cell_t *)arg;
+	cell->ok = false;
+
+	uint8_t *samples = malloc(MAX_GRAPH_TRACE_LEN);
+	if (samples == NULL) return;
+	size_t size = 0;
+	GraphViewCopy(samples, &size);
+	if (size < 255) {
+		free(samples);
+		return;
+	}
+
+	if (cell->amp) askAmp(samples, size);
+	int clk = cell->clock;
+	int invert = cell->invert;
+	int startIdx = 0;
+	int errCnt = askdemod_ext(samples, &size, &clk, &invert, cell->maxErr, 0, 1, &startIdx);
+	free(samples);
+	if (errCnt < 0 || size < 16 || errCnt > cell->maxErr) return;
+	cell->ok = true;
+	cell->errCnt = errCnt;
+	cell->bits = size;
+}
+
+int CmdDemodTune(const char *Cmd)
+{
+	char cmdp = param_getchar(Cmd, 0);
+	if (cmdp == 'h' || cmdp == 'H') {
+		PrintAndLog("Usage:  data demodtune [maxError]");
+		PrintAndLog("     [set maximum allowed errors], default = 100");
+		PrintAndLog("");
+		PrintAndLog("Grid-searches clock/invert/amplify for an ask/manchester decode of the");
+		PrintAndLog("GraphBuffer in parallel, then re-runs the best parameter set on it.");
+		PrintAndLog("    sample: data demodtune");
+		return 0;
+	}
+	if (!HasGraphData()) return 0;
+
+	int maxErr = param_get32ex(Cmd, 0, 100, 10);
+
+	static const int clocks[] = {8, 16, 32, 40, 50, 64, 100, 128};
+	const int numClocks = sizeof(clocks) / sizeof(clocks[0]);
+	demodtune_cell_t cells[sizeof(clocks) / sizeof(clocks[0]) * 4];
+	int n = 0;
+	for (int c = 0; c < numClocks; c++) {
+		for (int invert = 0; invert < 2; invert++) {
+			for (int amp = 0; amp < 2; amp++) {
+				cells[n].clock = clocks[c];
+				cells[n].invert = invert;
+				cells[n].amp = (amp != 0);
+				cells[n].maxErr = maxErr;
+				n++;
+			}
+		}
+	}
+
+	GraphViewPublish();
+	for (int i = 0; i < n; i++) {
+		workqueue_submit(demodtune_task, &cells[i]);
+	}
+	workqueue_join();
+
+	int best = -1;
+	PrintAndLog(" clock | invert | amp | errors | bits");
+	PrintAndLog("-------+--------+-----+--------+------");
+	for (int i = 0; i < n; i++) {
+		if (!cells[i].ok) continue;
+		PrintAndLog("%6d | %6d | %3s | %6d | %u", cells[i].clock, cells[i].invert,
+		            cells[i].amp ? "yes" : "no", cells[i].errCnt, (unsigned int)cells[i].bits);
+		if (best < 0 || cells[i].errCnt < cells[best].errCnt ||
+		    (cells[i].errCnt == cells[best].errCnt && cells[i].bits > cells[best].bits)) {
+			best = i;
+		}
+	}
+	if (best < 0) {
+		PrintAndLog("demodtune: no clock/invert/amplify combination decoded (%d cells tried)", n);
+		return 0;
+	}
+
+	PrintAndLog("\nBest: clock %d, invert %d, amplify %s - applying", cells[best].clock,
+	            cells[best].invert, cells[best].amp ? "on" : "off");
+	char args[40];
+	sprintf(args, "%d %d %d 0 %c", cells[best].clock, cells[best].invert, maxErr,
+	        cells[best].amp ? 'a' : '0');
+	return ASKDemod(args, true, false, 1);
+}
+
 static command_t CommandTable[] =
 {
 	{"help",            CmdHelp,            1, "This help"},
@@ -1823,8 +2242,11 @@ static command_t CommandTable[] =
 	{"biphaserawdecode",CmdBiphaseDecodeRaw,1, "[offset] [invert<0|1>] [maxErr] -- Biphase decode bin stream in DemodBuffer (offset = 0|1 bits to shift the decode start)"},
 	{"bin2hex",         Cmdbin2hex,         1, "bin2hex <digits>     -- Converts binary to hexadecimal"},
 	{"bitsamples",      CmdBitsamples,      0, "Get raw samples as bitstring"},
+	{"bsave",           CmdBSave,           1, "<filename> -- Save trace as binary sample container (loads instantly with 'load')"},
 	{"buffclear",       CmdBuffClear,       1, "Clear sample buffer and graph window"},
+	{"chain",           CmdChain,           1, "<hpf|norm|dec> ... -- Run a chain of graph filters fused in a single pass"},
 	{"dec",             CmdDec,             1, "Decimate samples"},
+	{"demodtune",       CmdDemodTune,       1, "[maxError] -- Grid-search ask/manchester demod parameters in parallel and apply the best decode"},
 	{"detectclock",     CmdDetectClockRate, 1, "[modulation] Detect clock rate of wave in GraphBuffer (options: 'a','f','n','p' for ask, fsk, nrz, psk respectively)"},
 	{"fsktonrz",        CmdFSKToNRZ,        1, "Convert fsk2 to nrz wave for alternate fsk demodulating (for weak fsk)"},
 	{"getbitstream",    CmdGetBitStream,    1, "Convert GraphBuffer's >=1 values to 1 and <1 to 0"},
@@ -1848,9 +2270,11 @@ static command_t CommandTable[] =
 	{"scale",           CmdScale,           1, "<int> -- Set cursor display scale"},
 	{"setdebugmode",    CmdSetDebugMode,    1, "<0|1|2> -- Turn on or off Debugging Level for lf demods"},
 	{"shiftgraphzero",  CmdGraphShiftZero,  1, "<shift> -- Shift 0 for Graphed wave + or - shift value"},
+	{"sigstat",         CmdSigStat,         1, "[threshold] -- Print signal statistics of the GraphBuffer (min/max, RMS, crossings, dominant run length)"},
 	{"dirthreshold",    CmdDirectionalThreshold,   1, "<thres up> <thres down> -- Max rising higher up-thres/ Min falling lower down-thres, keep rest as prev."},
 	{"tune",            CmdTuneSamples,     0, "Get hw tune samples for graph window"},
 	{"undec",           CmdUndec,           1, "Un-decimate samples by 2"},
+	{"undo",            CmdGraphUndo,       1, "Restore graph window to the state before the last destructive operation (repeatable)"},
 	{"zerocrossings",   CmdZerocrossings,   1, "Count time between zero-crossings"},
 	{NULL, NULL, 0, NULL}
 };
@@ -32,6 +32,7 @@
 #include "cmddata.h"
 #include "graph.h"
 #include "fpga.h"
+#include "util.h"
 
 static int CmdHelp(const char *Cmd);
 
@@ -78,8 +79,73 @@ int CmdHFSearch(const char *Cmd){
 int CmdHFSnoop(const char *Cmd)
 {
 	char * pEnd;
-	UsbCommand c = {CMD_HF_SNIFFER, {strtol(Cmd, &pEnd,0),strtol(pEnd, &pEnd,0),0}};
+	int samplesToSkip = strtol(Cmd, &pEnd, 0);
+	int triggersToSkip = strtol(pEnd, &pEnd, 0);
+	int triggerThreshold = strtol(pEnd, &pEnd, 0);
+	UsbCommand c = {CMD_HF_SNIFFER, {samplesToSkip, triggersToSkip, triggerThreshold}};
 	SendCommand(&c);
+
+	// the device reports back when the capture ends (trigger plus full
+	// buffer, or the device button). Enter aborts the wait client side.
+	UsbCommand resp;
+	while (!WaitForResponseTimeout(CMD_ACK, &resp, 2000)) {
+		printf(".");
+		fflush(stdout);
+		if (ukbhit()) {
+			getchar();
+			PrintAndLog("\naborted via keyboard - the device keeps capturing until its button is pressed");
+			return 1;
+		}
+	}
+	printf("\n");
+
+	uint32_t pretrig = (resp.arg[0] >> 16) & 0xffff;
+	uint32_t ring_head = resp.arg[0] & 0xffff;
+	uint32_t complen = resp.arg[1];
+	uint32_t nsamples = resp.arg[2];
+	if (complen == 0) {
+		PrintAndLog("Snoop ended before the trigger fired - nothing captured");
+		return 1;
+	}
+
+	uint8_t *buf = malloc(pretrig + complen);
+	if (buf == NULL)
+		return 1;
+	GetFromBigBuf(buf, pretrig + complen, 0, NULL, -1, false);
+
+	// pre-trigger ring first, oldest sample first
+	int n = 0;
+	for (uint32_t i = 0; i < pretrig && n < MAX_GRAPH_TRACE_LEN; i++)
+		GraphBuffer[n++] = (int)buf[(ring_head + i) % pretrig] - 128;
+
+	// then the delta/RLE stream: an absolute first sample, followed by
+	// signed delta tokens, runs (0x00 <count>) and literals (0x80 <sample>)
+	int prev = 0;
+	for (uint32_t i = 0; i < complen && n < MAX_GRAPH_TRACE_LEN; i++) {
+		uint8_t tok = buf[pretrig + i];
+		if (i == 0) {
+			prev = tok;
+			GraphBuffer[n++] = prev - 128;
+		} else if (tok == 0x00) {
+			if (++i >= complen)
+				break;
+			for (int j = buf[pretrig + i]; j > 0 && n < MAX_GRAPH_TRACE_LEN; j--)
+				GraphBuffer[n++] = prev - 128;
+		} else if (tok == 0x80) {
+			if (++i >= complen)
+				break;
+			prev = buf[pretrig + i];
+			GraphBuffer[n++] = prev - 128;
+		} else {
+			prev += (int8_t)tok;
+			GraphBuffer[n++] = prev - 128;
+		}
+	}
+	free(buf);
+
+	GraphTraceLen = n;
+	PrintAndLog("%u pre-trigger and %u captured samples (%u compressed bytes)", pretrig, nsamples, complen);
+	RepaintGraphWindow();
 	return 0;
 }
 
@@ -112,11 +178,15 @@ static int CmdHFPlot(const char *Cmd)
 		"Plots HF signal after RF signal path and A/D conversion.",
 		"This can be used after any hf command and will show the last few milliseconds of the HF signal.\n"
 		"Note: If the last hf command terminated because of a timeout you will most probably see nothing.\n");
-	void* argtable[] = {
-		arg_param_begin,
-		arg_param_end
-	};
-	CLIExecWithReturn(Cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(Cmd, argtable, true);
 
 	uint8_t buf[FPGA_TRACE_SIZE];
 
@@ -152,7 +222,7 @@ static command_t CommandTable[] =
 	{"list",    CmdHFList,      1, "List protocol data in trace buffer"},
 	{"plot",    CmdHFPlot,      0, "Plot signal"},
 	{"search",  CmdHFSearch,    0, "Search for known HF tags [preliminary]"},
-	{"snoop",   CmdHFSnoop,     0, "<samples to skip (10000)> <triggers to skip (1)> Generic HF Snoop"},
+	{"snoop",   CmdHFSnoop,     0, "<samples to skip (10000)> <triggers to skip (1)> [trigger threshold (240)] Generic HF Snoop"},
 	{NULL,      NULL,           0, NULL}
 };
 
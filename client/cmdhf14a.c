@@ -17,6 +17,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <math.h>
 #include "util.h"
 #include "util_posix.h"
 #include "iso14443crc.h"
@@ -40,6 +41,23 @@ static int waitCmd(uint8_t iLen);
 static uint16_t frameLength = 0;
 uint16_t atsFSC[] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
 
+// Session-scoped cache of the currently selected iso14443-4 card. While an
+// APDU-level caller keeps the field up (leaveSignalON), re-activating reuses
+// the cached select result (UID/ATQA/SAK/ATS and the frame length derived
+// from it) instead of paying a field drop + anticollision + RATS round trip
+// for every workflow step. The device doesn't report field drops, so every
+// client path in this file that drops or reconfigures the field invalidates
+// the cache, as does any failed APDU exchange.
+static struct {
+	bool valid;
+	iso14a_card_select_t card;
+	uint16_t frameLength;
+} cardSession = { false };
+
+static void InvalidateCardSession(void) {
+	cardSession.valid = false;
+}
+
 int CmdHF14AList(const char *Cmd)
 {
 	PrintAndLog("Deprecated command, use 'hf list 14a' instead");
@@ -47,6 +65,7 @@ int CmdHF14AList(const char *Cmd)
 }
 
 int Hf14443_4aGetCardData(iso14a_card_select_t * card) {
+	InvalidateCardSession();
 	UsbCommand c = {CMD_READER_ISO_14443a, {ISO14A_CONNECT, 0, 0}};
 	SendCommand(&c);
 
@@ -90,14 +109,18 @@ int CmdHF14AReader(const char *Cmd) {
 	bool leaveSignalON = false;
 
 	CLIParserInit("hf 14a reader", "Executes ISO1443A anticollision-select group of commands.", NULL);
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("kK",  "keep",    "keep the field active after command executed"),
-		arg_lit0("xX",  "drop",    "just drop the signal field"),
-		arg_lit0("3",   NULL,      "ISO14443-3 select only (skip RATS)"),
-		arg_param_end
-	};
-	if (CLIParserParseString(Cmd, argtable, arg_getsize(argtable), true)){
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("kK",  "keep",    "keep the field active after command executed"),
+			arg_lit0("xX",  "drop",    "just drop the signal field"),
+			arg_lit0("3",   NULL,      "ISO14443-3 select only (skip RATS)"),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	if (CLIParserParseString(Cmd, argtable, CLIParserArgtableLen(), true)){
 		CLIParserFree();
 		return 0;
 	}
@@ -115,6 +138,7 @@ int CmdHF14AReader(const char *Cmd) {
 	if (leaveSignalON)
 		cm |= ISO14A_NO_DISCONNECT;
 
+	InvalidateCardSession();
 	UsbCommand c = {CMD_READER_ISO_14443a, {cm, 0, 0}};
 	SendCommand(&c);
 
@@ -158,6 +182,7 @@ int CmdHF14AReader(const char *Cmd) {
 
 int CmdHF14AInfo(const char *Cmd)
 {
+	InvalidateCardSession();
 	UsbCommand c = {CMD_READER_ISO_14443a, {ISO14A_CONNECT | ISO14A_NO_DISCONNECT, 0, 0}};
 	SendCommand(&c);
 
@@ -455,6 +480,7 @@ int CmdHF14ACUIDs(const char *Cmd)
 
 	PrintAndLog("Collecting %d UIDs", n);
 	PrintAndLog("Start: %" PRIu64, msclock()/1000);
+	InvalidateCardSession();
 	// repeat n times
 	for (int i = 0; i < n; i++) {
 		// execute anticollision procedure
@@ -482,10 +508,141 @@ int CmdHF14ACUIDs(const char *Cmd)
 	return 1;
 }
 
+// inventory all tags in the field in one go. The anticollision tree is
+// walked on the device, so a stack of tags costs a single USB round trip
+int CmdHF14AInventory(const char *Cmd)
+{
+	char cmdp = param_getchar(Cmd, 0);
+	if (cmdp == 'h' || cmdp == 'H') {
+		PrintAndLog("Usage:  hf 14a inventory [maximum number of tags]");
+		PrintAndLog("Enumerates all ISO14443a tags in the field and lists their UIDs.");
+		return 0;
+	}
+
+	// requested maximum number of tags. 0 = as many as fit in one response
+	uint32_t n = param_get32ex(Cmd, 0, 0, 10);
+
+	UsbCommand c = {CMD_READER_ISO_14443A_INVENTORY, {n, 0, 0}};
+	SendCommand(&c);
+
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 5000)) {
+		PrintAndLog("Command execute timeout");
+		return 1;
+	}
+
+	uint16_t count = resp.arg[0] & 0xffff;
+	if (count == 0) {
+		PrintAndLog("No tags found.");
+		return 0;
+	}
+
+	// entries of [1 byte uidlen][10 byte uid][2 byte ATQA][1 byte SAK]
+	for (uint16_t i = 0; i < count; i++) {
+		uint8_t *entry = resp.d.asBytes + i * 14;
+		uint8_t uidlen = entry[0] <= 10 ? entry[0] : 10;
+		PrintAndLog("%2d: UID : %s  ATQA : %02x %02x  SAK : %02x",
+			i + 1, sprint_hex(entry + 1, uidlen), entry[12], entry[11], entry[13]);
+	}
+	PrintAndLog("Found %d tag%s.", count, count == 1 ? "" : "s");
+
+	return 0;
+}
+
+// print min/max/mean/stddev of one timing column. The records are three
+// little endian uint16 frame delay times per cycle, 0 = step failed
+static void print_timing_stats(const char *name, uint8_t *recs, uint32_t count, uint32_t offset)
+{
+	uint32_t samples = 0;
+	uint32_t min = 0xffff, max = 0;
+	uint64_t sum = 0, sqsum = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t fdt = recs[i*6 + offset] | (recs[i*6 + offset + 1] << 8);
+		if (fdt == 0) continue;
+		samples++;
+		sum += fdt;
+		sqsum += (uint64_t)fdt * fdt;
+		if (fdt < min) min = fdt;
+		if (fdt > max) max = fdt;
+	}
+
+	if (samples == 0) {
+		PrintAndLog("%-8s|    0    |      |      |         |", name);
+		return;
+	}
+	double mean = (double)sum / samples;
+	double var = (double)sqsum / samples - mean * mean;
+	PrintAndLog("%-8s| %7u | %4u | %4u | %7.1f | %5.2f", name, samples, min, max, mean, sqrt(var > 0 ? var : 0));
+}
+
+// collect frame delay time distributions of the select sequence. The cycles
+// run autonomously on the device, so 10k samples take seconds instead of
+// 10k USB round trips
+int CmdHF14ATiming(const char *Cmd)
+{
+	char cmdp = param_getchar(Cmd, 0);
+	if (cmdp == 'h' || cmdp == 'H') {
+		PrintAndLog("Usage:  hf 14a timing [number of cycles] [d]");
+		PrintAndLog("Runs WUPA/anticollision/select cycles on the device and records the");
+		PrintAndLog("frame delay time of each card answer in carrier cycles (1/13.56MHz).");
+		PrintAndLog("    d  - also dump the raw samples (atqa;uid;sak per line, 0 = step failed)");
+		PrintAndLog("0 or no cycle count runs as many cycles as the device can record (~6800).");
+		return 0;
+	}
+
+	uint32_t cycles = param_get32ex(Cmd, 0, 0, 10);
+	bool dump = (param_getchar(Cmd, 1) == 'd');
+
+	UsbCommand c = {CMD_READER_ISO_14443A_TIMING, {cycles, 0, 0}};
+	SendCommand(&c);
+
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 300000)) {
+		PrintAndLog("Command execute timeout");
+		return 1;
+	}
+
+	uint32_t count = resp.arg[0];
+	uint32_t bytes = resp.arg[1];
+	if (count == 0) {
+		PrintAndLog("No cycles recorded.");
+		return 0;
+	}
+
+	uint8_t *recs = malloc(bytes);
+	if (recs == NULL) {
+		PrintAndLog("Cannot allocate memory for timing data");
+		return 2;
+	}
+	GetFromBigBuf(recs, bytes, 0, NULL, -1, false);
+
+	PrintAndLog("%u cycles recorded. All times in carrier cycles (1/13.56MHz)", count);
+	PrintAndLog("step    | samples |  min |  max |    mean |  sdev");
+	PrintAndLog("--------|---------|------|------|---------|------");
+	print_timing_stats("atqa", recs, count, 0);
+	print_timing_stats("uid", recs, count, 2);
+	print_timing_stats("sak", recs, count, 4);
+
+	if (dump) {
+		PrintAndLog("");
+		for (uint32_t i = 0; i < count; i++) {
+			PrintAndLog("%u;%u;%u",
+				recs[i*6] | (recs[i*6+1] << 8),
+				recs[i*6+2] | (recs[i*6+3] << 8),
+				recs[i*6+4] | (recs[i*6+5] << 8));
+		}
+	}
+
+	free(recs);
+	return 0;
+}
+
 // ## simulate iso14443a tag
 // ## greg - added ability to specify tag UID
 int CmdHF14ASim(const char *Cmd)
 {
+	InvalidateCardSession();
 	UsbCommand c = {CMD_SIMULATE_TAG_ISO_14443a,{0,0,0}};
 
 	// Retrieve the tag type
@@ -572,26 +729,160 @@ int CmdHF14ASnoop(const char *Cmd) {
 	if (ctmp == 'h' || ctmp == 'H') {
 		PrintAndLog("It get data from the field and saves it into command buffer.");
 		PrintAndLog("Buffer accessible from command hf list 14a.");
-		PrintAndLog("Usage:  hf 14a snoop [c][r]");
+		PrintAndLog("Usage:  hf 14a snoop [c][r][s <filename>][u <uid>][w <cmds>]");
 		PrintAndLog("c - triggered by first data from card");
 		PrintAndLog("r - triggered by first 7-bit request from reader (REQ,WUP,...)");
+		PrintAndLog("s - stream the trace to a file while sniffing, so long sessions");
+		PrintAndLog("    aren't truncated when the trace buffer fills. Stop with the");
+		PrintAndLog("    button, then view with: hf list 14a l <filename>");
+		PrintAndLog("u - only record the session of the card with this UID (4, 7 or");
+		PrintAndLog("    10 bytes hex); other cards' traffic is dropped on the device");
+		PrintAndLog("    after their SELECT diverges, so the buffer lasts much longer");
+		PrintAndLog("w - reader command byte whitelist (hex, e.g. 3060 for MF read +");
+		PrintAndLog("    auth A); short frames and anticollision always pass");
 		PrintAndLog("sample: hf 14a snoop c r");
+		PrintAndLog("sample: hf 14a snoop s mytrace.trc");
+		PrintAndLog("sample: hf 14a snoop u 11223344 w 6061");
 		return 0;
 	}
 
-	for (int i = 0; i < 2; i++) {
+	char filename[FILE_PATH_SIZE] = {0};
+	uint8_t uid[10] = {0};
+	int uidlen = 0;
+	uint8_t wl[16] = {0};
+	int wllen = 0;
+	for (int i = 0; i < 8; i++) {
 		ctmp = param_getchar(Cmd, i);
 		if (ctmp == 'c' || ctmp == 'C') param |= 0x01;
 		if (ctmp == 'r' || ctmp == 'R') param |= 0x02;
+		if (ctmp == 's' || ctmp == 'S') {
+			param |= 0x04;
+			param_getstr(Cmd, ++i, filename, sizeof(filename));
+		}
+		if (ctmp == 'u' || ctmp == 'U') {
+			int hexcnt = 0;
+			param_gethex_ex(Cmd, ++i, uid, &hexcnt);
+			uidlen = hexcnt / 2;
+			if (uidlen != 4 && uidlen != 7 && uidlen != 10) {
+				PrintAndLog("UID filter must be 4, 7 or 10 bytes of hex");
+				return 1;
+			}
+		}
+		if (ctmp == 'w' || ctmp == 'W') {
+			int hexcnt = 0;
+			param_gethex_ex(Cmd, ++i, wl, &hexcnt);
+			wllen = hexcnt / 2;
+			if (wllen < 1 || wllen > (int)sizeof(wl)) {
+				PrintAndLog("command whitelist takes 1 to %zu bytes of hex", sizeof(wl));
+				return 1;
+			}
+		}
+	}
+
+	if ((param & 0x04) && strlen(filename) == 0) {
+		PrintAndLog("streaming mode needs a filename");
+		return 1;
+	}
+
+	InvalidateCardSession();
+	UsbCommand c = {CMD_SNOOP_ISO_14443a, {param, uidlen, wllen}};
+	memcpy(c.d.asBytes, uid, sizeof(uid));
+	memcpy(c.d.asBytes + 10, wl, wllen);
+	SendCommand(&c);
+
+	if (param & 0x04) {
+		FILE *tracefile = fopen(filename, "wb");
+		if (tracefile == NULL) {
+			PrintAndLog("Could not create file %s", filename);
+			return 1;
+		}
+		PrintAndLog("Streaming trace to %s, press the button on the device to stop", filename);
+		UsbCommand resp;
+		for (;;) {
+			if (!WaitForResponseTimeoutW(CMD_UNKNOWN, &resp, 5000, false)) {
+				if (ukbhit()) {
+					getchar();
+					PrintAndLog("aborted via keyboard - device keeps sniffing until the button is pressed");
+					break;
+				}
+				continue;
+			}
+			if (resp.cmd == CMD_DOWNLOADED_TRACE) {
+				uint32_t len = resp.arg[1];
+				if (len > USB_CMD_DATA_SIZE) len = USB_CMD_DATA_SIZE;
+				fwrite(resp.d.asBytes, 1, len, tracefile);
+				continue;
+			}
+			if (resp.cmd == CMD_ACK) {
+				PrintAndLog("Done. %" PRIu64 " trace bytes streamed, %" PRIu64 " entries dropped", (uint64_t)resp.arg[0], (uint64_t)resp.arg[1]);
+				if (resp.arg[2])
+					PrintAndLog("Warning: %" PRIu64 " DMA overruns on the device - the capture has gaps", (uint64_t)resp.arg[2]);
+				break;
+			}
+		}
+		fclose(tracefile);
+		PrintAndLog("View with: hf list 14a l %s", filename);
+	}
+	return 0;
+}
+
+
+int CmdHF14APoll(const char *Cmd) {
+	uint32_t period = 500;
+
+	char ctmp = param_getchar(Cmd, 0);
+	if (ctmp == 'h' || ctmp == 'H') {
+		PrintAndLog("Usage:  hf 14a poll [period_ms]");
+		PrintAndLog("The device polls for ISO14443a tags autonomously and pushes");
+		PrintAndLog("arrival/departure events; press any key to stop.");
+		PrintAndLog("  [period_ms] : poll cadence in milliseconds (default 500)");
+		return 0;
+	}
+	if (ctmp != 0x00) period = param_get32ex(Cmd, 0, 500, 10);
+	if (period == 0) period = 500;
+
+	UsbCommand c = {CMD_TAG_POLL_CONFIG, {period, 0, 0}};
+	clearCommandBuffer();
+	SendCommand(&c);
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500)) {
+		PrintAndLog("Command execution timeout");
+		return 1;
+	}
+	if (resp.arg[0] != 1) {
+		PrintAndLog("Tag polling is not supported by this firmware");
+		return 1;
+	}
+
+	PrintAndLog("Polling every %u ms, press any key to stop", period);
+	for (;;) {
+		if (!WaitForResponseTimeoutW(CMD_UNKNOWN, &resp, 1000, false)) {
+			if (ukbhit()) {
+				getchar();
+				break;
+			}
+			continue;
+		}
+		if (resp.cmd == CMD_TAG_POLL_EVENT) {
+			uint32_t uidlen = resp.arg[2];
+			if (uidlen > 10) uidlen = 10;
+			PrintAndLog("%10u ms: tag %s, UID %s", (uint32_t)resp.arg[1],
+					resp.arg[0] ? "arrived " : "departed",
+					sprint_hex(resp.d.asBytes, uidlen));
+		}
 	}
 
-	UsbCommand c = {CMD_SNOOP_ISO_14443a, {param, 0, 0}};
+	// stop polling
+	c.arg[0] = 0;
+	clearCommandBuffer();
 	SendCommand(&c);
+	WaitForResponseTimeout(CMD_ACK, &resp, 1500);
 	return 0;
 }
 
 
 void DropField() {
+	InvalidateCardSession();
 	UsbCommand c = {CMD_READER_ISO_14443a, {0, 0, 0}};
 	SendCommand(&c);
 }
@@ -604,6 +895,7 @@ int ExchangeRAW14a(uint8_t *datain, int datainlen, bool activateField, bool leav
 
 	if (activateField) {
 		responseNum = false;
+		InvalidateCardSession();
 		UsbCommand resp;
 
 		// Anticollision + SELECT card
@@ -700,6 +992,15 @@ int ExchangeRAW14a(uint8_t *datain, int datainlen, bool activateField, bool leav
 static int SelectCard14443_4(bool disconnect, iso14a_card_select_t *card) {
 	UsbCommand resp;
 
+	// card still selected and field still up from an earlier exchange:
+	// hand out the cached select result instead of reselecting
+	if (cardSession.valid && !disconnect) {
+		frameLength = cardSession.frameLength;
+		if (card)
+			memcpy(card, &cardSession.card, sizeof(iso14a_card_select_t));
+		return 0;
+	}
+
 	frameLength = 0;
 
 	if (card)
@@ -757,15 +1058,33 @@ static int SelectCard14443_4(bool disconnect, iso14a_card_select_t *card) {
 
 	if (disconnect) {
 		DropField();
+	} else {
+		memcpy(&cardSession.card, vcard, sizeof(iso14a_card_select_t));
+		cardSession.frameLength = frameLength;
+		cardSession.valid = true;
 	}
 
 	return 0;
 }
 
 
-static int ExchangeAPDU(bool chainingin, uint8_t *datain, int datainlen, bool activateField, uint8_t *dataout, int maxdataoutlen, int *dataoutlen, bool *chainingout)
-{
-	*chainingout = false;
+int ExchangeAPDU14a(uint8_t *datain, int datainlen, bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen) {
+	*dataoutlen = 0;
+
+	if (datainlen > USB_CMD_DATA_SIZE) {
+		PrintAndLog("APDU ERROR: APDU too long(%d). Max %d bytes", datainlen, USB_CMD_DATA_SIZE);
+		if (!leaveSignalON)
+			DropField();
+		return 2;
+	}
+
+	int res;
+
+retry:;
+	// remember whether the activation came from the session cache: if the
+	// field was dropped behind our back by an unrelated command, the first
+	// exchange fails and we retry once with a forced reselect
+	bool cached = activateField && cardSession.valid;
 
 	if (activateField) {
 		// select with no disconnect and set frameLength
@@ -774,146 +1093,130 @@ static int ExchangeAPDU(bool chainingin, uint8_t *datain, int datainlen, bool ac
 			return selres;
 	}
 
-	uint16_t cmdc = 0;
-	if (chainingin)
-		cmdc = ISO14A_SEND_CHAINING;
-
-	// "Command APDU" length should be 5+255+1, but javacard's APDU buffer might be smaller - 133 bytes
-	// https://stackoverflow.com/questions/32994936/safe-max-java-card-apdu-data-command-and-respond-size
-	// here length USB_CMD_DATA_SIZE=512
-	// timeout must be authomatically set by "get ATS"
-	UsbCommand c = {CMD_READER_ISO_14443a, {ISO14A_APDU | ISO14A_NO_DISCONNECT | cmdc, (datainlen & 0xFFFF), 0}};
+	// The firmware splits the APDU into FSC-sized chained I-blocks, answers
+	// WTX requests and reassembles a chained response on its own, so one USB
+	// round trip carries one complete APDU. Keeping the inter-block timing on
+	// the device stops slow cards (e.g. javacards with a small APDU buffer)
+	// from running into a frame waiting time overrun between our blocks.
+	UsbCommand c = {CMD_READER_ISO_14443a, {ISO14A_APDU_FULL | ISO14A_NO_DISCONNECT, (datainlen & 0xFFFF), 0}};
 	memcpy(c.d.asBytes, datain, datainlen);
 	SendCommand(&c);
 
-	uint8_t *recv;
 	UsbCommand resp;
 
-	if (WaitForResponseTimeout(CMD_ACK, &resp, 1500)) {
-		recv = resp.d.asBytes;
-		int iLen = resp.arg[0];
-		uint8_t res = resp.arg[1];
-
-		int dlen = iLen - 2;
-		if (dlen < 0)
-			dlen = 0;
-		*dataoutlen += dlen;
-
-		if (maxdataoutlen && *dataoutlen > maxdataoutlen) {
-			PrintAndLog("APDU ERROR: Buffer too small(%d). Needs %d bytes", *dataoutlen, maxdataoutlen);
-			return 2;
-		}
-
-		// I-block ACK
-		if ((res & 0xf2) == 0xa2) {
-			*dataoutlen = 0;
-			*chainingout = true;
-			return 0;
-		}
-
-		if(!iLen) {
-			PrintAndLog("APDU ERROR: No APDU response.");
-			return 1;
-		}
-
-		// check apdu length
-		if (iLen < 2 && iLen >= 0) {
-			PrintAndLog("APDU ERROR: Small APDU response. Len=%d", iLen);
-			return 2;
-		}
-
-		// check block TODO
-		if (iLen == -2) {
-			PrintAndLog("APDU ERROR: Block type mismatch.");
-			return 2;
-		}
-
-		memcpy(dataout, recv, dlen);
+	// a card may stretch the whole exchange with WTX requests - be patient
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 5000)) {
+		InvalidateCardSession();
+		if (cached)
+			goto retry;
+		PrintAndLog("APDU ERROR: Reply timeout.");
+		if (!leaveSignalON)
+			DropField();
+		return 4;
+	}
 
-		// chaining
-		if ((res & 0x10) != 0) {
-			*chainingout = true;
-		}
+	int iLen = (int)resp.arg[0];
+	res = 0;
 
-		// CRC Check
-		if (iLen == -1) {
-			PrintAndLog("APDU ERROR: ISO 14443A CRC error.");
-			return 3;
+	if (!iLen) {
+		if (cached) {
+			InvalidateCardSession();
+			goto retry;
 		}
+		PrintAndLog("APDU ERROR: No APDU response.");
+		res = 1;
+	} else if (iLen == -1) {
+		PrintAndLog("APDU ERROR: ISO 14443A CRC error.");
+		res = 3;
+	} else if (iLen == -2) {
+		PrintAndLog("APDU ERROR: Block type mismatch.");
+		res = 2;
+	} else if (iLen == -3) {
+		PrintAndLog("APDU ERROR: APDU response too long.");
+		res = 2;
+	} else if (iLen < 2) {
+		PrintAndLog("APDU ERROR: Small APDU response. Len=%d", iLen);
+		res = 2;
+	} else if (maxdataoutlen && iLen > maxdataoutlen) {
+		PrintAndLog("APDU ERROR: Buffer too small(%d). Needs %d bytes", maxdataoutlen, iLen);
+		res = 2;
 	} else {
-		PrintAndLog("APDU ERROR: Reply timeout.");
-		return 4;
+		memcpy(dataout, resp.d.asBytes, iLen);
+		*dataoutlen = iLen;
 	}
 
-	return 0;
-}
+	// on any exchange error the card state is unknown - force a reselect
+	if (res)
+		InvalidateCardSession();
 
+	if (!leaveSignalON)
+		DropField();
 
-int ExchangeAPDU14a(uint8_t *datain, int datainlen, bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen) {
-	*dataoutlen = 0;
-	bool chaining = false;
-	int res;
+	return res;
+}
 
-	// 3 byte here - 1b framing header, 2b crc16
-	if ( (frameLength && (datainlen > frameLength - 3)) || (datainlen > USB_CMD_DATA_SIZE - 3) ) {
-		int clen = 0;
+// Exchange a list of APDUs back to back in the field: the whole batch goes
+// down in one USB command and the firmware streams one response frame per
+// APDU back, so only the batch pays the USB round trip. The card must
+// already be selected and stays selected. Returns 0 when every entry got a
+// response; on a card exchange error the firmware aborts the rest of the
+// list and the remaining entries stay !ok.
+int ExchangeAPDUBatch14a(apdu_batch_t *items, int count) {
+	int done = 0;
+
+	for (int i = 0; i < count; i++) {
+		items[i].ok = false;
+		items[i].response_len = 0;
+	}
 
-		bool vActivateField = activateField;
+	while (done < count) {
+		UsbCommand c = {CMD_READER_ISO_14443A_APDU_BATCH, {0, 0, 0}};
+		int pos = 0;
+		int in_chunk = 0;
 
-		do {
-			int vlen = MIN(frameLength - 3, datainlen - clen);
-			bool chainBlockNotLast = ((clen + vlen) < datainlen);
+		// pack as many entries as fit into one command
+		for (int i = done; i < count; i++) {
+			if (items[i].apdu_len <= 0 || items[i].apdu_len > 0xff)
+				return 1;
+			if (pos + 1 + items[i].apdu_len > (int)USB_CMD_DATA_SIZE)
+				break;
+			c.d.asBytes[pos++] = items[i].apdu_len;
+			memcpy(&c.d.asBytes[pos], items[i].apdu, items[i].apdu_len);
+			pos += items[i].apdu_len;
+			in_chunk++;
+		}
+		if (in_chunk == 0)
+			return 1;
 
-			*dataoutlen = 0;
-			res = ExchangeAPDU(chainBlockNotLast, &datain[clen], vlen, vActivateField, dataout, maxdataoutlen, dataoutlen, &chaining);
-			if (res) {
-				if (!leaveSignalON)
-					DropField();
+		c.arg[0] = in_chunk;
+		SendCommand(&c);
 
-				return 200;
+		for (int i = 0; i < in_chunk; i++) {
+			UsbCommand resp;
+			if (!WaitForResponseTimeout(CMD_ACK, &resp, 2500)) {
+				InvalidateCardSession();
+				return 2;
 			}
-
-			// check R-block ACK
-			if ((*dataoutlen == 0) && (*dataoutlen != 0 || chaining != chainBlockNotLast)) {
-				if (!leaveSignalON)
-					DropField();
-
-				return 201;
+			if ((int)resp.arg[0] != i) {
+				InvalidateCardSession();
+				return 2;
 			}
-
-			clen += vlen;
-			vActivateField = false;
-			if (*dataoutlen) {
-				if (clen != datainlen)
-					PrintAndLogEx(WARNING, "APDU: I-block/R-block sequence error. Data len=%d, Sent=%d, Last packet len=%d", datainlen, clen, *dataoutlen);
-				break;
+			int rlen = resp.arg[1] & 0xffff;
+			if (rlen == 0xffff) {
+				InvalidateCardSession();
+				return 3;
 			}
-		} while (clen < datainlen);
-	} else {
-		res = ExchangeAPDU(false, datain, datainlen, activateField, dataout, maxdataoutlen, dataoutlen, &chaining);
-		if (res) {
-			if (!leaveSignalON)
-				DropField();
-
-			return res;
-		}
-	}
 
-	while (chaining) {
-		// I-block with chaining
-		res = ExchangeAPDU(false, NULL, 0, false, &dataout[*dataoutlen], maxdataoutlen, dataoutlen, &chaining);
-
-		if (res) {
-			if (!leaveSignalON)
-				DropField();
-
-			return 100;
+			apdu_batch_t *item = &items[done + i];
+			if (rlen > item->max_response_len)
+				return 2;
+			memcpy(item->response, resp.d.asBytes, rlen);
+			item->response_len = rlen;
+			item->ok = true;
 		}
+		done += in_chunk;
 	}
 
-	if (!leaveSignalON)
-		DropField();
-
 	return 0;
 }
 
@@ -939,19 +1242,23 @@ int CmdHF14AAPDU(const char *cmd) {
 				  "\thf 14a apdu -sm 00A40400 325041592E5359532E4444463031 -l 256 - encode standard APDU\n"
 				  "\thf 14a apdu -sm 00A40400 325041592E5359532E4444463031 -el 65536 - encode extended APDU\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("sS",  "select",   "activate field and select card"),
-		arg_lit0("kK",  "keep",     "leave the signal field ON after receive response"),
-		arg_lit0("tT",  "tlv",      "executes TLV decoder if it possible"),
-		arg_lit0("dD",  "decapdu",  "decode APDU request if it possible"),
-		arg_str0("mM",  "make",     "<head (CLA INS P1 P2) hex>", "make APDU with head from this field and data from data field. Must be 4 bytes length: <CLA INS P1 P2>"),
-		arg_lit0("eE",  "extended", "make extended length APDU (requires `-m`)"),
-		arg_int0("lL",  "le",       "<Le (int)>", "Le APDU parameter (requires `-m`)"),
-		arg_strx1(NULL, NULL,       "<APDU (hex) | data (hex)>", "APDU (without `-m`), or data (with `-m`)"),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, false);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("sS",  "select",   "activate field and select card"),
+			arg_lit0("kK",  "keep",     "leave the signal field ON after receive response"),
+			arg_lit0("tT",  "tlv",      "executes TLV decoder if it possible"),
+			arg_lit0("dD",  "decapdu",  "decode APDU request if it possible"),
+			arg_str0("mM",  "make",     "<head (CLA INS P1 P2) hex>", "make APDU with head from this field and data from data field. Must be 4 bytes length: <CLA INS P1 P2>"),
+			arg_lit0("eE",  "extended", "make extended length APDU (requires `-m`)"),
+			arg_int0("lL",  "le",       "<Le (int)>", "Le APDU parameter (requires `-m`)"),
+			arg_strx1(NULL, NULL,       "<APDU (hex) | data (hex)>", "APDU (without `-m`), or data (with `-m`)"),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, false);
 
 	activateField = arg_get_lit(1);
 	leaveSignalON = arg_get_lit(2);
@@ -1058,25 +1365,29 @@ int CmdHF14ACmdRaw(const char *cmd) {
 		"\thf 14a raw -pa -b7 -t1000 52  -- execute WUPA\n"\
 		"\thf 14a raw -p 9320            -- anticollision\n"\
 		"\thf 14a raw -psc 60 00         -- select and mifare AUTH\n");
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("rR",  "nreply",  "do not read response"),
-		arg_lit0("cC",  "crc",     "calculate and append CRC"),
-		arg_lit0("pP",  "power",   "leave the signal field ON after receive"),
-		arg_lit0("aA",  "active",  "active signal field ON without select"),
-		arg_lit0("sS",  "actives", "active signal field ON with select"),
-		arg_int0("bB",  "bits",    NULL, "number of bits to send. Useful for send partial byte"),
-		arg_int0("t",   "timeout", NULL, "timeout in ms"),
-		arg_lit0("T",   "topaz",   "use Topaz protocol to send command"),
-		arg_lit0("3",   NULL,      "ISO14443-3 select only (skip RATS)"),
-		arg_strx1(NULL, NULL,      "<data (hex)>", NULL),
-		arg_param_end
-	};
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("rR",  "nreply",  "do not read response"),
+			arg_lit0("cC",  "crc",     "calculate and append CRC"),
+			arg_lit0("pP",  "power",   "leave the signal field ON after receive"),
+			arg_lit0("aA",  "active",  "active signal field ON without select"),
+			arg_lit0("sS",  "actives", "active signal field ON with select"),
+			arg_int0("bB",  "bits",    NULL, "number of bits to send. Useful for send partial byte"),
+			arg_int0("t",   "timeout", NULL, "timeout in ms"),
+			arg_lit0("T",   "topaz",   "use Topaz protocol to send command"),
+			arg_lit0("3",   NULL,      "ISO14443-3 select only (skip RATS)"),
+			arg_strx1(NULL, NULL,      "<data (hex)>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
 	// defaults
 	arg_get_int(6) = 0;
 	arg_get_int(7) = 0;
 
-	if (CLIParserParseString(cmd, argtable, arg_getsize(argtable), false)){
+	if (CLIParserParseString(cmd, argtable, CLIParserArgtableLen(), false)){
 		CLIParserFree();
 		return 0;
 	}
@@ -1149,6 +1460,7 @@ int CmdHF14ACmdRaw(const char *cmd) {
 	c.arg[1] = (datalen & 0xFFFF) | ((uint32_t)numbits << 16);
 	memcpy(c.d.asBytes,data,datalen);
 
+	InvalidateCardSession();
 	SendCommand(&c);
 
 	if (reply) {
@@ -1164,14 +1476,15 @@ int CmdHF14ACmdRaw(const char *cmd) {
 
 static int waitCmd(uint8_t iSelect) {
 	uint8_t *recv;
-	UsbCommand resp;
 	char *hexout;
 
-	if (WaitForResponseTimeout(CMD_ACK,&resp,1500)) {
-		recv = resp.d.asBytes;
-		uint8_t iLen = resp.arg[0];
+	// read the payload straight out of the pooled response buffer
+	UsbCommand *resp = WaitForResponseInPlace(CMD_ACK, 1500);
+	if (resp != NULL) {
+		recv = resp->d.asBytes;
+		uint8_t iLen = resp->arg[0];
 		if (iSelect){
-			iLen = resp.arg[1];
+			iLen = resp->arg[1];
 			if (iLen){
 				PrintAndLog("Card selected. UID[%i]:", iLen);
 			} else {
@@ -1180,8 +1493,10 @@ static int waitCmd(uint8_t iSelect) {
 		} else {
 			PrintAndLog("received %i bytes:", iLen);
 		}
-		if(!iLen)
+		if(!iLen) {
+			ReleaseResponse(resp);
 			return 1;
+		}
 		hexout = (char *)malloc(iLen * 3 + 1);
 		if (hexout != NULL) {
 			for (int i = 0; i < iLen; i++) { // data in hex
@@ -1191,8 +1506,10 @@ static int waitCmd(uint8_t iSelect) {
 			free(hexout);
 		} else {
 			PrintAndLog("malloc failed your client has low memory?");
+			ReleaseResponse(resp);
 			return 2;
 		}
+		ReleaseResponse(resp);
 	} else {
 		PrintAndLog("timeout while waiting for reply.");
 		return 3;
@@ -1207,8 +1524,11 @@ static command_t CommandTable[] =
 	{"reader",   CmdHF14AReader,       0, "Start acting like an ISO14443 Type A reader"},
 	{"info",     CmdHF14AInfo,         0, "Reads card and shows information about it"},
 	{"cuids",    CmdHF14ACUIDs,        0, "<n> Collect n>0 ISO14443 Type A UIDs in one go"},
+	{"inventory",CmdHF14AInventory,   0, "Enumerate all ISO14443 Type A tags in the field"},
+	{"timing",   CmdHF14ATiming,      0, "Record response time distributions of the select sequence"},
 	{"sim",      CmdHF14ASim,          0, "<UID> -- Simulate ISO 14443a tag"},
 	{"snoop",    CmdHF14ASnoop,        0, "Eavesdrop ISO 14443 Type A"},
+	{"poll",     CmdHF14APoll,         0, "[period_ms] -- Poll for tag presence in the background"},
 	{"apdu",     CmdHF14AAPDU,         0, "Send an ISO 7816-4 APDU via ISO 14443-4 block transmission protocol"},
 	{"raw",      CmdHF14ACmdRaw,       0, "Send raw hex data to tag"},
 	{NULL,       NULL,                 0, NULL}
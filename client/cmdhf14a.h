@@ -22,8 +22,11 @@ extern int CmdHF14AList(const char *Cmd);
 extern int CmdHF14AMifare(const char *Cmd);
 extern int CmdHF14AReader(const char *Cmd);
 extern int CmdHF14AInfo(const char *Cmd);
+extern int CmdHF14AInventory(const char *Cmd);
+extern int CmdHF14ATiming(const char *Cmd);
 extern int CmdHF14ASim(const char *Cmd);
 extern int CmdHF14ASnoop(const char *Cmd);
+extern int CmdHF14APoll(const char *Cmd);
 
 extern void DropField();
 
@@ -31,4 +34,16 @@ extern int Hf14443_4aGetCardData(iso14a_card_select_t * card);
 extern int ExchangeRAW14a(uint8_t *datain, int datainlen, bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen);
 extern int ExchangeAPDU14a(uint8_t *datain, int datainlen, bool activateField, bool leaveSignalON, uint8_t *dataout, int maxdataoutlen, int *dataoutlen);
 
+// one entry of an APDU batch (see ExchangeAPDUBatch14a)
+typedef struct {
+	const uint8_t *apdu;
+	int apdu_len;
+	uint8_t *response;		// caller provided buffer
+	int max_response_len;
+	int response_len;		// filled in, includes SW1SW2
+	bool ok;
+} apdu_batch_t;
+
+extern int ExchangeAPDUBatch14a(apdu_batch_t *items, int count);
+
 #endif
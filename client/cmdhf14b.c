@@ -664,6 +664,55 @@ static int CmdHF14BReader(const char *Cmd) {
 }
 
 
+// enumerate all tags in the field in one go. The slot-marker anticollision
+// and the HLTB/ATTRIB negotiation run on the device, so a stack of tags
+// costs a single USB round trip
+static int CmdHF14BInventory(const char *Cmd) {
+	char cmdp = tolower(param_getchar(Cmd, 0));
+	if (cmdp == 'h') {
+		PrintAndLogEx(NORMAL, "Usage: hf 14b inventory [maximum number of tags] [s]");
+		PrintAndLogEx(NORMAL, "Enumerates all ISO14443B tags in the field and lists their PUPIs.");
+		PrintAndLogEx(NORMAL, "Options:");
+		PrintAndLogEx(NORMAL, "       h    this help");
+		PrintAndLogEx(NORMAL, "       s    stay connected - leave the first tag ATTRIB'ed and the field on");
+		return 0;
+	}
+
+	// requested maximum number of tags. 0 = as many as fit in one response
+	uint32_t n = param_get32ex(Cmd, 0, 0, 10);
+	bool stay = tolower(param_getchar(Cmd, 1)) == 's';
+
+	UsbCommand c = {CMD_READER_ISO_14443B_INVENTORY, {n, stay, 0}};
+	clearCommandBuffer();
+	SendCommand(&c);
+
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 5000)) {
+		PrintAndLog("Command execute timeout");
+		return 1;
+	}
+
+	uint16_t count = resp.arg[0] & 0xffff;
+	if (count == 0) {
+		PrintAndLog("No tags found.");
+		return 0;
+	}
+
+	// entries of [4 byte PUPI][4 byte App Data][3 byte Prot Info][1 pad]
+	for (uint16_t i = 0; i < count; i++) {
+		uint8_t *entry = resp.d.asBytes + i * 12;
+		PrintAndLog("%2d: PUPI : %s  App Data : %s  Prot Info : %s",
+			i + 1, sprint_hex(entry, 4), sprint_hex(entry + 4, 4), sprint_hex(entry + 8, 3));
+	}
+	PrintAndLog("Found %d tag%s.", count, count == 1 ? "" : "s");
+	if (stay) {
+		PrintAndLog(resp.arg[1] ? "Tag 1 left selected, field on." : "Could not re-select tag 1, field off.");
+	}
+
+	return 0;
+}
+
+
 int CmdSriWrite(const char *Cmd) {
 /*
  * For SRIX4K  blocks 00 - 7F
@@ -740,6 +789,7 @@ static command_t CommandTable[] =
   {"info",        CmdHF14Binfo,   0, "Find and print details about a 14443B tag"},
   {"list",        CmdHF14BList,   0, "[Deprecated] List ISO 14443B history"},
   {"reader",      CmdHF14BReader, 0, "Act as a 14443B reader to identify a tag"},
+  {"inventory",   CmdHF14BInventory, 0, "Enumerate all 14443B tags in the field on-device"},
   {"sim",         CmdHF14BSim,    0, "Fake ISO 14443B tag"},
   {"snoop",       CmdHF14BSnoop,  0, "Eavesdrop ISO 14443B"},
   {"sri512read",  CmdSri512Read,  0, "Read contents of a SRI512 tag"},
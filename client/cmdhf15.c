@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <ctype.h>
 
 #include "comms.h"
@@ -35,6 +36,7 @@
 #include "ui.h"
 #include "util.h"
 #include "cmdparser.h"
+#include "crc32.h"
 #include "iso15693tools.h"
 #include "protocols.h"
 #include "cmdmain.h"
@@ -238,8 +240,64 @@ int CmdHF15Read(const char *Cmd)
 // Record Activity without enabling carrier
 int CmdHF15Snoop(const char *Cmd)
 {
-	UsbCommand c = {CMD_SNOOP_ISO_15693};
+	uint8_t param = 0;
+
+	char ctmp = param_getchar(Cmd, 0);
+	if (ctmp == 'h' || ctmp == 'H') {
+		PrintAndLog("Usage:  hf 15 snoop [s <filename>]");
+		PrintAndLog("    s <filename> : stream the decoded frames to <filename> while");
+		PrintAndLog("    sniffing, so long sessions aren't truncated when the trace");
+		PrintAndLog("    buffer fills. Stop with the button, then view with:");
+		PrintAndLog("    hf list 15 l <filename>");
+		PrintAndLog("sample: hf 15 snoop");
+		PrintAndLog("sample: hf 15 snoop s mytrace.trc");
+		return 0;
+	}
+
+	char filename[FILE_PATH_SIZE] = {0};
+	if (ctmp == 's' || ctmp == 'S') {
+		param |= 0x01;
+		param_getstr(Cmd, 1, filename, sizeof(filename));
+		if (strlen(filename) == 0) {
+			PrintAndLog("streaming mode needs a filename");
+			return 1;
+		}
+	}
+
+	UsbCommand c = {CMD_SNOOP_ISO_15693, {param, 0, 0}};
 	SendCommand(&c);
+
+	if (param & 0x01) {
+		FILE *tracefile = fopen(filename, "wb");
+		if (tracefile == NULL) {
+			PrintAndLog("Could not create file %s", filename);
+			return 1;
+		}
+		PrintAndLog("Streaming trace to %s, press the button on the device to stop", filename);
+		UsbCommand resp;
+		for (;;) {
+			if (!WaitForResponseTimeoutW(CMD_UNKNOWN, &resp, 5000, false)) {
+				if (ukbhit()) {
+					getchar();
+					PrintAndLog("aborted via keyboard - device keeps sniffing until the button is pressed");
+					break;
+				}
+				continue;
+			}
+			if (resp.cmd == CMD_DOWNLOADED_TRACE) {
+				uint32_t len = resp.arg[1];
+				if (len > USB_CMD_DATA_SIZE) len = USB_CMD_DATA_SIZE;
+				fwrite(resp.d.asBytes, 1, len, tracefile);
+				continue;
+			}
+			if (resp.cmd == CMD_ACK) {
+				PrintAndLog("Done. %" PRIu64 " trace bytes streamed, %" PRIu64 " entries dropped", (uint64_t)resp.arg[0], (uint64_t)resp.arg[1]);
+				break;
+			}
+		}
+		fclose(tracefile);
+		PrintAndLog("View with: hf list 15 l %s", filename);
+	}
 	return 0;
 }
 
@@ -265,6 +323,37 @@ int CmdHF15Reader(const char *Cmd)
 	return 0;
 }
 
+// Enumerate a multi-tag field: the device runs full 16-slot anticollision
+// rounds with on-device mask descent and returns every UID it resolved.
+int CmdHF15Inventory(const char *Cmd)
+{
+	char cmdp = param_getchar(Cmd, 0);
+	if (cmdp == 'h' || cmdp == 'H') {
+		PrintAndLog("Usage:  hf 15 inventory");
+		PrintAndLog("Enumerate all ISO15693 tags in the field at once using 16-slot");
+		PrintAndLog("anticollision rounds, resolved on the device.");
+		return 0;
+	}
+
+	UsbCommand resp;
+	UsbCommand c = {CMD_ISO_15693_INVENTORY, {0, 0, 0}};
+	clearCommandBuffer();
+	SendCommand(&c);
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 20000)) {
+		PrintAndLog("timeout while waiting for reply.");
+		return 1;
+	}
+
+	uint16_t nuids = resp.arg[0];
+	for (uint16_t i = 0; i < nuids; i++) {
+		uint8_t *uid = resp.d.asBytes + i*8;
+		PrintAndLog("UID %2u: %s, %s", i + 1, sprintUID(NULL, uid), getManufacturerName(uid[6]));
+	}
+	PrintAndLog("%u tag%s found (%u rounds, %u collisions resolved)",
+		nuids, nuids == 1 ? "" : "s", (unsigned int)resp.arg[2], (unsigned int)resp.arg[1]);
+	return 0;
+}
+
 // Simulation is still not working very good
 int CmdHF15Sim(const char *Cmd)
 {
@@ -598,6 +687,29 @@ int CmdHF15Dump(const char *Cmd) {
 	return 0;
 }
 
+// returns true when device emulator memory already holds these bytes
+// (per-block CRC32 compare via CMD_EML_GET_HASHES), so eload can skip
+// re-uploading an unchanged chunk
+static bool emlChunkUnchanged(uint32_t offset, uint8_t *data, uint32_t len)
+{
+	if (len == 0 || len % 16)
+		return false;
+	UsbCommand c = {CMD_EML_GET_HASHES, {offset, len / 16, 0}};
+	UsbCommand resp;
+	SendCommand(&c);
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500))
+		return false;
+	if (resp.arg[0] != len / 16)
+		return false;
+	for (uint32_t i = 0; i < len / 16; i++) {
+		uint8_t crc[4];
+		crc32(data + i * 16, 16, crc);
+		if (memcmp(crc, resp.d.asBytes + i * 4, 4) != 0)
+			return false;
+	}
+	return true;
+}
+
 int CmdHF15ELoad(const char *Cmd)
 {
 	FILE * f;
@@ -642,8 +754,12 @@ int CmdHF15ELoad(const char *Cmd)
 		c.arg[0] = i;
 		if (c.arg[0] + c.arg[1] > CARD_MEMORY_SIZE) // less than USB_CMD_DATA_SIZE space left
 			c.arg[1] = CARD_MEMORY_SIZE-c.arg[0];
-		SendCommand(&c);
-		printf(".");
+		if (emlChunkUnchanged(c.arg[0], c.d.asBytes, c.arg[1])) {
+			printf(","); // already in sync
+		} else {
+			SendCommand(&c);
+			printf(".");
+		}
 		fflush(stdout);
 	}
 	fclose(f);
@@ -758,6 +874,7 @@ static command_t CommandTable15[] =
 	{"read",    CmdHF15Read,    0, "Read HF tag (ISO 15693)"},
 	{"snoop",   CmdHF15Snoop,   0, "Eavesdrop ISO 15693 communications"},
 	{"reader",  CmdHF15Reader,  0, "Act like an ISO15693 reader"},
+	{"inventory", CmdHF15Inventory, 0, "Enumerate all ISO15693 tags in the field (16-slot anticollision)"},
 	{"sim",     CmdHF15Sim,     0, "Fake an ISO15693 tag"},
 	{"cmd",     CmdHF15Cmd,     0, "Send direct commands to ISO15693 tag"},
 	{"findafi", CmdHF15Afi,     0, "Brute force AFI of an ISO15693 tag"},
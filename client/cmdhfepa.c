@@ -43,31 +43,49 @@ int CmdHFEPACollectPACENonces(const char *Cmd)
 
 	PrintAndLog("Collecting %u %u-byte nonces", n, m);
 	PrintAndLog("Start: %" PRIu64 , msclock()/1000);
-	// repeat n times
-	for (unsigned int i = 0; i < n; i++) {
-		// execute PACE
-		UsbCommand c = {CMD_EPA_PACE_COLLECT_NONCE, {(int)m, 0, 0}};
-		SendCommand(&c);
+
+	// the reset-collect cycles all run on the device; records stream back
+	// in bulk while the collection is still going
+	UsbCommand c = {CMD_EPA_PACE_COLLECT_NONCE_BATCH, {(int)m, (int)n, (int)d}};
+	clearCommandBuffer();
+	SendCommand(&c);
+
+	unsigned int i = 0;
+	size_t record_size = m + 1;
+	while (true) {
 		UsbCommand resp;
+		// the device flushes at least every two seconds while collecting,
+		// plus the requested pause between cycles
+		if (!WaitForResponseTimeout(CMD_ACK, &resp, 15000 + d * 1000)) {
+			PrintAndLog("Device timeout while collecting nonces.");
+			return 1;
+		}
 
-		WaitForResponse(CMD_ACK,&resp);
+		// final packet carries the totals
+		if (resp.arg[2]) {
+			PrintAndLog("Collected %d nonce%s, %d failed cycle%s",
+				(int)resp.arg[0], resp.arg[0] == 1 ? "" : "s",
+				(int)resp.arg[1], resp.arg[1] == 1 ? "" : "s");
+			break;
+		}
 
-		// check if command failed
-		if (resp.arg[0] != 0) {
-			PrintAndLog("Error in step %d, Return code: %d",resp.arg[0],(int)resp.arg[1]);
-		} else {
-			size_t nonce_length = resp.arg[1];
+		// unpack the fixed size [1 byte length][m byte nonce] records
+		for (size_t j = 0; j < resp.arg[0]; j++) {
+			uint8_t *record = resp.d.asBytes + j * record_size;
+			i++;
+			if (record[0] == 0) {
+				PrintAndLog("Cycle %u failed", i);
+				continue;
+			}
+			size_t nonce_length = record[0];
 			char *nonce = (char *) malloc(2 * nonce_length + 1);
-			for(int j = 0; j < nonce_length; j++) {
-				sprintf(nonce + (2 * j), "%02X", resp.d.asBytes[j]);
+			for(size_t k = 0; k < nonce_length; k++) {
+				sprintf(nonce + (2 * k), "%02X", record[1 + k]);
 			}
 			// print nonce
-			PrintAndLog("Length: %d, Nonce: %s", nonce_length, nonce);
+			PrintAndLog("Length: %d, Nonce: %s", (int)nonce_length, nonce);
 			free(nonce);
 		}
-		if (i < n - 1) {
-			sleep(d);
-		}
 	}
 	PrintAndLog("End: %" PRIu64, msclock()/1000);
 
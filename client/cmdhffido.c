@@ -183,18 +183,22 @@ int CmdHFFidoRegister(const char *cmd) {
 			"\thf fido reg 000102030405060708090a0b0c0d0e0f000102030405060708090a0b0c0d0e0f 000102030405060708090a0b0c0d0e0f000102030405060708090a0b0c0d0e0f -> execute command with parameters"
 			"\thf fido reg -p s0 s1 -> execute command with plain parameters");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("aA",  "apdu",     "show APDU reqests and responses"),
-		arg_litn("vV",  "verbose",  0, 2, "show technical data. vv - show full certificates data"),
-		arg_lit0("pP",  "plain",    "send plain ASCII to challenge and application parameters instead of HEX"),
-		arg_lit0("tT",  "tlv",      "Show DER certificate contents in TLV representation"),
-		arg_str0("jJ",  "json",		"fido.json", "JSON input / output file name for parameters."),
-		arg_str0(NULL,  NULL,       "<HEX/ASCII challenge parameter (32b HEX/1..16 chars)>", NULL),
-		arg_str0(NULL,  NULL,       "<HEX/ASCII application parameter (32b HEX/1..16 chars)>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("aA",  "apdu",     "show APDU reqests and responses"),
+			arg_litn("vV",  "verbose",  0, 2, "show technical data. vv - show full certificates data"),
+			arg_lit0("pP",  "plain",    "send plain ASCII to challenge and application parameters instead of HEX"),
+			arg_lit0("tT",  "tlv",      "Show DER certificate contents in TLV representation"),
+			arg_str0("jJ",  "json",		"fido.json", "JSON input / output file name for parameters."),
+			arg_str0(NULL,  NULL,       "<HEX/ASCII challenge parameter (32b HEX/1..16 chars)>", NULL),
+			arg_str0(NULL,  NULL,       "<HEX/ASCII application parameter (32b HEX/1..16 chars)>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 	
 	bool APDULogging = arg_get_lit(1);
 	bool verbose = arg_get_lit(2);
@@ -413,22 +417,26 @@ int CmdHFFidoAuthenticate(const char *cmd) {
 			"\thf fido auth 000102030405060708090a0b0c0d0e0f000102030405060708090a0b0c0d0e0f000102030405060708090a0b0c0d0e0f000102030405060708090a0b0c0d0e0f "
 				"000102030405060708090a0b0c0d0e0f000102030405060708090a0b0c0d0e0f 000102030405060708090a0b0c0d0e0f000102030405060708090a0b0c0d0e0f -> execute command with parameters");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("aA",  "apdu",     "show APDU reqests and responses"),
-		arg_lit0("vV",  "verbose",  "show technical data"),
-		arg_lit0("pP",  "plain",    "send plain ASCII to challenge and application parameters instead of HEX"),
-		arg_rem("default mode:",    "dont-enforce-user-presence-and-sign"),
-		arg_lit0("uU",  "user",     "mode: enforce-user-presence-and-sign"),
-		arg_lit0("cC",  "check",    "mode: check-only"),
-		arg_str0("jJ",  "json",		"fido.json", "JSON input / output file name for parameters."),
-		arg_str0("kK",  "key",		"public key to verify signature", NULL),
-		arg_str0(NULL,  NULL,       "<HEX key handle (var 0..255b)>", NULL),
-		arg_str0(NULL,  NULL,       "<HEX/ASCII challenge parameter (32b HEX/1..16 chars)>", NULL),
-		arg_str0(NULL,  NULL,       "<HEX/ASCII application parameter (32b HEX/1..16 chars)>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("aA",  "apdu",     "show APDU reqests and responses"),
+			arg_lit0("vV",  "verbose",  "show technical data"),
+			arg_lit0("pP",  "plain",    "send plain ASCII to challenge and application parameters instead of HEX"),
+			arg_rem("default mode:",    "dont-enforce-user-presence-and-sign"),
+			arg_lit0("uU",  "user",     "mode: enforce-user-presence-and-sign"),
+			arg_lit0("cC",  "check",    "mode: check-only"),
+			arg_str0("jJ",  "json",		"fido.json", "JSON input / output file name for parameters."),
+			arg_str0("kK",  "key",		"public key to verify signature", NULL),
+			arg_str0(NULL,  NULL,       "<HEX key handle (var 0..255b)>", NULL),
+			arg_str0(NULL,  NULL,       "<HEX/ASCII challenge parameter (32b HEX/1..16 chars)>", NULL),
+			arg_str0(NULL,  NULL,       "<HEX/ASCII application parameter (32b HEX/1..16 chars)>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 	
 	bool APDULogging = arg_get_lit(1);
 	bool verbose = arg_get_lit(2);
@@ -659,16 +667,20 @@ int CmdHFFido2MakeCredential(const char *cmd) {
 		"Usage:\n\thf fido make -> execute command default parameters file `fido2.json`\n"
 			"\thf fido make test.json -> execute command with parameters file `text.json`");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("aA",  "apdu",     "show APDU reqests and responses"),
-		arg_litn("vV",  "verbose",  0, 2, "show technical data. vv - show full certificates data"),
-		arg_lit0("tT",  "tlv",      "Show DER certificate contents in TLV representation"),
-		arg_lit0("cC",  "cbor",     "show CBOR decoded data"),
-		arg_str0(NULL,  NULL,		"<json file name>", "JSON input / output file name for parameters. Default `fido2.json`"),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("aA",  "apdu",     "show APDU reqests and responses"),
+			arg_litn("vV",  "verbose",  0, 2, "show technical data. vv - show full certificates data"),
+			arg_lit0("tT",  "tlv",      "Show DER certificate contents in TLV representation"),
+			arg_lit0("cC",  "cbor",     "show CBOR decoded data"),
+			arg_str0(NULL,  NULL,		"<json file name>", "JSON input / output file name for parameters. Default `fido2.json`"),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 	
 	bool APDULogging = arg_get_lit(1);
 	bool verbose = arg_get_lit(2);
@@ -786,16 +798,20 @@ int CmdHFFido2GetAssertion(const char *cmd) {
 		"Usage:\n\thf fido assert -> execute command default parameters file `fido2.json`\n"
 			"\thf fido assert test.json -l -> execute command with parameters file `text.json` and add to request CredentialId");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("aA",  "apdu",     "show APDU reqests and responses"),
-		arg_litn("vV",  "verbose",  0, 2, "show technical data. vv - show full certificates data"),
-		arg_lit0("cC",  "cbor",     "show CBOR decoded data"),
-		arg_lit0("lL",  "list",     "add CredentialId from json to allowList. Needs if `rk` option is `false` (authenticator don't store credential to its memory)"),
-		arg_str0(NULL,  NULL,		"<json file name>", "JSON input / output file name for parameters. Default `fido2.json`"),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("aA",  "apdu",     "show APDU reqests and responses"),
+			arg_litn("vV",  "verbose",  0, 2, "show technical data. vv - show full certificates data"),
+			arg_lit0("cC",  "cbor",     "show CBOR decoded data"),
+			arg_lit0("lL",  "list",     "add CredentialId from json to allowList. Needs if `rk` option is `false` (authenticator don't store credential to its memory)"),
+			arg_str0(NULL,  NULL,		"<json file name>", "JSON input / output file name for parameters. Default `fido2.json`"),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 	
 	bool APDULogging = arg_get_lit(1);
 	bool verbose = arg_get_lit(2);
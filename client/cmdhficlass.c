@@ -16,6 +16,8 @@
 #include <sys/stat.h>
 #include <ctype.h>
 #include "iso14443crc.h" // Can also be used for iClass, using 0xE012 as CRC-type
+#include "crc32.h"
+#include "crc64.h"
 #include "comms.h"
 #include "ui.h"
 #include "cmdparser.h"
@@ -285,6 +287,16 @@ static int CmdHFiClassReader_Replay(const char *Cmd) {
 }
 
 
+// whole-dump CRC64 (ECMA preset), printed on dump save and load so bulk
+// re-validation of a dump archive can compare fingerprints instead of
+// re-reading every block
+static void printIclassDumpCrc(uint8_t *dump, size_t len) {
+	uint64_t crc = 0;
+	crc64(dump, len, &crc);
+	PrintAndLog("Dump CRC64: %08x%08x", (uint32_t)(crc >> 32), (uint32_t)crc);
+}
+
+
 static void usage_hf_iclass_eload(void) {
 	PrintAndLog("Loads iclass tag-dump into emulator memory on device");
 	PrintAndLog("Usage:  hf iclass eload f <filename>");
@@ -293,6 +305,29 @@ static void usage_hf_iclass_eload(void) {
 }
 
 
+// returns true when device emulator memory already holds these bytes
+// (per-block CRC32 compare via CMD_EML_GET_HASHES), so eload can skip
+// re-uploading an unchanged chunk
+static bool emlChunkUnchanged(uint32_t offset, uint8_t *data, uint32_t len)
+{
+	if (len == 0 || len % 16)
+		return false;
+	UsbCommand c = {CMD_EML_GET_HASHES, {offset, len / 16, 0}};
+	UsbCommand resp;
+	SendCommand(&c);
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500))
+		return false;
+	if (resp.arg[0] != len / 16)
+		return false;
+	for (uint32_t i = 0; i < len / 16; i++) {
+		uint8_t crc[4];
+		crc32(data + i * 16, 16, crc);
+		if (memcmp(crc, resp.d.asBytes + i * 4, 4) != 0)
+			return false;
+	}
+	return true;
+}
+
 static int CmdHFiClassELoad(const char *Cmd) {
 
 	char opt = param_getchar(Cmd, 0);
@@ -339,20 +374,27 @@ static int CmdHFiClassELoad(const char *Cmd) {
 		free(dump);
 		return 1;
 	}
-	//Send to device
+	printIclassDumpCrc(dump, bytes_read);
+	//Send to device - skip chunks the emulator already holds
 	uint32_t bytes_sent = 0;
 	uint32_t bytes_remaining  = bytes_read;
+	uint32_t bytes_skipped = 0;
 
 	while (bytes_remaining > 0) {
 		uint32_t bytes_in_packet = MIN(USB_CMD_DATA_SIZE, bytes_remaining);
-		UsbCommand c = {CMD_ICLASS_EML_MEMSET, {bytes_sent,bytes_in_packet,0}};
-		memcpy(c.d.asBytes, dump+bytes_sent, bytes_in_packet);
-		SendCommand(&c);
+		if (emlChunkUnchanged(bytes_sent, dump+bytes_sent, bytes_in_packet)) {
+			bytes_skipped += bytes_in_packet;
+		} else {
+			UsbCommand c = {CMD_ICLASS_EML_MEMSET, {bytes_sent,bytes_in_packet,0}};
+			memcpy(c.d.asBytes, dump+bytes_sent, bytes_in_packet);
+			SendCommand(&c);
+		}
 		bytes_remaining -= bytes_in_packet;
 		bytes_sent += bytes_in_packet;
 	}
 	free(dump);
-	PrintAndLog("Sent %d bytes of data to device emulator memory", bytes_sent);
+	PrintAndLog("Sent %d bytes of data to device emulator memory (%d already in sync)",
+			bytes_sent - bytes_skipped, bytes_skipped);
 	return 0;
 }
 
@@ -903,6 +945,7 @@ static int CmdHFiClassReader_Dump(const char *Cmd) {
 
 	// save the dump to .bin file
 	PrintAndLog("Saving dump file - %d blocks read", gotBytes/8);
+	printIclassDumpCrc(tag_data, gotBytes);
 	saveFile(filename, "bin", tag_data, gotBytes);
 	return 1;
 }
@@ -1447,6 +1490,7 @@ static int CmdHFiClassReadTagFile(const char *Cmd) {
 	printf("CSN   |00| %s|\n", sprint_hex(csn, 8) );
 	//    printIclassDumpInfo(dump);
 	printIclassDumpContents(dump,startblock,endblock,bytes_read);
+	printIclassDumpCrc(dump, bytes_read);
 	free(dump);
 	return 0;
 }
@@ -28,6 +28,7 @@
 #include "mifare/mifaredefault.h"
 #include "usb_cmd.h"
 #include "pcsc.h"
+#include "tracefile.h"
 
 typedef struct {
 	uint32_t uid;       // UID
@@ -213,32 +214,59 @@ uint8_t iclass_CRC_check(bool isResponse, uint8_t* data, uint8_t len)
 }
 
 
-void annotateIclass(char *exp, size_t size, uint8_t* cmd, uint8_t cmdsize) {
-	switch(cmd[0])
-	{
-	case ICLASS_CMD_ACTALL:      snprintf(exp, size, "ACTALL"); break;
-	case ICLASS_CMD_READ_OR_IDENTIFY: {
-		if (cmdsize > 1){
-			snprintf(exp,size,"READ(%d)",cmd[1]);
-		} else {
-			snprintf(exp,size,"IDENTIFY");
-		}
-		break;
+// First-byte indexed annotation tables. Each entry either carries a fixed
+// annotation (optionally formatted with the second command byte), or a
+// secondary matcher for commands that need more context - further command
+// bytes, the frame size or the mifare auth state. Unset entries annotate
+// as "?", like the default cases of the old if/else chains did.
+typedef void annotate_fn_t(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize);
+typedef struct {
+	const char *text;		// contains one %d consuming cmd[1] if with_arg is set
+	bool with_arg;
+	annotate_fn_t *matcher;	// takes precedence over text
+} annotate_entry_t;
+
+static void annotateFromTable(const annotate_entry_t *table, char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	const annotate_entry_t *e = &table[cmd[0]];
+	if (e->matcher != NULL) {
+		e->matcher(exp, size, cmd, cmdsize);
+	} else if (e->text != NULL && e->with_arg) {
+		snprintf(exp, size, e->text, cmd[1]);
+	} else if (e->text != NULL) {
+		snprintf(exp, size, "%s", e->text);
+	} else {
+		snprintf(exp, size, "?");
 	}
-	case ICLASS_CMD_SELECT:       snprintf(exp,size, "SELECT"); break;
-	case ICLASS_CMD_PAGESEL:      snprintf(exp,size, "PAGESEL(%d)", cmd[1]); break;
-	case ICLASS_CMD_READCHECK_KC: snprintf(exp,size, "READCHECK[Kc](%d)", cmd[1]); break;
-	case ICLASS_CMD_READCHECK_KD: snprintf(exp,size, "READCHECK[Kd](%d)", cmd[1]); break;
-	case ICLASS_CMD_CHECK_KC:
-	case ICLASS_CMD_CHECK_KD:     snprintf(exp,size, "CHECK"); break;
-	case ICLASS_CMD_DETECT:       snprintf(exp,size, "DETECT"); break;
-	case ICLASS_CMD_HALT:         snprintf(exp,size, "HALT"); break;
-	case ICLASS_CMD_UPDATE:       snprintf(exp,size, "UPDATE(%d)",cmd[1]); break;
-	case ICLASS_CMD_ACT:          snprintf(exp,size, "ACT"); break;
-	case ICLASS_CMD_READ4:        snprintf(exp,size, "READ4(%d)",cmd[1]); break;
-	default:                      snprintf(exp,size, "?"); break;
+}
+
+static void annotateIclassReadOrIdentify(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	if (cmdsize > 1) {
+		snprintf(exp,size,"READ(%d)",cmd[1]);
+	} else {
+		snprintf(exp,size,"IDENTIFY");
 	}
-	return;
+}
+
+static const annotate_entry_t annotate_table_iclass[256] = {
+	[ICLASS_CMD_ACTALL]           = { .text = "ACTALL" },
+	[ICLASS_CMD_READ_OR_IDENTIFY] = { .matcher = annotateIclassReadOrIdentify },
+	[ICLASS_CMD_SELECT]           = { .text = "SELECT" },
+	[ICLASS_CMD_PAGESEL]          = { .text = "PAGESEL(%d)", .with_arg = true },
+	[ICLASS_CMD_READCHECK_KC]     = { .text = "READCHECK[Kc](%d)", .with_arg = true },
+	[ICLASS_CMD_READCHECK_KD]     = { .text = "READCHECK[Kd](%d)", .with_arg = true },
+	[ICLASS_CMD_CHECK_KC]         = { .text = "CHECK" },
+	[ICLASS_CMD_CHECK_KD]         = { .text = "CHECK" },
+	[ICLASS_CMD_DETECT]           = { .text = "DETECT" },
+	[ICLASS_CMD_HALT]             = { .text = "HALT" },
+	[ICLASS_CMD_UPDATE]           = { .text = "UPDATE(%d)", .with_arg = true },
+	[ICLASS_CMD_ACT]              = { .text = "ACT" },
+	[ICLASS_CMD_READ4]            = { .text = "READ4(%d)", .with_arg = true },
+};
+
+void annotateIclass(char *exp, size_t size, uint8_t* cmd, uint8_t cmdsize) {
+	annotateFromTable(annotate_table_iclass, exp, size, cmd, cmdsize);
 }
 
 
@@ -383,107 +411,124 @@ void annotateIso14443b(char *exp, size_t size, uint8_t* cmd, uint8_t cmdsize)
 
 }
 
-void annotateIso14443a(char *exp, size_t size, uint8_t* cmd, uint8_t cmdsize)
+static void annotate14aAnticollOrSelect(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
 {
-	switch(cmd[0])
-	{
-	case ISO14443A_CMD_WUPA:
-		snprintf(exp,size,"WUPA");
-		break;
-	case ISO14443A_CMD_ANTICOLL_OR_SELECT:{
-		// 93 20 = Anticollision (usage: 9320 - answer: 4bytes UID+1byte UID-bytes-xor)
-		// 93 70 = Select (usage: 9370+5bytes 9320 answer - answer: 1byte SAK)
-		if(cmd[1] == 0x70)
-		{
-			snprintf(exp,size,"SELECT_UID"); break;
-		}else
-		{
-			snprintf(exp,size,"ANTICOLL"); break;
-		}
+	// 93 20 = Anticollision (usage: 9320 - answer: 4bytes UID+1byte UID-bytes-xor)
+	// 93 70 = Select (usage: 9370+5bytes 9320 answer - answer: 1byte SAK)
+	if (cmd[1] == 0x70) {
+		snprintf(exp,size,"SELECT_UID");
+	} else {
+		snprintf(exp,size,"ANTICOLL");
 	}
-	case ISO14443A_CMD_ANTICOLL_OR_SELECT_2:{
-		//95 20 = Anticollision of cascade level2
-		//95 70 = Select of cascade level2
-		if(cmd[2] == 0x70)
-		{
-			snprintf(exp,size,"SELECT_UID-2"); break;
-		}else
-		{
-			snprintf(exp,size,"ANTICOLL-2"); break;
-		}
+}
+
+static void annotate14aAnticollOrSelect2(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	//95 20 = Anticollision of cascade level2
+	//95 70 = Select of cascade level2
+	if (cmd[2] == 0x70) {
+		snprintf(exp,size,"SELECT_UID-2");
+	} else {
+		snprintf(exp,size,"ANTICOLL-2");
 	}
-	case ISO14443A_CMD_REQA:
-		snprintf(exp,size,"REQA");
-		break;
-	case MIFARE_CMD_READBLOCK:   snprintf(exp,size,"READBLOCK(%d)",cmd[1]); break;
-	case MIFARE_CMD_WRITEBLOCK:  snprintf(exp,size,"WRITEBLOCK(%d)",cmd[1]); break;
-	case ISO14443A_CMD_HALT:
-		snprintf(exp,size,"HALT");
-		MifareAuthState = masNone;
-		break;
-	case ISO14443A_CMD_RATS:        snprintf(exp,size,"RATS"); break;
-	case MIFARE_CMD_INC:            snprintf(exp,size,"INC(%d)",cmd[1]); break;
-	case MIFARE_CMD_DEC:            snprintf(exp,size,"DEC(%d)",cmd[1]); break;
-	case MIFARE_CMD_RESTORE:        snprintf(exp,size,"RESTORE(%d)",cmd[1]); break;
-	case MIFARE_CMD_TRANSFER:       snprintf(exp,size,"TRANSFER(%d)",cmd[1]); break;
-	case MIFARE_AUTH_KEYA:
-		if ( cmdsize > 3) {
-			snprintf(exp,size,"AUTH-A(%d)",cmd[1]);
-			MifareAuthState = masNt;
-		} else {
-			//  case MIFARE_ULEV1_VERSION :  both 0x60.
-			snprintf(exp,size,"EV1 VERSION");
-		}
-		break;
-	case MIFARE_AUTH_KEYB:
+}
+
+static void annotate14aHalt(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	snprintf(exp,size,"HALT");
+	MifareAuthState = masNone;
+}
+
+static void annotate14aAuthKeyA(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	if ( cmdsize > 3) {
+		snprintf(exp,size,"AUTH-A(%d)",cmd[1]);
 		MifareAuthState = masNt;
-		snprintf(exp,size,"AUTH-B(%d)",cmd[1]);
-		break;
-	case MIFARE_MAGICWUPC1:         snprintf(exp,size,"MAGIC WUPC1"); break;
-	case MIFARE_MAGICWUPC2:         snprintf(exp,size,"MAGIC WUPC2"); break;
-	case MIFARE_MAGICWIPEC:         snprintf(exp,size,"MAGIC WIPEC"); break;
-	case MIFARE_ULC_AUTH_1:     snprintf(exp,size,"AUTH "); break;
-	case MIFARE_ULC_AUTH_2:     snprintf(exp,size,"AUTH_ANSW"); break;
-	case MIFARE_ULEV1_AUTH:
-		if ( cmdsize == 7 )
-			snprintf(exp,size,"PWD-AUTH KEY: 0x%02x%02x%02x%02x", cmd[1], cmd[2], cmd[3], cmd[4] );
-		else
-			snprintf(exp,size,"PWD-AUTH");
-		break;
-	case MIFARE_ULEV1_FASTREAD:{
-		if ( cmdsize >=3 && cmd[2] <= 0xE6)
-			snprintf(exp,size,"READ RANGE (%d-%d)",cmd[1],cmd[2]);
-		else
-			snprintf(exp,size,"?");
-		break;
-	}
-	case MIFARE_ULC_WRITE:{
-		if ( cmd[1] < 0x21 )
-			snprintf(exp,size,"WRITEBLOCK(%d)",cmd[1]);
-		else
-			snprintf(exp,size,"?");
-		break;
-	}
-	case MIFARE_ULEV1_READ_CNT:{
-		if ( cmd[1] < 5 )
-			snprintf(exp,size,"READ CNT(%d)",cmd[1]);
-		else
-			snprintf(exp,size,"?");
-		break;
-	}
-	case MIFARE_ULEV1_INCR_CNT:{
-		if ( cmd[1] < 5 )
-			snprintf(exp,size,"INCR(%d)",cmd[1]);
-		else
-			snprintf(exp,size,"?");
-		break;
-	}
-	case MIFARE_ULEV1_READSIG:      snprintf(exp,size,"READ_SIG"); break;
-	case MIFARE_ULEV1_CHECKTEAR:    snprintf(exp,size,"CHK_TEARING(%d)",cmd[1]); break;
-	case MIFARE_ULEV1_VCSL:     snprintf(exp,size,"VCSL"); break;
-	default:                        snprintf(exp,size,"?"); break;
+	} else {
+		//  case MIFARE_ULEV1_VERSION :  both 0x60.
+		snprintf(exp,size,"EV1 VERSION");
 	}
-	return;
+}
+
+static void annotate14aAuthKeyB(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	MifareAuthState = masNt;
+	snprintf(exp,size,"AUTH-B(%d)",cmd[1]);
+}
+
+static void annotate14aUlev1Auth(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	if ( cmdsize == 7 )
+		snprintf(exp,size,"PWD-AUTH KEY: 0x%02x%02x%02x%02x", cmd[1], cmd[2], cmd[3], cmd[4] );
+	else
+		snprintf(exp,size,"PWD-AUTH");
+}
+
+static void annotate14aUlev1Fastread(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	if ( cmdsize >=3 && cmd[2] <= 0xE6)
+		snprintf(exp,size,"READ RANGE (%d-%d)",cmd[1],cmd[2]);
+	else
+		snprintf(exp,size,"?");
+}
+
+static void annotate14aUlcWrite(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	if ( cmd[1] < 0x21 )
+		snprintf(exp,size,"WRITEBLOCK(%d)",cmd[1]);
+	else
+		snprintf(exp,size,"?");
+}
+
+static void annotate14aUlev1ReadCnt(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	if ( cmd[1] < 5 )
+		snprintf(exp,size,"READ CNT(%d)",cmd[1]);
+	else
+		snprintf(exp,size,"?");
+}
+
+static void annotate14aUlev1IncrCnt(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize)
+{
+	if ( cmd[1] < 5 )
+		snprintf(exp,size,"INCR(%d)",cmd[1]);
+	else
+		snprintf(exp,size,"?");
+}
+
+static const annotate_entry_t annotate_table_iso14443a[256] = {
+	[ISO14443A_CMD_WUPA]                 = { .text = "WUPA" },
+	[ISO14443A_CMD_ANTICOLL_OR_SELECT]   = { .matcher = annotate14aAnticollOrSelect },
+	[ISO14443A_CMD_ANTICOLL_OR_SELECT_2] = { .matcher = annotate14aAnticollOrSelect2 },
+	[ISO14443A_CMD_REQA]                 = { .text = "REQA" },
+	[MIFARE_CMD_READBLOCK]               = { .text = "READBLOCK(%d)", .with_arg = true },
+	[MIFARE_CMD_WRITEBLOCK]              = { .text = "WRITEBLOCK(%d)", .with_arg = true },
+	[ISO14443A_CMD_HALT]                 = { .matcher = annotate14aHalt },
+	[ISO14443A_CMD_RATS]                 = { .text = "RATS" },
+	[MIFARE_CMD_INC]                     = { .text = "INC(%d)", .with_arg = true },
+	[MIFARE_CMD_DEC]                     = { .text = "DEC(%d)", .with_arg = true },
+	[MIFARE_CMD_RESTORE]                 = { .text = "RESTORE(%d)", .with_arg = true },
+	[MIFARE_CMD_TRANSFER]                = { .text = "TRANSFER(%d)", .with_arg = true },
+	[MIFARE_AUTH_KEYA]                   = { .matcher = annotate14aAuthKeyA },
+	[MIFARE_AUTH_KEYB]                   = { .matcher = annotate14aAuthKeyB },
+	[MIFARE_MAGICWUPC1]                  = { .text = "MAGIC WUPC1" },
+	[MIFARE_MAGICWUPC2]                  = { .text = "MAGIC WUPC2" },
+	[MIFARE_MAGICWIPEC]                  = { .text = "MAGIC WIPEC" },
+	[MIFARE_ULC_AUTH_1]                  = { .text = "AUTH " },
+	[MIFARE_ULC_AUTH_2]                  = { .text = "AUTH_ANSW" },
+	[MIFARE_ULEV1_AUTH]                  = { .matcher = annotate14aUlev1Auth },
+	[MIFARE_ULEV1_FASTREAD]              = { .matcher = annotate14aUlev1Fastread },
+	[MIFARE_ULC_WRITE]                   = { .matcher = annotate14aUlcWrite },
+	[MIFARE_ULEV1_READ_CNT]              = { .matcher = annotate14aUlev1ReadCnt },
+	[MIFARE_ULEV1_INCR_CNT]              = { .matcher = annotate14aUlev1IncrCnt },
+	[MIFARE_ULEV1_READSIG]               = { .text = "READ_SIG" },
+	[MIFARE_ULEV1_CHECKTEAR]             = { .text = "CHK_TEARING(%d)", .with_arg = true },
+	[MIFARE_ULEV1_VCSL]                  = { .text = "VCSL" },
+};
+
+void annotateIso14443a(char *exp, size_t size, uint8_t* cmd, uint8_t cmdsize)
+{
+	annotateFromTable(annotate_table_iso14443a, exp, size, cmd, cmdsize);
 }
 
 void annotateMifare(char *exp, size_t size, uint8_t* cmd, uint8_t cmdsize, uint8_t* parity, uint8_t paritysize, bool isResponse) {
@@ -654,6 +699,32 @@ static bool NestedCheckKey(uint64_t key, TAuthData *ad, uint8_t *cmd, uint8_t cm
 }
 
 
+// Session key table: every crypto1 key recovered in this session - by the
+// mfkey32/mfkey64 attacks, darkside/nested runs or while interpreting a
+// trace - is remembered here and tried right after the last used key when a
+// listed auth doesn't match it. A sniffed session using several recovered
+// sector keys then decrypts without falling through to the default key list
+// or the 16k-step nested search on every re-list.
+#define MF_SESSION_KEYS 64
+static uint64_t mfSessionKeys[MF_SESSION_KEYS];
+static uint32_t mfSessionKeyCount = 0;
+static uint32_t mfSessionKeyNext = 0;	// ring position once the table is full
+static bool annotation_cache_complete;	// defined with the cache below
+
+void mfSessionKeyAdd(uint64_t key)
+{
+	for (uint32_t i = 0; i < mfSessionKeyCount; i++) {
+		if (mfSessionKeys[i] == key)
+			return;
+	}
+	mfSessionKeys[mfSessionKeyNext] = key;
+	mfSessionKeyNext = (mfSessionKeyNext + 1) % MF_SESSION_KEYS;
+	if (mfSessionKeyCount < MF_SESSION_KEYS)
+		mfSessionKeyCount++;
+	// frames a previous list pass could not decrypt may decrypt now
+	annotation_cache_complete = false;
+}
+
 static bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isResponse, uint8_t *mfData, size_t *mfDataLen) {
 	static struct Crypto1State *traceCrypto1;
 	static uint64_t mfLastKey;
@@ -679,14 +750,17 @@ static bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, boo
 			AuthData.ks3 = AuthData.at_enc ^ prng_successor(AuthData.nt, 96);
 
 			mfLastKey = GetCrypto1ProbableKey(&AuthData);
-			PrintAndLog("            |          * | key | probable key:%012"PRIx64" Prng:%s   ks2:%08x ks3:%08x |     |",
+			char *out = PrintBatchReserve(160);
+			snprintf(out, 160, "            |          * | key | probable key:%012"PRIx64" Prng:%s   ks2:%08x ks3:%08x |     |",
 				mfLastKey,
 				validate_prng_nonce(AuthData.nt) ? "WEAK": "HARD",
 				AuthData.ks2,
 				AuthData.ks3);
+			PrintBatchCommit();
 
 			AuthData.first_auth = false;
 
+			mfSessionKeyAdd(mfLastKey);
 			traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
 		} else {
 			if (traceCrypto1) {
@@ -697,25 +771,50 @@ static bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, boo
 			// check last used key
 			if (mfLastKey) {
 				if (NestedCheckKey(mfLastKey, &AuthData, cmd, cmdsize, parity)) {
-					PrintAndLog("            |          * | key | last used key:%012"PRIx64"            ks2:%08x ks3:%08x |     |",
+					char *out = PrintBatchReserve(160);
+					snprintf(out, 160, "            |          * | key | last used key:%012"PRIx64"            ks2:%08x ks3:%08x |     |",
 						mfLastKey,
 						AuthData.ks2,
 						AuthData.ks3);
+					PrintBatchCommit();
 
 				traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
 				};
 			}
 
+			// check keys recovered earlier in this session
+			if (!traceCrypto1) {
+				for (uint32_t i = 0; i < mfSessionKeyCount; i++) {
+					if (mfSessionKeys[i] == mfLastKey)
+						continue;
+					if (NestedCheckKey(mfSessionKeys[i], &AuthData, cmd, cmdsize, parity)) {
+						char *out = PrintBatchReserve(160);
+						snprintf(out, 160, "            |          * | key | session key:%012"PRIx64"              ks2:%08x ks3:%08x |     |",
+							mfSessionKeys[i],
+							AuthData.ks2,
+							AuthData.ks3);
+						PrintBatchCommit();
+
+						mfLastKey = mfSessionKeys[i];
+						traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
+						break;
+					}
+				}
+			}
+
 			// check default keys
 			if (!traceCrypto1) {
 				for (int defaultKeyCounter = 0; defaultKeyCounter < MifareDefaultKeysSize; defaultKeyCounter++){
 					if (NestedCheckKey(MifareDefaultKeys[defaultKeyCounter], &AuthData, cmd, cmdsize, parity)) {
-						PrintAndLog("            |          * | key | default key:%012"PRIx64"              ks2:%08x ks3:%08x |     |",
+						char *out = PrintBatchReserve(160);
+						snprintf(out, 160, "            |          * | key | default key:%012"PRIx64"              ks2:%08x ks3:%08x |     |",
 							MifareDefaultKeys[defaultKeyCounter],
 							AuthData.ks2,
 							AuthData.ks3);
+						PrintBatchCommit();
 
 						mfLastKey = MifareDefaultKeys[defaultKeyCounter];
+						mfSessionKeyAdd(mfLastKey);
 						traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
 						break;
 					};
@@ -742,10 +841,13 @@ static bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, boo
 
 							AuthData.nt = ntx;
 							mfLastKey = GetCrypto1ProbableKey(&AuthData);
-							PrintAndLog("            |          * | key | nested probable key:%012"PRIx64"      ks2:%08x ks3:%08x |     |",
+							mfSessionKeyAdd(mfLastKey);
+							char *out = PrintBatchReserve(160);
+							snprintf(out, 160, "            |          * | key | nested probable key:%012"PRIx64"      ks2:%08x ks3:%08x |     |",
 								mfLastKey,
 								AuthData.ks2,
 								AuthData.ks3);
+							PrintBatchCommit();
 
 							traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
 							break;
@@ -802,13 +904,13 @@ static bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, boo
 }
 
 
-bool is_last_record(uint16_t tracepos, uint8_t *trace, uint16_t traceLen)
+bool is_last_record(uint32_t tracepos, uint8_t *trace, uint32_t traceLen)
 {
 	return(tracepos + sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint16_t) >= traceLen);
 }
 
 
-bool next_record_is_response(uint16_t tracepos, uint8_t *trace)
+bool next_record_is_response(uint32_t tracepos, uint8_t *trace)
 {
 	uint16_t next_records_datalen = *((uint16_t *)(trace + tracepos + sizeof(uint32_t) + sizeof(uint16_t)));
 
@@ -816,7 +918,7 @@ bool next_record_is_response(uint16_t tracepos, uint8_t *trace)
 }
 
 
-bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint16_t *tracepos, uint16_t traceLen, uint8_t *trace, uint8_t *frame, uint8_t *topaz_reader_command, uint16_t *data_len)
+bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint32_t *tracepos, uint32_t traceLen, uint8_t *trace, uint8_t *frame, uint8_t *topaz_reader_command, uint16_t *data_len)
 {
 
 #define MAX_TOPAZ_READER_CMD_LEN    16
@@ -855,7 +957,117 @@ bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint16_t
 }
 
 
-uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes)
+// Per-frame annotation cache. Re-listing the same capture with different
+// display options repeats the whole per-frame analysis, including the
+// crypto1 parity and key checks of the mf interpreter - noticeable when
+// iterating filters over a six-digit frame count. Cache the annotation (and
+// the mf decrypt result) keyed by trace offset. The cache is only filled
+// during complete sequential walks, because the interpreters are stateful
+// and a filtered pass skips frames; it is served again as long as protocol,
+// trace length and a sampled checksum of the trace still match.
+typedef struct {
+	uint32_t pos;			// trace offset of the frame header
+	bool has_dec;			// frame got a decrypted "dec" line
+	uint8_t mfCrc;
+	uint8_t mfDataLen;
+	uint8_t mfData[32];
+	char exp[30];
+	char dec_exp[30];
+} annotation_cache_entry_t;
+
+static annotation_cache_entry_t *annotation_cache = NULL;
+static uint32_t annotation_cache_frames = 0;
+static uint32_t annotation_cache_allocated = 0;
+static bool annotation_cache_complete;	// also cleared by mfSessionKeyAdd above
+static bool annotation_cache_filling = false;
+static bool annotation_cache_serving = false;
+static uint8_t annotation_cache_protocol = 0;
+static uint32_t annotation_cache_tracelen = 0;
+static uint32_t annotation_cache_tracesum = 0;
+
+static uint32_t annotationCacheTraceSum(uint8_t *trace, uint32_t traceLen)
+{
+	uint32_t sum = traceLen;
+	uint32_t step = (traceLen > 4096) ? traceLen / 4096 : 1;
+	for (uint32_t i = 0; i < traceLen; i += step) {
+		sum = sum * 33 + trace[i];
+	}
+	return sum;
+}
+
+static void annotationCacheBegin(uint8_t protocol, uint8_t *trace, uint32_t traceLen, bool full_walk)
+{
+	uint32_t sum = annotationCacheTraceSum(trace, traceLen);
+	annotation_cache_serving = false;
+	annotation_cache_filling = false;
+	if (annotation_cache_complete
+			&& annotation_cache_protocol == protocol
+			&& annotation_cache_tracelen == traceLen
+			&& annotation_cache_tracesum == sum) {
+		annotation_cache_serving = true;
+		return;
+	}
+	if (!full_walk) return;
+	annotation_cache_frames = 0;
+	annotation_cache_complete = false;
+	annotation_cache_protocol = protocol;
+	annotation_cache_tracelen = traceLen;
+	annotation_cache_tracesum = sum;
+	annotation_cache_filling = true;
+}
+
+static void annotationCacheEnd(void)
+{
+	if (annotation_cache_filling) {
+		annotation_cache_complete = true;
+	}
+	annotation_cache_filling = false;
+	annotation_cache_serving = false;
+}
+
+static const annotation_cache_entry_t *annotationCacheLookup(uint32_t pos)
+{
+	if (!annotation_cache_serving) return NULL;
+	uint32_t lo = 0, hi = annotation_cache_frames;
+	while (lo < hi) {		// entries are sorted by trace offset
+		uint32_t mid = (lo + hi) / 2;
+		if (annotation_cache[mid].pos < pos) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo < annotation_cache_frames && annotation_cache[lo].pos == pos) {
+		return &annotation_cache[lo];
+	}
+	return NULL;
+}
+
+static void annotationCacheStore(uint32_t pos, const char *exp, bool has_dec, uint8_t *mfData, size_t mfDataLen, const char *dec_exp, uint8_t mfCrc)
+{
+	if (!annotation_cache_filling) return;
+	if (annotation_cache_frames == annotation_cache_allocated) {
+		uint32_t newsize = (annotation_cache_allocated == 0) ? 1024 : annotation_cache_allocated * 2;
+		annotation_cache_entry_t *p = realloc(annotation_cache, newsize * sizeof(annotation_cache_entry_t));
+		if (p == NULL) {	// keep listing, just stop caching
+			annotation_cache_filling = false;
+			return;
+		}
+		annotation_cache = p;
+		annotation_cache_allocated = newsize;
+	}
+	annotation_cache_entry_t *e = &annotation_cache[annotation_cache_frames++];
+	e->pos = pos;
+	e->has_dec = has_dec;
+	e->mfCrc = mfCrc;
+	e->mfDataLen = (mfDataLen > sizeof(e->mfData)) ? sizeof(e->mfData) : mfDataLen;
+	memcpy(e->mfData, mfData, e->mfDataLen);
+	memcpy(e->exp, exp, sizeof(e->exp));
+	memcpy(e->dec_exp, dec_exp, sizeof(e->dec_exp));
+}
+
+
+uint32_t printTraceLine(uint32_t tracepos, uint32_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes)
 {
 	bool isResponse;
 	uint16_t data_len, parity_len;
@@ -863,8 +1075,10 @@ uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, ui
 	uint8_t topaz_reader_command[9];
 	uint32_t timestamp, first_timestamp, EndOfTransmissionTimestamp;
 	char explanation[30] = {0};
+	char dec_explanation[30] = {0};
 	uint8_t mfData[32] = {0};
 	size_t mfDataLen = 0;
+	uint32_t frame_start = tracepos;
 
 	if (tracepos + sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint16_t) > traceLen) return traceLen;
 
@@ -949,9 +1163,19 @@ uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, ui
 			&& protocol != ISO_7816_4
 			&& (isResponse || protocol == ISO_14443A)
 			&& (oddparity8(frame[j]) != ((parityBits >> (7-(j&0x0007))) & 0x01))) {
-			snprintf(line[j/16]+(( j % 16) * 4), 110, " %02x!", frame[j]);
+			char *pos = line[j/16] + ((j % 16) * 4);
+			pos[0] = ' ';
+			pos[1] = hex_digits_lower[frame[j] >> 4];
+			pos[2] = hex_digits_lower[frame[j] & 0x0f];
+			pos[3] = '!';
+			pos[4] = '\0';
 		} else {
-			snprintf(line[j/16]+(( j % 16) * 4), 110, " %02x ", frame[j]);
+			char *pos = line[j/16] + ((j % 16) * 4);
+			pos[0] = ' ';
+			pos[1] = hex_digits_lower[frame[j] >> 4];
+			pos[2] = hex_digits_lower[frame[j] & 0x0f];
+			pos[3] = ' ';
+			pos[4] = '\0';
 		}
 	}
 
@@ -984,26 +1208,33 @@ uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, ui
 
 	EndOfTransmissionTimestamp = timestamp + duration;
 
-	if (protocol == PROTO_MIFARE)
-		annotateMifare(explanation, sizeof(explanation), frame, data_len, parityBytes, parity_len, isResponse);
-
-	if (!isResponse) {
-		switch(protocol) {
-			case ICLASS:      annotateIclass(explanation,sizeof(explanation),frame,data_len); break;
-			case ISO_14443A:  annotateIso14443a(explanation,sizeof(explanation),frame,data_len); break;
-			case ISO_14443B:  annotateIso14443b(explanation,sizeof(explanation),frame,data_len); break;
-			case TOPAZ:       annotateTopaz(explanation,sizeof(explanation),frame,data_len); break;
-			case ISO_15693:   annotateIso15693(explanation,sizeof(explanation),frame,data_len); break;
-			case ISO_7816_4:  annotateIso7816(explanation, sizeof(explanation), frame, data_len); break;
-			case ISO_14443_4: annotateIso14443_4(explanation, sizeof(explanation), frame, data_len); break;
-			default:          break;
+	const annotation_cache_entry_t *cached = annotationCacheLookup(frame_start);
+
+	if (cached != NULL) {
+		memcpy(explanation, cached->exp, sizeof(explanation));
+	} else {
+		if (protocol == PROTO_MIFARE)
+			annotateMifare(explanation, sizeof(explanation), frame, data_len, parityBytes, parity_len, isResponse);
+
+		if (!isResponse) {
+			switch(protocol) {
+				case ICLASS:      annotateIclass(explanation,sizeof(explanation),frame,data_len); break;
+				case ISO_14443A:  annotateIso14443a(explanation,sizeof(explanation),frame,data_len); break;
+				case ISO_14443B:  annotateIso14443b(explanation,sizeof(explanation),frame,data_len); break;
+				case TOPAZ:       annotateTopaz(explanation,sizeof(explanation),frame,data_len); break;
+				case ISO_15693:   annotateIso15693(explanation,sizeof(explanation),frame,data_len); break;
+				case ISO_7816_4:  annotateIso7816(explanation, sizeof(explanation), frame, data_len); break;
+				case ISO_14443_4: annotateIso14443_4(explanation, sizeof(explanation), frame, data_len); break;
+				default:          break;
+			}
 		}
 	}
 
 	int num_lines = MIN((data_len - 1)/16 + 1, 16);
 	for (int j = 0; j < num_lines ; j++) {
+		char *out = PrintBatchReserve(160);
 		if (j == 0) {
-			PrintAndLog(" %10" PRIu32 " | %10" PRIu32 " | %s |%-64s | %s| %s",
+			snprintf(out, 160, " %10" PRIu32 " | %10" PRIu32 " | %s |%-64s | %s| %s",
 				(timestamp - first_timestamp),
 				(EndOfTransmissionTimestamp - first_timestamp),
 				(isResponse ? "Tag" : "Rdr"),
@@ -1011,36 +1242,54 @@ uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, ui
 				(j == num_lines-1) ? crc : "    ",
 				(j == num_lines-1) ? explanation : "");
 		} else {
-			PrintAndLog("            |            |     |%-64s | %s| %s",
+			snprintf(out, 160, "            |            |     |%-64s | %s| %s",
 				line[j],
 				(j == num_lines-1) ? crc : "    ",
 				(j == num_lines-1) ? explanation : "");
 		}
+		PrintBatchCommit();
 	}
 
-	if (DecodeMifareData(frame, data_len, parityBytes, isResponse, mfData, &mfDataLen)) {
-		memset(explanation, 0x00, sizeof(explanation));
-		if (!isResponse) {
-			explanation[0] = '>';
-			annotateIso14443a(&explanation[1], sizeof(explanation) - 1, mfData, mfDataLen);
+	bool has_dec;
+	uint8_t crcc = 2;
+	if (cached != NULL) {
+		has_dec = cached->has_dec;
+		mfDataLen = cached->mfDataLen;
+		memcpy(mfData, cached->mfData, cached->mfDataLen);
+		memcpy(dec_explanation, cached->dec_exp, sizeof(dec_explanation));
+		crcc = cached->mfCrc;
+	} else {
+		has_dec = DecodeMifareData(frame, data_len, parityBytes, isResponse, mfData, &mfDataLen);
+		if (has_dec) {
+			if (!isResponse) {
+				dec_explanation[0] = '>';
+				annotateIso14443a(&dec_explanation[1], sizeof(dec_explanation) - 1, mfData, mfDataLen);
+			}
+			crcc = iso14443A_CRC_check(isResponse, mfData, mfDataLen);
 		}
-		uint8_t crcc = iso14443A_CRC_check(isResponse, mfData, mfDataLen);
-		PrintAndLog("            |          * | dec |%-64s | %-4s| %s",
+		annotationCacheStore(frame_start, explanation, has_dec, mfData, mfDataLen, dec_explanation, crcc);
+	}
+	if (has_dec) {
+		char *out = PrintBatchReserve(160);
+		snprintf(out, 160, "            |          * | dec |%-64s | %-4s| %s",
 			sprint_hex(mfData, mfDataLen),
 			(crcc == 0 ? "!crc" : (crcc == 1 ? " ok " : "    ")),
-			(true) ? explanation : "");
-	};
+			dec_explanation);
+		PrintBatchCommit();
+	}
 
 	if (is_last_record(tracepos, trace, traceLen)) return traceLen;
 
 	if (showWaitCycles && !isResponse && next_record_is_response(tracepos, trace)) {
 		uint32_t next_timestamp = *((uint32_t *)(trace + tracepos));
 
-		PrintAndLog(" %10d | %10d | %s | fdt (Frame Delay Time): %d",
+		char *out = PrintBatchReserve(160);
+		snprintf(out, 160, " %10d | %10d | %s | fdt (Frame Delay Time): %d",
 			(EndOfTransmissionTimestamp - first_timestamp),
 			(next_timestamp - first_timestamp),
 			"   ",
 			(next_timestamp - EndOfTransmissionTimestamp));
+		PrintBatchCommit();
 	}
 
 	return tracepos;
@@ -1054,50 +1303,69 @@ int CmdHFList(const char *Cmd)
 	bool loadFromFile = false;
 	bool PCSCtrace = false;
 	bool saveToFile = false;
-	char param1 = '\0';
-	char param2 = '\0';
-	char param3 = '\0';
-	char param4 = '\0';
 	char type[40] = {0};
 	char filename[FILE_PATH_SIZE] = {0};
 	uint8_t protocol = 0;
+	// filters. Only the frames passing all of them get annotated and printed
+	uint32_t tailCount = 0;
+	int filterCmd = -1;
+	char filterDir = '\0';
+	bool timeFilter = false;
+	uint32_t timeFrom = 0, timeTo = 0;
 
 	// parse command line
 	int tlen = param_getstr(Cmd, 0, type, sizeof(type));
-	if (param_getlength(Cmd, 1) == 1) {
-		param1 = param_getchar(Cmd, 1);
-	} else {
-		param_getstr(Cmd, 1, filename, sizeof(filename));
-	}
-	if (param_getlength(Cmd, 2) == 1) {
-		param2 = param_getchar(Cmd, 2);
-	} else if (strlen(filename) == 0) {
-		param_getstr(Cmd, 2, filename, sizeof(filename));
-	}
-	if (param_getlength(Cmd, 3) == 1) {
-		param3 = param_getchar(Cmd, 3);
-	} else if (strlen(filename) == 0) {
-		param_getstr(Cmd, 3, filename, sizeof(filename));
-	}
-	if (param_getlength(Cmd, 4) == 1) {
-		param4 = param_getchar(Cmd, 4);
-	} else if (strlen(filename) == 0) {
-		param_getstr(Cmd, 4, filename, sizeof(filename));
-	}
-
-	// Validate params
-	bool errors = false;
-
-	if(tlen == 0) {
-		errors = true;
-	}
-
-	if(param1 == 'h'
-			|| (param1 != 0 && param1 != 'f' && param1 != 'c' && param1 != 'l' && param1 != 'p')
-			|| (param2 != 0 && param2 != 'f' && param2 != 'c' && param2 != 'l' && param1 != 'p')
-			|| (param3 != 0 && param3 != 'f' && param3 != 'c' && param3 != 'l' && param1 != 'p')
-			|| (param4 != 0 && param4 != 'f' && param4 != 'c' && param4 != 'l' && param4 != 'p')) {
-		errors = true;
+	bool errors = (tlen == 0);
+
+	uint8_t paramnum = 1;
+	while (!errors && param_getlength(Cmd, paramnum) > 0) {
+		if (param_getlength(Cmd, paramnum) == 1) {
+			switch (param_getchar(Cmd, paramnum)) {
+				case 'f':
+					showWaitCycles = true;
+					break;
+				case 'c':
+					markCRCBytes = true;
+					break;
+				case 'l':
+					loadFromFile = true;
+					break;
+				case 'p':
+					PCSCtrace = true;
+					break;
+				case 'n':
+					tailCount = param_get32ex(Cmd, ++paramnum, 0, 10);
+					if (tailCount == 0) errors = true;
+					break;
+				case 'b':
+					filterCmd = param_get32ex(Cmd, ++paramnum, 0x100, 16);
+					if (filterCmd > 0xff) errors = true;
+					break;
+				case 'd':
+					filterDir = param_getchar(Cmd, ++paramnum);
+					if (filterDir != 'r' && filterDir != 't') errors = true;
+					break;
+				case 't': {
+					char range[40] = {0};
+					param_getstr(Cmd, ++paramnum, range, sizeof(range));
+					if (sscanf(range, "%u-%u", &timeFrom, &timeTo) != 2 || timeTo < timeFrom) {
+						errors = true;
+					} else {
+						timeFilter = true;
+					}
+					break;
+				}
+				case 'h':
+				default:
+					errors = true;
+					break;
+			}
+		} else if (strlen(filename) == 0) {
+			param_getstr(Cmd, paramnum, filename, sizeof(filename));
+		} else {
+			errors = true;
+		}
+		paramnum++;
 	}
 
 	if(!errors) {
@@ -1114,22 +1382,6 @@ int CmdHFList(const char *Cmd)
 		else errors = true;
 	}
 
-	if (param1 == 'f' || param2 == 'f' || param3 == 'f' || param4 == 'f') {
-		showWaitCycles = true;
-	}
-
-	if (param1 == 'c' || param2 == 'c' || param3 == 'c' || param4 == 'c') {
-		markCRCBytes = true;
-	}
-
-	if (param1 == 'l' || param2 == 'l' || param3 == 'l' || param4 == 'l') {
-		loadFromFile = true;
-	}
-
-	if (param1 == 'p' || param2 == 'p' || param3 == 'p' || param4 == 'p') {
-		PCSCtrace = true;
-	}
-
 	if ((loadFromFile || saveToFile) && strlen(filename) == 0) {
 		errors = true;
 	}
@@ -1140,13 +1392,17 @@ int CmdHFList(const char *Cmd)
 
 	if (errors) {
 		PrintAndLog("List or save protocol data.");
-		PrintAndLog("Usage:  hf list <protocol> [f] [c] [p] [l <filename>]");
+		PrintAndLog("Usage:  hf list <protocol> [f] [c] [p] [l <filename>] [n <count>] [b <byte>] [d <r|t>] [t <from>-<to>]");
 		PrintAndLog("        hf list save <filename>");
 		PrintAndLog("    f      - show frame delay times as well");
 		PrintAndLog("    c      - mark CRC bytes");
 		PrintAndLog("    p      - use trace buffer from PCSC card reader instead of PM3");
 		PrintAndLog("    l      - load data from file instead of trace buffer");
-		PrintAndLog("    save   - save data to file");
+		PrintAndLog("    n <count>   - show only the last <count> matching frames");
+		PrintAndLog("    b <byte>    - show only frames whose first data byte is <byte> (hex)");
+		PrintAndLog("    d <r|t>     - show only reader (r) or tag (t) frames");
+		PrintAndLog("    t <from>-<to> - show only frames with a start time in that range (carrier periods)");
+		PrintAndLog("    save   - save data to file (binary container with a frame index, loadable with l)");
 		PrintAndLog("Supported <protocol> values:");
 		PrintAndLog("    raw    - just show raw data without annotations");
 		PrintAndLog("    14a    - interpret data as iso14443a communications");
@@ -1162,46 +1418,57 @@ int CmdHFList(const char *Cmd)
 		PrintAndLog("example: hf list iclass");
 		PrintAndLog("example: hf list save myCardTrace.trc");
 		PrintAndLog("example: hf list 14a l myCardTrace.trc");
+		PrintAndLog("example: hf list 14a n 10");
+		PrintAndLog("example: hf list 14a b 52 d r");
 		return 0;
 	}
 
 
-	uint8_t *trace;
+	uint8_t *trace = NULL;
 	uint32_t tracepos = 0;
 	uint32_t traceLen = 0;
+	tracefile_t *tf = NULL;
 
 	if (loadFromFile) {
-		#define TRACE_CHUNK_SIZE (1<<16)        // 64K to start with. Will be enough for BigBuf and some room for future extensions
-		FILE *tracefile = NULL;
-		size_t bytes_read;
-		trace = malloc(TRACE_CHUNK_SIZE);
-		if (trace == NULL) {
-			PrintAndLog("Cannot allocate memory for trace");
-			return 2;
-		}
-		if ((tracefile = fopen(filename,"rb")) == NULL) {
+		tf = traceOpen(filename);
+		if (tf == NULL) {
 			PrintAndLog("Could not open file %s", filename);
-			free(trace);
 			return 0;
 		}
-		while (!feof(tracefile)) {
-			bytes_read = fread(trace+traceLen, 1, TRACE_CHUNK_SIZE, tracefile);
-			traceLen += bytes_read;
-			if (!feof(tracefile)) {
-				uint8_t *p = realloc(trace, traceLen + TRACE_CHUNK_SIZE);
-				if (p == NULL) {
-					PrintAndLog("Cannot allocate memory for trace");
-					free(trace);
-					fclose(tracefile);
-					return 2;
-				}
-				trace = p;
-			}
-		}
-		fclose(tracefile);
+		trace = tf->trace;
+		traceLen = tf->traceLen;
 	} else if (PCSCtrace) {
 		trace = pcsc_get_trace_addr();
 		traceLen = pcsc_get_traceLen();
+	} else if (saveToFile) {
+		// stream the trace straight into the container, chunk by chunk -
+		// the capture never needs to be in memory in one piece
+		uint8_t chunk[USB_CMD_DATA_SIZE];
+		UsbCommand response;
+		GetFromBigBuf(chunk, sizeof(chunk), 0, &response, -1, false);
+		traceLen = response.arg[2];
+		FILE *tracefile = traceWriteOpen(filename);
+		if (tracefile == NULL) {
+			PrintAndLog("Could not create file %s", filename);
+			return 1;
+		}
+		bool ok = traceWriteChunk(tracefile, chunk, MIN(traceLen, sizeof(chunk)));
+		for (uint32_t done = sizeof(chunk); ok && done < traceLen; done += sizeof(chunk)) {
+			uint32_t chunklen = MIN(traceLen - done, sizeof(chunk));
+			ok = GetFromBigBuf(chunk, chunklen, done, NULL, -1, false)
+				&& traceWriteChunk(tracefile, chunk, chunklen);
+		}
+		if (!ok) {
+			fclose(tracefile);
+			PrintAndLog("Could not write file %s", filename);
+			return 1;
+		}
+		if (traceWriteClose(tracefile) != 0) {
+			PrintAndLog("Could not write file %s", filename);
+			return 1;
+		}
+		PrintAndLog("Recorded Activity (TraceLen = %d bytes) written to file %s", traceLen, filename);
+		return 0;
 	} else {
 		trace = malloc(USB_CMD_DATA_SIZE);
 		// Query for the size of the trace
@@ -1221,14 +1488,22 @@ int CmdHFList(const char *Cmd)
 	}
 
 	if (saveToFile) {
-		FILE *tracefile = NULL;
-		if ((tracefile = fopen(filename,"wb")) == NULL) {
+		// PCSC trace, already in memory as one block
+		FILE *tracefile = traceWriteOpen(filename);
+		if (tracefile == NULL) {
 			PrintAndLog("Could not create file %s", filename);
 			return 1;
 		}
-		fwrite(trace, 1, traceLen, tracefile);
+		if (!traceWriteChunk(tracefile, trace, traceLen)) {
+			fclose(tracefile);
+			PrintAndLog("Could not write file %s", filename);
+			return 1;
+		}
+		if (traceWriteClose(tracefile) != 0) {
+			PrintAndLog("Could not write file %s", filename);
+			return 1;
+		}
 		PrintAndLog("Recorded Activity (TraceLen = %d bytes) written to file %s", traceLen, filename);
-		fclose(tracefile);
 	} else {
 		PrintAndLog("Recorded Activity (TraceLen = %d bytes)", traceLen);
 		PrintAndLog("");
@@ -1240,13 +1515,72 @@ int CmdHFList(const char *Cmd)
 		PrintAndLog("------------|------------|-----|-----------------------------------------------------------------|-----|--------------------|");
 
 		ClearAuthData();
-		while(tracepos < traceLen)
-		{
-			tracepos = printTraceLine(tracepos, traceLen, trace, protocol, showWaitCycles, markCRCBytes);
+
+		bool filtered = (tailCount > 0 || filterCmd >= 0 || filterDir != '\0' || timeFilter);
+		tracefile_idx_t *index = NULL;
+		uint32_t frames = 0;
+		if (filtered && protocol != TOPAZ) {	// topaz frames get merged, they need the sequential walk
+			if (tf != NULL && tf->index != NULL) {
+				// the filter pass below marks entries, so work on a copy of
+				// the mapped index
+				index = malloc(tf->frames * sizeof(tracefile_idx_t));
+				if (index != NULL) {
+					memcpy(index, tf->index, tf->frames * sizeof(tracefile_idx_t));
+					frames = tf->frames;
+				}
+			} else {
+				frames = traceIndex(trace, traceLen, &index);
+			}
 		}
+
+		annotationCacheBegin(protocol, trace, traceLen, index == NULL);
+		PrintBatchBegin();
+
+		if (index != NULL) {
+			// index-first: select the frames to show, then annotate only those
+			uint32_t first_timestamp = (frames > 0) ? index[0].timestamp : 0;
+			uint32_t matches = 0;
+			for (uint32_t i = 0; i < frames; i++) {
+				uint32_t reltime = index[i].timestamp - first_timestamp;
+				if ((filterCmd < 0 || index[i].cmd == filterCmd)
+						&& (filterDir == '\0' || (filterDir == 'r') != index[i].isResponse)
+						&& (!timeFilter || (reltime >= timeFrom && reltime <= timeTo))) {
+					matches++;
+				} else {
+					index[i].pos = traceLen;	// deselect
+				}
+			}
+			uint32_t skip = (tailCount > 0 && matches > tailCount) ? matches - tailCount : 0;
+			if (protocol == PROTO_MIFARE && (skip > 0 || matches < frames)) {
+				PrintAndLog("note: filters skip frames, crypto1 decryption may be incomplete");
+			}
+			for (uint32_t i = 0; i < frames; i++) {
+				if (index[i].pos >= traceLen) continue;
+				if (skip > 0) {
+					skip--;
+					continue;
+				}
+				printTraceLine(index[i].pos, traceLen, trace, protocol, showWaitCycles, markCRCBytes);
+			}
+			PrintBatchEnd();
+			PrintAndLog("%u frame(s) of %u shown", (matches > tailCount && tailCount > 0) ? tailCount : matches, frames);
+			free(index);
+		} else {
+			while(tracepos < traceLen)
+			{
+				tracepos = printTraceLine(tracepos, traceLen, trace, protocol, showWaitCycles, markCRCBytes);
+			}
+			PrintBatchEnd();
+		}
+
+		annotationCacheEnd();
 	}
 
-	free(trace);
+	if (tf != NULL) {
+		traceClose(tf);
+	} else if (!PCSCtrace) {
+		free(trace);
+	}
 	return 0;
 }
 
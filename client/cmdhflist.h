@@ -11,6 +11,10 @@
 #ifndef CMDHFLIST_H
 #define CMDHFLIST_H
 
+#include <stdint.h>
+
 extern int CmdHFList(const char *Cmd);
+// remember a recovered crypto1 key for trace decryption in this session
+extern void mfSessionKeyAdd(uint64_t key);
 
 #endif // CMDHFLIST_H
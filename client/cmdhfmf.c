@@ -26,6 +26,8 @@
 #include "mifare/mifarehost.h"
 #include "mifare.h"
 #include "mifare/mfkey.h"
+#include "mifare/mfdict.h"
+#include "mifare/keydb.h"
 #include "hardnested/hardnested_bf_core.h"
 #include "cliparser/cliparser.h"
 #include "cmdhf14a.h"
@@ -34,6 +36,8 @@
 #include "mifare/mad.h"
 #include "mifare/ndef.h"
 #include "emv/dump.h"
+#include "cmdhflist.h"
+#include "loclass/fileutils.h"
 #include "protocols.h"
 
 #define NESTED_SECTOR_RETRY     10          // how often we try mfested() until we give up
@@ -44,6 +48,7 @@ int CmdHF14AMifare(const char *Cmd)
 {
 	int isOK = 0;
 	uint64_t key = 0;
+	uint32_t uid = 0;
 	isOK = mfDarkside(&key);
 	switch (isOK) {
 		case -1 : PrintAndLog("Button pressed. Aborted."); return 1;
@@ -53,6 +58,9 @@ int CmdHF14AMifare(const char *Cmd)
 				  PrintAndLog("generating polynomial with 16 effective bits only, but shows unexpected behaviour."); return 1;
 		case -5 : PrintAndLog("Aborted via keyboard.");  return 1;
 		default : PrintAndLog("Found valid key:%012" PRIx64 "\n", key);
+				  mfSessionKeyAdd(key);
+				  if (!mfGetUid(&uid))
+					  keyDbRecord(uid, 0, 0, key);	// darkside targets block 0, key A
 	}
 
 	PrintAndLog("");
@@ -148,6 +156,8 @@ int CmdHF14AMfRdBl(const char *Cmd)
 
 		if (isOK) {
 			PrintAndLog("isOk:%02x data:%s", isOK, sprint_hex(data, 16));
+			if (resp.arg[1])
+				PrintAndLog("marginal coupling: %u air-interface retransmissions", (uint32_t)resp.arg[1]);
 		} else {
 			PrintAndLog("isOk:%02x", isOK);
 			return 1;
@@ -229,6 +239,8 @@ int CmdHF14AMfRdSc(const char *Cmd)
 								bln += blinc;
 						}
 						PrintAndLogEx(NORMAL, "UserData: %s", sprint_hex_inrow(&(data + (sectorNo<32?3:15) * 16)[9], 1));
+			if (resp.arg[1])
+				PrintAndLog("marginal coupling: %u air-interface retransmissions", (uint32_t)resp.arg[1]);
 		}
 	} else {
 		PrintAndLog("Command execute timeout");
@@ -282,7 +294,6 @@ int CmdHF14AMfDump(const char *Cmd)
 	uint8_t sectorNo, blockNo;
 
 	uint8_t keys[2][40][6];
-	uint8_t rights[40][4];
 	uint8_t carddata[256][16];
 	uint8_t numSectors = 16;
 
@@ -307,8 +318,7 @@ int CmdHF14AMfDump(const char *Cmd)
 	}
 
 	char opts = param_getchar(Cmd, 1);
-	bool useBothKeysAlways = false;
-	if (opts == 'k' || opts == 'K') useBothKeysAlways = true;
+	// 'k' (always try both keys) is the device's default behaviour now and accepted for compatibility
 	bool nullMissingKeys = false;
 	if (opts == 'm' || opts == 'M') nullMissingKeys = true;
 
@@ -332,116 +342,65 @@ int CmdHF14AMfDump(const char *Cmd)
 	fclose(fin);
 
 	PrintAndLog("|-----------------------------------------|");
-	PrintAndLog("|------ Reading sector access bits...-----|");
+	PrintAndLog("|----- Dumping all blocks to file... -----|");
 	PrintAndLog("|-----------------------------------------|");
-	uint8_t tries = 0;
-	for (sectorNo = 0; sectorNo < numSectors; sectorNo++) {
-		for (tries = 0; tries < 3; tries++) {
-			UsbCommand c = {CMD_MIFARE_READBL, {FirstBlockOfSector(sectorNo) + NumBlocksPerSector(sectorNo) - 1, 0, 0}};
-			// At least the Access Conditions can always be read with key A.
-			memcpy(c.d.asBytes, keys[0][sectorNo], 6);
-			SendCommand(&c);
 
-			if (WaitForResponseTimeout(CMD_ACK,&resp,1500)) {
-				uint8_t isOK  = resp.arg[0] & 0xff;
-				uint8_t *data  = resp.d.asBytes;
-				if (isOK){
-					rights[sectorNo][0] = ((data[7] & 0x10)>>2) | ((data[8] & 0x1)<<1) | ((data[8] & 0x10)>>4); // C1C2C3 for data area 0
-					rights[sectorNo][1] = ((data[7] & 0x20)>>3) | ((data[8] & 0x2)<<0) | ((data[8] & 0x20)>>5); // C1C2C3 for data area 1
-					rights[sectorNo][2] = ((data[7] & 0x40)>>4) | ((data[8] & 0x4)>>1) | ((data[8] & 0x40)>>6); // C1C2C3 for data area 2
-					rights[sectorNo][3] = ((data[7] & 0x80)>>5) | ((data[8] & 0x8)>>2) | ((data[8] & 0x80)>>7); // C1C2C3 for sector trailer
-					break;
-				} else if (tries == 2) { // on last try set defaults
-					PrintAndLog("Could not get access rights for sector %2d. Trying with defaults...", sectorNo);
-					rights[sectorNo][0] = rights[sectorNo][1] = rights[sectorNo][2] = 0x00;
-					rights[sectorNo][3] = 0x01;
-				}
-			} else {
-				PrintAndLog("Command execute timeout when trying to read access rights for sector %2d. Trying with defaults...", sectorNo);
-				rights[sectorNo][0] = rights[sectorNo][1] = rights[sectorNo][2] = 0x00;
-				rights[sectorNo][3] = 0x01;
-			}
-		}
+	// The whole card is read on the device in one pass. Key A is tried first
+	// for every block, key B for whatever remains, so no separate access
+	// rights pass is needed (and 'k' comes for free).
+	UsbCommand c = {CMD_MIFARE_READCARD, {numSectors, 0, 0}};
+	for (int group = 0; group <= 1; group++)
+		for (sectorNo = 0; sectorNo < numSectors; sectorNo++)
+			memcpy(c.d.asBytes + (group * numSectors + sectorNo) * 6, keys[group][sectorNo], 6);
+	SendCommand(&c);
+
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 10000)) {
+		PrintAndLog("Command execute timeout when trying to read the card.");
+		return 1;
 	}
 
-	PrintAndLog("|-----------------------------------------|");
-	PrintAndLog("|----- Dumping all blocks to file... -----|");
-	PrintAndLog("|-----------------------------------------|");
+	uint8_t readok[32];
+	memcpy(readok, resp.d.asBytes, sizeof(readok));
+	uint32_t bufferSize = resp.arg[1];
+	uint32_t startindex = resp.arg[2];
+	if (bufferSize > sizeof(carddata)) {
+		PrintAndLog("Data exceeded buffer size!");
+		return 1;
+	}
 
-	bool isOK = true;
-	for (sectorNo = 0; isOK && sectorNo < numSectors; sectorNo++) {
-		for (blockNo = 0; isOK && blockNo < NumBlocksPerSector(sectorNo); blockNo++) {
-			bool received = false;
-			for (tries = 0; tries < 3; tries++) {
-				if (blockNo == NumBlocksPerSector(sectorNo) - 1) {      // sector trailer. At least the Access Conditions can always be read with key A.
-					UsbCommand c = {CMD_MIFARE_READBL, {FirstBlockOfSector(sectorNo) + blockNo, 0, 0}};
-					memcpy(c.d.asBytes, keys[0][sectorNo], 6);
-					SendCommand(&c);
-					received = WaitForResponseTimeout(CMD_ACK,&resp,1500);
-				} else if (useBothKeysAlways) {
-					// Always try both keys, even if access conditions wouldn't work.
-					for (int k=0; k<=1; k++) {
-						UsbCommand c = {CMD_MIFARE_READBL, {FirstBlockOfSector(sectorNo) + blockNo, 1, 0}};
-						memcpy(c.d.asBytes, keys[k][sectorNo], 6);
-						SendCommand(&c);
-						received = WaitForResponseTimeout(CMD_ACK,&resp,1500);
-
-						// Don't try the other one on success.
-						if (resp.arg[0] & 0xff) break;
-					}
-				} else {                                                // data block. Check if it can be read with key A or key B
-					uint8_t data_area = sectorNo<32?blockNo:blockNo/5;
-					if ((rights[sectorNo][data_area] == 0x03) || (rights[sectorNo][data_area] == 0x05)) {   // only key B would work
-						UsbCommand c = {CMD_MIFARE_READBL, {FirstBlockOfSector(sectorNo) + blockNo, 1, 0}};
-						memcpy(c.d.asBytes, keys[1][sectorNo], 6);
-						SendCommand(&c);
-						received = WaitForResponseTimeout(CMD_ACK,&resp,1500);
-					} else if (rights[sectorNo][data_area] == 0x07) {                                       // no key would work
-						PrintAndLog("Access rights do not allow reading of sector %2d block %3d", sectorNo, blockNo);
-						if (nullMissingKeys) {
-							memset(resp.d.asBytes, 0, 16);
-							resp.arg[0] = 1;
-							PrintAndLog("  ... filling the block with NULL");
-							received = true;
-						} else {
-							isOK = false;
-							tries = 2;
-						}
-					} else {                                                                                // key A would work
-						UsbCommand c = {CMD_MIFARE_READBL, {FirstBlockOfSector(sectorNo) + blockNo, 0, 0}};
-						memcpy(c.d.asBytes, keys[0][sectorNo], 6);
-						SendCommand(&c);
-						received = WaitForResponseTimeout(CMD_ACK,&resp,1500);
-					}
-				}
-				if (received) {
-					isOK  = resp.arg[0] & 0xff;
-					if (isOK) break;
-				}
-			}
+	memset(carddata, 0, sizeof(carddata));
+	if (!GetFromBigBuf((uint8_t *)carddata, bufferSize, startindex, NULL, -1, false)) {
+		PrintAndLog("Command execute timeout when downloading the card data.");
+		return 1;
+	}
 
-			if (received) {
-				isOK  = resp.arg[0] & 0xff;
-				uint8_t *data  = resp.d.asBytes;
-				if (blockNo == NumBlocksPerSector(sectorNo) - 1) {      // sector trailer. Fill in the keys.
-					memcpy(data, keys[0][sectorNo], 6);
-					memcpy(data + 10, keys[1][sectorNo], 6);
-				}
-				if (isOK) {
-					memcpy(carddata[FirstBlockOfSector(sectorNo) + blockNo], data, 16);
-					PrintAndLog("Successfully read block %2d of sector %2d.", blockNo, sectorNo);
+	bool isOK = true;
+	PrintBatchBegin();
+	for (sectorNo = 0; sectorNo < numSectors; sectorNo++) {
+		for (blockNo = 0; blockNo < NumBlocksPerSector(sectorNo); blockNo++) {
+			uint16_t block = FirstBlockOfSector(sectorNo) + blockNo;
+			char *out = PrintBatchReserve(64);
+			if (readok[block / 8] & (1 << (block % 8))) {
+				snprintf(out, 64, "Successfully read block %2d of sector %2d.", blockNo, sectorNo);
+				PrintBatchCommit();
+			} else {
+				snprintf(out, 64, "Could not read block %2d of sector %2d", blockNo, sectorNo);
+				PrintBatchCommit();
+				if (nullMissingKeys) {
+					out = PrintBatchReserve(64);
+					snprintf(out, 64, "  ... filling the block with NULL");
+					PrintBatchCommit();
 				} else {
-					PrintAndLog("Could not read block %2d of sector %2d", blockNo, sectorNo);
-					break;
+					isOK = false;
 				}
 			}
-			else {
-				isOK = false;
-				PrintAndLog("Command execute timeout when trying to read block %2d of sector %2d.", blockNo, sectorNo);
-				break;
+			if (blockNo == NumBlocksPerSector(sectorNo) - 1) {      // sector trailer. Fill in the keys.
+				memcpy(carddata[block], keys[0][sectorNo], 6);
+				memcpy(carddata[block] + 10, keys[1][sectorNo], 6);
 			}
 		}
 	}
+	PrintBatchEnd();
 
 	if (isOK) {
 		if ((fout = fopen("dumpdata.bin","wb")) == NULL) {
@@ -703,22 +662,42 @@ int CmdHF14AMfNested(const char *Cmd)
 			SectorsCnt, blockNo, keyType?'B':'A', transferToEml?'y':'n', createDumpFile?'y':'n', ((int)btimeout14a * 10000) / 106);
 	}
 
+	// uid for the cross-run key db; stays 0 when no card answers the select
+	uint32_t uid = 0;
+	mfGetUid(&uid);
+
 	// one-sector nested
 	if (cmdp == 'o') { // ------------------------------------  one sector working
 		PrintAndLog("--target block no:%3d, target key type:%c ", trgBlockNo, trgKeyType?'B':'A');
-		int16_t isOK = mfnested(blockNo, keyType, key, trgBlockNo, trgKeyType, keyBlock, true);
-		if (isOK) {
-			switch (isOK) {
-				case -1 : PrintAndLog("Error: No response from Proxmark.\n"); break;
-				case -2 : PrintAndLog("Button pressed. Aborted.\n"); break;
-				case -3 : PrintAndLog("Tag isn't vulnerable to Nested Attack (random numbers are not predictable).\n"); break;
-				default : PrintAndLog("Unknown Error.\n");
+
+		// a key recovered for this card in an earlier run makes the attack unnecessary
+		key64 = 0;
+		uint64_t dbkey;
+		if (uid && keyDbLookup(uid, mfSectorNum(trgBlockNo), trgKeyType, &dbkey)) {
+			num_to_bytes(dbkey, 6, keyBlock);
+			if (!mfCheckKeys(trgBlockNo, trgKeyType, true, 1, keyBlock, &key64))
+				PrintAndLog("Target key found in %s and verified on card - skipping nested attack", KEYDB_FILE);
+			else
+				key64 = 0;
+		}
+
+		if (!key64) {
+			int16_t isOK = mfnested(blockNo, keyType, key, trgBlockNo, trgKeyType, keyBlock, true);
+			if (isOK) {
+				switch (isOK) {
+					case -1 : PrintAndLog("Error: No response from Proxmark.\n"); break;
+					case -2 : PrintAndLog("Button pressed. Aborted.\n"); break;
+					case -3 : PrintAndLog("Tag isn't vulnerable to Nested Attack (random numbers are not predictable).\n"); break;
+					default : PrintAndLog("Unknown Error.\n");
+				}
+				return 2;
 			}
-			return 2;
+			key64 = bytes_to_num(keyBlock, 6);
 		}
-		key64 = bytes_to_num(keyBlock, 6);
 		if (key64) {
 			PrintAndLog("Found valid key:%012" PRIx64, key64);
+			mfSessionKeyAdd(key64);
+			keyDbRecord(uid, mfSectorNum(trgBlockNo), trgKeyType, key64);
 
 			// transfer key to the emulator
 			if (transferToEml) {
@@ -748,6 +727,17 @@ int CmdHF14AMfNested(const char *Cmd)
 		e_sector = calloc(SectorsCnt, sizeof(sector_t));
 		if (e_sector == NULL) return 1;
 
+		// keys recovered for this card in earlier runs first - a card that was
+		// cracked before never reaches the nested attack below
+		if (uid) {
+			uint8_t dbKeys[(USB_CMD_DATA_SIZE / 6) * 6];
+			uint32_t dbCnt = keyDbKeysForUid(uid, dbKeys, USB_CMD_DATA_SIZE / 6);
+			if (dbCnt) {
+				PrintAndLog("Testing %u key(s) recovered in earlier runs (%s)", dbCnt, KEYDB_FILE);
+				mfCheckKeysSec(SectorsCnt, 2, btimeout14a, true, dbCnt, dbKeys, e_sector);
+			}
+		}
+
 		//test current key and additional standard keys first
 		for (int defaultKeyCounter = 0; defaultKeyCounter < MifareDefaultKeysSize; defaultKeyCounter++){
 			num_to_bytes(MifareDefaultKeys[defaultKeyCounter], 6, (uint8_t*)(keyBlock + defaultKeyCounter * 6));
@@ -810,6 +800,7 @@ int CmdHF14AMfNested(const char *Cmd)
 					key64 = bytes_to_num(keyBlock, 6);
 					if (key64) {
 						PrintAndLog("Found valid key:%012" PRIx64, key64);
+						mfSessionKeyAdd(key64);
 						e_sector[sectorNo].foundKey[trgKeyType] = 1;
 						e_sector[sectorNo].Key[trgKeyType] = key64;
 
@@ -834,6 +825,12 @@ int CmdHF14AMfNested(const char *Cmd)
 		}
 		PrintAndLog("|---|----------------|---|----------------|---|");
 
+		// persist everything we learned for the next run
+		for (i = 0; i < SectorsCnt; i++)
+			for (j = 0; j < 2; j++)
+				if (e_sector[i].foundKey[j])
+					keyDbRecord(uid, i, j, e_sector[i].Key[j]);
+
 		// transfer keys to the emulator memory
 		if (transferToEml) {
 			for (i = 0; i < SectorsCnt; i++) {
@@ -1034,6 +1031,21 @@ int CmdHF14AMfNestedHard(const char *Cmd)
 			slow?"Yes":"No",
 			tests);
 
+	// a key recovered for this card in an earlier run makes the attack unnecessary
+	if (!nonce_file_read && tests == 0 && !know_target_key) {
+		uint32_t uid = 0;
+		uint64_t dbkey, key64;
+		uint8_t dbkeyblock[6];
+		if (!mfGetUid(&uid) && keyDbLookup(uid, mfSectorNum(trgBlockNo), trgKeyType, &dbkey)) {
+			num_to_bytes(dbkey, 6, dbkeyblock);
+			if (!mfCheckKeys(trgBlockNo, trgKeyType, true, 1, dbkeyblock, &key64)) {
+				PrintAndLog("Target key %012" PRIx64 " found in %s and verified on card - skipping hardnested attack", dbkey, KEYDB_FILE);
+				mfSessionKeyAdd(dbkey);
+				return 0;
+			}
+		}
+	}
+
 	int16_t isOK = mfnestedhard(blockNo, keyType, key, trgBlockNo, trgKeyType, know_target_key?trgkey:NULL, nonce_file_read, nonce_file_write, slow, tests);
 
 	if (isOK) {
@@ -1049,6 +1061,28 @@ int CmdHF14AMfNestedHard(const char *Cmd)
 }
 
 
+int CmdHF14AMfDictImport(const char *Cmd)
+{
+	char infile[FILE_PATH_SIZE] = {0};
+	char outfile[FILE_PATH_SIZE] = {0};
+
+	if (param_getstr(Cmd, 0, infile, sizeof(infile)) == 0) {
+		PrintAndLog("Usage:  hf mf dicimport <keys.dic> [<out file>]");
+		PrintAndLog("Converts a text key dictionary (12 hex symbols per line) to the binary");
+		PrintAndLog("indexed format: keys are deduplicated and sorted, and per-key hit");
+		PrintAndLog("counters persist across runs so 'hf mf chk' tries the historically");
+		PrintAndLog("most successful keys first. Re-importing keeps the counters of keys");
+		PrintAndLog("already present. Default output file is <keys.dic>.mfd");
+		PrintAndLog("      sample: hf mf dicimport default_keys.dic");
+		return 0;
+	}
+
+	if (param_getstr(Cmd, 1, outfile, sizeof(outfile)) == 0)
+		snprintf(outfile, sizeof(outfile), "%.*s.mfd", FILE_PATH_SIZE - 5, infile);
+
+	return mfdictImport(infile, outfile);
+}
+
 int CmdHF14AMfChk(const char *Cmd)
 {
 	if (strlen(Cmd)<3) {
@@ -1059,6 +1093,7 @@ int CmdHF14AMfChk(const char *Cmd)
 		PrintAndLog("t  - write keys to emulator memory");
 		PrintAndLog("s  - slow execute. timeout 1ms");
 		PrintAndLog("ss - very slow execute. timeout 5ms");
+		PrintAndLog("<dic> may also be a binary dictionary created with 'hf mf dicimport'");
 		PrintAndLog("      sample: hf mf chk 0 A 1234567890ab keys.dic");
 		PrintAndLog("              hf mf chk *1 ? t");
 		PrintAndLog("              hf mf chk *1 ? d");
@@ -1087,6 +1122,7 @@ int CmdHF14AMfChk(const char *Cmd)
 	bool     createDumpFile = 0;
 	bool     singleBlock    = false;     // Flag to ID if a single or multi key check
 	uint8_t  keyFoundCount  = 0;         // Counter to display the number of keys found/transfered to emulator
+	mfdict_t *dict          = NULL;      // binary dictionary, keeps the per-key hit counters
 
 	sector_t *e_sector = NULL;
 
@@ -1166,11 +1202,32 @@ int CmdHF14AMfChk(const char *Cmd)
 			// May be a dic file
 			if ( param_getstr(Cmd, 2 + i, filename, sizeof(filename)) >= FILE_PATH_SIZE ) {
 				PrintAndLog("File name too long");
+				mfdictClose(dict);
 				free(keyBlock);
 				return 2;
 			}
 
-			if ((f = fopen( filename , "r"))) {
+			mfdict_t *bindict = mfdictOpen(filename);
+			if (bindict != NULL) {
+				// binary indexed dictionary: keys come pre-deduplicated,
+				// ordered by their persisted hit counters
+				if (stKeyBlock - keycnt < bindict->count + 2) {
+					p = realloc(keyBlock, 6*(stKeyBlock = keycnt + bindict->count + 10));
+					if (!p) {
+						PrintAndLog("Cannot allocate memory for defKeys");
+						mfdictClose(bindict);
+						mfdictClose(dict);
+						free(keyBlock);
+						return 2;
+					}
+					keyBlock = p;
+				}
+				mfdictGetKeysByHits(bindict, keyBlock + 6 * keycnt);
+				keycnt += bindict->count;
+				PrintAndLog("chk binary dictionary %s: %u keys, most-hit first", filename, bindict->count);
+				mfdictClose(dict);	// only the last dictionary collects new hits
+				dict = bindict;
+			} else if ((f = fopen( filename , "r"))) {
 				while (fgets(buf, sizeof(buf), f)) {
 					if (strlen(buf) < 12 || buf[11] == '\n')
 						continue;
@@ -1196,6 +1253,7 @@ int CmdHF14AMfChk(const char *Cmd)
 						p = realloc(keyBlock, 6*(stKeyBlock+=10));
 						if (!p) {
 							PrintAndLog("Cannot allocate memory for defKeys");
+							mfdictClose(dict);
 							free(keyBlock);
 							fclose(f);
 							return 2;
@@ -1211,6 +1269,7 @@ int CmdHF14AMfChk(const char *Cmd)
 				fclose(f);
 			} else {
 				PrintAndLog("File: %s: not found or locked.", filename);
+				mfdictClose(dict);
 				free(keyBlock);
 				return 1;
 			}
@@ -1229,6 +1288,7 @@ int CmdHF14AMfChk(const char *Cmd)
 	// initialize storage for found keys
 	e_sector = calloc(SectorsCnt, sizeof(sector_t));
 	if (e_sector == NULL) {
+		mfdictClose(dict);
 		free(keyBlock);
 		return 1;
 	}
@@ -1247,23 +1307,38 @@ int CmdHF14AMfChk(const char *Cmd)
 	// !SingleKey, so all key check (if SectorsCnt > 0)
 	if (!singleBlock) {
 		PrintAndLog("To cancel this operation press the button on the proxmark...");
-		printf("--");
-		for (uint32_t c = 0; c < keycnt; c += max_keys) {
 
-			uint32_t size = keycnt-c > max_keys ? max_keys : keycnt-c;
-			res = mfCheckKeysSec(SectorsCnt, keyType, btimeout14a, clearTraceLog, size, &keyBlock[6 * c], e_sector); // timeout is (ms * 106)/10 or us*0.0106
-			clearTraceLog = false;
+		// large dictionary: upload it into the device once and let the device
+		// iterate all sectors and key types on its own instead of re-sending
+		// the dictionary per round trip
+		bool onDeviceCheck = (keycnt > max_keys && mfCheckKeysLoad(keyBlock, keycnt) == 0);
+		if (onDeviceCheck) {
+			PrintAndLog("Dictionary (%d keys) cached on device, checking...", keycnt);
+			res = mfCheckKeysCached(SectorsCnt, keyType, btimeout14a, clearTraceLog, keycnt, e_sector);
+			if (res == 0) {
+				foundAKey = true;
+			} else if (res == 1) {
+				PrintAndLog("Command execute timeout");
+			}
+		} else {
+			printf("--");
+			for (uint32_t c = 0; c < keycnt; c += max_keys) {
+
+				uint32_t size = keycnt-c > max_keys ? max_keys : keycnt-c;
+				res = mfCheckKeysSec(SectorsCnt, keyType, btimeout14a, clearTraceLog, size, &keyBlock[6 * c], e_sector); // timeout is (ms * 106)/10 or us*0.0106
+				clearTraceLog = false;
 
-			if (res != 1) {
-				if (!res) {
-					printf("o");
-					foundAKey = true;
+				if (res != 1) {
+					if (!res) {
+						printf("o");
+						foundAKey = true;
+					} else {
+						printf(".");
+					}
 				} else {
-					printf(".");
+					printf("\n");
+					PrintAndLog("Command execute timeout");
 				}
-			} else {
-				printf("\n");
-				PrintAndLog("Command execute timeout");
 			}
 		}
 	} else {
@@ -1294,6 +1369,33 @@ int CmdHF14AMfChk(const char *Cmd)
 		} while(--keyAB > 0);
 	}
 
+	// count the hits in the binary dictionary so successful keys get tried
+	// first next time
+	if (dict != NULL) {
+		uint8_t dictkey[6];
+		for (i = 0; i < SectorsCnt; i++) {
+			for (uint8_t keyAB = 0; keyAB < 2; keyAB++) {
+				if (e_sector[i].foundKey[keyAB]) {
+					num_to_bytes(e_sector[i].Key[keyAB], 6, dictkey);
+					mfdictRecordHit(dict, dictkey);
+				}
+			}
+		}
+		mfdictClose(dict);
+	}
+
+	// persist the found keys per uid, so the attack commands can skip a card
+	// that has been cracked before
+	if (foundAKey && !singleBlock) {
+		uint32_t uid = 0;
+		if (!mfGetUid(&uid)) {
+			for (i = 0; i < SectorsCnt; i++)
+				for (uint8_t keyAB = 0; keyAB < 2; keyAB++)
+					if (e_sector[i].foundKey[keyAB])
+						keyDbRecord(uid, i, keyAB, e_sector[i].Key[keyAB]);
+		}
+	}
+
 	// print result
 	if (foundAKey) {
 		PrintAndLog("");
@@ -1385,6 +1487,7 @@ void readerAttack(nonces_t ar_resp[], bool setEmulatorMem, bool doStandardAttack
 			//PrintAndLog("DEBUG: Trying sector %d, cuid %08x, nt %08x, ar %08x, nr %08x, ar2 %08x, nr2 %08x",ar_resp[i].sector, ar_resp[i].cuid,ar_resp[i].nonce,ar_resp[i].ar,ar_resp[i].nr,ar_resp[i].ar2,ar_resp[i].nr2);
 			if (doStandardAttack && mfkey32(ar_resp[i], &key)) {
 				PrintAndLog("  Found Key%s for sector %02d: [%04x%08x]", (ar_resp[i].keytype) ? "B" : "A", ar_resp[i].sector, (uint32_t) (key>>32), (uint32_t) (key &0xFFFFFFFF));
+				mfSessionKeyAdd(key);
 
 				for (uint8_t ii = 0; ii<ATTACK_KEY_COUNT; ii++) {
 					if (key_cnt[ii]==0 || stSector[ii]==ar_resp[i].sector) {
@@ -1412,6 +1515,7 @@ void readerAttack(nonces_t ar_resp[], bool setEmulatorMem, bool doStandardAttack
 					, sectorNum
 					, key
 				);
+				mfSessionKeyAdd(key);
 
 				for (uint8_t ii = 0; ii<ATTACK_KEY_COUNT; ii++) {
 					if (key_cnt[ii]==0 || stSector[ii]==sectorNum) {
@@ -1475,6 +1579,7 @@ int usage_hf14_mfsim(void) {
 	PrintAndLog("      u    (Optional) UID 4 or 7 bytes. If not specified, the UID 4B from emulator memory will be used");
 	PrintAndLog("      n    (Optional) Automatically exit simulation after <numreads> blocks have been read by reader. 0 = infinite");
 	PrintAndLog("      i    (Optional) Interactive, means that console will not be returned until simulation finishes or is aborted");
+	PrintAndLog("      l    (Optional) Load the emulator memory from the device flash store first (see 'hw flashstore')");
 	PrintAndLog("      x    (Optional) Crack, performs the 'reader attack', nr/ar attack against a legitimate reader, fishes out the key(s)");
 	PrintAndLog("      e    (Optional) set keys found from 'reader attack' to emulator memory (implies x and i)");
 	PrintAndLog("      f    (Optional) get UIDs to use for 'reader attack' from file 'f <filename.txt>' (implies x and i)");
@@ -1549,6 +1654,11 @@ int CmdHF14AMfSim(const char *Cmd) {
 			flags |= FLAG_INTERACTIVE;
 			cmdp++;
 			break;
+		case 'l':
+		case 'L':
+			flags |= FLAG_EML_FROM_FLASH;
+			cmdp++;
+			break;
 		case 'n':
 		case 'N':
 			exitAfterNReads = param_get8(Cmd, cmdp+1);
@@ -1693,6 +1803,76 @@ int CmdHF14AMfSim(const char *Cmd) {
 	return 0;
 }
 
+int CmdHF14AMfSimHooks(const char *Cmd) {
+	char ctmp = param_getchar(Cmd, 0);
+	if (ctmp == 'h' || ctmp == 'H' || ctmp == 0x00) {
+		PrintAndLog("Load a scripted deviation into the emulator behavior table, for");
+		PrintAndLog("probing reader error handling. 'hf mf sim' evaluates the table at");
+		PrintAndLog("full field rate; each call appends one entry (max %d).", MFSIM_MAX_HOOKS);
+		PrintAndLog("Usage:  hf mf simhooks c");
+		PrintAndLog("        hf mf simhooks <cmd> <action> [resp hex|-] [afterN] [delay us]");
+		PrintAndLog("c        - clear the table");
+		PrintAndLog("<cmd>    - reader command byte to match, e.g. 30 for read block");
+		PrintAndLog("<action> - s = stay silent, n = nack, a = ack, r = canned response,");
+		PrintAndLog("           p = pass through unchanged (with the delay applied)");
+		PrintAndLog("[resp]   - up to 18 bytes hex for action r (CRC included), '-' otherwise");
+		PrintAndLog("[afterN] - deviate only after N matching frames, default 0 = always");
+		PrintAndLog("[delay]  - stall this many microseconds before acting, default 0");
+		PrintAndLog("sample: hf mf simhooks 30 n - 5 200   -- delayed nack from the 6th read");
+		PrintAndLog("sample: hf mf simhooks 30 r 00112233  -- truncated read response");
+		return 0;
+	}
+
+	UsbCommand c = {CMD_MIFARE_SIM_HOOKS, {0, 0, 0}};
+	UsbCommand resp;
+	if (ctmp == 'c' || ctmp == 'C') {
+		clearCommandBuffer();
+		SendCommand(&c);
+		if (WaitForResponseTimeout(CMD_ACK, &resp, 1500))
+			PrintAndLog("behavior table cleared");
+		return 0;
+	}
+
+	mfsim_hook_t hook;
+	memset(&hook, 0, sizeof(hook));
+	hook.cmd = param_get8ex(Cmd, 0, 0, 16);
+	switch (tolower(param_getchar(Cmd, 1))) {
+		case 's': hook.action = MFSIM_HOOK_SILENT; break;
+		case 'n': hook.action = MFSIM_HOOK_NACK; break;
+		case 'a': hook.action = MFSIM_HOOK_ACK; break;
+		case 'r': hook.action = MFSIM_HOOK_RESPONSE; break;
+		case 'p': hook.action = MFSIM_HOOK_PASS; break;
+		default:
+			PrintAndLog("unknown action, expected s, n, a, r or p");
+			return 1;
+	}
+	if (hook.action == MFSIM_HOOK_RESPONSE) {
+		int hexcnt = 0;
+		param_gethex_ex(Cmd, 2, hook.resp, &hexcnt);
+		if (hexcnt < 2 || hexcnt / 2 > (int)sizeof(hook.resp)) {
+			PrintAndLog("action r needs 1 to %zu response bytes of hex", sizeof(hook.resp));
+			return 1;
+		}
+		hook.resp_len = hexcnt / 2;
+	}
+	hook.after_n = param_get32ex(Cmd, 3, 0, 10);
+	hook.delay_us = param_get32ex(Cmd, 4, 0, 10);
+
+	c.arg[0] = 1;
+	memcpy(c.d.asBytes, &hook, sizeof(hook));
+	clearCommandBuffer();
+	SendCommand(&c);
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500)) {
+		PrintAndLog("command timeout");
+		return 1;
+	}
+	if (resp.arg[0] == MFSIM_MAX_HOOKS)
+		PrintAndLog("behavior table holds %" PRIu64 " entries (table full)", (uint64_t)resp.arg[0]);
+	else
+		PrintAndLog("behavior table holds %" PRIu64 " entries", (uint64_t)resp.arg[0]);
+	return 0;
+}
+
 int CmdHF14AMfDbg(const char *Cmd)
 {
 	int dbgMode = param_get32ex(Cmd, 0, 0, 10);
@@ -1717,6 +1897,41 @@ int CmdHF14AMfDbg(const char *Cmd)
 	return 0;
 }
 
+int CmdHF14AMfStats(const char *Cmd)
+{
+	char cmdp = param_getchar(Cmd, 0);
+	if (cmdp == 'h' || cmdp == 'H') {
+		PrintAndLog("Print the communication statistics the device accumulated across mifare commands.");
+		PrintAndLog("A clean run shows only auth attempts; timeouts, CRC errors and retransmissions");
+		PrintAndLog("point at a marginal field rather than a slow protocol.");
+		PrintAndLog("Usage:  hf mf stats [r]");
+		PrintAndLog(" r - reset the counters after printing");
+		return 0;
+	}
+	bool reset = (cmdp == 'r' || cmdp == 'R');
+
+	UsbCommand c = {CMD_MIFARE_COMM_STATS, {reset, 0, 0}};
+	SendCommand(&c);
+
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500)) {
+		PrintAndLog("Command execute timeout");
+		return 1;
+	}
+
+	uint32_t stats[5];
+	memcpy(stats, resp.d.asBytes, sizeof(stats));
+	PrintAndLog("auth attempts.....: %u", stats[0]);
+	PrintAndLog("auth failures.....: %u", stats[1]);
+	PrintAndLog("CRC errors........: %u", stats[2]);
+	PrintAndLog("timeouts..........: %u", stats[3]);
+	PrintAndLog("retransmissions...: %u", stats[4]);
+	if (reset)
+		PrintAndLog("counters reset");
+
+	return 0;
+}
+
 int CmdHF14AMfEGet(const char *Cmd)
 {
 	uint8_t blockNo = 0;
@@ -1754,6 +1969,57 @@ int CmdHF14AMfEClear(const char *Cmd)
 }
 
 
+// store/restore the emulator memory as a persona slot. Slots are
+// copy-on-write deltas against the first stored image, kept on the device,
+// so switching card identities is a local memcpy instead of a re-upload.
+int CmdHF14AMfEPersona(const char *Cmd)
+{
+	char op = param_getchar(Cmd, 0);
+	uint64_t mode;
+
+	switch (op) {
+		case 's':
+		case 'S': mode = 0; break;
+		case 'r':
+		case 'R': mode = 1; break;
+		case 'i':
+		case 'I': mode = 2; break;
+		default:
+			PrintAndLog("Usage:  hf mf epersona <s|r|i> [slot]");
+			PrintAndLog("  s <slot> : store current emulator memory into persona slot (0..%d)", EM_PERSONA_SLOTS - 1);
+			PrintAndLog("  r <slot> : restore persona slot into emulator memory");
+			PrintAndLog("  i        : slot status (printed on the device debug output)");
+			PrintAndLog("Slots are stored as copy-on-write deltas against the first stored image;");
+			PrintAndLog("restoring is instant and does not need a re-upload.");
+			PrintAndLog(" sample: hf mf epersona s 0");
+			return 0;
+	}
+
+	uint8_t slot = param_get8(Cmd, 1);
+
+	UsbCommand c = {CMD_MIFARE_EML_PERSONA, {mode, slot, 0}};
+	SendCommand(&c);
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500)) {
+		PrintAndLog("Command execute timeout");
+		return 1;
+	}
+	if (mode == 2) return 0;
+
+	if (resp.arg[0]) {
+		PrintAndLog("Persona slot %d %s", slot, mode ? "restored" : "stored");
+		return 0;
+	}
+	switch (resp.arg[1]) {
+		case 1: PrintAndLog("Invalid slot (0..%d)", EM_PERSONA_SLOTS - 1); break;
+		case 2: PrintAndLog(mode ? "Slot is empty" : "Out of BigBuf memory for persona storage"); break;
+		case 3: PrintAndLog("Delta page pool exhausted - personas differ too much from the base image"); break;
+		default: PrintAndLog("Failed (%d)", (int)resp.arg[1]); break;
+	}
+	return 1;
+}
+
+
 int CmdHF14AMfESet(const char *Cmd)
 {
 	uint8_t memBlock[16];
@@ -1781,19 +2047,18 @@ int CmdHF14AMfESet(const char *Cmd)
 
 int CmdHF14AMfELoad(const char *Cmd)
 {
-	FILE * f;
 	char filename[FILE_PATH_SIZE];
-	char *fnameptr = filename;
-	char buf[64] = {0x00};
-	uint8_t buf8[64] = {0x00};
-	int i, len, blockNum, numBlocks;
+	uint8_t image[256 * 16];
+	size_t bytes = 0;
+	int blockNum, numBlocks;
 	int nameParamNo = 1;
 
 	char ctmp = param_getchar(Cmd, 0);
 
 	if ( ctmp == 'h' || ctmp == 0x00) {
-		PrintAndLog("It loads emul dump from the file `filename.eml`");
-		PrintAndLog("Usage:  hf mf eload [card memory] <file name w/o `.eml`>");
+		PrintAndLog("It loads emul dump from the file `filename` (eml, json or bin,");
+		PrintAndLog("detected from the content; the suffix may be left out)");
+		PrintAndLog("Usage:  hf mf eload [card memory] <file name>");
 		PrintAndLog("  [card memory]: 0 = 320 bytes (Mifare Mini), 1 = 1K (default), 2 = 2K, 4 = 4K");
 		PrintAndLog("");
 		PrintAndLog(" sample: hf mf eload filename");
@@ -1813,58 +2078,19 @@ int CmdHF14AMfELoad(const char *Cmd)
 		}
 	}
 
-	len = param_getstr(Cmd, nameParamNo, filename, sizeof(filename));
-
-	if (len > FILE_PATH_SIZE - 5) len = FILE_PATH_SIZE - 5;
-
-	fnameptr += len;
-
-	sprintf(fnameptr, ".eml");
-
-	// open file
-	f = fopen(filename, "r");
-	if (f == NULL) {
-		PrintAndLog("File %s not found or locked", filename);
-		return 1;
-	}
-
-	blockNum = 0;
-	while(!feof(f)){
-		memset(buf, 0, sizeof(buf));
-
-		if (fgets(buf, sizeof(buf), f) == NULL) {
-
-			if (blockNum >= numBlocks) break;
-
-			PrintAndLog("File reading error.");
-			fclose(f);
-			return 2;
-		}
-
-		if (strlen(buf) < 32){
-			if(strlen(buf) && feof(f))
-				break;
-			PrintAndLog("File content error. Block data must include 32 HEX symbols");
-			fclose(f);
-			return 2;
-		}
+	param_getstr(Cmd, nameParamNo, filename, sizeof(filename));
 
-		for (i = 0; i < 32; i += 2) {
-			sscanf(&buf[i], "%02x", (unsigned int *)&buf8[i / 2]);
-		}
+	if (loadFileDump(filename, image, sizeof(image), &bytes))
+		return 2;
 
-		if (mfEmlSetMem(buf8, blockNum, 1)) {
-			PrintAndLog("Cant set emul block: %3d", blockNum);
-			fclose(f);
-			return 3;
-		}
-		printf(".");
-		blockNum++;
+	blockNum = bytes / 16;
+	if (blockNum > numBlocks) blockNum = numBlocks;	// bigger dumps load up to the card memory
 
-		if (blockNum >= numBlocks) break;
+	// diff-sync against the device; falls back to a full stream upload
+	if (mfEmlSyncMem(image, blockNum * 16)) {
+		PrintAndLog("Cant upload emul image");
+		return 3;
 	}
-	fclose(f);
-	printf("\n");
 
 	if ((blockNum != numBlocks)) {
 		PrintAndLog("File content error. Got %d must be %d blocks.",blockNum, numBlocks);
@@ -1943,15 +2169,29 @@ int CmdHF14AMfESave(const char *Cmd)
 		return 1;
 	}
 
-	// put hex
-	for (i = 0; i < numBlocks; i++) {
-		if (mfEmlGetMem(buf, i, 1)) {
+	// put hex: fetch a full USB frame worth of blocks per round trip and
+	// convert through a scratch line instead of one fprintf per byte
+	uint8_t dump[USB_CMD_DATA_SIZE];
+	char line[33];
+	const char *hextab = "0123456789ABCDEF";
+	i = 0;
+	while (i < numBlocks) {
+		int chunk = numBlocks - i;
+		if (chunk > USB_CMD_DATA_SIZE / 16) chunk = USB_CMD_DATA_SIZE / 16;
+		if (mfEmlGetMem(dump, i, chunk)) {
 			PrintAndLog("Cant get block: %d", i);
 			break;
 		}
-		for (j = 0; j < 16; j++)
-			fprintf(f, "%02X", buf[j]);
-		fprintf(f,"\n");
+		for (j = 0; j < chunk; j++) {
+			uint8_t *blk = dump + j * 16;
+			for (int k = 0; k < 16; k++) {
+				line[k * 2] = hextab[blk[k] >> 4];
+				line[k * 2 + 1] = hextab[blk[k] & 0x0f];
+			}
+			line[32] = '\n';
+			fwrite(line, 1, sizeof(line), f);
+		}
+		i += chunk;
 	}
 	fclose(f);
 
@@ -2260,18 +2500,16 @@ int CmdHF14AMfCSetBlk(const char *Cmd)
 
 int CmdHF14AMfCLoad(const char *Cmd)
 {
-	FILE * f;
 	char filename[FILE_PATH_SIZE] = {0x00};
-	char * fnameptr = filename;
-	char buf[256] = {0x00};
 	uint8_t buf8[256] = {0x00};
 	uint8_t fillFromEmulator = 0;
-	int i, len, blockNum, flags = 0, gen = 0, numblock = 64;
+	int blockNum, flags = 0, gen = 0, numblock = 64;
 
 	if (param_getchar(Cmd, 0) == 'h' || param_getchar(Cmd, 0)== 0x00) {
-		PrintAndLog("It loads magic Chinese card from the file `filename.eml`");
+		PrintAndLog("It loads magic Chinese card from the file `filename`");
+		PrintAndLog("(eml, json or bin, detected from the content)");
 		PrintAndLog("or from emulator memory (option `e`). 4K card: (option `4`)");
-		PrintAndLog("Usage:  hf mf cload [file name w/o `.eml`][e][4]");
+		PrintAndLog("Usage:  hf mf cload [file name][e][4]");
 		PrintAndLog("   or:  hf mf cload e [4]");
 		PrintAndLog("Sample: hf mf cload filename");
 		PrintAndLog("        hf mf cload filname 4");
@@ -2308,43 +2546,21 @@ int CmdHF14AMfCLoad(const char *Cmd)
 		}
 		return 0;
 	} else {
-		param_getstr(Cmd, 0, filename, sizeof(filename));
+		static uint8_t dump[256 * 16];
+		size_t bytes = 0;
 
-		len = strlen(filename);
-		if (len > FILE_PATH_SIZE - 5) len = FILE_PATH_SIZE - 5;
-
-		//memcpy(filename, Cmd, len);
-		fnameptr += len;
+		param_getstr(Cmd, 0, filename, sizeof(filename));
 
-		sprintf(fnameptr, ".eml");
+		if (loadFileDump(filename, dump, sizeof(dump), &bytes))
+			return 2;
 
-		// open file
-		f = fopen(filename, "r");
-		if (f == NULL) {
-			PrintAndLog("File not found or locked.");
-			return 1;
+		if ((int)(bytes / 16) < numblock) {
+			PrintAndLog("File content error. There must be %d blocks", numblock);
+			return 4;
 		}
 
-		blockNum = 0;
-		while(!feof(f)){
-
-			memset(buf, 0, sizeof(buf));
-
-			if (fgets(buf, sizeof(buf), f) == NULL) {
-				fclose(f);
-				PrintAndLog("File reading error.");
-				return 2;
-			}
-
-			if (strlen(buf) < 32) {
-				if(strlen(buf) && feof(f))
-					break;
-				PrintAndLog("File content error. Block data must include 32 HEX symbols");
-				fclose(f);
-				return 2;
-			}
-			for (i = 0; i < 32; i += 2)
-				sscanf(&buf[i], "%02x", (unsigned int *)&buf8[i / 2]);
+		for (blockNum = 0; blockNum < numblock; blockNum++) {
+			memcpy(buf8, dump + blockNum * 16, 16);
 
 			if (blockNum == 0) flags = CSETBLOCK_INIT_FIELD + CSETBLOCK_WUPC;               // switch on field and send magic sequence
 			if (blockNum == 1) flags = 0;                                                   // just write
@@ -2355,19 +2571,8 @@ int CmdHF14AMfCLoad(const char *Cmd)
 				flags |= CSETBLOCK_MAGIC_1B;
 			if (mfCSetBlock(blockNum, buf8, NULL, 0, flags)) {
 				PrintAndLog("Can't set magic card block: %d", blockNum);
-				fclose(f);
 				return 3;
 			}
-			blockNum++;
-
-			if (blockNum >= numblock) break;  // magic card type - mifare 1K 64 blocks, mifare 4k 256 blocks
-		}
-		fclose(f);
-
-		//if (blockNum != 16 * 4 && blockNum != 32 * 4 + 8 * 16){
-		if (blockNum != numblock){
-			PrintAndLog("File content error. There must be %d blocks", numblock);
-			return 4;
 		}
 		PrintAndLog("Loaded from file: %s", filename);
 		return 0;
@@ -2790,13 +2995,17 @@ int CmdHF14AMfAuth4(const char *cmd) {
 		"Usage:\n\thf mf auth4 4000 000102030405060708090a0b0c0d0e0f -> executes authentication\n"
 			"\thf mf auth4 9003 FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF -> executes authentication\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_str1(NULL,  NULL,     "<Key Num (HEX 2 bytes)>", NULL),
-		arg_str1(NULL,  NULL,     "<Key Value (HEX 16 bytes)>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_str1(NULL,  NULL,     "<Key Num (HEX 2 bytes)>", NULL),
+			arg_str1(NULL,  NULL,     "<Key Value (HEX 16 bytes)>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	CLIGetHexWithReturn(1, keyn, &keynlen);
 	CLIGetHexWithReturn(2, key, &keylen);
@@ -2823,15 +3032,19 @@ int CmdHF14AMfMAD(const char *cmd) {
 				  "Usage:\n\thf mf mad -> shows MAD if exists\n"
 				  "\thf mf mad -a 03e1 -k ffffffffffff -b -> shows NDEF data if exists. read card with custom key and key B\n");
 
-	void *argtable[] = {
-		arg_param_begin,
-		arg_lit0("vV",  "verbose",  "show technical data"),
-		arg_str0("aA",  "aid",      "print all sectors with aid", NULL),
-		arg_str0("kK",  "key",      "key for printing sectors", NULL),
-		arg_lit0("bB",  "keyb",     "use key B for access printing sectors (by default: key A)"),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("vV",  "verbose",  "show technical data"),
+			arg_str0("aA",  "aid",      "print all sectors with aid", NULL),
+			arg_str0("kK",  "key",      "key for printing sectors", NULL),
+			arg_lit0("bB",  "keyb",     "use key B for access printing sectors (by default: key A)"),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 	bool verbose = arg_get_lit(1);
 	uint8_t aid[2] = {0};
 	int aidlen;
@@ -2913,15 +3126,19 @@ int CmdHFMFNDEF(const char *cmd) {
 				  "Usage:\n\thf mf ndef -> shows NDEF data\n"
 				  "\thf mf ndef -a 03e1 -k ffffffffffff -b -> shows NDEF data with custom AID, key and with key B\n");
 
-	void *argtable[] = {
-		arg_param_begin,
-		arg_litn("vV",  "verbose",  0, 2, "show technical data"),
-		arg_str0("aA",  "aid",      "replace default aid for NDEF", NULL),
-		arg_str0("kK",  "key",      "replace default key for NDEF", NULL),
-		arg_lit0("bB",  "keyb",     "use key B for access sectors (by default: key A)"),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_litn("vV",  "verbose",  0, 2, "show technical data"),
+			arg_str0("aA",  "aid",      "replace default aid for NDEF", NULL),
+			arg_str0("kK",  "key",      "replace default key for NDEF", NULL),
+			arg_lit0("bB",  "keyb",     "use key B for access sectors (by default: key A)"),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	bool verbose = arg_get_lit(1);
 	bool verbose2 = arg_get_lit(1) > 1;
@@ -3020,14 +3237,18 @@ int CmdHFMFPersonalize(const char *cmd) {
 				  "\thf mf personalize UIDF3                        -> single size NUID according to ISO/IEC14443-3\n"
 				  "\thf mf personalize -t B -k B0B1B2B3B4B5 UIDF3   -> use key B = 0xB0B1B2B3B4B5 instead of default key A\n");
 
-	void *argtable[] = {
-		arg_param_begin,
-		arg_str0("tT",  "keytype", "<A|B>",                     "key type (A or B) to authenticate sector 0 (default: A)"),
-		arg_str0("kK",  "key",     "<key (hex 6 Bytes)>",       "key to authenticate sector 0 (default: FFFFFFFFFFFF)"),
-		arg_str1(NULL,  NULL,      "<UIDF0|UIDF1|UIDF2|UIDF3>", "Personalization Option"),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_str0("tT",  "keytype", "<A|B>",                     "key type (A or B) to authenticate sector 0 (default: A)"),
+			arg_str0("kK",  "key",     "<key (hex 6 Bytes)>",       "key to authenticate sector 0 (default: FFFFFFFFFFFF)"),
+			arg_str1(NULL,  NULL,      "<UIDF0|UIDF1|UIDF2|UIDF3>", "Personalization Option"),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	char keytypestr[2] = "A";
 	uint8_t keytype = 0x00;
@@ -3092,6 +3313,7 @@ int CmdHFMFPersonalize(const char *cmd) {
 static command_t CommandTable[] = {
 	{"help",             CmdHelp,                 1, "This help"},
 	{"dbg",              CmdHF14AMfDbg,           0, "Set default debug mode"},
+	{"stats",            CmdHF14AMfStats,         0, "Print device-side communication statistics"},
 	{"rdbl",             CmdHF14AMfRdBl,          0, "Read MIFARE classic block"},
 	{"rdsc",             CmdHF14AMfRdSc,          0, "Read MIFARE classic sector"},
 	{"dump",             CmdHF14AMfDump,          0, "Dump MIFARE classic tag to binary file"},
@@ -3099,11 +3321,13 @@ static command_t CommandTable[] = {
 	{"wrbl",             CmdHF14AMfWrBl,          0, "Write MIFARE classic block"},
 	{"auth4",            CmdHF14AMfAuth4,         0, "ISO14443-4 AES authentication"},
 	{"chk",              CmdHF14AMfChk,           0, "Test block keys"},
+	{"dicimport",        CmdHF14AMfDictImport,    1, "Convert a text key dictionary to the binary indexed format"},
 	{"mifare",           CmdHF14AMifare,          0, "Read parity error messages."},
 	{"hardnested",       CmdHF14AMfNestedHard,    0, "Nested attack for hardened Mifare cards"},
 	{"nested",           CmdHF14AMfNested,        0, "Test nested authentication"},
 	{"sniff",            CmdHF14AMfSniff,         0, "Sniff card-reader communication"},
 	{"sim",              CmdHF14AMfSim,           0, "Simulate MIFARE card"},
+	{"simhooks",         CmdHF14AMfSimHooks,      0, "Load scripted behavior deviations for the simulator"},
 	{"eclr",             CmdHF14AMfEClear,        0, "Clear simulator memory"},
 	{"eget",             CmdHF14AMfEGet,          0, "Get simulator memory block"},
 	{"eset",             CmdHF14AMfESet,          0, "Set simulator memory block"},
@@ -3111,6 +3335,7 @@ static command_t CommandTable[] = {
 	{"esave",            CmdHF14AMfESave,         0, "Save to file emul dump"},
 	{"ecfill",           CmdHF14AMfECFill,        0, "Fill simulator memory with help of keys from simulator"},
 	{"ekeyprn",          CmdHF14AMfEKeyPrn,       0, "Print keys from simulator memory"},
+	{"epersona",         CmdHF14AMfEPersona,      0, "Store/restore simulator memory as copy-on-write persona slots"},
 	{"cwipe",            CmdHF14AMfCWipe,         0, "Wipe magic Chinese card"},
 	{"csetuid",          CmdHF14AMfCSetUID,       0, "Set UID for magic Chinese card"},
 	{"csetblk",          CmdHF14AMfCSetBlk,       0, "Write block - Magic Chinese card"},
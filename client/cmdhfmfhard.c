@@ -18,6 +18,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <inttypes.h>
 #include <string.h>
 #include <time.h>
@@ -35,9 +36,12 @@
 #include "hardnested/hardnested_bruteforce.h"
 #include "hardnested/hardnested_bf_core.h"
 #include "hardnested/hardnested_bitarray_core.h"
+#include "mifare/keydb.h"
+#include "mifare/mifare4.h"
+#include "cmdhflist.h"
+#include "workqueue.h"
 #include "zlib.h"
 
-#define NUM_CHECK_BITFLIPS_THREADS		(num_CPUs())
 #define NUM_REDUCTION_WORKING_THREADS	(num_CPUs())
 
 #define IGNORE_BITFLIP_THRESHOLD		0.99	// ignore bitflip arrays which have nearly only valid states
@@ -210,6 +214,156 @@ static int compare_count_bitflip_bitarrays(const void *b1, const void *b2)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// mmap()able bitflip table cache
+//
+// Inflating all the bitflip_0_*.bin.z tables takes seconds and costs hundreds
+// of MB of anonymous memory per process. On first use we write the inflated
+// tables into a single page-aligned cache file next to them; later runs (and
+// concurrent hardnested jobs) map it read-only, so startup is near-instant
+// and the kernel page cache keeps one shared copy for all processes.
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define BITFLIP_CACHE_FILE   "bitflip_cached_states.bin"
+#define BITFLIP_CACHE_MAGIC  0x31636662  // "bfc1"
+#define BITFLIP_BITARRAY_SIZE (sizeof(uint32_t) * (1<<19))
+
+typedef struct {
+	uint32_t magic;
+	uint32_t num_entries;
+} bitflip_cache_header_t;
+
+typedef struct {
+	uint16_t bitflip;
+	uint16_t odd_even;
+	uint32_t count;
+	uint64_t offset;	// page-aligned file offset of the bitarray
+} bitflip_cache_entry_t;
+
+static void *bitflip_cache_base = MAP_FAILED;
+static size_t bitflip_cache_size = 0;
+
+static void bitflip_cache_file_path(char *path)
+{
+	strcpy(path, get_my_executable_directory());
+	strcat(path, STATE_FILES_DIRECTORY);
+	strcat(path, BITFLIP_CACHE_FILE);
+}
+
+
+static bool load_bitflip_cache(void)
+{
+	char path[strlen(get_my_executable_directory()) + strlen(STATE_FILES_DIRECTORY) + strlen(BITFLIP_CACHE_FILE) + 1];
+	bitflip_cache_file_path(path);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(bitflip_cache_header_t)) {
+		close(fd);
+		return false;
+	}
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+
+	bitflip_cache_header_t *header = (bitflip_cache_header_t *)base;
+	bitflip_cache_entry_t *entries = (bitflip_cache_entry_t *)(header + 1);
+	if (header->magic != BITFLIP_CACHE_MAGIC
+			|| header->num_entries > 2 * 0x400
+			|| sizeof(bitflip_cache_header_t) + header->num_entries * sizeof(bitflip_cache_entry_t) > (size_t)st.st_size) {
+		munmap(base, st.st_size);
+		return false;
+	}
+	for (uint32_t i = 0; i < header->num_entries; i++) {
+		if (entries[i].odd_even > ODD_STATE
+				|| entries[i].bitflip == 0 || entries[i].bitflip >= 0x400
+				|| entries[i].offset + BITFLIP_BITARRAY_SIZE > (uint64_t)st.st_size) {
+			munmap(base, st.st_size);
+			return false;
+		}
+	}
+
+	for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+		num_effective_bitflips[odd_even] = 0;
+		for (uint16_t bitflip = 0x001; bitflip < 0x400; bitflip++) {
+			bitflip_bitarrays[odd_even][bitflip] = NULL;
+			count_bitflip_bitarrays[odd_even][bitflip] = 1<<24;
+		}
+	}
+	for (uint32_t i = 0; i < header->num_entries; i++) {
+		bitflip_cache_entry_t *entry = entries + i;
+		bitflip_bitarrays[entry->odd_even][entry->bitflip] = (uint32_t *)((uint8_t *)base + entry->offset);
+		count_bitflip_bitarrays[entry->odd_even][entry->bitflip] = entry->count;
+		effective_bitflip[entry->odd_even][num_effective_bitflips[entry->odd_even]++] = entry->bitflip;
+	}
+	for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+		effective_bitflip[odd_even][num_effective_bitflips[odd_even]] = 0x400;	// EndOfList marker
+	}
+
+	bitflip_cache_base = base;
+	bitflip_cache_size = st.st_size;
+	return true;
+}
+
+
+static void write_bitflip_cache(void)
+{
+	char path[strlen(get_my_executable_directory()) + strlen(STATE_FILES_DIRECTORY) + strlen(BITFLIP_CACHE_FILE) + sizeof(".tmp")];
+	bitflip_cache_file_path(path);
+	char tmp_path[sizeof(path)];
+	strcpy(tmp_path, path);
+	strcat(tmp_path, ".tmp");
+
+	uint32_t num_entries = num_effective_bitflips[EVEN_STATE] + num_effective_bitflips[ODD_STATE];
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t header_size = sizeof(bitflip_cache_header_t) + num_entries * sizeof(bitflip_cache_entry_t);
+	// bitarrays start page-aligned right after the entry table
+	uint64_t offset = (header_size + page_size - 1) / page_size * page_size;
+
+	FILE *cachefile = fopen(tmp_path, "wb");
+	if (cachefile == NULL) {
+		return;	// the cache is an optimization only, never an error
+	}
+
+	bitflip_cache_header_t header = { BITFLIP_CACHE_MAGIC, num_entries };
+	bool ok = (fwrite(&header, sizeof(header), 1, cachefile) == 1);
+	for (odd_even_t odd_even = EVEN_STATE; ok && odd_even <= ODD_STATE; odd_even++) {
+		for (uint16_t i = 0; ok && i < num_effective_bitflips[odd_even]; i++) {
+			uint16_t bitflip = effective_bitflip[odd_even][i];
+			bitflip_cache_entry_t entry = { bitflip, odd_even, count_bitflip_bitarrays[odd_even][bitflip], offset };
+			ok = (fwrite(&entry, sizeof(entry), 1, cachefile) == 1);
+			offset += (BITFLIP_BITARRAY_SIZE + page_size - 1) / page_size * page_size;
+		}
+	}
+	offset = (header_size + page_size - 1) / page_size * page_size;
+	for (odd_even_t odd_even = EVEN_STATE; ok && odd_even <= ODD_STATE; odd_even++) {
+		for (uint16_t i = 0; ok && i < num_effective_bitflips[odd_even]; i++) {
+			uint16_t bitflip = effective_bitflip[odd_even][i];
+			ok = (fseek(cachefile, offset, SEEK_SET) == 0)
+				&& (fwrite(bitflip_bitarrays[odd_even][bitflip], BITFLIP_BITARRAY_SIZE, 1, cachefile) == 1);
+			offset += (BITFLIP_BITARRAY_SIZE + page_size - 1) / page_size * page_size;
+		}
+	}
+	fclose(cachefile);
+
+	// atomic rename so concurrent hardnested runs never see a partial cache
+	if (!ok || rename(tmp_path, path) != 0) {
+		unlink(tmp_path);
+	}
+}
+#endif // !_WIN32
+
+
 static voidpf inflate_malloc(voidpf opaque, uInt items, uInt size)
 {
 	return malloc(items*size);
@@ -251,10 +405,16 @@ static void init_bitflip_bitarrays(void)
 
 
 	z_stream compressed_stream;
-	
+
 	char state_files_path[strlen(get_my_executable_directory()) + strlen(STATE_FILES_DIRECTORY) + strlen(STATE_FILE_TEMPLATE) + 1];
 	char state_file_name[strlen(STATE_FILE_TEMPLATE)+1];
-	
+
+	bool cached = false;
+#ifndef _WIN32
+	cached = load_bitflip_cache();
+#endif
+
+	if (!cached)
 	for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
 		num_effective_bitflips[odd_even] = 0;
 		for (uint16_t bitflip = 0x001; bitflip < 0x400; bitflip++) {
@@ -310,6 +470,12 @@ static void init_bitflip_bitarrays(void)
 		effective_bitflip[odd_even][num_effective_bitflips[odd_even]] = 0x400;	// EndOfList marker
 	}
 
+#ifndef _WIN32
+	if (!cached) {
+		write_bitflip_cache();
+	}
+#endif
+
 	uint16_t i = 0;
 	uint16_t j = 0;
 	num_all_effective_bitflips = 0;
@@ -344,13 +510,23 @@ static void init_bitflip_bitarrays(void)
 	}
 #endif	
 	char progress_text[80];
-	sprintf(progress_text, "Using %d precalculated bitflip state tables", num_all_effective_bitflips);
+	sprintf(progress_text, "Using %d precalculated bitflip state tables%s", num_all_effective_bitflips, cached ? " (mmap'ed)" : "");
 	hardnested_print_progress(0, progress_text, (float)(1LL<<47), 0);
 }
 
 
 static void	free_bitflip_bitarrays(void)
 {
+#ifndef _WIN32
+	if (bitflip_cache_base != MAP_FAILED) {
+		// the bitarrays live in the mapped cache file, not on the heap
+		munmap(bitflip_cache_base, bitflip_cache_size);
+		bitflip_cache_base = MAP_FAILED;
+		bitflip_cache_size = 0;
+		memset(bitflip_bitarrays, 0, sizeof(bitflip_bitarrays));
+		return;
+	}
+#endif
 	for (int16_t bitflip = 0x3ff; bitflip > 0x000; bitflip--) {
 		free_bitarray(bitflip_bitarrays[ODD_STATE][bitflip]);
 	}
@@ -365,7 +541,137 @@ static void	free_bitflip_bitarrays(void)
 
 static uint32_t *part_sum_a0_bitarrays[2][NUM_PART_SUMS];
 static uint32_t *part_sum_a8_bitarrays[2][NUM_PART_SUMS];
-static uint32_t *sum_a0_bitarrays[2][NUM_SUMS];	
+static uint32_t *sum_a0_bitarrays[2][NUM_SUMS];
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// mmap()able sum property table cache
+//
+// The partial sum and Sum(a0) bitarrays are identical for every run but cost
+// seconds to derive from the filter function. Like the bitflip table cache
+// above they are written to a page-aligned file on first computation and
+// simply mapped on later runs. The mapping is private (copy-on-write)
+// because update_sum_bitarrays() reduces the partial sum bitarrays in place
+// during the attack; untouched pages stay shared between concurrent jobs and
+// the private copies vanish with the munmap() at the end of the run.
+
+#ifndef _WIN32
+
+#define SUM_CACHE_FILE			"sum_cached_states.bin"
+#define SUM_CACHE_MAGIC			0x31636d73	// "smc1"
+#define SUM_CACHE_NUM_TABLES	(2 * (2 * NUM_PART_SUMS + NUM_SUMS))
+
+typedef struct {
+	uint32_t magic;
+	uint32_t num_tables;
+} sum_cache_header_t;
+
+static void *sum_cache_base = MAP_FAILED;
+static size_t sum_cache_size = 0;
+
+// the fixed order of the tables in the cache file
+static void sum_cache_table_slots(uint32_t **slots[SUM_CACHE_NUM_TABLES])
+{
+	uint32_t n = 0;
+	for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+		for (uint16_t i = 0; i < NUM_PART_SUMS; i++) {
+			slots[n++] = &part_sum_a0_bitarrays[odd_even][i];
+		}
+	}
+	for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+		for (uint16_t i = 0; i < NUM_PART_SUMS; i++) {
+			slots[n++] = &part_sum_a8_bitarrays[odd_even][i];
+		}
+	}
+	for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+		for (uint16_t i = 0; i < NUM_SUMS; i++) {
+			slots[n++] = &sum_a0_bitarrays[odd_even][i];
+		}
+	}
+}
+
+
+static void sum_cache_file_path(char *path)
+{
+	strcpy(path, get_my_executable_directory());
+	strcat(path, STATE_FILES_DIRECTORY);
+	strcat(path, SUM_CACHE_FILE);
+}
+
+
+static bool load_sum_cache(void)
+{
+	char path[strlen(get_my_executable_directory()) + strlen(STATE_FILES_DIRECTORY) + strlen(SUM_CACHE_FILE) + 1];
+	sum_cache_file_path(path);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	uint64_t table_offset = (sizeof(sum_cache_header_t) + page_size - 1) / page_size * page_size;
+	struct stat st;
+	if (fstat(fd, &st) != 0
+			|| (uint64_t)st.st_size != table_offset + (uint64_t)SUM_CACHE_NUM_TABLES * BITFLIP_BITARRAY_SIZE) {
+		close(fd);
+		return false;
+	}
+	void *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+	sum_cache_header_t *header = (sum_cache_header_t *)base;
+	if (header->magic != SUM_CACHE_MAGIC || header->num_tables != SUM_CACHE_NUM_TABLES) {
+		munmap(base, st.st_size);
+		return false;
+	}
+
+	uint32_t **slots[SUM_CACHE_NUM_TABLES];
+	sum_cache_table_slots(slots);
+	for (uint32_t i = 0; i < SUM_CACHE_NUM_TABLES; i++) {
+		*slots[i] = (uint32_t *)((uint8_t *)base + table_offset + (uint64_t)i * BITFLIP_BITARRAY_SIZE);
+	}
+
+	sum_cache_base = base;
+	sum_cache_size = st.st_size;
+	return true;
+}
+
+
+static void write_sum_cache(void)
+{
+	char path[strlen(get_my_executable_directory()) + strlen(STATE_FILES_DIRECTORY) + strlen(SUM_CACHE_FILE) + sizeof(".tmp")];
+	sum_cache_file_path(path);
+	char tmp_path[sizeof(path)];
+	strcpy(tmp_path, path);
+	strcat(tmp_path, ".tmp");
+
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	uint64_t table_offset = (sizeof(sum_cache_header_t) + page_size - 1) / page_size * page_size;
+
+	FILE *cachefile = fopen(tmp_path, "wb");
+	if (cachefile == NULL) {
+		return;	// the cache is an optimization only, never an error
+	}
+
+	sum_cache_header_t header = { SUM_CACHE_MAGIC, SUM_CACHE_NUM_TABLES };
+	bool ok = (fwrite(&header, sizeof(header), 1, cachefile) == 1)
+			&& (fseek(cachefile, table_offset, SEEK_SET) == 0);
+	uint32_t **slots[SUM_CACHE_NUM_TABLES];
+	sum_cache_table_slots(slots);
+	for (uint32_t i = 0; ok && i < SUM_CACHE_NUM_TABLES; i++) {
+		ok = (fwrite(*slots[i], BITFLIP_BITARRAY_SIZE, 1, cachefile) == 1);
+	}
+	fclose(cachefile);
+
+	// atomic rename so concurrent hardnested runs never see a partial cache
+	if (!ok || rename(tmp_path, path) != 0) {
+		unlink(tmp_path);
+	}
+}
+#endif // !_WIN32
+
 
 static uint16_t PartialSumProperty(uint32_t state, odd_even_t odd_even)
 { 
@@ -393,6 +699,11 @@ static uint16_t PartialSumProperty(uint32_t state, odd_even_t odd_even)
 
 static void init_part_sum_bitarrays(void)
 {
+#ifndef _WIN32
+	if (load_sum_cache()) {
+		return;		// the init_sum_bitarrays() tables are part of the mapping as well
+	}
+#endif
 	for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
 		for (uint16_t part_sum_a0 = 0; part_sum_a0 < NUM_PART_SUMS; part_sum_a0++) {
 			part_sum_a0_bitarrays[odd_even][part_sum_a0] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1<<19));
@@ -435,8 +746,15 @@ static void init_part_sum_bitarrays(void)
 }
 
 
-static void free_part_sum_bitarrays(void) 
+static void free_part_sum_bitarrays(void)
 {
+#ifndef _WIN32
+	if (sum_cache_base != MAP_FAILED) {	// all sum property tables live in the cache mapping
+		munmap(sum_cache_base, sum_cache_size);
+		sum_cache_base = MAP_FAILED;
+		return;
+	}
+#endif
 	for (int16_t part_sum_a8 = (NUM_PART_SUMS-1); part_sum_a8 >= 0; part_sum_a8--) {
 		free_bitarray(part_sum_a8_bitarrays[ODD_STATE][part_sum_a8]);
 	}
@@ -454,6 +772,11 @@ static void free_part_sum_bitarrays(void)
 
 static void init_sum_bitarrays(void)
 {
+#ifndef _WIN32
+	if (sum_cache_base != MAP_FAILED) {
+		return;		// already set up by load_sum_cache()
+	}
+#endif
 	for (uint16_t sum_a0 = 0; sum_a0 < NUM_SUMS; sum_a0++) {
 		for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
 			sum_a0_bitarrays[odd_even][sum_a0] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1<<19));
@@ -479,11 +802,19 @@ static void init_sum_bitarrays(void)
 			// printf("sum_a0_bitarray[%s][%d] has %d states (%5.2f%%)\n", odd_even==EVEN_STATE?"even":"odd ", sums[sum_a0], count, (float)count/(1<<24)*100.0);
 		// }
 	// }
+#ifndef _WIN32
+	write_sum_cache();
+#endif
 }
 
 
 static void free_sum_bitarrays(void)
 {
+#ifndef _WIN32
+	if (sum_cache_base != MAP_FAILED) {
+		return;		// released together with the partial sum tables in free_part_sum_bitarrays()
+	}
+#endif
 	for (int8_t sum_a0 = NUM_SUMS-1; sum_a0 >= 0; sum_a0--) {
 		free_bitarray(sum_a0_bitarrays[ODD_STATE][sum_a0]);
 		free_bitarray(sum_a0_bitarrays[EVEN_STATE][sum_a0]);
@@ -520,6 +851,23 @@ static uint64_t sample_period = 0;
 static uint64_t num_keys_tested = 0;
 static statelist_t *candidates = NULL;
 
+// Compact prefilters for bitflips_match(). Candidate generation probes the
+// 2MByte states_bitarrays of all 256 first bytes in random order - a working
+// set far beyond any cache. Folding each group of 16 adjacent states into a
+// single bit gives a 128KByte summary per first byte and parity: a cleared
+// filter bit proves that no state of its group is possible and rejects the
+// candidate with a single cache line, a set bit falls through to the exact
+// test. The filters are rebuilt lazily whenever a states_bitarray shrinks;
+// a stale filter is merely a superset and therefore always safe.
+static uint32_t *states_prefilter[256][2];
+static bool states_prefilter_dirty[256][2];
+
+// Power-of-two word count covering all set bits of each states_bitarray.
+// Bitflip pruning only ever clears bits, so a cached value stays a safe upper
+// bound; it is re-measured whenever the statelist actually shrinks, and the
+// size-specialized AND kernels then skip the dead upper words entirely.
+static uint32_t states_trimmed_words[256][2];
+
 
 static int add_nonce(uint32_t nonce_enc, uint8_t par_enc) 
 {
@@ -595,6 +943,10 @@ static void init_nonce_memory(void)
 		nonces[i].num_states_bitarray[ODD_STATE] = 1 << 24;
 		nonces[i].all_bitflips_dirty[EVEN_STATE] = false;
 		nonces[i].all_bitflips_dirty[ODD_STATE] = false;
+		states_prefilter_dirty[i][EVEN_STATE] = true;
+		states_prefilter_dirty[i][ODD_STATE] = true;
+		states_trimmed_words[i][EVEN_STATE] = 1 << 19;
+		states_trimmed_words[i][ODD_STATE] = 1 << 19;
 	}
 	first_byte_num = 0;
 	first_byte_Sum = 0;
@@ -620,6 +972,10 @@ static void free_nonces_memory(void)
 	for (int i = 255; i >= 0; i--) {
 		free_bitarray(nonces[i].states_bitarray[ODD_STATE]);
 		free_bitarray(nonces[i].states_bitarray[EVEN_STATE]);
+		for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+			free(states_prefilter[i][odd_even]);
+			states_prefilter[i][odd_even] = NULL;
+		}
 	}
 }
 
@@ -839,7 +1195,9 @@ static void update_sum_bitarrays(odd_even_t odd_even)
 			bitarray_AND(part_sum_a8_bitarrays[odd_even][part_sum], all_bitflips_bitarray[odd_even]);
 		}
 		for (uint16_t i = 0; i < 256; i++) {
-			nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(nonces[i].states_bitarray[odd_even], all_bitflips_bitarray[odd_even]);
+			nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND_sized(nonces[i].states_bitarray[odd_even], all_bitflips_bitarray[odd_even], states_trimmed_words[i][odd_even]);
+			states_trimmed_words[i][odd_even] = bitarray_trimmed_wordcount(nonces[i].states_bitarray[odd_even]);
+			states_prefilter_dirty[i][odd_even] = true;
 		}
 		for (uint8_t part_sum_a0 = 0; part_sum_a0 < NUM_PART_SUMS; part_sum_a0++) {
 			for (uint8_t part_sum_a8 = 0; part_sum_a8 < NUM_PART_SUMS; part_sum_a8++) {
@@ -1158,13 +1516,13 @@ static bool timeout(void)
 }
 
 
-static void 
+static void
 #ifdef __has_attribute
 #if __has_attribute(force_align_arg_pointer)
-__attribute__((force_align_arg_pointer)) 
+__attribute__((force_align_arg_pointer))
 #endif
 #endif
-*check_for_BitFlipProperties_thread(void *args)
+check_for_BitFlipProperties_task(void *args)
 {
 	uint8_t first_byte = ((uint8_t *)args)[0];
 	uint8_t last_byte = ((uint8_t *)args)[1];
@@ -1175,10 +1533,10 @@ __attribute__((force_align_arg_pointer))
 		for (uint16_t bitflip_idx = 0; bitflip_idx < num_1st_byte_effective_bitflips; bitflip_idx++) {
 			uint16_t bitflip = all_effective_bitflip[bitflip_idx];
 			if (time_budget & timeout()) {
-#if defined (DEBUG_REDUCTION)				
+#if defined (DEBUG_REDUCTION)
 				printf("break at bitflip_idx %d...", bitflip_idx);
-#endif				
-				return NULL;
+#endif
+				return;
 			}
 			for (uint16_t i = first_byte; i <= last_byte; i++) {
 				if (nonces[i].BitFlips[bitflip] == 0 && nonces[i].BitFlips[bitflip ^ 0x100] == 0
@@ -1191,9 +1549,11 @@ __attribute__((force_align_arg_pointer))
 						for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
 							if (bitflip_bitarrays[odd_even][bitflip] != NULL) {
 								uint32_t old_count = nonces[i].num_states_bitarray[odd_even];
-								nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(nonces[i].states_bitarray[odd_even], bitflip_bitarrays[odd_even][bitflip]);
+								nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND_sized(nonces[i].states_bitarray[odd_even], bitflip_bitarrays[odd_even][bitflip], states_trimmed_words[i][odd_even]);
 								if (nonces[i].num_states_bitarray[odd_even] != old_count) {
 									nonces[i].all_bitflips_dirty[odd_even] = true;
+									states_prefilter_dirty[i][odd_even] = true;
+									states_trimmed_words[i][odd_even] = bitarray_trimmed_wordcount(nonces[i].states_bitarray[odd_even]);
 								}
 								// printf("bitflip: %d old: %d, new: %d ", bitflip, old_count, nonces[i].num_states_bitarray[odd_even]);
 							}
@@ -1214,7 +1574,7 @@ __attribute__((force_align_arg_pointer))
 #if defined (DEBUG_REDUCTION)
 				printf("break at bitflip_idx %d...", bitflip_idx);
 #endif
-				return NULL;
+				return;
 			}
 			for (uint16_t i = first_byte; i <= last_byte; i++) {
 				// Check for Bit Flip Property of 2nd bytes
@@ -1231,9 +1591,11 @@ __attribute__((force_align_arg_pointer))
 								for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
 									if (bitflip_bitarrays[odd_even][bitflip] != NULL) {
 										uint32_t old_count = nonces[i].num_states_bitarray[odd_even];
-										nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(nonces[i].states_bitarray[odd_even], bitflip_bitarrays[odd_even][bitflip]);
+										nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND_sized(nonces[i].states_bitarray[odd_even], bitflip_bitarrays[odd_even][bitflip], states_trimmed_words[i][odd_even]);
 										if (nonces[i].num_states_bitarray[odd_even] != old_count) {
 											nonces[i].all_bitflips_dirty[odd_even] = true;
+											states_prefilter_dirty[i][odd_even] = true;
+											states_trimmed_words[i][odd_even] = bitarray_trimmed_wordcount(nonces[i].states_bitarray[odd_even]);
 										}
 									}
 								}
@@ -1247,40 +1609,34 @@ __attribute__((force_align_arg_pointer))
 			}
 		}
 	}
-
-	return NULL;
 }
 
 
 static void check_for_BitFlipProperties(bool time_budget)
 {
-	// create and run worker threads
-	pthread_t thread_id[NUM_CHECK_BITFLIPS_THREADS];
-		
-	uint8_t args[NUM_CHECK_BITFLIPS_THREADS][3];
-	uint16_t bytes_per_thread = (256 + (NUM_CHECK_BITFLIPS_THREADS/2)) / NUM_CHECK_BITFLIPS_THREADS; 
-	for (uint8_t i = 0; i < NUM_CHECK_BITFLIPS_THREADS; i++) {
-		args[i][0] = i * bytes_per_thread;
-		args[i][1] = MIN(args[i][0]+bytes_per_thread-1, 255);
-		args[i][2] = time_budget;
-	}
-	args[NUM_CHECK_BITFLIPS_THREADS-1][1] = MAX(args[NUM_CHECK_BITFLIPS_THREADS-1][1], 255);
-	
-	// start threads
-	for (uint8_t i = 0; i < NUM_CHECK_BITFLIPS_THREADS; i++) {
-		pthread_create(&thread_id[i], NULL, check_for_BitFlipProperties_thread, args[i]);
-	}
-	
-	// wait for threads to terminate:
-	for (uint8_t i = 0; i < NUM_CHECK_BITFLIPS_THREADS; i++) {
-		pthread_join(thread_id[i], NULL);
+	// split the 256 first bytes into several small tasks per worker and hand
+	// them to the shared pool; byte ranges aren't equally expensive, so idle
+	// workers picking up the remaining tasks beats one fixed range per thread
+	uint16_t num_tasks = MIN(workqueue_num_workers() * 4, 256);
+	uint16_t bytes_per_task = (256 + (num_tasks/2)) / num_tasks;
+
+	uint8_t args[256][3];
+	uint16_t t = 0;
+	for (uint16_t first_byte = 0; first_byte < 256; first_byte += bytes_per_task, t++) {
+		args[t][0] = first_byte;
+		args[t][1] = MIN(first_byte+bytes_per_task-1, 255);
+		args[t][2] = time_budget;
+		workqueue_submit(check_for_BitFlipProperties_task, args[t]);
 	}
-	
+
+	// wait for all tasks to finish
+	workqueue_join();
+
 	if (hardnested_stage & CHECK_2ND_BYTES) {
 		hardnested_stage &= ~CHECK_1ST_BYTES;	// we are done with 1st stage, except...
-		for (uint16_t i = 0; i < NUM_CHECK_BITFLIPS_THREADS; i++) {
+		for (uint16_t i = 0; i < t; i++) {
 			if (args[i][1] != 0) {
-				hardnested_stage |= CHECK_1ST_BYTES;  // ... when any of the threads didn't complete in time
+				hardnested_stage |= CHECK_1ST_BYTES;  // ... when any of the tasks didn't complete in time
 				break;
 			}
 		}
@@ -1416,6 +1772,121 @@ static void simulate_acquire_nonces()
 }
 
 
+// Pipelined nonce analysis. The device is wall-clock-bound by card round
+// trips, so the USB loop in acquire_nonces() must never sit in
+// update_nonce_data()/shrink_key_space() while the device has a batch ready.
+// Received batches are queued here and consumed by a worker thread; the USB
+// loop requests the next batch immediately and switches the field off as
+// soon as the worker reports that the key space is small enough, instead of
+// one full batch round trip later.
+typedef struct nonce_batch {
+	struct nonce_batch *next;
+	uint16_t num_sampled_nonces;
+	uint8_t buf[USB_CMD_DATA_SIZE];
+} nonce_batch_t;
+
+static pthread_mutex_t batch_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_queue_cond = PTHREAD_COND_INITIALIZER;
+static nonce_batch_t *batch_queue_head = NULL;
+static nonce_batch_t *batch_queue_tail = NULL;
+static bool batch_queue_closed = false;			// no more batches will arrive
+static bool batch_analysis_completed = false;	// key space small enough, stop sampling
+
+static void enqueue_nonce_batch(uint16_t num_sampled_nonces, uint8_t *buf)
+{
+	nonce_batch_t *batch = malloc(sizeof(nonce_batch_t));
+	if (batch == NULL) return;
+	batch->next = NULL;
+	batch->num_sampled_nonces = num_sampled_nonces;
+	memcpy(batch->buf, buf, 9 * ((num_sampled_nonces + 1) / 2));
+	pthread_mutex_lock(&batch_queue_mutex);
+	if (batch_queue_tail == NULL) {
+		batch_queue_head = batch;
+	} else {
+		batch_queue_tail->next = batch;
+	}
+	batch_queue_tail = batch;
+	pthread_cond_signal(&batch_queue_cond);
+	pthread_mutex_unlock(&batch_queue_mutex);
+}
+
+static void close_nonce_batch_queue(void)
+{
+	pthread_mutex_lock(&batch_queue_mutex);
+	batch_queue_closed = true;
+	pthread_cond_signal(&batch_queue_cond);
+	pthread_mutex_unlock(&batch_queue_mutex);
+}
+
+static void* analyze_nonce_batches_thread(void *arg)
+{
+	bool reported_suma8 = false;
+	float brute_force;
+	(void)arg;
+
+	while (true) {
+		pthread_mutex_lock(&batch_queue_mutex);
+		while (batch_queue_head == NULL && !batch_queue_closed) {
+			pthread_cond_wait(&batch_queue_cond, &batch_queue_mutex);
+		}
+		nonce_batch_t *batch = batch_queue_head;
+		if (batch != NULL) {
+			batch_queue_head = batch->next;
+			if (batch_queue_head == NULL) batch_queue_tail = NULL;
+		}
+		pthread_mutex_unlock(&batch_queue_mutex);
+		if (batch == NULL) break;	// queue closed and drained
+
+		uint8_t *bufp = batch->buf;
+		for (uint16_t i = 0; i < batch->num_sampled_nonces; i+=2) {
+			uint32_t nt_enc1 = bytes_to_num(bufp, 4);
+			uint32_t nt_enc2 = bytes_to_num(bufp+4, 4);
+			uint8_t par_enc = bytes_to_num(bufp+8, 1);
+
+			num_acquired_nonces += add_nonce(nt_enc1, par_enc >> 4);
+			num_acquired_nonces += add_nonce(nt_enc2, par_enc & 0x0f);
+			bufp += 9;
+		}
+		free(batch);
+
+		bool acquisition_completed;
+		if (first_byte_num == 256 ) {
+			if (hardnested_stage == CHECK_1ST_BYTES) {
+				for (uint16_t i = 0; i < NUM_SUMS; i++) {
+					if (first_byte_Sum == sums[i]) {
+						first_byte_Sum = i;
+						break;
+					}
+				}
+				hardnested_stage |= CHECK_2ND_BYTES;
+				apply_sum_a0();
+			}
+			update_nonce_data(true);
+			acquisition_completed = shrink_key_space(&brute_force);
+			if (!reported_suma8) {
+				char progress_string[80];
+				sprintf(progress_string, "Apply Sum property. Sum(a0) = %d", sums[first_byte_Sum]);
+				hardnested_print_progress(num_acquired_nonces, progress_string, brute_force, 0);
+				reported_suma8 = true;
+			} else {
+				hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force, 0);
+			}
+		} else {
+			update_nonce_data(true);
+			acquisition_completed = shrink_key_space(&brute_force);
+			hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force, 0);
+		}
+
+		if (acquisition_completed) {
+			pthread_mutex_lock(&batch_queue_mutex);
+			batch_analysis_completed = true;
+			pthread_mutex_unlock(&batch_queue_mutex);
+			break;	// leave remaining batches to the cleanup in acquire_nonces
+		}
+	}
+	return NULL;
+}
+
 static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow)
 {
 	last_sample_clock = msclock();
@@ -1423,17 +1894,20 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
 	bool initialize = true;
 	bool field_off = false;
 	hardnested_stage = CHECK_1ST_BYTES;
-	bool acquisition_completed = false;
 	uint32_t flags = 0;
 	uint8_t write_buf[9];
 	uint32_t total_num_nonces = 0;
-	float brute_force;
-	bool reported_suma8 = false;
 	FILE *fnonces = NULL;
 	UsbCommand resp;
+	pthread_t analysis_thread;
+	int result = 0;
 
 	num_acquired_nonces = 0;
-	
+	batch_queue_head = batch_queue_tail = NULL;
+	batch_queue_closed = false;
+	batch_analysis_completed = false;
+	pthread_create(&analysis_thread, NULL, analyze_nonce_batches_thread, NULL);
+
 	clearCommandBuffer();
 
 	do {
@@ -1445,20 +1919,26 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
 		memcpy(c.d.asBytes, key, 6);
 
 		SendCommand(&c);
-		
+
 		if (field_off) break;
-		
-		if (initialize) {
-			if (!WaitForResponseTimeout(CMD_ACK, &resp, 3000)) return 1;
 
-			if (resp.arg[0]) return resp.arg[0];  // error during nested_hard
+		if (!WaitForResponseTimeout(CMD_ACK, &resp, 3000)) {
+			result = 1;
+			break;
+		}
+		if (resp.arg[0]) {
+			result = resp.arg[0];  // error during nested_hard
+			break;
+		}
 
+		if (initialize) {
 			cuid = resp.arg[1];
-			// PrintAndLog("Acquiring nonces for CUID 0x%08x", cuid); 
+			// PrintAndLog("Acquiring nonces for CUID 0x%08x", cuid);
 			if (nonce_file_write && fnonces == NULL) {
-				if ((fnonces = fopen("nonces.bin","wb")) == NULL) { 
+				if ((fnonces = fopen("nonces.bin","wb")) == NULL) {
 					PrintAndLog("Could not create file nonces.bin");
-					return 3;
+					result = 3;
+					break;
 				}
 				hardnested_print_progress(0, "Writing acquired nonces to binary file nonces.bin", (float)(1LL<<47), 0);
 				num_to_bytes(cuid, 4, write_buf);
@@ -1466,75 +1946,15 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
 				fwrite(&trgBlockNo, 1, 1, fnonces);
 				fwrite(&trgKeyType, 1, 1, fnonces);
 			}
-		}
-
-		if (!initialize) {
-			uint32_t nt_enc1, nt_enc2;
-			uint8_t par_enc;
+		} else {
+			// hand the batch to the analysis worker and immediately request
+			// the next one - the device keeps streaming while we analyze
 			uint16_t num_sampled_nonces = resp.arg[2];
-			uint8_t *bufp = resp.d.asBytes;
-			for (uint16_t i = 0; i < num_sampled_nonces; i+=2) {
-				nt_enc1 = bytes_to_num(bufp, 4);
-				nt_enc2 = bytes_to_num(bufp+4, 4);
-				par_enc = bytes_to_num(bufp+8, 1);
-				
-				//printf("Encrypted nonce: %08x, encrypted_parity: %02x\n", nt_enc1, par_enc >> 4);
-				num_acquired_nonces += add_nonce(nt_enc1, par_enc >> 4);
-				//printf("Encrypted nonce: %08x, encrypted_parity: %02x\n", nt_enc2, par_enc & 0x0f);
-				num_acquired_nonces += add_nonce(nt_enc2, par_enc & 0x0f);
-
-				if (nonce_file_write) {
-					fwrite(bufp, 1, 9, fnonces);
-				}
-				bufp += 9;
+			if (nonce_file_write) {
+				fwrite(resp.d.asBytes, 1, 9 * ((num_sampled_nonces + 1) / 2), fnonces);
 			}
+			enqueue_nonce_batch(num_sampled_nonces, resp.d.asBytes);
 			total_num_nonces += num_sampled_nonces;
-		
-			if (first_byte_num == 256 ) {
-				if (hardnested_stage == CHECK_1ST_BYTES) {
-					for (uint16_t i = 0; i < NUM_SUMS; i++) {
-						if (first_byte_Sum == sums[i]) {
-							first_byte_Sum = i;
-							break;
-						}
-					}
-					hardnested_stage |= CHECK_2ND_BYTES;
-					apply_sum_a0();
-				}
-				update_nonce_data(true);
-				acquisition_completed = shrink_key_space(&brute_force);
-				if (!reported_suma8) {
-					char progress_string[80];
-					sprintf(progress_string, "Apply Sum property. Sum(a0) = %d", sums[first_byte_Sum]);
-					hardnested_print_progress(num_acquired_nonces, progress_string, brute_force, 0);
-					reported_suma8 = true;
-				} else {
-					hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force, 0);
-				}
-			} else {
-				update_nonce_data(true);
-				acquisition_completed = shrink_key_space(&brute_force);
-				hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force, 0);
-			}
-		}
-		
-		if (acquisition_completed) {
-			field_off = true;	// switch off field with next SendCommand and then finish
-		}
-
-		if (!initialize) {
-			if (!WaitForResponseTimeout(CMD_ACK, &resp, 3000)) {
-				if (nonce_file_write) {
-					fclose(fnonces);
-				}
-				return 1;
-			}
-			if (resp.arg[0]) {
-				if (nonce_file_write) {
-					fclose(fnonces);
-				}
-				return resp.arg[0];  // error during nested_hard
-			}
 		}
 
 		initialize = false;
@@ -1544,18 +1964,35 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
 		}
 		last_sample_clock = msclock();
 
-	} while (!acquisition_completed || field_off);
+		// stop sampling as soon as the worker reports the key space is small
+		// enough; the next command switches the field off
+		pthread_mutex_lock(&batch_queue_mutex);
+		field_off = batch_analysis_completed;
+		pthread_mutex_unlock(&batch_queue_mutex);
+
+	} while (true);
 
-	if (nonce_file_write) {
+	close_nonce_batch_queue();
+	pthread_join(analysis_thread, NULL);
+
+	// free batches the worker left unconsumed after completion
+	while (batch_queue_head != NULL) {
+		nonce_batch_t *batch = batch_queue_head;
+		batch_queue_head = batch->next;
+		free(batch);
+	}
+	batch_queue_tail = NULL;
+
+	if (nonce_file_write && fnonces != NULL) {
 		fclose(fnonces);
 	}
-	
-	// PrintAndLog("Sampled a total of %d nonces in %d seconds (%0.0f nonces/minute)", 
-		// total_num_nonces, 
-		// time(NULL)-time1, 
+
+	// PrintAndLog("Sampled a total of %d nonces in %d seconds (%0.0f nonces/minute)",
+		// total_num_nonces,
+		// time(NULL)-time1,
 		// (float)total_num_nonces*60.0/(time(NULL)-time1));
-	
-	return 0;
+
+	return result;
 }
 
 
@@ -1630,6 +2067,108 @@ static struct sl_cache_entry {
 	} sl_cache[NUM_PART_SUMS][NUM_PART_SUMS][2];
 
 
+// Arena allocator for the candidates statelists. The lists are built once per
+// Sum(a8) guess and all die together after the brute force pass, so instead of
+// a worst case malloc() plus shrinking realloc() per list (4 MB each, with one
+// in flight per reduction thread) the final lists are carved out of large
+// shared chunks with a bump pointer and released in one go. The temporary
+// worst case buffers that bitarray_to_list() writes into are recycled through
+// a free list, so the hundreds of add_matching_states() calls reuse a handful
+// of buffers instead of churning the heap at that size.
+#define STATELIST_ARENA_CHUNK_WORDS		(1<<20)
+#define STATELIST_SCRATCH_WORDS			(1<<20)
+
+typedef struct statelist_arena_chunk {
+	struct statelist_arena_chunk *next;
+	uint32_t capacity;
+	uint32_t used;
+	uint32_t states[];
+} statelist_arena_chunk_t;
+
+typedef struct statelist_scratch_buf {
+	struct statelist_scratch_buf *next;
+	uint32_t states[STATELIST_SCRATCH_WORDS];
+} statelist_scratch_buf_t;
+
+static pthread_mutex_t statelist_arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+static statelist_arena_chunk_t *statelist_arena = NULL;
+static statelist_scratch_buf_t *statelist_scratch_freelist = NULL;
+static uint64_t statelist_arena_footprint = 0;	// bytes malloc'ed for chunks and scratch buffers
+
+
+static uint32_t *statelist_arena_alloc(uint32_t num_words)
+{
+	pthread_mutex_lock(&statelist_arena_mutex);
+	if (statelist_arena == NULL || statelist_arena->used + num_words > statelist_arena->capacity) {
+		uint32_t capacity = num_words > STATELIST_ARENA_CHUNK_WORDS ? num_words : STATELIST_ARENA_CHUNK_WORDS;
+		statelist_arena_chunk_t *chunk = malloc(sizeof(statelist_arena_chunk_t) + sizeof(uint32_t) * capacity);
+		if (chunk == NULL) {
+			pthread_mutex_unlock(&statelist_arena_mutex);
+			PrintAndLog("Out of memory error in statelist_arena_alloc()\n");
+			exit(4);
+		}
+		chunk->next = statelist_arena;
+		chunk->capacity = capacity;
+		chunk->used = 0;
+		statelist_arena = chunk;
+		statelist_arena_footprint += sizeof(statelist_arena_chunk_t) + sizeof(uint32_t) * capacity;
+	}
+	uint32_t *p = statelist_arena->states + statelist_arena->used;
+	statelist_arena->used += num_words;
+	pthread_mutex_unlock(&statelist_arena_mutex);
+	return p;
+}
+
+
+static void statelist_arena_free_all(void)
+{
+	pthread_mutex_lock(&statelist_arena_mutex);
+	while (statelist_arena != NULL) {
+		statelist_arena_chunk_t *chunk = statelist_arena;
+		statelist_arena = chunk->next;
+		free(chunk);
+	}
+	while (statelist_scratch_freelist != NULL) {
+		statelist_scratch_buf_t *scratch = statelist_scratch_freelist;
+		statelist_scratch_freelist = scratch->next;
+		free(scratch);
+	}
+	statelist_arena_footprint = 0;
+	pthread_mutex_unlock(&statelist_arena_mutex);
+}
+
+
+static uint32_t *statelist_scratch_acquire(void)
+{
+	pthread_mutex_lock(&statelist_arena_mutex);
+	statelist_scratch_buf_t *scratch = statelist_scratch_freelist;
+	if (scratch != NULL) {
+		statelist_scratch_freelist = scratch->next;
+	} else {
+		statelist_arena_footprint += sizeof(statelist_scratch_buf_t);
+	}
+	pthread_mutex_unlock(&statelist_arena_mutex);
+	if (scratch == NULL) {
+		scratch = malloc(sizeof(statelist_scratch_buf_t));
+		if (scratch == NULL) {
+			PrintAndLog("Out of memory error in statelist_scratch_acquire()\n");
+			exit(4);
+		}
+	}
+	return scratch->states;
+}
+
+
+static void statelist_scratch_release(uint32_t *states)
+{
+	statelist_scratch_buf_t *scratch = (statelist_scratch_buf_t *)((uint8_t *)states - offsetof(statelist_scratch_buf_t, states));
+	pthread_mutex_lock(&statelist_arena_mutex);
+	scratch->next = statelist_scratch_freelist;
+	statelist_scratch_freelist = scratch;
+	pthread_mutex_unlock(&statelist_arena_mutex);
+}
+
+
 static void init_statelist_cache(void)
 {
 	pthread_mutex_lock(&statelist_cache_mutex);
@@ -1652,11 +2191,49 @@ static void free_statelist_cache(void)
 	for (uint16_t i = 0; i < NUM_PART_SUMS; i++) {
 		for (uint16_t j = 0; j < NUM_PART_SUMS; j++) {
 			for (uint16_t k = 0; k < 2; k++) {
-				free(sl_cache[i][j][k].sl);
+				sl_cache[i][j][k].sl = NULL;	// owned by the statelist arena
 			}
 		}
-	}		
+	}
 	pthread_mutex_unlock(&statelist_cache_mutex);
+	statelist_arena_free_all();
+}
+
+
+static void build_states_prefilter(uint8_t byte, odd_even_t odd_even)
+{
+	uint32_t *filter = states_prefilter[byte][odd_even];
+	uint32_t *bitarray = nonces[byte].states_bitarray[odd_even];
+	if (filter == NULL) {
+		filter = (uint32_t *)malloc(sizeof(uint32_t) * (1<<15));
+		if (filter == NULL) {	// not fatal: without a filter we simply fall back to the exact test
+			return;
+		}
+		states_prefilter[byte][odd_even] = filter;
+	}
+	// each word of the bitarray holds two groups of 16 states
+	for (uint32_t i = 0; i < (1<<15); i++) {
+		uint32_t filter_word = 0;
+		for (uint32_t j = 0; j < 16; j++) {
+			uint32_t bitarray_word = bitarray[(i<<4)+j];
+			if (bitarray_word & 0x0000ffff) filter_word |= 1 << (2*j);
+			if (bitarray_word & 0xffff0000) filter_word |= 1 << (2*j+1);
+		}
+		filter[i] = filter_word;
+	}
+}
+
+
+static void update_states_prefilters(void)
+{
+	for (uint16_t i = 0; i < 256; i++) {
+		for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+			if (states_prefilter_dirty[i][odd_even]) {
+				build_states_prefilter(i, odd_even);
+				states_prefilter_dirty[i][odd_even] = false;
+			}
+		}
+	}
 }
 
 
@@ -1664,10 +2241,15 @@ static void free_statelist_cache(void)
 static inline bool bitflips_match(uint8_t byte, uint32_t state, odd_even_t odd_even, bool quiet)
 #else
 static inline bool bitflips_match(uint8_t byte, uint32_t state, odd_even_t odd_even)
-#endif	
+#endif
 {
-	uint32_t *bitset = nonces[byte].states_bitarray[odd_even];
-	bool possible = test_bit24(bitset, state);
+	bool possible;
+	uint32_t *filter = states_prefilter[byte][odd_even];
+	if (filter != NULL && !(filter[state >> 9] >> (state >> 4 & 0x1f) & 0x01)) {
+		possible = false;		// the whole group of 16 states is empty
+	} else {
+		possible = test_bit24(nonces[byte].states_bitarray[odd_even], state);
+	}
 	if (!possible) {
 #ifdef DEBUG_KEY_ELIMINATION
 		if (!quiet && known_target_key != -1 && state == test_state[odd_even]) {
@@ -1762,19 +2344,13 @@ static void add_cached_states(statelist_t *candidates, uint16_t part_sum_a0, uin
 
 static void add_matching_states(statelist_t *candidates, uint8_t part_sum_a0, uint8_t part_sum_a8, odd_even_t odd_even)
 {
-	uint32_t worstcase_size = 1<<20;
-	candidates->states[odd_even] = (uint32_t *)malloc(sizeof(uint32_t) * worstcase_size);
-	if (candidates->states[odd_even] == NULL) {
-		PrintAndLog("Out of memory error in add_matching_states() - statelist.\n");
-		exit(4);
-	}
+	uint32_t *scratch = statelist_scratch_acquire();
 	uint32_t *candidates_bitarray = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1<<19));
 	if (candidates_bitarray == NULL) {
 		PrintAndLog("Out of memory error in add_matching_states() - bitarray.\n");
-		free(candidates->states[odd_even]);
 		exit(4);
 	}
-	
+
 	uint32_t *bitarray_a0 = part_sum_a0_bitarrays[odd_even][part_sum_a0/2];
 	uint32_t *bitarray_a8 = part_sum_a8_bitarrays[odd_even][part_sum_a8/2];
 	uint32_t *bitarray_bitflips = nonces[best_first_bytes[0]].states_bitarray[odd_even];
@@ -1783,14 +2359,17 @@ static void add_matching_states(statelist_t *candidates, uint8_t part_sum_a0, ui
 		// candidates_bitarray[i] = bitarray_a0[i] & bitarray_a8[i] & bitarray_bitflips[i];
 	// }
 	bitarray_AND4(candidates_bitarray, bitarray_a0, bitarray_a8, bitarray_bitflips);
-	
-	bitarray_to_list(best_first_bytes[0], candidates_bitarray, candidates->states[odd_even], &(candidates->len[odd_even]), odd_even);
+
+	// build the list in the reusable scratch buffer, then move the exact sized
+	// result (including End Of List marker) into the arena
+	bitarray_to_list(best_first_bytes[0], candidates_bitarray, scratch, &(candidates->len[odd_even]), odd_even);
 	if (candidates->len[odd_even] == 0) {
-		free(candidates->states[odd_even]);
 		candidates->states[odd_even] = NULL;
-	} else if (candidates->len[odd_even] + 1 < worstcase_size) {
-		candidates->states[odd_even] = realloc(candidates->states[odd_even], sizeof(uint32_t) * (candidates->len[odd_even] + 1));
+	} else {
+		candidates->states[odd_even] = statelist_arena_alloc(candidates->len[odd_even] + 1);
+		memcpy(candidates->states[odd_even], scratch, sizeof(uint32_t) * (candidates->len[odd_even] + 1));
 	}
+	statelist_scratch_release(scratch);
 	free_bitarray(candidates_bitarray);
 
 
@@ -1832,16 +2411,27 @@ static void add_bitflip_candidates(uint8_t byte)
 
 	for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
 		uint32_t worstcase_size = nonces[byte].num_states_bitarray[odd_even] + 1;
-		candidates->states[odd_even] = (uint32_t *)malloc(sizeof(uint32_t) * worstcase_size);
-		if (candidates->states[odd_even] == NULL) {
-			PrintAndLog("Out of memory error in add_bitflip_candidates().\n");
-			exit(4);
+		uint32_t *scratch;
+		bool own_scratch = (worstcase_size > STATELIST_SCRATCH_WORDS);
+		if (own_scratch) {
+			scratch = (uint32_t *)malloc(sizeof(uint32_t) * worstcase_size);
+			if (scratch == NULL) {
+				PrintAndLog("Out of memory error in add_bitflip_candidates().\n");
+				exit(4);
+			}
+		} else {
+			scratch = statelist_scratch_acquire();
 		}
-	
-		bitarray_to_list(byte, nonces[byte].states_bitarray[odd_even], candidates->states[odd_even], &(candidates->len[odd_even]), odd_even);
 
-		if (candidates->len[odd_even] + 1 < worstcase_size) {
-			candidates->states[odd_even] = realloc(candidates->states[odd_even], sizeof(uint32_t) * (candidates->len[odd_even] + 1));
+		bitarray_to_list(byte, nonces[byte].states_bitarray[odd_even], scratch, &(candidates->len[odd_even]), odd_even);
+
+		candidates->states[odd_even] = statelist_arena_alloc(candidates->len[odd_even] + 1);
+		memcpy(candidates->states[odd_even], scratch, sizeof(uint32_t) * (candidates->len[odd_even] + 1));
+
+		if (own_scratch) {
+			free(scratch);
+		} else {
+			statelist_scratch_release(scratch);
 		}
 	}
 	return;
@@ -2078,6 +2668,7 @@ static void generate_candidates(uint8_t sum_a0_idx, uint8_t sum_a8_idx)
 	
 	init_statelist_cache();
 	init_book_of_work();
+	update_states_prefilters();		// worker threads probe these read-only
 
 	// create mutexes for accessing the statelist cache and our "book of work"
 	pthread_mutex_init(&statelist_cache_mutex, NULL);
@@ -2092,6 +2683,7 @@ static void generate_candidates(uint8_t sum_a0_idx, uint8_t sum_a8_idx)
 		sums[i][1] = sum_a8_idx;
 		sums[i][2] = i+1;
 		pthread_create(thread_id + i, NULL, generate_candidates_worker_thread, sums[i]);
+		hardnested_pin_thread(thread_id[i], i);
 	}
 	
 	// wait for threads to terminate:
@@ -2115,7 +2707,10 @@ static void generate_candidates(uint8_t sum_a0_idx, uint8_t sum_a8_idx)
 	}
 	update_expected_brute_force(best_first_bytes[0]);
 
-	hardnested_print_progress(num_acquired_nonces, "Apply Sum(a8) and all bytes bitflip properties", nonces[best_first_bytes[0]].expected_num_brute_force, 0);
+	char progress_text[80];
+	sprintf(progress_text, "Apply Sum(a8) and all bytes bitflip properties (%" PRIu64 "MB statelists)",
+			(statelist_arena_footprint + (1<<20) - 1) >> 20);
+	hardnested_print_progress(num_acquired_nonces, progress_text, nonces[best_first_bytes[0]].expected_num_brute_force, 0);
 }
 
 
@@ -2580,8 +3175,7 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
 				prepare_bf_test_nonces(nonces, best_first_bytes[0]);
 				hardnested_print_progress(num_acquired_nonces, "Starting brute force...", expected_brute_force1, 0);
 				key_found = brute_force();
-				free(candidates->states[ODD_STATE]);
-				free(candidates->states[EVEN_STATE]);
+				statelist_arena_free_all();
 				free_candidates_memory(candidates);
 				candidates = NULL;
 			} else {
@@ -2695,8 +3289,7 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
 			prepare_bf_test_nonces(nonces, best_first_bytes[0]);
 			hardnested_print_progress(num_acquired_nonces, "Starting brute force...", expected_brute_force1, 0);
 			key_found = brute_force();
-			free(candidates->states[ODD_STATE]);
-			free(candidates->states[EVEN_STATE]);
+			statelist_arena_free_all();
 			free_candidates_memory(candidates);
 			candidates = NULL;
 		} else {
@@ -2728,7 +3321,13 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
 
 			}
 		}
-		
+
+		// remember the key across sessions so this card is never cracked again
+		if (key_found && hardnested_found_key != 0) {
+			mfSessionKeyAdd(hardnested_found_key);
+			keyDbRecord(cuid, mfSectorNum(trgBlockNo), trgKeyType, hardnested_found_key);
+		}
+
 		free_nonces_memory();
 		free_bitarray(all_bitflips_bitarray[ODD_STATE]);
 		free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
@@ -2738,3 +3337,14 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
 
 	return 0;
 }
+
+
+// timing hook for the client benchmark suite ('make bench'): one cold
+// bitflip table load/free cycle, including a cache write on the first run
+double hardnested_benchmark_table_load(void)
+{
+	uint64_t start = msclock();
+	init_bitflip_bitarrays();
+	free_bitflip_bitarrays();
+	return (double)(msclock() - start);
+}
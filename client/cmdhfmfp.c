@@ -123,14 +123,18 @@ int CmdHFMFPWritePerso(const char *cmd) {
 		"Usage:\n\thf mfp wrp 4000 000102030405060708090a0b0c0d0e0f -> write key (00..0f) to key number 4000 \n"
 			"\thf mfp wrp 4000 -> write default key(0xff..0xff) to key number 4000");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("vV",  "verbose", "show internal data."),
-		arg_str1(NULL,  NULL,      "<HEX key number (2b)>", NULL),
-		arg_strx0(NULL,  NULL,     "<HEX key (16b)>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("vV",  "verbose", "show internal data."),
+			arg_str1(NULL,  NULL,      "<HEX key number (2b)>", NULL),
+			arg_strx0(NULL,  NULL,     "<HEX key (16b)>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 	
 	bool verbose = arg_get_lit(1);
 	CLIGetHexWithReturn(2, keyNum, &keyNumLen);
@@ -191,13 +195,17 @@ int CmdHFMFPInitPerso(const char *cmd) {
 		"Usage:\n\thf mfp initp 000102030405060708090a0b0c0d0e0f -> fill all the keys with key (00..0f)\n"
 			"\thf mfp initp -vv -> fill all the keys with default key(0xff..0xff) and show all the data exchange");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_litn("vV",  "verbose", 0, 2, "show internal data."),
-		arg_strx0(NULL,  NULL,      "<HEX key (16b)>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_litn("vV",  "verbose", 0, 2, "show internal data."),
+			arg_strx0(NULL,  NULL,      "<HEX key (16b)>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 	
 	bool verbose = arg_get_lit(1);
 	bool verbose2 = arg_get_lit(1) > 1;
@@ -257,13 +265,17 @@ int CmdHFMFPCommitPerso(const char *cmd) {
 		"Executes Commit Perso command. Can be used in SL0 mode only.", 
 		"Usage:\n\thf mfp commitp ->  \n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("vV",  "verbose", "show internal data."),
-		arg_int0(NULL,  NULL,      "SL mode", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("vV",  "verbose", "show internal data."),
+			arg_int0(NULL,  NULL,      "SL mode", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 	
 	bool verbose = arg_get_lit(1);
 	CLIParserFree();
@@ -304,14 +316,18 @@ int CmdHFMFPAuth(const char *cmd) {
 		"Usage:\n\thf mfp auth 4000 000102030405060708090a0b0c0d0e0f -> executes authentication\n"
 			"\thf mfp auth 9003 FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF -v -> executes authentication and shows all the system data\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("vV",  "verbose", "show internal data."),
-		arg_str1(NULL,  NULL,     "<Key Num (HEX 2 bytes)>", NULL),
-		arg_str1(NULL,  NULL,     "<Key Value (HEX 16 bytes)>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("vV",  "verbose", "show internal data."),
+			arg_str1(NULL,  NULL,     "<Key Num (HEX 2 bytes)>", NULL),
+			arg_str1(NULL,  NULL,     "<Key Value (HEX 16 bytes)>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 	
 	bool verbose = arg_get_lit(1);
 	CLIGetHexWithReturn(2, keyn, &keynlen);
@@ -341,17 +357,21 @@ int CmdHFMFPRdbl(const char *cmd) {
 		"Usage:\n\thf mfp rdbl 0 000102030405060708090a0b0c0d0e0f -> executes authentication and read block 0 data\n"
 			"\thf mfp rdbl 1 -v -> executes authentication and shows sector 1 data with default key 0xFF..0xFF and some additional data\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("vV",  "verbose", "show internal data."),
-		arg_int0("nN",  "count",   "blocks count (by default 1).", NULL),
-		arg_lit0("bB",  "keyb",    "use key B (by default keyA)."),
-		arg_lit0("pP",  "plain",   "plain communication mode between reader and card."),
-		arg_int1(NULL,  NULL,      "<Block Num (0..255)>", NULL),
-		arg_str0(NULL,  NULL,      "<Key Value (HEX 16 bytes)>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, false);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("vV",  "verbose", "show internal data."),
+			arg_int0("nN",  "count",   "blocks count (by default 1).", NULL),
+			arg_lit0("bB",  "keyb",    "use key B (by default keyA)."),
+			arg_lit0("pP",  "plain",   "plain communication mode between reader and card."),
+			arg_int1(NULL,  NULL,      "<Block Num (0..255)>", NULL),
+			arg_str0(NULL,  NULL,      "<Key Value (HEX 16 bytes)>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, false);
 	
 	bool verbose = arg_get_lit(1);
 	int blocksCount = arg_get_int_def(2, 1);
@@ -453,16 +473,20 @@ int CmdHFMFPRdsc(const char *cmd) {
 		"Usage:\n\thf mfp rdsc 0 000102030405060708090a0b0c0d0e0f -> executes authentication and read sector 0 data\n"
 			"\thf mfp rdsc 1 -v -> executes authentication and shows sector 1 data with default key 0xFF..0xFF and some additional data\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("vV",  "verbose", "show internal data."),
-		arg_lit0("bB",  "keyb",    "use key B (by default keyA)."),
-		arg_lit0("pP",  "plain",   "plain communication mode between reader and card."),
-		arg_int1(NULL,  NULL,      "<Sector Num (0..255)>", NULL),
-		arg_str0(NULL,  NULL,      "<Key Value (HEX 16 bytes)>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, false);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("vV",  "verbose", "show internal data."),
+			arg_lit0("bB",  "keyb",    "use key B (by default keyA)."),
+			arg_lit0("pP",  "plain",   "plain communication mode between reader and card."),
+			arg_int1(NULL,  NULL,      "<Sector Num (0..255)>", NULL),
+			arg_str0(NULL,  NULL,      "<Key Value (HEX 16 bytes)>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, false);
 	
 	bool verbose = arg_get_lit(1);
 	bool keyB = arg_get_lit(2);
@@ -551,16 +575,20 @@ int CmdHFMFPWrbl(const char *cmd) {
 		"Usage:\n\thf mfp wrbl 1 ff0000000000000000000000000000ff 000102030405060708090a0b0c0d0e0f -> writes block 1 data\n"
 			"\thf mfp wrbl 2 ff0000000000000000000000000000ff -v -> writes block 2 data with default key 0xFF..0xFF and some additional data\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("vV",  "verbose", "show internal data."),
-		arg_lit0("bB",  "keyb",    "use key B (by default keyA)."),
-		arg_int1(NULL,  NULL,      "<Block Num (0..255)>", NULL),
-		arg_str1(NULL,  NULL,      "<Data (HEX 16 bytes)>", NULL),
-		arg_str0(NULL,  NULL,      "<Key (HEX 16 bytes)>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, false);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("vV",  "verbose", "show internal data."),
+			arg_lit0("bB",  "keyb",    "use key B (by default keyA)."),
+			arg_int1(NULL,  NULL,      "<Block Num (0..255)>", NULL),
+			arg_str1(NULL,  NULL,      "<Data (HEX 16 bytes)>", NULL),
+			arg_str0(NULL,  NULL,      "<Key (HEX 16 bytes)>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, false);
 	
 	bool verbose = arg_get_lit(1);
 	bool keyB = arg_get_lit(2);
@@ -648,15 +676,19 @@ int CmdHFMFPMAD(const char *cmd) {
                   "Usage:\n\thf mfp mad -> shows MAD if exists\n"
                   "\thf mfp mad -a 03e1 -k d3f7d3f7d3f7d3f7d3f7d3f7d3f7d3f7 -> shows NDEF data if exists\n");
 
-    void *argtable[] = {
-        arg_param_begin,
-        arg_lit0("vV",  "verbose",  "show technical data"),
-        arg_str0("aA",  "aid",      "print all sectors with aid", NULL),
-        arg_str0("kK",  "key",      "key for printing sectors", NULL),
-        arg_lit0("bB",  "keyb",     "use key B for access printing sectors (by default: key A)"),
-        arg_param_end
-    };
-    CLIExecWithReturn(cmd, argtable, true);
+    void **argtable = CLIParserCachedArgtable();
+    if (argtable == NULL) {
+        void *newtable[] = {
+            arg_param_begin,
+            arg_lit0("vV",  "verbose",  "show technical data"),
+            arg_str0("aA",  "aid",      "print all sectors with aid", NULL),
+            arg_str0("kK",  "key",      "key for printing sectors", NULL),
+            arg_lit0("bB",  "keyb",     "use key B for access printing sectors (by default: key A)"),
+            arg_param_end
+        };
+        argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+    }
+    CLIExecCachedWithReturn(cmd, argtable, true);
 
     bool verbose = arg_get_lit(1);
     uint8_t aid[2] = {0};
@@ -742,15 +774,19 @@ int CmdHFMFPNDEF(const char *cmd) {
                   "Usage:\n\thf mfp ndef -> shows NDEF data\n"
                   "\thf mfp ndef -a 03e1 -k d3f7d3f7d3f7d3f7d3f7d3f7d3f7d3f7 -> shows NDEF data with custom AID and key\n");
 
-    void *argtable[] = {
-        arg_param_begin,
-        arg_litn("vV",  "verbose",  0, 2, "show technical data"),
-        arg_str0("aA",  "aid",      "replace default aid for NDEF", NULL),
-        arg_str0("kK",  "key",      "replace default key for NDEF", NULL),
-        arg_lit0("bB",  "keyb",     "use key B for access sectors (by default: key A)"),
-        arg_param_end
-    };
-    CLIExecWithReturn(cmd, argtable, true);
+    void **argtable = CLIParserCachedArgtable();
+    if (argtable == NULL) {
+        void *newtable[] = {
+            arg_param_begin,
+            arg_litn("vV",  "verbose",  0, 2, "show technical data"),
+            arg_str0("aA",  "aid",      "replace default aid for NDEF", NULL),
+            arg_str0("kK",  "key",      "replace default key for NDEF", NULL),
+            arg_lit0("bB",  "keyb",     "use key B for access sectors (by default: key A)"),
+            arg_param_end
+        };
+        argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+    }
+    CLIExecCachedWithReturn(cmd, argtable, true);
 
     bool verbose = arg_get_lit(1);
     bool verbose2 = arg_get_lit(1) > 1;
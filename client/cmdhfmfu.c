@@ -1448,6 +1448,11 @@ static int CmdHF14AMfUDump(const char *Cmd){
 		memcpy(c.d.asBytes, authenticationkey, keyLen);
 	}
 
+	// EV1/NTAG support FAST_READ - let the firmware batch blocks per round trip
+	bool useFastRead = (tagtype & (UL_EV1_48 | UL_EV1_128 | NTAG_210 | NTAG_212 | NTAG_213 | NTAG_215 | NTAG_216 | NTAG_I2C_1K | NTAG_I2C_2K));
+	if (useFastRead)
+		c.arg[2] |= 4;
+
 	clearCommandBuffer();
 	SendCommand(&c);
 	UsbCommand resp;
@@ -1456,6 +1461,18 @@ static int CmdHF14AMfUDump(const char *Cmd){
 		DropField();
 		return 1;
 	}
+	if (resp.arg[0] != 1 && useFastRead) {
+		// clones may identify as EV1/NTAG yet NAK FAST_READ - retry with plain reads
+		PrintAndLogEx(NORMAL, "Fast read failed, falling back to single block reads...");
+		c.arg[2] &= ~4;
+		clearCommandBuffer();
+		SendCommand(&c);
+		if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500)) {
+			PrintAndLogEx(ERR, "Command execution timeout");
+			DropField();
+			return 1;
+		}
+	}
 	if (resp.arg[0] != 1) {
 		PrintAndLogEx(ERR, "Failed reading card");
 		DropField();
@@ -1827,6 +1844,153 @@ static int CmdHF14AMfuGenDiverseKeys(const char *Cmd){
 	// return;
 // }
 
+// 128 four-byte candidates fit one USB command payload
+#define PWDCHK_BATCH_SIZE (USB_CMD_DATA_SIZE / 4)
+
+// UID-derived EV1/NTAG password (the XOR scheme seen on several commercial
+// deployments; needs the full 7-byte UID)
+static void ul_ev1_pwdgen_xor(uint8_t *uid, uint8_t *pwd) {
+	pwd[0] = uid[1] ^ uid[3] ^ 0xAA;
+	pwd[1] = uid[2] ^ uid[4] ^ 0x55;
+	pwd[2] = uid[3] ^ uid[5] ^ 0xAA;
+	pwd[3] = uid[4] ^ uid[6] ^ 0x55;
+}
+
+static int usage_hf_mfu_pwdchk(void) {
+	PrintAndLogEx(NORMAL, "Checks UL-EV1/NTAG PWD_AUTH password candidates against the tag.");
+	PrintAndLogEx(NORMAL, "Candidates are the built-in default passwords, a password derived from");
+	PrintAndLogEx(NORMAL, "the tag UID and optionally a dictionary file (one 8-digit hex password");
+	PrintAndLogEx(NORMAL, "per line, '#' comments allowed). The device tries %d candidates per", PWDCHK_BATCH_SIZE);
+	PrintAndLogEx(NORMAL, "USB command, re-selecting the tag between attempts, instead of paying a");
+	PrintAndLogEx(NORMAL, "USB round trip per password.");
+	PrintAndLogEx(NORMAL, "");
+	PrintAndLogEx(NORMAL, "NOTE: tags with AUTHLIM set lock up after that many failed attempts -");
+	PrintAndLogEx(NORMAL, "check 'hf mfu info' first.");
+	PrintAndLogEx(NORMAL, "");
+	PrintAndLogEx(NORMAL, "Usage:  hf mfu pwdchk [h] [f <dictionary file>]");
+	PrintAndLogEx(NORMAL, "    h                   : this help");
+	PrintAndLogEx(NORMAL, "    f <dictionary file> : also try all passwords from this file");
+	PrintAndLogEx(NORMAL, "");
+	PrintAndLogEx(NORMAL, "Examples:");
+	PrintAndLogEx(NORMAL, "        hf mfu pwdchk");
+	PrintAndLogEx(NORMAL, "        hf mfu pwdchk f default_pwd.dic");
+	return 0;
+}
+
+static int CmdHF14AMfUPwdChk(const char *Cmd) {
+
+	char filename[FILE_PATH_SIZE] = {0};
+	uint8_t *candidates = NULL;
+	uint32_t count = 0, capacity = 0;
+
+	uint8_t cmdp = 0;
+	bool errors = false;
+	while (param_getchar(Cmd, cmdp) != 0x00) {
+		switch (param_getchar(Cmd, cmdp)) {
+			case 'h':
+			case 'H':
+				return usage_hf_mfu_pwdchk();
+			case 'f':
+			case 'F':
+				if (param_getstr(Cmd, cmdp+1, filename, sizeof(filename)) < 1) {
+					PrintAndLogEx(WARNING, "missing dictionary file name");
+					errors = true;
+				}
+				cmdp += 2;
+				break;
+			default:
+				PrintAndLogEx(WARNING, "Unknown parameter '%c'", param_getchar(Cmd, cmdp));
+				errors = true;
+		}
+		if (errors) break;
+	}
+	if (errors) return usage_hf_mfu_pwdchk();
+
+	// select once to get the UID for the derived candidate
+	iso14a_card_select_t card;
+	if (!ul_select(&card, false))
+		return 1;
+	DropField();
+
+	capacity = 256;
+	candidates = malloc(capacity * 4);
+	if (!candidates) return 1;
+
+	// built-in defaults first, then the UID-derived password
+	for (uint8_t i = 0; i < KEYS_PWD_COUNT; ++i) {
+		memcpy(candidates + count * 4, default_pwd_pack[i], 4);
+		count++;
+	}
+	if (card.uidlen == 7) {
+		ul_ev1_pwdgen_xor(card.uid, candidates + count * 4);
+		count++;
+	}
+
+	if (filename[0]) {
+		FILE *f = fopen(filename, "r");
+		if (!f) {
+			PrintAndLogEx(WARNING, "Could not open dictionary file %s", filename);
+			free(candidates);
+			return 1;
+		}
+		char line[64];
+		while (fgets(line, sizeof(line), f)) {
+			uint8_t pwd[4];
+			if (line[0] == '#' || sscanf(line, "%2hhx%2hhx%2hhx%2hhx", &pwd[0], &pwd[1], &pwd[2], &pwd[3]) != 4)
+				continue;
+			if (count == capacity) {
+				capacity *= 2;
+				uint8_t *p = realloc(candidates, capacity * 4);
+				if (!p) {
+					free(candidates);
+					fclose(f);
+					return 1;
+				}
+				candidates = p;
+			}
+			memcpy(candidates + count * 4, pwd, 4);
+			count++;
+		}
+		fclose(f);
+	}
+
+	PrintAndLogEx(NORMAL, "Testing %u password candidates in batches of %d...", count, PWDCHK_BATCH_SIZE);
+
+	uint64_t t1 = msclock();
+	bool found = false;
+	for (uint32_t done = 0; done < count && !found; done += PWDCHK_BATCH_SIZE) {
+		uint32_t batch = MIN(count - done, PWDCHK_BATCH_SIZE);
+
+		UsbCommand c = {CMD_MIFAREU_EV1_PWD_CHECK, {batch, 0, 0}};
+		memcpy(c.d.asBytes, candidates + done * 4, batch * 4);
+		clearCommandBuffer();
+		SendCommand(&c);
+
+		UsbCommand resp;
+		if (!WaitForResponseTimeout(CMD_ACK, &resp, 30000)) {
+			PrintAndLogEx(WARNING, "Command execute timeout");
+			free(candidates);
+			return 1;
+		}
+
+		if (resp.arg[0] == 1) {
+			uint8_t *pwd = candidates + (done + resp.arg[1]) * 4;
+			PrintAndLogEx(SUCCESS, "Found password: %s || Pack: %02X %02X",
+			              sprint_hex(pwd, 4), resp.d.asBytes[0], resp.d.asBytes[1]);
+			found = true;
+		} else {
+			PrintAndLogEx(NORMAL, "...%u/%u", MIN(done + batch, count), count);
+		}
+	}
+	uint64_t duration = msclock() - t1;
+
+	if (!found)
+		PrintAndLogEx(WARNING, "password not found (%u attempts in %.1fs)", count, duration / 1000.0);
+
+	free(candidates);
+	return found ? 0 : 1;
+}
+
 //------------------------------------
 // Menu Stuff
 //------------------------------------
@@ -1845,6 +2009,7 @@ static command_t CommandTable[] =
 	{"setpwd",  CmdHF14AMfucSetPwd,        0, "Set 3des password - Ultralight-C"},
 	{"setuid",  CmdHF14AMfucSetUid,        0, "Set UID - MAGIC tags only"},
 	{"gen",     CmdHF14AMfuGenDiverseKeys, 1, "Generate 3des mifare diversified keys"},
+	{"pwdchk",  CmdHF14AMfUPwdChk,         0, "Check EV1/NTAG password candidates in device-side batches"},
 	{NULL, NULL, 0, NULL}
 };
 
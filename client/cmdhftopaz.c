@@ -131,45 +131,7 @@ static int topaz_rall(uint8_t *uid, uint8_t *response)
 }
 
 
-// read a block (8 Bytes) of a selected Topaz tag.
-static int topaz_read_block(uint8_t *uid, uint8_t blockno, uint8_t *block_data)
-{
-	uint8_t read8_cmd[] = {TOPAZ_READ8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-	uint8_t read8_response[11];
-	
-	read8_cmd[1] = blockno;
-	memcpy(&read8_cmd[10], uid, 4);
-	if (!topaz_send_cmd(read8_cmd, sizeof(read8_cmd), read8_response)) {
-		topaz_switch_off_field();
-		return -1;		// READ8 failed
-	}
-	
-	memcpy(block_data, &read8_response[1], 8);
-	
-	return 0;
-}
-
-
-// read a segment (16 blocks = 128 Bytes) of a selected Topaz tag. Works only for tags with dynamic memory.
-static int topaz_read_segment(uint8_t *uid, uint8_t segno, uint8_t *segment_data)
-{
-	uint8_t rseg_cmd[] = {TOPAZ_RSEG, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-	uint8_t rseg_response[131];
-	
-	rseg_cmd[1] = segno << 4;
-	memcpy(&rseg_cmd[10], uid, 4);
-	if (!topaz_send_cmd(rseg_cmd, sizeof(rseg_cmd), rseg_response)) {
-		topaz_switch_off_field();
-		return -1;		// RSEG failed
-	}
-	
-	memcpy(segment_data, &rseg_response[1], 128);
-	
-	return 0;
-}
-
-
-// search for the lock area descriptor for the lockable area including byteno 
+// search for the lock area descriptor for the lockable area including byteno
 static dynamic_lock_area_t *get_dynamic_lock_area(uint16_t byteno)
 {
 	dynamic_lock_area_t *lock_area;
@@ -363,24 +325,29 @@ static void topaz_print_control_TLVs(uint8_t *memory)
 }
 
 
-// read all of the dynamic memory
+// read all of the dynamic memory. The device walks READ8 of block 0x0f plus
+// RSEG of every remaining segment in one field session and returns
+// everything in one download instead of one USB round trip per segment.
 static int topaz_read_dynamic_data(void)
 {
-	// first read the remaining block of segment 0
-	if(topaz_read_block(topaz_tag.uid, 0x0f, &topaz_tag.dynamic_memory[0]) == -1) {
-		PrintAndLog("Error while reading dynamic memory block %02x. Aborting...", 0x0f);
+	uint8_t max_segment = topaz_tag.size / 128 - 1;
+	uint16_t expected = 8 + (uint16_t)max_segment * 128;
+
+	UsbCommand c = {CMD_TOPAZ_READ_ALL, {topaz_tag.size, 0, 0}};
+	memcpy(c.d.asBytes, topaz_tag.uid, 4);
+	SendCommand(&c);
+
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 3000)) {
+		PrintAndLog("No response from Proxmark while reading dynamic memory. Aborting...");
 		return -1;
 	}
-	
-	// read the remaining segments
-	uint8_t max_segment = topaz_tag.size / 128 - 1;
-	for(uint8_t segment = 1; segment <= max_segment; segment++) {
-		if(topaz_read_segment(topaz_tag.uid, segment, &topaz_tag.dynamic_memory[(segment-1)*128+8]) == -1) {
-			PrintAndLog("Error while reading dynamic memory block %02x. Aborting...", 0x0f);
-			return -1;
-		}
+	if (resp.arg[0] != expected) {
+		PrintAndLog("Error while reading dynamic memory (got %u of %u bytes). Aborting...", (unsigned)resp.arg[0], expected);
+		return -1;
 	}
-	
+	memcpy(topaz_tag.dynamic_memory, resp.d.asBytes, expected);
+
 	return 0;
 }
 	
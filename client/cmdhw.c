@@ -14,11 +14,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <ctype.h>
 #include "ui.h"
+#include "util.h"
 #include "comms.h"
 #include "cmdparser.h"
 #include "cmdmain.h"
 #include "cmddata.h"
+#include "graph.h"
+#ifdef ALLOC_AUDIT
+#include "allocaudit.h"
+#endif
 
 
 static uint32_t hw_capabilities = 0;
@@ -404,6 +410,137 @@ int CmdTune(const char *Cmd)
     return CmdTuneSamples(Cmd);
 }
 
+static const char *evt_name(uint16_t id)
+{
+	switch (id) {
+		case EVT_FIELD_ON:        return "FIELD_ON";
+		case EVT_FIELD_OFF:       return "FIELD_OFF";
+		case EVT_14A_SELECT:      return "14A_SELECT";
+		case EVT_14A_SELECT_FAIL: return "14A_SELECT_FAIL";
+		case EVT_MF_AUTH_START:   return "MF_AUTH_START";
+		case EVT_MF_AUTH_FAIL:    return "MF_AUTH_FAIL";
+		case EVT_MF_AUTH_OK:      return "MF_AUTH_OK";
+		case EVT_SIM_START:       return "SIM_START";
+		case EVT_SIM_STOP:        return "SIM_STOP";
+		case EVT_SIM_HALT:        return "SIM_HALT";
+		default:                  return "?";
+	}
+}
+
+// download and print the device field-event journal
+int CmdJournal(const char *Cmd)
+{
+	char ctmp = tolower(param_getchar(Cmd, 0));
+	if (ctmp == 'h') {
+		PrintAndLog("Download the field-event journal the device keeps while");
+		PrintAndLog("running protocol code - field on, select, auth outcomes and");
+		PrintAndLog("the like, timestamped with the SSP carrier clock.");
+		PrintAndLog("Usage:  hw journal ['c']");
+		PrintAndLog("  c : clear the journal after downloading it");
+		return 0;
+	}
+	bool clear = (ctmp == 'c');
+
+	UsbCommand c = {CMD_EVENT_JOURNAL, {clear, 0, 0}};
+	clearCommandBuffer();
+	SendCommand(&c);
+
+	uint32_t prev_ts = 0;
+	bool first = true;
+	for (;;) {
+		UsbCommand resp;
+		if (!WaitForResponseTimeout(CMD_ACK, &resp, 2500)) {
+			PrintAndLog("Command execution timeout");
+			return 1;
+		}
+		uint16_t n = resp.arg[1];
+		if (n == 0) {
+			PrintAndLog("%u events%s", (uint32_t)resp.arg[2], clear ? ", journal cleared" : "");
+			break;
+		}
+		if (first && n) {
+			PrintAndLog("  seq |     ssp clk (      delta) | event            | arg");
+			PrintAndLog("------+---------------------------+------------------+---------");
+		}
+		event_journal_entry_t *e = (event_journal_entry_t *)resp.d.asBytes;
+		for (uint16_t i = 0; i < n; i++, e++) {
+			PrintAndLog("%5u | %11u (%+11d) | %-16s | %08x",
+				e->seq, e->ts, first ? 0 : (int32_t)(e->ts - prev_ts), evt_name(e->id), e->arg);
+			prev_ts = e->ts;
+			first = false;
+		}
+	}
+	return 0;
+}
+
+// live antenna voltage telemetry, streamed by the device and fed into the
+// plot window as a rolling strip chart
+int CmdTelemetry(const char *Cmd)
+{
+#define TELEM_PLOT_WINDOW 1024
+	char ctmp = tolower(param_getchar(Cmd, 0));
+	if (ctmp == 'h') {
+		PrintAndLog("Stream periodic antenna voltage readings from the device and");
+		PrintAndLog("plot them live, to catch tuning drift without re-running 'hw tune'.");
+		PrintAndLog("Usage:  hw telemetry [period_ms] [lf|hf] [divisor]");
+		PrintAndLog("  [period_ms] : sample cadence in milliseconds (default 1000)");
+		PrintAndLog("  [lf|hf]     : antenna to watch (default lf)");
+		PrintAndLog("  [divisor]   : LF divisor 19-255 (default 95 = 125 kHz)");
+		PrintAndLog("Press any key to stop; the field stays powered while streaming.");
+		return 0;
+	}
+
+	uint32_t period = param_get32ex(Cmd, 0, 1000, 10);
+	if (period == 0) period = 1000;
+	char mode[8] = {0};
+	param_getstr(Cmd, 1, mode, sizeof(mode));
+	bool hf = (mode[0] == 'h');
+	uint32_t divisor = param_get32ex(Cmd, 2, 95, 10);
+
+	UsbCommand c = {CMD_ANTENNA_TELEMETRY, {period, hf, divisor}};
+	clearCommandBuffer();
+	SendCommand(&c);
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500)) {
+		PrintAndLog("Command execution timeout");
+		return 1;
+	}
+
+	PrintAndLog("Streaming %s antenna voltage every %u ms, press any key to stop",
+		hf ? "HF" : "LF", period);
+	GraphTraceLen = 0;
+	ShowGraphWindow();
+
+	for (;;) {
+		if (!WaitForResponseTimeoutW(CMD_UNKNOWN, &resp, 1000, false)) {
+			if (ukbhit()) {
+				getchar();
+				break;
+			}
+			continue;
+		}
+		if (resp.cmd != CMD_ANTENNA_TELEMETRY_SAMPLE) continue;
+
+		uint32_t mv = resp.arg[0];
+		PrintAndLog("%10u ms: %u.%03u V", (uint32_t)resp.arg[2], mv / 1000, mv % 1000);
+
+		// rolling window so the newest readings are always on screen
+		if (GraphTraceLen >= TELEM_PLOT_WINDOW) {
+			memmove(GraphBuffer, GraphBuffer + 1, (TELEM_PLOT_WINDOW - 1) * sizeof(int));
+			GraphTraceLen = TELEM_PLOT_WINDOW - 1;
+		}
+		GraphBuffer[GraphTraceLen++] = mv;
+		RepaintGraphWindow();
+	}
+
+	// stop streaming and switch the field back off
+	c.arg[0] = 0;
+	clearCommandBuffer();
+	SendCommand(&c);
+	WaitForResponseTimeout(CMD_ACK, &resp, 1500);
+	return 0;
+}
+
 bool PM3hasSmartcardSlot(void) {
 	return (hw_capabilities & HAS_SMARTCARD_SLOT);
 }
@@ -432,11 +569,207 @@ int CmdStatus(const char *Cmd)
 	SendCommand(&c);
 	if (!WaitForResponseTimeout(CMD_ACK, &c, 1900)) {
 		PrintAndLog("Status command failed. USB Speed Test timed out");
+	} else if (c.arg[1] > 0) {
+		PrintAndLog("BigBuf high water mark: %u bytes", (unsigned int)c.arg[1]);
 	}
 	return 0;
 }
 
 
+// push a blob to the device flash store in USB_CMD_DATA_SIZE chunks
+static int flashstore_write_blob(uint8_t id, const uint8_t *data, uint16_t total)
+{
+	uint16_t offset = 0;
+	do {
+		uint16_t chunk = total - offset;
+		if (chunk > USB_CMD_DATA_SIZE) chunk = USB_CMD_DATA_SIZE;
+		UsbCommand c = {CMD_FLASHSTORE_WRITE, {id, offset, ((uint32_t)total << 16) | chunk}};
+		memcpy(c.d.asBytes, data + offset, chunk);
+		clearCommandBuffer();
+		SendCommand(&c);
+		UsbCommand resp;
+		// the final chunk triggers the actual flash programming, allow for it
+		if (!WaitForResponseTimeout(CMD_ACK, &resp, 5000)) {
+			PrintAndLog("Device did not respond while writing the flash store");
+			return 1;
+		}
+		if (!resp.arg[0]) {
+			switch (resp.arg[1]) {
+				case 1: PrintAndLog("Flash store is full, even after compaction"); break;
+				case 2: PrintAndLog("Flash programming error"); break;
+				case 3: PrintAndLog("Not enough memory on the device to stage the data"); break;
+				default: PrintAndLog("Flash store write failed"); break;
+			}
+			return 1;
+		}
+		offset += chunk;
+	} while (offset < total);
+	return 0;
+}
+
+int CmdFlashStore(const char *Cmd)
+{
+	char ctmp = param_getchar(Cmd, 0);
+	UsbCommand resp;
+
+	switch (ctmp) {
+		case 'i':
+		case 'I': {
+			// status is printed on the device debug channel
+			UsbCommand c = {CMD_FLASHSTORE_INFO, {0, 0, 0}};
+			clearCommandBuffer();
+			SendCommand(&c);
+			if (WaitForResponseTimeout(CMD_ACK, &resp, 1000))
+				PrintAndLog("Flash store: %u of %u bytes used (see device debug output for details)",
+					(unsigned int)resp.arg[1], (unsigned int)resp.arg[2]);
+			return 0;
+		}
+		case 'd':
+		case 'D': {
+			uint8_t id = param_get8(Cmd, 1);
+			UsbCommand c = {CMD_FLASHSTORE_INFO, {1, id, 0}};
+			clearCommandBuffer();
+			SendCommand(&c);
+			if (!WaitForResponseTimeout(CMD_ACK, &resp, 5000)) {
+				PrintAndLog("Device did not respond");
+			} else if (resp.arg[0]) {
+				PrintAndLog("Deleted entry %u", id);
+			} else {
+				PrintAndLog("No entry %u in the flash store", id);
+			}
+			return 0;
+		}
+		case 'w':
+		case 'W': {
+			uint8_t id = param_get8(Cmd, 1);
+			uint8_t data[USB_CMD_DATA_SIZE];
+			int len = 0;
+			if (param_gethex_ex(Cmd, 2, data, &len) || len == 0 || len & 1) {
+				PrintAndLog("Data must be hex symbols in even count");
+				return 1;
+			}
+			if (flashstore_write_blob(id, data, len / 2) == 0)
+				PrintAndLog("Stored %d bytes as entry %u", len / 2, id);
+			return 0;
+		}
+		case 'r':
+		case 'R': {
+			uint8_t id = param_get8(Cmd, 1);
+			uint16_t offset = 0;
+			uint16_t total = 0;
+			do {
+				UsbCommand c = {CMD_FLASHSTORE_READ, {id, offset, 0}};
+				clearCommandBuffer();
+				SendCommand(&c);
+				if (!WaitForResponseTimeout(CMD_ACK, &resp, 1000)) {
+					PrintAndLog("Device did not respond");
+					return 1;
+				}
+				if (!resp.arg[0]) {
+					PrintAndLog("No entry %u in the flash store", id);
+					return 0;
+				}
+				total = resp.arg[1];
+				uint16_t chunk = total - offset;
+				if (chunk > USB_CMD_DATA_SIZE) chunk = USB_CMD_DATA_SIZE;
+				for (uint16_t i = 0; i < chunk; i += 16) {
+					uint16_t line = (chunk - i < 16) ? chunk - i : 16;
+					PrintAndLog("%04x | %s", offset + i, sprint_hex(resp.d.asBytes + i, line));
+				}
+				offset += chunk;
+			} while (offset < total);
+			PrintAndLog("Entry %u: %u bytes", id, total);
+			return 0;
+		}
+		case 'k':
+		case 'K': {
+			// load a mifare key dictionary (12 hex chars per line) into the key entry
+			char filename[FILE_PATH_SIZE] = {0};
+			if (param_getstr(Cmd, 1, filename, sizeof(filename)) < 1) {
+				PrintAndLog("Please specify a dictionary file");
+				return 1;
+			}
+			FILE *f = fopen(filename, "r");
+			if (f == NULL) {
+				PrintAndLog("File: %s: not found or locked.", filename);
+				return 1;
+			}
+			// the store takes one value of up to 16k - 8 bytes -> 2730 keys max
+			uint16_t maxKeys = (0x4000 - 8) / 6;
+			uint8_t *keyBlock = calloc(maxKeys, 6);
+			if (keyBlock == NULL) {
+				fclose(f);
+				return 1;
+			}
+			uint16_t keycnt = 0;
+			char buf[13];
+			while (fgets(buf, sizeof(buf), f)) {
+				if (strlen(buf) < 12 || buf[11] == '\n')
+					continue;
+				while (fgetc(f) != '\n' && !feof(f)) ; // skip long lines
+				if (buf[0] == '#')
+					continue;
+				if (!isxdigit((unsigned char)buf[0])) {
+					PrintAndLog("File content error. '%s' must include 12 HEX symbols", buf);
+					continue;
+				}
+				buf[12] = 0;
+				if (keycnt >= maxKeys) {
+					PrintAndLog("Key file is larger than the flash store, stopping after %u keys", keycnt);
+					break;
+				}
+				uint64_t key = strtoull(buf, NULL, 16);
+				num_to_bytes(key, 6, keyBlock + keycnt * 6);
+				keycnt++;
+			}
+			fclose(f);
+			if (keycnt == 0) {
+				PrintAndLog("No keys found in file");
+				free(keyBlock);
+				return 1;
+			}
+			PrintAndLog("Loaded %u keys from %s", keycnt, filename);
+			if (flashstore_write_blob(FLASHSTORE_ID_MFKEYS, keyBlock, keycnt * 6) == 0)
+				PrintAndLog("Stored %u keys in the device flash store", keycnt);
+			free(keyBlock);
+			return 0;
+		}
+		case 'e':
+		case 'E': {
+			char ctmp2 = param_getchar_indx(Cmd, 1, 0);
+			if (ctmp2 != 's' && ctmp2 != 'S' && ctmp2 != 'l' && ctmp2 != 'L')
+				break;
+			bool save = (ctmp2 == 's' || ctmp2 == 'S');
+			UsbCommand c = {CMD_FLASHSTORE_INFO, {save ? 2 : 3, 0, 0}};
+			clearCommandBuffer();
+			SendCommand(&c);
+			if (!WaitForResponseTimeout(CMD_ACK, &resp, 5000)) {
+				PrintAndLog("Device did not respond");
+			} else if (resp.arg[0]) {
+				PrintAndLog(save ? "Emulator memory saved to flash" : "Emulator memory loaded from flash");
+			} else {
+				PrintAndLog(save ? "Save failed (flash store full?)" : "No emulator image in the flash store");
+			}
+			return 0;
+		}
+		default:
+			break;
+	}
+
+	PrintAndLog("Persistent key-value store in the last 16k of device flash.");
+	PrintAndLog("Entries survive firmware updates (the flasher never touches that area).");
+	PrintAndLog("Usage:  hw flashstore i            - show store status");
+	PrintAndLog("        hw flashstore w <id> <hex> - store up to %d bytes under <id>", USB_CMD_DATA_SIZE);
+	PrintAndLog("        hw flashstore r <id>       - read entry <id> and dump it");
+	PrintAndLog("        hw flashstore d <id>       - delete entry <id>");
+	PrintAndLog("        hw flashstore k <file>     - store a mifare key dictionary (id %d)", FLASHSTORE_ID_MFKEYS);
+	PrintAndLog("        hw flashstore es           - save the emulator memory to flash (id %d)", FLASHSTORE_ID_EMIMAGE);
+	PrintAndLog("        hw flashstore el           - load the emulator memory from flash");
+	PrintAndLog("The stored dictionary feeds 'hf mf chk' on the device, the stored emulator");
+	PrintAndLog("image feeds 'hf mf sim' option 'l'.");
+	return 0;
+}
+
 int CmdPing(const char *Cmd)
 {
 	clearCommandBuffer();
@@ -451,7 +784,297 @@ int CmdPing(const char *Cmd)
 	return 0;
 }
 
-static command_t CommandTable[] = 
+static int usage_hw_standalone(void)
+{
+	PrintAndLog("Upload an operation sequence for untethered execution. The device");
+	PrintAndLog("runs the steps on a long button press and logs per-step results.");
+	PrintAndLog("Usage:  hw standalone load [n=<repeat>] <op> [<op> ...]");
+	PrintAndLog("        hw standalone results");
+	PrintAndLog("Ops:");
+	PrintAndLog("        read[:<timeout ms>]      - read a 14a card (0/absent = wait for one)");
+	PrintAndLog("        chk[:<sectors>[:a|b|ab]] - check flash store keys (default 16 sectors, key A)");
+	PrintAndLog("        sim                      - simulate the last read card until button press");
+	PrintAndLog("        delay:<ms>               - pause between steps");
+	PrintAndLog("        mark:<value>             - write a marker into the result log");
+	PrintAndLog("Examples:");
+	PrintAndLog("        hw standalone load read chk:16:ab sim");
+	PrintAndLog("        hw standalone load n=10 read:5000 delay:2000");
+	return 0;
+}
+
+// 8 byte wire format of one op, must match seq_op_t in armsrc/standalone_seq.c
+static void standalone_pack_op(uint8_t *dst, uint8_t op, uint16_t arg16, uint32_t arg32)
+{
+	dst[0] = op;
+	dst[1] = 0;
+	dst[2] = arg16 & 0xff;
+	dst[3] = arg16 >> 8;
+	dst[4] = arg32 & 0xff;
+	dst[5] = (arg32 >> 8) & 0xff;
+	dst[6] = (arg32 >> 16) & 0xff;
+	dst[7] = (arg32 >> 24) & 0xff;
+}
+
+int CmdStandalone(const char *Cmd)
+{
+	char token[64];
+
+	if (param_getstr(Cmd, 0, token, sizeof(token)) == 0 || token[0] == 'h') {
+		return usage_hw_standalone();
+	}
+
+	if (strcmp(token, "results") == 0) {
+		UsbCommand c = {CMD_STANDALONE_RESULT};
+		clearCommandBuffer();
+		SendCommand(&c);
+		UsbCommand resp;
+		if (!WaitForResponseTimeout(CMD_ACK, &resp, 1000)) {
+			PrintAndLog("Command execute timeout");
+			return 1;
+		}
+		uint16_t loglen = resp.arg[0] & 0xffff;
+		PrintAndLog("Completed runs: %d", (int)resp.arg[1]);
+		if (loglen == 0) {
+			PrintAndLog("Result log is empty.");
+			return 0;
+		}
+		// entries of [step][op][status][len][data]
+		uint16_t pos = 0;
+		while (pos + 4 <= loglen) {
+			uint8_t step = resp.d.asBytes[pos];
+			uint8_t op = resp.d.asBytes[pos + 1];
+			uint8_t status = resp.d.asBytes[pos + 2];
+			uint8_t len = resp.d.asBytes[pos + 3];
+			uint8_t *data = resp.d.asBytes + pos + 4;
+			if (pos + 4 + len > loglen) break;
+			switch (op) {
+				case SEQ_OP_READ_14A:
+					if (status && len >= 13)
+						PrintAndLog("step %2u: read  UID %s ATQA %02x %02x SAK %02x",
+							step, sprint_hex(data, 10), data[11], data[10], data[12]);
+					else
+						PrintAndLog("step %2u: read  no card found", step);
+					break;
+				case SEQ_OP_CHK_KEYS:
+					if (status && len >= 8)
+						PrintAndLog("step %2u: chk   sector %2u key %c : %s",
+							step, data[0], data[1] ? 'B' : 'A', sprint_hex(data + 2, 6));
+					else
+						PrintAndLog("step %2u: chk   no key found", step);
+					break;
+				case SEQ_OP_SIM_14A:
+					PrintAndLog("step %2u: sim   %s", step, status ? "done" : "skipped - no card read");
+					break;
+				case SEQ_OP_LOG:
+					if (len >= 4)
+						PrintAndLog("step %2u: mark  %u", step,
+							data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24));
+					break;
+				default:
+					PrintAndLog("step %2u: op %u status %u", step, op, status);
+					break;
+			}
+			pos += 4 + len;
+		}
+		return 0;
+	}
+
+	if (strcmp(token, "load") != 0) {
+		return usage_hw_standalone();
+	}
+
+	UsbCommand c = {CMD_STANDALONE_PROG, {0, 1, 0}};
+	int count = 0;
+	int i = 1;
+	while (param_getstr(Cmd, i, token, sizeof(token)) > 0) {
+		i++;
+		if (strncmp(token, "n=", 2) == 0) {
+			c.arg[1] = strtoul(token + 2, NULL, 10);
+			continue;
+		}
+		if (count >= USB_CMD_DATA_SIZE / 8) {
+			PrintAndLog("Too many ops (max %d)", USB_CMD_DATA_SIZE / 8);
+			return 1;
+		}
+		uint8_t *dst = c.d.asBytes + count * 8;
+		char *arg1 = strchr(token, ':');
+		if (arg1) *arg1++ = '\0';
+		char *arg2 = arg1 ? strchr(arg1, ':') : NULL;
+		if (arg2) *arg2++ = '\0';
+
+		if (strcmp(token, "read") == 0) {
+			standalone_pack_op(dst, SEQ_OP_READ_14A, 0, arg1 ? strtoul(arg1, NULL, 10) : 0);
+		} else if (strcmp(token, "chk") == 0) {
+			uint16_t sectors = arg1 ? strtoul(arg1, NULL, 10) : 16;
+			uint16_t type = 0;
+			if (arg2) {
+				if (strcmp(arg2, "b") == 0) type = 1;
+				else if (strcmp(arg2, "ab") == 0) type = 2;
+			}
+			standalone_pack_op(dst, SEQ_OP_CHK_KEYS, (sectors & 0xff) | (type << 8), 0);
+		} else if (strcmp(token, "sim") == 0) {
+			standalone_pack_op(dst, SEQ_OP_SIM_14A, 0, 0);
+		} else if (strcmp(token, "delay") == 0 && arg1) {
+			standalone_pack_op(dst, SEQ_OP_DELAY, 0, strtoul(arg1, NULL, 10));
+		} else if (strcmp(token, "mark") == 0 && arg1) {
+			standalone_pack_op(dst, SEQ_OP_LOG, 0, strtoul(arg1, NULL, 10));
+		} else {
+			PrintAndLog("Unknown op '%s'", token);
+			return usage_hw_standalone();
+		}
+		count++;
+	}
+
+	if (count == 0) {
+		PrintAndLog("No ops given");
+		return usage_hw_standalone();
+	}
+
+	c.arg[0] = count;
+	clearCommandBuffer();
+	SendCommand(&c);
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 1000)) {
+		PrintAndLog("Command execute timeout");
+		return 1;
+	}
+	if (resp.arg[0] == 0) {
+		PrintAndLog("Device rejected the sequence");
+		return 1;
+	}
+	PrintAndLog("Loaded %d op%s, %d run%s. Hold the button for a second to start.",
+		(int)resp.arg[0], resp.arg[0] == 1 ? "" : "s",
+		(int)resp.arg[1], resp.arg[1] == 1 ? "" : "s");
+	return 0;
+}
+
+int CmdPerf(const char *Cmd)
+{
+	char ctmp = param_getchar(Cmd, 0);
+	if (ctmp == 'h') {
+		PrintAndLog("Show client<->device communication statistics: per-command");
+		PrintAndLog("request/response latency histograms and link byte counters.");
+		PrintAndLog("Usage:  hw perf [r|a]");
+		PrintAndLog("        r - reset all counters");
+		PrintAndLog("        a - toggle adaptive (p99-derived) response timeouts");
+		return 0;
+	}
+	if (ctmp == 'r') {
+		PerfReset();
+		PrintAndLog("Comms performance counters reset");
+		return 0;
+	}
+	if (ctmp == 'a') {
+		SetAdaptiveTimeout(!GetAdaptiveTimeout());
+		PrintAndLog("Adaptive response timeouts %s", GetAdaptiveTimeout() ? "enabled" : "disabled");
+		return 0;
+	}
+	PerfPrint();
+	return 0;
+}
+
+int CmdAllocAudit(const char *Cmd)
+{
+#ifdef ALLOC_AUDIT
+	char ctmp = param_getchar(Cmd, 0);
+	if (ctmp == 'h') {
+		PrintAndLog("Show per-command heap allocation statistics: alloc/free counts,");
+		PrintAndLog("bytes handed out, net live bytes and worker-thread allocations.");
+		PrintAndLog("Usage:  hw allocaudit [r]");
+		PrintAndLog("        r - reset all counters");
+		return 0;
+	}
+	if (ctmp == 'r') {
+		alloc_audit_reset();
+		PrintAndLog("Allocation audit counters reset");
+		return 0;
+	}
+	alloc_audit_report();
+#else
+	PrintAndLog("Client was built without allocation audit support (rebuild with 'make ALLOC_AUDIT=1')");
+#endif
+	return 0;
+}
+
+int CmdSession(const char *Cmd)
+{
+	char ctmp = param_getchar(Cmd, 0);
+	char port[FILE_PATH_SIZE];
+	int index;
+
+	switch (ctmp) {
+		case '\0':
+		case 'l':
+			SessionList();
+			return 0;
+		case 'o':
+			if (param_getstr(Cmd, 1, port, sizeof(port)) < 1) {
+				PrintAndLog("Missing port name");
+				return 1;
+			}
+			index = SessionOpen(port);
+			if (index < 0) {
+				return 1;
+			}
+			PrintAndLog("Session %d opened on %s and selected", index, port);
+			return 0;
+		case 's':
+			index = param_get32ex(Cmd, 1, -1, 10);
+			if (!SessionSelect(index)) {
+				PrintAndLog("No session %d", index);
+				return 1;
+			}
+			PrintAndLog("Session %d selected", index);
+			return 0;
+		case 'c':
+			index = param_get32ex(Cmd, 1, SessionCurrent(), 10);
+			SessionClose(index);
+			PrintAndLog("Session %d closed, session %d selected", index, SessionCurrent());
+			return 0;
+		default:
+			PrintAndLog("Drive several Proxmarks from one client. Each connected device");
+			PrintAndLog("gets a session; commands are routed to the selected session.");
+			PrintAndLog("Usage:  hw session [l]           - list sessions");
+			PrintAndLog("        hw session o <port>      - open a device and select it");
+			PrintAndLog("        hw session s <n>         - select session <n>");
+			PrintAndLog("        hw session c [n]         - close session <n> (default: selected)");
+			return 0;
+	}
+}
+
+// Session recorder control. Recorded files replay against the client at
+// zero device latency by opening them as a port: proxmark3 replay:<file>
+int CmdRecord(const char *Cmd)
+{
+	char filename[FILE_PATH_SIZE];
+	int len = param_getstr(Cmd, 0, filename, sizeof(filename));
+
+	if (len < 1 || filename[0] == 'h') {
+		PrintAndLog("Record the USB command/response traffic of this session, with");
+		PrintAndLog("timing, for later replay benchmarking: proxmark3 replay:<file>");
+		PrintAndLog("Usage:  hw record <file>  - start recording to <file>");
+		PrintAndLog("        hw record off     - stop recording");
+		return 0;
+	}
+
+	if (strcmp(filename, "off") == 0) {
+		if (!SessionRecordingActive()) {
+			PrintAndLog("Not recording.");
+			return 1;
+		}
+		StopSessionRecording();
+		PrintAndLog("Recording stopped.");
+		return 0;
+	}
+
+	if (!StartSessionRecording(filename)) {
+		return 1;
+	}
+	PrintAndLog("Recording session to %s, stop with 'hw record off'.", filename);
+	return 0;
+}
+
+static command_t CommandTable[] =
 {
 	{"help",          CmdHelp,        1, "This help"},
 	{"detectreader",  CmdDetectReader,0, "['l'|'h'] -- Detect external reader field (option 'l' or 'h' to limit to LF or HF)"},
@@ -463,9 +1086,17 @@ static command_t CommandTable[] =
 	{"setlfdivisor",  CmdSetDivisor,  0, "<19 - 255> -- Drive LF antenna at 12Mhz/(divisor+1)"},
 	{"setmux",        CmdSetMux,      0, "<loraw|hiraw|lopkd|hipkd> -- Set the ADC mux to a specific value"},
 	{"tune",          CmdTune,        0, "['l'|'h'] -- Measure antenna tuning (option 'l' or 'h' to limit to LF or HF)"},
+	{"telemetry",     CmdTelemetry,   0, "[period_ms] [lf|hf] [divisor] -- Stream live antenna voltage readings to the plot window"},
+	{"journal",       CmdJournal,     0, "['c'] -- Download the device field-event journal (c = clear after download)"},
 	{"version",       CmdVersion,     0, "Show version information about the connected Proxmark"},
 	{"status",        CmdStatus,      0, "Show runtime status information about the connected Proxmark"},
+	{"flashstore",    CmdFlashStore,  0, "[i|w|r|d|k|es|el] -- Persistent key-value store in device flash"},
 	{"ping",          CmdPing,        0, "Test if the pm3 is responsive"},
+	{"standalone",    CmdStandalone,  0, "[load|results] -- Upload and collect results of a stand-alone op sequence"},
+	{"perf",          CmdPerf,        1, "[r] -- Show comms latency statistics ('r' to reset)"},
+	{"allocaudit",    CmdAllocAudit,  1, "[r] -- Show per-command heap statistics (needs ALLOC_AUDIT=1 build; 'r' to reset)"},
+	{"session",       CmdSession,     1, "[l|o <port>|s <n>|c [n]] -- List/open/select/close device sessions"},
+	{"record",        CmdRecord,      1, "[<file>|off] -- Record the command/response session for replay benchmarking"},
 	{NULL, NULL, 0, NULL}
 };
 
@@ -16,7 +16,13 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <jansson.h>
 #include "comms.h"
+#include "loclass/fileutils.h"	// for fileExists (lf profile)
 #include "lfdemod.h"     // for psk2TOpsk1
 #include "util.h"        // for parsing cli command utils
 #include "ui.h"          // for show graph controls
@@ -212,11 +218,27 @@ int usage_lf_read(void)
 }
 int usage_lf_snoop(void)
 {
-	PrintAndLog("Usage: lf snoop");
+	PrintAndLog("Usage: lf snoop [t] [pre-trigger samples]");
 	PrintAndLog("Options:        ");
 	PrintAndLog("       h            This help");
-	PrintAndLog("This function takes no arguments. ");
-	PrintAndLog("Use 'lf config' to set parameters.");
+	PrintAndLog("       t            Triggered mode: wait for the trigger threshold, keep a");
+	PrintAndLog("                    pre-trigger window (default 2000 samples) and decimate");
+	PrintAndLog("                    quiescent stretches so idle gaps don't fill the buffer");
+	PrintAndLog("Use 'lf config' to set parameters (set [t]hreshold for triggered mode).");
+	return 0;
+}
+
+int usage_lf_stream(void)
+{
+	PrintAndLog("Stream LF samples from the device while the capture keeps running.");
+	PrintAndLog("Not limited by device memory - press the button on the device to stop.");
+	PrintAndLog("The last %d samples are kept in the graph buffer.", MAX_GRAPH_TRACE_LEN);
+	PrintAndLog("Usage: lf stream [p] [# samples]");
+	PrintAndLog("Options:        ");
+	PrintAndLog("       h            This help");
+	PrintAndLog("       p            passive, keep the field off (snoop mode)");
+	PrintAndLog("       [# samples]  stop after # samples (optional, default: until button press)");
+	PrintAndLog("Use 'lf config' to set the divisor. Samples are streamed raw at 8 bits/sample.");
 	return 0;
 }
 
@@ -246,6 +268,55 @@ int usage_lf_config(void)
 	return 0;
 }
 
+// client-side mirror of the device sampling config (defaults match
+// armsrc/lfsampling.c) - this is what 'lf profile save' snapshots
+static sample_config lf_client_config = { 1, 8, 1, 95, 0, 0 };
+
+// Send a sampling config to the device. The device makes identical configs
+// a no-op and reports a generation number; if we already got this exact
+// config acknowledged, just check that the device still agrees instead of
+// re-sending the full config.
+static int lf_send_config(sample_config *config)
+{
+	static sample_config last_config;
+	static uint32_t last_generation = 0;
+
+	// mirror the device's merge rules (0 / -1 means keep), so the client
+	// copy always holds concrete values
+	if (config->divisor != 0) lf_client_config.divisor = config->divisor;
+	if (config->bits_per_sample != 0) lf_client_config.bits_per_sample = config->bits_per_sample;
+	if (config->decimation != 0) lf_client_config.decimation = config->decimation;
+	if (config->trigger_threshold != -1) lf_client_config.trigger_threshold = config->trigger_threshold;
+	if (config->samples_to_skip != -1) lf_client_config.samples_to_skip = config->samples_to_skip;
+	lf_client_config.averaging = config->averaging;
+	if (lf_client_config.bits_per_sample > 8) lf_client_config.bits_per_sample = 8;
+	if (lf_client_config.decimation < 1) lf_client_config.decimation = 1;
+	g_lf_threshold_set = lf_client_config.trigger_threshold > 0;
+
+	UsbCommand c = {CMD_SET_LF_SAMPLING_CONFIG};
+	UsbCommand resp;
+	if (!IsOffline() && last_generation != 0 && memcmp(config, &last_config, sizeof(sample_config)) == 0) {
+		c.arg[0] = 1;	// query generation only
+		clearCommandBuffer();
+		SendCommand(&c);
+		if (WaitForResponseTimeout(CMD_ACK, &resp, 1000) && resp.arg[0] == last_generation) {
+			return 0;	// device already runs this config
+		}
+		c.arg[0] = 0;	// device was reset or reconfigured - re-send
+	}
+
+	memcpy(c.d.asBytes,config,sizeof(sample_config));
+	clearCommandBuffer();
+	SendCommand(&c);
+	if (!IsOffline() && WaitForResponseTimeout(CMD_ACK, &resp, 1000)) {
+		last_config = *config;
+		last_generation = resp.arg[0];
+	} else {
+		last_generation = 0;
+	}
+	return 0;
+}
+
 int CmdLFSetConfig(const char *Cmd)
 {
 
@@ -324,16 +395,18 @@ int CmdLFSetConfig(const char *Cmd)
 	sample_config config = {
 		decimation,bps,averaging,divisor,trigger_threshold,samples_to_skip
 	};
-	//Averaging is a flag on high-bit of arg[1]
-	UsbCommand c = {CMD_SET_LF_SAMPLING_CONFIG};
-	memcpy(c.d.asBytes,&config,sizeof(sample_config));
-	clearCommandBuffer();
-	SendCommand(&c);
-	return 0;
+
+	return lf_send_config(&config);
 }
 
+// signal statistics computed by the firmware during the last acquisition:
+// (dominant zero-crossing interval in samples << 16) | number of crossings.
+// Zero when the last read produced none (offline, non-8-bit sampling).
+static uint32_t lf_acq_stats = 0;
+
 bool lf_read(bool silent, uint32_t samples) {
 	if (IsOffline()) return false;
+	lf_acq_stats = 0;
 	UsbCommand c = {CMD_ACQUIRE_RAW_ADC_SAMPLES_125K, {silent,samples,0}};
 	clearCommandBuffer();
 	//And ship it to device
@@ -348,12 +421,172 @@ bool lf_read(bool silent, uint32_t samples) {
 			return false;
 		}
 	}
+	lf_acq_stats = resp.arg[1];
+	if (g_debugMode && lf_acq_stats)
+		PrintAndLog("DEBUG: device signal stats: dominant crossing interval %u samples, %u crossings",
+				lf_acq_stats >> 16, lf_acq_stats & 0xFFFF);
 	// resp.arg[0] is bits read not bytes read.
 	getSamples(resp.arg[0]/8, silent);
 
 	return true;
 }
 
+#define LF_PROFILE_FILE "lf_profiles.json"
+
+int usage_lf_profile(void)
+{
+	PrintAndLog("Named sampling parameter profiles, persisted in %s", LF_PROFILE_FILE);
+	PrintAndLog("A profile snapshots the current 'lf config' values together with the");
+	PrintAndLog("signal statistics of the last read, so a known site's tuning is one load away.");
+	PrintAndLog("Usage: lf profile <save|load|auto|list|del> [name]");
+	PrintAndLog("       save <name>   store the active config under <name>");
+	PrintAndLog("       load <name>   apply <name> as one batched config upload");
+	PrintAndLog("       auto          apply the profile whose recorded signal statistics");
+	PrintAndLog("                     best match the last 'lf read'");
+	PrintAndLog("       list          show all stored profiles");
+	PrintAndLog("       del <name>    remove <name>");
+	return 0;
+}
+
+// read the profile file; returns a fresh root when there is none yet
+static json_t *lf_profiles_read(void)
+{
+	if (!fileExists(LF_PROFILE_FILE))
+		return json_pack("{so}", "profiles", json_object());
+
+	json_error_t err;
+	json_t *root = json_load_file(LF_PROFILE_FILE, 0, &err);
+	if (root == NULL) {
+		PrintAndLog("%s parse error on line %d: %s", LF_PROFILE_FILE, err.line, err.text);
+		return NULL;
+	}
+	if (!json_is_object(json_object_get(root, "profiles"))) {
+		json_object_set_new(root, "profiles", json_object());
+	}
+	return root;
+}
+
+// apply one stored profile through the regular batched config upload
+static int lf_profile_apply(const char *name, json_t *p)
+{
+	sample_config config = {
+		json_integer_value(json_object_get(p, "decimation")),
+		json_integer_value(json_object_get(p, "bps")),
+		json_integer_value(json_object_get(p, "averaging")),
+		json_integer_value(json_object_get(p, "divisor")),
+		json_integer_value(json_object_get(p, "trigger_threshold")),
+		json_integer_value(json_object_get(p, "samples_to_skip")),
+	};
+	PrintAndLog("Applying profile '%s': divisor %d, %d bps, decimation %d, averaging %d, threshold %d, skip %d",
+			name, config.divisor, config.bits_per_sample, config.decimation,
+			config.averaging, config.trigger_threshold, config.samples_to_skip);
+	return lf_send_config(&config);
+}
+
+int CmdLFProfile(const char *Cmd)
+{
+	char sub[16] = {0};
+	char name[64] = {0};
+
+	param_getstr(Cmd, 0, sub, sizeof(sub));
+	param_getstr(Cmd, 1, name, sizeof(name));
+
+	if (sub[0] == '\0' || sub[0] == 'h')
+		return usage_lf_profile();
+
+	json_t *root = lf_profiles_read();
+	if (root == NULL) return 1;
+	json_t *profiles = json_object_get(root, "profiles");
+
+	int res = 0;
+	if (strcmp(sub, "save") == 0 && name[0]) {
+		json_t *p = json_pack("{sisisisisisisi}",
+				"divisor", lf_client_config.divisor,
+				"bps", lf_client_config.bits_per_sample,
+				"decimation", lf_client_config.decimation,
+				"averaging", lf_client_config.averaging,
+				"trigger_threshold", lf_client_config.trigger_threshold,
+				"samples_to_skip", lf_client_config.samples_to_skip,
+				"interval", (int)(lf_acq_stats >> 16));
+		json_object_set_new(profiles, name, p);
+		if (json_dump_file(root, LF_PROFILE_FILE, JSON_INDENT(2) | JSON_SORT_KEYS)) {
+			PrintAndLog("Failed to write %s", LF_PROFILE_FILE);
+			res = 1;
+		} else {
+			PrintAndLog("Saved profile '%s' to %s%s", name, LF_PROFILE_FILE,
+					lf_acq_stats ? "" : " (no signal statistics - run 'lf read' before saving for 'auto')");
+		}
+	} else if (strcmp(sub, "load") == 0 && name[0]) {
+		json_t *p = json_object_get(profiles, name);
+		if (!json_is_object(p)) {
+			PrintAndLog("No profile '%s' in %s", name, LF_PROFILE_FILE);
+			res = 1;
+		} else {
+			res = lf_profile_apply(name, p);
+		}
+	} else if (strcmp(sub, "auto") == 0) {
+		uint32_t interval = lf_acq_stats >> 16;
+		if (interval == 0) {
+			PrintAndLog("No signal statistics yet - run 'lf read' first");
+			res = 1;
+		} else {
+			const char *key, *bestName = NULL;
+			json_t *value, *best = NULL;
+			uint32_t bestDist = 0;
+			json_object_foreach(profiles, key, value) {
+				uint32_t pi = json_integer_value(json_object_get(value, "interval"));
+				if (pi == 0) continue;	// saved without statistics
+				uint32_t dist = pi > interval ? pi - interval : interval - pi;
+				if (best == NULL || dist < bestDist) {
+					best = value;
+					bestName = key;
+					bestDist = dist;
+				}
+			}
+			if (best == NULL) {
+				PrintAndLog("No profile with recorded signal statistics in %s", LF_PROFILE_FILE);
+				res = 1;
+			} else {
+				PrintAndLog("Signal interval %u samples, closest profile '%s' (off by %u)",
+						interval, bestName, bestDist);
+				res = lf_profile_apply(bestName, best);
+			}
+		}
+	} else if (strcmp(sub, "list") == 0) {
+		const char *key;
+		json_t *value;
+		PrintAndLog(" name                 | div | bps | dec | avg | thres | skip  | interval");
+		PrintAndLog("----------------------+-----+-----+-----+-----+-------+-------+---------");
+		json_object_foreach(profiles, key, value) {
+			PrintAndLog(" %-20s | %3lld | %3lld | %3lld | %3lld | %5lld | %5lld | %8lld",
+					key,
+					json_integer_value(json_object_get(value, "divisor")),
+					json_integer_value(json_object_get(value, "bps")),
+					json_integer_value(json_object_get(value, "decimation")),
+					json_integer_value(json_object_get(value, "averaging")),
+					json_integer_value(json_object_get(value, "trigger_threshold")),
+					json_integer_value(json_object_get(value, "samples_to_skip")),
+					json_integer_value(json_object_get(value, "interval")));
+		}
+	} else if (strcmp(sub, "del") == 0 && name[0]) {
+		if (json_object_del(profiles, name)) {
+			PrintAndLog("No profile '%s' in %s", name, LF_PROFILE_FILE);
+			res = 1;
+		} else if (json_dump_file(root, LF_PROFILE_FILE, JSON_INDENT(2) | JSON_SORT_KEYS)) {
+			PrintAndLog("Failed to write %s", LF_PROFILE_FILE);
+			res = 1;
+		} else {
+			PrintAndLog("Removed profile '%s'", name);
+		}
+	} else {
+		json_decref(root);
+		return usage_lf_profile();
+	}
+
+	json_decref(root);
+	return res;
+}
+
 int CmdLFRead(const char *Cmd)
 {
 	uint8_t cmdp = 0;
@@ -379,6 +612,10 @@ int CmdLFSnoop(const char *Cmd)
 	}
 
 	UsbCommand c = {CMD_LF_SNOOP_RAW_ADC_SAMPLES};
+	if (param_getchar(Cmd, cmdp) == 't') {
+		c.cmd = CMD_LF_SNOOP_SMART_ADC_SAMPLES;
+		c.arg[0] = param_get32ex(Cmd, cmdp + 1, 2000, 10);
+	}
 	clearCommandBuffer();
 	SendCommand(&c);
 	WaitForResponse(CMD_ACK,NULL);
@@ -387,6 +624,71 @@ int CmdLFSnoop(const char *Cmd)
 	return 0;
 }
 
+int CmdLFStream(const char *Cmd)
+{
+	uint8_t cmdp = 0;
+	bool activeField = true;
+	if (param_getchar(Cmd, cmdp) == 'h')
+		return usage_lf_stream();
+	if (param_getchar(Cmd, cmdp) == 'p') {
+		activeField = false;
+		cmdp++;
+	}
+	uint32_t samples = param_get32ex(Cmd, cmdp, 0, 10);
+
+	// rolling window over the stream, keeping the most recent samples
+	uint8_t *window = malloc(MAX_GRAPH_TRACE_LEN);
+	if (window == NULL) return 1;
+	size_t wpos = 0;
+	bool wrapped = false;
+	uint64_t total = 0;
+
+	UsbCommand c = {CMD_LF_STREAM_RAW_ADC_SAMPLES, {activeField, samples, 0}};
+	clearCommandBuffer();
+	SendCommand(&c);
+
+	// chunks arrive as CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K, a final ACK
+	// carries the total sample count
+	PrintAndLog("Streaming... press the button on the device to stop");
+	UsbCommand resp;
+	for (;;) {
+		if (!WaitForResponseTimeoutW(CMD_UNKNOWN, &resp, 10000, false)) {
+			PrintAndLog("Stream timed out after %" PRIu64 " samples", total);
+			break;
+		}
+		if (resp.cmd == CMD_ACK) {
+			PrintAndLog("Done, streamed %" PRIu64 " samples", (uint64_t)resp.arg[0]);
+			break;
+		}
+		if (resp.cmd != CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K) continue;
+
+		uint32_t len = resp.arg[1];
+		if (len > USB_CMD_DATA_SIZE) len = USB_CMD_DATA_SIZE;
+		for (uint32_t i = 0; i < len; i++) {
+			window[wpos++] = resp.d.asBytes[i];
+			if (wpos >= MAX_GRAPH_TRACE_LEN) {
+				wpos = 0;
+				wrapped = true;
+			}
+		}
+		total += len;
+	}
+
+	// unroll the window into the graph buffer in chronological order
+	size_t n = wrapped ? MAX_GRAPH_TRACE_LEN : wpos;
+	size_t start = wrapped ? wpos : 0;
+	for (size_t j = 0; j < n; j++) {
+		GraphBuffer[j] = ((int)window[(start + j) % MAX_GRAPH_TRACE_LEN]) - 128;
+	}
+	GraphTraceLen = n;
+	free(window);
+
+	setClockGrid(0,0);
+	DemodBufferLen = 0;
+	RepaintGraphWindow();
+	return 0;
+}
+
 static void ChkBitstream(const char *str)
 {
 	int i;
@@ -785,6 +1087,155 @@ int CmdLFpskSim(const char *Cmd)
 	return 0;
 }
 
+int usage_lf_simsynth(void)
+{
+	//print help
+	PrintAndLog("On-device waveform synthesis: the device expands a packed bit template");
+	PrintAndLog("instead of replaying an uploaded buffer. An optional field of the template");
+	PrintAndLog("is refilled from a seeded PRNG before every repetition (rolling code sim).");
+	PrintAndLog("Usage: lf simsynth [c <clock>] [i] [m|r|b|p|f] [R <carrier>] [H <fcHigh>] [L <fcLow>] [o <offset> w <width>] [s <seed>] d <hexdata>");
+	PrintAndLog("Options:        ");
+	PrintAndLog("       h              This help");
+	PrintAndLog("       c <clock>      Set clock - default: 64");
+	PrintAndLog("       i              invert data");
+	PrintAndLog("       m              ask/manchester - default");
+	PrintAndLog("       r              ask/raw (nrz)");
+	PrintAndLog("       b              ask/biphase");
+	PrintAndLog("       p              psk1");
+	PrintAndLog("       f              fsk");
+	PrintAndLog("       R <carrier>    psk carrier: 2|4|8 - default: 2");
+	PrintAndLog("       H <fcHigh>     fsk larger Field Clock - default: 10");
+	PrintAndLog("       L <fcLow>      fsk smaller Field Clock - default: 8");
+	PrintAndLog("       o <offset>     bit offset of the mutating field");
+	PrintAndLog("       w <width>      width of the mutating field in bits (max 32, 0 = static)");
+	PrintAndLog("       s <seed>       PRNG seed for the mutating field");
+	PrintAndLog("       d <hexdata>    Bit template to sim as hex");
+	return 0;
+}
+
+// upload a compact symbol description and let the device synthesize the
+// waveform - see CmdLFSynthSim in armsrc/lfops.c
+int CmdLFsynthSim(const char *Cmd)
+{
+	uint8_t modulation = 0, clk = 0, carrier = 0, fcHigh = 0, fcLow = 0;
+	uint8_t invert = 0, width = 0;
+	uint32_t offset = 0, seed = 0;
+	bool errors = false;
+	char hexData[129] = {0x00};
+	uint8_t data[512] = {0x00};
+	int dataLen = 0;
+	uint8_t cmdp = 0;
+	while(param_getchar(Cmd, cmdp) != 0x00)
+	{
+		switch(param_getchar(Cmd, cmdp))
+		{
+		case 'h':
+			return usage_lf_simsynth();
+		case 'i':
+			invert = 1;
+			cmdp++;
+			break;
+		case 'm':
+			modulation = 0;
+			cmdp++;
+			break;
+		case 'r':
+			modulation = 1;
+			cmdp++;
+			break;
+		case 'b':
+			modulation = 2;
+			cmdp++;
+			break;
+		case 'p':
+			modulation = 3;
+			cmdp++;
+			break;
+		case 'f':
+			modulation = 4;
+			cmdp++;
+			break;
+		case 'c':
+			errors |= param_getdec(Cmd,cmdp+1,&clk);
+			cmdp+=2;
+			break;
+		case 'R':
+			errors |= param_getdec(Cmd,cmdp+1,&carrier);
+			cmdp+=2;
+			break;
+		case 'H':
+			errors |= param_getdec(Cmd,cmdp+1,&fcHigh);
+			cmdp+=2;
+			break;
+		case 'L':
+			errors |= param_getdec(Cmd,cmdp+1,&fcLow);
+			cmdp+=2;
+			break;
+		case 'o':
+			offset = param_get32ex(Cmd,cmdp+1,0,10);
+			cmdp+=2;
+			break;
+		case 'w':
+			errors |= param_getdec(Cmd,cmdp+1,&width);
+			cmdp+=2;
+			break;
+		case 's':
+			seed = param_get32ex(Cmd,cmdp+1,0,16);
+			cmdp+=2;
+			break;
+		case 'd':
+			dataLen = param_getstr(Cmd, cmdp+1, hexData, sizeof(hexData));
+			if (dataLen==0) {
+				errors=true;
+			} else {
+				dataLen = hextobinarray((char *)data, hexData);
+			}
+			if (dataLen==0) errors=true;
+			if (errors) PrintAndLog ("Error getting hex data");
+			cmdp+=2;
+			break;
+		default:
+			PrintAndLog("Unknown parameter '%c'", param_getchar(Cmd, cmdp));
+			errors = true;
+			break;
+		}
+		if(errors) break;
+	}
+	if (dataLen == 0) errors = true; // template is mandatory
+
+	//Validations
+	if (errors)
+	{
+		return usage_lf_simsynth();
+	}
+	if (clk == 0) clk = 64;
+	if (carrier == 0) carrier = 2;
+	if (fcHigh == 0) fcHigh = 10;
+	if (fcLow == 0) fcLow = 8;
+	if (modulation == 4) carrier = fcHigh << 4 | fcLow;
+	if (width > 32) width = 32;
+	if (offset + width > (uint32_t)dataLen) {
+		PrintAndLog("Mutating field (offset %u, width %u) does not fit in %d bits", offset, width, dataLen);
+		return usage_lf_simsynth();
+	}
+
+	UsbCommand c = {CMD_LF_SYNTH_SIM, {0, 0, seed}};
+	c.arg[0] = modulation | clk << 8 | carrier << 16 | (uint32_t)invert << 24;
+	c.arg[1] = dataLen | offset << 16;
+	memset(c.d.asBytes, 0, USB_CMD_DATA_SIZE);
+	c.d.asBytes[0] = width;
+	// pack the template MSB first, 8 bits per byte
+	for (int i = 0; i < dataLen; i++) {
+		if (data[i])
+			c.d.asBytes[4 + (i >> 3)] |= 1 << (7 - (i & 7));
+	}
+	PrintAndLog("Simulating on device: mod %u, clk %u, %d bits%s", modulation, clk, dataLen,
+		width ? " (mutating)" : "");
+	clearCommandBuffer();
+	SendCommand(&c);
+	return 0;
+}
+
 int CmdLFSimBidir(const char *Cmd)
 {
 	// Set ADC to twice the carrier for a slight supersampling
@@ -901,6 +1352,218 @@ int CheckChipType(char cmdp) {
 }
 
 //by marshmellow
+// Parallel modulation prefilter for lf search. The demodulators themselves
+// share global state (DemodBuffer, graph repaints) and have to run
+// sequentially, but the clock/modulation detectors in lfdemod.c are pure
+// functions. Snapshot the graph buffer once and probe all modulations
+// concurrently, then only walk the demod families that plausibly match.
+typedef struct {
+	uint8_t *bits;
+	size_t size;
+	bool detected;
+} lf_probe_arg_t;
+
+static void *lf_probe_fsk(void *x)
+{
+	lf_probe_arg_t *probe = (lf_probe_arg_t *)x;
+	uint16_t fcs = countFC(probe->bits, probe->size, 1);
+	uint8_t fc1 = fcs >> 8;
+	uint8_t fc2 = fcs & 0xFF;
+	// the only valid field clock pairs (same test as fskClocks())
+	probe->detected = ((fc1 == 10 && fc2 == 8) || (fc1 == 8 && fc2 == 5));
+	return NULL;
+}
+
+static void *lf_probe_ask(void *x)
+{
+	lf_probe_arg_t *probe = (lf_probe_arg_t *)x;
+	int clock = 0;
+	probe->detected = (DetectASKClock(probe->bits, probe->size, &clock, 5) >= 0 && clock > 0);
+	return NULL;
+}
+
+static void *lf_probe_psk(void *x)
+{
+	lf_probe_arg_t *probe = (lf_probe_arg_t *)x;
+	size_t firstPhaseShift = 0;
+	uint8_t curPhase = 0, fc = 0;
+	probe->detected = (DetectPSKClock(probe->bits, probe->size, 0, &firstPhaseShift, &curPhase, &fc) > 0);
+	return NULL;
+}
+
+static void *lf_probe_nrz(void *x)
+{
+	lf_probe_arg_t *probe = (lf_probe_arg_t *)x;
+	size_t clkStartIdx = 0;
+	probe->detected = (DetectNRZClock(probe->bits, probe->size, 0, &clkStartIdx) > 0);
+	return NULL;
+}
+
+static void lf_probe_modulations(bool *fsk, bool *ask, bool *psk, bool *nrz)
+{
+	uint8_t *bits = malloc(MAX_GRAPH_TRACE_LEN);
+	if (bits == NULL) {
+		return;	// keep the defaults and try everything
+	}
+	size_t size = getFromGraphBuf(bits);
+	if (size < 1000) {
+		free(bits);
+		return;
+	}
+
+	void *(*probe_fn[4])(void *) = {lf_probe_fsk, lf_probe_ask, lf_probe_psk, lf_probe_nrz};
+	lf_probe_arg_t probes[4];
+	pthread_t threads[4];
+	for (int i = 0; i < 4; i++) {
+		// every probe gets its own snapshot - some detectors smooth in place
+		probes[i].bits = malloc(size);
+		probes[i].size = size;
+		probes[i].detected = (probes[i].bits == NULL);	// can't rule out without probing
+		if (probes[i].bits != NULL) {
+			memcpy(probes[i].bits, bits, size);
+			pthread_create(&threads[i], NULL, probe_fn[i], &probes[i]);
+		}
+	}
+	for (int i = 0; i < 4; i++) {
+		if (probes[i].bits != NULL) {
+			pthread_join(threads[i], NULL);
+		}
+	}
+
+	// only narrow the sweep when at least one modulation looks plausible -
+	// a completely negative probe means the detectors are unsure, not that
+	// there is nothing to find
+	if (probes[0].detected || probes[1].detected || probes[2].detected || probes[3].detected) {
+		*fsk = probes[0].detected;
+		*ask = probes[1].detected;
+		*psk = probes[2].detected;
+		*nrz = probes[3].detected;
+	}
+
+	for (int i = 0; i < 4; i++) {
+		free(probes[i].bits);
+	}
+	free(bits);
+}
+
+// demod family sweeps for lf search, split out so the scheduler can order
+// them by prior success. Each returns true when a tag was found and leaves
+// the value to return from lf search in *ret; the demods themselves keep
+// the classic order within a family.
+enum { LF_FAM_FSK, LF_FAM_ASK, LF_FAM_PSK, LF_FAM_NRZ, LF_FAM_COUNT };
+
+// per-session hit counters used to schedule the family sweeps
+static unsigned int lf_family_hits[LF_FAM_COUNT] = {0};
+
+static bool lf_search_fsk(char cmdp, int *ret)
+{
+	if (CmdFSKdemodIO("") > 0) {
+		PrintAndLog("\nValid IO Prox ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdFSKdemodPyramid("") > 0) {
+		PrintAndLog("\nValid Pyramid ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdFSKdemodParadox("") > 0) {
+		PrintAndLog("\nValid Paradox ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdFSKdemodAWID("") > 0) {
+		PrintAndLog("\nValid AWID ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdFSKdemodHID("") > 0) {
+		PrintAndLog("\nValid HID Prox ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	return false;
+}
+
+static bool lf_search_ask(char cmdp, int *ret)
+{
+	if (CmdAskEM410xDemod("") > 0) {
+		PrintAndLog("\nValid EM410x ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdVisa2kDemod("") > 0) {
+		PrintAndLog("\nValid Visa2000 ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdG_Prox_II_Demod("") > 0) {
+		PrintAndLog("\nValid G Prox II ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdFdxDemod("") > 0) { //biphase
+		PrintAndLog("\nValid FDX-B ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (EM4x50Read("", false) > 0) { //ask
+		PrintAndLog("\nValid EM4x50 ID Found!");
+		*ret = 1;
+		return true;
+	}
+	if (CmdJablotronDemod("") > 0) {
+		PrintAndLog("\nValid Jablotron ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdNoralsyDemod("") > 0) {
+		PrintAndLog("\nValid Noralsy ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdSecurakeyDemod("") > 0) {
+		PrintAndLog("\nValid Securakey ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdVikingDemod("") > 0) {
+		PrintAndLog("\nValid Viking ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	return false;
+}
+
+static bool lf_search_psk(char cmdp, int *ret)
+{
+	if (CmdIndalaDecode("") > 0) { //psk
+		PrintAndLog("\nValid Indala ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	if (CmdPSKNexWatch("") > 0) {
+		PrintAndLog("\nValid NexWatch ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	return false;
+}
+
+static bool lf_search_nrz(char cmdp, int *ret)
+{
+	if (CmdPacDemod("") > 0) {
+		PrintAndLog("\nValid PAC/Stanley ID Found!");
+		*ret = CheckChipType(cmdp);
+		return true;
+	}
+	return false;
+}
+
+static bool (*const lf_family_fns[LF_FAM_COUNT])(char, int *) = {
+	lf_search_fsk, lf_search_ask, lf_search_psk, lf_search_nrz
+};
+
 int CmdLFfind(const char *Cmd)
 {
 	uint32_t wordData = 0;
@@ -957,108 +1620,51 @@ int CmdLFfind(const char *Cmd)
 		return 0;
 	}
 
-	// TODO test for modulation then only test formats that use that modulation
-
-	ans=CmdFSKdemodIO("");
-	if (ans>0) {
-		PrintAndLog("\nValid IO Prox ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdFSKdemodPyramid("");
-	if (ans>0) {
-		PrintAndLog("\nValid Pyramid ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdFSKdemodParadox("");
-	if (ans>0) {
-		PrintAndLog("\nValid Paradox ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdFSKdemodAWID("");
-	if (ans>0) {
-		PrintAndLog("\nValid AWID ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdFSKdemodHID("");
-	if (ans>0) {
-		PrintAndLog("\nValid HID Prox ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdAskEM410xDemod("");
-	if (ans>0) {
-		PrintAndLog("\nValid EM410x ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdVisa2kDemod("");
-	if (ans>0) {
-		PrintAndLog("\nValid Visa2000 ID Found!");
-		return CheckChipType(cmdp);		
-	}
-	
-	ans=CmdG_Prox_II_Demod("");
-	if (ans>0) {
-		PrintAndLog("\nValid G Prox II ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdFdxDemod(""); //biphase
-	if (ans>0) {
-		PrintAndLog("\nValid FDX-B ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=EM4x50Read("", false); //ask
-	if (ans>0) {
-		PrintAndLog("\nValid EM4x50 ID Found!");
-		return 1;
-	}
-
-	ans=CmdJablotronDemod("");
-	if (ans>0) {
-		PrintAndLog("\nValid Jablotron ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdNoralsyDemod("");
-	if (ans>0) {
-		PrintAndLog("\nValid Noralsy ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdSecurakeyDemod("");
-	if (ans>0) {
-		PrintAndLog("\nValid Securakey ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdVikingDemod("");
-	if (ans>0) {
-		PrintAndLog("\nValid Viking ID Found!");
-		return CheckChipType(cmdp);
-	}
-
-	ans=CmdIndalaDecode(""); //psk
-	if (ans>0) {
-		PrintAndLog("\nValid Indala ID Found!");
-		return CheckChipType(cmdp);
+	// probe the modulations concurrently, then only test formats that use
+	// a modulation which looks plausible for this capture
+	bool try_fsk = true, try_ask = true, try_psk = true, try_nrz = true;
+	lf_probe_modulations(&try_fsk, &try_ask, &try_psk, &try_nrz);
+
+	// schedule the family sweeps: plausible modulations only, ordered by
+	// how often each family produced the hit earlier in this session, with
+	// the firmware's acquisition stats as a tie-break (a short dominant
+	// crossing interval is an FSK tell, long intervals point at ASK/NRZ
+	// envelopes). Order never affects which demods run, only who gets the
+	// first shot, so single-protocol captures behave exactly as before.
+	bool enabled[LF_FAM_COUNT];
+	enabled[LF_FAM_FSK] = try_fsk;
+	enabled[LF_FAM_ASK] = try_ask;
+	enabled[LF_FAM_PSK] = try_psk;
+	enabled[LF_FAM_NRZ] = try_nrz;
+
+	int score[LF_FAM_COUNT];
+	for (int f = 0; f < LF_FAM_COUNT; f++)
+		score[f] = 2 * lf_family_hits[f];
+	uint32_t dominant = (!IsOffline() && cmdp != '1') ? lf_acq_stats >> 16 : 0;
+	if (dominant >= 1 && dominant <= 6)
+		score[LF_FAM_FSK] += 1;
+	else if (dominant >= 12) {
+		score[LF_FAM_ASK] += 1;
+		score[LF_FAM_NRZ] += 1;
 	}
 
-	ans=CmdPSKNexWatch("");
-	if (ans>0) {
-		PrintAndLog("\nValid NexWatch ID Found!");
-		return CheckChipType(cmdp);
+	int order[LF_FAM_COUNT] = {LF_FAM_FSK, LF_FAM_ASK, LF_FAM_PSK, LF_FAM_NRZ};
+	for (int k = 1; k < LF_FAM_COUNT; k++) {	// stable: ties keep the classic order
+		int fam = order[k], pos = k;
+		while (pos > 0 && score[order[pos-1]] < score[fam]) {
+			order[pos] = order[pos-1];
+			--pos;
+		}
+		order[pos] = fam;
 	}
 
-	ans=CmdPacDemod("");
-	if (ans>0) {
-		PrintAndLog("\nValid PAC/Stanley ID Found!");
-		return CheckChipType(cmdp);		
+	for (int k = 0; k < LF_FAM_COUNT; k++) {
+		int fam = order[k];
+		int ret = 0;
+		if (enabled[fam] && lf_family_fns[fam](cmdp, &ret)) {
+			lf_family_hits[fam]++;
+			return ret;
+		}
 	}
 
 	PrintAndLog("\nNo Known Tags Found!\n");
@@ -1096,7 +1702,102 @@ int CmdLFfind(const char *Cmd)
 	return 0;
 }
 
-static command_t CommandTable[] = 
+// load one saved trace and run the full offline demod pipeline over it;
+// returns 1 if a valid known tag was found
+static int CmdLFBatchFile(const char *path, bool unknown)
+{
+	PrintAndLog("");
+	PrintAndLog("--- %s", path);
+	CmdLoad(path);
+	if (GraphTraceLen < 1000) {
+		PrintAndLog("not enough samples, skipped");
+		return 0;
+	}
+	return CmdLFfind(unknown ? "1 u" : "1");
+}
+
+
+static int compare_filenames(const void *a, const void *b)
+{
+	return strcmp((const char *)a, (const char *)b);
+}
+
+
+int CmdLFBatch(const char *Cmd)
+{
+	char path[FILE_PATH_SIZE] = {0x00};
+	char cmdp = param_getchar(Cmd, 0);
+	if (cmdp == 0x00 || cmdp == 'h' || cmdp == 'H') {
+		PrintAndLog("Usage:  lf batch <file|directory> ['u']");
+		PrintAndLog("     Replay saved traces through the full offline demod pipeline, no device needed.");
+		PrintAndLog("     A directory is processed file by file (*.pm3), in name order.");
+		PrintAndLog("     [u] also search for unknown tags, like 'lf search u'");
+		PrintAndLog("");
+		PrintAndLog("    sample: lf batch ../traces");
+		PrintAndLog("          : lf batch ../traces/EM4102-1.pm3 u");
+		return 0;
+	}
+	param_getstr(Cmd, 0, path, sizeof(path));
+	char testRaw = param_getchar(Cmd, 1);
+	bool unknown = (testRaw == 'u' || testRaw == 'U');
+
+	struct stat st;
+	if (stat(path, &st) != 0) {
+		PrintAndLog("couldn't open '%s'", path);
+		return 0;
+	}
+
+	uint16_t num_files = 0;
+	uint16_t num_found = 0;
+	if (S_ISDIR(st.st_mode)) {
+		DIR *dir = opendir(path);
+		if (dir == NULL) {
+			PrintAndLog("couldn't open directory '%s'", path);
+			return 0;
+		}
+		// collect and sort the trace file names for reproducible output
+		size_t max_files = 1024;
+		char (*names)[FILE_PATH_SIZE] = calloc(max_files, FILE_PATH_SIZE);
+		if (names == NULL) {
+			closedir(dir);
+			return 0;
+		}
+		size_t num_names = 0;
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL && num_names < max_files) {
+			size_t name_len = strlen(entry->d_name);
+			if (name_len < 4 || strcmp(entry->d_name + name_len - 4, ".pm3") != 0) {
+				continue;
+			}
+			if (strlen(path) + 1 + name_len >= FILE_PATH_SIZE) {
+				PrintAndLog("path too long, skipping %s", entry->d_name);
+				continue;
+			}
+			strcpy(names[num_names], entry->d_name);
+			num_names++;
+		}
+		closedir(dir);
+		qsort(names, num_names, FILE_PATH_SIZE, compare_filenames);
+
+		for (size_t i = 0; i < num_names; i++) {
+			char filepath[FILE_PATH_SIZE];
+			sprintf(filepath, "%s/%s", path, names[i]);
+			num_found += CmdLFBatchFile(filepath, unknown);
+			num_files++;
+		}
+		free(names);
+	} else {
+		num_found += CmdLFBatchFile(path, unknown);
+		num_files++;
+	}
+
+	PrintAndLog("");
+	PrintAndLog("Batch decode: %u file(s), %u with a valid known tag", num_files, num_found);
+	return 0;
+}
+
+
+static command_t CommandTable[] =
 {
 	{"help",        CmdHelp,            1, "This help"},
 	{"awid",        CmdLFAWID,          1, "{ AWID RFIDs...              }"},
@@ -1121,17 +1822,21 @@ static command_t CommandTable[] =
 	{"ti",          CmdLFTI,            1, "{ TI CHIPs...                }"},
 	{"viking",      CmdLFViking,        1, "{ Viking RFIDs...            }"},
 	{"visa2000",    CmdLFVisa2k,        1, "{ Visa2000 RFIDs...          }"},
+	{"batch",       CmdLFBatch,         1, "<file|directory> ['u'] -- Replay saved traces through the offline demod pipeline"},
 	{"cmdread",     CmdLFCommandRead,   0, "<d period> <z period> <o period> <c command> ['H'] -- Modulate LF reader field to send command before read (all periods in microseconds) (option 'H' for 134)"},
 	{"config",      CmdLFSetConfig,     0, "Set config for LF sampling, bit/sample, decimation, frequency"},
 	{"flexdemod",   CmdFlexdemod,       1, "Demodulate samples for FlexPass"},
+	{"profile",     CmdLFProfile,       1, "<save|load|auto|list|del> [name] -- Named 'lf config' profiles, persisted in lf_profiles.json"},
 	{"read",        CmdLFRead,          0, "['s' silent] Read 125/134 kHz LF ID-only tag. Do 'lf read h' for help"},
 	{"search",      CmdLFfind,          1, "[offline] ['u'] Read and Search for valid known tag (in offline mode it you can load first then search) - 'u' to search for unknown tags"},
 	{"sim",         CmdLFSim,           0, "[GAP] -- Simulate LF tag from buffer with optional GAP (in microseconds)"},
 	{"simask",      CmdLFaskSim,        0, "[clock] [invert <1|0>] [biphase/manchester/raw <'b'|'m'|'r'>] [msg separator 's'] [d <hexdata>] -- Simulate LF ASK tag from demodbuffer or input"},
 	{"simfsk",      CmdLFfskSim,        0, "[c <clock>] [i] [H <fcHigh>] [L <fcLow>] [d <hexdata>] -- Simulate LF FSK tag from demodbuffer or input"},
 	{"simpsk",      CmdLFpskSim,        0, "[1|2|3] [c <clock>] [i] [r <carrier>] [d <raw hex to sim>] -- Simulate LF PSK tag from demodbuffer or input"},
+	{"simsynth",    CmdLFsynthSim,      0, "[c <clock>] [i] [m|r|b|p|f] [o <offset> w <width>] [s <seed>] d <hexdata> -- Synthesize LF waveform on device, with optional per-repetition PRNG field"},
 	{"simbidir",    CmdLFSimBidir,      0, "Simulate LF tag (with bidirectional data transmission between reader and tag)"},
 	{"snoop",       CmdLFSnoop,         0, "['l'|'h'|<divisor>] [trigger threshold]-- Snoop LF (l:125khz, h:134khz)"},
+	{"stream",      CmdLFStream,        0, "['p'] [# samples] -- Stream LF samples while capturing, not limited by device memory"},
 	{"vchdemod",    CmdVchDemod,        1, "['clone'] -- Demodulate samples for VeriChip"},
 	{NULL, NULL, 0, NULL}
 };
@@ -21,13 +21,17 @@ extern int CmdFlexdemod(const char *Cmd);
 extern int CmdIndalaDemod(const char *Cmd);
 extern int CmdIndalaClone(const char *Cmd);
 extern int CmdLFRead(const char *Cmd);
+extern int CmdLFProfile(const char *Cmd);
 extern int CmdLFSim(const char *Cmd);
 extern int CmdLFaskSim(const char *Cmd);
 extern int CmdLFfskSim(const char *Cmd);
 extern int CmdLFpskSim(const char *Cmd);
+extern int CmdLFsynthSim(const char *Cmd);
 extern int CmdLFSimBidir(const char *Cmd);
 extern int CmdLFSnoop(const char *Cmd);
+extern int CmdLFStream(const char *Cmd);
 extern int CmdVchDemod(const char *Cmd);
+extern int CmdLFBatch(const char *Cmd);
 extern int CmdLFfind(const char *Cmd);
 extern bool lf_read(bool silent, uint32_t samples);
 
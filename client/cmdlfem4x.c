@@ -37,7 +37,33 @@ int CmdEMdemodASK(const char *Cmd)
 	UsbCommand c={CMD_EM410X_DEMOD};
 	c.arg[0]=findone;
 	SendCommand(&c);
-	return 0;
+
+	if (!findone) return 0;
+
+	// the device samples, demodulates and checks parity on its own, and
+	// answers with just the decoded ID - one small response instead of a
+	// sample buffer download
+	while (true) {
+		UsbCommand resp;
+		if (WaitForResponseTimeout(CMD_ACK, &resp, 1000)) {
+			if (resp.arg[0]) {
+				g_em410xId = resp.arg[2];
+				printEM410x(resp.arg[1], resp.arg[2]);
+				return 0;
+			}
+			PrintAndLog("no EM410x tag found");
+			return 1;
+		}
+		if (ukbhit()) {
+			getchar();
+			printf("\naborted via keyboard!\n");
+			// any USB traffic makes the sampling loop on the device exit
+			UsbCommand ping = {CMD_PING};
+			SendCommand(&ping);
+			while (WaitForResponseTimeout(CMD_ACK, NULL, 500)) {}
+			return 1;
+		}
+	}
 }
 
 //by marshmellow
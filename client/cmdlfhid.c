@@ -198,6 +198,57 @@ int CmdHIDReadFSK(const char *Cmd)
   return 0;
 }
 
+// passive badge-read logger: the device demods and deduplicates on its own
+// and streams one small timestamped event per read, so no sample download
+// or tethered demod work is needed
+int CmdHIDBeacon(const char *Cmd)
+{
+  char ctmp = param_getchar(Cmd, 0);
+  if (ctmp == 'h' || ctmp == 'H') {
+    PrintAndLog("Usage:  lf hid beacon");
+    PrintAndLog("The device FSK-demods HID frames continuously, suppresses the");
+    PrintAndLog("~30/s repeats of a tag sitting in the field and streams one");
+    PrintAndLog("timestamped event per read. Press any key (or the pm3 button)");
+    PrintAndLog("to stop.");
+    return 0;
+  }
+
+  UsbCommand c = {CMD_HID_BEACON};
+  clearCommandBuffer();
+  SendCommand(&c);
+  PrintAndLog("Logging HID reads, press any key to stop");
+
+  UsbCommand resp;
+  for (;;) {
+    if (!WaitForResponseTimeoutW(CMD_UNKNOWN, &resp, 1000, false)) {
+      if (ukbhit()) {
+        getchar();
+        // any command wakes the device out of the beacon loop
+        UsbCommand ping = {CMD_PING};
+        clearCommandBuffer();
+        SendCommand(&ping);
+      }
+      continue;
+    }
+    if (resp.cmd == CMD_HID_BEACON_EVENT) {
+      uint32_t ts = resp.arg[0];
+      uint32_t hi2 = resp.arg[1] >> 32;
+      uint32_t hi = resp.arg[1] & 0xffffffff;
+      uint32_t lo = resp.arg[2] & 0xffffffff;
+      if (hi2 != 0)
+        PrintAndLog("%10u ms: TAG ID: %x%08x%08x (%u)", ts, hi2, hi, lo, (lo >> 1) & 0xFFFF);
+      else
+        PrintAndLog("%10u ms: TAG ID: %x%08x (%u)", ts, hi, lo, (lo >> 1) & 0xFFFF);
+      continue;
+    }
+    if (resp.cmd == CMD_ACK) {
+      PrintAndLog("Done. %u duplicate transmissions suppressed", (uint32_t)resp.arg[2]);
+      break;
+    }
+  }
+  return 0;
+}
+
 int CmdHIDSim(const char *Cmd)
 {
   uint32_t hi2 = 0, hi = 0, lo = 0;
@@ -280,6 +331,7 @@ static command_t CommandTable[] =
   {"help",      CmdHelp,        1, "This help"},
   {"demod",     CmdFSKdemodHID, 1, "Demodulate HID Prox from GraphBuffer"},
   {"read",      CmdHIDReadFSK,  0, "['1'] Realtime HID FSK Read from antenna (option '1' for one tag only)"},
+  {"beacon",    CmdHIDBeacon,   0, "Passive on-device read logger, streams decoded frames with timestamps"},
   {"sim",       CmdHIDSim,      0, "<ID> -- HID tag simulator"},
   {"clone",     CmdHIDClone,    0, "<ID> -- Clone HID to T55x7 (tag must be in antenna)"},
   {"decode",    CmdHIDDecode,   1, "<ID> -- Try to decode an HID tag and show its contents"},
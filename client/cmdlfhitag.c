@@ -13,13 +13,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include "comms.h"
 #include "ui.h"
 #include "cmdparser.h"
 #include "common.h"
 #include "util.h"
+#include "util_posix.h"
 #include "parity.h"
 #include "hitag.h"
+#include "hitag2crack.h"
+#include "workqueue.h"
 #include "cmdmain.h"
 
 static size_t nbytes(size_t nbits) {
@@ -358,6 +362,35 @@ int CmdLFHitagReader(const char *Cmd) {
 
 	uint32_t id = bytes_to_num(resp.d.asBytes,4);
 
+	if (htf >= 01 && htf <= 04) { // Hitag S: the device streams back the pages it read
+		uint32_t startpage = resp.arg[1];
+		uint32_t num_pages = resp.arg[2];
+		if (num_pages == 0 || num_pages > 64) {
+			PrintAndLogEx(WARNING, "no page data received");
+			return 1;
+		}
+		for (uint32_t i = 0; i < num_pages; i++) {
+			uint8_t *page = resp.d.asBytes + i * 4;
+			PrintAndLog("Page[%2d]: %02X %02X %02X %02X", startpage + i,
+					page[3], page[2], page[1], page[0]);
+		}
+
+		char filename[256];
+		FILE* pf = NULL;
+		uint32_t uid = bytes_to_num(resp.d.asBytes, 4);
+
+		sprintf(filename, "%08x_%04x.hts", uid, (rand() & 0xffff));
+		if ((pf = fopen(filename, "wb")) == NULL) {
+			PrintAndLog("Error: Could not open file [%s]", filename);
+			return 1;
+		}
+		fwrite(resp.d.asBytes, 1, num_pages * 4, pf);
+		fclose(pf);
+
+		PrintAndLog("Succesfully saved tag memory to [%s]", filename);
+		return 0;
+	}
+
 	if (htf == RHT2F_UID_ONLY){
 		PrintAndLog("Valid Hitag2 tag found - UID: %08x",id);
 	} else {
@@ -449,6 +482,64 @@ static int CmdLFHitagCheckChallenges(const char *Cmd) {
 }
 
 
+static int CmdLFHitagCrack(const char *Cmd) {
+	char ctmp = param_getchar(Cmd, 0);
+	if (ctmp == '\0' || ctmp == 'h' || ctmp == 'H') {
+		PrintAndLog("Search for the Hitag2 key matching a sniffed reader authentication.");
+		PrintAndLog("All candidates in the window are tested 64 at a time (bitsliced) on all cores.");
+		PrintAndLog("Usage:   lf hitag crack <uid> <nr> <ar> [<nr2> <ar2> [<bits> [<keystart>]]]");
+		PrintAndLog("Options:");
+		PrintAndLog("       uid        tag UID (hex)");
+		PrintAndLog("       nr  ar     sniffed reader nonce and answer (hex, wire order)");
+		PrintAndLog("       nr2 ar2    second sniffed pair used to verify candidates, set to 0 0 if unavailable");
+		PrintAndLog("       bits       width of the key window to search, default 48 = the full keyspace (slow!)");
+		PrintAndLog("       keystart   supplies the key bits above the window, format as 'lf hitag reader 23'");
+		PrintAndLog("Examples:");
+		PrintAndLog("         lf hitag crack 12345678 deadbeef 01020304 cafebabe 05060708");
+		PrintAndLog("         lf hitag crack 12345678 deadbeef 01020304 0 0 32 4f4e4d490000");
+		return 0;
+	}
+
+	hitag2crack_t job = {0};
+	job.uid = param_get32ex(Cmd, 0, 0, 16);
+	job.nr = param_get32ex(Cmd, 1, 0, 16);
+	job.ar = param_get32ex(Cmd, 2, 0, 16);
+	job.nr2 = param_get32ex(Cmd, 3, 0, 16);
+	job.ar2 = param_get32ex(Cmd, 4, 0, 16);
+	uint32_t bits = param_get32ex(Cmd, 5, 48, 10);
+	job.keystart = param_get64ex(Cmd, 6, 0, 16);
+
+	if (bits < 1 || bits > 48) {
+		PrintAndLogEx(WARNING, "Window width must be between 1 and 48 bits");
+		return 1;
+	}
+	job.bits = bits;
+
+	PrintAndLogEx(INFO, "Searching a 2^%u key window with %d threads", job.bits, workqueue_num_workers());
+
+	uint64_t elapsed = msclock();
+	bool found = hitag2crack_run(&job);
+	elapsed = msclock() - elapsed;
+
+	PrintAndLogEx(INFO, "Search took %" PRIu64 ".%03" PRIu64 " seconds", elapsed / 1000, elapsed % 1000);
+
+	if (!found) {
+		PrintAndLogEx(FAILED, "No key in this window matches the sniffed pair");
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < job.num_candidates; i++) {
+		PrintAndLogEx(SUCCESS, "%s key: %012" PRIx64,
+			(job.verified && i == 0) ? "Verified" : "Candidate", job.candidates[i]);
+	}
+
+	if ((job.nr2 || job.ar2) && !job.verified) {
+		PrintAndLogEx(WARNING, "No candidate also matched the second pair");
+	}
+	return 0;
+}
+
+
 static int CmdLFHitagWriter(const char *Cmd) {
 	UsbCommand c = { CMD_WR_HITAG_S };
 	hitag_data* htd = (hitag_data*)c.d.asBytes;
@@ -518,6 +609,7 @@ static command_t CommandTable[] =
 	{"writer",           CmdLFHitagWriter,          0, "Act like a Hitag Writer" },
 	{"simS",             CmdLFHitagSimS,            0, "Simulate HitagS transponder" },
 	{"checkChallenges",  CmdLFHitagCheckChallenges, 0, "Test challenges from a file" },
+	{"crack",            CmdLFHitagCrack,           1, "Recover a Hitag2 key from sniffed authentications" },
 	{ NULL,              NULL,                      0, NULL }
 };
 
@@ -174,6 +174,8 @@ int usage_t55xx_wakup(){
 int usage_t55xx_bruteforce(){
 	PrintAndLog("This command uses A) bruteforce to scan a number range");
 	PrintAndLog("                  B) a dictionary attack");
+	PrintAndLog("Candidates are checked in batches on the device; only the best");
+	PrintAndLog("response of each batch is verified with a full read.");
 	PrintAndLog("Usage: lf t55xx bruteforce <start password> <end password> [i <*.dic>]");
 	PrintAndLog("       password must be 4 bytes (8 hex symbols)");
 	PrintAndLog("Options:");
@@ -449,8 +451,7 @@ bool DecodeT55xxBlock(){
 			save_restoreGB(GRAPH_SAVE);
 			CmdLtrim("160");
 			snprintf(cmdStr, sizeof(buf),"%d 0 6", bitRate[config.bitrate] );
-			ans = PSKDemod(cmdStr, false);
-			psk1TOpsk2(DemodBuffer, DemodBufferLen);
+			ans = PSK2Demod(cmdStr, false);
 			//undo trim samples
 			save_restoreGB(GRAPH_RESTORE);
 			break;
@@ -659,9 +660,8 @@ bool tryDetectModulation(){
 				tests[hits].ST = false;
 				++hits;
 			}
-			// PSK2 - needs a call to psk1TOpsk2.
-			if ( PSKDemod("0 0 6", false)) {
-				psk1TOpsk2(DemodBuffer, DemodBufferLen);
+			// PSK2 - psk1 demod with the psk2 conversion fused in.
+			if ( PSK2Demod("0 0 6", false)) {
 				if (test(DEMOD_PSK2, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)){
 					tests[hits].modulation = DEMOD_PSK2;
 					tests[hits].bitrate = bitRate;
@@ -671,9 +671,8 @@ bool tryDetectModulation(){
 					++hits;
 				}
 			} // inverse waves does not affect this demod
-			// PSK3 - needs a call to psk1TOpsk2.
-			if ( PSKDemod("0 0 6", false)) {
-				psk1TOpsk2(DemodBuffer, DemodBufferLen);
+			// PSK3 - psk1 demod with the psk2 conversion fused in.
+			if ( PSK2Demod("0 0 6", false)) {
 				if (test(DEMOD_PSK3, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)){
 					tests[hits].modulation = DEMOD_PSK3;
 					tests[hits].bitrate = bitRate;
@@ -1419,10 +1418,7 @@ int CmdResetRead(const char *Cmd) {
 }
 
 int CmdT55xxWipe(const char *Cmd) {
-	char writeData[20] = {0};
-	char *ptrData = writeData;
-
-	char cmdp = param_getchar(Cmd, 0);	
+	char cmdp = param_getchar(Cmd, 0);
 	if ( cmdp == 'h' || cmdp == 'H') return usage_t55xx_wipe();
 
 	bool Q5 = (cmdp == 'q' || cmdp == 'Q');
@@ -1431,24 +1427,57 @@ int CmdT55xxWipe(const char *Cmd) {
 	// With a pwd should work even if pwd bit not set
 	PrintAndLog("\nBeginning Wipe of a T55xx tag (assuming the tag is not password protected)\n");
 
-	if ( Q5 ){
-		snprintf(ptrData,sizeof(writeData),"b 0 d 6001F004 p 0");
-	} else {
-		snprintf(ptrData,sizeof(writeData),"b 0 d 00088040 p 0");
+	// all eight blocks are programmed back-to-back on the device in one
+	// field session, with a read-back check per block
+	UsbCommand c = {CMD_T55XX_WRITE_BLOCK_BULK, {0, 8, 0}};
+	uint32_t blockdata = Q5 ? 0x6001F004 : 0x00088040;
+	for (uint8_t blk = 0; blk < 8; blk++) {
+		c.d.asBytes[5*blk] = blk;
+		num_to_bytes(blockdata, 4, c.d.asBytes + 5*blk + 1);
+		blockdata = 0;
 	}
 
-	if (!CmdT55xxWriteBlock(ptrData)) PrintAndLog("Error writing blk 0");
+	clearCommandBuffer();
+	SendCommand(&c);
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 5000)) {
+		PrintAndLog("Error occurred, device did not ACK write operation. (May be due to old firmware)");
+		return 0;
+	}
 
-	for (uint8_t blk = 1; blk<8; blk++) {
-		snprintf(ptrData,sizeof(writeData),"b %d d 0", blk);
-		if (!CmdT55xxWriteBlock(ptrData))
-			PrintAndLog("Error writing blk %d", blk);
+	// a block whose read-back stayed well below the strongest response
+	// most likely did not program
+	uint32_t best = 0;
+	for (uint8_t blk = 0; blk < 8; blk++)
+		if (resp.d.asDwords[blk] > best) best = resp.d.asDwords[blk];
+	for (uint8_t blk = 0; blk < 8; blk++)
+		if (resp.d.asDwords[blk] < best / 4)
+			PrintAndLog("Warning: block %d gave no read-back response, write may have failed", blk);
 
-		memset(writeData, 0x00, sizeof(writeData));
-	}
 	return 0;
 }
 
+// Ship a block of candidate passwords to the device for on-device checking
+// (CMD_T55XX_CHK_PWDS). The device measures the tag response per candidate
+// and reports the strongest one back; the caller still has to verify that
+// candidate with a full acquisition + demodulation.
+static bool t55xx_chk_on_device(uint8_t *pwds, uint16_t num_pwds, uint8_t dl_mode, uint32_t *candidate) {
+	UsbCommand c = {CMD_T55XX_CHK_PWDS, {(uint32_t)dl_mode << 3, num_pwds, 0}};
+	memcpy(c.d.asBytes, pwds, 4 * num_pwds);
+	clearCommandBuffer();
+	SendCommand(&c);
+	UsbCommand resp;
+	// the device needs roughly 100ms per candidate
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 60000)) {
+		PrintAndLog("command execution time out");
+		return false;
+	}
+	if (resp.arg[2] < num_pwds)
+		PrintAndLog("aborted via button, checked %u of %u candidates", (uint32_t)resp.arg[2], num_pwds);
+	*candidate = bytes_to_num(pwds + 4 * resp.arg[1], 4);
+	return true;
+}
+
 int CmdT55xxBruteForce(const char *Cmd) {
 
 	// load a default pwd file.
@@ -1536,44 +1565,46 @@ int CmdT55xxBruteForce(const char *Cmd) {
 		}
 		PrintAndLog("Loaded %d keys", keycnt);
 		
-		// loop
-		uint64_t testpwd = 0x00;
-		for (uint16_t c = 0; c < keycnt; ++c ) {
-
-			if (ukbhit()) {
-				ch = getchar();
-				(void)ch;
-				printf("\naborted via keyboard!\n");
-				free(keyBlock);
-				return 0;
-			}
+		// loop - ship the candidates to the device in batches and only pull
+		// the strongest response of each batch back for verification
+		uint32_t testpwd = 0;
+		// Try each downlink_mode if asked to
+		// donwlink_mode will = 0 if > 3 or set to 0, so loop from 0 - 3
+		for (dl_mode = downlink_mode; dl_mode <= 3; dl_mode++){
 
-			testpwd = bytes_to_num(keyBlock + 4*c, 4);
+			for (uint16_t c = 0; c < keycnt; c += USB_CMD_DATA_SIZE / 4) {
 
-			PrintAndLog("Testing %08X", testpwd);
-			
-			// Try each downlink_mode if asked to 
-			// donwlink_mode will = 0 if > 3 or set to 0, so loop from 0 - 3
-			for (dl_mode = downlink_mode; dl_mode <= 3; dl_mode++){
-				if ( !AquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, true, testpwd, dl_mode)) {
-					PrintAndLog("Acquiring data from device failed. Quitting");
+				if (ukbhit()) {
+					ch = getchar();
+					(void)ch;
+					printf("\naborted via keyboard!\n");
 					free(keyBlock);
 					return 0;
 				}
 
-				found = tryDetectModulation();
+				uint16_t n = keycnt - c;
+				if (n > USB_CMD_DATA_SIZE / 4) n = USB_CMD_DATA_SIZE / 4;
+
+				PrintAndLog("Testing %u passwords on device [%u..%u]", n, c, c + n - 1);
+
+				if (!t55xx_chk_on_device(keyBlock + 4*c, n, dl_mode, &testpwd)) {
+					free(keyBlock);
+					return 0;
+				}
 
-				if ( found ) {
+				// verify the reported candidate with a full demodulation
+				if ( AquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, true, testpwd, dl_mode)
+						&& tryDetectModulation() ) {
 					PrintAndLog("Found valid password: [%08X]", testpwd);
 					free(keyBlock);
-					
+
 					T55xx_Print_DownlinkMode (dl_mode);
 
 					return 0;
 				}
-				if (!try_all_dl_modes) // Exit loop if not trying all downlink modes
-					dl_mode = 4;
-			}	
+			}
+			if (!try_all_dl_modes) // Exit loop if not trying all downlink modes
+				dl_mode = 4;
 		}
 		PrintAndLog("Password NOT found.");
 		free(keyBlock);
@@ -1593,6 +1624,7 @@ int CmdT55xxBruteForce(const char *Cmd) {
 	PrintAndLog("Search password range [%08X -> %08X]", start_password, end_password);
 
 	uint32_t i = start_password;
+	uint8_t batch[USB_CMD_DATA_SIZE];
 
 	while ((!found) && (i <= end_password)) {
 
@@ -1605,22 +1637,34 @@ int CmdT55xxBruteForce(const char *Cmd) {
 			free(keyBlock);
 			return 0;
 		}
-		// Try each downlink_mode if asked to 
+
+		// build the next batch of sequential candidates for the device
+		uint64_t remaining = (uint64_t)end_password - i + 1;
+		uint16_t n = (remaining > USB_CMD_DATA_SIZE / 4) ? USB_CMD_DATA_SIZE / 4 : remaining;
+		for (uint16_t j = 0; j < n; j++)
+			num_to_bytes(i + j, 4, batch + 4*j);
+
+		// Try each downlink_mode if asked to
 		// donwlink_mode will = 0 if > 3 or set to 0, so loop from 0 - 3
 		for (dl_mode = downlink_mode; dl_mode <= 3; dl_mode++){
-			if (!AquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, true, i,dl_mode)) {
-				PrintAndLog("Acquiring data from device failed. Quitting");
+			uint32_t candidate = 0;
+			if (!t55xx_chk_on_device(batch, n, dl_mode, &candidate)) {
 				free(keyBlock);
 				return 0;
 			}
-			found = tryDetectModulation();
-
-			if (found) break;
+			// verify the reported candidate with a full demodulation
+			if ( AquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, true, candidate, dl_mode)
+					&& tryDetectModulation() ) {
+				found = true;
+				i = candidate;
+				break;
+			}
 			if (!try_all_dl_modes) // Exit loop if not trying all downlink modes
-				dl_mode = 4;			
+				dl_mode = 4;
 		}
 		if (found) break;
-		i++;
+		if (i + n < i) break;	// wrapped past 0xffffffff
+		i += n;
 	}
 
 	if (found){
@@ -1685,10 +1729,9 @@ bool tryDetectP1(bool getData) {
 			//save_restoreGB(0);
 			return true;
 		}
-		// PSK2 - needs a call to psk1TOpsk2.
-		if ( PSKDemod("0 0 6", false)) {
-			psk1TOpsk2(DemodBuffer, DemodBufferLen);
-			if (preambleSearchEx(DemodBuffer,preamble,sizeof(preamble),&DemodBufferLen,&startIdx,false) && 
+		// PSK2 - psk1 demod with the psk2 conversion fused in.
+		if ( PSK2Demod("0 0 6", false)) {
+			if (preambleSearchEx(DemodBuffer,preamble,sizeof(preamble),&DemodBufferLen,&startIdx,false) &&
 				  (DemodBufferLen == 32 || DemodBufferLen == 64) ) {
 				//save_restoreGB(0);
 				return true;
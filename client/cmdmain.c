@@ -26,18 +26,22 @@
 #include "util.h"
 #include "util_posix.h"
 #include "cmdscript.h"
-#include "emv/cmdemv.h"		// EMV				  
+#include "comms.h"
+#include "mifare.h"
+#include "emv/cmdemv.h"		// EMV
 #ifdef WITH_SMARTCARD 
   #include "cmdsmartcard.h"
 #endif
 
 static int CmdHelp(const char *Cmd);
+static int CmdAuto(const char *Cmd);
 static int CmdQuit(const char *Cmd);
 
 
 static command_t CommandTable[] = 
 {
 	{"help",  CmdHelp,  1, "This help. Use '<command> help' for details of a particular command."},
+	{"auto",  CmdAuto,  0, "Time-sliced search for both LF and HF tags"},
 	{"data",  CmdData,  1, "{ Plot window / data buffer manipulation... }"},
 	{"hf",    CmdHF,    1, "{ High Frequency commands... }"},
 	{"hw",    CmdHW,    1, "{ Hardware commands... }"},
@@ -65,6 +69,55 @@ static int CmdHelp(const char *Cmd)
   return 0;
 }
 
+// One device command interleaves short HF (ISO14443a select) and LF
+// (125 kHz acquisition) slices and returns whichever side sees a tag first,
+// so an unknown card doesn't need 'lf search' and 'hf search' back to back.
+static int CmdAuto(const char *Cmd)
+{
+	char cmdp = param_getchar(Cmd, 0);
+	if (cmdp == 'h' || cmdp == 'H') {
+		PrintAndLog("Usage:  auto [rounds]");
+		PrintAndLog("     [rounds] - how many LF/HF rounds to try before giving up (default 10)");
+		PrintAndLog("");
+		PrintAndLog("    sample: auto    = scan until a tag answers or 10 rounds pass");
+		PrintAndLog("          : auto 3  = give up after 3 rounds");
+		return 0;
+	}
+	uint32_t rounds = param_get32ex(Cmd, 0, 0, 10);
+
+	UsbCommand c = {CMD_INTERLEAVED_SCAN, {rounds, 0, 0}};
+	clearCommandBuffer();
+	SendCommand(&c);
+
+	UsbCommand resp;
+	// each round is roughly one LF window plus two bitstream switches
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, rounds * 2000 + 5000)) {
+		PrintAndLog("auto: no response from device");
+		return 1;
+	}
+
+	switch (resp.arg[0]) {
+		case ISCAN_FOUND_14A: {
+			iso14a_card_select_t *card = (iso14a_card_select_t *)resp.d.asBytes;
+			PrintAndLog("Found ISO14443a tag (round %d):", (int)resp.arg[1]);
+			PrintAndLog(" UID: %s", sprint_hex(card->uid, card->uidlen));
+			PrintAndLog("ATQA: %02x %02x", card->atqa[1], card->atqa[0]);
+			PrintAndLog(" SAK: %02x", card->sak);
+			PrintAndLog("Use 'hf 14a info' for the full card scan.");
+			return 0;
+		}
+		case ISCAN_FOUND_LF:
+			PrintAndLog("LF modulation seen (round %d), fetching %d samples...",
+					(int)resp.arg[1], (int)resp.arg[2]);
+			if (getSamples((int)resp.arg[2], true))
+				return 1;
+			return CmdLFfind("1");
+		default:
+			PrintAndLog("No tag found.");
+			return 0;
+	}
+}
+
 static int CmdQuit(const char *Cmd)
 {
   return 99;
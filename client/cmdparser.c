@@ -12,10 +12,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include "ui.h"
 #include "proxmark3.h"
 #include "comms.h"
+#ifdef ALLOC_AUDIT
+#include "allocaudit.h"
+#endif
 
 
 void CmdsHelp(const command_t Commands[])
@@ -32,6 +36,72 @@ void CmdsHelp(const command_t Commands[])
 }
 
 
+// Lazily built per-table dispatch indexes. The command tables are static
+// arrays, so each one gets a name-sorted index the first time it is touched;
+// lookups are then a binary search and the prefix fallback walks the
+// contiguous run of matching entries instead of rescanning the whole table.
+// Scripted workloads hammer the same few tables hundreds of times a second,
+// and tables that are never used never pay for an index.
+#define CMD_INDEX_TABLES 48
+
+typedef struct {
+	const command_t *table;
+	uint16_t count;
+	uint16_t *order;	// entry numbers sorted by name
+} cmd_index_t;
+
+static cmd_index_t cmd_indexes[CMD_INDEX_TABLES];
+static int num_cmd_indexes = 0;
+
+static cmd_index_t *CmdsGetIndex(const command_t Commands[])
+{
+	int i;
+	for (i = 0; i < num_cmd_indexes; i++) {
+		if (cmd_indexes[i].table == Commands)
+			return &cmd_indexes[i];
+	}
+	if (num_cmd_indexes == CMD_INDEX_TABLES)
+		return NULL;
+
+	uint16_t count = 0;
+	while (Commands[count].Name)
+		++count;
+
+	uint16_t *order = malloc(count * sizeof(uint16_t));
+	if (order == NULL)
+		return NULL;
+
+	// insertion sort; the tables hold a few dozen entries at most
+	for (uint16_t n = 0; n < count; n++) {
+		uint16_t pos = n;
+		while (pos > 0 && strcmp(Commands[order[pos-1]].Name, Commands[n].Name) > 0) {
+			order[pos] = order[pos-1];
+			--pos;
+		}
+		order[pos] = n;
+	}
+
+	cmd_index_t *idx = &cmd_indexes[num_cmd_indexes++];
+	idx->table = Commands;
+	idx->count = count;
+	idx->order = order;
+	return idx;
+}
+
+// position of the first entry >= cmd_name in sort order
+static uint16_t CmdsLowerBound(const command_t Commands[], const cmd_index_t *idx, const char *cmd_name)
+{
+	uint16_t lo = 0, hi = idx->count;
+	while (lo < hi) {
+		uint16_t mid = (lo + hi) / 2;
+		if (strcmp(Commands[idx->order[mid]].Name, cmd_name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 int CmdsParse(const command_t Commands[], const char *Cmd)
 {
 	if(strcmp( Cmd, "XX_internal_command_dump_XX") == 0)
@@ -49,27 +119,57 @@ int CmdsParse(const command_t Commands[], const char *Cmd)
 	memset(cmd_name, 0, 32);
 	sscanf(Cmd, "%31s%n", cmd_name, &len);
 	int i = 0;
-	while (Commands[i].Name && strcmp(Commands[i].Name, cmd_name))
-		++i;
 
-	/* try to find exactly one prefix-match */
-	if(!Commands[i].Name) {
-		int last_match = 0;
-		int matches = 0;
-
-		for(i=0;Commands[i].Name;i++) {
-			if( !strncmp(Commands[i].Name, cmd_name, strlen(cmd_name)) ) {
-				last_match = i;
+	cmd_index_t *idx = CmdsGetIndex(Commands);
+	if (idx) {
+		uint16_t lb = CmdsLowerBound(Commands, idx, cmd_name);
+
+		if (lb < idx->count && !strcmp(Commands[idx->order[lb]].Name, cmd_name)) {
+			i = idx->order[lb];
+		} else {
+			/* try to find exactly one prefix-match: in sort order these are
+			   a contiguous run starting at the lower bound */
+			int last_match = 0;
+			int matches = 0;
+			for (uint16_t n = lb; n < idx->count
+					&& !strncmp(Commands[idx->order[n]].Name, cmd_name, strlen(cmd_name)); n++) {
+				last_match = idx->order[n];
 				matches++;
 			}
+			i = (matches == 1) ? last_match : idx->count;
+		}
+	} else {
+		// index table exhausted: fall back to the linear scan
+		while (Commands[i].Name && strcmp(Commands[i].Name, cmd_name))
+			++i;
+
+		/* try to find exactly one prefix-match */
+		if(!Commands[i].Name) {
+			int last_match = 0;
+			int matches = 0;
+
+			for(i=0;Commands[i].Name;i++) {
+				if( !strncmp(Commands[i].Name, cmd_name, strlen(cmd_name)) ) {
+					last_match = i;
+					matches++;
+				}
+			}
+			if(matches == 1) i=last_match;
 		}
-		if(matches == 1) i=last_match;
 	}
 
 	if (Commands[i].Name) {
 		while (Cmd[len] == ' ')
 			++len;
+#ifdef ALLOC_AUDIT
+		// attribute heap operations to the full command path
+		alloc_audit_push_site(Commands[i].Name);
+		int ret = Commands[i].Parse(Cmd + len);
+		alloc_audit_pop_site();
+		return ret;
+#else
 	return Commands[i].Parse(Cmd + len);
+#endif
 	} else {
 		// show help for selected hierarchy or if command not recognised
 		CmdsHelp(Commands);
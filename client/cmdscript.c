@@ -13,6 +13,7 @@
 #include <string.h>
 #include <limits.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <dirent.h>
 
 #include "proxmark3.h"
@@ -116,6 +117,120 @@ bool endsWith (char* base, char* str) {
     return (blen >= slen) && (0 == strcmp(base + blen - slen, str));
 }
 
+/**
+ * lua_Writer appending a compiled chunk to the cache file
+ */
+static int writeLuaChunk(lua_State *L, const void *p, size_t sz, void *ud)
+{
+    return fwrite(p, 1, sz, (FILE*)ud) != sz;
+}
+
+/**
+ * @brief Loads a Lua file through a compiled-chunk cache.
+ * A successful compile is dumped to "<file>c" (foo.lua -> foo.luac) and as
+ * long as that cache is not older than the source, the binary chunk is
+ * loaded instead of recompiling. Behaves like luaL_loadfile otherwise: the
+ * chunk (or an error message) ends up on the stack.
+ */
+static int loadLuaFileCached(lua_State *L, const char *path)
+{
+    struct stat src, cached;
+    char cache_path[strlen(path) + 2];
+    sprintf(cache_path, "%sc", path);
+
+    if (stat(path, &src) == 0 && stat(cache_path, &cached) == 0 && cached.st_mtime >= src.st_mtime)
+    {
+        if (luaL_loadfile(L, cache_path) == LUA_OK)
+            return LUA_OK;
+        lua_pop(L, 1);  // corrupt cache - recompile from source
+    }
+
+    int error = luaL_loadfile(L, path);
+    if (!error)
+    {
+        // cache the compiled chunk. A failure (e.g. read-only directory) is no problem,
+        // the next run simply compiles from source again
+        FILE *f = fopen(cache_path, "wb");
+        if (f != NULL)
+        {
+            int dump_error = lua_dump(L, writeLuaChunk, f);
+            fclose(f);
+            if (dump_error)
+                remove(cache_path); // don't leave a partial dump around
+        }
+    }
+    return error;
+}
+
+/**
+ * package searcher resolving require()d modules in the lualibs directory
+ * through the same compiled-chunk cache as the scripts themselves
+ */
+static int luaLibSearcher(lua_State *L)
+{
+    const char *name = luaL_checkstring(L, 1);
+    char const *exedir = get_my_executable_directory();
+    char path[strlen(exedir) + strlen(LUA_LIBRARIES_DIRECTORY) + strlen(name) + strlen(".lua") + 1];
+    sprintf(path, "%s%s%s.lua", exedir, LUA_LIBRARIES_DIRECTORY, name);
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        // not ours - the standard path searcher gets its turn next
+        lua_pushfstring(L, "\n\tno file '%s'", path);
+        return 1;
+    }
+    if (loadLuaFileCached(L, path) != LUA_OK)
+        return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s", name, path, lua_tostring(L, -1));
+
+    lua_pushstring(L, path);
+    return 2;   // the loader plus the file name as its argument
+}
+
+/**
+ * Puts the lualibs searcher in front of the standard path searcher, so that
+ * library chunks come from the cache instead of being recompiled per run
+ */
+static void registerLuaLibSearcher(lua_State *L)
+{
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "searchers");
+    int n = luaL_len(L, -1);
+    for (int i = n; i >= 2; i--)    // make room at position 2 (1 is the preload searcher)
+    {
+        lua_rawgeti(L, -1, i);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_pushcfunction(L, luaLibSearcher);
+    lua_rawseti(L, -2, 2);
+    lua_pop(L, 2);
+}
+
+/**
+ * @brief Counting allocator wrapped around the stock Lua allocator. Keeps the
+ * per-script heap accounting behind core.memstats() and the report printed
+ * when a script finishes, at the cost of a few additions per allocation.
+ */
+static void *countingLuaAlloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    lua_alloc_stats_t *s = ud;
+    size_t old = ptr ? osize : 0; // osize is a type tag when ptr is NULL
+
+    void *p = s->base(s->base_ud, ptr, osize, nsize);
+    if (nsize == 0 || (p != NULL && nsize < old)) {
+        // clamp: blocks allocated before we were installed get freed too
+        size_t gone = (nsize == 0) ? old : old - nsize;
+        s->cur -= (gone < s->cur) ? gone : s->cur;
+    } else if (p != NULL && nsize > old) {
+        s->cur += nsize - old;
+        s->total += nsize - old;
+        s->count++;
+        if (s->cur > s->peak)
+            s->peak = s->cur;
+    }
+    return p;
+}
+
 /**
  * @brief CmdRun - executes a script file.
  * @param argc
@@ -124,10 +239,22 @@ bool endsWith (char* base, char* str) {
  */
 int CmdRun(const char *Cmd)
 {
+    lua_alloc_stats_t alloc_stats = {0};
+
     // create new Lua state
     lua_State *lua_state;
     lua_state = luaL_newstate();
 
+    // account every allocation of this state
+    alloc_stats.base = lua_getallocf(lua_state, &alloc_stats.base_ud);
+    lua_setallocf(lua_state, countingLuaAlloc, &alloc_stats);
+    // the bare state already holds some objects - start from the GC's view
+    alloc_stats.cur = (size_t)lua_gc(lua_state, LUA_GCCOUNT, 0) * 1024
+                    + (size_t)lua_gc(lua_state, LUA_GCCOUNTB, 0);
+    alloc_stats.peak = alloc_stats.cur;
+    lua_pushlightuserdata(lua_state, &alloc_stats);
+    lua_setfield(lua_state, LUA_REGISTRYINDEX, LUA_ALLOC_STATS_KEY);
+
     // load Lua libraries
     luaL_openlibs(lua_state);
 
@@ -140,6 +267,9 @@ int CmdRun(const char *Cmd)
 	//Add the 'bit' library
 	set_bit_library(lua_state);
 
+    //Serve the lualibs helpers from the compiled-chunk cache
+    registerLuaLibSearcher(lua_state);
+
     char script_name[128] = {0};
     char arguments[256] = {0};
 
@@ -165,7 +295,7 @@ int CmdRun(const char *Cmd)
 
     // run the Lua script
 
-    int error = luaL_loadfile(lua_state, script_path);
+    int error = loadLuaFileCached(lua_state, script_path);
     if(!error)
     {
 
@@ -191,6 +321,10 @@ int CmdRun(const char *Cmd)
     // close the Lua state
     lua_close(lua_state);
     printf("\n-----Finished\n");
+    printf("lua heap: peak %lu KB, %lu KB allocated over %lu allocations\n",
+            (unsigned long)(alloc_stats.peak / 1024),
+            (unsigned long)(alloc_stats.total / 1024),
+            (unsigned long)alloc_stats.count);
     return 0;
 }
 
@@ -486,7 +486,7 @@ static int CmdSmartRaw(const char *Cmd) {
 	}
 	if (hexlen > 0) {
 		if (useT0)
-			protocol = SC_RAW_T0;
+			protocol = SC_RAW_T0 | SC_T0_GETRESP; // pcsc path ignores the chaining flag
 		else
 			protocol = SC_RAW;
 	}
@@ -532,7 +532,7 @@ int ExchangeAPDUSC(uint8_t *APDU, int APDUlen, bool activateCard, bool leaveSign
 	if (activateCard)
 		smart_select(false);
 
-	uint32_t flags = SC_RAW_T0;
+	uint32_t flags = SC_RAW_T0 | SC_T0_GETRESP;
 	if (activateCard) {
 		flags |= SC_SELECT | SC_CONNECT;
 	}
@@ -962,6 +962,51 @@ static int CmdSmartBruteforceSFI(const char *Cmd) {
 
 	PrintAndLogEx(INFO, "starting");
 
+	if (UseAlternativeSmartcardReader) {
+		// PC/SC path: probe all records in one batched transmit list, then
+		// re-read the ones that answered 6C (wrong Le) in a second batch
+		#define SFI_PROBES 12
+		uint8_t probes[SFI_PROBES][5];
+		pcsc_apdu_exchange_t ex[SFI_PROBES];
+		uint8_t *responses = calloc(SFI_PROBES, ISO7816_MAX_FRAME_SIZE);
+		if (!responses)
+			return 1;
+
+		size_t n = 0;
+		for (uint8_t i=1; i < 4; i++) {
+			for (int p1=1; p1 < 5; p1++) {
+				memcpy(probes[n], data, sizeof(data));
+				probes[n][2] = p1;
+				probes[n][3] = (i << 3) + 4;
+				ex[n].data = probes[n];
+				ex[n].data_len = sizeof(probes[n]);
+				ex[n].response = responses + n * ISO7816_MAX_FRAME_SIZE;
+				ex[n].response_len = ISO7816_MAX_FRAME_SIZE;
+				n++;
+			}
+		}
+		pcscTransmitBatch(ex, n, SC_RAW_T0);
+
+		size_t retries = 0;
+		for (size_t j = 0; j < n; j++) {
+			if (ex[j].response_len >= 2 && ex[j].response[0] == 0x6C) {
+				probes[j][4] = ex[j].response[1];
+				ex[retries] = ex[j];
+				ex[retries].response_len = ISO7816_MAX_FRAME_SIZE;
+				retries++;
+			}
+		}
+		pcscTransmitBatch(ex, retries, SC_RAW_T0);
+
+		for (size_t j = 0; j < retries; j++) {
+			if (ex[j].response_len > 4)
+				TLVPrintFromBuffer(ex[j].response+1, ex[j].response_len-3);
+		}
+		free(responses);
+		#undef SFI_PROBES
+		return 0;
+	}
+
 	int response_len = 0;
 	uint8_t* response = malloc(ISO7816_MAX_FRAME_SIZE);
 	if (!response)
@@ -973,11 +1018,11 @@ static int CmdSmartBruteforceSFI(const char *Cmd) {
 			data[2] = p1;
 			data[3] = (i << 3) + 4;
 
-			smart_transmit(data, sizeof(data), SC_RAW_T0, response, &response_len, ISO7816_MAX_FRAME_SIZE); 
+			smart_transmit(data, sizeof(data), SC_RAW_T0, response, &response_len, ISO7816_MAX_FRAME_SIZE);
 
 			if ( response[0] == 0x6C ) {
 				data[4] = response[1];
-				smart_transmit(data, sizeof(data), SC_RAW_T0, response, &response_len, ISO7816_MAX_FRAME_SIZE); 
+				smart_transmit(data, sizeof(data), SC_RAW_T0, response, &response_len, ISO7816_MAX_FRAME_SIZE);
 
 				// TLV decoder
 				if (response_len > 4)
@@ -12,86 +12,454 @@
 #include "comms.h"
 
 #include <pthread.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>	// for gettimeofday()
 #if defined(__linux__) && !defined(NO_UNLINK)
 #include <unistd.h>		// for unlink()
 #endif
 #include "uart.h"
+#include "uart_replay.h"
 #include "ui.h"
 #include "common.h"
+#include "rle.h"
 #include "util_darwin.h"
 #include "util_posix.h"
 
 
-// Serial port that we are communicating with the PM3 on.
-static serial_port sp = NULL;
-static char *serial_port_name = NULL;
-
-// If TRUE, then there is no active connection to the PM3, and we will drop commands sent.
-static bool offline;
-
 typedef struct {
 	bool run; // If TRUE, continue running the uart_communication thread
 	bool block_after_ACK; // if true, block after receiving an ACK package
 } communication_arg_t;
 
-static communication_arg_t conn;
-static pthread_t USB_communication_thread;
+// commands that can be queued ahead of the communication thread
+#define TX_RING_SIZE 4
+
+// One reference-counted response buffer. refs counts the ring's reference
+// plus any outstanding WaitForResponseInPlace borrows; 0 means free.
+typedef struct {
+	UsbCommand cmd;		// must stay first - ReleaseResponse casts back
+	int refs;
+} pooled_resp_t;
+
+// ring capacity plus headroom for payloads callers have borrowed with
+// WaitForResponseInPlace and not yet released
+#define RESP_POOL_SIZE (CMD_BUFFER_SIZE + 8)
+
+// All connection state for one attached Proxmark. Each session runs its own
+// communication thread and keeps its own tx ring and rx ring, so several
+// devices can be driven from one client process. Commands are routed to the
+// session selected with SessionSelect() ('hw session').
+typedef struct {
+	// Serial port that we are communicating with the PM3 on.
+	serial_port sp;
+	char *serial_port_name;
+
+	// If TRUE, then there is no active connection to the PM3, and we will drop commands sent.
+	bool offline;
+
+	communication_arg_t conn;
+	pthread_t USB_communication_thread;
+
+	// Transmit ring. Several commands can be queued ahead of the
+	// communication thread, so scripted callers no longer serialize on a
+	// single in-flight transmit slot.
+	UsbCommand txRing[TX_RING_SIZE];
+	int tx_head;	// next empty slot
+	int tx_tail;	// oldest command not yet on the wire
+	pthread_mutex_t txBufferMutex;
+	pthread_cond_t txBufferSig;
+
+	// Reference-counted response pool. The ring below holds pointers into
+	// it: WaitForResponse* copies out as before, WaitForResponseInPlace
+	// hands the pooled buffer itself to the caller until ReleaseResponse.
+	pooled_resp_t respPool[RESP_POOL_SIZE];
+
+	// Used by UsbReceiveCommand as a ring buffer for messages that are yet to be
+	// processed by a command handler (WaitForResponse{,Timeout})
+	pooled_resp_t *rxBuffer[CMD_BUFFER_SIZE];
+
+	// Points to the next empty position to write to
+	int cmd_head;
+
+	// Points to the position of the last unread command
+	int cmd_tail;
+
+	// to lock rxBuffer operations from different threads
+	pthread_mutex_t rxBufferMutex;
+
+	// signalled when a response lands in rxBuffer, so waiters wake at once
+	pthread_cond_t rxBufferSig;
+
+	bool mutexes_initialized;
+} comms_session_t;
+
+static comms_session_t sessions[COMMS_MAX_SESSIONS];
+static int current_session = 0;
+
+static void session_init(comms_session_t *s)
+{
+	if (!s->mutexes_initialized) {
+		pthread_mutex_init(&s->txBufferMutex, NULL);
+		pthread_cond_init(&s->txBufferSig, NULL);
+		pthread_mutex_init(&s->rxBufferMutex, NULL);
+		pthread_cond_init(&s->rxBufferSig, NULL);
+		s->mutexes_initialized = true;
+	}
+}
+
+// the session commands are routed to
+static comms_session_t *cur(void)
+{
+	comms_session_t *s = &sessions[current_session];
+	session_init(s);
+	return s;
+}
+
+// Streaming download target. When registered, bulk payload frames are written
+// by the communication thread straight into the caller's buffer instead of
+// being staged in the rxBuffer ring and copied out a second time under
+// rxBufferMutex.
+typedef struct {
+	uint8_t *dest;     // caller's destination buffer
+	size_t n;          // capacity of dest in bytes
+	uint32_t cmd;      // response type carrying the payload
+	size_t received;   // payload bytes delivered so far
+	bool active;
+} stream_target_t;
+
+static stream_target_t streamTarget;
+static pthread_mutex_t streamTargetMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Asynchronously submitted commands. Responses are matched to pending
+// requests in submission order - the device executes commands serially, so
+// responses always come back in request order.
+typedef struct {
+	uint64_t handle;           // handle this slot was assigned to
+	uint32_t expected_cmd;     // response type completing the request
+	bool completed;
+	UsbCommand response;
+	CommandCompletionCB callback;
+	void *context;
+} async_slot_t;
+
+static async_slot_t asyncSlots[ASYNC_MAX_PENDING];
+static uint64_t asyncNext = 1;  // next handle to assign (0 is never used)
+static uint64_t asyncOldest = 1; // oldest pending handle
+static pthread_mutex_t asyncMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Latency and throughput instrumentation, shown by 'hw perf'. SendCommand()
+// timestamps the request; the first successful (or timed out) wait afterwards
+// closes the pair and accounts it to the request's cmd. The communication
+// thread counts raw frames and bytes in both directions.
+#define PERF_CMD_SLOTS	64
+#define PERF_BUCKETS	16	// log2(ms) latency histogram: <1ms, <2ms, <4ms, ...
+
+typedef struct {
+	uint32_t cmd;		// request command this slot accounts for
+	uint32_t count;		// completed request/response pairs
+	uint32_t timeouts;
+	uint64_t total_ms;
+	uint64_t max_ms;
+	uint32_t buckets[PERF_BUCKETS];
+} perf_rec_t;
+
+static perf_rec_t perfRecs[PERF_CMD_SLOTS];
+static uint64_t perfBytesSent, perfBytesReceived;
+static uint64_t perfFramesSent, perfFramesReceived;
+static uint32_t perfPendingCmd = CMD_UNKNOWN;	// request awaiting its first wait
+static uint64_t perfPendingStart;
+static pthread_mutex_t perfMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// find or create the record for cmd. perfMutex must be held.
+static perf_rec_t *perfFind(uint32_t cmd)
+{
+	for (int i = 0; i < PERF_CMD_SLOTS; i++) {
+		if (perfRecs[i].count == 0 && perfRecs[i].timeouts == 0) {
+			perfRecs[i].cmd = cmd;
+			return &perfRecs[i];
+		}
+		if (perfRecs[i].cmd == cmd) {
+			return &perfRecs[i];
+		}
+	}
+	return NULL;	// table full; stop accounting new cmd types
+}
+
+static void perfNoteSent(uint32_t cmd)
+{
+	pthread_mutex_lock(&perfMutex);
+	perfPendingCmd = cmd;
+	perfPendingStart = msclock();
+	perfBytesSent += sizeof(UsbCommand);
+	perfFramesSent++;
+	pthread_mutex_unlock(&perfMutex);
+}
+
+static void perfNoteWaitDone(bool completed)
+{
+	pthread_mutex_lock(&perfMutex);
+	if (perfPendingCmd != CMD_UNKNOWN) {
+		perf_rec_t *rec = perfFind(perfPendingCmd);
+		perfPendingCmd = CMD_UNKNOWN;
+		if (rec != NULL) {
+			if (completed) {
+				uint64_t latency = msclock() - perfPendingStart;
+				rec->count++;
+				rec->total_ms += latency;
+				if (latency > rec->max_ms) rec->max_ms = latency;
+				int b = 0;
+				while (latency && b < PERF_BUCKETS - 1) {
+					latency >>= 1;
+					b++;
+				}
+				rec->buckets[b]++;
+			} else {
+				rec->timeouts++;
+			}
+		}
+	}
+	pthread_mutex_unlock(&perfMutex);
+}
+
+// Adaptive timeouts. Call-site timeouts are either padded hugely (slow
+// failure detection) or too tight (spurious aborts); once enough samples
+// exist for a command type, waits use a p99-derived deadline instead. The
+// caller's value stays the upper bound and the explicit override -
+// adaptation only ever shortens a timeout, never lengthens it.
+static bool adaptiveTimeoutEnabled = true;
+#define ADAPTIVE_MIN_SAMPLES	32
+#define ADAPTIVE_MARGIN		4	// multiple of the p99 bucket bound
+#define ADAPTIVE_FLOOR_MS	100
+
+void SetAdaptiveTimeout(bool enable)
+{
+	adaptiveTimeoutEnabled = enable;
+}
 
-// Transmit buffer.
-static UsbCommand txBuffer;
-static bool txBuffer_pending = false;
-static pthread_mutex_t txBufferMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t txBufferSig = PTHREAD_COND_INITIALIZER;
+bool GetAdaptiveTimeout(void)
+{
+	return adaptiveTimeoutEnabled;
+}
 
-// Used by UsbReceiveCommand as a ring buffer for messages that are yet to be
-// processed by a command handler (WaitForResponse{,Timeout})
-static UsbCommand rxBuffer[CMD_BUFFER_SIZE];
+// derive the timeout for the request currently awaiting its response;
+// returns ms_timeout unchanged when there is no basis for a tighter one
+static size_t adaptiveTimeout(size_t ms_timeout)
+{
+	if (!adaptiveTimeoutEnabled || ms_timeout == (size_t)-1) {
+		return ms_timeout;
+	}
+	size_t derived = ms_timeout;
+	pthread_mutex_lock(&perfMutex);
+	if (perfPendingCmd != CMD_UNKNOWN) {
+		perf_rec_t *rec = perfFind(perfPendingCmd);
+		if (rec != NULL && rec->count >= ADAPTIVE_MIN_SAMPLES) {
+			// walk the histogram up to the p99 bucket
+			uint32_t below = 0;
+			int b = 0;
+			for (; b < PERF_BUCKETS - 1; b++) {
+				below += rec->buckets[b];
+				if ((uint64_t)below * 100 >= (uint64_t)rec->count * 99) {
+					break;
+				}
+			}
+			// bucket b holds latencies below 2^b ms
+			uint64_t t = ((uint64_t)1 << b) * ADAPTIVE_MARGIN;
+			if (t < ADAPTIVE_FLOOR_MS) {
+				t = ADAPTIVE_FLOOR_MS;
+			}
+			if (t < derived) {
+				derived = t;
+			}
+		}
+	}
+	pthread_mutex_unlock(&perfMutex);
+	return derived;
+}
 
-// Points to the next empty position to write to
-static int cmd_head = 0;
+// called on the communication thread for every complete frame off the wire
+static void perfNoteReceived(size_t bytes)
+{
+	pthread_mutex_lock(&perfMutex);
+	perfBytesReceived += bytes;
+	perfFramesReceived++;
+	pthread_mutex_unlock(&perfMutex);
+}
 
-// Points to the position of the last unread command
-static int cmd_tail = 0;
+//-----------------------------------------------------------------------------
+// Session recorder. When armed ('hw record'), every complete frame that
+// crosses the wire is appended to the recording file with its direction and
+// a timestamp, in the format the replay port (uart_replay.c) consumes. The
+// recorder is global, not per session - frames from all open sessions land
+// in the same file, so record single-device workflows for clean replays.
+//-----------------------------------------------------------------------------
+static FILE *recordFile = NULL;
+static uint64_t recordStart = 0;
+static pthread_mutex_t recordMutex = PTHREAD_MUTEX_INITIALIZER;
 
-// to lock rxBuffer operations from different threads
-static pthread_mutex_t rxBufferMutex = PTHREAD_MUTEX_INITIALIZER;
+// called on the communication threads; the unsynchronized NULL check keeps
+// the common not-recording case free, armed/disarmed is settled under the lock
+static void recordFrame(uint32_t dir, const uint8_t *data, size_t len)
+{
+	if (recordFile == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&recordMutex);
+	if (recordFile != NULL) {
+		pm3_rec_hdr_t hdr = { (uint32_t)len, dir, msclock() - recordStart };
+		fwrite(&hdr, sizeof(hdr), 1, recordFile);
+		fwrite(data, 1, len, recordFile);
+	}
+	pthread_mutex_unlock(&recordMutex);
+}
+
+bool StartSessionRecording(const char *path)
+{
+	pthread_mutex_lock(&recordMutex);
+	if (recordFile != NULL) {
+		pthread_mutex_unlock(&recordMutex);
+		PrintAndLog("Already recording, stop with 'hw record off' first.");
+		return false;
+	}
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) {
+		pthread_mutex_unlock(&recordMutex);
+		PrintAndLog("Can't open %s for writing.", path);
+		return false;
+	}
+	fwrite(PM3_REC_MAGIC, PM3_REC_MAGIC_LEN, 1, f);
+	recordFile = f;
+	recordStart = msclock();
+	pthread_mutex_unlock(&recordMutex);
+	return true;
+}
+
+void StopSessionRecording(void)
+{
+	pthread_mutex_lock(&recordMutex);
+	if (recordFile != NULL) {
+		fclose(recordFile);
+		recordFile = NULL;
+	}
+	pthread_mutex_unlock(&recordMutex);
+}
+
+bool SessionRecordingActive(void)
+{
+	return recordFile != NULL;
+}
+
+void PerfReset(void)
+{
+	pthread_mutex_lock(&perfMutex);
+	memset(perfRecs, 0, sizeof(perfRecs));
+	perfBytesSent = perfBytesReceived = 0;
+	perfFramesSent = perfFramesReceived = 0;
+	perfPendingCmd = CMD_UNKNOWN;
+	pthread_mutex_unlock(&perfMutex);
+}
+
+void PerfPrint(void)
+{
+	pthread_mutex_lock(&perfMutex);
+	PrintAndLog("link: sent %" PRIu64 " frames / %" PRIu64 " bytes, received %" PRIu64 " frames / %" PRIu64 " bytes",
+			perfFramesSent, perfBytesSent, perfFramesReceived, perfBytesReceived);
+	PrintAndLog("cmd      count   t/o   avg ms   max ms   latency histogram (bucket:count, bucket i = < 2^i ms)");
+	for (int i = 0; i < PERF_CMD_SLOTS; i++) {
+		perf_rec_t *rec = &perfRecs[i];
+		if (rec->count == 0 && rec->timeouts == 0) break;
+		char hist[PERF_BUCKETS * 12 + 1];
+		int pos = 0;
+		for (int b = 0; b < PERF_BUCKETS; b++) {
+			if (rec->buckets[b]) {
+				pos += sprintf(hist + pos, " %d:%u", b, rec->buckets[b]);
+			}
+		}
+		PrintAndLog("0x%04x %7u %5u %8" PRIu64 " %8" PRIu64 "  %s",
+				rec->cmd, rec->count, rec->timeouts,
+				rec->count ? rec->total_ms / rec->count : 0,
+				rec->max_ms, hist);
+	}
+	pthread_mutex_unlock(&perfMutex);
+}
 
 // These wrappers are required because it is not possible to access a static
 // global variable outside of the context of a single file.
 
 void SetOffline(bool new_offline) {
-	offline = new_offline;
+	cur()->offline = new_offline;
 }
 
 bool IsOffline() {
-	return offline;
+	return cur()->offline;
 }
 
 void SendCommand(UsbCommand *c) {
+	comms_session_t *s = cur();
+
 	#ifdef COMMS_DEBUG
 	printf("Sending %04x cmd\n", c->cmd);
 	#endif
 
-	if (offline) {
+	if (s->offline) {
 		PrintAndLog("Sending bytes to proxmark failed - offline");
 		return;
     }
 
-	pthread_mutex_lock(&txBufferMutex);
+	pthread_mutex_lock(&s->txBufferMutex);
 	/**
-	This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive, 
+	This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
 	but comm thread just spins here. Not good.../holiman
 	**/
-	while (txBuffer_pending) {
-		pthread_cond_wait(&txBufferSig, &txBufferMutex); // wait for communication thread to complete sending a previous commmand
+	while ((s->tx_head + 1) % TX_RING_SIZE == s->tx_tail) {
+		pthread_cond_wait(&s->txBufferSig, &s->txBufferMutex); // ring full - wait for the communication thread to drain a slot
 	}
 
-	txBuffer = *c;
-	txBuffer_pending = true;
-	pthread_cond_signal(&txBufferSig); // tell communication thread that a new command can be send
+	s->txRing[s->tx_head] = *c;
+	s->tx_head = (s->tx_head + 1) % TX_RING_SIZE;
+	pthread_cond_signal(&s->txBufferSig); // tell communication thread that a new command can be send
+
+	pthread_mutex_unlock(&s->txBufferMutex);
+
+	// kick the communication thread out of its receive timeout so the
+	// command goes on the wire now instead of up to 30ms later
+	if (s->sp != NULL && !uart_replay_is(s->sp)) {
+		uart_wakeup(s->sp);
+	}
+
+	perfNoteSent(c->cmd);
+}
+
 
-	pthread_mutex_unlock(&txBufferMutex);
+/**
+ * @brief Pack several sub-commands into a single CMD_EXEC_BATCH envelope and
+ *  send it. The device executes them back-to-back without returning to its
+ *  USB wait loop, saving one USB round trip per sub-command for the fixed
+ *  command sequences many workflows consist of. data_lens gives the number
+ *  of payload bytes actually used by each sub-command.
+ * @return true if all sub-commands fit into one envelope and it was sent.
+ */
+bool SendCommandBatch(UsbCommand *cmds, uint16_t *data_lens, uint16_t count) {
+	UsbCommand envelope = {CMD_EXEC_BATCH, {count, 0, 0}};
+	uint32_t used = 0;
+
+	for (uint16_t i = 0; i < count; i++) {
+		uint16_t sub = cmds[i].cmd & 0xffff;
+		uint16_t sub_len = data_lens[i];
+		if (sub_len > USB_CMD_DATA_SIZE || used + 4 + sizeof(cmds[i].arg) + sub_len > USB_CMD_DATA_SIZE) {
+			PrintAndLog("SendCommandBatch: %u sub-commands don't fit into one envelope", count);
+			return false;
+		}
+		memcpy(envelope.d.asBytes + used, &sub, sizeof(sub));
+		memcpy(envelope.d.asBytes + used + 2, &sub_len, sizeof(sub_len));
+		memcpy(envelope.d.asBytes + used + 4, cmds[i].arg, sizeof(cmds[i].arg));
+		memcpy(envelope.d.asBytes + used + 4 + sizeof(cmds[i].arg), cmds[i].d.asBytes, sub_len);
+		used += 4 + sizeof(cmds[i].arg) + sub_len;
+	}
 
+	SendCommand(&envelope);
+	return true;
 }
 
 
@@ -103,142 +471,425 @@ void SendCommand(UsbCommand *c) {
  */
 void clearCommandBuffer()
 {
+	comms_session_t *s = cur();
 	//This is a very simple operation
-	pthread_mutex_lock(&rxBufferMutex);
-	cmd_tail = cmd_head;
-	pthread_mutex_unlock(&rxBufferMutex);
+	pthread_mutex_lock(&s->rxBufferMutex);
+	while (s->cmd_tail != s->cmd_head) {
+		s->rxBuffer[s->cmd_tail]->refs--;
+		s->cmd_tail = (s->cmd_tail + 1) % CMD_BUFFER_SIZE;
+	}
+	pthread_mutex_unlock(&s->rxBufferMutex);
 }
 
 /**
- * @brief storeCommand stores a USB command in a circular buffer
+ * @brief storeCommand stores a USB command in a session's circular buffer
  * @param UC
  */
-static void storeCommand(UsbCommand *command)
+// caller must hold s->rxBufferMutex
+static pooled_resp_t *respPoolAlloc(comms_session_t *s)
+{
+	for (int i = 0; i < RESP_POOL_SIZE; i++) {
+		if (s->respPool[i].refs == 0) {
+			s->respPool[i].refs = 1;
+			return &s->respPool[i];
+		}
+	}
+	return NULL;
+}
+
+static void storeCommand(comms_session_t *s, UsbCommand *command)
 {
-	pthread_mutex_lock(&rxBufferMutex);
-	if( (cmd_head+1) % CMD_BUFFER_SIZE == cmd_tail)
+	pthread_mutex_lock(&s->rxBufferMutex);
+	if( (s->cmd_head+1) % CMD_BUFFER_SIZE == s->cmd_tail)
 	{
-		// If these two are equal, we're about to overwrite in the
-		// circular buffer.
+		// Ring full - drop the oldest unread response to make room.
 		PrintAndLog("WARNING: Command buffer about to overwrite command! This needs to be fixed!");
+		s->rxBuffer[s->cmd_tail]->refs--;
+		s->cmd_tail = (s->cmd_tail + 1) % CMD_BUFFER_SIZE;
+	}
+
+	pooled_resp_t *slot = respPoolAlloc(s);
+	if (slot == NULL) {
+		// every buffer is still borrowed - nothing left to do but drop
+		PrintAndLog("WARNING: response pool exhausted, dropping a response!");
+		pthread_mutex_unlock(&s->rxBufferMutex);
+		return;
 	}
 
 	// Store the command at the 'head' location
-	UsbCommand* destination = &rxBuffer[cmd_head];
-	memcpy(destination, command, sizeof(UsbCommand));
+	memcpy(&slot->cmd, command, sizeof(UsbCommand));
+	s->rxBuffer[s->cmd_head] = slot;
+
+	s->cmd_head = (s->cmd_head +1) % CMD_BUFFER_SIZE; //increment head and wrap
+	pthread_cond_broadcast(&s->rxBufferSig); // wake anyone blocked in WaitForResponse*
+	pthread_mutex_unlock(&s->rxBufferMutex);
+}
+
+
+/**
+ * @brief RegisterStreamTarget registers dest as the streaming destination for
+ * payload frames of type cmd. Offsets are taken from arg[0] of each frame.
+ */
+void RegisterStreamTarget(uint8_t *dest, size_t n, uint32_t cmd)
+{
+	pthread_mutex_lock(&streamTargetMutex);
+	streamTarget.dest = dest;
+	streamTarget.n = n;
+	streamTarget.cmd = cmd;
+	streamTarget.received = 0;
+	streamTarget.active = true;
+	pthread_mutex_unlock(&streamTargetMutex);
+}
 
-	cmd_head = (cmd_head +1) % CMD_BUFFER_SIZE; //increment head and wrap
-	pthread_mutex_unlock(&rxBufferMutex);
+
+/**
+ * @brief UnregisterStreamTarget ends streaming mode.
+ * @return number of payload bytes delivered to the registered buffer
+ */
+size_t UnregisterStreamTarget(void)
+{
+	pthread_mutex_lock(&streamTargetMutex);
+	streamTarget.active = false;
+	size_t received = streamTarget.received;
+	pthread_mutex_unlock(&streamTargetMutex);
+	return received;
+}
+
+
+/**
+ * @brief Deliver a payload frame to the registered streaming buffer, if any.
+ * Called on the communication thread.
+ * @return true if the frame was consumed and must not enter the ring buffer
+ */
+static bool streamConsume(uint32_t cmd, uint64_t offset, const uint8_t *data, size_t len)
+{
+	bool consumed = false;
+	pthread_mutex_lock(&streamTargetMutex);
+	if (streamTarget.active && cmd == streamTarget.cmd) {
+		if (offset < streamTarget.n) {
+			size_t copy_bytes = MIN(len, streamTarget.n - offset);
+			memcpy(streamTarget.dest + offset, data, copy_bytes);
+			streamTarget.received += copy_bytes;
+		}
+		consumed = true;
+	} else if (streamTarget.active && cmd == CMD_DOWNLOADED_COMPRESSED_ADC_SAMPLES_125K
+			&& streamTarget.cmd == CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K) {
+		// the device chose to RLE-compress this sample chunk
+		if (offset < streamTarget.n) {
+			streamTarget.received += rle_decode(data, len, streamTarget.dest + offset, streamTarget.n - offset);
+		}
+		consumed = true;
+	}
+	pthread_mutex_unlock(&streamTargetMutex);
+	return consumed;
 }
 
 
 /**
- * @brief getCommand gets a command from an internal circular buffer.
- * @param response location to write command
- * @return 1 if response was returned, 0 if nothing has been received
+ * @brief SendCommandAsync submits a command without waiting for completion.
+ * The response of type expected_cmd (or any response, if CMD_UNKNOWN) is
+ * delivered via PollAsyncResponse()/WaitAsyncResponseTimeout() and, when
+ * given, via callback on the communication thread. Callers can pipeline the
+ * next command while a previous response is still in flight.
+ * @return handle for polling, or 0 when the pending table is full or offline
  */
-static int getCommand(UsbCommand* response)
+uint64_t SendCommandAsync(UsbCommand *c, uint32_t expected_cmd, CommandCompletionCB callback, void *context)
 {
-	pthread_mutex_lock(&rxBufferMutex);
-	//If head == tail, there's nothing to read, or if we just got initialized
-	if (cmd_head == cmd_tail){
-		pthread_mutex_unlock(&rxBufferMutex);
+	if (cur()->offline) {
+		PrintAndLog("Sending bytes to proxmark failed - offline");
 		return 0;
 	}
 
-	//Pick out the next unread command
-	UsbCommand* last_unread = &rxBuffer[cmd_tail];
-	memcpy(response, last_unread, sizeof(UsbCommand));
-	//Increment tail - this is a circular buffer, so modulo buffer size
-	cmd_tail = (cmd_tail + 1) % CMD_BUFFER_SIZE;
+	pthread_mutex_lock(&asyncMutex);
+	if (asyncNext - asyncOldest >= ASYNC_MAX_PENDING) {
+		pthread_mutex_unlock(&asyncMutex);
+		return 0;
+	}
+	uint64_t handle = asyncNext++;
+	async_slot_t *slot = &asyncSlots[handle % ASYNC_MAX_PENDING];
+	slot->handle = handle;
+	slot->expected_cmd = expected_cmd;
+	slot->completed = false;
+	slot->callback = callback;
+	slot->context = context;
+	pthread_mutex_unlock(&asyncMutex);
+
+	SendCommand(c);
+	return handle;
+}
+
 
-	pthread_mutex_unlock(&rxBufferMutex);
-	return 1;
+/**
+ * @brief PollAsyncResponse checks (without blocking) whether the request
+ * behind handle has completed.
+ * @return true if completed; the response is copied into response if non-NULL
+ */
+bool PollAsyncResponse(uint64_t handle, UsbCommand *response)
+{
+	bool completed = false;
+	pthread_mutex_lock(&asyncMutex);
+	async_slot_t *slot = &asyncSlots[handle % ASYNC_MAX_PENDING];
+	if (slot->handle == handle && slot->completed) {
+		if (response != NULL) {
+			*response = slot->response;
+		}
+		completed = true;
+	}
+	pthread_mutex_unlock(&asyncMutex);
+	return completed;
+}
+
+
+/**
+ * @brief WaitAsyncResponseTimeout blocks until the request behind handle
+ * completes or ms_timeout milliseconds have passed.
+ */
+bool WaitAsyncResponseTimeout(uint64_t handle, UsbCommand *response, size_t ms_timeout)
+{
+	uint64_t start_time = msclock();
+	while (!PollAsyncResponse(handle, response)) {
+		if (msclock() - start_time > ms_timeout) {
+			return false;
+		}
+		msleep(1);
+	}
+	return true;
+}
+
+
+/**
+ * @brief Complete the oldest pending async request, if this response matches
+ * its expected type. Called on the communication thread.
+ * @return true if the response was consumed and must not enter the ring buffer
+ */
+static bool asyncConsume(UsbCommand *UC)
+{
+	CommandCompletionCB callback = NULL;
+	void *context = NULL;
+	UsbCommand response;
+
+	pthread_mutex_lock(&asyncMutex);
+	if (asyncOldest == asyncNext) {
+		pthread_mutex_unlock(&asyncMutex);
+		return false;
+	}
+	async_slot_t *slot = &asyncSlots[asyncOldest % ASYNC_MAX_PENDING];
+	if (slot->expected_cmd != CMD_UNKNOWN && slot->expected_cmd != UC->cmd) {
+		// an intermediate frame (e.g. a download chunk) - not a completion
+		pthread_mutex_unlock(&asyncMutex);
+		return false;
+	}
+	slot->response = *UC;
+	slot->completed = true;
+	callback = slot->callback;
+	context = slot->context;
+	response = *UC;
+	asyncOldest++;
+	pthread_mutex_unlock(&asyncMutex);
+
+	if (callback != NULL) {
+		callback(&response, context);
+	}
+	return true;
 }
 
 
 //----------------------------------------------------------------------------------
 // Entry point into our code: called whenever we received a packet over USB.
-// Handle debug commands directly, store all other commands in circular buffer.
+// Handle debug commands directly, store all other commands in the session's
+// circular buffer. The streaming and async fast paths only serve the selected
+// session; background sessions always deliver through their own ring.
 //----------------------------------------------------------------------------------
-static void UsbCommandReceived(UsbCommand *UC)
+static void UsbCommandReceived(comms_session_t *s, UsbCommand *UC)
 {
 	switch(UC->cmd) {
 		// First check if we are handling a debug message
 		case CMD_DEBUG_PRINT_STRING: {
-			char s[USB_CMD_DATA_SIZE+1];
-			memset(s, 0x00, sizeof(s));
+			char dbg[USB_CMD_DATA_SIZE+1];
+			memset(dbg, 0x00, sizeof(dbg));
 			size_t len = MIN(UC->arg[0],USB_CMD_DATA_SIZE);
-			memcpy(s,UC->d.asBytes,len);
-			PrintAndLog("#db# %s", s);
+			memcpy(dbg,UC->d.asBytes,len);
+			PrintAndLog("#db# %s", dbg);
 			return;
 		} break;
 
+		case CMD_PROGRESS_REPORT:
+			// unsolicited progress from a long-running firmware loop
+			PrintProgress(UC->arg[0], UC->arg[1], UC->arg[2]);
+			return;
+
 		case CMD_DEBUG_PRINT_INTEGERS: {
 			PrintAndLog("#db# %08x, %08x, %08x       \r\n", UC->arg[0], UC->arg[1], UC->arg[2]);
 			return;
 		} break;
 
 		default:
- 			storeCommand(UC);
+			if (s == &sessions[current_session]) {
+				if (streamConsume(UC->cmd, UC->arg[0], UC->d.asBytes, MIN(UC->arg[1], USB_CMD_DATA_SIZE))) {
+					return;
+				}
+				if (asyncConsume(UC)) {
+					return;
+				}
+			}
+ 			storeCommand(s, UC);
 			break;
 	}
 
 }
 
 
+// Route uart traffic either to the real serial port or, for ports opened
+// from a "replay:<file>" name, to the replay engine.
+static bool port_receive(serial_port sp, uint8_t *pbtRx, size_t maxLen, size_t *rxLen)
+{
+	if (uart_replay_is(sp)) {
+		return uart_replay_receive(sp, pbtRx, maxLen, rxLen);
+	}
+	return uart_receive(sp, pbtRx, maxLen, rxLen);
+}
+
+static bool port_send(serial_port sp, const uint8_t *pbtTx, size_t txLen)
+{
+	if (uart_replay_is(sp)) {
+		return uart_replay_send(sp, pbtTx, txLen);
+	}
+	return uart_send(sp, pbtTx, txLen);
+}
+
+/**
+ * @brief Number of bytes the frame currently accumulating in buf occupies on
+ * the wire. Until the first dword has arrived we can't tell the format apart
+ * and assume a fixed-size UsbCommand; uart_receive() returns early with
+ * whatever is available, so asking for too much doesn't stall the probe.
+ */
+static size_t frameLength(const uint8_t *buf, size_t fill)
+{
+	if (fill >= sizeof(uint32_t)) {
+		uint32_t magic;
+		memcpy(&magic, buf, sizeof(magic));
+		if (magic == USB_FRAME_NG_MAGIC) {
+			if (fill >= sizeof(UsbFrameNGHeader)) {
+				UsbFrameNGHeader header;
+				memcpy(&header, buf, sizeof(header));
+				return sizeof(UsbFrameNGHeader) + MIN(header.datalen, USB_CMD_DATA_SIZE_EXT);
+			}
+			return sizeof(UsbFrameNGHeader);
+		}
+	}
+	return sizeof(UsbCommand);
+}
+
+
+/**
+ * @brief Deliver a variable-length frame by re-chunking it into fixed-size
+ * UsbCommands, so all existing consumers (WaitForResponse, GetFromBigBuf, ...)
+ * keep working unchanged. As with device-side chunking, arg[0] carries the
+ * offset of each chunk within the transfer and arg[1] its length.
+ */
+static void UsbFrameNGReceived(comms_session_t *s, UsbFrameNGHeader *header, uint8_t *data)
+{
+	size_t len = MIN(header->datalen, USB_CMD_DATA_SIZE_EXT);
+	UsbCommand cmd;
+	size_t i = 0;
+
+	// Streaming downloads consume the whole frame in one copy
+	if (s == &sessions[current_session]
+			&& streamConsume(header->cmd, header->arg[0], data, len)) {
+		return;
+	}
+
+	do {
+		size_t chunk = MIN(len - i, USB_CMD_DATA_SIZE);
+		memset(&cmd, 0, sizeof(cmd));
+		cmd.cmd = header->cmd;
+		cmd.arg[0] = header->arg[0] + i;
+		cmd.arg[1] = chunk;
+		cmd.arg[2] = header->arg[2];
+		memcpy(cmd.d.asBytes, data + i, chunk);
+		UsbCommandReceived(s, &cmd);
+		i += chunk;
+	} while (i < len);
+}
+
+
 static void
 #ifdef __has_attribute
 #if __has_attribute(force_align_arg_pointer)
-__attribute__((force_align_arg_pointer)) 
+__attribute__((force_align_arg_pointer))
 #endif
 #endif
 *uart_communication(void *targ) {
-	communication_arg_t *conn = (communication_arg_t*)targ;
+	comms_session_t *s = (comms_session_t*)targ;
 	size_t rxlen;
-	UsbCommand rx;
-	UsbCommand *prx = &rx;
+	// Large enough for either frame format. Automatic, not static - each
+	// session runs its own copy of this thread.
+	uint8_t rx[sizeof(UsbFrameNGHeader) + USB_CMD_DATA_SIZE_EXT];
+	size_t rx_fill = 0;
 
 #if defined(__MACH__) && defined(__APPLE__)
 	disableAppNap("Proxmark3 polling UART");
 #endif
 
-	while (conn->run) {
+	while (s->conn.run) {
 		rxlen = 0;
 		bool ACK_received = false;
-		if (uart_receive(sp, (uint8_t *)prx, sizeof(UsbCommand) - (prx-&rx), &rxlen) && rxlen) {
-			prx += rxlen;
-			if (prx-&rx < sizeof(UsbCommand)) {
-				continue;
-			}
-			UsbCommandReceived(&rx);
-			if (rx.cmd == CMD_ACK) {
-				ACK_received = true;
+		size_t need = frameLength(rx, rx_fill);
+		if (rx_fill < need
+				&& port_receive(s->sp, rx + rx_fill, need - rx_fill, &rxlen) && rxlen) {
+			rx_fill += rxlen;
+		}
+
+		// Consume every complete frame in the buffer. Until the first dword
+		// of a frame has arrived we have to probe for a worst-case legacy
+		// frame, and uart_receive() drains whatever the kernel has buffered
+		// up to that length - so one read can span several shorter NG frames
+		// and end mid-frame. Anything past a consumed frame is the start of
+		// the next one and must be kept, not discarded.
+		while (rx_fill >= (need = frameLength(rx, rx_fill))) {
+			perfNoteReceived(need);
+			recordFrame(PM3_REC_DIR_RX, rx, need);
+			uint32_t magic;
+			memcpy(&magic, rx, sizeof(magic));
+			if (magic == USB_FRAME_NG_MAGIC) {
+				UsbFrameNGHeader header;
+				memcpy(&header, rx, sizeof(header));
+				UsbFrameNGReceived(s, &header, rx + sizeof(UsbFrameNGHeader));
+				if (header.cmd == CMD_ACK) {
+					ACK_received = true;
+				}
+			} else {
+				UsbCommandReceived(s, (UsbCommand *)rx);
+				if (((UsbCommand *)rx)->cmd == CMD_ACK) {
+					ACK_received = true;
+				}
 			}
+			rx_fill -= need;
+			memmove(rx, rx + need, rx_fill);
 		}
-		prx = &rx;
 
-		
-		pthread_mutex_lock(&txBufferMutex);
 
-		if (conn->block_after_ACK) {
+		pthread_mutex_lock(&s->txBufferMutex);
+
+		if (s->conn.block_after_ACK) {
 			// if we just received an ACK, wait here until a new command is to be transmitted
 			if (ACK_received) {
-				while (!txBuffer_pending) {
-					pthread_cond_wait(&txBufferSig, &txBufferMutex);
+				while (s->tx_head == s->tx_tail) {
+					pthread_cond_wait(&s->txBufferSig, &s->txBufferMutex);
 				}
 			}
 		}
-				
-		if(txBuffer_pending) {
-			if (!uart_send(sp, (uint8_t*) &txBuffer, sizeof(UsbCommand))) {
+
+		while (s->tx_head != s->tx_tail) {
+			if (!port_send(s->sp, (uint8_t*) &s->txRing[s->tx_tail], sizeof(UsbCommand))) {
 				PrintAndLog("Sending bytes to proxmark failed");
 			}
-			txBuffer_pending = false;
-			pthread_cond_signal(&txBufferSig); // tell main thread that txBuffer is empty
+			recordFrame(PM3_REC_DIR_TX, (uint8_t*) &s->txRing[s->tx_tail], sizeof(UsbCommand));
+			s->tx_tail = (s->tx_tail + 1) % TX_RING_SIZE;
+			pthread_cond_signal(&s->txBufferSig); // a slot freed up for the main thread
 		}
 
-		pthread_mutex_unlock(&txBufferMutex);
+		pthread_mutex_unlock(&s->txBufferMutex);
 	}
 
 #if defined(__MACH__) && defined(__APPLE__)
@@ -264,117 +915,150 @@ __attribute__((force_align_arg_pointer))
  */
 bool GetFromBigBuf(uint8_t *dest, int bytes, int start_index, UsbCommand *response, size_t ms_timeout, bool show_warning)
 {
-	UsbCommand c = {CMD_DOWNLOAD_RAW_ADC_SAMPLES_125K, {start_index, bytes, 0}};
+	// Payload frames are written straight into dest by the communication
+	// thread; we only wait for the final ACK here.
+	RegisterStreamTarget(dest, bytes, CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K);
+
+	// Old firmware ignores arg[2] and always sends raw chunks
+	UsbCommand c = {CMD_DOWNLOAD_RAW_ADC_SAMPLES_125K, {start_index, bytes, FLAG_DOWNLOAD_COMPRESS}};
 	SendCommand(&c);
 
-	uint64_t start_time = msclock();
+	bool ack_received = WaitForResponseTimeoutW(CMD_ACK, response, ms_timeout, show_warning);
+	UnregisterStreamTarget();
+	return ack_received;
+}
 
-	UsbCommand resp;
-  	if (response == NULL) {
-		response = &resp;
+	
+/**
+ * Ask the device to switch to variable-length response frames. Old firmware
+ * doesn't know CMD_FRAME_NEGOTIATE and only logs it, so a timeout simply
+ * means we stay on fixed-size frames.
+ * @brief TryExtendedFraming
+ * @return true if the device acknowledged variable-length framing
+ */
+bool TryExtendedFraming(void)
+{
+	if (cur()->offline) {
+		return false;
 	}
 
-	int bytes_completed = 0;
-	while(true) {
-		if (getCommand(response)) {
-			if (response->cmd == CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K) {
-				int copy_bytes = MIN(bytes - bytes_completed, response->arg[1]);
-				memcpy(dest + response->arg[0], response->d.asBytes, copy_bytes);
-				bytes_completed += copy_bytes;
-			} else if (response->cmd == CMD_ACK) {
-				return true;
-			}
-		}
+	UsbCommand c = {CMD_FRAME_NEGOTIATE, {1, 0, 0}};
+	UsbCommand resp;
 
-		if (msclock() - start_time > ms_timeout) {
-			break;
-		}
+	clearCommandBuffer();
+	SendCommand(&c);
 
-		if (msclock() - start_time > 2000 && show_warning) {
-			PrintAndLog("Waiting for a response from the proxmark...");
-			PrintAndLog("You can cancel this operation by pressing the pm3 button");
-			show_warning = false;
-		}
+	if (!WaitForResponseTimeoutW(CMD_ACK, &resp, 1000, false)) {
+		return false;
 	}
 
-	return false;
+	return resp.arg[0] >= USB_CMD_DATA_SIZE;
 }
 
-	
+
 bool GetFromFpgaRAM(uint8_t *dest, int bytes)
 {
+	RegisterStreamTarget(dest, bytes, CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K);
+
 	UsbCommand c = {CMD_HF_PLOT, {0, 0, 0}};
 	SendCommand(&c);
 
-	uint64_t start_time = msclock();
+	bool ack_received = WaitForResponseTimeoutW(CMD_ACK, NULL, -1, true);
+	UnregisterStreamTarget();
+	return ack_received;
+}
 
-	UsbCommand response;
-	
-	int bytes_completed = 0;
-	bool show_warning = true;
-	while(true) {
-		if (getCommand(&response)) {
-			if (response.cmd == CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K) {
-				int copy_bytes = MIN(bytes - bytes_completed, response.arg[1]);
-				memcpy(dest + response.arg[0], response.d.asBytes, copy_bytes);
-				bytes_completed += copy_bytes;
-			} else if (response.cmd == CMD_ACK) {
-				return true;
-			}
-		}
 
-		if (msclock() - start_time > 2000 && show_warning) {
-			PrintAndLog("Waiting for a response from the proxmark...");
-			PrintAndLog("You can cancel this operation by pressing the pm3 button");
-			show_warning = false;
-		}
-	}
+// Warm asset preloading. The client registers a hook (see proxmark3.c)
+// that reads the big read-only assets - hardnested tables, dictionaries -
+// so they are in the page cache before the first command wants them.
+// It runs on a detached thread kicked off as the first session opens,
+// overlapping with the port open and version exchange. This stays a hook
+// because comms.c is also linked into the flasher, which has no assets.
+static void (*preload_hook)(void) = NULL;
 
-	return false;
+void SetConnectPreloadHook(void (*hook)(void)) {
+	preload_hook = hook;
 }
 
+static void *preload_thread(void *arg) {
+	(void)arg;
+	preload_hook();
+	return NULL;
+}
 
-bool OpenProxmark(void *port, bool wait_for_port, int timeout, bool flash_mode) {
-	char *portname = (char *)port;
-	if (!wait_for_port) {
-		sp = uart_open(portname);
+static void preload_kick(void) {
+	static bool started = false;
+	if (preload_hook == NULL || started) {
+		return;
+	}
+	started = true;
+	pthread_t t;
+	if (pthread_create(&t, NULL, preload_thread, NULL) == 0) {
+		pthread_detach(t);
+	}
+}
+
+// open a device into session s. Shared by OpenProxmark() and SessionOpen().
+static bool session_open(comms_session_t *s, char *portname, bool wait_for_port, int timeout, bool flash_mode) {
+	preload_kick();
+	session_init(s);
+	if (uart_replay_is_port_name(portname)) {
+		// recorded session standing in for a device; no point in waiting
+		s->sp = uart_replay_open(portname);
+	} else if (!wait_for_port) {
+		s->sp = uart_open(portname);
 	} else {
 		printf("Waiting for Proxmark to appear on %s ", portname);
 		fflush(stdout);
 		int openCount = 0;
 		do {
-			sp = uart_open(portname);
+			s->sp = uart_open(portname);
 			msleep(1000);
 			printf(".");
 			fflush(stdout);
-		} while(++openCount < timeout && (sp == INVALID_SERIAL_PORT || sp == CLAIMED_SERIAL_PORT));
+		} while(++openCount < timeout && (s->sp == INVALID_SERIAL_PORT || s->sp == CLAIMED_SERIAL_PORT));
 		printf("\n");
 	}
 
 	// check result of uart opening
-	if (sp == INVALID_SERIAL_PORT) {
+	if (s->sp == INVALID_SERIAL_PORT) {
 		printf("ERROR: invalid serial port\n");
-		sp = NULL;
-		serial_port_name = NULL;
+		s->sp = NULL;
+		s->serial_port_name = NULL;
 		return false;
-	} else if (sp == CLAIMED_SERIAL_PORT) {
+	} else if (s->sp == CLAIMED_SERIAL_PORT) {
 		printf("ERROR: serial port is claimed by another process\n");
-		sp = NULL;
-		serial_port_name = NULL;
+		s->sp = NULL;
+		s->serial_port_name = NULL;
 		return false;
 	} else {
 		// start the USB communication thread
-		serial_port_name = portname;
-		conn.run = true;
-		conn.block_after_ACK = flash_mode;
-		pthread_create(&USB_communication_thread, NULL, &uart_communication, &conn);
+		// note: strdup() isn't declared under -std=c99 -D_ISOC99_SOURCE
+		s->serial_port_name = malloc(strlen(portname) + 1);
+		if (s->serial_port_name != NULL) {
+			strcpy(s->serial_port_name, portname);
+		}
+		s->offline = false;
+		s->cmd_head = s->cmd_tail = 0;
+		s->tx_head = s->tx_tail = 0;
+		for (int i = 0; i < RESP_POOL_SIZE; i++) {
+			s->respPool[i].refs = 0;
+		}
+		s->conn.run = true;
+		s->conn.block_after_ACK = flash_mode;
+		pthread_create(&s->USB_communication_thread, NULL, &uart_communication, s);
 		return true;
 	}
 }
 
 
-void CloseProxmark(void) {
-	conn.run = false;
+static void session_close(comms_session_t *s) {
+	if (s->sp == NULL) {
+		return;
+	}
+
+	s->conn.run = false;
 
 #ifdef __BIONIC__
 	// In Android O and later, if an invalid pthread_t is passed to pthread_join, it calls fatal().
@@ -382,36 +1066,152 @@ void CloseProxmark(void) {
 	//
 	// In Bionic libc, pthread_t is an integer.
 
-	if (USB_communication_thread != 0) {
-		pthread_join(USB_communication_thread, NULL);
+	if (s->USB_communication_thread != 0) {
+		pthread_join(s->USB_communication_thread, NULL);
 	}
 #else
 	// pthread_t is a struct on other libc, treat as an opaque memory reference
-	pthread_join(USB_communication_thread, NULL);
+	pthread_join(s->USB_communication_thread, NULL);
 #endif
 
-	if (sp) {
-		uart_close(sp);
+	if (uart_replay_is(s->sp)) {
+		uart_replay_close(s->sp);
+		s->sp = NULL;
+		// nothing to unlink for a replay port
+		free(s->serial_port_name);
+		s->serial_port_name = NULL;
+	} else {
+		uart_close(s->sp);
 	}
 
 #if defined(__linux__) && !defined(NO_UNLINK)
 	// Fix for linux, it seems that it is extremely slow to release the serial port file descriptor /dev/*
 	//
 	// This may be disabled at compile-time with -DNO_UNLINK (used for a JNI-based serial port on Android).
-	if (serial_port_name) {
-		unlink(serial_port_name);
+	if (s->serial_port_name) {
+		unlink(s->serial_port_name);
 	}
 #endif
 
 	// Clean up our state
-	sp = NULL;
-	serial_port_name = NULL;
+	s->sp = NULL;
+	free(s->serial_port_name);
+	s->serial_port_name = NULL;
+	s->offline = true;
 #ifdef __BIONIC__
-	memset(&USB_communication_thread, 0, sizeof(pthread_t));
+	memset(&s->USB_communication_thread, 0, sizeof(pthread_t));
 #endif
 }
 
 
+bool OpenProxmark(void *port, bool wait_for_port, int timeout, bool flash_mode) {
+	return session_open(cur(), (char *)port, wait_for_port, timeout, flash_mode);
+}
+
+
+void CloseProxmark(void) {
+	session_close(cur());
+}
+
+
+/**
+ * @brief SessionOpen opens an additional device into a free session slot and
+ * selects it. The initial connection made at startup occupies slot 0.
+ * @return session index, or -1 if the port could not be opened or all slots are taken
+ */
+int SessionOpen(const char *port) {
+	for (int i = 0; i < COMMS_MAX_SESSIONS; i++) {
+		if (sessions[i].sp != NULL) {
+			continue;
+		}
+		if (!session_open(&sessions[i], (char *)port, false, 0, false)) {
+			return -1;
+		}
+		current_session = i;
+		return i;
+	}
+	PrintAndLog("All %d session slots are in use", COMMS_MAX_SESSIONS);
+	return -1;
+}
+
+
+/**
+ * @brief SessionSelect routes subsequent commands to the given session.
+ */
+bool SessionSelect(int index) {
+	if (index < 0 || index >= COMMS_MAX_SESSIONS) {
+		return false;
+	}
+	if (sessions[index].sp == NULL && index != 0) {
+		return false;
+	}
+	current_session = index;
+	return true;
+}
+
+
+/**
+ * @brief SessionClose closes the given session. When it was the selected one,
+ * selection falls back to the lowest connected session (or slot 0).
+ */
+void SessionClose(int index) {
+	if (index < 0 || index >= COMMS_MAX_SESSIONS) {
+		return;
+	}
+	session_close(&sessions[index]);
+	if (index == current_session) {
+		current_session = 0;
+		for (int i = 0; i < COMMS_MAX_SESSIONS; i++) {
+			if (sessions[i].sp != NULL) {
+				current_session = i;
+				break;
+			}
+		}
+	}
+}
+
+
+void SessionCloseAll(void) {
+	for (int i = 0; i < COMMS_MAX_SESSIONS; i++) {
+		session_close(&sessions[i]);
+	}
+	current_session = 0;
+}
+
+
+int SessionCurrent(void) {
+	return current_session;
+}
+
+
+void SessionList(void) {
+	int shown = 0;
+	for (int i = 0; i < COMMS_MAX_SESSIONS; i++) {
+		comms_session_t *s = &sessions[i];
+		if (s->sp == NULL) {
+			continue;
+		}
+		PrintAndLog("%c %d: %s", i == current_session ? '*' : ' ', i, s->serial_port_name);
+		shown++;
+	}
+	if (shown == 0) {
+		PrintAndLog("No connected sessions (offline)");
+	}
+}
+
+
+// absolute CLOCK_REALTIME deadline ms milliseconds from now, for pthread_cond_timedwait
+static void waitDeadline(struct timespec *ts, size_t ms)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	ts->tv_sec = now.tv_sec + ms / 1000;
+	long usec = now.tv_usec + (ms % 1000) * 1000;
+	ts->tv_sec += usec / 1000000;
+	ts->tv_nsec = (usec % 1000000) * 1000;
+}
+
+
 /**
  * Waits for a certain response type. This method waits for a maximum of
  * ms_timeout milliseconds for a specified response command.
@@ -424,6 +1224,7 @@ void CloseProxmark(void) {
  */
 bool WaitForResponseTimeoutW(uint32_t cmd, UsbCommand* response, size_t ms_timeout, bool show_warning) {
 
+	comms_session_t *s = cur();
 	UsbCommand resp;
 
 	#ifdef COMMS_DEBUG
@@ -435,13 +1236,25 @@ bool WaitForResponseTimeoutW(uint32_t cmd, UsbCommand* response, size_t ms_timeo
 	}
 
 	uint64_t start_time = msclock();
+	ms_timeout = adaptiveTimeout(ms_timeout);
 
-	// Wait until the command is received
+	// Wait until the command is received. The communication thread signals
+	// rxBufferSig for every stored response, so arrivals are picked up
+	// immediately; the 100ms cap on each wait only services the timeout and
+	// warning bookkeeping.
+	pthread_mutex_lock(&s->rxBufferMutex);
 	while (true) {
-		while(getCommand(response)) {
-			if (cmd == CMD_UNKNOWN || response->cmd == cmd) {
+		while (s->cmd_head != s->cmd_tail) {
+			pooled_resp_t *pr = s->rxBuffer[s->cmd_tail];
+			s->cmd_tail = (s->cmd_tail + 1) % CMD_BUFFER_SIZE;
+			if (cmd == CMD_UNKNOWN || pr->cmd.cmd == cmd) {
+				memcpy(response, &pr->cmd, sizeof(UsbCommand));
+				pr->refs--;
+				pthread_mutex_unlock(&s->rxBufferMutex);
+				perfNoteWaitDone(true);
 				return true;
 			}
+			pr->refs--;
 		}
 
 		if (msclock() - start_time > ms_timeout) {
@@ -454,7 +1267,13 @@ bool WaitForResponseTimeoutW(uint32_t cmd, UsbCommand* response, size_t ms_timeo
 			PrintAndLog("You can cancel this operation by pressing the pm3 button");
 			show_warning = false;
 		}
+
+		struct timespec ts;
+		waitDeadline(&ts, 100);
+		pthread_cond_timedwait(&s->rxBufferSig, &s->rxBufferMutex, &ts);
 	}
+	pthread_mutex_unlock(&s->rxBufferMutex);
+	perfNoteWaitDone(false);
 	return false;
 }
 
@@ -467,3 +1286,66 @@ bool WaitForResponse(uint32_t cmd, UsbCommand* response) {
 	return WaitForResponseTimeoutW(cmd, response, -1, true);
 }
 
+/**
+ * @brief WaitForResponseInPlace is WaitForResponseTimeout without the
+ * 544-byte copy-out: on success the caller gets the pooled response buffer
+ * itself and reads the payload in place. The buffer - and its pool slot -
+ * stays valid until ReleaseResponse() is called on it.
+ * @param cmd command to wait for, or CMD_UNKNOWN to take any command.
+ * @param ms_timeout
+ * @return borrowed response buffer, or NULL on timeout
+ */
+UsbCommand *WaitForResponseInPlace(uint32_t cmd, size_t ms_timeout)
+{
+	comms_session_t *s = cur();
+	uint64_t start_time = msclock();
+	ms_timeout = adaptiveTimeout(ms_timeout);
+
+	pthread_mutex_lock(&s->rxBufferMutex);
+	while (true) {
+		while (s->cmd_head != s->cmd_tail) {
+			pooled_resp_t *pr = s->rxBuffer[s->cmd_tail];
+			s->cmd_tail = (s->cmd_tail + 1) % CMD_BUFFER_SIZE;
+			if (cmd == CMD_UNKNOWN || pr->cmd.cmd == cmd) {
+				// the ring's reference moves to the caller
+				pthread_mutex_unlock(&s->rxBufferMutex);
+				perfNoteWaitDone(true);
+				return &pr->cmd;
+			}
+			pr->refs--;
+		}
+
+		if (msclock() - start_time > ms_timeout) {
+			break;
+		}
+
+		struct timespec ts;
+		waitDeadline(&ts, 100);
+		pthread_cond_timedwait(&s->rxBufferSig, &s->rxBufferMutex, &ts);
+	}
+	pthread_mutex_unlock(&s->rxBufferMutex);
+	perfNoteWaitDone(false);
+	return NULL;
+}
+
+/**
+ * @brief ReleaseResponse returns a buffer borrowed through
+ * WaitForResponseInPlace to its session's pool.
+ */
+void ReleaseResponse(UsbCommand *response)
+{
+	if (response == NULL) {
+		return;
+	}
+	pooled_resp_t *pr = (pooled_resp_t *)response;
+	for (int i = 0; i < COMMS_MAX_SESSIONS; i++) {
+		comms_session_t *s = &sessions[i];
+		if (pr >= s->respPool && pr < s->respPool + RESP_POOL_SIZE) {
+			pthread_mutex_lock(&s->rxBufferMutex);
+			pr->refs--;
+			pthread_mutex_unlock(&s->rxBufferMutex);
+			return;
+		}
+	}
+}
+
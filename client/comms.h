@@ -25,16 +25,71 @@
 void SetOffline(bool new_offline);
 bool IsOffline();
 
+// optional hook run on a detached background thread when the first
+// session opens, so big read-only assets can fault in while the USB
+// negotiation proceeds
+void SetConnectPreloadHook(void (*hook)(void));
+
 bool OpenProxmark(void *port, bool wait_for_port, int timeout, bool flash_mode);
 void CloseProxmark(void);
 
+// Multiple attached devices. Each session has its own communication thread
+// and response buffers; commands are routed to the selected session.
+// See 'hw session'.
+#ifndef COMMS_MAX_SESSIONS
+#define COMMS_MAX_SESSIONS 8
+#endif
+
+int SessionOpen(const char *port);
+bool SessionSelect(int index);
+void SessionClose(int index);
+void SessionCloseAll(void);
+int SessionCurrent(void);
+void SessionList(void);
+
 void SendCommand(UsbCommand *c);
+bool SendCommandBatch(UsbCommand *cmds, uint16_t *data_lens, uint16_t count);
+bool TryExtendedFraming(void);
+
+// Asynchronous command submission. A request completes when a response of
+// the expected type arrives; completions are matched in submission order.
+#ifndef ASYNC_MAX_PENDING
+#define ASYNC_MAX_PENDING 16
+#endif
+
+typedef void (*CommandCompletionCB)(UsbCommand *response, void *context);
+
+uint64_t SendCommandAsync(UsbCommand *c, uint32_t expected_cmd, CommandCompletionCB callback, void *context);
+bool PollAsyncResponse(uint64_t handle, UsbCommand *response);
+bool WaitAsyncResponseTimeout(uint64_t handle, UsbCommand *response, size_t ms_timeout);
 
 void clearCommandBuffer();
 bool WaitForResponseTimeoutW(uint32_t cmd, UsbCommand* response, size_t ms_timeout, bool show_warning);
 bool WaitForResponseTimeout(uint32_t cmd, UsbCommand* response, size_t ms_timeout);
 bool WaitForResponse(uint32_t cmd, UsbCommand* response);
+// zero-copy variant: read the response payload in the pooled buffer itself,
+// then hand the buffer back with ReleaseResponse()
+UsbCommand *WaitForResponseInPlace(uint32_t cmd, size_t ms_timeout);
+void ReleaseResponse(UsbCommand *response);
 bool GetFromBigBuf(uint8_t *dest, int bytes, int start_index, UsbCommand *response, size_t ms_timeout, bool show_warning);
 bool GetFromFpgaRAM(uint8_t *dest, int bytes);
 
+// Streaming downloads: payload frames of type cmd bypass the response ring
+// buffer and are written directly into dest by the communication thread.
+void RegisterStreamTarget(uint8_t *dest, size_t n, uint32_t cmd);
+size_t UnregisterStreamTarget(void);
+
+// Session recorder ('hw record'): captures the command/response traffic of
+// all open sessions with timing, in the format uart_replay.c replays.
+bool StartSessionRecording(const char *path);
+void StopSessionRecording(void);
+bool SessionRecordingActive(void);
+
+// Comms latency/throughput counters, see 'hw perf'
+void PerfPrint(void);
+void PerfReset(void);
+// adaptive, histogram-derived response timeouts ('hw perf a')
+void SetAdaptiveTimeout(bool enable);
+bool GetAdaptiveTimeout(void);
+
 #endif // COMMS_H_
@@ -354,6 +354,51 @@ int ecdsa_signature_verify(mbedtls_ecp_group_id curveID, uint8_t *key_xy, uint8_
 	return res;
 }
 
+// Same check, but the context (curve group and public key point) is kept
+// between calls and rebuilt only when the key or curve changes. Loading the
+// group costs more than a single P-256 verification, so callers that verify
+// many signatures with one key (FIDO conformance runs) should use this.
+int ecdsa_signature_verify_cached(mbedtls_ecp_group_id curveID, uint8_t *key_xy, uint8_t *input, int length, uint8_t *signature, size_t signaturelen, bool hash) {
+	static mbedtls_ecdsa_context ctx;
+	static bool ctx_valid = false;
+	static mbedtls_ecp_group_id ctx_curve;
+	static uint8_t ctx_key[133];	// 04 || x || y, up to P-521
+
+	int res;
+	uint8_t shahash[32] = {0};
+	if (hash) {
+		res = sha256hash(input, length, shahash);
+		if (res)
+			return res;
+	}
+
+	if (ctx_valid) {
+		size_t keylen = (ctx.grp.nbits + 7) / 8;
+		if (ctx_curve != curveID || memcmp(ctx_key, key_xy, keylen * 2 + 1)) {
+			mbedtls_ecdsa_free(&ctx);
+			ctx_valid = false;
+		}
+	}
+
+	if (!ctx_valid) {
+		res = ecdsa_init(&ctx, curveID, NULL, key_xy);
+		if (res) {
+			mbedtls_ecdsa_free(&ctx);
+			return res;
+		}
+		size_t keylen = (ctx.grp.nbits + 7) / 8;
+		if (keylen * 2 + 1 > sizeof(ctx_key)) {
+			mbedtls_ecdsa_free(&ctx);
+			return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+		}
+		memcpy(ctx_key, key_xy, keylen * 2 + 1);
+		ctx_curve = curveID;
+		ctx_valid = true;
+	}
+
+	return mbedtls_ecdsa_read_signature(&ctx, hash?shahash:input, hash?sizeof(shahash):length, signature, signaturelen);
+}
+
 
 int ecdsa_signature_r_s_verify(mbedtls_ecp_group_id curveID, uint8_t *key_xy, uint8_t *input, int length, uint8_t *r_s, size_t r_s_len, bool hash) {
     int res;
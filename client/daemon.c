@@ -0,0 +1,205 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Daemon mode: a resident client process that keeps the device session, the
+// Lua state and all warmed caches (hardnested tables, dictionaries, ...)
+// alive and executes commands forwarded over a local socket. Scripted
+// callers use 'proxmark3 -s <socket> "<cmd>"' per operation and skip the
+// serial open/negotiation and interpreter start-up entirely.
+//
+// The protocol is one line per connection: the caller sends the command
+// line, the daemon runs it with stdout redirected to the connection and
+// finishes with a trailer line - the command's return code prefixed with an
+// EOT byte, which cannot occur in command output.
+//-----------------------------------------------------------------------------
+
+#ifndef _WIN32
+#define _DEFAULT_SOURCE			// for dup(), dup2() with -std=c99
+#endif
+
+#include "daemon.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "comms.h"
+#include "cmdmain.h"
+#include "cmdhw.h"
+
+#define DAEMON_RC_PREFIX	'\x04'
+#define DAEMON_CMD_LEN		256
+
+// read one command line from the connection; returns its length, 0 on EOF
+// before a newline, -1 on error
+static int read_request(int fd, char *buf, size_t len) {
+	size_t total = 0;
+	while (total < len - 1) {
+		ssize_t n = read(fd, buf + total, 1);
+		if (n < 0) return -1;
+		if (n == 0) return 0;
+		if (buf[total] == '\n') break;
+		total++;
+	}
+	buf[total] = '\0';
+	// trim trailing whitespace like the interactive loop does
+	while (total > 0 && (buf[total-1] == ' ' || buf[total-1] == '\r'))
+		buf[--total] = '\0';
+	return (int)total;
+}
+
+void daemon_loop(const char *socket_path, bool usb_present) {
+	// same session warmup as the interactive main_loop
+	if (usb_present) {
+		SetOffline(false);
+		CmdVersion(NULL);
+		TryExtendedFraming();
+	} else {
+		SetOffline(true);
+	}
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		perror("daemon: socket");
+		return;
+	}
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	unlink(socket_path);
+
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 5) < 0) {
+		perror("daemon: bind/listen");
+		close(sock);
+		return;
+	}
+
+	printf("daemon: serving commands on %s\n", socket_path);
+
+	char cmd[DAEMON_CMD_LEN];
+	bool quit = false;
+	while (!quit) {
+		int conn = accept(sock, NULL, NULL);
+		if (conn < 0)
+			continue;
+
+		if (read_request(conn, cmd, sizeof(cmd)) <= 0) {
+			close(conn);
+			continue;
+		}
+
+		// run the command with its output going to the caller
+		fflush(stdout);
+		int saved_stdout = dup(STDOUT_FILENO);
+		dup2(conn, STDOUT_FILENO);
+
+		int ret = CommandReceived(cmd);
+
+		fflush(stdout);
+		dup2(saved_stdout, STDOUT_FILENO);
+		close(saved_stdout);
+
+		if (ret == 99) {	// exit or quit shuts the daemon down
+			ret = 0;
+			quit = true;
+		}
+		char trailer[16];
+		int tlen = snprintf(trailer, sizeof(trailer), "%c%d\n", DAEMON_RC_PREFIX, ret);
+		if (write(conn, trailer, tlen) < 0) {
+			// caller went away; nothing sensible to do about it
+		}
+		close(conn);
+	}
+
+	close(sock);
+	unlink(socket_path);
+}
+
+int daemon_send(const char *socket_path, const char *command) {
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		perror("socket");
+		return 2;
+	}
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		fprintf(stderr, "cannot reach daemon at %s: ", socket_path);
+		perror("connect");
+		close(sock);
+		return 2;
+	}
+
+	size_t cmdlen = strlen(command);
+	if (write(sock, command, cmdlen) != (ssize_t)cmdlen || write(sock, "\n", 1) != 1) {
+		perror("write");
+		close(sock);
+		return 2;
+	}
+
+	// stream the output; everything from the EOT byte on is the trailer
+	int rc = 0;
+	char buf[4096];
+	char rcbuf[16] = {0};
+	size_t rclen = 0;
+	bool in_trailer = false;
+	ssize_t n;
+	while ((n = read(sock, buf, sizeof(buf))) > 0) {
+		char *p = buf;
+		if (!in_trailer) {
+			char *eot = memchr(buf, DAEMON_RC_PREFIX, n);
+			if (eot == NULL) {
+				fwrite(buf, 1, n, stdout);
+				continue;
+			}
+			fwrite(buf, 1, eot - buf, stdout);
+			n -= (eot + 1) - buf;
+			p = eot + 1;
+			in_trailer = true;
+		}
+		while (n > 0 && rclen < sizeof(rcbuf) - 1) {
+			rcbuf[rclen++] = *p++;
+			n--;
+		}
+	}
+	close(sock);
+	fflush(stdout);
+
+	if (!in_trailer) {
+		fprintf(stderr, "daemon closed the connection without a result\n");
+		return 2;
+	}
+	rc = atoi(rcbuf);
+	return rc;
+}
+
+#else	// _WIN32
+
+void daemon_loop(const char *socket_path, bool usb_present) {
+	(void) socket_path;
+	(void) usb_present;
+	printf("daemon mode is not supported on Windows\n");
+}
+
+int daemon_send(const char *socket_path, const char *command) {
+	(void) socket_path;
+	(void) command;
+	printf("daemon mode is not supported on Windows\n");
+	return 1;
+}
+
+#endif
@@ -0,0 +1,22 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Daemon mode - resident client session behind a local socket
+//-----------------------------------------------------------------------------
+
+#ifndef DAEMON_H__
+#define DAEMON_H__
+
+#include <stdbool.h>
+
+// Serve commands from a local socket using this process' device session.
+// Returns when a forwarded 'quit' or 'exit' command is received.
+void daemon_loop(const char *socket_path, bool usb_present);
+
+// Thin forwarding client: send one command to a running daemon, stream its
+// output to stdout and return the command's return code.
+int daemon_send(const char *socket_path, const char *command);
+
+#endif
@@ -74,19 +74,23 @@ int CmdEMVSelect(const char *cmd) {
 		"Executes select applet command",
 		"Usage:\n\temv select -s a00000000101 -> select card, select applet\n\temv select -st a00000000101 -> select card, select applet, show result in TLV\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("sS",  "select",  "activate field and select card"),
-		arg_lit0("kK",  "keep",    "keep field for next command"),
-		arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
-		arg_lit0("tT",  "tlv",     "TLV decode results"),
-#ifdef WITH_SMARTCARD
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-#endif
-		arg_strx0(NULL,  NULL,     "<HEX applet AID>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("sS",  "select",  "activate field and select card"),
+			arg_lit0("kK",  "keep",    "keep field for next command"),
+			arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
+			arg_lit0("tT",  "tlv",     "TLV decode results"),
+	#ifdef WITH_SMARTCARD
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+	#endif
+			arg_strx0(NULL,  NULL,     "<HEX applet AID>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	bool activateField = arg_get_lit(1);
 	bool leaveSignalON = arg_get_lit(2);
@@ -129,18 +133,22 @@ int CmdEMVSearch(const char *cmd) {
 		"Tries to select all applets from applet list:\n",
 		"Usage:\n\temv search -s -> select card and search\n\temv search -st -> select card, search and show result in TLV\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("sS",  "select",  "activate field and select card"),
-		arg_lit0("kK",  "keep",    "keep field ON for next command"),
-		arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
-		arg_lit0("tT",  "tlv",     "TLV decode results of selected applets"),
-#ifdef WITH_SMARTCARD
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-#endif
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("sS",  "select",  "activate field and select card"),
+			arg_lit0("kK",  "keep",    "keep field ON for next command"),
+			arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
+			arg_lit0("tT",  "tlv",     "TLV decode results of selected applets"),
+	#ifdef WITH_SMARTCARD
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+	#endif
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	bool activateField = arg_get_lit(1);
 	bool leaveSignalON = arg_get_lit(2);
@@ -183,20 +191,24 @@ int CmdEMVPPSE(const char *cmd) {
 		"Executes PSE/PPSE select command. It returns list of applet on the card:\n",
 		"Usage:\n\temv pse -s1 -> select, get pse\n\temv pse -st2 -> select, get ppse, show result in TLV\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("sS",  "select",  "activate field and select card"),
-		arg_lit0("kK",  "keep",    "keep field ON for next command"),
-		arg_lit0("1",   "pse",     "pse (1PAY.SYS.DDF01) mode"),
-		arg_lit0("2",   "ppse",    "ppse (2PAY.SYS.DDF01) mode (default mode)"),
-		arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
-		arg_lit0("tT",  "tlv",     "TLV decode results of selected applets"),
-#ifdef WITH_SMARTCARD
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-#endif
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("sS",  "select",  "activate field and select card"),
+			arg_lit0("kK",  "keep",    "keep field ON for next command"),
+			arg_lit0("1",   "pse",     "pse (1PAY.SYS.DDF01) mode"),
+			arg_lit0("2",   "ppse",    "ppse (2PAY.SYS.DDF01) mode (default mode)"),
+			arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
+			arg_lit0("tT",  "tlv",     "TLV decode results of selected applets"),
+	#ifdef WITH_SMARTCARD
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+	#endif
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	bool activateField = arg_get_lit(1);
 	bool leaveSignalON = arg_get_lit(2);
@@ -246,20 +258,24 @@ int CmdEMVGPO(const char *cmd) {
 			"\temv gpo -t 01020304 -> execute GPO with 4-byte PDOL data, show result in TLV\n"
 			"\temv gpo -pmt 9F 37 04 -> load params from file, make PDOL data from PDOL, execute GPO with PDOL, show result in TLV\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("kK",  "keep",    "keep field ON for next command"),
-		arg_lit0("pP",  "params",  "load parameters from `emv/defparams.json` file for PDOLdata making from PDOL and parameters"),
-		arg_lit0("mM",  "make",    "make PDOLdata from PDOL (tag 9F38) and parameters (by default uses default parameters)"),
-		arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
-		arg_lit0("tT",  "tlv",     "TLV decode results of selected applets"),
-#ifdef WITH_SMARTCARD
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-#endif
-		arg_strx0(NULL,  NULL,     "<HEX PDOLdata/PDOL>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("kK",  "keep",    "keep field ON for next command"),
+			arg_lit0("pP",  "params",  "load parameters from `emv/defparams.json` file for PDOLdata making from PDOL and parameters"),
+			arg_lit0("mM",  "make",    "make PDOLdata from PDOL (tag 9F38) and parameters (by default uses default parameters)"),
+			arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
+			arg_lit0("tT",  "tlv",     "TLV decode results of selected applets"),
+	#ifdef WITH_SMARTCARD
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+	#endif
+			arg_strx0(NULL,  NULL,     "<HEX PDOLdata/PDOL>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	bool leaveSignalON = arg_get_lit(1);
 	bool paramsLoadFromFile = arg_get_lit(2);
@@ -350,16 +366,20 @@ int CmdEMVReadRecord(const char *cmd) {
 		"Executes Read Record command. It returns data in TLV format.\nNeeds a bank applet to be selected and sometimes needs GPO to be executed.",
 		"Usage:\n\temv readrec -k 0101 -> read file SFI=01, SFIrec=01\n\temv readrec -kt 0201-> read file 0201 and show result in TLV\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("kK",  "keep",    "keep field ON for next command"),
-		arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
-		arg_lit0("tT",  "tlv",     "TLV decode results of selected applets"),
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-		arg_strx1(NULL,  NULL,     "<SFI 1byte HEX><SFIrecord 1byte HEX>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("kK",  "keep",    "keep field ON for next command"),
+			arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
+			arg_lit0("tT",  "tlv",     "TLV decode results of selected applets"),
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+			arg_strx1(NULL,  NULL,     "<SFI 1byte HEX><SFIrecord 1byte HEX>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	bool leaveSignalON = arg_get_lit(1);
 	bool APDULogging = arg_get_lit(2);
@@ -412,22 +432,26 @@ int CmdEMVAC(const char *cmd) {
 			"\temv genac -Daac 01020304 -> generate AC with 4-byte CDOL data and terminal decision 'declined'\n"
 			"\temv genac -pmt 9F 37 04 -> load params from file, make CDOL data from CDOL, generate AC with CDOL, show result in TLV");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("kK",  "keep",     "keep field ON for next command"),
-		arg_lit0("cC",  "cda",      "executes CDA transaction. Needs to get SDAD in results."),
-		arg_str0("dD",  "decision", "<aac|tc|arqc>", "Terminal decision. aac - declined, tc - approved, arqc - online authorisation requested"),
-		arg_lit0("pP",  "params",   "load parameters from `emv/defparams.json` file for CDOLdata making from CDOL and parameters"),
-		arg_lit0("mM",  "make",     "make CDOLdata from CDOL (tag 8C and 8D) and parameters (by default uses default parameters)"),
-		arg_lit0("aA",  "apdu",     "show APDU reqests and responses"),
-		arg_lit0("tT",  "tlv",      "TLV decode results of selected applets"),
-#ifdef WITH_SMARTCARD
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-#endif
-		arg_strx1(NULL,  NULL,      "<HEX CDOLdata/CDOL>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, false);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("kK",  "keep",     "keep field ON for next command"),
+			arg_lit0("cC",  "cda",      "executes CDA transaction. Needs to get SDAD in results."),
+			arg_str0("dD",  "decision", "<aac|tc|arqc>", "Terminal decision. aac - declined, tc - approved, arqc - online authorisation requested"),
+			arg_lit0("pP",  "params",   "load parameters from `emv/defparams.json` file for CDOLdata making from CDOL and parameters"),
+			arg_lit0("mM",  "make",     "make CDOLdata from CDOL (tag 8C and 8D) and parameters (by default uses default parameters)"),
+			arg_lit0("aA",  "apdu",     "show APDU reqests and responses"),
+			arg_lit0("tT",  "tlv",      "TLV decode results of selected applets"),
+	#ifdef WITH_SMARTCARD
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+	#endif
+			arg_strx1(NULL,  NULL,      "<HEX CDOLdata/CDOL>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, false);
 
 	bool leaveSignalON = arg_get_lit(1);
 	bool trTypeCDA = arg_get_lit(2);
@@ -529,16 +553,20 @@ int CmdEMVGenerateChallenge(const char *cmd) {
 		"Executes Generate Challenge command. It returns 4 or 8-byte random number from card.\nNeeds a EMV applet to be selected and GPO to be executed.",
 		"Usage:\n\temv challenge -> get challenge\n\temv challenge -k -> get challenge, keep fileld ON\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("kK",  "keep",    "keep field ON for next command"),
-		arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
-#ifdef WITH_SMARTCARD
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-#endif
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("kK",  "keep",    "keep field ON for next command"),
+			arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
+	#ifdef WITH_SMARTCARD
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+	#endif
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	bool leaveSignalON = arg_get_lit(1);
 	bool APDULogging = arg_get_lit(2);
@@ -585,20 +613,24 @@ int CmdEMVInternalAuthenticate(const char *cmd) {
 			"\temv intauth -t 01020304 -> execute Internal Authenticate with 4-byte DDOL data, show result in TLV\n"
 			"\temv intauth -pmt 9F 37 04 -> load params from file, make DDOL data from DDOL, Internal Authenticate with DDOL, show result in TLV");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("kK",  "keep",    "keep field ON for next command"),
-		arg_lit0("pP",  "params",  "load parameters from `emv/defparams.json` file for DDOLdata making from DDOL and parameters"),
-		arg_lit0("mM",  "make",    "make DDOLdata from DDOL (tag 9F49) and parameters (by default uses default parameters)"),
-		arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
-		arg_lit0("tT",  "tlv",     "TLV decode results of selected applets"),
-#ifdef WITH_SMARTCARD
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-#endif
-		arg_strx1(NULL,  NULL,     "<HEX DDOLdata/DDOL>", NULL),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, false);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("kK",  "keep",    "keep field ON for next command"),
+			arg_lit0("pP",  "params",  "load parameters from `emv/defparams.json` file for DDOLdata making from DDOL and parameters"),
+			arg_lit0("mM",  "make",    "make DDOLdata from DDOL (tag 9F49) and parameters (by default uses default parameters)"),
+			arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
+			arg_lit0("tT",  "tlv",     "TLV decode results of selected applets"),
+	#ifdef WITH_SMARTCARD
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+	#endif
+			arg_strx1(NULL,  NULL,     "<HEX DDOLdata/DDOL>", NULL),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, false);
 
 	bool leaveSignalON = arg_get_lit(1);
 	bool paramsLoadFromFile = arg_get_lit(2);
@@ -805,22 +837,26 @@ int CmdEMVExec(const char *cmd) {
 			"\temv exec -sat -> select card, execute MSD transaction, show APDU and TLV\n"
 			"\temv exec -satc -> select card, execute CDA transaction, show APDU and TLV\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("sS",  "select",   "activate field and select card."),
-		arg_lit0("aA",  "apdu",     "show APDU reqests and responses."),
-		arg_lit0("tT",  "tlv",      "TLV decode results."),
-		arg_lit0("jJ",  "jload",    "Load transaction parameters from `emv/defparams.json` file."),
-		arg_lit0("fF",  "forceaid", "Force search AID. Search AID instead of execute PPSE."),
-		arg_rem("By default:",      "Transaction type - MSD"),
-		arg_lit0("vV",  "qvsdc",    "Transaction type - qVSDC or M/Chip."),
-		arg_lit0("cC",  "qvsdccda", "Transaction type - qVSDC or M/Chip plus CDA (SDAD generation)."),
-		arg_lit0("xX",  "vsdc",     "Transaction type - VSDC. For test only. Not a standart behavior."),
-		arg_lit0("gG",  "acgpo",    "VISA. generate AC from GPO."),
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("sS",  "select",   "activate field and select card."),
+			arg_lit0("aA",  "apdu",     "show APDU reqests and responses."),
+			arg_lit0("tT",  "tlv",      "TLV decode results."),
+			arg_lit0("jJ",  "jload",    "Load transaction parameters from `emv/defparams.json` file."),
+			arg_lit0("fF",  "forceaid", "Force search AID. Search AID instead of execute PPSE."),
+			arg_rem("By default:",      "Transaction type - MSD"),
+			arg_lit0("vV",  "qvsdc",    "Transaction type - qVSDC or M/Chip."),
+			arg_lit0("cC",  "qvsdccda", "Transaction type - qVSDC or M/Chip plus CDA (SDAD generation)."),
+			arg_lit0("xX",  "vsdc",     "Transaction type - VSDC. For test only. Not a standart behavior."),
+			arg_lit0("gG",  "acgpo",    "VISA. generate AC from GPO."),
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	bool activateField = arg_get_lit(1);
 	bool showAPDU = arg_get_lit(2);
@@ -967,6 +1003,27 @@ int CmdEMVExec(const char *cmd) {
 			break;
 		}
 
+		// build the whole read plan first, it executes as one batch in the field
+		size_t reccount = 0;
+		for (int i = 0; i < AFL->len / 4; i++) {
+			uint8_t SFI = AFL->value[i * 4 + 0] >> 3;
+			uint8_t SFIstart = AFL->value[i * 4 + 1];
+			uint8_t SFIend = AFL->value[i * 4 + 2];
+			if (SFI == 0 || SFI == 31 || SFIstart == 0 || SFIstart > SFIend)
+				continue;
+			reccount += SFIend - SFIstart + 1;
+		}
+
+		emv_record_req_t *recs = calloc(reccount ? reccount : 1, sizeof(emv_record_req_t));
+		bool *offline = calloc(reccount ? reccount : 1, sizeof(bool));
+		if (!recs || !offline) {
+			free(recs);
+			free(offline);
+			PrintAndLogEx(WARNING, "Error: Can't allocate the record read plan");
+			break;
+		}
+
+		size_t r = 0;
 		for (int i = 0; i < AFL->len / 4; i++) {
 			uint8_t SFI = AFL->value[i * 4 + 0] >> 3;
 			uint8_t SFIstart = AFL->value[i * 4 + 1];
@@ -980,42 +1037,52 @@ int CmdEMVExec(const char *cmd) {
 			}
 
 			for(int n = SFIstart; n <= SFIend; n++) {
-				PrintAndLogEx(NORMAL, "* * * SFI[%02x] %d", SFI, n);
+				recs[r].SFI = SFI;
+				recs[r].record = n;
+				offline[r] = (SFIoffline > 0);
+				if (SFIoffline)
+					SFIoffline--;
+				r++;
+			}
+		}
 
-				res = EMVReadRecord(channel, true, SFI, n, buf, sizeof(buf), &len, &sw, tlvRoot);
-				if (res) {
-					PrintAndLogEx(WARNING, "Error SFI[%02x]. APDU error %4x", SFI, sw);
-					continue;
-				}
+		EMVReadRecords(channel, true, recs, r, tlvRoot);
 
-				if (decodeTLV) {
-					TLVPrintFromBuffer(buf, len);
-					PrintAndLogEx(NORMAL, "");
-				}
+		for (size_t ri = 0; ri < r; ri++) {
+			PrintAndLogEx(NORMAL, "* * * SFI[%02x] %d", recs[ri].SFI, recs[ri].record);
 
-				// Build Input list for Offline Data Authentication
-				// EMV 4.3 book3 10.3, page 96
-				if (SFIoffline > 0) {
-					if (SFI < 11) {
-						const unsigned char *abuf = buf;
-						size_t elmlen = len;
-						struct tlv e;
-						if (tlv_parse_tl(&abuf, &elmlen, &e)) {
-							memcpy(&ODAiList[ODAiListLen], &buf[len - elmlen], elmlen);
-							ODAiListLen += elmlen;
-						} else {
-							PrintAndLogEx(WARNING, "Error SFI[%02x]. Creating input list for Offline Data Authentication error.", SFI);
-						}
+			if (recs[ri].res) {
+				PrintAndLogEx(WARNING, "Error SFI[%02x]. APDU error %4x", recs[ri].SFI, recs[ri].sw);
+				continue;
+			}
+
+			if (decodeTLV) {
+				TLVPrintFromBuffer(recs[ri].data, recs[ri].len);
+				PrintAndLogEx(NORMAL, "");
+			}
+
+			// Build Input list for Offline Data Authentication
+			// EMV 4.3 book3 10.3, page 96
+			if (offline[ri]) {
+				if (recs[ri].SFI < 11) {
+					const unsigned char *abuf = recs[ri].data;
+					size_t elmlen = recs[ri].len;
+					struct tlv e;
+					if (tlv_parse_tl(&abuf, &elmlen, &e)) {
+						memcpy(&ODAiList[ODAiListLen], &recs[ri].data[recs[ri].len - elmlen], elmlen);
+						ODAiListLen += elmlen;
 					} else {
-						memcpy(&ODAiList[ODAiListLen], buf, len);
-						ODAiListLen += len;
+						PrintAndLogEx(WARNING, "Error SFI[%02x]. Creating input list for Offline Data Authentication error.", recs[ri].SFI);
 					}
-
-					SFIoffline--;
+				} else {
+					memcpy(&ODAiList[ODAiListLen], recs[ri].data, recs[ri].len);
+					ODAiListLen += recs[ri].len;
 				}
 			}
 		}
 
+		free(recs);
+		free(offline);
 		break;
 	}
 
@@ -1390,25 +1457,29 @@ int CmdEMVScan(const char *cmd) {
 			"Usage:\n\temv scan -at -> scan MSD transaction mode and show APDU and TLV\n"
 			"\temv scan -c -> scan CDA transaction mode\n");
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("aA",  "apdu",     "show APDU reqests and responses."),
-		arg_lit0("tT",  "tlv",      "TLV decode results."),
-		arg_lit0("eE",  "extract",  "Extract TLV elements and fill Application Data"),
-		arg_lit0("jJ",  "jload",    "Load transaction parameters from `emv/defparams.json` file."),
-		arg_rem("By default:",      "Transaction type - MSD"),
-		arg_lit0("vV",  "qvsdc",    "Transaction type - qVSDC or M/Chip."),
-		arg_lit0("cC",  "qvsdccda", "Transaction type - qVSDC or M/Chip plus CDA (SDAD generation)."),
-		arg_lit0("xX",  "vsdc",     "Transaction type - VSDC. For test only. Not a standart behavior."),
-		arg_lit0("gG",  "acgpo",    "VISA. generate AC from GPO."),
-		arg_lit0("mM",  "merge",    "Merge output file with card's data. (warning: the file may be corrupted!)"),
-#ifdef WITH_SMARTCARD
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-#endif
-		arg_str1(NULL,  NULL,       "output.json", "JSON output file name"),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("aA",  "apdu",     "show APDU reqests and responses."),
+			arg_lit0("tT",  "tlv",      "TLV decode results."),
+			arg_lit0("eE",  "extract",  "Extract TLV elements and fill Application Data"),
+			arg_lit0("jJ",  "jload",    "Load transaction parameters from `emv/defparams.json` file."),
+			arg_rem("By default:",      "Transaction type - MSD"),
+			arg_lit0("vV",  "qvsdc",    "Transaction type - qVSDC or M/Chip."),
+			arg_lit0("cC",  "qvsdccda", "Transaction type - qVSDC or M/Chip plus CDA (SDAD generation)."),
+			arg_lit0("xX",  "vsdc",     "Transaction type - VSDC. For test only. Not a standart behavior."),
+			arg_lit0("gG",  "acgpo",    "VISA. generate AC from GPO."),
+			arg_lit0("mM",  "merge",    "Merge output file with card's data. (warning: the file may be corrupted!)"),
+	#ifdef WITH_SMARTCARD
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+	#endif
+			arg_str1(NULL,  NULL,       "output.json", "JSON output file name"),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	bool showAPDU = arg_get_lit(1);
 	bool decodeTLV = arg_get_lit(2);
@@ -1752,14 +1823,18 @@ int CmdEMVRoca(const char *cmd) {
 			"\temv roca -> select --CONTACTLESS-- card and run test\n"
 	);
 
-	void* argtable[] = {
-		arg_param_begin,
-		arg_lit0("tT",  "selftest",   "self test"),
-		arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
-		arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
-		arg_param_end
-	};
-	CLIExecWithReturn(cmd, argtable, true);
+	void **argtable = CLIParserCachedArgtable();
+	if (argtable == NULL) {
+		void *newtable[] = {
+			arg_param_begin,
+			arg_lit0("tT",  "selftest",   "self test"),
+			arg_lit0("aA",  "apdu",    "show APDU reqests and responses"),
+			arg_lit0("wW",  "wired",   "Send data via contact (iso7816) interface. Contactless interface set by default."),
+			arg_param_end
+		};
+		argtable = CLIParserCacheArgtable(newtable, arg_getsize(newtable));
+	}
+	CLIExecCachedWithReturn(cmd, argtable, true);
 
 	if (arg_get_lit(1))
 		return roca_self_test();
@@ -141,6 +141,22 @@ unsigned char *crypto_pk_encrypt(const struct crypto_pk *cp, const unsigned char
 	return cp->encrypt(cp, buf, len, clen);
 }
 
+size_t crypto_pk_encrypt_batch(const struct crypto_pk *cp, struct crypto_pk_batch_op *ops, size_t count)
+{
+	size_t i, ok = 0;
+
+	if (cp->encrypt_batch)
+		return cp->encrypt_batch(cp, ops, count);
+
+	for (i = 0; i < count; i++) {
+		ops[i].result = cp->encrypt(cp, ops[i].buf, ops[i].len, &ops[i].result_len);
+		if (ops[i].result)
+			ok++;
+	}
+
+	return ok;
+}
+
 unsigned char *crypto_pk_decrypt(const struct crypto_pk *cp, const unsigned char *buf, size_t len, size_t *clen)
 {
 	if (!cp->decrypt) {
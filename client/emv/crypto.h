@@ -35,11 +35,21 @@ enum crypto_algo_pk {
 	PK_RSA,
 };
 
+/* one independent public-key operation of a batch (EMV signature recovery);
+ * result is malloc'd on success and left NULL on failure */
+struct crypto_pk_batch_op {
+	const unsigned char *buf;
+	size_t len;
+	unsigned char *result;
+	size_t result_len;
+};
+
 struct crypto_pk *crypto_pk_open(enum crypto_algo_pk pk, ...);
 struct crypto_pk *crypto_pk_open_priv(enum crypto_algo_pk pk, ...);
 struct crypto_pk *crypto_pk_genkey(enum crypto_algo_pk pk, ...);
 void crypto_pk_close(struct crypto_pk *cp);
 unsigned char *crypto_pk_encrypt(const struct crypto_pk *cp, const unsigned char *buf, size_t len, size_t *clen);
+size_t crypto_pk_encrypt_batch(const struct crypto_pk *cp, struct crypto_pk_batch_op *ops, size_t count);
 unsigned char *crypto_pk_decrypt(const struct crypto_pk *cp, const unsigned char *buf, size_t len, size_t *clen);
 enum crypto_algo_pk crypto_pk_get_algo(const struct crypto_pk *cp);
 size_t crypto_pk_get_nbits(const struct crypto_pk *cp);
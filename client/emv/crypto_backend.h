@@ -32,6 +32,7 @@ struct crypto_hash {
 struct crypto_pk {
 	enum crypto_algo_pk algo;
 	unsigned char *(*encrypt)(const struct crypto_pk *cp, const unsigned char *buf, size_t len, size_t *clen);
+	size_t (*encrypt_batch)(const struct crypto_pk *cp, struct crypto_pk_batch_op *ops, size_t count);
 	unsigned char *(*decrypt)(const struct crypto_pk *cp, const unsigned char *buf, size_t len, size_t *clen);
 	unsigned char *(*get_parameter)(const struct crypto_pk *cp, unsigned param, size_t *plen);
 	size_t (*get_nbits)(const struct crypto_pk *cp);
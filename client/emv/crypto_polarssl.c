@@ -21,6 +21,7 @@
 #include "crypto.h"
 #include "crypto_backend.h"
 
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,6 +29,58 @@
 
 #include "mbedtls/rsa.h"
 #include "mbedtls/sha1.h"
+#include "workqueue.h"
+
+/* Cache of the Montgomery setup (R^2 mod N, the RN member) per modulus.
+ * mbedtls computes RN lazily on the first mbedtls_rsa_public() of each
+ * context, and every card certificate opens a fresh context - cards sharing
+ * a CA public key would otherwise redo that setup for every signature. */
+#define RR_CACHE_SIZE 16
+
+struct rr_cache_entry {
+	mbedtls_mpi N;
+	mbedtls_mpi RN;
+};
+
+static struct rr_cache_entry rr_cache[RR_CACHE_SIZE];
+static int rr_cache_count = 0;
+static pthread_mutex_t rr_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void rr_cache_fill(mbedtls_rsa_context *ctx)
+{
+	pthread_mutex_lock(&rr_cache_lock);
+	for (int i = 0; i < rr_cache_count; i++) {
+		if (mbedtls_mpi_cmp_mpi(&rr_cache[i].N, &ctx->N) == 0) {
+			mbedtls_mpi_copy(&ctx->RN, &rr_cache[i].RN);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&rr_cache_lock);
+}
+
+static void rr_cache_store(mbedtls_rsa_context *ctx)
+{
+	if (mbedtls_mpi_cmp_int(&ctx->RN, 0) == 0)
+		return;
+
+	pthread_mutex_lock(&rr_cache_lock);
+	int i;
+	for (i = 0; i < rr_cache_count; i++)
+		if (mbedtls_mpi_cmp_mpi(&rr_cache[i].N, &ctx->N) == 0)
+			break;
+	if (i == rr_cache_count && rr_cache_count < RR_CACHE_SIZE) {
+		mbedtls_mpi_init(&rr_cache[i].N);
+		mbedtls_mpi_init(&rr_cache[i].RN);
+		if (mbedtls_mpi_copy(&rr_cache[i].N, &ctx->N) == 0
+		 && mbedtls_mpi_copy(&rr_cache[i].RN, &ctx->RN) == 0) {
+			rr_cache_count++;
+		} else {
+			mbedtls_mpi_free(&rr_cache[i].N);
+			mbedtls_mpi_free(&rr_cache[i].RN);
+		}
+	}
+	pthread_mutex_unlock(&rr_cache_lock);
+}
 
 struct crypto_hash_polarssl {
 	struct crypto_hash ch;
@@ -110,6 +163,8 @@ static struct crypto_pk *crypto_pk_polarssl_open_rsa(va_list vl)
 		return NULL;
 	}
 
+	rr_cache_fill(&cp->ctx);
+
 	return &cp->cp;
 }
 
@@ -222,12 +277,102 @@ static unsigned char *crypto_pk_polarssl_encrypt(const struct crypto_pk *_cp, co
 		free(result);
 		return NULL;
 	}
-	
+
+	rr_cache_store(&cp->ctx);
+
 	*clen = keylen;
-	
+
 	return result;
 }
 
+/* one worker's share of a batch: every stride'th op starting at ops[0],
+ * processed on a private clone of the rsa context so no state is shared */
+struct polarssl_batch_slice {
+	const mbedtls_rsa_context *src;
+	struct crypto_pk_batch_op *ops;
+	size_t count;
+	size_t stride;
+	size_t done;
+};
+
+static void crypto_pk_polarssl_batch_worker(void *arg)
+{
+	struct polarssl_batch_slice *slice = (struct polarssl_batch_slice *)arg;
+	mbedtls_rsa_context ctx;
+
+	mbedtls_rsa_init(&ctx, MBEDTLS_RSA_PKCS_V15, 0);
+	if (mbedtls_rsa_copy(&ctx, slice->src) != 0) {
+		mbedtls_rsa_free(&ctx);
+		return;
+	}
+
+	for (size_t i = 0; i < slice->count; i += slice->stride) {
+		struct crypto_pk_batch_op *op = &slice->ops[i];
+		unsigned char *out = malloc(ctx.len);
+		if (!out)
+			continue;
+		if (mbedtls_rsa_public(&ctx, op->buf, out) != 0) {
+			free(out);
+			continue;
+		}
+		op->result = out;
+		op->result_len = ctx.len;
+		slice->done++;
+	}
+
+	mbedtls_rsa_free(&ctx);
+}
+
+static size_t crypto_pk_polarssl_encrypt_batch(const struct crypto_pk *_cp, struct crypto_pk_batch_op *ops, size_t count)
+{
+	struct crypto_pk_polarssl *cp = (struct crypto_pk_polarssl *)_cp;
+	size_t ok = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		ops[i].result = NULL;
+		ops[i].result_len = 0;
+	}
+	if (count == 0)
+		return 0;
+
+	// run the first op on this thread: it computes the Montgomery setup for
+	// the modulus (unless already cached), which the workers then clone
+	// instead of each redoing it
+	ops[0].result = crypto_pk_polarssl_encrypt(_cp, ops[0].buf, ops[0].len, &ops[0].result_len);
+	if (ops[0].result)
+		ok++;
+	if (count == 1)
+		return ok;
+
+	size_t nworkers = (size_t)workqueue_num_workers();
+	if (nworkers > count - 1)
+		nworkers = count - 1;
+
+	struct polarssl_batch_slice *slices = calloc(nworkers, sizeof(*slices));
+	if (!slices) {
+		// no memory for the bookkeeping - fall back to one serial slice
+		struct polarssl_batch_slice slice = { &cp->ctx, ops + 1, count - 1, 1, 0 };
+		crypto_pk_polarssl_batch_worker(&slice);
+		return ok + slice.done;
+	}
+
+	for (size_t w = 0; w < nworkers; w++) {
+		slices[w].src = &cp->ctx;
+		slices[w].ops = ops + 1 + w;
+		slices[w].count = count - 1 - w;
+		slices[w].stride = nworkers;
+		if (workqueue_submit(crypto_pk_polarssl_batch_worker, &slices[w]))
+			crypto_pk_polarssl_batch_worker(&slices[w]);
+	}
+	workqueue_join();
+
+	for (size_t w = 0; w < nworkers; w++)
+		ok += slices[w].done;
+	free(slices);
+
+	return ok;
+}
+
 static unsigned char *crypto_pk_polarssl_decrypt(const struct crypto_pk *_cp, const unsigned char *buf, size_t len, size_t *clen)
 {
 	struct crypto_pk_polarssl *cp = (struct crypto_pk_polarssl *)_cp;
@@ -301,6 +446,7 @@ static struct crypto_pk *crypto_pk_polarssl_open(enum crypto_algo_pk pk, va_list
 
 	cp->close = crypto_pk_polarssl_close;
 	cp->encrypt = crypto_pk_polarssl_encrypt;
+	cp->encrypt_batch = crypto_pk_polarssl_encrypt_batch;
 	cp->get_parameter = crypto_pk_polarssl_get_parameter;
 	cp->get_nbits = crypto_pk_polarssl_get_nbits;
 
@@ -26,9 +26,11 @@
 #include "proxmark3.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 
 #define BCD(c) (((c) >= '0' && (c) <= '9') ? ((c) - '0') : \
 		-1)
@@ -424,6 +426,224 @@ static struct emv_pk *emv_pk_get_ca_pk_from_file(const char *fname,
 	return NULL;
 }
 
+/*
+ * Binary CAPK index. emv_pk_get_ca_pk() used to line-scan capk.txt with
+ * emv_pk_parse_pk on every certificate verification, and batch jobs pay that
+ * per card. The text file stays the source: it is compiled once into capk.bin
+ * (header + fixed-size entry table + modulus blob), rebuilt whenever the text
+ * file is newer, and loaded back with two reads. Lookups then search the
+ * in-memory entry table.
+ */
+
+#define CAPK_BIN_MAGIC   0x4b504143	/* "CAPK" */
+#define CAPK_BIN_VERSION 1
+
+struct capk_bin_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t modulus_bytes;
+	int64_t source_mtime;
+};
+
+struct capk_bin_entry {
+	unsigned char rid[5];
+	unsigned char index;
+	unsigned char hash_algo;
+	unsigned char pk_algo;
+	unsigned char hash[20];
+	unsigned char exp[3];
+	unsigned char elen;
+	uint32_t mlen;
+	uint32_t expire;
+	uint32_t mod_offset;
+};
+
+static struct capk_bin_entry *capk_entries = NULL;
+static unsigned char *capk_moduli = NULL;
+static uint32_t capk_count = 0;
+static bool capk_index_tried = false;
+
+static bool capk_index_load(const char *binname, int64_t source_mtime)
+{
+	FILE *f = fopen(binname, "rb");
+	if (!f)
+		return false;
+
+	struct capk_bin_header hdr;
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1
+			|| hdr.magic != CAPK_BIN_MAGIC
+			|| hdr.version != CAPK_BIN_VERSION
+			|| hdr.source_mtime != source_mtime
+			|| hdr.count == 0 || hdr.count > 10000
+			|| hdr.modulus_bytes > hdr.count * 2048/8) {
+		fclose(f);
+		return false;
+	}
+
+	struct capk_bin_entry *entries = calloc(hdr.count, sizeof(*entries));
+	unsigned char *moduli = malloc(hdr.modulus_bytes);
+	if (!entries || !moduli
+			|| fread(entries, sizeof(*entries), hdr.count, f) != hdr.count
+			|| fread(moduli, 1, hdr.modulus_bytes, f) != hdr.modulus_bytes) {
+		free(entries);
+		free(moduli);
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+
+	for (uint32_t i = 0; i < hdr.count; i++) {
+		if (entries[i].mod_offset + entries[i].mlen > hdr.modulus_bytes) {
+			free(entries);
+			free(moduli);
+			return false;
+		}
+	}
+
+	capk_entries = entries;
+	capk_moduli = moduli;
+	capk_count = hdr.count;
+	return true;
+}
+
+static bool capk_index_compile(const char *txtname, const char *binname, int64_t source_mtime)
+{
+	FILE *f = fopen(txtname, "r");
+	if (!f)
+		return false;
+
+	struct capk_bin_entry *entries = NULL;
+	unsigned char *moduli = NULL;
+	uint32_t count = 0;
+	uint32_t mod_bytes = 0;
+
+	while (!feof(f)) {
+		char buf[2048];
+		if (fgets(buf, sizeof(buf), f) == NULL)
+			break;
+
+		struct emv_pk *pk = emv_pk_parse_pk(buf);
+		if (!pk)
+			continue;
+
+		struct capk_bin_entry *nentries = realloc(entries, (count + 1) * sizeof(*entries));
+		unsigned char *nmoduli = realloc(moduli, mod_bytes + pk->mlen);
+		if (!nentries || !nmoduli) {
+			free(nentries ? nentries : entries);
+			free(nmoduli ? nmoduli : moduli);
+			emv_pk_free(pk);
+			fclose(f);
+			return false;
+		}
+		entries = nentries;
+		moduli = nmoduli;
+
+		struct capk_bin_entry *e = &entries[count];
+		memset(e, 0, sizeof(*e));
+		memcpy(e->rid, pk->rid, 5);
+		e->index = pk->index;
+		e->hash_algo = pk->hash_algo;
+		e->pk_algo = pk->pk_algo;
+		memcpy(e->hash, pk->hash, 20);
+		memcpy(e->exp, pk->exp, 3);
+		e->elen = pk->elen;
+		e->mlen = pk->mlen;
+		e->expire = pk->expire;
+		e->mod_offset = mod_bytes;
+		memcpy(moduli + mod_bytes, pk->modulus, pk->mlen);
+		mod_bytes += pk->mlen;
+		count++;
+
+		emv_pk_free(pk);
+	}
+	fclose(f);
+
+	if (count == 0) {
+		free(entries);
+		free(moduli);
+		return false;
+	}
+
+	/* best effort: the index also works without the cache file */
+	FILE *out = fopen(binname, "wb");
+	if (out) {
+		struct capk_bin_header hdr = {
+			.magic = CAPK_BIN_MAGIC,
+			.version = CAPK_BIN_VERSION,
+			.count = count,
+			.modulus_bytes = mod_bytes,
+			.source_mtime = source_mtime,
+		};
+		if (fwrite(&hdr, sizeof(hdr), 1, out) != 1
+				|| fwrite(entries, sizeof(*entries), count, out) != count
+				|| fwrite(moduli, 1, mod_bytes, out) != mod_bytes) {
+			fclose(out);
+			remove(binname);
+		} else {
+			fclose(out);
+		}
+	}
+
+	capk_entries = entries;
+	capk_moduli = moduli;
+	capk_count = count;
+	return true;
+}
+
+static void capk_index_init(void)
+{
+	capk_index_tried = true;
+
+	const char *reltxt = "emv/capk.txt";
+	const char *relbin = "emv/capk.bin";
+	const char *dir = get_my_executable_directory();
+
+	char txtname[strlen(dir) + strlen(reltxt) + 1];
+	strcpy(txtname, dir);
+	strcat(txtname, reltxt);
+	char binname[strlen(dir) + strlen(relbin) + 1];
+	strcpy(binname, dir);
+	strcat(binname, relbin);
+
+	struct stat st;
+	if (stat(txtname, &st))
+		return;
+	int64_t source_mtime = (int64_t)st.st_mtime;
+
+	if (capk_index_load(binname, source_mtime))
+		return;
+
+	capk_index_compile(txtname, binname, source_mtime);
+}
+
+static struct emv_pk *capk_index_get(const unsigned char *rid, unsigned char idx)
+{
+	if (!capk_index_tried)
+		capk_index_init();
+
+	for (uint32_t i = 0; i < capk_count; i++) {
+		const struct capk_bin_entry *e = &capk_entries[i];
+		if (memcmp(e->rid, rid, 5) || e->index != idx)
+			continue;
+
+		struct emv_pk *pk = emv_pk_new(e->mlen, e->elen);
+		if (!pk)
+			return NULL;
+		memcpy(pk->rid, e->rid, 5);
+		pk->index = e->index;
+		pk->hash_algo = e->hash_algo;
+		pk->pk_algo = e->pk_algo;
+		memcpy(pk->hash, e->hash, 20);
+		memcpy(pk->exp, e->exp, 3);
+		pk->expire = e->expire;
+		memcpy(pk->modulus, capk_moduli + e->mod_offset, e->mlen);
+		return pk;
+	}
+
+	return NULL;
+}
+
 char *emv_pk_get_ca_pk_file(const char *dirname, const unsigned char *rid, unsigned char idx)
 {
 	if (!dirname)
@@ -491,8 +711,12 @@ struct emv_pk *emv_pk_get_ca_pk(const unsigned char *rid, unsigned char idx)
 		}
 	}
 */
-	if (!pk) {
-		const char *relfname = "emv/capk.txt"; 
+	if (!pk)
+		pk = capk_index_get(rid, idx);
+
+	// fall back to the text scan if the index could not be built
+	if (!pk && capk_count == 0) {
+		const char *relfname = "emv/capk.txt";
 
 		char fname[strlen(get_my_executable_directory()) + strlen(relfname) + 1];
 		strcpy(fname, get_my_executable_directory());
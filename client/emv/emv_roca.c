@@ -26,6 +26,8 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
 
 #include "ui.h"
 #include "util.h"
@@ -37,9 +39,16 @@ static uint8_t g_primes[ROCA_PRINTS_LENGTH] = {
 };
 
 mbedtls_mpi g_prints[ROCA_PRINTS_LENGTH];
+static bool g_prints_initialized = false;
 
 void rocacheck_init(void) {
-	
+
+	// parse the residue tables once, they are read only afterwards and
+	// shared by all checks (and all batch worker threads)
+	if (g_prints_initialized)
+		return;
+	g_prints_initialized = true;
+
 	for (int i = 0; i < ROCA_PRINTS_LENGTH; i++)
 		mbedtls_mpi_init(&g_prints[i]);
 	
@@ -65,6 +74,7 @@ void rocacheck_init(void) {
 void rocacheck_cleanup(void) {
 	for (int i = 0; i < ROCA_PRINTS_LENGTH; i++)
 		mbedtls_mpi_free(&g_prints[i]);
+	g_prints_initialized = false;
 }
 
 int bitand_is_zero(	mbedtls_mpi* a, mbedtls_mpi* b ) {
@@ -96,6 +106,24 @@ void print_mpi(const char *msg, int radix, const mbedtls_mpi *X) {
 	printf("%s[%zd] %s\n", msg, len, Xchar);	
 }
 
+// the fingerprint itself: the modulus reduced by every marker prime must
+// hit a set bit of the matching residue print. Reads g_prints only, so it
+// is safe to run from several threads at once.
+static bool rocacheck_mpi(const mbedtls_mpi *modulus) {
+
+	for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
+
+		mbedtls_mpi_uint residue = 0;
+
+		if (mbedtls_mpi_mod_int(&residue, modulus, g_primes[i]) != 0)
+			return false;
+
+		if (mbedtls_mpi_get_bit(&g_prints[i], residue) != 1)
+			return false;
+	}
+	return true;
+}
+
 bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose) {
 
 	mbedtls_mpi t_modulus;
@@ -106,47 +134,80 @@ bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose) {
 	rocacheck_init();
 
 	MBEDTLS_MPI_CHK( mbedtls_mpi_read_binary(&t_modulus, buf, buflen) );
-	
-	for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
 
-		mbedtls_mpi t_temp;
-		mbedtls_mpi t_prime;
-		mbedtls_mpi g_one;
-		
-		mbedtls_mpi_init(&t_temp);
-		mbedtls_mpi_init(&t_prime);
-		mbedtls_mpi_init(&g_one);
-
-		MBEDTLS_MPI_CHK( mbedtls_mpi_read_string(&g_one, 10, "1") );
-
-		MBEDTLS_MPI_CHK( mbedtls_mpi_add_int(&t_prime, &t_prime, g_primes[i]) );
-		
-		MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi(&t_temp, &t_modulus, &t_prime) ); 
-		
-		MBEDTLS_MPI_CHK( mbedtls_mpi_shift_l(&g_one, mpi_get_uint(&t_temp)) );
-		
-		if (bitand_is_zero(&g_one, &g_prints[i])) {
-			if (verbose)
-				PrintAndLogEx(FAILED, "No fingerprint found.\n");
-			goto cleanup;
-		}
-		
-		mbedtls_mpi_free(&g_one);		
-		mbedtls_mpi_free(&t_temp);
-		mbedtls_mpi_free(&t_prime);
-	}
+	ret = rocacheck_mpi(&t_modulus);
 
-	ret = true;
-	if (verbose)
-		PrintAndLogEx(SUCCESS, "Fingerprint found!\n");
+	if (verbose) {
+		if (ret)
+			PrintAndLogEx(SUCCESS, "Fingerprint found!\n");
+		else
+			PrintAndLogEx(FAILED, "No fingerprint found.\n");
+	}
 
 cleanup:
 	mbedtls_mpi_free(&t_modulus);
-
-	rocacheck_cleanup();
 	return ret;
 }
 
+typedef struct {
+	roca_batch_item_t *items;
+	size_t count;
+} RocaBatch_t;
+
+static size_t roca_batch_cursor;
+
+static void *roca_batch_worker(void *arg) {
+
+	RocaBatch_t *batch = (RocaBatch_t *)arg;
+
+	while (true) {
+		size_t i = __sync_fetch_and_add(&roca_batch_cursor, 1);
+		if (i >= batch->count)
+			break;
+
+		mbedtls_mpi t_modulus;
+		mbedtls_mpi_init(&t_modulus);
+
+		batch->items[i].vulnerable =
+			mbedtls_mpi_read_binary(&t_modulus, batch->items[i].modulus, batch->items[i].len) == 0
+			&& rocacheck_mpi(&t_modulus);
+
+		mbedtls_mpi_free(&t_modulus);
+	}
+	return NULL;
+}
+
+void emv_rocacheck_batch(roca_batch_item_t *items, size_t count) {
+
+	RocaBatch_t batch = { items, count };
+
+	rocacheck_init();
+
+	int threads = num_CPUs();
+	if ((size_t)threads > count)
+		threads = count;
+	if (threads <= 1) {
+		roca_batch_cursor = 0;
+		roca_batch_worker(&batch);
+		return;
+	}
+
+	pthread_t *thread_ids = malloc(threads * sizeof(pthread_t));
+	if (thread_ids == NULL) {
+		roca_batch_cursor = 0;
+		roca_batch_worker(&batch);
+		return;
+	}
+
+	roca_batch_cursor = 0;
+	for (int i = 0; i < threads; i++)
+		pthread_create(&thread_ids[i], NULL, roca_batch_worker, &batch);
+	for (int i = 0; i < threads; i++)
+		pthread_join(thread_ids[i], NULL);
+
+	free(thread_ids);
+}
+
 int roca_self_test( void ) {
 	int ret = 0;
 
@@ -25,11 +25,21 @@
 #define EMV_ROCA_H__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #define ROCA_PRINTS_LENGTH	17
 
+// one modulus of a screening batch. vulnerable is filled in by the check
+typedef struct {
+	const uint8_t *modulus;
+	size_t len;
+	bool vulnerable;
+} roca_batch_item_t;
+
 extern bool emv_rocacheck( const unsigned char *buf, size_t buflen, bool verbose );
+// fingerprint a whole batch of moduli, one worker thread per CPU
+extern void emv_rocacheck_batch( roca_batch_item_t *items, size_t count );
 extern int roca_self_test( void );
 
 #endif
@@ -677,6 +677,76 @@ int EMVReadRecord(EMVCommandChannel channel, bool LeaveFieldON, uint8_t SFI, uin
 	return res;
 }
 
+// Read a whole plan of records in one go. Over the contactless channel the
+// APDUs travel to the firmware as one batch and are exchanged back to back
+// in the field - the per-record USB round trip is what dominates the
+// transaction time. The contact channel, and whatever the batch could not
+// answer, falls back to one EMVReadRecord() per record. Responses with
+// sw 0x9000 are parsed into tlv as usual.
+int EMVReadRecords(EMVCommandChannel channel, bool LeaveFieldON, emv_record_req_t *recs, size_t count, struct tlvdb *tlv)
+{
+	size_t i = 0;
+
+	if (channel == ECC_CONTACTLESS && count > 1) {
+		uint8_t (*apdus)[5] = calloc(count, 5);
+		apdu_batch_t *items = calloc(count, sizeof(apdu_batch_t));
+
+		if (apdus && items) {
+			for (i = 0; i < count; i++) {
+				apdus[i][0] = 0x00;
+				apdus[i][1] = ISO7816_READ_RECORDS;
+				apdus[i][2] = recs[i].record;
+				apdus[i][3] = (recs[i].SFI << 3) | 0x04;
+				apdus[i][4] = 0x00;
+				items[i].apdu = apdus[i];
+				items[i].apdu_len = 5;
+				items[i].response = recs[i].data;
+				items[i].max_response_len = sizeof(recs[i].data);
+
+				if (APDULogging)
+					PrintAndLogEx(SUCCESS, ">>>> %s", sprint_hex(apdus[i], 5));
+			}
+
+			// a partial result is fine, the tail is re-read below
+			ExchangeAPDUBatch14a(items, count);
+
+			for (i = 0; i < count; i++) {
+				if (!items[i].ok || items[i].response_len < 2)
+					break;
+
+				if (APDULogging)
+					PrintAndLogEx(SUCCESS, "<<<< %s", sprint_hex(recs[i].data, items[i].response_len));
+
+				recs[i].len = items[i].response_len - 2;
+				recs[i].sw = recs[i].data[recs[i].len] * 0x0100 + recs[i].data[recs[i].len + 1];
+				recs[i].res = 0;
+				if (recs[i].sw != 0x9000 && APDULogging) {
+					PrintAndLogEx(ERR, "APDU(00b2) ERROR: [%4X] %s", recs[i].sw, GetAPDUCodeDescription(recs[i].sw >> 8, recs[i].sw & 0xff));
+					recs[i].res = 5;
+				}
+				if (recs[i].res == 0 && tlv) {
+					struct tlvdb *t = tlvdb_parse_multi(recs[i].data, recs[i].len);
+					tlvdb_add(tlv, t);
+				}
+			}
+		}
+
+		free(apdus);
+		free(items);
+	}
+
+	// the rest (or everything, over the contact channel) one record at a time
+	for (; i < count; i++) {
+		recs[i].len = 0;
+		recs[i].res = EMVReadRecord(channel, true, recs[i].SFI, recs[i].record, recs[i].data, sizeof(recs[i].data), &recs[i].len, &recs[i].sw, tlv);
+	}
+
+	if (!LeaveFieldON)
+		DropFieldEx(channel);
+
+	return 0;
+}
+
 int EMVAC(EMVCommandChannel channel, bool LeaveFieldON, uint8_t RefControl, uint8_t *CDOL, size_t CDOLLen, uint8_t *Result, size_t MaxResultLen, size_t *ResultLen, uint16_t *sw, struct tlvdb *tlv)
 {
 	uint8_t CDOL_APDU[APDU_COMMAND_LEN] = {0x80, 0xae, RefControl, 0x00, CDOLLen, 0x00};
@@ -192,6 +192,59 @@ static unsigned char pk_I[] = {
 	0xd4, 0x42, 0xc9, 0x17, 0xb2, 0x2c, 0x92, 0x12, 0x37, 0x1b, 0xd3, 0xc5, 0x79, 0xd2, 0x65, 0x61,
 };
 
+static int test_pk_batch(bool verbose)
+{
+	int ret = 1;
+	size_t i, ok, ref_len;
+	unsigned char *ref;
+	struct crypto_pk *pubk;
+	struct crypto_pk_batch_op ops[17];
+	size_t count = sizeof(ops) / sizeof(ops[0]);
+
+	printf("Testing public key batch interface\n");
+
+	pubk = crypto_pk_open(PK_RSA,
+			pk_N, sizeof(pk_N),
+			pk_E, sizeof(pk_E));
+	if (!pubk) {
+		fprintf(stderr, "ERROR: open public key.\n");
+		return 1;
+	}
+
+	ref = crypto_pk_encrypt(pubk, message, sizeof(pk_N), &ref_len);
+	if (!ref) {
+		fprintf(stderr, "ERROR: crypto_pk_encrypt.\n");
+		goto close_pub;
+	}
+
+	for (i = 0; i < count; i++) {
+		ops[i].buf = message;
+		ops[i].len = sizeof(pk_N);
+	}
+
+	ok = crypto_pk_encrypt_batch(pubk, ops, count);
+	if (ok != count) {
+		fprintf(stderr, "ERROR: crypto_pk_encrypt_batch %zd of %zd ops failed.\n", count - ok, count);
+		goto free_ref;
+	}
+
+	ret = 0;
+	for (i = 0; i < count; i++) {
+		if (!ops[i].result || ops[i].result_len != ref_len || memcmp(ops[i].result, ref, ref_len)) {
+			fprintf(stderr, "ERROR: crypto_pk_encrypt_batch op %zd result mismatch.\n", i);
+			ret = 1;
+		}
+		free(ops[i].result);
+	}
+
+free_ref:
+	free(ref);
+close_pub:
+	crypto_pk_close(pubk);
+
+	return ret;
+}
+
 static int test_pk(bool verbose)
 {
 	int ret = 1;
@@ -314,6 +367,13 @@ int exec_crypto_test(bool verbose)
 	}
 	fprintf(stdout, "Crypto raw test: passed\n\n");
 
+	ret = test_pk_batch(verbose);
+	if (ret) {
+		fprintf(stderr, "Crypto batch test: failed\n");
+		return ret;
+	}
+	fprintf(stdout, "Crypto batch test: passed\n\n");
+
 	for (i = 0; i < sizeof(keylengths) / sizeof(keylengths[0]); i++) {
 		unsigned int kl = keylengths[i];
 		ret = test_genkey(kl, message, kl / 8, verbose);
@@ -46,14 +46,51 @@ struct tlvdb {
 	struct tlvdb *next;
 	struct tlvdb *parent;
 	struct tlvdb *children;
+	bool arena;		// node lives in the root's arena and is freed with the root
 };
 
 struct tlvdb_root {
 	struct tlvdb db;
+	// parse arena: every node of a parsed tree comes from this block (laid
+	// out behind buf), so the whole tree is one malloc and one free
+	struct tlvdb *nodes;
+	size_t nodes_used;
+	size_t nodes_cap;
 	size_t len;
 	unsigned char buf[0];
 };
 
+// A parsed node consumes at least two input bytes (tag + length), so len/2
+// nodes always suffice. The node arena sits behind the data copy, aligned.
+static struct tlvdb_root *tlvdb_root_alloc(const unsigned char *buf, size_t len)
+{
+	size_t nodes_off = (sizeof(struct tlvdb_root) + len + 15) & ~(size_t)15;
+	size_t nodes_cap = len / 2;
+
+	struct tlvdb_root *root = malloc(nodes_off + nodes_cap * sizeof(struct tlvdb));
+	if (!root)
+		return NULL;
+
+	root->len = len;
+	memcpy(root->buf, buf, len);
+	root->nodes = (struct tlvdb *)((unsigned char *)root + nodes_off);
+	root->nodes_used = 0;
+	root->nodes_cap = nodes_cap;
+	root->db.arena = false;
+
+	return root;
+}
+
+static struct tlvdb *tlvdb_arena_alloc(struct tlvdb_root *root)
+{
+	if (root->nodes_used >= root->nodes_cap)	// cannot happen for well-formed input
+		return NULL;
+
+	struct tlvdb *node = &root->nodes[root->nodes_used++];
+	node->arena = true;
+	return node;
+}
+
 static tlv_tag_t tlv_parse_tag(const unsigned char **buf, size_t *len)
 {
 	tlv_tag_t tag;
@@ -120,9 +157,10 @@ bool tlv_parse_tl(const unsigned char **buf, size_t *len, struct tlv *tlv)
 	return true;
 }
 
-static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent);
+static struct tlvdb *tlvdb_parse_children(struct tlvdb_root *root, struct tlvdb *parent);
 
-static bool tlvdb_parse_one(struct tlvdb *tlvdb,
+static bool tlvdb_parse_one(struct tlvdb_root *root,
+		struct tlvdb *tlvdb,
 		struct tlvdb *parent,
 		const unsigned char **tmp,
 		size_t *left)
@@ -147,7 +185,7 @@ static bool tlvdb_parse_one(struct tlvdb *tlvdb,
 	*left -= tlvdb->tag.len;
 
 	if (tlv_is_constructed(&tlvdb->tag) && (tlvdb->tag.len != 0)) {
-		tlvdb->children = tlvdb_parse_children(tlvdb);
+		tlvdb->children = tlvdb_parse_children(root, tlvdb);
 		if (!tlvdb->children)
 			goto err;
 	} else {
@@ -160,21 +198,23 @@ err:
 	return false;
 }
 
-static struct tlvdb *tlvdb_parse_children(struct tlvdb *parent)
+static struct tlvdb *tlvdb_parse_children(struct tlvdb_root *root, struct tlvdb *parent)
 {
 	const unsigned char *tmp = parent->tag.value;
 	size_t left = parent->tag.len;
 	struct tlvdb *tlvdb, *first = NULL, *prev = NULL;
 
 	while (left != 0) {
-		tlvdb = malloc(sizeof(*tlvdb));
+		tlvdb = tlvdb_arena_alloc(root);
+		if (!tlvdb)
+			goto err;
 		if (prev)
 			prev->next = tlvdb;
 		else
 			first = tlvdb;
 		prev = tlvdb;
 
-		if (!tlvdb_parse_one(tlvdb, parent, &tmp, &left))
+		if (!tlvdb_parse_one(root, tlvdb, parent, &tmp, &left))
 			goto err;
 
 		tlvdb->parent = parent;
@@ -197,14 +237,14 @@ struct tlvdb *tlvdb_parse(const unsigned char *buf, size_t len)
 	if (!len || !buf)
 		return NULL;
 
-	root = malloc(sizeof(*root) + len);
-	root->len = len;
-	memcpy(root->buf, buf, len);
+	root = tlvdb_root_alloc(buf, len);
+	if (!root)
+		return NULL;
 
 	tmp = root->buf;
 	left = len;
 
-	if (!tlvdb_parse_one(&root->db, NULL, &tmp, &left))
+	if (!tlvdb_parse_one(root, &root->db, NULL, &tmp, &left))
 		goto err;
 
 	if (left)
@@ -227,22 +267,20 @@ struct tlvdb *tlvdb_parse_multi(const unsigned char *buf, size_t len)
 	if (!len || !buf)
 		return NULL;
 
-	root = malloc(sizeof(*root) + len);
-	root->len = len;
-	memcpy(root->buf, buf, len);
+	root = tlvdb_root_alloc(buf, len);
+	if (!root)
+		return NULL;
 
 	tmp = root->buf;
 	left = len;
 
-	if (!tlvdb_parse_one(&root->db, NULL, &tmp, &left))
+	if (!tlvdb_parse_one(root, &root->db, NULL, &tmp, &left))
 		goto err;
 
 	while (left != 0) {
-		struct tlvdb *db = malloc(sizeof(*db));
-		if (!tlvdb_parse_one(db, NULL, &tmp, &left)) {
-			free (db);
+		struct tlvdb *db = tlvdb_arena_alloc(root);
+		if (!db || !tlvdb_parse_one(root, db, NULL, &tmp, &left))
 			goto err;
-		}
 
 		tlvdb_add(&root->db, db);
 	}
@@ -263,6 +301,7 @@ struct tlvdb *tlvdb_fixed(tlv_tag_t tag, size_t len, const unsigned char *value)
 	memcpy(root->buf, value, len);
 
 	root->db.parent = root->db.next = root->db.children = NULL;
+	root->db.arena = false;
 	root->db.tag.tag = tag;
 	root->db.tag.len = len;
 	root->db.tag.value = root->buf;
@@ -277,6 +316,7 @@ struct tlvdb *tlvdb_external(tlv_tag_t tag, size_t len, const unsigned char *val
 	root->len = 0;
 
 	root->db.parent = root->db.next = root->db.children = NULL;
+	root->db.arena = false;
 	root->db.tag.tag = tag;
 	root->db.tag.len = len;
 	root->db.tag.value = value;
@@ -287,14 +327,25 @@ struct tlvdb *tlvdb_external(tlv_tag_t tag, size_t len, const unsigned char *val
 void tlvdb_free(struct tlvdb *tlvdb)
 {
 	struct tlvdb *next = NULL;
+	struct tlvdb *rev = NULL;
 
 	if (!tlvdb)
 		return;
 
+	// arena nodes are part of their root's block and get reclaimed when
+	// that root is freed. A parse root can precede its own arena nodes in
+	// a chain, so reverse the chain first and free back to front.
 	for (; tlvdb; tlvdb = next) {
 		next = tlvdb->next;
 		tlvdb_free(tlvdb->children);
-		free(tlvdb);
+		tlvdb->next = rev;
+		rev = tlvdb;
+	}
+
+	for (; rev; rev = next) {
+		next = rev->next;
+		if (!rev->arena)
+			free(rev);
 	}
 }
 
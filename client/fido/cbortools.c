@@ -356,6 +356,80 @@ int CborMapGetKeyById(CborParser *parser, CborValue *map, uint8_t *data, size_t
 	return 2;
 }
 
+// Single pass lookup of several integer keys in a top level map. values[i]
+// receives the position of the value belonging to keys[i], found[i] tells
+// whether the key was present. One walk over the response replaces one full
+// reparse per key through CborMapGetKeyById.
+int CborMapGetKeySet(CborParser *parser, uint8_t *data, size_t dataLen, const int *keys, size_t keyCount, CborValue *values, bool *found) {
+	CborValue cb, map;
+
+	for (size_t i = 0; i < keyCount; i++)
+		found[i] = false;
+
+	CborError err = cbor_parser_init(data, dataLen, 0, parser, &cb);
+	cbor_check(err);
+
+	if (cbor_value_get_type(&cb) != CborMapType)
+		return 1;
+
+	err = cbor_value_enter_container(&cb, &map);
+	cbor_check(err);
+
+	int64_t indx;
+	while (!cbor_value_at_end(&map)) {
+		if (cbor_value_get_type(&map) != CborIntegerType)
+			return 1;
+
+		cbor_value_get_int64(&map, &indx);
+
+		err = cbor_value_advance(&map);
+		cbor_check(err);
+
+		for (size_t i = 0; i < keyCount; i++) {
+			if (keys[i] == indx && !found[i]) {
+				values[i] = map;
+				found[i] = true;
+				break;
+			}
+		}
+
+		// pass value
+		err = cbor_value_advance(&map);
+		cbor_check(err);
+	}
+
+	return 0;
+}
+
+// Fixed scratch arena for byte strings pulled out of one CTAP2 response.
+// Authenticator responses are bounded well below the arena size, and parsing
+// thousands of assertions per session makes per-field malloc/free (via
+// cbor_value_dup_byte_string) pure overhead. Reset once per response.
+#define CBOR_SCRATCH_SIZE 4096
+static uint8_t cbor_scratch[CBOR_SCRATCH_SIZE];
+static size_t cbor_scratch_used = 0;
+
+void CborScratchReset(void) {
+	cbor_scratch_used = 0;
+}
+
+// Copy the byte string at elm into the arena and advance, like
+// cbor_value_dup_byte_string without the malloc. Returns NULL when the
+// arena is exhausted (fall back to the dup variant then).
+uint8_t *CborScratchGetByteString(CborValue *elm, size_t *datalen) {
+	size_t slen = CBOR_SCRATCH_SIZE - cbor_scratch_used;
+	uint8_t *buf = &cbor_scratch[cbor_scratch_used];
+
+	if (cbor_value_copy_byte_string(elm, buf, &slen, elm) != CborNoError)
+		return NULL;
+
+	cbor_scratch_used += slen;
+	if (datalen)
+		*datalen = slen;
+
+	return buf;
+}
+
 CborError CborGetArrayBinStringValue(CborValue *elm, uint8_t *data, size_t maxdatalen, size_t *datalen) {
 	return CborGetArrayBinStringValueEx(elm, data, maxdatalen, datalen, NULL, 0);
 }
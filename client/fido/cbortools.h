@@ -25,6 +25,9 @@ extern int TinyCborPrintFIDOPackage(uint8_t cmdCode, bool isResponse, uint8_t *d
 extern int JsonToCbor(json_t *elm, CborEncoder *encoder);
 
 extern int CborMapGetKeyById(CborParser *parser, CborValue *map, uint8_t *data, size_t dataLen, int key);
+extern int CborMapGetKeySet(CborParser *parser, uint8_t *data, size_t dataLen, const int *keys, size_t keyCount, CborValue *values, bool *found);
+extern void CborScratchReset(void);
+extern uint8_t *CborScratchGetByteString(CborValue *elm, size_t *datalen);
 extern CborError CborGetArrayBinStringValue(CborValue *elm, uint8_t *data, size_t maxdatalen, size_t *datalen);
 extern CborError CborGetArrayBinStringValueEx(CborValue *elm, uint8_t *data, size_t maxdatalen, size_t *datalen, uint8_t *delimeter, size_t delimeterlen);
 extern CborError CborGetBinStringValue(CborValue *elm, uint8_t *data, size_t maxdatalen, size_t *datalen);
@@ -396,7 +396,8 @@ int FIDO2CheckSignature(json_t *root, uint8_t *publickey, uint8_t *sign, size_t
 			clientDataHash, 32,     // Hash of the serialized client data. "$.ClientDataHash" from json
 			NULL, 0);
 		//PrintAndLog("--xbuf(%d)[%d]: %s", res, xbuflen, sprint_hex(xbuf, xbuflen));
-		res = ecdsa_signature_verify(MBEDTLS_ECP_DP_SECP256R1, publickey, xbuf, xbuflen, sign, signLen, true);
+		// cached context: the key rarely changes between assertions
+		res = ecdsa_signature_verify_cached(MBEDTLS_ECP_DP_SECP256R1, publickey, xbuf, xbuflen, sign, signLen, true);
 		if (res) {
 			if (res == MBEDTLS_ERR_ECP_VERIFY_FAILED) {
 				PrintAndLog("Signature is NOT VALID.");
@@ -657,17 +658,27 @@ int FIDO2CreateGetAssertionReq(json_t *root, uint8_t *data, size_t maxdatalen, s
 
 int FIDO2GetAssertionParseRes(json_t *root, uint8_t *data, size_t dataLen, bool verbose, bool verbose2, bool showCBOR) {
 	CborParser parser;
-	CborValue map, mapint;
+	CborValue mapint;
 	int res;
 	uint8_t *ubuf;
 	size_t n;
-	
-	// credential
-	res = CborMapGetKeyById(&parser, &map, data, dataLen, 1);
+
+	// one walk over the response gathers all five CTAP2 keys instead of a
+	// full reparse per key; one scratch arena replaces the per-field mallocs
+	// of cbor_value_dup_byte_string.
+	static const int keys[] = {1, 2, 3, 4, 5};
+	CborValue vals[5];
+	bool found[5];
+	res = CborMapGetKeySet(&parser, data, dataLen, keys, 5, vals, found);
 	if (res)
 		return res;
+	CborScratchReset();
 
-	res = cbor_value_enter_container(&map, &mapint);
+	// credential
+	if (!found[0])
+		return 2;
+
+	res = cbor_value_enter_container(&vals[0], &mapint);
 	cbor_check(res);
 	
 	while (!cbor_value_at_end(&mapint)) {
@@ -689,20 +700,20 @@ int FIDO2GetAssertionParseRes(json_t *root, uint8_t *data, size_t dataLen, bool
 			PrintAndLog("credential id [%d]: %s", n, sprint_hex(cid, n));
 		}
 	}
-	res = cbor_value_leave_container(&map, &mapint);
+	res = cbor_value_leave_container(&vals[0], &mapint);
 	cbor_check(res);
-	
+
 	// authData
-	uint8_t authData[400] = {0}; 
+	uint8_t authData[400] = {0};
 	size_t authDataLen = 0;
-	res = CborMapGetKeyById(&parser, &map, data, dataLen, 2);
-	if (res)
-		return res;
-	res = cbor_value_dup_byte_string(&map, &ubuf, &n, &map);
-	cbor_check(res);
-	
+	if (!found[1])
+		return 2;
+	ubuf = CborScratchGetByteString(&vals[1], &n);
+	if (ubuf == NULL)
+		return 2;
+
 	authDataLen = n;
-	memcpy(authData, ubuf, authDataLen); 
+	memcpy(authData, ubuf, authDataLen);
 	
 	if (verbose2) {
 		PrintAndLog("authData[%d]: %s", n, sprint_hex_inrow(authData, authDataLen));
@@ -734,15 +745,12 @@ int FIDO2GetAssertionParseRes(json_t *root, uint8_t *data, size_t dataLen, bool
 	uint32_t cntr =  (uint32_t)bytes_to_num(&ubuf[33], 4);
 	PrintAndLog("Counter: %d", cntr);
 	JsonSaveInt(root, "$.AppData.Counter", cntr);
-	
-	free(ubuf);
 
 	// publicKeyCredentialUserEntity
-	res = CborMapGetKeyById(&parser, &map, data, dataLen, 4);
-	if (res) {	
+	if (!found[3]) {
 		PrintAndLog("UserEntity n/a");
 	} else {
-		res = cbor_value_enter_container(&map, &mapint);
+		res = cbor_value_enter_container(&vals[3], &mapint);
 		cbor_check(res);
 		
 		while (!cbor_value_at_end(&mapint)) {
@@ -776,22 +784,19 @@ int FIDO2GetAssertionParseRes(json_t *root, uint8_t *data, size_t dataLen, bool
 				}
 			}
 		}
-		res = cbor_value_leave_container(&map, &mapint);
+		res = cbor_value_leave_container(&vals[3], &mapint);
 		cbor_check(res);
 	}
-	
-	
+
+
 	// signature
-	res = CborMapGetKeyById(&parser, &map, data, dataLen, 3);
-	if (res)
-		return res;
-	res = cbor_value_dup_byte_string(&map, &ubuf, &n, &map);
-	cbor_check(res);
-	
-	uint8_t *sign = ubuf;
+	if (!found[2])
+		return 2;
+	uint8_t *sign = CborScratchGetByteString(&vals[2], &n);
+	if (sign == NULL)
+		return 2;
 	size_t signLen = n;
 
-	cbor_check(res);
 	if (verbose2) {
 		PrintAndLog("signature [%d]: %s", signLen, sprint_hex_inrow(sign, signLen));
 	} else {
@@ -806,15 +811,12 @@ int FIDO2GetAssertionParseRes(json_t *root, uint8_t *data, size_t dataLen, bool
 	// check ANSI X9.62 format ECDSA signature (on P-256)
 	FIDO2CheckSignature(root, PublicKey, sign, signLen, authData, authDataLen, verbose);
 
-	free(ubuf);
-
 	// numberOfCredentials
-	res = CborMapGetKeyById(&parser, &map, data, dataLen, 5);
-	if (res) {
+	if (!found[4]) {
 		PrintAndLog("numberOfCredentials: 1 by default");
 	} else {
 		int64_t numberOfCredentials = 0;
-		cbor_value_get_int64(&map, &numberOfCredentials);    
+		cbor_value_get_int64(&vals[4], &numberOfCredentials);
 		PrintAndLog("numberOfCredentials: %lld", (long long)numberOfCredentials);
 	}
 	
@@ -21,6 +21,7 @@
 #include "proxendian.h"
 #include "usb_cmd.h"
 #include "comms.h"
+#include "../common/crc32.h"
 
 #define FLASH_START            0x100000
 #define FLASH_SIZE             (256*1024)
@@ -30,6 +31,17 @@
 
 #define BLOCK_SIZE             0x200
 
+// number of write blocks in flight before waiting for an ACK. The bootrom
+// handles one command at a time, USB flow control holds further ones back,
+// so the link stays busy while a block is being programmed
+#define WRITE_WINDOW           4
+
+// whether the bootloader understands CMD_FLASH_CRC (set by flash_start_flashing)
+static bool can_flash_crc = false;
+
+// whether the bootloader understands CMD_WRITE_LZ (set by flash_start_flashing)
+static bool can_write_lz = false;
+
 static const uint8_t elf_ident[] = {
 	0x7f, 'E', 'L', 'F',
 	ELFCLASS32,
@@ -372,6 +384,9 @@ int flash_start_flashing(int enable_bl_writes,char *serial_port_name)
 	if (get_proxmark_state(&state) < 0)
 		return -1;
 
+	can_flash_crc = (state & DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC) != 0;
+	can_write_lz = (state & DEVICE_INFO_FLAG_UNDERSTANDS_WRITE_LZ) != 0;
+
 	if (state & DEVICE_INFO_FLAG_UNDERSTANDS_START_FLASH) {
 		// This command is stupid. Why the heck does it care which area we're
 		// flashing, as long as it's not the bootloader area? The mind boggles.
@@ -396,18 +411,158 @@ int flash_start_flashing(int enable_bl_writes,char *serial_port_name)
 	return 0;
 }
 
-static int write_block(uint32_t address, uint8_t *data, uint32_t length)
+// send a write block without waiting for the ACK, see the write window in flash_write()
+static void send_write_block(uint32_t address, uint8_t *block_buf)
 {
-	uint8_t block_buf[BLOCK_SIZE];
-
-	memset(block_buf, 0xFF, BLOCK_SIZE);
-	memcpy(block_buf, data, length);
 	UsbCommand c;
 	c.cmd = CMD_FINISH_WRITE;
 	c.arg[0] = address;
-	memcpy(c.d.asBytes, block_buf, length);
+	memcpy(c.d.asBytes, block_buf, BLOCK_SIZE);
 	SendCommand(&c);
-	return wait_for_ack();
+}
+
+// Fetch the CRCs of the current flash contents for num_blocks blocks from address
+static int get_flash_crcs(uint32_t address, uint32_t num_blocks, uint32_t *crcs)
+{
+	while (num_blocks) {
+		uint32_t chunk = num_blocks;
+		if (chunk > USB_CMD_DATA_SIZE / sizeof(uint32_t))
+			chunk = USB_CMD_DATA_SIZE / sizeof(uint32_t);
+
+		UsbCommand c = {CMD_FLASH_CRC, {address, chunk, 0}};
+		SendCommand(&c);
+		UsbCommand resp;
+		WaitForResponse(CMD_UNKNOWN, &resp);
+		if (resp.cmd != CMD_ACK || resp.arg[1] != chunk)
+			return -1;
+		memcpy(crcs, resp.d.asBytes, chunk * sizeof(uint32_t));
+
+		crcs += chunk;
+		address += chunk * BLOCK_SIZE;
+		num_blocks -= chunk;
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// LZSS encoder matching the bootrom's CMD_WRITE_LZ decoder (stream format in
+// usb_cmd.h). Greedy, with a hash chain over 3-byte prefixes; firmware images
+// compress to roughly half their size, and since the wire cost is full
+// UsbCommand frames, that halves the number of frames for a dirty run.
+//-----------------------------------------------------------------------------
+#define LZ_HASH_BITS   12
+#define LZ_HASH_SIZE   (1 << LZ_HASH_BITS)
+#define LZ_MAX_CHAIN   64
+
+static uint32_t lz_hash(const uint8_t *p)
+{
+	return (((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// dst must have room for len + len/8 + 2 bytes (all-literal worst case)
+static uint32_t lzss_compress(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+	static int32_t head[LZ_HASH_SIZE];
+	static int32_t prev[LZSS_WIN_SIZE];
+	memset(head, -1, sizeof(head));
+
+	uint32_t out = 0;
+	uint32_t ctl_pos = out++;
+	dst[ctl_pos] = 0;
+	int ctl_bits = 0;
+
+	uint32_t pos = 0;
+	while (pos < len) {
+		if (ctl_bits == 8) {
+			ctl_pos = out++;
+			dst[ctl_pos] = 0;
+			ctl_bits = 0;
+		}
+
+		uint32_t best_len = 0, best_off = 0;
+		if (pos + LZSS_MIN_MATCH <= len) {
+			int32_t cand = head[lz_hash(src + pos)];
+			int chain = LZ_MAX_CHAIN;
+			while (cand >= 0 && chain--) {
+				// the low-bits-indexed prev table recycles slots, stale
+				// entries can point forward - stop there
+				if ((uint32_t)cand >= pos)
+					break;
+				uint32_t off = pos - cand;
+				if (off >= LZSS_WIN_SIZE)
+					break;
+				uint32_t limit = len - pos;
+				if (limit > LZSS_MAX_MATCH)
+					limit = LZSS_MAX_MATCH;
+				uint32_t mlen = 0;
+				while (mlen < limit && src[cand + mlen] == src[pos + mlen])
+					mlen++;
+				if (mlen > best_len) {
+					best_len = mlen;
+					best_off = off;
+					if (mlen == LZSS_MAX_MATCH)
+						break;
+				}
+				cand = prev[cand & (LZSS_WIN_SIZE - 1)];
+			}
+		}
+
+		if (best_len >= LZSS_MIN_MATCH) {
+			dst[out++] = best_off & 0xFF;
+			dst[out++] = ((best_off >> 4) & 0xF0) | (best_len - LZSS_MIN_MATCH);
+			for (uint32_t m = 0; m < best_len; m++) {
+				if (pos + LZSS_MIN_MATCH <= len) {
+					uint32_t h = lz_hash(src + pos);
+					prev[pos & (LZSS_WIN_SIZE - 1)] = head[h];
+					head[h] = pos;
+				}
+				pos++;
+			}
+		} else {
+			dst[ctl_pos] |= 1 << ctl_bits;
+			dst[out++] = src[pos];
+			if (pos + LZSS_MIN_MATCH <= len) {
+				uint32_t h = lz_hash(src + pos);
+				prev[pos & (LZSS_WIN_SIZE - 1)] = head[h];
+				head[h] = pos;
+			}
+			pos++;
+		}
+		ctl_bits++;
+	}
+	return out;
+}
+
+// stream one compressed run, sharing the in-flight ACK window with raw writes
+static int send_lz_run(uint32_t address, const uint8_t *zdata, uint32_t zlen, int *inflight)
+{
+	uint32_t sent = 0;
+	bool first = true;
+	while (sent < zlen) {
+		uint32_t chunk = zlen - sent;
+		if (chunk > USB_CMD_DATA_SIZE)
+			chunk = USB_CMD_DATA_SIZE;
+
+		UsbCommand c = {CMD_WRITE_LZ, {address, chunk, 0}};
+		if (first)
+			c.arg[2] |= WRITE_LZ_FIRST;
+		if (sent + chunk == zlen)
+			c.arg[2] |= WRITE_LZ_LAST;
+		memcpy(c.d.asBytes, zdata + sent, chunk);
+
+		if (*inflight == WRITE_WINDOW) {
+			if (wait_for_ack() < 0)
+				return -1;
+			(*inflight)--;
+		}
+		SendCommand(&c);
+		(*inflight)++;
+		fprintf(stderr, "z");
+
+		first = false;
+		sent += chunk;
+	}
+	return 0;
 }
 
 // Write a file's segments to Flash
@@ -421,31 +576,118 @@ int flash_write(flash_file_t *ctx)
 		uint32_t blocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
 		uint32_t end = seg->start + length;
 
-		fprintf(stderr, " 0x%08x..0x%08x [0x%x / %d blocks]",
+		fprintf(stderr, " 0x%08x..0x%08x [0x%x / %u blocks]",
 		        seg->start, end - 1, length, blocks);
 
-		int block = 0;
-		uint8_t *data = seg->data;
-		uint32_t baddr = seg->start;
+		// pad the segment out to whole blocks; the CRC comparison and both
+		// write paths work on the padded image
+		uint8_t *padded = malloc(blocks * BLOCK_SIZE);
+		bool *skip = calloc(blocks, sizeof(bool));
+		if (!padded || !skip) {
+			fprintf(stderr, "Out of memory\n");
+			free(padded);
+			free(skip);
+			return -1;
+		}
+		memset(padded, 0xFF, blocks * BLOCK_SIZE);
+		memcpy(padded, seg->data, length);
+
+		// with a capable bootloader, ask for the CRCs of what is in flash
+		// now and skip the blocks that would not change
+		uint32_t *crcs = NULL;
+		if (can_flash_crc) {
+			crcs = malloc(blocks * sizeof(uint32_t));
+			if (crcs && get_flash_crcs(seg->start, blocks, crcs) < 0) {
+				free(crcs);
+				crcs = NULL;    // just write everything
+			}
+		}
+		if (crcs) {
+			for (uint32_t b = 0; b < blocks; b++) {
+				uint32_t crc;
+				crc32(padded + b * BLOCK_SIZE, BLOCK_SIZE, (uint8_t *)&crc);
+				skip[b] = (crc == crcs[b]);
+			}
+			free(crcs);
+		}
+
+		int inflight = 0;
+		int skipped = 0;
+		uint32_t lz_in = 0, lz_out = 0;
+		uint32_t block = 0;
+		int err = 0;
+
+		while (block < blocks && !err) {
+			if (skip[block]) {
+				skipped++;
+				fprintf(stderr, "_");
+				block++;
+				continue;
+			}
 
-		while (length) {
-			uint32_t block_size = length;
-			if (block_size > BLOCK_SIZE)
-				block_size = BLOCK_SIZE;
+			// run of consecutive blocks that need writing
+			uint32_t run = 1;
+			while (block + run < blocks && !skip[block + run])
+				run++;
+
+			// compress the run if the bootloader can inflate it and doing
+			// so actually saves frames; a run of one block never can
+			bool sent_lz = false;
+			if (can_write_lz && run > 1) {
+				uint8_t *zbuf = malloc(run * BLOCK_SIZE + run * BLOCK_SIZE / 8 + 2);
+				if (zbuf) {
+					uint32_t zlen = lzss_compress(zbuf, padded + block * BLOCK_SIZE, run * BLOCK_SIZE);
+					if ((zlen + USB_CMD_DATA_SIZE - 1) / USB_CMD_DATA_SIZE < run) {
+						if (send_lz_run(seg->start + block * BLOCK_SIZE, zbuf, zlen, &inflight) < 0) {
+							err = 1;
+						} else {
+							lz_in += run * BLOCK_SIZE;
+							lz_out += zlen;
+							sent_lz = true;
+						}
+					}
+					free(zbuf);
+				}
+			}
 
-			if (write_block(baddr, data, block_size) < 0) {
-				fprintf(stderr, " ERROR\n");
-				fprintf(stderr, "Error writing block %d of %d\n", block, blocks);
-				return -1;
+			if (!sent_lz && !err) {
+				// keep up to WRITE_WINDOW blocks in flight, collecting the ACKs as we go
+				for (uint32_t b = 0; b < run; b++) {
+					if (inflight == WRITE_WINDOW) {
+						if (wait_for_ack() < 0) {
+							err = 1;
+							break;
+						}
+						inflight--;
+					}
+					send_write_block(seg->start + (block + b) * BLOCK_SIZE, padded + (block + b) * BLOCK_SIZE);
+					inflight++;
+					fprintf(stderr, ".");
+				}
 			}
+			block += run;
+		}
 
-			data += block_size;
-			baddr += block_size;
-			length -= block_size;
-			block++;
-			fprintf(stderr, ".");
+		while (inflight && !err) {
+			if (wait_for_ack() < 0)
+				err = 1;
+			inflight--;
 		}
-		fprintf(stderr, " OK\n");
+
+		free(skip);
+		free(padded);
+		if (err) {
+			fprintf(stderr, " ERROR\n");
+			fprintf(stderr, "Error writing block %u of %u\n", block, blocks);
+			return -1;
+		}
+
+		fprintf(stderr, " OK");
+		if (skipped)
+			fprintf(stderr, " (%d blocks already up to date)", skipped);
+		if (lz_out)
+			fprintf(stderr, " (compressed 0x%x -> 0x%x)", lz_in, lz_out);
+		fprintf(stderr, "\n");
 	}
 	return 0;
 }
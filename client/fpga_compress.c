@@ -85,7 +85,6 @@ int zlib_compress(FILE *infile[], uint8_t num_infiles, FILE *outfile, bool hardn
 	uint8_t *fpga_config;
 	uint32_t i;
 	int32_t ret;
-	uint8_t c;
 	z_stream compressed_fpga_stream;
 
 	if (hardnested_mode) {
@@ -111,13 +110,13 @@ int zlib_compress(FILE *infile[], uint8_t num_infiles, FILE *outfile, bool hardn
 		}
 
 		for(uint16_t j = 0; j < num_infiles; j++) {
-			for(uint16_t k = 0; k < FPGA_INTERLEAVE_SIZE; k++) {
-				c = (uint8_t)fgetc(infile[j]);
-				if (!feof(infile[j])) {
-					fpga_config[i++] = c;
-				} else if (num_infiles > 1) {
-					fpga_config[i++] = '\0';
-				}
+			// read a whole interleave chunk at once; exhausted files keep
+			// contributing zero-filled chunks until all of them hit EOF
+			size_t got = fread(&fpga_config[i], 1, FPGA_INTERLEAVE_SIZE, infile[j]);
+			i += got;
+			if (got < FPGA_INTERLEAVE_SIZE && num_infiles > 1) {
+				memset(&fpga_config[i], '\0', FPGA_INTERLEAVE_SIZE - got);
+				i += FPGA_INTERLEAVE_SIZE - got;
 			}
 		}
 
@@ -169,9 +168,7 @@ int zlib_compress(FILE *infile[], uint8_t num_infiles, FILE *outfile, bool hardn
 		return(EXIT_FAILURE);
 		}
 		
-	for (i = 0; i < compressed_fpga_stream.total_out; i++) {
-		fputc(outbuf[i], outfile);
-	}	
+	fwrite(outbuf, 1, compressed_fpga_stream.total_out, outfile);
 
 	free(outbuf);
 	deflateEnd(&compressed_fpga_stream);
@@ -210,16 +207,7 @@ int zlib_decompress(FILE *infile, FILE *outfile)
 	do {
 		if (compressed_fpga_stream.avail_in == 0) {
 			compressed_fpga_stream.next_in = inbuf;
-			uint16_t i = 0;
-			do {
-				int32_t c = fgetc(infile);
-				if (!feof(infile)) {
-					inbuf[i++] = c & 0xFF;
-					compressed_fpga_stream.avail_in++;
-				} else {
-					break;
-				}
-			} while (i < DECOMPRESS_BUF_SIZE);
+			compressed_fpga_stream.avail_in = fread(inbuf, 1, DECOMPRESS_BUF_SIZE, infile);
 		}
 
 		ret = inflate(&compressed_fpga_stream, Z_SYNC_FLUSH);
@@ -229,20 +217,14 @@ int zlib_decompress(FILE *infile, FILE *outfile)
 		}
 
 		if (compressed_fpga_stream.avail_out == 0) {
-			for (uint16_t i = 0; i < DECOMPRESS_BUF_SIZE; i++) {
-				fputc(outbuf[i], outfile);
-			}
+			fwrite(outbuf, 1, DECOMPRESS_BUF_SIZE, outfile);
 			compressed_fpga_stream.avail_out = DECOMPRESS_BUF_SIZE;
 			compressed_fpga_stream.next_out = outbuf;
 		}
 	} while (ret == Z_OK);
 
 	if (ret == Z_STREAM_END) {  // reached end of input
-		uint16_t i = 0;
-		while (compressed_fpga_stream.avail_out < DECOMPRESS_BUF_SIZE) {
-			fputc(outbuf[i++], outfile);
-			compressed_fpga_stream.avail_out++;
-		}
+		fwrite(outbuf, 1, DECOMPRESS_BUF_SIZE - compressed_fpga_stream.avail_out, outfile);
 		fclose(outfile);
 		fclose(infile);
 		return(EXIT_SUCCESS);
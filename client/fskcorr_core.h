@@ -0,0 +1,23 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// FSK matched-filter kernel, compiled per instruction set with runtime CPU
+// dispatch (same scheme as hardnested_bf_core and autocorr_core).
+//-----------------------------------------------------------------------------
+
+#ifndef FSKCORR_CORE_H__
+#define FSKCORR_CORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Mark each sample with the field clock whose square-wave template correlates
+// stronger at that position: 1 for fclow (the shorter, higher frequency wave),
+// 0 for fchigh. samples are raw 0-255 values as in the graph buffer.
+// Returns false if scratch memory could not be allocated.
+extern bool fsk_correlate_core(const uint8_t *samples, size_t size, uint8_t fchigh, uint8_t fclow, uint8_t *marks);
+
+#endif
@@ -10,7 +10,9 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "ui.h"
 #include "graph.h"
 #include "lfdemod.h"
@@ -21,6 +23,101 @@ int GraphTraceLen;
 
 int s_Buff[MAX_GRAPH_TRACE_LEN];
 
+// Seqlock-published snapshot of the graph buffers. The Qt plot thread used
+// to read GraphBuffer/s_Buff directly while demods mutated them, which
+// forced pausing acquisition around repaints. Writers (RepaintGraphWindow
+// callers) publish a consistent frame here; the plot reads only the
+// snapshot, so the live buffers can change at any time.
+static int snapshotGraph[MAX_GRAPH_TRACE_LEN];
+static int snapshotOverlay[MAX_GRAPH_TRACE_LEN];
+static int snapshotLen = 0;
+static unsigned int snapshotSeq = 0;	// odd while a write is in progress
+static pthread_mutex_t snapshotWriteMutex = PTHREAD_MUTEX_INITIALIZER;
+
+void GraphSnapshotPublish(void)
+{
+	// both the command thread and GUI-side operations publish
+	pthread_mutex_lock(&snapshotWriteMutex);
+	__atomic_fetch_add(&snapshotSeq, 1, __ATOMIC_ACQ_REL);
+
+	int len = GraphTraceLen;
+	if (len > MAX_GRAPH_TRACE_LEN)
+		len = MAX_GRAPH_TRACE_LEN;
+	memcpy(snapshotGraph, GraphBuffer, len * sizeof(int));
+	memcpy(snapshotOverlay, s_Buff, len * sizeof(int));
+	snapshotLen = len;
+
+	__atomic_fetch_add(&snapshotSeq, 1, __ATOMIC_ACQ_REL);
+	pthread_mutex_unlock(&snapshotWriteMutex);
+}
+
+unsigned int GraphSnapshotSeq(void)
+{
+	return __atomic_load_n(&snapshotSeq, __ATOMIC_ACQUIRE);
+}
+
+unsigned int GraphSnapshotRead(int *graph, int *overlay, int *len)
+{
+	for (;;) {
+		unsigned int seq = __atomic_load_n(&snapshotSeq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;	// write in progress
+		int l = snapshotLen;
+		memcpy(graph, snapshotGraph, l * sizeof(int));
+		memcpy(overlay, snapshotOverlay, l * sizeof(int));
+		if (__atomic_load_n(&snapshotSeq, __ATOMIC_ACQUIRE) == seq) {
+			*len = l;
+			return seq;
+		}
+	}
+}
+
+// Read-only demod view of the graph buffer, published with the same
+// seqlock discipline as the plot snapshot above. The lfdemod routines
+// mutate the sample buffer they are handed, so concurrent demod workers
+// ('data demodtune') each copy the view into a private buffer instead of
+// sharing getFromGraphBuf() output.
+static uint8_t viewSamples[MAX_GRAPH_TRACE_LEN];
+static size_t viewLen = 0;
+static unsigned int viewSeq = 0;	// odd while a write is in progress
+static pthread_mutex_t viewWriteMutex = PTHREAD_MUTEX_INITIALIZER;
+
+void GraphViewPublish(void)
+{
+	pthread_mutex_lock(&viewWriteMutex);
+	__atomic_fetch_add(&viewSeq, 1, __ATOMIC_ACQ_REL);
+
+	size_t len = GraphTraceLen;
+	if (len > MAX_GRAPH_TRACE_LEN)
+		len = MAX_GRAPH_TRACE_LEN;
+	// same conversion as getFromGraphBuf, without writing back the clamp
+	for (size_t i = 0; i < len; ++i) {
+		int v = GraphBuffer[i];
+		if (v > 127) v = 127;
+		else if (v < -127) v = -127;
+		viewSamples[i] = (uint8_t)(v + 128);
+	}
+	viewLen = len;
+
+	__atomic_fetch_add(&viewSeq, 1, __ATOMIC_ACQ_REL);
+	pthread_mutex_unlock(&viewWriteMutex);
+}
+
+unsigned int GraphViewCopy(uint8_t *samples, size_t *len)
+{
+	for (;;) {
+		unsigned int seq = __atomic_load_n(&viewSeq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;	// write in progress
+		size_t l = viewLen;
+		memcpy(samples, viewSamples, l);
+		if (__atomic_load_n(&viewSeq, __ATOMIC_ACQUIRE) == seq) {
+			*len = l;
+			return seq;
+		}
+	}
+}
+
 /* write a manchester bit to the graph */
 void AppendGraph(int redraw, int clock, int bit)
 {
@@ -71,6 +168,112 @@ void save_restoreGB(uint8_t saveOpt)
 	return;
 }
 
+// Generational undo for the graph buffer. Destructive operations (hpf, norm,
+// dec, trims, ...) call graph_push_undo() before they overwrite GraphBuffer,
+// and 'data undo' steps back through the saved states. The newest saved state
+// is kept as a full copy; every older one is stored only as the range in which
+// it differs from its successor, so a long chain of filters - which typically
+// touch either the whole buffer or a small part of it - costs far less than a
+// full copy per step.
+#define GRAPH_UNDO_DEPTH 32
+
+typedef struct {
+	uint32_t start;		// first sample differing from the newer state
+	uint32_t count;		// number of differing samples
+	int *samples;		// the older state's content of that range
+	int traceLen;
+	int gridOffset;
+} graph_undo_delta_t;
+
+static int undo_base[MAX_GRAPH_TRACE_LEN];	// newest saved state, full copy
+static int undo_base_len = 0;
+static int undo_base_grid = 0;
+static bool undo_base_valid = false;
+static graph_undo_delta_t undo_stack[GRAPH_UNDO_DEPTH];
+static int undo_depth = 0;
+
+static bool graph_undo_base_is_current(void)
+{
+	return undo_base_valid
+		&& undo_base_len == GraphTraceLen
+		&& undo_base_grid == GridOffset
+		&& memcmp(undo_base, GraphBuffer, sizeof(GraphBuffer)) == 0;
+}
+
+void graph_push_undo(void)
+{
+	if (!undo_base_valid) {
+		memcpy(undo_base, GraphBuffer, sizeof(GraphBuffer));
+		undo_base_len = GraphTraceLen;
+		undo_base_grid = GridOffset;
+		undo_base_valid = true;
+		return;
+	}
+
+	if (graph_undo_base_is_current()) // nothing changed since the last push
+		return;
+
+	// demote the previous base to a delta against the current buffer
+	uint32_t first = 0;
+	uint32_t last = MAX_GRAPH_TRACE_LEN;
+	while (first < MAX_GRAPH_TRACE_LEN && undo_base[first] == GraphBuffer[first])
+		first++;
+	while (last > first && undo_base[last-1] == GraphBuffer[last-1])
+		last--;
+
+	graph_undo_delta_t delta = {first, last - first, NULL, undo_base_len, undo_base_grid};
+	if (delta.count > 0) {
+		delta.samples = malloc(delta.count * sizeof(int));
+		if (delta.samples == NULL) // keep the old base, skip this generation
+			return;
+		memcpy(delta.samples, undo_base + first, delta.count * sizeof(int));
+	}
+
+	if (undo_depth == GRAPH_UNDO_DEPTH) { // full: drop the oldest state
+		free(undo_stack[0].samples);
+		memmove(undo_stack, undo_stack + 1, (GRAPH_UNDO_DEPTH - 1) * sizeof(undo_stack[0]));
+		undo_depth--;
+	}
+	undo_stack[undo_depth++] = delta;
+
+	memcpy(undo_base, GraphBuffer, sizeof(GraphBuffer));
+	undo_base_len = GraphTraceLen;
+	undo_base_grid = GridOffset;
+}
+
+bool graph_pop_undo(void)
+{
+	if (!undo_base_valid)
+		return false;
+
+	if (!graph_undo_base_is_current()) {
+		// buffer was modified after the last push: step back to the base first
+		memcpy(GraphBuffer, undo_base, sizeof(GraphBuffer));
+		GraphTraceLen = undo_base_len;
+		GridOffset = undo_base_grid;
+		RepaintGraphWindow();
+		return true;
+	}
+
+	if (undo_depth == 0)
+		return false;
+
+	// rewind the base one generation by applying the newest delta
+	graph_undo_delta_t *delta = &undo_stack[--undo_depth];
+	if (delta->count > 0) {
+		memcpy(undo_base + delta->start, delta->samples, delta->count * sizeof(int));
+		free(delta->samples);
+	}
+	undo_base_len = delta->traceLen;
+	undo_base_grid = delta->gridOffset;
+
+	memcpy(GraphBuffer, undo_base, sizeof(GraphBuffer));
+	GraphTraceLen = undo_base_len;
+	GridOffset = undo_base_grid;
+	RepaintGraphWindow();
+	return true;
+}
+
 // DETECT CLOCK NOW IN LFDEMOD.C
 
 void setGraphBuf(uint8_t *buff, size_t size)
@@ -93,9 +296,12 @@ size_t getFromGraphBuf(uint8_t *buff)
 	if (buff == NULL ) return 0;
 	uint32_t i;
 	for (i=0;i<GraphTraceLen;++i){
-		if (GraphBuffer[i]>127) GraphBuffer[i]=127; //trim
-		if (GraphBuffer[i]<-127) GraphBuffer[i]=-127; //trim
-		buff[i]=(uint8_t)(GraphBuffer[i]+128);
+		int v = GraphBuffer[i];
+		// trim, writing back only when needed - the common all-8-bit case
+		// then leaves the GraphBuffer cache lines clean
+		if (v > 127) { v = 127; GraphBuffer[i] = v; }
+		else if (v < -127) { v = -127; GraphBuffer[i] = v; }
+		buff[i] = (uint8_t)(v + 128);
 	}
 	return i;
 }
@@ -132,6 +338,11 @@ void DetectHighLowInGraph(int *high, int *low, bool addFuzz) {
 	}
 }
 
+// shared scratch for the 8-bit sample copies the clock detectors below hand
+// to lfdemod: one static buffer instead of a fresh zero-initialized 320K
+// stack array per call. The detectors don't nest, so sharing is safe.
+static uint8_t graphScratch[MAX_GRAPH_TRACE_LEN];
+
 // Get or auto-detect ask clock rate
 int GetAskClock(const char str[], bool printAns, bool verbose)
 {
@@ -143,7 +354,7 @@ int GetAskClock(const char str[], bool printAns, bool verbose)
 	if (clock != 0) 
 		return clock;
 	// Auto-detect clock
-	uint8_t grph[MAX_GRAPH_TRACE_LEN]={0};
+	uint8_t *grph = graphScratch;
 	size_t size = getFromGraphBuf(grph);
 	if (size == 0) {
 		if (verbose)
@@ -168,7 +379,7 @@ int GetAskClock(const char str[], bool printAns, bool verbose)
 uint8_t GetPskCarrier(const char str[], bool printAns, bool verbose)
 {
 	uint8_t carrier=0;
-	uint8_t grph[MAX_GRAPH_TRACE_LEN]={0};
+	uint8_t *grph = graphScratch;
 	size_t size = getFromGraphBuf(grph);
 	if ( size == 0 ) {
 		if (verbose) 
@@ -196,7 +407,7 @@ int GetPskClock(const char str[], bool printAns, bool verbose)
 	if (clock!=0) 
 		return clock;
 	// Auto-detect clock
-	uint8_t grph[MAX_GRAPH_TRACE_LEN]={0};
+	uint8_t *grph = graphScratch;
 	size_t size = getFromGraphBuf(grph);
 	if ( size == 0 ) {
 		if (verbose) 
@@ -224,7 +435,7 @@ uint8_t GetNrzClock(const char str[], bool printAns, bool verbose)
 	if (clock!=0) 
 		return clock;
 	// Auto-detect clock
-	uint8_t grph[MAX_GRAPH_TRACE_LEN]={0};
+	uint8_t *grph = graphScratch;
 	size_t size = getFromGraphBuf(grph);
 	if ( size == 0 ) {
 		if (verbose) 
@@ -268,7 +479,7 @@ uint8_t GetFskClock(const char str[], bool printAns, bool verbose)
 }
 uint8_t fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, bool verbose, int *firstClockEdge)
 {
-	uint8_t BitStream[MAX_GRAPH_TRACE_LEN]={0};
+	uint8_t *BitStream = graphScratch;
 	size_t size = getFromGraphBuf(BitStream);
 	if (size==0) return 0;
 	uint16_t ans = countFC(BitStream, size, 1); 
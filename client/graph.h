@@ -26,9 +26,21 @@ uint8_t fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, bool verbose, int *f
 bool graphJustNoise(int *BitStream, int size);
 void setGraphBuf(uint8_t *buff, size_t size);
 void save_restoreGB(uint8_t saveOpt);
+void graph_push_undo(void);
+bool graph_pop_undo(void);
 
 bool HasGraphData();
-void DetectHighLowInGraph(int *high, int *low, bool addFuzz); 
+void DetectHighLowInGraph(int *high, int *low, bool addFuzz);
+
+// seqlock-published graph snapshot for the plot window (see proxgui.h)
+void GraphSnapshotPublish(void);
+unsigned int GraphSnapshotSeq(void);
+unsigned int GraphSnapshotRead(int *graph, int *overlay, int *len);
+
+// seqlock-published read-only uint8 sample view for concurrent demod
+// workers (see 'data demodtune')
+void GraphViewPublish(void);
+unsigned int GraphViewCopy(uint8_t *samples, size_t *len);
 
 // Max graph trace len: 40000 (bigbuf) * 8 (at 1 bit per sample)
 #define MAX_GRAPH_TRACE_LEN (40000 * 8 )
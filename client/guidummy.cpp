@@ -22,6 +22,6 @@ extern "C" void ShowGraphWindow(void)
 
 extern "C" void HideGraphWindow(void) {}
 extern "C" void RepaintGraphWindow(void) {}
-extern "C" void MainGraphics() {}
-extern "C" void InitGraphics(int argc, char **argv) {}
+extern "C" void MainGraphics(void) {}
+extern "C" void InitGraphics(int argc, char **argv, char *script_cmds_file, char *script_cmd, bool usb_present) {}
 extern "C" void ExitGraphics(void) {}
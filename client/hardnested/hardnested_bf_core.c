@@ -59,6 +59,9 @@ THE SOFTWARE.
 #include <string.h>
 #include "crapto1/crapto1.h"
 #include "parity.h"
+#ifdef WITH_OPENCL
+#include "hardnested_bf_opencl.h"
+#endif
 
 // bitslice type
 // while AVX supports 256 bit vector floating point operations, we need integer operations for boolean logic
@@ -167,41 +170,34 @@ typedef enum {
 } odd_even_t;
 
 
-// arrays of bitsliced states with identical values in all slices
-static bitslice_t bitsliced_encrypted_nonces[256][KEYSTREAM_SIZE];
-static bitslice_t bitsliced_encrypted_parity_bits[256][4];
-// 1 and 0 vectors
-static bitslice_t bs_ones;
-static bitslice_t bs_zeroes;
+// The encrypted test nonces are identical in all slices, so they are kept as
+// plain bitmasks (one bit per keystream/parity bit) and broadcast to a vector
+// on the fly in the inner loop. Keeping them as pre-splatted vectors (24+4
+// vectors per nonce, ~200KB on AVX2) used to blow the working set of one
+// bucket out of L2 and re-streamed it for every odd state tested; the masks
+// fit in a few cache lines.
+static uint32_t encrypted_nonce_bits[256];		// 2nd to 4th nonce byte, bit ks_idx
+static uint8_t encrypted_parity_bits[256];		// 4 parity bits
 
+// broadcast the single bit (0 or 1) selected by mask & (1 << idx) to a full
+// all-zeroes/all-ones vector (0 - 1 = 0xff.. in every lane)
+#define broadcast_bit(mask, idx) ((bitslice_value_t){0} - (uint32_t)(((mask) >> (idx)) & 1))
 
 void BITSLICE_TEST_NONCES(uint32_t nonces_to_bruteforce, uint32_t *bf_test_nonce, uint8_t *bf_test_nonce_par) {
 
-	// initialize 1 and 0 vectors
-    memset(bs_ones.bytes, 0xff, VECTOR_SIZE);
-    memset(bs_zeroes.bytes, 0x00, VECTOR_SIZE);
-
-	// bitslice nonces' 2nd to 4th byte
+	// store nonces' 2nd to 4th byte with bit ks_idx in keystream order
 	for (uint32_t i = 0; i < nonces_to_bruteforce; i++) {
+		encrypted_nonce_bits[i] = 0;
 		for(uint32_t bit_idx = 0; bit_idx < KEYSTREAM_SIZE; bit_idx++){
 			bool bit = get_bit(KEYSTREAM_SIZE-1-bit_idx, rev32(bf_test_nonce[i] << 8));
 			if(bit){
-				bitsliced_encrypted_nonces[i][bit_idx].value = bs_ones.value;
-			} else {
-				bitsliced_encrypted_nonces[i][bit_idx].value = bs_zeroes.value;
+				encrypted_nonce_bits[i] |= 1 << bit_idx;
 			}
 		}
 	}
-	// bitslice nonces' parity (4 bits)
+	// nonces' parity (4 bits)
 	for (uint32_t i = 0; i < nonces_to_bruteforce; i++) {
-		for(uint32_t bit_idx = 0; bit_idx < 4; bit_idx++){
-			bool bit = get_bit(4-1-bit_idx, bf_test_nonce_par[i]);
-			if(bit){
-				bitsliced_encrypted_parity_bits[i][bit_idx].value = bs_ones.value;
-			} else {
-				bitsliced_encrypted_parity_bits[i][bit_idx].value = bs_zeroes.value;
-			}
-		}
+		encrypted_parity_bits[i] = bf_test_nonce_par[i] & 0x0f;
 	}
 
 }
@@ -341,6 +337,13 @@ const uint64_t CRACK_STATES_BITSLICED(uint32_t cuid, uint8_t *best_first_bytes,
 				// printf("block_idx = %d/%d\n", block_idx, bitsliced_blocks);
 			// }
 #endif
+            // hint the next block's even states into cache while this one is tested
+			if (block_idx + 1 < bitsliced_blocks) {
+				const uint8_t *next = (const uint8_t *)bitsliced_even_states[block_idx + 1];
+				for (uint32_t line = 0; line < STATE_SIZE/2*sizeof(bitslice_t); line += 64) {
+					__builtin_prefetch(next + line, 0, 0);
+				}
+			}
             // add the even state bits
 			const bitslice_t *restrict bitsliced_even_state = bitsliced_even_states[block_idx];
 			for(uint32_t state_idx = 1; state_idx < STATE_SIZE; state_idx += 2) {
@@ -360,6 +363,8 @@ const uint64_t CRACK_STATES_BITSLICED(uint32_t cuid, uint8_t *best_first_bytes,
 			uint32_t next_common_bits = 0;
 
             for(uint32_t tests = 0; tests < nonces_to_bruteforce; ++tests){
+				const uint32_t nonce_bits = encrypted_nonce_bits[tests];
+				const uint8_t nonce_par = encrypted_parity_bits[tests];
 				// common bits with preceding test nonce
 				uint32_t common_bits = next_common_bits; //tests ? trailing_zeros(bf_test_nonce_2nd_byte[tests] ^ bf_test_nonce_2nd_byte[tests-1]) : 0;
 				next_common_bits = tests < nonces_to_bruteforce - 1 ? trailing_zeros(bf_test_nonce_2nd_byte[tests] ^ bf_test_nonce_2nd_byte[tests+1]) : 0;
@@ -375,8 +380,8 @@ const uint64_t CRACK_STATES_BITSLICED(uint32_t cuid, uint8_t *best_first_bytes,
 				// or the highest bit which differs from the previous nonce
                 for (int32_t ks_idx = KEYSTREAM_SIZE-1-common_bits; ks_idx >= 0; --ks_idx) {
 
-                    // decrypt nonce bits
-                    const bitslice_value_t encrypted_nonce_bit_vector = bitsliced_encrypted_nonces[tests][ks_idx].value;
+                    // decrypt nonce bits (broadcast the mask bit, no table load)
+                    const bitslice_value_t encrypted_nonce_bit_vector = broadcast_bit(nonce_bits, ks_idx);
                     const bitslice_value_t decrypted_nonce_bit_vector = encrypted_nonce_bit_vector ^ ks_bits;
 
                     // compute real parity bits on the fly
@@ -416,7 +421,8 @@ const uint64_t CRACK_STATES_BITSLICED(uint32_t cuid, uint8_t *best_first_bytes,
                     // for each completed byte:
                     if ((ks_idx & 0x07) == 0) {
                         // get encrypted parity bits
-                        const bitslice_value_t encrypted_parity_bit_vector = bitsliced_encrypted_parity_bits[tests][parity_bit_idx++].value;
+                        const bitslice_value_t encrypted_parity_bit_vector = broadcast_bit(nonce_par, 3 - parity_bit_idx);
+                        parity_bit_idx++;
 
                         // decrypt parity bits
                         const bitslice_value_t decrypted_parity_bit_vector = encrypted_parity_bit_vector ^ ks_bits;
@@ -654,10 +660,24 @@ void bitslice_test_nonces_dispatch(uint32_t nonces_to_bruteforce, uint32_t *bf_t
 
 // Entries to dispatched function calls
 const uint64_t crack_states_bitsliced(uint32_t cuid, uint8_t *best_first_bytes, statelist_t *p, uint32_t *keys_found, uint64_t *num_keys_tested, uint32_t nonces_to_bruteforce, uint8_t *bf_test_nonce_2nd_byte, noncelist_t *nonces) {
+#ifdef WITH_OPENCL
+	// hand the bucket to the GPU when one is available; a GPU failure falls
+	// back to the CPU implementation for this bucket
+	if (opencl_brute_force_available()) {
+		bool gpu_ok;
+		const uint64_t key = crack_states_opencl(cuid, best_first_bytes, p, keys_found, num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, nonces, &gpu_ok);
+		if (gpu_ok) {
+			return key;
+		}
+	}
+#endif
     return (*crack_states_bitsliced_function_p)(cuid, best_first_bytes, p, keys_found, num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, nonces);
 }
 
 void bitslice_test_nonces(uint32_t nonces_to_bruteforce, uint32_t *bf_test_nonce, uint8_t *bf_test_nonce_par) {
+#ifdef WITH_OPENCL
+	opencl_set_test_nonces(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
+#endif
     (*bitslice_test_nonces_function_p)(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
 }
 
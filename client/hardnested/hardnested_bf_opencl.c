@@ -0,0 +1,286 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Optional OpenCL GPU backend for the hardnested brute force phase.
+//
+// The bitsliced CPU implementation in hardnested_bf_core.c tests the cross
+// product of a bucket's odd and even half-states against the test nonces.
+// This backend maps the same work onto a GPU: one work-item per (even, odd)
+// state pair, running a plain scalar crypto1 check (the massive parallelism
+// replaces the bitslicing). Surviving pairs - a handful per bucket at most -
+// are verified on the host with verify_key(), exactly like the survivors of
+// the bitsliced test, so a GPU false positive can never produce a wrong key.
+//
+// The work partitioning is unchanged: the brute force worker threads hand
+// buckets to crack_states_bitsliced() as before, and its entry point routes
+// them here when a GPU is available. Any OpenCL failure falls back to the
+// CPU path for the affected bucket.
+//-----------------------------------------------------------------------------
+
+#include "hardnested_bf_opencl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include "crapto1/crapto1.h"
+
+// bit indexing and nonce sizes, same conventions as hardnested_bf_core.c
+#define get_bit(n, word) (((word) >> (n)) & 1)
+#define KEYSTREAM_SIZE 24
+#define rev32(word) ((((word) & 0xff) << 24) | ((((word) >> 8) & 0xff) << 16) | ((((word) >> 16) & 0xff) << 8) | ((((word) >> 24) & 0xff)))
+
+// more survivors than this per bucket means something is wrong (the parity
+// checks eliminate all but a tiny fraction); fall back to the CPU if it hits
+#define MAX_SURVIVORS 65536
+
+// scalar crypto1 test, one work-item per (even, odd) state pair. The test is
+// the same as the bitsliced one: shift in the decrypted 2nd to 4th nonce
+// byte and check the three parity bits against the keystream.
+static const char *opencl_kernel_source =
+"#define LF_POLY_ODD  0x29CE5C\n"
+"#define LF_POLY_EVEN 0x870804\n"
+"\n"
+"inline uint filter(uint x)\n"
+"{\n"
+"	uint f;\n"
+"	f  = 0xf22c0 >> (x       & 0xf) & 16;\n"
+"	f |= 0x6c9c0 >> (x >>  4 & 0xf) &  8;\n"
+"	f |= 0x3c8b0 >> (x >>  8 & 0xf) &  4;\n"
+"	f |= 0x1e458 >> (x >> 12 & 0xf) &  2;\n"
+"	f |= 0x0d938 >> (x >> 16 & 0xf) &  1;\n"
+"	return (0xEC57E80A >> f) & 1;\n"
+"}\n"
+"\n"
+"__kernel void crack_states(__global const uint *odd_states, uint num_odd,\n"
+"                           __global const uint *even_states, uint num_even,\n"
+"                           __global const uint *nonce_bits,\n"
+"                           __global const uchar *nonce_par, uint num_nonces,\n"
+"                           volatile __global uint *survivor_count,\n"
+"                           __global uint2 *survivors, uint max_survivors)\n"
+"{\n"
+"	uint even_idx = get_global_id(0);\n"
+"	uint odd_idx = get_global_id(1);\n"
+"	if (even_idx >= num_even || odd_idx >= num_odd) return;\n"
+"\n"
+"	for (uint tests = 0; tests < num_nonces; tests++) {\n"
+"		uint odd = odd_states[odd_idx];\n"
+"		uint even = even_states[even_idx];\n"
+"		uint nbits = nonce_bits[tests];\n"
+"		uint npar = nonce_par[tests];\n"
+"		uint par_acc = 0;\n"
+"		for (int ks_idx = 23; ks_idx >= 0; ks_idx--) {\n"
+"			uint ks = filter(odd);\n"
+"			uint dec = ks ^ ((nbits >> ks_idx) & 1);\n"
+"			par_acc ^= dec;\n"
+"			uint feedin = dec;\n"
+"			feedin ^= LF_POLY_ODD & odd;\n"
+"			feedin ^= LF_POLY_EVEN & even;\n"
+"			uint t = even << 1 | (popcount(feedin) & 1);\n"
+"			even = odd;\n"
+"			odd = t;\n"
+"			if ((ks_idx & 7) == 0) {\n"
+"				// parity bits 1..3 for the 2nd to 4th nonce byte\n"
+"				uint parity_bit_idx = 3 - (ks_idx >> 3);\n"
+"				uint enc_par = (npar >> (3 - parity_bit_idx)) & 1;\n"
+"				// state pair eliminated, this work-item is done\n"
+"				if (par_acc != (enc_par ^ filter(odd))) return;\n"
+"				par_acc = 0;\n"
+"			}\n"
+"		}\n"
+"	}\n"
+"\n"
+"	uint slot = atomic_inc(survivor_count);\n"
+"	if (slot < max_survivors) {\n"
+"		survivors[slot] = (uint2)(odd_states[odd_idx], even_states[even_idx]);\n"
+"	}\n"
+"}\n";
+
+static pthread_once_t opencl_init_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t opencl_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool opencl_available = false;
+static cl_context opencl_context;
+static cl_command_queue opencl_queue;
+static cl_kernel opencl_kernel;
+
+// test nonces in the compact mask encoding, uploaded per crack run
+static uint32_t opencl_nonce_bits[256];
+static uint8_t opencl_nonce_par[256];
+static uint32_t opencl_num_nonces = 0;
+
+static void opencl_init(void)
+{
+	char *env = getenv("PM3_OPENCL");
+	if (env != NULL && strcmp(env, "0") == 0) {
+		return;
+	}
+
+	cl_platform_id platform;
+	cl_uint num_platforms = 0;
+	if (clGetPlatformIDs(1, &platform, &num_platforms) != CL_SUCCESS || num_platforms == 0) {
+		return;
+	}
+	cl_device_id device;
+	if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, NULL) != CL_SUCCESS) {
+		return;
+	}
+
+	cl_int err;
+	opencl_context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+	if (err != CL_SUCCESS) {
+		return;
+	}
+	opencl_queue = clCreateCommandQueue(opencl_context, device, 0, &err);
+	if (err != CL_SUCCESS) {
+		clReleaseContext(opencl_context);
+		return;
+	}
+	cl_program program = clCreateProgramWithSource(opencl_context, 1, &opencl_kernel_source, NULL, &err);
+	if (err != CL_SUCCESS
+			|| clBuildProgram(program, 1, &device, NULL, NULL, NULL) != CL_SUCCESS) {
+		printf("Failed to build OpenCL kernel, using CPU brute force\n");
+		clReleaseCommandQueue(opencl_queue);
+		clReleaseContext(opencl_context);
+		return;
+	}
+	opencl_kernel = clCreateKernel(program, "crack_states", &err);
+	clReleaseProgram(program);
+	if (err != CL_SUCCESS) {
+		clReleaseCommandQueue(opencl_queue);
+		clReleaseContext(opencl_context);
+		return;
+	}
+
+	char device_name[128] = "unknown";
+	clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(device_name) - 1, device_name, NULL);
+	printf("Brute force phase will run on OpenCL device %s\n", device_name);
+	opencl_available = true;
+}
+
+bool opencl_brute_force_available(void)
+{
+	pthread_once(&opencl_init_once, opencl_init);
+	return opencl_available;
+}
+
+void opencl_set_test_nonces(uint32_t nonces_to_bruteforce, uint32_t *bf_test_nonce, uint8_t *bf_test_nonce_par)
+{
+	// same encoding as the CPU implementation: 2nd to 4th nonce byte with
+	// bit ks_idx in keystream order, plus 4 parity bits
+	for (uint32_t i = 0; i < nonces_to_bruteforce; i++) {
+		opencl_nonce_bits[i] = 0;
+		for (uint32_t bit_idx = 0; bit_idx < KEYSTREAM_SIZE; bit_idx++) {
+			if (get_bit(KEYSTREAM_SIZE-1-bit_idx, rev32(bf_test_nonce[i] << 8))) {
+				opencl_nonce_bits[i] |= 1 << bit_idx;
+			}
+		}
+		opencl_nonce_par[i] = bf_test_nonce_par[i] & 0x0f;
+	}
+	opencl_num_nonces = nonces_to_bruteforce;
+}
+
+const uint64_t crack_states_opencl(uint32_t cuid, uint8_t *best_first_bytes, statelist_t *p, uint32_t *keys_found, uint64_t *num_keys_tested, uint32_t nonces_to_bruteforce, uint8_t *bf_test_nonce_2nd_byte, noncelist_t *nonces, bool *gpu_ok)
+{
+	typedef enum {
+		EVEN_STATE = 0,
+		ODD_STATE = 1
+	} odd_even_t;
+
+	uint64_t key = -1;
+	uint32_t num_even = p->len[EVEN_STATE];
+	uint32_t num_odd = p->len[ODD_STATE];
+	uint32_t survivor_count = 0;
+	cl_uint2 *survivors = NULL;
+	cl_int err = CL_SUCCESS;
+	*gpu_ok = false;
+
+	if (num_even == 0 || num_odd == 0 || opencl_num_nonces == 0) {
+		*gpu_ok = true;
+		return key;
+	}
+	if (*keys_found) {
+		*gpu_ok = true;
+		return key;
+	}
+
+	// one GPU, many worker threads: serialize bucket submission
+	pthread_mutex_lock(&opencl_mutex);
+
+	cl_mem odd_buf = clCreateBuffer(opencl_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, num_odd * sizeof(uint32_t), p->states[ODD_STATE], &err);
+	cl_mem even_buf = (err == CL_SUCCESS) ? clCreateBuffer(opencl_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, num_even * sizeof(uint32_t), p->states[EVEN_STATE], &err) : NULL;
+	cl_mem nonce_buf = (err == CL_SUCCESS) ? clCreateBuffer(opencl_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, opencl_num_nonces * sizeof(uint32_t), opencl_nonce_bits, &err) : NULL;
+	cl_mem par_buf = (err == CL_SUCCESS) ? clCreateBuffer(opencl_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, opencl_num_nonces * sizeof(uint8_t), opencl_nonce_par, &err) : NULL;
+	cl_mem count_buf = (err == CL_SUCCESS) ? clCreateBuffer(opencl_context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(uint32_t), &survivor_count, &err) : NULL;
+	cl_mem survivor_buf = (err == CL_SUCCESS) ? clCreateBuffer(opencl_context, CL_MEM_WRITE_ONLY, MAX_SURVIVORS * sizeof(cl_uint2), NULL, &err) : NULL;
+
+	if (err == CL_SUCCESS) {
+		cl_uint max_survivors = MAX_SURVIVORS;
+		clSetKernelArg(opencl_kernel, 0, sizeof(cl_mem), &odd_buf);
+		clSetKernelArg(opencl_kernel, 1, sizeof(cl_uint), &num_odd);
+		clSetKernelArg(opencl_kernel, 2, sizeof(cl_mem), &even_buf);
+		clSetKernelArg(opencl_kernel, 3, sizeof(cl_uint), &num_even);
+		clSetKernelArg(opencl_kernel, 4, sizeof(cl_mem), &nonce_buf);
+		clSetKernelArg(opencl_kernel, 5, sizeof(cl_mem), &par_buf);
+		clSetKernelArg(opencl_kernel, 6, sizeof(cl_uint), &opencl_num_nonces);
+		clSetKernelArg(opencl_kernel, 7, sizeof(cl_mem), &count_buf);
+		clSetKernelArg(opencl_kernel, 8, sizeof(cl_mem), &survivor_buf);
+		err = clSetKernelArg(opencl_kernel, 9, sizeof(cl_uint), &max_survivors);
+	}
+	if (err == CL_SUCCESS) {
+		// round global size up to a multiple of the workgroup size
+		size_t global[2] = { (num_even + 63) & ~(size_t)63, (num_odd + 3) & ~(size_t)3 };
+		size_t local[2] = { 64, 4 };
+		err = clEnqueueNDRangeKernel(opencl_queue, opencl_kernel, 2, NULL, global, local, 0, NULL, NULL);
+	}
+	if (err == CL_SUCCESS) {
+		err = clEnqueueReadBuffer(opencl_queue, count_buf, CL_TRUE, 0, sizeof(uint32_t), &survivor_count, 0, NULL, NULL);
+	}
+	if (err == CL_SUCCESS && survivor_count > 0 && survivor_count <= MAX_SURVIVORS) {
+		survivors = malloc(survivor_count * sizeof(cl_uint2));
+		if (survivors == NULL) {
+			err = CL_OUT_OF_HOST_MEMORY;
+		} else {
+			err = clEnqueueReadBuffer(opencl_queue, survivor_buf, CL_TRUE, 0, survivor_count * sizeof(cl_uint2), survivors, 0, NULL, NULL);
+		}
+	}
+
+	if (survivor_buf) clReleaseMemObject(survivor_buf);
+	if (count_buf) clReleaseMemObject(count_buf);
+	if (par_buf) clReleaseMemObject(par_buf);
+	if (nonce_buf) clReleaseMemObject(nonce_buf);
+	if (even_buf) clReleaseMemObject(even_buf);
+	if (odd_buf) clReleaseMemObject(odd_buf);
+	pthread_mutex_unlock(&opencl_mutex);
+
+	if (err != CL_SUCCESS || survivor_count > MAX_SURVIVORS) {
+		// let the CPU implementation crack this bucket
+		free(survivors);
+		return key;
+	}
+
+	// verify the survivors on the host, like the CPU path does
+	for (uint32_t i = 0; i < survivor_count; i++) {
+		uint32_t odd = survivors[i].s[0];
+		uint32_t even = survivors[i].s[1];
+		if (verify_key(cuid, nonces, best_first_bytes, odd, even)) {
+			struct Crypto1State pcs;
+			pcs.odd = odd;
+			pcs.even = even;
+			lfsr_rollback_byte(&pcs, (cuid >> 24) ^ best_first_bytes[0], true);
+			crypto1_get_lfsr(&pcs, &key);
+			break;
+		}
+	}
+	free(survivors);
+
+	__sync_fetch_and_add(num_keys_tested, (uint64_t)num_odd * num_even);
+	*gpu_ok = true;
+	return key;
+}
@@ -0,0 +1,29 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Optional OpenCL GPU backend for the hardnested brute force phase.
+// Compiled only when the client is built with OPENCL=1.
+//-----------------------------------------------------------------------------
+
+#ifndef HARDNESTED_BF_OPENCL_H__
+#define HARDNESTED_BF_OPENCL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardnested_bruteforce.h"		// statelist_t, noncelist_t
+
+// true if a usable OpenCL GPU was found. The first call probes the platform
+// and compiles the kernel; set PM3_OPENCL=0 to force the CPU path.
+extern bool opencl_brute_force_available(void);
+
+// upload the test nonces for subsequent crack_states_opencl() calls
+extern void opencl_set_test_nonces(uint32_t nonces_to_bruteforce, uint32_t *bf_test_nonce, uint8_t *bf_test_nonce_par);
+
+// GPU implementation of crack_states_bitsliced() for one bucket. Sets
+// *gpu_ok to false if the GPU path failed mid-run, in which case the caller
+// should crack this bucket with the CPU implementation instead.
+extern const uint64_t crack_states_opencl(uint32_t cuid, uint8_t *best_first_bytes, statelist_t *p, uint32_t *keys_found, uint64_t *num_keys_tested, uint32_t nonces_to_bruteforce, uint8_t *bf_test_nonce_2nd_byte, noncelist_t *nonces, bool *gpu_ok);
+
+#endif
@@ -41,6 +41,7 @@
 #define COUNT_BITARRAY_AND2 count_bitarray_AND2_AVX512
 #define COUNT_BITARRAY_AND3 count_bitarray_AND3_AVX512
 #define COUNT_BITARRAY_AND4 count_bitarray_AND4_AVX512
+#define COUNT_BITARRAY_AND_SIZED count_bitarray_AND_sized_AVX512
 #elif defined (__AVX2__)
 #define MALLOC_BITARRAY malloc_bitarray_AVX2
 #define FREE_BITARRAY free_bitarray_AVX2
@@ -55,6 +56,7 @@
 #define COUNT_BITARRAY_AND2 count_bitarray_AND2_AVX2
 #define COUNT_BITARRAY_AND3 count_bitarray_AND3_AVX2
 #define COUNT_BITARRAY_AND4 count_bitarray_AND4_AVX2
+#define COUNT_BITARRAY_AND_SIZED count_bitarray_AND_sized_AVX2
 #elif defined (__AVX__)
 #define MALLOC_BITARRAY malloc_bitarray_AVX
 #define FREE_BITARRAY free_bitarray_AVX
@@ -69,6 +71,7 @@
 #define COUNT_BITARRAY_AND2 count_bitarray_AND2_AVX
 #define COUNT_BITARRAY_AND3 count_bitarray_AND3_AVX
 #define COUNT_BITARRAY_AND4 count_bitarray_AND4_AVX
+#define COUNT_BITARRAY_AND_SIZED count_bitarray_AND_sized_AVX
 #elif defined (__SSE2__)
 #define MALLOC_BITARRAY malloc_bitarray_SSE2
 #define FREE_BITARRAY free_bitarray_SSE2
@@ -83,6 +86,7 @@
 #define COUNT_BITARRAY_AND2 count_bitarray_AND2_SSE2
 #define COUNT_BITARRAY_AND3 count_bitarray_AND3_SSE2
 #define COUNT_BITARRAY_AND4 count_bitarray_AND4_SSE2
+#define COUNT_BITARRAY_AND_SIZED count_bitarray_AND_sized_SSE2
 #elif defined (__MMX__) 
 #define MALLOC_BITARRAY malloc_bitarray_MMX
 #define FREE_BITARRAY free_bitarray_MMX
@@ -97,6 +101,7 @@
 #define COUNT_BITARRAY_AND2 count_bitarray_AND2_MMX
 #define COUNT_BITARRAY_AND3 count_bitarray_AND3_MMX
 #define COUNT_BITARRAY_AND4 count_bitarray_AND4_MMX
+#define COUNT_BITARRAY_AND_SIZED count_bitarray_AND_sized_MMX
 #else
 #define MALLOC_BITARRAY malloc_bitarray_NOSIMD
 #define FREE_BITARRAY free_bitarray_NOSIMD
@@ -111,6 +116,7 @@
 #define COUNT_BITARRAY_AND2 count_bitarray_AND2_NOSIMD
 #define COUNT_BITARRAY_AND3 count_bitarray_AND3_NOSIMD
 #define COUNT_BITARRAY_AND4 count_bitarray_AND4_NOSIMD
+#define COUNT_BITARRAY_AND_SIZED count_bitarray_AND_sized_NOSIMD
 #endif
 
 
@@ -141,6 +147,8 @@ typedef uint32_t count_bitarray_AND3_t(uint32_t*, uint32_t*, uint32_t*);
 count_bitarray_AND3_t count_bitarray_AND3_AVX512, count_bitarray_AND3_AVX2, count_bitarray_AND3_AVX, count_bitarray_AND3_SSE2, count_bitarray_AND3_MMX, count_bitarray_AND3_NOSIMD, count_bitarray_AND3_dispatch;
 typedef uint32_t count_bitarray_AND4_t(uint32_t*, uint32_t*, uint32_t*, uint32_t*);
 count_bitarray_AND4_t count_bitarray_AND4_AVX512, count_bitarray_AND4_AVX2, count_bitarray_AND4_AVX, count_bitarray_AND4_SSE2, count_bitarray_AND4_MMX, count_bitarray_AND4_NOSIMD, count_bitarray_AND4_dispatch;
+typedef uint32_t count_bitarray_AND_sized_t(uint32_t*, uint32_t*, uint32_t);
+count_bitarray_AND_sized_t count_bitarray_AND_sized_AVX512, count_bitarray_AND_sized_AVX2, count_bitarray_AND_sized_AVX, count_bitarray_AND_sized_SSE2, count_bitarray_AND_sized_MMX, count_bitarray_AND_sized_NOSIMD, count_bitarray_AND_sized_dispatch;
 
 
 inline uint32_t *MALLOC_BITARRAY(uint32_t x)
@@ -222,6 +230,48 @@ inline uint32_t COUNT_BITARRAY_AND(uint32_t *restrict A, uint32_t *restrict B)
 }
 
 
+// Size-specialized variant of COUNT_BITARRAY_AND for statelists whose
+// surviving states all fall within the first <words> words: everything beyond
+// is already zero in A and needs neither reading nor clearing. One case per
+// power-of-two trimmed width keeps the trip count a compile time constant, so
+// the compiler vectorizes each specialization without a scalar tail. Any other
+// width falls through to the full-size loop.
+#define COUNT_AND_SIZED_CASE(w) \
+	case (w): \
+		for (uint32_t i = 0; i < (w); i++) { \
+			A[i] &= B[i]; \
+			count += BITCOUNT(A[i]); \
+		} \
+		break
+
+inline uint32_t COUNT_BITARRAY_AND_SIZED(uint32_t *restrict A, uint32_t *restrict B, uint32_t words)
+{
+	A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
+	B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
+	uint32_t count = 0;
+	switch (words) {
+		COUNT_AND_SIZED_CASE(1<<10);
+		COUNT_AND_SIZED_CASE(1<<11);
+		COUNT_AND_SIZED_CASE(1<<12);
+		COUNT_AND_SIZED_CASE(1<<13);
+		COUNT_AND_SIZED_CASE(1<<14);
+		COUNT_AND_SIZED_CASE(1<<15);
+		COUNT_AND_SIZED_CASE(1<<16);
+		COUNT_AND_SIZED_CASE(1<<17);
+		COUNT_AND_SIZED_CASE(1<<18);
+		default:
+			for (uint32_t i = 0; i < (1<<19); i++) {
+				A[i] &= B[i];
+				count += BITCOUNT(A[i]);
+			}
+			break;
+	}
+	return count;
+}
+
+#undef COUNT_AND_SIZED_CASE
+
+
 inline uint32_t COUNT_BITARRAY_LOW20_AND(uint32_t *restrict A, uint32_t *restrict B)
 {
 	uint16_t *a = (uint16_t *)__builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
@@ -315,6 +365,7 @@ bitarray_OR_t *bitarray_OR_function_p = &bitarray_OR_dispatch;
 count_bitarray_AND2_t *count_bitarray_AND2_function_p = &count_bitarray_AND2_dispatch;
 count_bitarray_AND3_t *count_bitarray_AND3_function_p = &count_bitarray_AND3_dispatch;
 count_bitarray_AND4_t *count_bitarray_AND4_function_p = &count_bitarray_AND4_dispatch;
+count_bitarray_AND_sized_t *count_bitarray_AND_sized_function_p = &count_bitarray_AND_sized_dispatch;
 
 // determine the available instruction set at runtime and call the correct function
 uint32_t *malloc_bitarray_dispatch(uint32_t x) {
@@ -591,6 +642,28 @@ uint32_t count_bitarray_AND4_dispatch(uint32_t *A, uint32_t *B, uint32_t *C, uin
 }
 
 
+uint32_t count_bitarray_AND_sized_dispatch(uint32_t *A, uint32_t *B, uint32_t words) {
+#if defined (__i386__) || defined (__x86_64__)
+	#if !defined(__APPLE__) || (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1))
+		#if (__GNUC__ >= 5) && (__GNUC__ > 5 || __GNUC_MINOR__ > 2)
+	if (__builtin_cpu_supports("avx512f")) count_bitarray_AND_sized_function_p = &count_bitarray_AND_sized_AVX512;
+	else if (__builtin_cpu_supports("avx2")) count_bitarray_AND_sized_function_p = &count_bitarray_AND_sized_AVX2;
+		#else
+	if (__builtin_cpu_supports("avx2")) count_bitarray_AND_sized_function_p = &count_bitarray_AND_sized_AVX2;
+		#endif
+	else if (__builtin_cpu_supports("avx")) count_bitarray_AND_sized_function_p = &count_bitarray_AND_sized_AVX;
+	else if (__builtin_cpu_supports("sse2")) count_bitarray_AND_sized_function_p = &count_bitarray_AND_sized_SSE2;
+	else if (__builtin_cpu_supports("mmx")) count_bitarray_AND_sized_function_p = &count_bitarray_AND_sized_MMX;
+	else
+	#endif
+#endif
+		count_bitarray_AND_sized_function_p = &count_bitarray_AND_sized_NOSIMD;
+
+    // call the most optimized function for this CPU
+    return (*count_bitarray_AND_sized_function_p)(A, B, words);
+}
+
+
 ///////////////////////////////////////////////77
 // Entries to dispatched function calls
 
@@ -646,5 +719,24 @@ uint32_t count_bitarray_AND4(uint32_t *A, uint32_t *B, uint32_t *C, uint32_t *D)
     return (*count_bitarray_AND4_function_p)(A, B, C, D);
 }
 
+uint32_t count_bitarray_AND_sized(uint32_t *A, uint32_t *B, uint32_t words) {
+    return (*count_bitarray_AND_sized_function_p)(A, B, words);
+}
+
+// Smallest power-of-two word count (at least 1<<10) covering all set bits of
+// A. The result is a valid <words> argument for count_bitarray_AND_sized()
+// with A as first operand, and stays valid as long as A only ever loses bits.
+uint32_t bitarray_trimmed_wordcount(uint32_t *A) {
+	uint32_t hi = (1<<19);
+	while (hi > 0 && A[hi-1] == 0) {
+		hi--;
+	}
+	uint32_t words = (1<<10);
+	while (words < hi) {
+		words <<= 1;
+	}
+	return words;
+}
+
 #endif
 
@@ -65,5 +65,7 @@ extern void bitarray_OR(uint32_t *A, uint32_t *B);
 extern uint32_t count_bitarray_AND2(uint32_t *A, uint32_t *B);
 extern uint32_t count_bitarray_AND3(uint32_t *A, uint32_t *B, uint32_t *C);
 extern uint32_t count_bitarray_AND4(uint32_t *A, uint32_t *B, uint32_t *C, uint32_t *D);
+extern uint32_t count_bitarray_AND_sized(uint32_t *A, uint32_t *B, uint32_t words);
+extern uint32_t bitarray_trimmed_wordcount(uint32_t *A);
 
 #endif
@@ -47,6 +47,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE				// for pthread_setaffinity_np()
+#endif
+
 #include "hardnested_bruteforce.h"
 
 #include <inttypes.h>
@@ -55,6 +59,9 @@ THE SOFTWARE.
 #include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
 #include "proxmark3.h"
 #include "cmdhfmfhard.h"
 #include "hardnested_bf_core.h"
@@ -85,9 +92,110 @@ static uint8_t bf_test_nonce_2nd_byte[256];
 static uint8_t bf_test_nonce_par[256];
 static uint32_t bucket_count = 0;
 static statelist_t* buckets[128];
+static uint32_t next_bucket = 0;
 static uint32_t keys_found = 0;
 static uint64_t num_keys_tested;
 
+// the key of the last successful search, for the caller to log/persist
+uint64_t hardnested_found_key = 0;
+
+
+// Optional NUMA-aware thread pinning, enabled with PM3_HARDNESTED_PIN=1.
+// On multi socket machines the scheduler migrates worker threads between
+// nodes while their statelists stay on the node that first touched them,
+// and the resulting cross-node traffic makes run times vary wildly. Pinning
+// the workers round-robin over the online CPUs spreads them over all nodes
+// and keeps each worker next to the memory it allocates. Off by default -
+// pinned CPUs fight any other load on the machine.
+void hardnested_pin_thread(pthread_t thread, uint32_t thread_index)
+{
+#if defined(__linux__)
+	static int enabled = -1;
+	if (enabled == -1) {
+		char *env = getenv("PM3_HARDNESTED_PIN");
+		enabled = (env != NULL && env[0] != '\0' && env[0] != '0');
+	}
+	if (enabled) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(thread_index % num_CPUs(), &cpus);
+		pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpus);
+	}
+#else
+	(void)thread;
+	(void)thread_index;
+#endif
+}
+
+// Brute force checkpointing. Long cracks can be resumed after a client crash
+// or USB drop: every completed bucket is recorded in a small progress file,
+// keyed by a fingerprint of the search. Statelist generation from a saved
+// nonce file is deterministic, so on resume (hf mf hardnested ... r) the
+// bucket list is reproduced and already-searched buckets are skipped.
+#define CHECKPOINT_FILE		"hardnested_resume.bin"
+#define CHECKPOINT_MAGIC	0x72666268	// "hbfr"
+
+typedef struct {
+	uint32_t magic;
+	uint32_t cuid;
+	uint32_t num_acquired_nonces;
+	uint64_t maximum_states;
+	uint8_t bucket_done[sizeof(buckets) / sizeof(buckets[0]) / 8];
+} bf_checkpoint_t;
+
+static bf_checkpoint_t checkpoint;
+static bool checkpoint_enabled = false;
+static pthread_mutex_t checkpoint_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void checkpoint_bucket_completed(uint32_t bucket)
+{
+	if (!checkpoint_enabled) {
+		return;
+	}
+	pthread_mutex_lock(&checkpoint_mutex);
+	checkpoint.bucket_done[bucket >> 3] |= 1 << (bucket & 7);
+	FILE *checkpoint_file = fopen(CHECKPOINT_FILE ".tmp", "wb");
+	if (checkpoint_file != NULL) {
+		bool ok = (fwrite(&checkpoint, sizeof(checkpoint), 1, checkpoint_file) == 1);
+		fclose(checkpoint_file);
+		// atomic rename - a crash mid-write must not corrupt the checkpoint
+		if (!ok || rename(CHECKPOINT_FILE ".tmp", CHECKPOINT_FILE) != 0) {
+			remove(CHECKPOINT_FILE ".tmp");
+		}
+	}
+	pthread_mutex_unlock(&checkpoint_mutex);
+}
+
+
+// Returns the number of buckets which a previous, interrupted run of the
+// same search already completed.
+static uint32_t checkpoint_resume(void)
+{
+	FILE *checkpoint_file = fopen(CHECKPOINT_FILE, "rb");
+	if (checkpoint_file == NULL) {
+		return 0;
+	}
+	bf_checkpoint_t old_checkpoint;
+	bool ok = (fread(&old_checkpoint, sizeof(old_checkpoint), 1, checkpoint_file) == 1);
+	fclose(checkpoint_file);
+	if (!ok
+			|| old_checkpoint.magic != CHECKPOINT_MAGIC
+			|| old_checkpoint.cuid != checkpoint.cuid
+			|| old_checkpoint.num_acquired_nonces != checkpoint.num_acquired_nonces
+			|| old_checkpoint.maximum_states != checkpoint.maximum_states) {
+		return 0;	// checkpoint belongs to a different search
+	}
+	memcpy(checkpoint.bucket_done, old_checkpoint.bucket_done, sizeof(checkpoint.bucket_done));
+	uint32_t completed = 0;
+	for (uint32_t bucket = 0; bucket < bucket_count; bucket++) {
+		if (checkpoint.bucket_done[bucket >> 3] & (1 << (bucket & 7))) {
+			completed++;
+		}
+	}
+	return completed;
+}
+
 
 uint8_t trailing_zeros(uint8_t byte) 
 {
@@ -158,9 +266,17 @@ crack_states_thread(void* x){
 	} *thread_arg;
 
 	thread_arg = (struct arg *)x;
+#if defined (DEBUG_BRUTE_FORCE)
     const int thread_id = thread_arg->thread_ID;
-    uint32_t current_bucket = thread_id;
-    while(current_bucket < bucket_count){
+#endif
+    // claim buckets dynamically: bucket density varies a lot, so a static
+    // round-robin assignment leaves threads idle through the tail of the
+    // search while a straggler grinds its dense buckets
+    uint32_t current_bucket;
+    while((current_bucket = __sync_fetch_and_add(&next_bucket, 1)) < bucket_count){
+        if (checkpoint.bucket_done[current_bucket >> 3] & (1 << (current_bucket & 7))) {
+            continue;   // already searched by an interrupted previous run
+        }
         statelist_t *bucket = buckets[current_bucket];
         if(bucket){
 #if defined (DEBUG_BRUTE_FORCE)	
@@ -169,6 +285,7 @@ crack_states_thread(void* x){
             const uint64_t key = crack_states_bitsliced(thread_arg->cuid, thread_arg->best_first_bytes, bucket, &keys_found, &num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, thread_arg->nonces);
             if(key != -1){
                 __sync_fetch_and_add(&keys_found, 1);
+                hardnested_found_key = key;
 				char progress_text[80];
 				sprintf(progress_text, "Brute force phase completed. Key found: %012" PRIx64, key);
 				hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, 0.0, 0);
@@ -176,6 +293,7 @@ crack_states_thread(void* x){
             } else if(keys_found){
                 break;
             } else {
+				checkpoint_bucket_completed(current_bucket);
 				if (!thread_arg->silent) {
 					char progress_text[80];
 					sprintf(progress_text, "Brute force phase: %6.02f%%", 100.0*(float)num_keys_tested/(float)(thread_arg->maximum_states));
@@ -184,7 +302,6 @@ crack_states_thread(void* x){
 				}
             }
         }
-        current_bucket += NUM_BRUTE_FORCE_THREADS;
     }
     return NULL;
 }
@@ -301,6 +418,17 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
 	
 	keys_found = 0;
 	num_keys_tested = 0;
+	next_bucket = 0;
+	hardnested_found_key = 0;
+
+	memset(&checkpoint, 0, sizeof(checkpoint));
+	checkpoint_enabled = (nonces != NULL);	// never checkpoint the benchmark run
+	if (checkpoint_enabled) {
+		checkpoint.magic = CHECKPOINT_MAGIC;
+		checkpoint.cuid = cuid;
+		checkpoint.num_acquired_nonces = num_acquired_nonces;
+		checkpoint.maximum_states = maximum_states;
+	}
 
 	bitslice_test_nonces(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
 	
@@ -313,6 +441,15 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
 		}
 	}
 
+	if (checkpoint_enabled) {
+		uint32_t completed = checkpoint_resume();
+		if (completed) {
+			char progress_text[80];
+			sprintf(progress_text, "Resuming brute force: %u of %u buckets already searched", completed, bucket_count);
+			hardnested_print_progress(num_acquired_nonces, progress_text, 0.0, 0);
+		}
+	}
+
 	uint64_t start_time = msclock();
 	// enumerate states using all hardware threads, each thread handles one bucket
 	// if (!silent) {
@@ -343,11 +480,20 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
 		thread_args[i].nonces = nonces;
 		thread_args[i].best_first_bytes = best_first_bytes;
 		pthread_create(&threads[i], NULL, crack_states_thread, (void*)&thread_args[i]);
+		hardnested_pin_thread(threads[i], i);
 	}
 	for(uint32_t i = 0; i < NUM_BRUTE_FORCE_THREADS; i++){
 		pthread_join(threads[i], 0);
 	}
 
+	if (checkpoint_enabled) {
+		// search finished (key found or buckets exhausted) - either way the
+		// checkpoint is stale: an exhausted search continues with more nonces
+		// and therefore a different fingerprint
+		remove(CHECKPOINT_FILE);
+		checkpoint_enabled = false;
+	}
+
 	uint64_t elapsed_time = msclock() - start_time;
 
 	// if (!silent) {
@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include "cmdhfmfhard.h"
 
 typedef struct {
@@ -27,6 +28,8 @@ typedef struct {
 	void* next;
 } statelist_t;
 
+extern uint64_t hardnested_found_key;	// key of the last successful brute force
+extern void hardnested_pin_thread(pthread_t thread, uint32_t thread_index);
 extern void prepare_bf_test_nonces(noncelist_t *nonces, uint8_t best_first_byte);
 extern bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint32_t num_acquired_nonces, uint64_t maximum_states, noncelist_t *nonces, uint8_t *best_first_bytes);
 extern float brute_force_benchmark();
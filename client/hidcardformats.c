@@ -508,27 +508,54 @@ bool Unpack_C1k48s(/*in*/hidproxmessage_t* packed, /*out*/hidproxcard_t* card){
 }
 
 static const hidcardformat_t FormatTable[] = {
-    {"H10301", Pack_H10301, Unpack_H10301, "HID H10301 26-bit", {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"Tecom27", Pack_Tecom27, Unpack_Tecom27, "Tecom 27-bit", {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"2804W", Pack_2804W, Unpack_2804W, "2804 Wiegand", {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"ATSW30", Pack_ATSW30, Unpack_ATSW30, "ATS Wiegand 30-bit", {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"ADT31", Pack_ADT31, Unpack_ADT31, "HID ADT 31-bit", {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"Kastle", Pack_Kastle, Unpack_Kastle, "Kastle 32-bit", {1, 1, 1, 0, 1}}, // from @xilni; PR #23 on RfidResearchGroup/proxmark3
-    {"D10202", Pack_D10202, Unpack_D10202, "HID D10202 33-bit", {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"H10306", Pack_H10306, Unpack_H10306, "HID H10306 34-bit", {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"N10002", Pack_N10002, Unpack_N10002, "HID N10002 34-bit", {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"C1k35s", Pack_C1k35s, Unpack_C1k35s, "HID Corporate 1000 35-bit standard layout", {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"C15001", Pack_C15001, Unpack_C15001, "HID KeySpan 36-bit", {1, 1, 0, 1, 1}}, // from Proxmark forums
-    {"S12906", Pack_S12906, Unpack_S12906, "HID Simplex 36-bit", {1, 1, 1, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"Sie36", Pack_Sie36, Unpack_Sie36, "HID 36-bit Siemens", {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"H10320", Pack_H10320, Unpack_H10320, "HID H10320 36-bit BCD", {1, 0, 0, 0, 1}}, // from Proxmark forums
-    {"H10302", Pack_H10302, Unpack_H10302, "HID H10302 37-bit huge ID", {1, 0, 0, 0, 1}}, // from Proxmark forums
-    {"H10304", Pack_H10304, Unpack_H10304, "HID H10304 37-bit", {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"P10001", Pack_P10001, Unpack_P10001, "HID P10001 Honeywell 40-bit"}, // from cardinfo.barkweb.com.au
-    {"C1k48s", Pack_C1k48s, Unpack_C1k48s, "HID Corporate 1000 48-bit standard layout", {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {NULL, NULL, NULL, NULL, {0, 0, 0, 0, 0}} // Must null terminate array
+    {"H10301", Pack_H10301, Unpack_H10301, "HID H10301 26-bit", 26, {1, 1, 0, 0, 1}}, // imported from old pack/unpack
+    {"Tecom27", Pack_Tecom27, Unpack_Tecom27, "Tecom 27-bit", 27, {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
+    {"2804W", Pack_2804W, Unpack_2804W, "2804 Wiegand", 28, {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
+    {"ATSW30", Pack_ATSW30, Unpack_ATSW30, "ATS Wiegand 30-bit", 30, {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
+    {"ADT31", Pack_ADT31, Unpack_ADT31, "HID ADT 31-bit", 31, {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
+    {"Kastle", Pack_Kastle, Unpack_Kastle, "Kastle 32-bit", 32, {1, 1, 1, 0, 1}}, // from @xilni; PR #23 on RfidResearchGroup/proxmark3
+    {"D10202", Pack_D10202, Unpack_D10202, "HID D10202 33-bit", 33, {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
+    {"H10306", Pack_H10306, Unpack_H10306, "HID H10306 34-bit", 34, {1, 1, 0, 0, 1}}, // imported from old pack/unpack
+    {"N10002", Pack_N10002, Unpack_N10002, "HID N10002 34-bit", 34, {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
+    {"C1k35s", Pack_C1k35s, Unpack_C1k35s, "HID Corporate 1000 35-bit standard layout", 35, {1, 1, 0, 0, 1}}, // imported from old pack/unpack
+    {"C15001", Pack_C15001, Unpack_C15001, "HID KeySpan 36-bit", 36, {1, 1, 0, 1, 1}}, // from Proxmark forums
+    {"S12906", Pack_S12906, Unpack_S12906, "HID Simplex 36-bit", 36, {1, 1, 1, 0, 1}}, // from cardinfo.barkweb.com.au
+    {"Sie36", Pack_Sie36, Unpack_Sie36, "HID 36-bit Siemens", 36, {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
+    {"H10320", Pack_H10320, Unpack_H10320, "HID H10320 36-bit BCD", 36, {1, 0, 0, 0, 1}}, // from Proxmark forums
+    {"H10302", Pack_H10302, Unpack_H10302, "HID H10302 37-bit huge ID", 37, {1, 0, 0, 0, 1}}, // from Proxmark forums
+    {"H10304", Pack_H10304, Unpack_H10304, "HID H10304 37-bit", 37, {1, 1, 0, 0, 1}}, // imported from old pack/unpack
+    {"P10001", Pack_P10001, Unpack_P10001, "HID P10001 Honeywell 40-bit", 40}, // from cardinfo.barkweb.com.au
+    {"C1k48s", Pack_C1k48s, Unpack_C1k48s, "HID Corporate 1000 48-bit standard layout", 48, {1, 1, 0, 0, 1}}, // imported from old pack/unpack
+    {NULL, NULL, NULL, NULL, 0, {0, 0, 0, 0, 0}} // Must null terminate array
 };
 
+// Candidate index over FormatTable: for every message length a bitmask of
+// the formats declaring that length, built once on first use. Every Unpack
+// starts with its own length check anyway, so skipping the wrong-length
+// entries up front changes nothing but the work done per read.
+#define HID_MAX_FORMAT_BITS 96
+
+static uint32_t formatCandidates[HID_MAX_FORMAT_BITS + 1];
+static bool formatIndexBuilt = false;
+
+// last format that unpacked with valid parity; badge streams read the same
+// format over and over, so it gets resolved first on the next read
+static int sessionFormat = -1;
+
+static void HIDBuildFormatIndex(){
+  for (int i = 0; FormatTable[i].Name; ++i){
+    if (FormatTable[i].Bits <= HID_MAX_FORMAT_BITS)
+      formatCandidates[FormatTable[i].Bits] |= 1ul << i;
+  }
+  formatIndexBuilt = true;
+}
+
+static bool HIDUnpackMatches(int idx, /* in */hidproxmessage_t* packed, /* in */bool ignoreParity, /* out */hidproxcard_t* card){
+  if (!FormatTable[idx].Unpack(packed, card))
+    return false;
+  return ignoreParity || !FormatTable[idx].Fields.hasParity || card->ParityValid;
+}
+
 void HIDListFormats(){
   if (FormatTable[0].Name == NULL)
     return;
@@ -586,24 +613,44 @@ void HIDDisplayUnpackedCard(hidproxcard_t* card, const hidcardformat_t format){
 }
 
 bool HIDTryUnpack(/* in */hidproxmessage_t* packed, /* in */bool ignoreParity){
-  if (FormatTable[0].Name == NULL) 
+  if (FormatTable[0].Name == NULL)
     return false;
-    
+  if (!formatIndexBuilt)
+    HIDBuildFormatIndex();
+
+  uint32_t candidates = (packed->Length <= HID_MAX_FORMAT_BITS)
+    ? formatCandidates[packed->Length] : 0;
+
   bool result = false;
-  int i = 0;
   hidproxcard_t card;
   memset(&card, 0, sizeof(hidproxcard_t));
-  while (FormatTable[i].Name)
+
+  // the session winner goes first, so repeated reads of the same badge
+  // type print their match without waiting on the remaining candidates
+  if (sessionFormat >= 0 && (candidates & (1ul << sessionFormat))){
+    candidates &= ~(1ul << sessionFormat);
+    if (HIDUnpackMatches(sessionFormat, packed, ignoreParity, &card)){
+      PrintAndLog("--------------------------------------------------");
+      result = true;
+      HIDDisplayUnpackedCard(&card, FormatTable[sessionFormat]);
+      PrintAndLog("--------------------------------------------------");
+    } else {
+      sessionFormat = -1; // different badge - let the scan pick a new winner
+    }
+  }
+
+  for (int i = 0; FormatTable[i].Name; ++i)
   {
-    if (FormatTable[i].Unpack(packed, &card)){
-      if (ignoreParity || !FormatTable[i].Fields.hasParity || card.ParityValid){
-        if (!result) PrintAndLog("--------------------------------------------------");
-        result = true;
-        HIDDisplayUnpackedCard(&card, FormatTable[i]);
-        PrintAndLog("--------------------------------------------------");
-      }
+    if (!(candidates & (1ul << i)))
+      continue;
+    if (HIDUnpackMatches(i, packed, ignoreParity, &card)){
+      if (!result) PrintAndLog("--------------------------------------------------");
+      result = true;
+      if (sessionFormat < 0 && FormatTable[i].Fields.hasParity && card.ParityValid)
+        sessionFormat = i;
+      HIDDisplayUnpackedCard(&card, FormatTable[i]);
+      PrintAndLog("--------------------------------------------------");
     }
-    ++i;
   }
   return result;
 }
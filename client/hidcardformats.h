@@ -30,6 +30,7 @@ typedef struct hidcardformat_s{
   bool (*Pack)(/*in*/hidproxcard_t* card, /*out*/hidproxmessage_t* packed);
   bool (*Unpack)(/*in*/hidproxmessage_t* packed, /*out*/hidproxcard_t* card);
   const char* Descrp;
+  uint8_t Bits; // message length the format packs to, keyed by the unpack candidate index
   hidcardformatdescriptor_t Fields;
 } hidcardformat_t;
 
@@ -0,0 +1,280 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Multithreaded bitsliced Hitag2 key search from sniffed authentications
+//
+// A reader authentication carries {nR, aR} where aR is 0xFFFFFFFF encrypted
+// with the keystream derived from (key, uid, nR). Testing a candidate key
+// against one pair is a pure keystream match, so 64 candidates are evaluated
+// per machine word: every cipher state bit becomes a 64-lane word and the
+// filter function runs as boolean algebra over whole words, which the
+// compiler is free to vectorize further. The window is sliced over the
+// shared client worker pool.
+//-----------------------------------------------------------------------------
+
+#include "hitag2crack.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "workqueue.h"
+
+/* Following is a modified version of cryptolib.com/ciphers/hitag2/ */
+// Software optimized 48-bit Philips/NXP Mifare Hitag2 PCF7936/46/47/52 stream cipher algorithm by I.C. Wiener 2006-2007.
+// For educational purposes only.
+// No warranties or guarantees of any kind.
+// This code is released into the public domain by its author.
+
+#define i4(x,a,b,c,d)    ((uint32_t)((((x)>>(a))&1)+(((x)>>(b))&1)*2+(((x)>>(c))&1)*4+(((x)>>(d))&1)*8))
+
+static const uint32_t ht2_f4a = 0x2C79;      // 0010 1100 0111 1001
+static const uint32_t ht2_f4b = 0x6671;      // 0110 0110 0111 0001
+static const uint32_t ht2_f5c = 0x7907287B;  // 0111 1001 0000 0111 0010 1000 0111 1011
+
+static uint32_t _f20(const uint64_t x) {
+	uint32_t i5;
+
+	i5 = ((ht2_f4a >> i4(x, 1, 2, 4, 5)) & 1) * 1
+		+ ((ht2_f4b >> i4(x, 7,11,13,14)) & 1) * 2
+		+ ((ht2_f4b >> i4(x,16,20,22,25)) & 1) * 4
+		+ ((ht2_f4b >> i4(x,27,28,30,32)) & 1) * 8
+		+ ((ht2_f4a >> i4(x,33,42,43,45)) & 1) * 16;
+
+	return (ht2_f5c >> i5) & 1;
+}
+
+static uint64_t _hitag2_init(const uint64_t key, const uint32_t serial, const uint32_t IV) {
+	uint32_t i;
+	uint64_t x = ((key & 0xFFFF) << 32) + serial;
+
+	for (i = 0; i < 32; i++) {
+		x >>= 1;
+		x += (uint64_t)(_f20(x) ^ (((IV >> i) ^ (key >> (i+16))) & 1)) << 47;
+	}
+	return x;
+}
+
+static uint64_t _hitag2_round(uint64_t *state) {
+	uint64_t x = *state;
+
+	x = (x >>  1) +
+		((((x >>  0) ^ (x >>  2) ^ (x >>  3) ^ (x >>  6)
+		   ^ (x >>  7) ^ (x >>  8) ^ (x >> 16) ^ (x >> 22)
+		   ^ (x >> 23) ^ (x >> 26) ^ (x >> 30) ^ (x >> 41)
+		   ^ (x >> 42) ^ (x >> 43) ^ (x >> 46) ^ (x >> 47)) & 1) << 47);
+
+	*state = x;
+	return _f20(x);
+}
+
+// The cipher consumes key, serial and IV bit-reversed compared to the byte
+// order they travel over the air in (cf. the REV32/REV64 calls in
+// armsrc/hitag2.c).
+static uint32_t rev32(uint32_t v) {
+	uint32_t r = 0;
+	for (int i = 0; i < 32; i++)
+		r |= ((v >> i) & 1) << (31 - i);
+	return r;
+}
+
+static uint64_t rev48(uint64_t v) {
+	uint64_t r = 0;
+	for (int i = 0; i < 48; i++)
+		r |= ((v >> i) & 1) << (47 - i);
+	return r;
+}
+
+// aR a genuine reader with this key would send for (uid, nR), wire order
+uint32_t hitag2crack_ar(uint64_t key, uint32_t uid, uint32_t nr) {
+	uint64_t state = _hitag2_init(rev48(key), rev32(uid), rev32(nr));
+	uint32_t ks = 0;
+	for (int i = 0; i < 32; i++)
+		ks = (ks << 1) | (uint32_t)_hitag2_round(&state);
+	return ~ks;
+}
+
+//-----------------------------------------------------------------------------
+// bitsliced evaluation: one uint64_t per cipher state bit, one lane per
+// candidate key
+//-----------------------------------------------------------------------------
+
+// lane l differs from the batch base in the low six key bits: bit n of the
+// lane number selects key bit n
+static const uint64_t bs_lane[6] = {
+	0xAAAAAAAAAAAAAAAAULL,
+	0xCCCCCCCCCCCCCCCCULL,
+	0xF0F0F0F0F0F0F0F0ULL,
+	0xFF00FF00FF00FF00ULL,
+	0xFFFF0000FFFF0000ULL,
+	0xFFFFFFFF00000000ULL
+};
+
+// lookup table output for 64 lanes at once, as the sum of the table's minterms
+static uint64_t bs_lut4(uint32_t table, uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+	uint64_t r = 0;
+	for (uint32_t m = 0; m < 16; m++) {
+		if ((table >> m) & 1)
+			r |= ((m & 1) ? a : ~a) & ((m & 2) ? b : ~b) & ((m & 4) ? c : ~c) & ((m & 8) ? d : ~d);
+	}
+	return r;
+}
+
+static uint64_t bs_lut5(uint32_t table, uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e) {
+	uint64_t r = 0;
+	for (uint32_t m = 0; m < 32; m++) {
+		if ((table >> m) & 1)
+			r |= ((m & 1) ? a : ~a) & ((m & 2) ? b : ~b) & ((m & 4) ? c : ~c) & ((m & 8) ? d : ~d) & ((m & 16) ? e : ~e);
+	}
+	return r;
+}
+
+// the input indices mirror the i4() calls in _f20 above
+static uint64_t bs_f20(const uint64_t *s) {
+	uint64_t a = bs_lut4(ht2_f4a, s[ 1], s[ 2], s[ 4], s[ 5]);
+	uint64_t b = bs_lut4(ht2_f4b, s[ 7], s[11], s[13], s[14]);
+	uint64_t c = bs_lut4(ht2_f4b, s[16], s[20], s[22], s[25]);
+	uint64_t d = bs_lut4(ht2_f4b, s[27], s[28], s[30], s[32]);
+	uint64_t e = bs_lut4(ht2_f4a, s[33], s[42], s[43], s[45]);
+	return bs_lut5(ht2_f5c, a, b, c, d, e);
+}
+
+// Tests the 64 keys (base | lane) against one sniffed pair and returns the
+// mask of lanes whose keystream matches. base, uid, nr, ar in wire order.
+static uint64_t hitag2crack_batch(uint64_t base, uint32_t uid, uint32_t nr, uint32_t ar) {
+	uint64_t s[48];
+	uint64_t keyw[48];
+	int i;
+
+	// cipher-domain key bit i is wire-order key bit (47 - i); the six
+	// lowest wire-order bits vary across the lanes
+	for (i = 0; i < 48; i++) {
+		int u = 47 - i;
+		keyw[i] = (u < 6) ? bs_lane[u] : (((base >> u) & 1) ? ~0ULL : 0ULL);
+	}
+
+	// x = ((key & 0xFFFF) << 32) + serial
+	for (i = 0; i < 32; i++)
+		s[i] = ((uid >> (31 - i)) & 1) ? ~0ULL : 0ULL;
+	for (i = 0; i < 16; i++)
+		s[32 + i] = keyw[i];
+
+	// 32 initialisation rounds folding in the IV and the upper key bits.
+	// The filter taps reach no further than bit 45, so the stale top word
+	// left by the shift is harmless.
+	for (i = 0; i < 32; i++) {
+		memmove(s, s + 1, 47 * sizeof(uint64_t));
+		uint64_t in = ((nr >> (31 - i)) & 1) ? ~0ULL : 0ULL;
+		s[47] = bs_f20(s) ^ in ^ keyw[16 + i];
+	}
+
+	// 32 keystream bits against aR (the reader encrypts 0xFFFFFFFF)
+	uint64_t alive = ~0ULL;
+	for (i = 0; i < 32 && alive; i++) {
+		uint64_t fb = s[0] ^ s[2] ^ s[3] ^ s[6] ^ s[7] ^ s[8] ^ s[16] ^ s[22]
+			^ s[23] ^ s[26] ^ s[30] ^ s[41] ^ s[42] ^ s[43] ^ s[46] ^ s[47];
+		memmove(s, s + 1, 47 * sizeof(uint64_t));
+		s[47] = fb;
+		uint64_t want = ((~ar >> (31 - i)) & 1) ? ~0ULL : 0ULL;
+		alive &= ~(bs_f20(s) ^ want);
+	}
+	return alive;
+}
+
+//-----------------------------------------------------------------------------
+// worker pool plumbing
+//-----------------------------------------------------------------------------
+
+typedef struct {
+	hitag2crack_t *job;
+	uint64_t prefix;		// keystart with the window bits cleared
+	uint64_t lanemask;		// valid lanes for windows narrower than 6 bits
+	volatile bool stop;
+	pthread_mutex_t lock;
+} crack_ctx_t;
+
+typedef struct {
+	crack_ctx_t *ctx;
+	uint64_t first;			// batch counter range (keys >> 6)
+	uint64_t last;
+} crack_slice_t;
+
+static void crack_record(crack_ctx_t *ctx, uint64_t key, bool verified) {
+	pthread_mutex_lock(&ctx->lock);
+	hitag2crack_t *job = ctx->job;
+	if (job->num_candidates < HITAG2CRACK_MAX_CANDIDATES)
+		job->candidates[job->num_candidates++] = key;
+	if (verified) {
+		job->candidates[0] = key;
+		job->verified = true;
+		ctx->stop = true;
+	}
+	pthread_mutex_unlock(&ctx->lock);
+}
+
+static void crack_worker(void *arg) {
+	crack_slice_t *slice = (crack_slice_t *)arg;
+	crack_ctx_t *ctx = slice->ctx;
+	hitag2crack_t *job = ctx->job;
+
+	for (uint64_t c = slice->first; c < slice->last && !ctx->stop; c++) {
+		uint64_t base = ctx->prefix | (c << 6);
+		uint64_t alive = hitag2crack_batch(base, job->uid, job->nr, job->ar) & ctx->lanemask;
+
+		while (alive) {
+			uint64_t key = base | (uint64_t)__builtin_ctzll(alive);
+			alive &= alive - 1;
+
+			// re-check in the scalar cipher, then against the second pair
+			if (hitag2crack_ar(key, job->uid, job->nr) != job->ar)
+				continue;
+			bool verified = (job->nr2 || job->ar2)
+				&& hitag2crack_ar(key, job->uid, job->nr2) == job->ar2;
+			crack_record(ctx, key, verified);
+		}
+	}
+}
+
+bool hitag2crack_run(hitag2crack_t *job) {
+
+	job->num_candidates = 0;
+	job->verified = false;
+
+	if (job->bits < 1 || job->bits > 48)
+		return false;
+
+	crack_ctx_t ctx = {
+		.job = job,
+		.prefix = (job->bits == 48) ? 0 : (job->keystart & ~((1ULL << job->bits) - 1)),
+		.lanemask = (job->bits >= 6) ? ~0ULL : ((1ULL << (1u << job->bits)) - 1),
+		.stop = false,
+	};
+	pthread_mutex_init(&ctx.lock, NULL);
+
+	uint64_t batches = (job->bits > 6) ? (1ULL << (job->bits - 6)) : 1;
+
+	// a handful of slices per worker keeps the finish balanced and the
+	// early-out on a verified key responsive
+	uint64_t num_slices = (uint64_t)workqueue_num_workers() * 16;
+	if (num_slices > batches)
+		num_slices = batches;
+
+	crack_slice_t *slices = calloc(num_slices, sizeof(crack_slice_t));
+	if (!slices) {
+		pthread_mutex_destroy(&ctx.lock);
+		return false;
+	}
+
+	for (uint64_t i = 0; i < num_slices; i++) {
+		slices[i].ctx = &ctx;
+		slices[i].first = batches * i / num_slices;
+		slices[i].last = batches * (i + 1) / num_slices;
+		workqueue_submit(crack_worker, &slices[i]);
+	}
+	workqueue_join();
+
+	free(slices);
+	pthread_mutex_destroy(&ctx.lock);
+	return job->num_candidates > 0;
+}
@@ -0,0 +1,36 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Multithreaded bitsliced Hitag2 key search from sniffed authentications
+//-----------------------------------------------------------------------------
+
+#ifndef HITAG2CRACK_H__
+#define HITAG2CRACK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HITAG2CRACK_MAX_CANDIDATES 32
+
+typedef struct {
+	// inputs, all in the byte order they appear on the wire / in 'lf hitag reader'
+	uint32_t uid;			// tag UID
+	uint32_t nr;			// sniffed reader nonce
+	uint32_t ar;			// sniffed reader answer (encrypted 0xFFFFFFFF)
+	uint32_t nr2;			// optional second pair used to verify, 0 = not available
+	uint32_t ar2;
+	uint64_t keystart;		// window start, 'lf hitag reader 23' key format
+	uint8_t  bits;			// window width: the low <bits> bits of keystart are searched
+
+	// results
+	uint64_t candidates[HITAG2CRACK_MAX_CANDIDATES];
+	uint32_t num_candidates;
+	bool     verified;		// candidates[0] also matched the second pair
+} hitag2crack_t;
+
+extern uint32_t hitag2crack_ar(uint64_t key, uint32_t uid, uint32_t nr);
+extern bool hitag2crack_run(hitag2crack_t *job);
+
+#endif
@@ -0,0 +1,281 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// LF sample preprocessing kernels for lfdemod.c.
+//
+// askAmp() and getHiLo() walk the whole sample buffer byte by byte before
+// every ASK demod attempt, and the clock search may run them several times.
+// The kernels here split that work into loops plain enough for the compiler
+// to vectorize: a min/max reduction, and the edge classification half of the
+// amplification transform (the propagation half is inherently serial but
+// branch-light). A fused variant derives the min/max of the amplified buffer
+// from the classification flags, without a second pass.
+//
+// This file is compiled several times, once per instruction set (see
+// MULTIARCHSRCS in the Makefile), and the widest set the CPU supports is
+// selected at runtime - the same scheme as hardnested_bf_core.
+//-----------------------------------------------------------------------------
+
+#include "lfprep_core.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "hardnested/hardnested_bf_core.h"		// SIMDExecInstr, GetSIMDInstrAuto()
+
+// For each instruction set, define dedicated function names:
+#if defined (__AVX512F__)
+#define LF_MINMAX lf_minmax_AVX512
+#define LF_ASKAMP_MINMAX lf_askamp_minmax_AVX512
+#define LF_PEAKCLASS lf_peakclass_AVX512
+#elif defined (__AVX2__)
+#define LF_MINMAX lf_minmax_AVX2
+#define LF_ASKAMP_MINMAX lf_askamp_minmax_AVX2
+#define LF_PEAKCLASS lf_peakclass_AVX2
+#elif defined (__AVX__)
+#define LF_MINMAX lf_minmax_AVX
+#define LF_ASKAMP_MINMAX lf_askamp_minmax_AVX
+#define LF_PEAKCLASS lf_peakclass_AVX
+#elif defined (__SSE2__)
+#define LF_MINMAX lf_minmax_SSE2
+#define LF_ASKAMP_MINMAX lf_askamp_minmax_SSE2
+#define LF_PEAKCLASS lf_peakclass_SSE2
+#elif defined (__MMX__)
+#define LF_MINMAX lf_minmax_MMX
+#define LF_ASKAMP_MINMAX lf_askamp_minmax_MMX
+#define LF_PEAKCLASS lf_peakclass_MMX
+#else
+#define LF_MINMAX lf_minmax_NOSIMD
+#define LF_ASKAMP_MINMAX lf_askamp_minmax_NOSIMD
+#define LF_PEAKCLASS lf_peakclass_NOSIMD
+#endif
+
+// typedefs and declaration of functions:
+typedef void lf_minmax_t(const uint8_t*, size_t, int*, int*);
+lf_minmax_t lf_minmax_AVX512;
+lf_minmax_t lf_minmax_AVX2;
+lf_minmax_t lf_minmax_AVX;
+lf_minmax_t lf_minmax_SSE2;
+lf_minmax_t lf_minmax_MMX;
+lf_minmax_t lf_minmax_NOSIMD;
+
+typedef void lf_askamp_minmax_t(uint8_t*, size_t, int*, int*);
+lf_askamp_minmax_t lf_askamp_minmax_AVX512;
+lf_askamp_minmax_t lf_askamp_minmax_AVX2;
+lf_askamp_minmax_t lf_askamp_minmax_AVX;
+lf_askamp_minmax_t lf_askamp_minmax_SSE2;
+lf_askamp_minmax_t lf_askamp_minmax_MMX;
+lf_askamp_minmax_t lf_askamp_minmax_NOSIMD;
+
+typedef void lf_peakclass_t(const uint8_t*, size_t, int, int, uint8_t*, uint8_t*);
+lf_peakclass_t lf_peakclass_AVX512;
+lf_peakclass_t lf_peakclass_AVX2;
+lf_peakclass_t lf_peakclass_AVX;
+lf_peakclass_t lf_peakclass_SSE2;
+lf_peakclass_t lf_peakclass_MMX;
+lf_peakclass_t lf_peakclass_NOSIMD;
+
+void LF_MINMAX(const uint8_t *samples, size_t size, int *high, int *low)
+{
+	// simple reduction, compiles to wide vector min/max
+	uint8_t hi = 0;
+	uint8_t lo = 255;
+	for (size_t i = 0; i < size; i++) {
+		uint8_t v = samples[i];
+		hi = (v > hi) ? v : hi;
+		lo = (v < lo) ? v : lo;
+	}
+	*high = hi;
+	*low = lo;
+}
+
+void LF_ASKAMP_MINMAX(uint8_t *samples, size_t size, int *high, int *low)
+{
+	if (size < 2) {
+		if (high != NULL) LF_MINMAX(samples, size, high, low);
+		return;
+	}
+
+	uint8_t *flags = malloc(size);
+	if (flags == NULL) {
+		// fall back to the original one-pass transform
+		uint8_t Last = 128;
+		for (size_t i = 1; i < size; i++) {
+			if (samples[i] - samples[i-1] >= 30)
+				Last = 255;
+			else if (samples[i-1] - samples[i] >= 20)
+				Last = 0;
+			samples[i-1] = Last;
+		}
+		if (high != NULL) LF_MINMAX(samples, size, high, low);
+		return;
+	}
+
+	// pass 1, vectorizes: classify every step as large jump up/down or flat
+	flags[0] = 0;
+	for (size_t i = 1; i < size; i++) {
+		int d = (int)samples[i] - (int)samples[i-1];
+		flags[i] = (d >= 30) ? 2 : ((d <= -20) ? 1 : 0);
+	}
+
+	// pass 2, serial: propagate the most recent jump level
+	uint8_t Last = 128;
+	bool any_up = false;
+	bool any_down = false;
+	size_t first_event = 0;
+	for (size_t i = 1; i < size; i++) {
+		if (flags[i] == 2) {
+			Last = 255;
+			if (!any_up && !any_down) first_event = i;
+			any_up = true;
+		} else if (flags[i] == 1) {
+			Last = 0;
+			if (!any_up && !any_down) first_event = i;
+			any_down = true;
+		}
+		samples[i-1] = Last;
+	}
+	free(flags);
+
+	if (high != NULL) {
+		// amplified samples are 0/128/255 plus the untouched last raw sample;
+		// 128 only appears when there is no jump before the second sample
+		bool wrote128 = (!any_up && !any_down) || first_event > 1;
+		int hi = any_up ? 255 : (wrote128 ? 128 : 0);
+		int lo = any_down ? 0 : (wrote128 ? 128 : 255);
+		*high = (samples[size-1] > hi) ? samples[size-1] : hi;
+		*low = (samples[size-1] < lo) ? samples[size-1] : lo;
+	}
+}
+
+
+void LF_PEAKCLASS(const uint8_t *samples, size_t size, int peak, int low, uint8_t *isPeak, uint8_t *isPeakTol)
+{
+	if (size < 2) {
+		for (size_t i = 0; i < size; i++)
+			isPeakTol[i] = isPeak[i] = (samples[i] >= peak) | (samples[i] <= low);
+		return;
+	}
+
+	// both loops compile to wide vector compares/ors
+	for (size_t i = 0; i < size; i++)
+		isPeak[i] = (samples[i] >= peak) | (samples[i] <= low);
+
+	isPeakTol[0] = isPeak[0] | isPeak[1];
+	for (size_t i = 1; i + 1 < size; i++)
+		isPeakTol[i] = isPeak[i-1] | isPeak[i] | isPeak[i+1];
+	isPeakTol[size-1] = isPeak[size-2] | isPeak[size-1];
+}
+
+#ifndef __MMX__
+
+// determine the available instruction set at runtime and call the correct function
+void lf_minmax_core(const uint8_t *samples, size_t size, int *high, int *low)
+{
+	lf_minmax_t *lf_minmax_function_p;
+
+	switch(GetSIMDInstrAuto()) {
+#if defined (__i386__) || defined (__x86_64__)
+#if !defined(__APPLE__) || (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1))
+#if (__GNUC__ >= 5) && (__GNUC__ > 5 || __GNUC_MINOR__ > 2)
+		case SIMD_AVX512:
+			lf_minmax_function_p = &lf_minmax_AVX512;
+			break;
+#endif
+		case SIMD_AVX2:
+			lf_minmax_function_p = &lf_minmax_AVX2;
+			break;
+		case SIMD_AVX:
+			lf_minmax_function_p = &lf_minmax_AVX;
+			break;
+		case SIMD_SSE2:
+			lf_minmax_function_p = &lf_minmax_SSE2;
+			break;
+		case SIMD_MMX:
+			lf_minmax_function_p = &lf_minmax_MMX;
+			break;
+#endif
+#endif
+		default:
+			lf_minmax_function_p = &lf_minmax_NOSIMD;
+			break;
+	}
+
+	(*lf_minmax_function_p)(samples, size, high, low);
+}
+
+void lf_askamp_minmax_core(uint8_t *samples, size_t size, int *high, int *low)
+{
+	lf_askamp_minmax_t *lf_askamp_minmax_function_p;
+
+	switch(GetSIMDInstrAuto()) {
+#if defined (__i386__) || defined (__x86_64__)
+#if !defined(__APPLE__) || (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1))
+#if (__GNUC__ >= 5) && (__GNUC__ > 5 || __GNUC_MINOR__ > 2)
+		case SIMD_AVX512:
+			lf_askamp_minmax_function_p = &lf_askamp_minmax_AVX512;
+			break;
+#endif
+		case SIMD_AVX2:
+			lf_askamp_minmax_function_p = &lf_askamp_minmax_AVX2;
+			break;
+		case SIMD_AVX:
+			lf_askamp_minmax_function_p = &lf_askamp_minmax_AVX;
+			break;
+		case SIMD_SSE2:
+			lf_askamp_minmax_function_p = &lf_askamp_minmax_SSE2;
+			break;
+		case SIMD_MMX:
+			lf_askamp_minmax_function_p = &lf_askamp_minmax_MMX;
+			break;
+#endif
+#endif
+		default:
+			lf_askamp_minmax_function_p = &lf_askamp_minmax_NOSIMD;
+			break;
+	}
+
+	(*lf_askamp_minmax_function_p)(samples, size, high, low);
+}
+
+void lf_askamp_core(uint8_t *samples, size_t size)
+{
+	lf_askamp_minmax_core(samples, size, NULL, NULL);
+}
+
+void lf_peakclass_core(const uint8_t *samples, size_t size, int peak, int low, uint8_t *isPeak, uint8_t *isPeakTol)
+{
+	lf_peakclass_t *lf_peakclass_function_p;
+
+	switch(GetSIMDInstrAuto()) {
+#if defined (__i386__) || defined (__x86_64__)
+#if !defined(__APPLE__) || (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1))
+#if (__GNUC__ >= 5) && (__GNUC__ > 5 || __GNUC_MINOR__ > 2)
+		case SIMD_AVX512:
+			lf_peakclass_function_p = &lf_peakclass_AVX512;
+			break;
+#endif
+		case SIMD_AVX2:
+			lf_peakclass_function_p = &lf_peakclass_AVX2;
+			break;
+		case SIMD_AVX:
+			lf_peakclass_function_p = &lf_peakclass_AVX;
+			break;
+		case SIMD_SSE2:
+			lf_peakclass_function_p = &lf_peakclass_SSE2;
+			break;
+		case SIMD_MMX:
+			lf_peakclass_function_p = &lf_peakclass_MMX;
+			break;
+#endif
+#endif
+		default:
+			lf_peakclass_function_p = &lf_peakclass_NOSIMD;
+			break;
+	}
+
+	(*lf_peakclass_function_p)(samples, size, peak, low, isPeak, isPeakTol);
+}
+
+#endif
@@ -0,0 +1,31 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// LF sample preprocessing kernels (envelope amplification, min/max scan),
+// compiled per instruction set with runtime CPU dispatch (same scheme as
+// hardnested_bf_core).
+//-----------------------------------------------------------------------------
+
+#ifndef LFPREP_CORE_H__
+#define LFPREP_CORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// min/max of samples[0..size-1], using the widest instruction set available
+extern void lf_minmax_core(const uint8_t *samples, size_t size, int *high, int *low);
+
+// the askAmp() edge amplification transform
+extern void lf_askamp_core(uint8_t *samples, size_t size);
+
+// fused variant: amplify and report min/max of the result in the same pass
+extern void lf_askamp_minmax_core(uint8_t *samples, size_t size, int *high, int *low);
+
+// classify every sample as peak (>= peak or <= low) into isPeak[], and the
+// same with a ±1 neighbourhood folded in into isPeakTol[] - the predicates
+// DetectASKClock() scores clocks against
+extern void lf_peakclass_core(const uint8_t *samples, size_t size, int peak, int low, uint8_t *isPeak, uint8_t *isPeakTol);
+
+#endif
@@ -39,6 +39,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
 #include "util.h"
 #include "util_posix.h"
 #include "cipherutils.h"
@@ -295,6 +296,78 @@ int _readFromDump(uint8_t dump[], dumpdata* item, uint8_t i)
 }
 
 static uint32_t startvalue = 0;
+
+/**
+ * The brute-force is spread over worker threads, each claiming batches of
+ * candidate values from a shared cursor and diversifying a whole batch per
+ * call (diversifyKeyBatch uses a thread-local DES context, and doMAC/hash0
+ * only touch locals, so the workers share nothing but the cursor and the
+ * read-only inputs).
+ */
+#define BRUTE_BATCH_SIZE 64
+
+typedef struct {
+	dumpdata *item;
+	uint16_t *keytable;		// only read, candidate bytes are patched in locally
+	uint8_t *key_index;
+	uint8_t *bytes_to_recover;
+	uint8_t numbytes_to_recover;
+	uint32_t endvalue;
+} brute_job_t;
+
+static uint32_t brute_cursor;
+static volatile bool brute_found;
+static volatile uint32_t brute_result;
+
+static void *bruteforce_thread(void *args)
+{
+	brute_job_t *job = (brute_job_t *)args;
+	uint8_t keys[BRUTE_BATCH_SIZE][8];
+	uint8_t div_keys[BRUTE_BATCH_SIZE][8];
+	uint8_t key_sel[8];
+	uint8_t calculated_MAC[4];
+	uint32_t batch;
+
+	while (!brute_found
+			&& (batch = __sync_fetch_and_add(&brute_cursor, BRUTE_BATCH_SIZE)) < job->endvalue) {
+
+		uint32_t n = job->endvalue - batch;
+		if (n > BRUTE_BATCH_SIZE) n = BRUTE_BATCH_SIZE;
+
+		for (uint32_t j = 0; j < n; j++) {
+			uint32_t brute = batch + j;
+			// Piece together the key, patching in the candidate value for
+			// the bytes being brute-forced
+			for (int i = 0; i < 8; i++) {
+				key_sel[i] = job->keytable[job->key_index[i]] & 0xFF;
+				for (int b = 0; b < job->numbytes_to_recover; b++) {
+					if (job->key_index[i] == job->bytes_to_recover[b])
+						key_sel[i] = (brute >> (b*8)) & 0xFF;
+				}
+			}
+			//Permute from iclass format to standard format
+			permutekey_rev(key_sel, keys[j]);
+		}
+
+		//Diversify the whole batch
+		diversifyKeyBatch(job->item->csn, keys, div_keys, n);
+
+		for (uint32_t j = 0; j < n; j++) {
+			doMAC(job->item->cc_nr, div_keys[j], calculated_MAC);
+			if (memcmp(calculated_MAC, job->item->mac, 4) == 0) {
+				brute_result = batch + j;
+				brute_found = true;
+				break;
+			}
+		}
+
+		if ((batch & 0xFFFF) == 0) {
+			printf("%d", (batch >> 16) & 0xFF);
+			fflush(stdout);
+		}
+	}
+	return NULL;
+}
 /**
  * @brief Performs brute force attack against a dump-data item, containing csn, cc_nr and mac.
  *This method calculates the hash1 for the CSN, and determines what bytes need to be bruteforced
@@ -308,11 +381,7 @@ static uint32_t startvalue = 0;
  */
 int bruteforceItem(dumpdata item, uint16_t keytable[]) {
 	int errors = 0;
-	uint8_t key_sel_p[8] = { 0 };
-	uint8_t div_key[8] = {0};
 	int found = false;
-	uint8_t key_sel[8] = {0};
-	uint8_t calculated_MAC[4] = { 0 };
 
 	//Get the key index (hash1)
 	uint8_t key_index[8] = {0};
@@ -369,42 +438,42 @@ int bruteforceItem(dumpdata item, uint16_t keytable[]) {
 		prnlog("Bruteforcing byte %d", bytes_to_recover[i]);
 	}
 
-	while (!found && !(brute & endmask)) {
+	brute_job_t job = {
+		&item,
+		keytable,
+		key_index,
+		bytes_to_recover,
+		numbytes_to_recover,
+		endmask
+	};
+	brute_cursor = brute;
+	brute_found = false;
+	brute_result = 0;
+
+	// no point in more workers than there are batches: a 1-byte search is
+	// only 256 candidates, i.e. 4 batches
+	int num_threads = num_CPUs();
+	uint32_t num_batches = (endmask - brute + BRUTE_BATCH_SIZE - 1) / BRUTE_BATCH_SIZE;
+	if ((uint32_t)num_threads > num_batches)
+		num_threads = num_batches;
+	if (num_threads < 1)
+		num_threads = 1;
+	pthread_t threads[num_threads];
+	for (int i = 0; i < num_threads; i++) {
+		pthread_create(&threads[i], NULL, bruteforce_thread, &job);
+	}
+	for (int i = 0; i < num_threads; i++) {
+		pthread_join(threads[i], NULL);
+	}
 
-		//Update the keytable with the brute-values
-		for(int i = 0 ; i < numbytes_to_recover; i++) {
+	if (brute_found) {
+		//Update the keytable with the found values
+		for (int i = 0; i < numbytes_to_recover; i++) {
 			keytable[bytes_to_recover[i]] &= 0xFF00;
-			keytable[bytes_to_recover[i]] |= ((brute >> (i*8)) & 0xFF);
-		}
-
-		// Piece together the key
-		key_sel[0] = keytable[key_index[0]] & 0xFF;
-		key_sel[1] = keytable[key_index[1]] & 0xFF;
-		key_sel[2] = keytable[key_index[2]] & 0xFF;
-		key_sel[3] = keytable[key_index[3]] & 0xFF;
-		key_sel[4] = keytable[key_index[4]] & 0xFF;
-		key_sel[5] = keytable[key_index[5]] & 0xFF;
-		key_sel[6] = keytable[key_index[6]] & 0xFF;
-		key_sel[7] = keytable[key_index[7]] & 0xFF;
-
-		//Permute from iclass format to standard format
-		permutekey_rev(key_sel,key_sel_p);
-		//Diversify
-		diversifyKey(item.csn, key_sel_p, div_key);
-		//Calc mac
-		doMAC(item.cc_nr, div_key, calculated_MAC);
-
-		if (memcmp(calculated_MAC, item.mac, 4) == 0) {
-			for (int i = 0; i < numbytes_to_recover; i++)
-				prnlog("=> %d: 0x%02x", bytes_to_recover[i], 0xFF & keytable[bytes_to_recover[i]]);
-			found = true;
-			break;
-		}
-		brute++;
-		if ((brute & 0xFFFF) == 0) {
-			printf("%d",(brute >> 16) & 0xFF);
-			fflush(stdout);
+			keytable[bytes_to_recover[i]] |= ((brute_result >> (i*8)) & 0xFF);
+			prnlog("=> %d: 0x%02x", bytes_to_recover[i], 0xFF & keytable[bytes_to_recover[i]]);
 		}
+		found = true;
 	}
 
 	if (!found) {
@@ -38,10 +38,13 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <stdarg.h>
+#include <jansson.h>
 #include "fileutils.h"
+#include "workqueue.h"
 #include "ui.h"
 /**
  * @brief checks if a file exists
@@ -90,6 +93,247 @@ int saveFile(const char *preferredName, const char *suffix, const void* data, si
 	return 0;
 }
 
+static int hexNibble(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+// hex-text (.eml) dumps are decoded one line span per worker; below this
+// many lines the submit/join overhead costs more than the decode itself
+#define EML_PARALLEL_MIN_LINES 256
+
+typedef struct {
+	const char * const *lines;	// line start pointers into the raw file image
+	size_t first;			// first line index of this span
+	size_t count;
+	uint8_t *data;			// shared output buffer, line n decodes to data + n*16
+	long bad;			// first malformed line in the span, or -1
+} eml_span_t;
+
+static void eml_decode_task(void *arg)
+{
+	eml_span_t *span = arg;
+	span->bad = -1;
+	for (size_t n = span->first; n < span->first + span->count; n++) {
+		const char *line = span->lines[n];
+		uint8_t *dst = span->data + n * 16;
+		for (int i = 0; i < 32; i += 2) {
+			int hi = hexNibble(line[i]);
+			int lo = hexNibble(line[i + 1]);
+			if (hi < 0 || lo < 0) {
+				span->bad = n;
+				return;
+			}
+			dst[i / 2] = (hi << 4) | lo;
+		}
+	}
+}
+
+// decode every collected line into data; spreads the work over the shared
+// worker pool once the dump is big enough to be worth it
+static int eml_decode_lines(const char * const *lines, size_t numLines, uint8_t *data)
+{
+	int spans = 1;
+	if (numLines >= EML_PARALLEL_MIN_LINES)
+		spans = workqueue_num_workers();
+	if ((size_t)spans > numLines)
+		spans = numLines;
+
+	eml_span_t *span = calloc(spans, sizeof(eml_span_t));
+	if (span == NULL)
+		return 1;
+
+	size_t per = numLines / spans;
+	size_t extra = numLines % spans;
+	size_t first = 0;
+	for (int s = 0; s < spans; s++) {
+		span[s].lines = lines;
+		span[s].first = first;
+		span[s].count = per + (s < (int)extra ? 1 : 0);
+		span[s].data = data;
+		first += span[s].count;
+		if (spans > 1)
+			workqueue_submit(eml_decode_task, &span[s]);
+		else
+			eml_decode_task(&span[s]);
+	}
+	if (spans > 1)
+		workqueue_join();
+
+	int res = 0;
+	for (int s = 0; s < spans; s++) {
+		if (span[s].bad >= 0) {
+			prnlog("File content error. Line %ld must hold 32 HEX symbols", span[s].bad + 1);
+			res = 1;
+			break;
+		}
+	}
+	free(span);
+	return res;
+}
+
+// JSON dumps carry their blocks as an object of "<blocknum>": "<32 hex>"
+// entries; the object size gives the block count up front, so the output
+// size is checked before any block is decoded
+static int loadFileJsonBlocks(const char *text, uint8_t *data, size_t maxlen, size_t *datalen)
+{
+	json_error_t err;
+	json_t *root = json_loads(text, 0, &err);
+	if (root == NULL) {
+		prnlog("JSON parse error on line %d: %s", err.line, err.text);
+		return 1;
+	}
+
+	json_t *blocks = json_object_get(root, "blocks");
+	if (!json_is_object(blocks)) {
+		prnlog("File content error. JSON dump lacks a \"blocks\" object");
+		json_decref(root);
+		return 1;
+	}
+	if (json_object_size(blocks) * 16 > maxlen) {
+		prnlog("File content error. Dump holds %zu blocks, at most %zu fit",
+				json_object_size(blocks), maxlen / 16);
+		json_decref(root);
+		return 1;
+	}
+
+	size_t topBlock = 0;
+	const char *key;
+	json_t *value;
+	json_object_foreach(blocks, key, value) {
+		char *end = NULL;
+		long blockNum = strtol(key, &end, 10);
+		const char *hex = json_string_value(value);
+		if (blockNum < 0 || (end != NULL && *end != '\0') || hex == NULL || strlen(hex) != 32
+				|| (size_t)(blockNum + 1) * 16 > maxlen) {
+			prnlog("File content error. Bad JSON block entry \"%s\"", key);
+			json_decref(root);
+			return 1;
+		}
+		uint8_t *dst = data + blockNum * 16;
+		for (int i = 0; i < 32; i += 2) {
+			int hi = hexNibble(hex[i]);
+			int lo = hexNibble(hex[i + 1]);
+			if (hi < 0 || lo < 0) {
+				prnlog("File content error. Block %ld data must be 32 HEX symbols", blockNum);
+				json_decref(root);
+				return 1;
+			}
+			dst[i / 2] = (hi << 4) | lo;
+		}
+		if ((size_t)blockNum > topBlock)
+			topBlock = blockNum;
+	}
+	*datalen = (topBlock + 1) * 16;
+	json_decref(root);
+	return 0;
+}
+
+int loadFileDump(const char *preferredName, uint8_t *data, size_t maxlen, size_t *datalen)
+{
+	static const char *suffixes[] = { "", ".eml", ".json", ".bin" };
+	char fileName[FILENAME_MAX];
+	int found = 0;
+
+	*datalen = 0;
+	for (size_t s = 0; s < sizeof(suffixes) / sizeof(suffixes[0]); s++) {
+		snprintf(fileName, sizeof(fileName), "%s%s", preferredName, suffixes[s]);
+		if (fileExists(fileName)) {
+			found = 1;
+			break;
+		}
+	}
+	if (!found) {
+		prnlog("File %s not found", preferredName);
+		return 1;
+	}
+
+	FILE *f = fopen(fileName, "rb");
+	if (f == NULL) {
+		prnlog("File %s not found or locked", fileName);
+		return 1;
+	}
+
+	// size the raw image from the file length instead of growing it chunkwise
+	fseek(f, 0, SEEK_END);
+	long fsize = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (fsize < 0) {
+		fclose(f);
+		return 1;
+	}
+
+	char *raw = malloc(fsize + 1);
+	if (raw == NULL) {
+		fclose(f);
+		return 1;
+	}
+	size_t got = fread(raw, 1, fsize, f);
+	fclose(f);
+	raw[got] = '\0';
+
+	// format is sniffed from the content, not the extension: a JSON dump
+	// opens with '{', an eml dump is lines of hex text, anything else is
+	// taken as a raw binary image
+	size_t off = 0;
+	while (off < got && (raw[off] == ' ' || raw[off] == '\t' || raw[off] == '\r' || raw[off] == '\n'))
+		off++;
+
+	int res;
+	if (off < got && raw[off] == '{') {
+		res = loadFileJsonBlocks(raw + off, data, maxlen, datalen);
+	} else if (off + 32 <= got && hexNibble(raw[off]) >= 0 && hexNibble(raw[off + 31]) >= 0) {
+		// collect line starts, then decode them (in parallel when large)
+		const char **lines = malloc((got / 33 + 1) * sizeof(char *));
+		if (lines == NULL) {
+			free(raw);
+			return 1;
+		}
+		size_t numLines = 0;
+		res = 0;
+		for (char *p = raw; (size_t)(p - raw) < got; ) {
+			char *eol = strchr(p, '\n');
+			size_t linelen = eol ? (size_t)(eol - p) : strlen(p);
+			if (linelen && p[linelen - 1] == '\r')
+				linelen--;
+			if (linelen >= 32) {
+				if (numLines * 16 + 16 > maxlen) {
+					prnlog("File content error. Dump exceeds %zu blocks", maxlen / 16);
+					res = 1;
+					break;
+				}
+				lines[numLines++] = p;
+			} else if (linelen != 0) {
+				prnlog("File content error. Block data must include 32 HEX symbols");
+				res = 1;
+				break;
+			}
+			if (eol == NULL)
+				break;
+			p = eol + 1;
+		}
+		if (res == 0)
+			res = eml_decode_lines(lines, numLines, data);
+		if (res == 0)
+			*datalen = numLines * 16;
+		free(lines);
+	} else {
+		if (got > maxlen) {
+			prnlog("File content error. Image is %zu bytes, at most %zu fit", got, maxlen);
+			res = 1;
+		} else {
+			memcpy(data, raw, got);
+			*datalen = got;
+			res = 0;
+		}
+	}
+	free(raw);
+	return res;
+}
+
 /**
  * Utility function to print to console. This is used consistently within the library instead
  * of printf, but it actually only calls printf (and adds a linebreak).
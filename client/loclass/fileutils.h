@@ -53,6 +53,20 @@
 int saveFile(const char *preferredName, const char *suffix, const void* data, size_t datalen);
 
 int fileExists(const char *filename);
+
+/**
+ * @brief Utility function to load a dump file without knowing its format up front.
+ * The format is sniffed from the content: JSON ('{' opener, blocks decoded from the
+ * "blocks" object), eml (lines of 32 hex symbols, decoded in parallel for large
+ * dumps) or raw binary. If preferredName does not exist as given, the suffixes
+ * .eml, .json and .bin are tried in that order.
+ * @param preferredName the file name, with or without suffix
+ * @param data caller-allocated output buffer
+ * @param maxlen size of the output buffer
+ * @param datalen receives the number of bytes loaded
+ * @return 0 for ok, 1 for failz
+ */
+int loadFileDump(const char *preferredName, uint8_t *data, size_t maxlen, size_t *datalen);
 #endif //ON_DEVICE
 
 /**
@@ -407,6 +407,25 @@ void diversifyKey(uint8_t csn[8], uint8_t key[8], uint8_t div_key[8])
 	hash0(crypt_csn,div_key);
 }
 
+/**
+ * @brief Batched, reentrant variant of diversifyKey(). Diversifies count
+ * candidate keys against a single CSN. Uses a caller-local DES context
+ * instead of the file-global ctx_enc, so batches can run on several
+ * threads concurrently - the brute-force in elite_crack.c hands out
+ * batches of candidates to worker threads.
+ */
+void diversifyKeyBatch(uint8_t csn[8], uint8_t keys[][8], uint8_t div_keys[][8], size_t count)
+{
+	mbedtls_des_context ctx = { {0} };
+	uint8_t crypted_csn[8];
+
+	for (size_t i = 0; i < count; i++) {
+		mbedtls_des_setkey_enc(&ctx, keys[i]);
+		mbedtls_des_crypt_ecb(&ctx, csn, crypted_csn);
+		hash0(x_bytes_to_num(crypted_csn, 8), div_keys[i]);
+	}
+}
+
 
 
 
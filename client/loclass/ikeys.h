@@ -60,6 +60,7 @@ int doKeyTests(uint8_t debuglevel);
  */
 
 void diversifyKey(uint8_t csn[8], uint8_t key[8], uint8_t div_key[8]);
+void diversifyKeyBatch(uint8_t csn[8], uint8_t keys[][8], uint8_t div_keys[][8], size_t count);
 /**
  * @brief Permutes a key from standard NIST format to Iclass specific format
  * @param key
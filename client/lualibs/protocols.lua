@@ -0,0 +1,240 @@
+--[[
+These are tag protocol constants (ISO14443A/B, ISO15693, iClass, Topaz, T55x7...).
+This file is automatically generated from protocols.h - DON'T EDIT MANUALLY.
+--]]
+local __protocols = {}
+__protocols.ICLASS_CMD_ACTALL = 0x0A
+__protocols.ICLASS_CMD_READ_OR_IDENTIFY = 0x0C
+__protocols.ICLASS_CMD_SELECT = 0x81
+__protocols.ICLASS_CMD_PAGESEL = 0x84
+__protocols.ICLASS_CMD_READCHECK_KD = 0x88
+__protocols.ICLASS_CMD_READCHECK_KC = 0x18
+__protocols.ICLASS_CMD_CHECK_KC = 0x95
+__protocols.ICLASS_CMD_CHECK_KD = 0x05
+__protocols.ICLASS_CMD_DETECT = 0x0F
+__protocols.ICLASS_CMD_HALT = 0x00
+__protocols.ICLASS_CMD_UPDATE = 0x87
+__protocols.ICLASS_CMD_ACT = 0x8E
+__protocols.ICLASS_CMD_READ4 = 0x06
+__protocols.ISO14443A_CMD_REQA = 0x26
+__protocols.ISO14443A_CMD_WUPA = 0x52
+__protocols.ISO14443A_CMD_ANTICOLL_OR_SELECT = 0x93
+__protocols.ISO14443A_CMD_ANTICOLL_OR_SELECT_2 = 0x95
+__protocols.ISO14443A_CMD_ANTICOLL_OR_SELECT_3 = 0x97
+__protocols.ISO14443A_CMD_HALT = 0x50
+__protocols.ISO14443A_CMD_RATS = 0xE0
+__protocols.MIFARE_CMD_READBLOCK = 0x30
+__protocols.MIFARE_CMD_WRITEBLOCK = 0xA0
+__protocols.MIFARE_AUTH_KEYA = 0x60
+__protocols.MIFARE_AUTH_KEYB = 0x61
+__protocols.MIFARE_MAGICWUPC1 = 0x40
+__protocols.MIFARE_MAGICWUPC2 = 0x43
+__protocols.MIFARE_MAGICWIPEC = 0x41
+__protocols.MIFARE_CMD_INC = 0xC0
+__protocols.MIFARE_CMD_DEC = 0xC1
+__protocols.MIFARE_CMD_RESTORE = 0xC2
+__protocols.MIFARE_CMD_TRANSFER = 0xB0
+__protocols.MIFARE_EV1_PERSONAL_UID = 0x40
+__protocols.MIFARE_EV1_UIDF0 = 0x00
+__protocols.MIFARE_EV1_UIDF1 = 0x40
+__protocols.MIFARE_EV1_UIDF2 = 0x20
+__protocols.MIFARE_EV1_UIDF3 = 0x60
+__protocols.MIFARE_EV1_SETMODE = 0x43
+__protocols.MIFARE_ULC_WRITE = 0xA2
+__protocols.MIFARE_ULC_COMP_WRITE = __protocols.MIFARE_CMD_WRITEBLOCK
+__protocols.MIFARE_ULC_AUTH_1 = 0x1A
+__protocols.MIFARE_ULC_AUTH_2 = 0xAF
+__protocols.MIFARE_ULEV1_AUTH = 0x1B
+__protocols.MIFARE_ULEV1_VERSION = 0x60
+__protocols.MIFARE_ULEV1_FASTREAD = 0x3A
+__protocols.MIFARE_ULEV1_WRITE = 0xA2
+__protocols.MIFARE_ULEV1_COMP_WRITE = __protocols.MIFARE_CMD_WRITEBLOCK
+__protocols.MIFARE_ULEV1_READ_CNT = 0x39
+__protocols.MIFARE_ULEV1_INCR_CNT = 0xA5
+__protocols.MIFARE_ULEV1_READSIG = 0x3C
+__protocols.MIFARE_ULEV1_CHECKTEAR = 0x3E
+__protocols.MIFARE_ULEV1_VCSL = 0x4B
+__protocols.CARD_ACK = 0x0A
+__protocols.CARD_NACK_NA = 0x04
+__protocols.CARD_NACK_TR = 0x05
+__protocols.ISO14443B_REQB = 0x05
+__protocols.ISO14443B_ATTRIB = 0x1D
+__protocols.ISO14443B_HALT = 0x50
+__protocols.ISO14443B_INITIATE = 0x06
+__protocols.ISO14443B_SELECT = 0x0E
+__protocols.ISO14443B_GET_UID = 0x0B
+__protocols.ISO14443B_READ_BLK = 0x08
+__protocols.ISO14443B_WRITE_BLK = 0x09
+__protocols.ISO14443B_RESET = 0x0C
+__protocols.ISO14443B_COMPLETION = 0x0F
+__protocols.ISO14443B_AUTHENTICATE = 0x0A
+__protocols.ISO15693_INVENTORY = 0x01
+__protocols.ISO15693_STAYQUIET = 0x02
+__protocols.ISO15693_READBLOCK = 0x20
+__protocols.ISO15693_WRITEBLOCK = 0x21
+__protocols.ISO15693_LOCKBLOCK = 0x22
+__protocols.ISO15693_READ_MULTI_BLOCK = 0x23
+__protocols.ISO15693_SELECT = 0x25
+__protocols.ISO15693_RESET_TO_READY = 0x26
+__protocols.ISO15693_WRITE_AFI = 0x27
+__protocols.ISO15693_LOCK_AFI = 0x28
+__protocols.ISO15693_WRITE_DSFID = 0x29
+__protocols.ISO15693_LOCK_DSFID = 0x2A
+__protocols.ISO15693_GET_SYSTEM_INFO = 0x2B
+__protocols.ISO15693_READ_MULTI_SECSTATUS = 0x2C
+__protocols.ISO15693_REQ_SUBCARRIER_TWO = 0x1
+__protocols.ISO15693_REQ_DATARATE_HIGH = 0x2
+__protocols.ISO15693_REQ_INVENTORY = 0x4
+__protocols.ISO15693_REQ_PROTOCOL_EXT = 0x8
+__protocols.ISO15693_REQ_OPTION = 0x40
+__protocols.ISO15693_REQ_SELECT = 0x10
+__protocols.ISO15693_REQ_ADDRESS = 0x20
+__protocols.ISO15693_REQINV_AFI = 0x10
+__protocols.ISO15693_REQINV_SLOT1 = 0x20
+__protocols.ISO15693_RES_ERROR = 0x1
+__protocols.ISO15693_RES_EXT = 0x8
+__protocols.ISO15693_NOERROR = 0x00
+__protocols.ISO15693_ERROR_CMD_NOT_SUP = 0x01
+__protocols.ISO15693_ERROR_CMD_NOT_REC = 0x02
+__protocols.ISO15693_ERROR_CMD_OPTION = 0x03
+__protocols.ISO15693_ERROR_GENERIC = 0x0F
+__protocols.ISO15693_ERROR_BLOCK_UNAVAILABLE = 0x10
+__protocols.ISO15693_ERROR_BLOCK_LOCKED_ALREADY = 0x11
+__protocols.ISO15693_ERROR_BLOCK_LOCKED = 0x12
+__protocols.ISO15693_ERROR_BLOCK_WRITE = 0x13
+__protocols.ISO15693_ERROR_BLOCL_WRITELOCK = 0x14
+__protocols.TOPAZ_REQA = 0x26
+__protocols.TOPAZ_WUPA = 0x52
+__protocols.TOPAZ_RID = 0x78
+__protocols.TOPAZ_RALL = 0x00
+__protocols.TOPAZ_READ = 0x01
+__protocols.TOPAZ_WRITE_E = 0x53
+__protocols.TOPAZ_WRITE_NE = 0x1a
+__protocols.TOPAZ_RSEG = 0x10
+__protocols.TOPAZ_READ8 = 0x02
+__protocols.TOPAZ_WRITE_E8 = 0x54
+__protocols.TOPAZ_WRITE_NE8 = 0x1B
+__protocols.HITAG1_SET_CCNEW = 0xC2
+__protocols.HITAG1_READ_ID = 0x00
+__protocols.HITAG1_SELECT = 0x00
+__protocols.HITAG1_WRPPAGE = 0x80
+__protocols.HITAG1_WRPBLK = 0x90
+__protocols.HITAG1_WRCPAGE = 0xA0
+__protocols.HITAG1_WRCBLK = 0xB0
+__protocols.HITAG1_RDPPAGE = 0xC0
+__protocols.HITAG1_RDPBLK = 0xD0
+__protocols.HITAG1_RDCPAGE = 0xE0
+__protocols.HITAG1_RDCBLK = 0xF0
+__protocols.HITAG1_HALT = 0x70
+__protocols.HITAG2_START_AUTH = 0xC0
+__protocols.HITAG2_READ_PAGE = 0xC0
+__protocols.HITAG2_READ_PAGE_INVERTED = 0x44
+__protocols.HITAG2_WRITE_PAGE = 0x82
+__protocols.HITAG2_HALT = 0x00
+__protocols.ISO_14443A = 0
+__protocols.ICLASS = 1
+__protocols.ISO_14443B = 2
+__protocols.TOPAZ = 3
+__protocols.PROTO_MIFARE = 4
+__protocols.ISO_7816_4 = 5
+__protocols.ISO_15693 = 6
+__protocols.ISO_14443_4 = 7
+__protocols.FUSE_FPERS = 0x80
+__protocols.FUSE_CODING1 = 0x40
+__protocols.FUSE_CODING0 = 0x20
+__protocols.FUSE_CRYPT1 = 0x10
+__protocols.FUSE_CRYPT0 = 0x08
+__protocols.FUSE_FPROD1 = 0x04
+__protocols.FUSE_FPROD0 = 0x02
+__protocols.FUSE_RA = 0x01
+__protocols.ISO7816_ERASE_BINARY = 0x0E
+__protocols.ISO7816_VERIFY = 0x20
+__protocols.ISO7816_MANAGE_CHANNEL = 0x70
+__protocols.ISO7816_EXTERNAL_AUTHENTICATE = 0x82
+__protocols.ISO7816_GET_CHALLENGE = 0x84
+__protocols.ISO7816_INTERNAL_AUTHENTICATE = 0x88
+__protocols.ISO7816_SELECT_FILE = 0xA4
+__protocols.ISO7816_GET_PROCESSING_OPTIONS = 0xA8
+__protocols.ISO7816_READ_BINARY = 0xB0
+__protocols.ISO7816_READ_RECORDS = 0xB2
+__protocols.ISO7816_GET_RESPONSE = 0xC0
+__protocols.ISO7816_ENVELOPE = 0xC2
+__protocols.ISO7816_GET_DATA = 0xCA
+__protocols.ISO7816_WRITE_BINARY = 0xD0
+__protocols.ISO7816_WRITE_RECORD = 0xD2
+__protocols.ISO7816_UPDATE_BINARY = 0xD6
+__protocols.ISO7816_PUT_DATA = 0xDA
+__protocols.ISO7816_UPDATE_DATA = 0xDC
+__protocols.ISO7816_APPEND_RECORD = 0xE2
+__protocols.ISO7816_OK = 0x9000
+__protocols.ISO7816_MAX_FRAME_SIZE = 261
+__protocols.T55x7_POR_DELAY = 0x00000001
+__protocols.T55x7_ST_TERMINATOR = 0x00000008
+__protocols.T55x7_PWD = 0x00000010
+__protocols.T55x7_MAXBLOCK_SHIFT = 5
+__protocols.T55x7_AOR = 0x00000200
+__protocols.T55x7_PSKCF_RF_2 = 0
+__protocols.T55x7_PSKCF_RF_4 = 0x00000400
+__protocols.T55x7_PSKCF_RF_8 = 0x00000800
+__protocols.T55x7_MODULATION_DIRECT = 0
+__protocols.T55x7_MODULATION_PSK1 = 0x00001000
+__protocols.T55x7_MODULATION_PSK2 = 0x00002000
+__protocols.T55x7_MODULATION_PSK3 = 0x00003000
+__protocols.T55x7_MODULATION_FSK1 = 0x00004000
+__protocols.T55x7_MODULATION_FSK2 = 0x00005000
+__protocols.T55x7_MODULATION_FSK1a = 0x00006000
+__protocols.T55x7_MODULATION_FSK2a = 0x00007000
+__protocols.T55x7_MODULATION_MANCHESTER = 0x00008000
+__protocols.T55x7_MODULATION_BIPHASE = 0x00010000
+__protocols.T55x7_MODULATION_DIPHASE = 0x00018000
+__protocols.T55x7_X_MODE = 0x00020000
+__protocols.T55x7_BITRATE_RF_8 = 0
+__protocols.T55x7_BITRATE_RF_16 = 0x00040000
+__protocols.T55x7_BITRATE_RF_32 = 0x00080000
+__protocols.T55x7_BITRATE_RF_40 = 0x000C0000
+__protocols.T55x7_BITRATE_RF_50 = 0x00100000
+__protocols.T55x7_BITRATE_RF_64 = 0x00140000
+__protocols.T55x7_BITRATE_RF_100 = 0x00180000
+__protocols.T55x7_BITRATE_RF_128 = 0x001C0000
+__protocols.T5555_ST_TERMINATOR = 0x00000001
+__protocols.T5555_MAXBLOCK_SHIFT = 0x00000001
+__protocols.T5555_MODULATION_MANCHESTER = 0
+__protocols.T5555_MODULATION_PSK1 = 0x00000010
+__protocols.T5555_MODULATION_PSK2 = 0x00000020
+__protocols.T5555_MODULATION_PSK3 = 0x00000030
+__protocols.T5555_MODULATION_FSK1 = 0x00000040
+__protocols.T5555_MODULATION_FSK2 = 0x00000050
+__protocols.T5555_MODULATION_BIPHASE = 0x00000060
+__protocols.T5555_MODULATION_DIRECT = 0x00000070
+__protocols.T5555_INVERT_OUTPUT = 0x00000080
+__protocols.T5555_PSK_RF_2 = 0
+__protocols.T5555_PSK_RF_4 = 0x00000100
+__protocols.T5555_PSK_RF_8 = 0x00000200
+__protocols.T5555_USE_PWD = 0x00000400
+__protocols.T5555_USE_AOR = 0x00000800
+__protocols.T5555_BITRATE_SHIFT = 12
+__protocols.T5555_FAST_WRITE = 0x00004000
+__protocols.T5555_PAGE_SELECT = 0x00008000
+__protocols.T55XX_WRITE_TIMEOUT = 1500
+__protocols.EM4x05_MODULATION_NRZ = 0x00000000
+__protocols.EM4x05_MODULATION_MANCHESTER = 0x00000040
+__protocols.EM4x05_MODULATION_BIPHASE = 0x00000080
+__protocols.EM4x05_MODULATION_MILLER = 0x000000C0
+__protocols.EM4x05_MODULATION_PSK1 = 0x00000100
+__protocols.EM4x05_MODULATION_PSK2 = 0x00000140
+__protocols.EM4x05_MODULATION_PSK3 = 0x00000180
+__protocols.EM4x05_MODULATION_FSK1 = 0x00000200
+__protocols.EM4x05_MODULATION_FSK2 = 0x00000240
+__protocols.EM4x05_PSK_RF_2 = 0
+__protocols.EM4x05_PSK_RF_4 = 0x00000400
+__protocols.EM4x05_PSK_RF_8 = 0x00000800
+__protocols.EM4x05_MAXBLOCK_SHIFT = 14
+__protocols.EM4x05_FIRST_USER_BLOCK = 5
+__protocols.EM4x05_READ_LOGIN_REQ = 0x40000
+__protocols.EM4x05_READ_HK_LOGIN_REQ = 0x80000
+__protocols.EM4x05_WRITE_LOGIN_REQ = 0x100000
+__protocols.EM4x05_WRITE_HK_LOGIN_REQ = 0x200000
+__protocols.EM4x05_READ_AFTER_WRITE = 0x400000
+__protocols.EM4x05_DISABLE_ALLOWED = 0x800000
+__protocols.EM4x05_READER_TALK_FIRST = 0x1000000
+return __protocols
@@ -0,0 +1,66 @@
+--[[
+	Reading of the binary trace containers written by 'hf list save' (see
+	client/tracefile.h for the layout). A container carries the raw trace
+	bytes plus a frame index, so scripts can address single frames without
+	re-parsing the whole capture. Files without the magic are treated as
+	legacy raw captures and get no frame list.
+--]]
+
+local TraceLib = {
+	MAGIC = "TRC1",
+}
+
+local function u16(bytes, pos)
+	local a, b = bytes:byte(pos, pos + 1)
+	return a + b * 256
+end
+
+local function u32(bytes, pos)
+	local a, b, c, d = bytes:byte(pos, pos + 3)
+	return a + b * 256 + c * 65536 + d * 16777216
+end
+
+---
+-- Loads a capture. Returns a table { trace = <raw trace bytes>, frames =
+-- { {pos, timestamp, data_len, cmd, isResponse}, ...} } where frames is nil
+-- for legacy raw captures, or nil and an error message.
+function TraceLib.load(filename)
+	local f = io.open(filename, "rb")
+	if not f then
+		return nil, ("Could not open file %s"):format(filename)
+	end
+	local bytes = f:read("*all")
+	f:close()
+
+	if #bytes < 16 or bytes:sub(1, 4) ~= TraceLib.MAGIC then
+		return { trace = bytes, frames = nil }
+	end
+
+	local traceLen = u32(bytes, 5)
+	local count = u32(bytes, 9)
+	if 16 + traceLen + count * 12 > #bytes then
+		return nil, ("Truncated trace container %s"):format(filename)
+	end
+
+	local frames = {}
+	local idx = 17 + traceLen
+	for i = 1, count do
+		local off = idx + (i - 1) * 12
+		frames[i] = {
+			pos = u32(bytes, off),
+			timestamp = u32(bytes, off + 4),
+			data_len = u16(bytes, off + 8),
+			cmd = bytes:byte(off + 10),
+			isResponse = bytes:byte(off + 11) ~= 0,
+		}
+	end
+	return { trace = bytes:sub(17, 16 + traceLen), frames = frames }
+end
+
+---
+-- Returns the data bytes of one frame (no timestamps, no parity)
+function TraceLib.framedata(capture, frame)
+	return capture.trace:sub(frame.pos + 9, frame.pos + 8 + frame.data_len)
+end
+
+return TraceLib
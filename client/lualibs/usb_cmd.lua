@@ -0,0 +1,195 @@
+--[[
+These are Proxmark command definitions.
+This file is automatically generated from usb_cmd.h - DON'T EDIT MANUALLY.
+--]]
+local __commands = {
+CMD_DEVICE_INFO = 0x0000,
+CMD_SETUP_WRITE = 0x0001,
+CMD_FINISH_WRITE = 0x0003,
+CMD_HARDWARE_RESET = 0x0004,
+CMD_START_FLASH = 0x0005,
+CMD_FLASH_CRC = 0x0006,
+CMD_WRITE_LZ = 0x0007,
+CMD_NACK = 0x00fe,
+CMD_ACK = 0x00ff,
+CMD_DEBUG_PRINT_STRING = 0x0100,
+CMD_DEBUG_PRINT_INTEGERS = 0x0101,
+CMD_DEBUG_PRINT_BYTES = 0x0102,
+CMD_LCD_RESET = 0x0103,
+CMD_LCD = 0x0104,
+CMD_BUFF_CLEAR = 0x0105,
+CMD_READ_MEM = 0x0106,
+CMD_VERSION = 0x0107,
+CMD_STATUS = 0x0108,
+CMD_PING = 0x0109,
+CMD_FLASHSTORE_WRITE = 0x010D,
+CMD_FLASHSTORE_READ = 0x010E,
+CMD_FLASHSTORE_INFO = 0x010F,
+CMD_FRAME_NEGOTIATE = 0x010A,
+CMD_TAG_POLL_CONFIG = 0x010B,
+CMD_TAG_POLL_EVENT = 0x010C,
+CMD_EXEC_BATCH = 0x0110,
+CMD_PROGRESS_REPORT = 0x0112,
+CMD_EML_GET_HASHES = 0x0111,
+CMD_STANDALONE_PROG = 0x0113,
+CMD_STANDALONE_RESULT = 0x0114,
+CMD_EVENT_JOURNAL = 0x0115,
+CMD_MIFARE_SIM_HOOKS = 0x0116,
+CMD_INTERLEAVED_SCAN = 0x0117,
+CMD_SET_ADC_MUX = 0x020F,
+CMD_SMART_RAW = 0x0140,
+CMD_SMART_UPGRADE = 0x0141,
+CMD_SMART_UPLOAD = 0x0142,
+CMD_SMART_ATR = 0x0143,
+CMD_SMART_SETBAUD = 0x0144,
+CMD_SMART_SETCLOCK = 0x0145,
+CMD_READ_TI_TYPE = 0x0202,
+CMD_WRITE_TI_TYPE = 0x0203,
+CMD_DOWNLOADED_RAW_BITS_TI_TYPE = 0x0204,
+CMD_ACQUIRE_RAW_ADC_SAMPLES_125K = 0x0205,
+CMD_MOD_THEN_ACQUIRE_RAW_ADC_SAMPLES_125K = 0x0206,
+CMD_DOWNLOAD_RAW_ADC_SAMPLES_125K = 0x0207,
+CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K = 0x0208,
+CMD_DOWNLOADED_SIM_SAMPLES_125K = 0x0209,
+CMD_SIMULATE_TAG_125K = 0x020A,
+CMD_HID_DEMOD_FSK = 0x020B,
+CMD_HID_SIM_TAG = 0x020C,
+CMD_SET_LF_DIVISOR = 0x020D,
+CMD_LF_SIMULATE_BIDIR = 0x020E,
+CMD_HID_CLONE_TAG = 0x0210,
+CMD_EM410X_WRITE_TAG = 0x0211,
+CMD_INDALA_CLONE_TAG = 0x0212,
+CMD_INDALA_CLONE_TAG_L = 0x0213,
+CMD_T55XX_READ_BLOCK = 0x0214,
+CMD_T55XX_WRITE_BLOCK = 0x0215,
+CMD_T55XX_RESET_READ = 0x0216,
+CMD_PCF7931_READ = 0x0217,
+CMD_PCF7931_WRITE = 0x0222,
+CMD_PCF7931_BRUTEFORCE = 0x0227,
+CMD_EM4X_READ_WORD = 0x0218,
+CMD_EM4X_WRITE_WORD = 0x0219,
+CMD_IO_DEMOD_FSK = 0x021A,
+CMD_IO_CLONE_TAG = 0x021B,
+CMD_EM410X_DEMOD = 0x021c,
+CMD_SET_LF_SAMPLING_CONFIG = 0x021d,
+CMD_FSK_SIM_TAG = 0x021E,
+CMD_ASK_SIM_TAG = 0x021F,
+CMD_PSK_SIM_TAG = 0x0220,
+CMD_AWID_DEMOD_FSK = 0x0221,
+CMD_VIKING_CLONE_TAG = 0x0223,
+CMD_T55XX_WAKEUP = 0x0224,
+CMD_COTAG = 0x0225,
+CMD_PARADOX_CLONE_TAG = 0x0226,
+CMD_T55XX_CHK_PWDS = 0x022F,
+CMD_EM4X_PROTECT = 0x0228,
+CMD_DOWNLOADED_COMPRESSED_ADC_SAMPLES_125K = 0x0229,
+CMD_LF_STREAM_RAW_ADC_SAMPLES = 0x022A,
+CMD_LF_SNOOP_SMART_ADC_SAMPLES = 0x022B,
+CMD_LF_SYNTH_SIM = 0x022C,
+CMD_T55XX_WRITE_BLOCK_BULK = 0x0230,
+CMD_HID_BEACON = 0x022D,
+CMD_HID_BEACON_EVENT = 0x022E,
+CMD_ACQUIRE_RAW_ADC_SAMPLES_ISO_15693 = 0x0300,
+CMD_READ_SRI512_TAG = 0x0303,
+CMD_READ_SRIX4K_TAG = 0x0304,
+CMD_ISO_14443B_COMMAND = 0x0305,
+CMD_READER_ISO_14443B_INVENTORY = 0x0306,
+CMD_READER_ISO_15693 = 0x0310,
+CMD_SIMTAG_ISO_15693 = 0x0311,
+CMD_SNOOP_ISO_15693 = 0x0312,
+CMD_ISO_15693_COMMAND = 0x0313,
+CMD_ISO_15693_COMMAND_DONE = 0x0314,
+CMD_ISO_15693_FIND_AFI = 0x0315,
+CMD_ISO_15693_DEBUG = 0x0316,
+CMD_LF_SNOOP_RAW_ADC_SAMPLES = 0x0317,
+CMD_CSETUID_ISO_15693 = 0x0318,
+CMD_ISO_15693_EML_MEMSET = 0x0320,
+CMD_ISO_15693_EML_MEMGET = 0x0321,
+CMD_ISO_15693_INVENTORY = 0x0322,
+CMD_SNOOP_HITAG = 0x0370,
+CMD_SIMULATE_HITAG = 0x0371,
+CMD_READER_HITAG = 0x0372,
+CMD_SIMULATE_HITAG_S = 0x0368,
+CMD_TEST_HITAGS_TRACES = 0x0367,
+CMD_READ_HITAG_S = 0x0373,
+CMD_READ_HITAG_S_BLK = 0x0374,
+CMD_WR_HITAG_S = 0x0375,
+CMD_EMU_HITAG_S = 0x0376,
+CMD_SIMULATE_TAG_ISO_14443B = 0x0381,
+CMD_SNOOP_ISO_14443B = 0x0382,
+CMD_SNOOP_ISO_14443a = 0x0383,
+CMD_SIMULATE_TAG_ISO_14443a = 0x0384,
+CMD_READER_ISO_14443a = 0x0385,
+CMD_READER_ISO_14443A_APDU_BATCH = 0x038D,
+CMD_READER_ISO_14443A_INVENTORY = 0x038E,
+CMD_READER_ISO_14443A_TIMING = 0x038F,
+CMD_TOPAZ_READ_ALL = 0x03A0,
+CMD_DOWNLOADED_TRACE = 0x038C,
+CMD_SIMULATE_TAG_LEGIC_RF = 0x0387,
+CMD_READER_LEGIC_RF = 0x0388,
+CMD_WRITER_LEGIC_RF = 0x0389,
+CMD_EPA_PACE_COLLECT_NONCE = 0x038A,
+CMD_EPA_PACE_REPLAY = 0x038B,
+CMD_EPA_PACE_COLLECT_NONCE_BATCH = 0x0386,
+CMD_ICLASS_CLONE = 0x0390,
+CMD_ICLASS_DUMP = 0x0391,
+CMD_SNOOP_ICLASS = 0x0392,
+CMD_SIMULATE_TAG_ICLASS = 0x0393,
+CMD_READER_ICLASS = 0x0394,
+CMD_READER_ICLASS_REPLAY = 0x0395,
+CMD_ICLASS_READBLOCK = 0x0396,
+CMD_ICLASS_WRITEBLOCK = 0x0397,
+CMD_ICLASS_EML_MEMSET = 0x0398,
+CMD_ICLASS_CHECK = 0x0399,
+CMD_ICLASS_READCHECK = 0x039A,
+CMD_MEASURE_ANTENNA_TUNING = 0x0400,
+CMD_MEASURE_ANTENNA_TUNING_HF = 0x0401,
+CMD_ANTENNA_TELEMETRY = 0x0402,
+CMD_ANTENNA_TELEMETRY_SAMPLE = 0x0411,
+CMD_MEASURED_ANTENNA_TUNING = 0x0410,
+CMD_LISTEN_READER_FIELD = 0x0420,
+CMD_FPGA_MAJOR_MODE_OFF = 0x0500,
+CMD_MIFARE_SET_DBGMODE = 0x0600,
+CMD_MIFARE_EML_MEMCLR = 0x0601,
+CMD_MIFARE_EML_MEMSET = 0x0602,
+CMD_MIFARE_EML_MEMGET = 0x0603,
+CMD_MIFARE_EML_CARDLOAD = 0x0604,
+CMD_MIFARE_EML_LOAD = 0x0609,
+CMD_MIFARE_EML_PERSONA = 0x060a,
+CMD_MIFARE_CSETBLOCK = 0x0605,
+CMD_MIFARE_CGETBLOCK = 0x0606,
+CMD_MIFARE_CIDENT = 0x0607,
+CMD_MIFARE_CWIPE = 0x0608,
+CMD_SIMULATE_MIFARE_CARD = 0x0610,
+CMD_READER_MIFARE = 0x0611,
+CMD_MIFARE_NESTED = 0x0612,
+CMD_MIFARE_ACQUIRE_ENCRYPTED_NONCES = 0x0613,
+CMD_MIFARE_READBL = 0x0620,
+CMD_MIFARE_READSC = 0x0621,
+CMD_MIFARE_WRITEBL = 0x0622,
+CMD_MIFARE_CHKKEYS = 0x0623,
+CMD_MIFARE_PERSONALIZE_UID = 0x0624,
+CMD_MIFARE_CHKKEYS_LOAD = 0x0625,
+CMD_MIFARE_CHKKEYS_CACHED = 0x0626,
+CMD_MIFARE_READCARD = 0x0627,
+CMD_MIFARE_SNIFFER = 0x0630,
+CMD_MIFARE_COMM_STATS = 0x0631,
+CMD_MIFAREU_READBL = 0x0720,
+CMD_MIFAREU_READCARD = 0x0721,
+CMD_MIFAREU_WRITEBL = 0x0722,
+CMD_MIFAREU_WRITEBL_COMPAT = 0x0723,
+CMD_MIFAREUC_AUTH = 0x0724,
+CMD_MIFAREUC_SETPWD = 0x0727,
+CMD_MIFARE_DESFIRE_READBL = 0x0728,
+CMD_MIFARE_DESFIRE_WRITEBL = 0x0729,
+CMD_MIFARE_DESFIRE_AUTH1 = 0x072a,
+CMD_MIFARE_DESFIRE_AUTH2 = 0x072b,
+CMD_MIFARE_DES_READER = 0x072c,
+CMD_MIFARE_DESFIRE_INFO = 0x072d,
+CMD_MIFARE_DESFIRE = 0x072e,
+CMD_MIFAREU_EV1_PWD_CHECK = 0x072f,
+CMD_HF_SNIFFER = 0x0800,
+CMD_HF_PLOT = 0x0801,
+CMD_UNKNOWN = 0xFFFF,
+}
+return __commands
@@ -0,0 +1,223 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Cross-run store for recovered Mifare Classic keys
+//-----------------------------------------------------------------------------
+
+#include "keydb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ui.h"
+#include "util.h"
+
+#define KEYDB_MAGIC		"MFK1"
+#define KEYDB_MAGIC_LEN	4
+
+typedef struct {
+	char magic[KEYDB_MAGIC_LEN];
+	uint32_t reserved;
+} keydb_header_t;
+
+typedef struct {
+	uint32_t uid;
+	uint32_t when;		// unix time of the recovery
+	uint8_t sector;
+	uint8_t keytype;
+	uint8_t key[6];
+} keydb_rec_t;			// 16 bytes, fixed layout
+
+// the whole log, in file order, plus a hash index over (uid, sector, key
+// type). A slot holds record index + 1 so 0 can mean empty; a record that
+// shadows an older one for the same triple simply takes over its slot.
+static keydb_rec_t *records = NULL;
+static uint32_t record_count = 0;
+static uint32_t record_capacity = 0;
+static uint32_t *slots = NULL;
+static uint32_t slot_count = 0;
+static bool loaded = false;
+
+static uint32_t keydb_hash(uint32_t uid, uint8_t sectorNo, uint8_t keyType) {
+	uint32_t h = uid ^ ((uint32_t)sectorNo << 8) ^ keyType;
+	h *= 2654435761u;	// Knuth multiplicative hash
+	return h ^ (h >> 16);
+}
+
+// place record index idx into the hash index (idx must refer to records[])
+static void keydb_index_insert(uint32_t idx) {
+	keydb_rec_t *r = &records[idx];
+	uint32_t s = keydb_hash(r->uid, r->sector, r->keytype) & (slot_count - 1);
+	while (slots[s] != 0) {
+		keydb_rec_t *o = &records[slots[s] - 1];
+		if (o->uid == r->uid && o->sector == r->sector && o->keytype == r->keytype)
+			break;	// newer record for the same triple shadows the old one
+		s = (s + 1) & (slot_count - 1);
+	}
+	slots[s] = idx + 1;
+}
+
+// (re)build the index with room for count records at < 50% load
+static int keydb_index_rebuild(uint32_t count) {
+	uint32_t n = 64;
+	while (n < count * 2)
+		n *= 2;
+	uint32_t *p = calloc(n, sizeof(uint32_t));
+	if (p == NULL)
+		return 1;
+	free(slots);
+	slots = p;
+	slot_count = n;
+	for (uint32_t i = 0; i < record_count; i++)
+		keydb_index_insert(i);
+	return 0;
+}
+
+static keydb_rec_t *keydb_find(uint32_t uid, uint8_t sectorNo, uint8_t keyType) {
+	if (slot_count == 0)
+		return NULL;
+	uint32_t s = keydb_hash(uid, sectorNo, keyType) & (slot_count - 1);
+	while (slots[s] != 0) {
+		keydb_rec_t *r = &records[slots[s] - 1];
+		if (r->uid == uid && r->sector == sectorNo && r->keytype == keyType)
+			return r;
+		s = (s + 1) & (slot_count - 1);
+	}
+	return NULL;
+}
+
+static void keydb_load(void) {
+
+	if (loaded)
+		return;
+	loaded = true;
+
+	FILE *f = fopen(KEYDB_FILE, "rb");
+	if (f == NULL)
+		return;		// no history yet
+
+	keydb_header_t header;
+	if (fread(&header, sizeof(header), 1, f) != 1
+			|| memcmp(header.magic, KEYDB_MAGIC, KEYDB_MAGIC_LEN) != 0) {
+		PrintAndLog("Warning: %s is not a key db, ignoring it", KEYDB_FILE);
+		fclose(f);
+		return;
+	}
+
+	record_capacity = 64;
+	records = calloc(record_capacity, sizeof(keydb_rec_t));
+	if (records == NULL) {
+		fclose(f);
+		return;
+	}
+
+	keydb_rec_t rec;
+	// a torn trailing record (interrupted write) reads short and is dropped
+	while (fread(&rec, sizeof(rec), 1, f) == 1) {
+		if (record_count == record_capacity) {
+			record_capacity *= 2;
+			keydb_rec_t *p = realloc(records, record_capacity * sizeof(keydb_rec_t));
+			if (p == NULL)
+				break;
+			records = p;
+		}
+		records[record_count++] = rec;
+	}
+	fclose(f);
+
+	keydb_index_rebuild(record_count);
+}
+
+// append one record to the log, creating the file (with header) on first use
+static int keydb_append(const keydb_rec_t *rec) {
+
+	FILE *f = fopen(KEYDB_FILE, "ab");
+	if (f == NULL) {
+		PrintAndLog("Could not write to %s", KEYDB_FILE);
+		return 1;
+	}
+	if (ftell(f) == 0) {
+		keydb_header_t header;
+		memcpy(header.magic, KEYDB_MAGIC, KEYDB_MAGIC_LEN);
+		header.reserved = 0;
+		fwrite(&header, sizeof(header), 1, f);
+	}
+	fwrite(rec, sizeof(keydb_rec_t), 1, f);
+	fclose(f);
+	return 0;
+}
+
+void keyDbRecord(uint32_t uid, uint8_t sectorNo, uint8_t keyType, uint64_t key) {
+
+	if (uid == 0)
+		return;
+
+	keydb_load();
+
+	keydb_rec_t rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.uid = uid;
+	rec.when = (uint32_t)time(NULL);
+	rec.sector = sectorNo;
+	rec.keytype = keyType;
+	num_to_bytes(key, 6, rec.key);
+
+	keydb_rec_t *old = keydb_find(uid, sectorNo, keyType);
+	if (old != NULL && memcmp(old->key, rec.key, 6) == 0)
+		return;		// already on record
+
+	if (keydb_append(&rec))
+		return;
+
+	if (record_count == record_capacity) {
+		uint32_t cap = record_capacity ? record_capacity * 2 : 64;
+		keydb_rec_t *p = realloc(records, cap * sizeof(keydb_rec_t));
+		if (p == NULL)
+			return;	// on disk but not indexed - picked up next run
+		records = p;
+		record_capacity = cap;
+	}
+	records[record_count++] = rec;
+
+	if (record_count * 2 > slot_count)
+		keydb_index_rebuild(record_count);
+	else
+		keydb_index_insert(record_count - 1);
+}
+
+bool keyDbLookup(uint32_t uid, uint8_t sectorNo, uint8_t keyType, uint64_t *key) {
+
+	keydb_load();
+
+	keydb_rec_t *r = keydb_find(uid, sectorNo, keyType);
+	if (r == NULL)
+		return false;
+	*key = bytes_to_num(r->key, 6);
+	return true;
+}
+
+uint32_t keyDbKeysForUid(uint32_t uid, uint8_t *keyBlock, uint32_t maxKeys) {
+
+	keydb_load();
+
+	uint32_t n = 0;
+	for (uint32_t i = record_count; i > 0 && n < maxKeys; i--) {
+		keydb_rec_t *r = &records[i - 1];
+		if (r->uid != uid)
+			continue;
+		bool dup = false;
+		for (uint32_t j = 0; j < n; j++) {
+			if (memcmp(keyBlock + 6 * j, r->key, 6) == 0) {
+				dup = true;
+				break;
+			}
+		}
+		if (!dup)
+			memcpy(keyBlock + 6 * n++, r->key, 6);
+	}
+	return n;
+}
@@ -0,0 +1,36 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Cross-run store for recovered Mifare Classic keys. Every key recovered by
+// darkside, nested, hardnested or 'hf mf chk' is appended to a small binary
+// log together with the card UID, sector, key type and a timestamp. The log
+// is consulted before an expensive attack is launched, so a card that was
+// cracked in an earlier session is never cracked again. Append-only writes
+// keep the file crash safe; an in-memory hash index over (uid, sector, key
+// type) makes lookups O(1), with later records shadowing earlier ones.
+//-----------------------------------------------------------------------------
+
+#ifndef KEYDB_H
+#define KEYDB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define KEYDB_FILE	"pm3_keys.db"
+
+// record a recovered key for (uid, sector, key type). Appends to the log
+// only when the key differs from the one already on record. keyType: 0 = A,
+// 1 = B. A uid of 0 (no card selected) is ignored.
+extern void keyDbRecord(uint32_t uid, uint8_t sectorNo, uint8_t keyType, uint64_t key);
+
+// fetch the most recently recorded key for (uid, sector, key type).
+// Returns false when nothing is on record.
+extern bool keyDbLookup(uint32_t uid, uint8_t sectorNo, uint8_t keyType, uint64_t *key);
+
+// copy every distinct key ever recorded for uid into keyBlock (6 bytes
+// each, newest first). Returns the number of keys copied, at most maxKeys.
+extern uint32_t keyDbKeysForUid(uint32_t uid, uint8_t *keyBlock, uint32_t maxKeys);
+
+#endif
@@ -0,0 +1,255 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Binary indexed key dictionaries for 'hf mf chk'
+//-----------------------------------------------------------------------------
+
+#include "mfdict.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ui.h"
+#include "util.h"
+
+
+// sort/search order of a dictionary: by key bytes
+static int compare_entries(const void *a, const void *b) {
+	return memcmp(((const mfdict_entry_t *)a)->key, ((const mfdict_entry_t *)b)->key, 6);
+}
+
+// most hits first, for mfdictGetKeysByHits
+static int compare_hits(const void *a, const void *b) {
+	uint32_t ha = ((const mfdict_entry_t *)a)->hits;
+	uint32_t hb = ((const mfdict_entry_t *)b)->hits;
+	if (ha < hb) return 1;
+	if (ha > hb) return -1;
+	return compare_entries(a, b);
+}
+
+
+int mfdictImport(const char *textfile, const char *dictfile) {
+
+	FILE *f = fopen(textfile, "r");
+	if (f == NULL) {
+		PrintAndLog("File: %s: not found or locked.", textfile);
+		return 1;
+	}
+
+	uint32_t capacity = 64;
+	uint32_t count = 0;
+	mfdict_entry_t *entries = calloc(capacity, sizeof(mfdict_entry_t));
+	if (entries == NULL) {
+		fclose(f);
+		return 2;
+	}
+
+	char buf[13];
+	while (fgets(buf, sizeof(buf), f)) {
+		if (strlen(buf) < 12 || buf[11] == '\n')
+			continue;
+
+		while (fgetc(f) != '\n' && !feof(f)) ;  //goto next line
+
+		if( buf[0]=='#' ) continue; //The line start with # is comment, skip
+
+		bool content_error = false;
+		for (int i = 0; i < 12; i++) {
+			if (!isxdigit((unsigned char)buf[i])) {
+				content_error = true;
+			}
+		}
+		if (content_error) {
+			PrintAndLog("File content error. '%s' must include 12 HEX symbols", buf);
+			continue;
+		}
+
+		buf[12] = 0;
+
+		if (count == capacity) {
+			capacity *= 2;
+			entries = realloc(entries, capacity * sizeof(mfdict_entry_t));
+			if (entries == NULL) {
+				fclose(f);
+				return 2;
+			}
+		}
+		memset(&entries[count], 0, sizeof(mfdict_entry_t));
+		num_to_bytes(strtoll(buf, NULL, 16), 6, entries[count].key);
+		count++;
+		memset(buf, 0, sizeof(buf));
+	}
+	fclose(f);
+
+	if (count == 0) {
+		PrintAndLog("No keys found in %s", textfile);
+		free(entries);
+		return 1;
+	}
+
+	// sort and deduplicate
+	qsort(entries, count, sizeof(mfdict_entry_t), compare_entries);
+	uint32_t unique = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		if (i == 0 || compare_entries(&entries[i], &entries[i-1]) != 0)
+			entries[unique++] = entries[i];
+	}
+
+	// carry the hit counters over from a previous version of the dictionary
+	mfdict_t *old = mfdictOpen(dictfile);
+	if (old != NULL) {
+		for (uint32_t i = 0; i < old->count; i++) {
+			mfdict_entry_t *e = bsearch(&old->entries[i], entries, unique, sizeof(mfdict_entry_t), compare_entries);
+			if (e != NULL)
+				e->hits = old->entries[i].hits;
+		}
+		mfdictClose(old);
+	}
+
+	FILE *fout = fopen(dictfile, "wb");
+	if (fout == NULL) {
+		PrintAndLog("Could not create file %s", dictfile);
+		free(entries);
+		return 1;
+	}
+	mfdict_header_t header;
+	memcpy(header.magic, MFDICT_MAGIC, MFDICT_MAGIC_LEN);
+	header.count = unique;
+	fwrite(&header, sizeof(header), 1, fout);
+	fwrite(entries, sizeof(mfdict_entry_t), unique, fout);
+	fclose(fout);
+	free(entries);
+
+	PrintAndLog("Imported %u unique key(s) (%u duplicate(s) dropped) into %s", unique, count - unique, dictfile);
+	return 0;
+}
+
+
+mfdict_t *mfdictOpen(const char *path) {
+
+	mfdict_t *dict = calloc(1, sizeof(mfdict_t));
+	if (dict == NULL)
+		return NULL;
+	strncpy(dict->path, path, sizeof(dict->path) - 1);
+
+	mfdict_header_t header;
+
+#if !defined(_WIN32)
+	dict->fd = open(path, O_RDWR);
+	if (dict->fd < 0) {
+		free(dict);
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(dict->fd, &st) != 0
+			|| (size_t)st.st_size < sizeof(mfdict_header_t)
+			|| read(dict->fd, &header, sizeof(header)) != sizeof(header)
+			|| memcmp(header.magic, MFDICT_MAGIC, MFDICT_MAGIC_LEN) != 0
+			|| (size_t)st.st_size < sizeof(mfdict_header_t) + header.count * sizeof(mfdict_entry_t)) {
+		close(dict->fd);
+		free(dict);
+		return NULL;
+	}
+	dict->maplen = st.st_size;
+	uint8_t *map = mmap(NULL, dict->maplen, PROT_READ | PROT_WRITE, MAP_SHARED, dict->fd, 0);
+	if (map == MAP_FAILED) {
+		close(dict->fd);
+		free(dict);
+		return NULL;
+	}
+	dict->mapped = true;
+	dict->entries = (mfdict_entry_t *)(map + sizeof(mfdict_header_t));
+	dict->count = header.count;
+#else
+	// no mmap on mingw - load the records into memory and write them back on close
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		free(dict);
+		return NULL;
+	}
+	if (fread(&header, sizeof(header), 1, f) != 1
+			|| memcmp(header.magic, MFDICT_MAGIC, MFDICT_MAGIC_LEN) != 0) {
+		fclose(f);
+		free(dict);
+		return NULL;
+	}
+	dict->entries = calloc(header.count, sizeof(mfdict_entry_t));
+	if (dict->entries == NULL
+			|| fread(dict->entries, sizeof(mfdict_entry_t), header.count, f) != header.count) {
+		free(dict->entries);
+		fclose(f);
+		free(dict);
+		return NULL;
+	}
+	fclose(f);
+	dict->count = header.count;
+#endif
+
+	return dict;
+}
+
+
+void mfdictClose(mfdict_t *dict) {
+
+	if (dict == NULL)
+		return;
+
+#if !defined(_WIN32)
+	uint8_t *map = (uint8_t *)dict->entries - sizeof(mfdict_header_t);
+	if (dict->dirty)
+		msync(map, dict->maplen, MS_SYNC);
+	munmap(map, dict->maplen);
+	close(dict->fd);
+#else
+	if (dict->dirty) {
+		FILE *f = fopen(dict->path, "rb+");
+		if (f != NULL) {
+			fseek(f, sizeof(mfdict_header_t), SEEK_SET);
+			fwrite(dict->entries, sizeof(mfdict_entry_t), dict->count, f);
+			fclose(f);
+		}
+	}
+	free(dict->entries);
+#endif
+
+	free(dict);
+}
+
+
+void mfdictGetKeysByHits(mfdict_t *dict, uint8_t *keyBlock) {
+
+	mfdict_entry_t *sorted = calloc(dict->count, sizeof(mfdict_entry_t));
+	if (sorted == NULL) {	// keep the on-disk (key) order then
+		for (uint32_t i = 0; i < dict->count; i++)
+			memcpy(keyBlock + 6 * i, dict->entries[i].key, 6);
+		return;
+	}
+	memcpy(sorted, dict->entries, dict->count * sizeof(mfdict_entry_t));
+	qsort(sorted, dict->count, sizeof(mfdict_entry_t), compare_hits);
+	for (uint32_t i = 0; i < dict->count; i++)
+		memcpy(keyBlock + 6 * i, sorted[i].key, 6);
+	free(sorted);
+}
+
+
+bool mfdictRecordHit(mfdict_t *dict, const uint8_t key[6]) {
+
+	mfdict_entry_t probe = {{0}};
+	memcpy(probe.key, key, 6);
+	mfdict_entry_t *e = bsearch(&probe, dict->entries, dict->count, sizeof(mfdict_entry_t), compare_entries);
+	if (e == NULL)
+		return false;
+	e->hits++;
+	dict->dirty = true;
+	return true;
+}
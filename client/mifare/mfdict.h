@@ -0,0 +1,65 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Binary indexed key dictionaries for 'hf mf chk'. A dictionary is a sorted,
+// deduplicated array of fixed size records (key + hit counter), so lookups
+// are a binary search and the whole file can be mapped read/write. The hit
+// counters persist across runs and are used to try the historically most
+// successful keys first.
+//-----------------------------------------------------------------------------
+
+#ifndef MFDICT_H
+#define MFDICT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MFDICT_MAGIC		"MFD1"
+#define MFDICT_MAGIC_LEN	4
+
+typedef struct {
+	char magic[MFDICT_MAGIC_LEN];
+	uint32_t count;
+} mfdict_header_t;
+
+typedef struct {
+	uint8_t key[6];
+	uint8_t reserved[2];
+	uint32_t hits;
+} mfdict_entry_t;		// 12 bytes, fixed layout, little endian counter
+
+typedef struct {
+	mfdict_entry_t *entries;
+	uint32_t count;
+	bool dirty;
+	char path[2000];	// FILE_PATH_SIZE
+#if !defined(_WIN32)
+	int fd;
+	size_t maplen;
+	bool mapped;
+#endif
+} mfdict_t;
+
+// convert a text dictionary (12 hex digits per line, '#' comments) to the
+// binary format, deduplicating the keys. If dictfile already exists, the hit
+// counters of keys present in both are carried over.
+extern int mfdictImport(const char *textfile, const char *dictfile);
+
+// open a binary dictionary read/write (mapped where the platform allows it).
+// Returns NULL if the file is missing or does not carry the magic.
+extern mfdict_t *mfdictOpen(const char *path);
+
+// write back the hit counters (if needed) and release the dictionary
+extern void mfdictClose(mfdict_t *dict);
+
+// copy all keys into keyBlock (6 bytes each), most-hit keys first
+extern void mfdictGetKeysByHits(mfdict_t *dict, uint8_t *keyBlock);
+
+// count a successful authentication against key. Returns false if the key is
+// not part of the dictionary.
+extern bool mfdictRecordHit(mfdict_t *dict, const uint8_t key[6]);
+
+#endif
@@ -22,10 +22,15 @@
 #include "ui.h"
 #include "parity.h"
 #include "util.h"
+#include "crc32.h"
 #include "iso14443crc.h"
 
 #include "mifare.h"
 #include "mifare4.h"
+#include "zlib.h"
+#ifdef crc32
+#undef crc32	// zlib's Z_PREFIX mapping; we use common/crc32.c here
+#endif
 
 // mifare tracer flags used in mfTraceDecode()
 #define TRACE_IDLE		 				0x00
@@ -226,6 +231,25 @@ int mfDarkside(uint64_t *key)
 	return 0;
 }
 
+// select the card in the field and return the 4 byte uid the crypto runs on
+// (the tail of the full uid for 7 and 10 byte cards - same as the ARM side).
+// Returns 0 on success.
+int mfGetUid(uint32_t *uid) {
+
+	UsbCommand c = {CMD_READER_ISO_14443a, {ISO14A_CONNECT, 0, 0}};
+	SendCommand(&c);
+
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 2500)) return 1;
+	if (resp.arg[0] == 0) return 2;		// no card in field
+
+	iso14a_card_select_t card;
+	memcpy(&card, resp.d.asBytes, sizeof(card));
+	if (card.uidlen < 4 || card.uidlen > 10) return 2;
+	*uid = (uint32_t)bytes_to_num(card.uid + card.uidlen - 4, 4);
+	return 0;
+}
+
 
 int mfCheckKeys (uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t keycnt, uint8_t * keyBlock, uint64_t * key){
 
@@ -271,6 +295,54 @@ int mfCheckKeysSec(uint8_t sectorCnt, uint8_t keyType, uint8_t timeout14a, bool
 	return foundAKey ? 0 : 3;
 }
 
+// upload a key dictionary into the BigBuf resident cache on the device,
+// USB_CMD_DATA_SIZE/6 keys per chunk
+int mfCheckKeysLoad(uint8_t *keyBlock, uint32_t keycnt) {
+
+	if (keycnt == 0 || keycnt > 0xffff)
+		return 2;
+
+	for (uint32_t c = 0; c < keycnt; c += USB_CMD_DATA_SIZE / 6) {
+		uint32_t size = MIN(keycnt - c, USB_CMD_DATA_SIZE / 6);
+		UsbCommand cmd = {CMD_MIFARE_CHKKEYS_LOAD, {c, size, keycnt}};
+		memcpy(cmd.d.asBytes, keyBlock + 6 * c, 6 * size);
+		SendCommand(&cmd);
+
+		UsbCommand resp;
+		if (!WaitForResponseTimeout(CMD_ACK, &resp, 3000)) return 1;
+		if ((resp.arg[0] & 0xff) != 0x01) return 2;	// no room in BigBuf (or old firmware)
+	}
+	return 0;
+}
+
+// check the previously uploaded dictionary against all sectors and key types
+// in a single round trip
+int mfCheckKeysCached(uint8_t sectorCnt, uint8_t keyType, uint8_t timeout14a, bool clear_trace, uint32_t keycnt, sector_t * e_sector){
+
+	if (e_sector == NULL)
+		return -1;
+
+	UsbCommand c = {CMD_MIFARE_CHKKEYS_CACHED, {((sectorCnt & 0xff) | ((keyType & 0xff) << 8)), clear_trace | ((timeout14a & 0xff) << 8), 0}};
+	SendCommand(&c);
+
+	UsbCommand resp;
+	if (!WaitForResponseTimeoutW(CMD_ACK, &resp, MAX(3000, 1000 + 13 * sectorCnt * keycnt * (keyType == 2 ? 2 : 1)), false)) return 1; // timeout: 13 ms / fail auth
+	if ((resp.arg[0] & 0xff) != 0x01) return 2;
+
+	bool foundAKey = false;
+	for (int sec = 0; sec < sectorCnt; sec++){
+		for (int keyAB = 0; keyAB < 2; keyAB++){
+			int idx = keyAB * 40 + sec;
+			if (resp.d.asBytes[idx >> 3] & (1 << (idx & 0x07))){
+				e_sector[sec].foundKey[keyAB] = true;
+				e_sector[sec].Key[keyAB] = bytes_to_num(resp.d.asBytes + 10 + idx * 6, 6);
+				foundAKey = true;
+			}
+		}
+	}
+	return foundAKey ? 0 : 3;
+}
+
 // Compare 16 Bits out of cryptostate
 int Compare16Bits(const void * a, const void * b) {
 	if ((*(uint64_t*)b & 0x00ff000000ff0000) == (*(uint64_t*)a & 0x00ff000000ff0000)) return 0;
@@ -278,6 +350,66 @@ int Compare16Bits(const void * a, const void * b) {
 	else return -1;
 }
 
+typedef
+	struct {
+		uint64_t *list;
+		uint32_t len;
+		int (*compar)(const void *, const void *);
+	} SortJob_t;
+
+
+static void *sort_worker_thread(void *arg)
+{
+	SortJob_t *job = arg;
+	qsort(job->list, job->len, sizeof(uint64_t), job->compar);
+	return NULL;
+}
+
+
+// sort the two halves of the list on separate threads and merge them. Falls
+// back to a plain qsort for short lists or when no scratch memory is available.
+static void parallel_sort(uint64_t *list, uint32_t len, int (*compar)(const void *, const void *))
+{
+	uint64_t *scratch;
+	uint32_t half = len / 2;
+
+	if (len < 0x1000 || (scratch = malloc(len * sizeof(uint64_t))) == NULL) {
+		qsort(list, len, sizeof(uint64_t), compar);
+		return;
+	}
+
+	SortJob_t jobs[2] = {
+		{list, half, compar},
+		{list + half, len - half, compar}
+	};
+	pthread_t sort_thread;
+	pthread_create(&sort_thread, NULL, sort_worker_thread, &jobs[0]);
+	sort_worker_thread(&jobs[1]);
+	pthread_join(sort_thread, NULL);
+
+	uint32_t a = 0, b = half, n = 0;
+	while (a < half && b < len) {
+		if (compar(list + a, list + b) <= 0)
+			scratch[n++] = list[a++];
+		else
+			scratch[n++] = list[b++];
+	}
+	while (a < half) scratch[n++] = list[a++];
+	while (b < len)  scratch[n++] = list[b++];
+	memcpy(list, scratch, len * sizeof(uint64_t));
+	free(scratch);
+}
+
+
+// runs parallel_sort as a thread of its own, so two lists can be sorted
+// concurrently
+static void *parallel_sort_thread(void *arg)
+{
+	SortJob_t *job = arg;
+	parallel_sort(job->list, job->len, job->compar);
+	return NULL;
+}
+
 typedef
 	struct {
 		union {
@@ -313,7 +445,7 @@ __attribute__((force_align_arg_pointer))
 	for (p1 = statelist->head.slhead; *(uint64_t *)p1 != 0; p1++);
 	statelist->len = p1 - statelist->head.slhead;
 	statelist->tail.sltail = --p1;
-	qsort(statelist->head.slhead, statelist->len, sizeof(uint64_t), Compare16Bits);
+	parallel_sort(statelist->head.keyhead, statelist->len, Compare16Bits);
 
 	return statelist->head.slhead;
 }
@@ -405,9 +537,15 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
 	statelists[1].tail.sltail=--p4;
 
 	// the statelists now contain possible keys. The key we are searching for must be in the
-	// intersection of both lists. Create the intersection:
-	qsort(statelists[0].head.keyhead, statelists[0].len, sizeof(uint64_t), compare_uint64);
-	qsort(statelists[1].head.keyhead, statelists[1].len, sizeof(uint64_t), compare_uint64);
+	// intersection of both lists. Sort both lists concurrently, then create the intersection:
+	SortJob_t keysort[2] = {
+		{statelists[0].head.keyhead, statelists[0].len, compare_uint64},
+		{statelists[1].head.keyhead, statelists[1].len, compare_uint64}
+	};
+	pthread_t sort_thread;
+	pthread_create(&sort_thread, NULL, parallel_sort_thread, &keysort[0]);
+	parallel_sort(keysort[1].list, keysort[1].len, keysort[1].compar);
+	pthread_join(sort_thread, NULL);
 	statelists[0].len = intersection(statelists[0].head.keyhead, statelists[1].head.keyhead);
 
 	memset(resultKey, 0, 6);
@@ -475,6 +613,136 @@ int mfEmlSetMem(uint8_t *data, int blockNum, int blocksCount) {
 	return 0;
 }
 
+// zlib is built with Z_SOLO and needs explicit allocators
+static voidpf eml_zlib_malloc(voidpf opaque, uInt items, uInt size) {
+	return malloc(items * size);
+}
+
+static void eml_zlib_free(voidpf opaque, voidpf address) {
+	free(address);
+}
+
+// upload a whole emulator image as one stream of USB_CMD_DATA_SIZE chunks.
+// The image is deflated first; the small deflate window keeps the inflater
+// on the device within a 1kB BigBuf allocation next to the emulator memory.
+// Falls back to sending the raw image when compression doesn't help.
+int mfEmlLoadStream(uint8_t *data, uint32_t numBytes) {
+	uint8_t *compressed = malloc(numBytes + 64);
+	uint32_t compressedLen = 0;
+	if (compressed != NULL) {
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+		stream.zalloc = &eml_zlib_malloc;
+		stream.zfree = &eml_zlib_free;
+		if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 10, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+			stream.next_in = data;
+			stream.avail_in = numBytes;
+			stream.next_out = compressed;
+			stream.avail_out = numBytes + 64;
+			if (deflate(&stream, Z_FINISH) == Z_STREAM_END)
+				compressedLen = stream.total_out;
+			deflateEnd(&stream);
+		}
+	}
+
+	uint8_t *send_data = data;
+	uint32_t send_len = numBytes;
+	uint64_t flags = 0;
+	if (compressedLen > 0 && compressedLen < numBytes) {
+		send_data = compressed;
+		send_len = compressedLen;
+		flags = EML_LOAD_COMPRESSED;
+	}
+
+	uint32_t offset = 0;
+	while (offset < send_len) {
+		uint32_t chunk = send_len - offset;
+		if (chunk > USB_CMD_DATA_SIZE) chunk = USB_CMD_DATA_SIZE;
+		UsbCommand c = {CMD_MIFARE_EML_LOAD, {flags, offset, chunk}};
+		if (offset == 0) c.arg[0] |= EML_LOAD_FIRST;
+		if (offset + chunk == send_len) c.arg[0] |= EML_LOAD_FINAL;
+		memcpy(c.d.asBytes, send_data + offset, chunk);
+		SendCommand(&c);
+		offset += chunk;
+	}
+	free(compressed);
+
+	UsbCommand resp;
+	if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500)) return 1;
+	if (resp.arg[0] != 1 || resp.arg[1] != numBytes) return 2;
+	return 0;
+}
+
+// fetch per-16-byte-block CRC32 hashes of device emulator memory
+int mfEmlGetHashes(uint8_t *hashes, int blockNum, int blocksCount) {
+	while (blocksCount > 0) {
+		int chunk = blocksCount;
+		if (chunk > USB_CMD_DATA_SIZE / 4) chunk = USB_CMD_DATA_SIZE / 4;
+		UsbCommand c = {CMD_EML_GET_HASHES, {blockNum * 16, chunk, 0}};
+		SendCommand(&c);
+		UsbCommand resp;
+		if (!WaitForResponseTimeout(CMD_ACK, &resp, 1500)) return 1;
+		if (resp.arg[0] != (uint64_t)chunk) return 2;
+		memcpy(hashes, resp.d.asBytes, chunk * 4);
+		hashes += chunk * 4;
+		blockNum += chunk;
+		blocksCount -= chunk;
+	}
+	return 0;
+}
+
+// Diff-sync upload: compare per-block CRC32 hashes against the device and
+// transfer only blocks that differ - iterating on an image ('eload', tweak a
+// block, 'eload' again) then ships one block instead of the whole dump.
+// Falls back to a full stream load when the hashes are unavailable or most
+// of the image changed anyway.
+int mfEmlSyncMem(uint8_t *data, uint32_t numBytes) {
+	uint32_t numBlocks = numBytes / 16;
+	uint8_t *hashes = malloc(numBlocks * 4);
+	if (hashes == NULL || mfEmlGetHashes(hashes, 0, numBlocks)) {
+		free(hashes);
+		return mfEmlLoadStream(data, numBytes);
+	}
+
+	uint32_t changed = 0;
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		uint8_t crc[4];
+		crc32(data + i * 16, 16, crc);
+		if (memcmp(crc, hashes + i * 4, 4) != 0)
+			changed++;
+	}
+	if (changed > numBlocks / 4) {
+		free(hashes);
+		return mfEmlLoadStream(data, numBytes);
+	}
+
+	// send contiguous runs of changed blocks
+	uint32_t sent = 0;
+	for (uint32_t i = 0; i < numBlocks; ) {
+		uint8_t crc[4];
+		crc32(data + i * 16, 16, crc);
+		if (memcmp(crc, hashes + i * 4, 4) == 0) {
+			i++;
+			continue;
+		}
+		uint32_t run = i + 1;
+		while (run < numBlocks && run - i < USB_CMD_DATA_SIZE / 16) {
+			crc32(data + run * 16, 16, crc);
+			if (memcmp(crc, hashes + run * 4, 4) == 0) break;
+			run++;
+		}
+		if (mfEmlSetMem(data + i * 16, i, run - i)) {
+			free(hashes);
+			return 1;
+		}
+		sent += run - i;
+		i = run;
+	}
+	free(hashes);
+	PrintAndLog("Emulator sync: %u of %u blocks changed", sent, numBlocks);
+	return 0;
+}
+
 // "MAGIC" CARD
 
 int mfCGetBlock(uint8_t blockNo, uint8_t *data, uint8_t params) {
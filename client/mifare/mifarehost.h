@@ -38,14 +38,20 @@ typedef struct {
 extern char logHexFileName[FILE_PATH_SIZE];
 
 extern int mfDarkside(uint64_t *key);
+extern int mfGetUid(uint32_t *uid);
 extern int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *ResultKeys, bool calibrate);
 extern int mfCheckKeys (uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t keycnt, uint8_t *keyBlock, uint64_t *key);
 extern int mfCheckKeysSec(uint8_t sectorCnt, uint8_t keyType, uint8_t timeout14a, bool clear_trace, uint8_t keycnt, uint8_t * keyBlock, sector_t * e_sector);
+extern int mfCheckKeysLoad(uint8_t *keyBlock, uint32_t keycnt);
+extern int mfCheckKeysCached(uint8_t sectorCnt, uint8_t keyType, uint8_t timeout14a, bool clear_trace, uint32_t keycnt, sector_t * e_sector);
 
 extern int mfReadSector(uint8_t sectorNo, uint8_t keyType, uint8_t *key, uint8_t *data);
 
 extern int mfEmlGetMem(uint8_t *data, int blockNum, int blocksCount);
 extern int mfEmlSetMem(uint8_t *data, int blockNum, int blocksCount);
+extern int mfEmlLoadStream(uint8_t *data, uint32_t numBytes);
+extern int mfEmlGetHashes(uint8_t *hashes, int blockNum, int blocksCount);
+extern int mfEmlSyncMem(uint8_t *data, uint32_t numBytes);
 
 extern int mfCWipe(uint32_t numSectors, bool gen1b, bool wantWipe, bool wantFill);
 extern int mfCSetUID(uint8_t *uid, uint8_t *atqa, uint8_t *sak, uint8_t *oldUID);
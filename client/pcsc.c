@@ -37,6 +37,7 @@
 static SCARDCONTEXT SC_Context;
 static SCARDHANDLE SC_Card;
 static DWORD SC_Protocol;
+static bool SC_Connected = false;
 static char* AlternativeSmartcardReader = NULL;
 
 #define PCSC_MAX_TRACELEN 60000
@@ -126,6 +127,48 @@ static bool pcsc_LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timest
 }
 
 
+// Pooled connection: connect once and keep the handle across operations.
+// Connecting per APDU costs several round trips to the PC/SC daemon; with a
+// pooled handle only a cheap status check remains, and a reset card is
+// healed in place with SCardReconnect.
+static bool pcscEnsureConnected(void)
+{
+	if (SC_Connected) {
+		DWORD state, protocol, atr_len = 0;
+		DWORD readers_len = 0;
+		LONG res = SCardStatus(SC_Card, NULL, &readers_len, &state, &protocol, NULL, &atr_len);
+		if (res == SCARD_S_SUCCESS) {
+			return true;
+		}
+		if (res == SCARD_W_RESET_CARD
+				&& SCardReconnect(SC_Card, SCARD_SHARE_SHARED, SCARD_PROTOCOL_T0 | SCARD_PROTOCOL_T1,
+					SCARD_LEAVE_CARD, &SC_Protocol) == SCARD_S_SUCCESS) {
+			return true;
+		}
+		SCardDisconnect(SC_Card, SCARD_LEAVE_CARD);
+		SC_Connected = false;
+	}
+
+	LONG res = SCardConnect(SC_Context, AlternativeSmartcardReader, SCARD_SHARE_SHARED,
+	                        SCARD_PROTOCOL_T0 | SCARD_PROTOCOL_T1, &SC_Card, &SC_Protocol);
+	if (res != SCARD_S_SUCCESS) {
+		return false;
+	}
+
+	SC_Connected = true;
+	return true;
+}
+
+
+static void pcscDropConnection(void)
+{
+	if (SC_Connected) {
+		SCardDisconnect(SC_Card, SCARD_LEAVE_CARD);
+		SC_Connected = false;
+	}
+}
+
+
 char *getAlternativeSmartcardReader(void)
 {
 	return AlternativeSmartcardReader ? AlternativeSmartcardReader : PM3_SMARTCARD_DEFAULT_NAME;
@@ -269,6 +312,9 @@ bool pcscSelectAlternativeCardReader(const char *readername)
 		return false;
 	}
 
+	// the pooled handle belongs to the previous reader
+	pcscDropConnection();
+
 	free(AlternativeSmartcardReader);
 	AlternativeSmartcardReader = malloc((strlen(selected_readername) + 1) * sizeof(char));
 	strcpy(AlternativeSmartcardReader, selected_readername);
@@ -290,14 +336,12 @@ bool pcscGetATR(smart_card_atr_t *card)
 	card->atr_len = 0;
 	memset(card->atr, 0, sizeof(card->atr));
 
-	LONG res = SCardConnect(SC_Context, AlternativeSmartcardReader, SCARD_SHARE_SHARED,
-	                        SCARD_PROTOCOL_T0 | SCARD_PROTOCOL_T1, &SC_Card, &SC_Protocol);
-	if (res != SCARD_S_SUCCESS) {
+	if (!pcscEnsureConnected()) {
 		return false;
 	}
 
 	DWORD atr_len = sizeof(card->atr);
-	res = SCardGetAttrib(SC_Card, SCARD_ATTR_ATR_STRING, card->atr, &atr_len);
+	LONG res = SCardGetAttrib(SC_Card, SCARD_ATTR_ATR_STRING, card->atr, &atr_len);
 	if (res != SCARD_S_SUCCESS) {
 		return false;
 	}
@@ -326,9 +370,7 @@ void pcscTransmit(uint8_t *data, uint32_t data_len, uint32_t flags, uint8_t *res
 	pcsc_set_tracing(true);
 
 	if ((flags & SC_CONNECT || flags & SC_SELECT)) {
-		LONG res = SCardConnect(SC_Context, AlternativeSmartcardReader, SCARD_SHARE_SHARED,
-		                        SCARD_PROTOCOL_T0 | SCARD_PROTOCOL_T1, &SC_Card, &SC_Protocol);
-		if (res != SCARD_S_SUCCESS) {
+		if (!pcscEnsureConnected()) {
 			*response_len = -1;
 			return;
 		}
@@ -338,6 +380,11 @@ void pcscTransmit(uint8_t *data, uint32_t data_len, uint32_t flags, uint8_t *res
 		pcsc_LogTrace(data, data_len, 0, 0, true);
 		DWORD len = *response_len;
 		LONG res = SCardTransmit(SC_Card, protocol, data, data_len, NULL, response, &len);
+		if (res == SCARD_W_RESET_CARD && pcscEnsureConnected()) {
+			// card was reset behind our back - heal the pooled handle and retry once
+			len = *response_len;
+			res = SCardTransmit(SC_Card, protocol, data, data_len, NULL, response, &len);
+		}
 		if (res != SCARD_S_SUCCESS) {
 			*response_len = -1;
 		} else {
@@ -347,3 +394,45 @@ void pcscTransmit(uint8_t *data, uint32_t data_len, uint32_t flags, uint8_t *res
 	}
 	pcsc_set_tracing(false);
 }
+
+// Transmit a list of raw APDUs over the pooled connection: the handle is
+// validated once for the whole list instead of per exchange. SCardTransmit
+// itself stays synchronous (PC/SC offers no true pipelining), so this saves
+// the per-APDU connection overhead, not the card time. A failed exchange
+// gets response_len = -1 and the rest of the list still runs.
+void pcscTransmitBatch(pcsc_apdu_exchange_t *exchanges, size_t count, uint32_t flags)
+{
+	LPCSCARD_IO_REQUEST protocol;
+	if (flags & SC_RAW_T0) {
+		protocol = SCARD_PCI_T0;
+	} else {
+		protocol = SCARD_PCI_RAW;
+	}
+
+	if (!pcscEnsureConnected()) {
+		for (size_t i = 0; i < count; i++)
+			exchanges[i].response_len = -1;
+		return;
+	}
+
+	pcsc_set_tracing(true);
+
+	for (size_t i = 0; i < count; i++) {
+		pcsc_apdu_exchange_t *ex = &exchanges[i];
+		pcsc_LogTrace(ex->data, ex->data_len, 0, 0, true);
+		DWORD len = ex->response_len;
+		LONG res = SCardTransmit(SC_Card, protocol, ex->data, ex->data_len, NULL, ex->response, &len);
+		if (res == SCARD_W_RESET_CARD && pcscEnsureConnected()) {
+			len = ex->response_len;
+			res = SCardTransmit(SC_Card, protocol, ex->data, ex->data_len, NULL, ex->response, &len);
+		}
+		if (res != SCARD_S_SUCCESS) {
+			ex->response_len = -1;
+		} else {
+			pcsc_LogTrace(ex->response, len, 0, 0, false);
+			ex->response_len = len;
+		}
+	}
+
+	pcsc_set_tracing(false);
+}
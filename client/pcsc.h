@@ -13,8 +13,17 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "smartcard.h"
 
+// one APDU exchange within a batched transmit list
+typedef struct {
+	uint8_t *data;
+	uint32_t data_len;
+	uint8_t *response;
+	int response_len;	// in: size of the response buffer, out: bytes received or -1
+} pcsc_apdu_exchange_t;
+
 uint8_t *pcsc_get_trace_addr(void);
 uint32_t pcsc_get_traceLen(void);
 char *getAlternativeSmartcardReader(void);
@@ -22,5 +31,6 @@ bool pcscCheckForCardReaders(void);
 bool pcscSelectAlternativeCardReader(const char *readername);
 bool pcscGetATR(smart_card_atr_t *card);
 void pcscTransmit(uint8_t *data, uint32_t data_len, uint32_t flags, uint8_t *response, int *response_len);
+void pcscTransmitBatch(pcsc_apdu_exchange_t *exchanges, size_t count, uint32_t flags);
 
 #endif
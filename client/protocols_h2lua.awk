@@ -0,0 +1,37 @@
+BEGIN {
+	print "--[["
+	print "These are tag protocol constants (ISO14443A/B, ISO15693, iClass, Topaz, T55x7...)."
+	print "This file is automatically generated from protocols.h - DON'T EDIT MANUALLY."
+	print "--]]"
+	print "local __protocols = {}"
+}
+
+# object-like macros only: a name followed by '(' is a function-like macro
+# and has no Lua representation
+$1 == "#define" && $2 ~ /^[A-Za-z_][A-Za-z0-9_]*$/ && NF >= 3 {
+	sub(/\r/, "")
+	name = $2
+	val = $0
+	sub(/^[ \t]*#define[ \t]+[A-Za-z0-9_]+[ \t]+/, "", val)
+	sub(/[ \t]*\/\/.*$/, "", val)
+	sub(/[ \t]+$/, "", val)
+	if (val == "") next
+
+	if (val ~ /^(0[xX][0-9a-fA-F]+|[0-9]+)$/) {
+		print "__protocols." name " = " val
+	} else if (val ~ /^\(?1[ \t]*<<[ \t]*[0-9]+\)?$/) {
+		# the bundled Lua (5.2) has no shift operator - expand here
+		shift = val
+		gsub(/[^0-9<]/, "", shift)
+		sub(/^1<</, "", shift)
+		printf "__protocols.%s = 0x%X\n", name, 2 ^ shift
+	} else if (val ~ /^[A-Za-z_][A-Za-z0-9_]*$/) {
+		# alias of an earlier constant
+		print "__protocols." name " = __protocols." val
+	}
+	# anything else (compound expressions) is skipped
+}
+
+END {
+	print "return __protocols"
+}
@@ -8,18 +8,36 @@
 // GUI functions
 //-----------------------------------------------------------------------------
 
+#include <pthread.h>
+
 #include "proxgui.h"
 #include "proxguiqt.h"
 #include "proxmark3.h"
 
 static ProxGuiQT *gui = NULL;
-static WorkerThread *main_loop_thread = NULL;
+
+// Deferred Qt startup. The command loop runs in a worker thread while the
+// main thread parks on a condition variable; the QApplication (which must
+// live on the main thread) is only constructed once a command actually asks
+// for the plot window. A '-c' one-shot that never plots exits without ever
+// touching Qt.
+static int gui_argc;
+static char **gui_argv;
+static char *worker_script_cmds_file;
+static char *worker_script_cmd;
+static bool worker_usb_present;
+static pthread_t worker_thread;
+static pthread_mutex_t gui_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gui_cond = PTHREAD_COND_INITIALIZER;
+static bool main_parked = false;	// main thread waits in MainGraphics
+static bool gui_wanted = false;		// a command asked for the plot window
+static bool worker_done = false;	// main_loop returned
 
 WorkerThread::WorkerThread(char *script_cmds_file, char *script_cmd, bool usb_present) : script_cmds_file(script_cmds_file), script_cmd(script_cmd), usb_present(usb_present)
 {
 }
 
-WorkerThread::~WorkerThread() 
+WorkerThread::~WorkerThread()
 {
 }
 
@@ -27,11 +45,48 @@ void WorkerThread::run() {
 	main_loop(script_cmds_file, script_cmd, usb_present);
 }
 
+static void *worker_thread_main(void *arg)
+{
+	(void) arg;
+	main_loop(worker_script_cmds_file, worker_script_cmd, worker_usb_present);
+
+	pthread_mutex_lock(&gui_mutex);
+	worker_done = true;
+	ProxGuiQT *g = gui;
+	pthread_cond_broadcast(&gui_cond);
+	pthread_mutex_unlock(&gui_mutex);
+
+	// if Qt came up, its event loop owns the main thread now - tell it to quit
+	if (g)
+		g->Exit();
+	return NULL;
+}
+
+// Ask the main thread to bring up Qt and wait until it has (called from the
+// command thread on the first plot request). Returns false when no GUI can
+// be started in this invocation.
+static bool demandGui(void)
+{
+	pthread_mutex_lock(&gui_mutex);
+	if (!main_parked) {	// running without MainGraphics (no display)
+		pthread_mutex_unlock(&gui_mutex);
+		return false;
+	}
+	gui_wanted = true;
+	pthread_cond_broadcast(&gui_cond);
+	while (gui == NULL && !worker_done)
+		pthread_cond_wait(&gui_cond, &gui_mutex);
+	bool ok = gui != NULL;
+	pthread_mutex_unlock(&gui_mutex);
+	return ok;
+}
+
 extern "C" void ShowGraphWindow(void)
 {
-  if (!gui)
+  if (!gui && !demandGui())
     return;
 
+  GraphSnapshotPublish();
   gui->ShowGraphWindow();
 }
 
@@ -48,26 +103,45 @@ extern "C" void RepaintGraphWindow(void)
   if (!gui)
     return;
 
+  // publish a consistent frame for the plot thread before waking it; the
+  // live buffers may keep changing while the repaint is queued
+  GraphSnapshotPublish();
   gui->RepaintGraphWindow();
 }
 
 extern "C" void MainGraphics(void)
 {
-	if (!gui)
+	main_parked = true;
+	pthread_create(&worker_thread, NULL, worker_thread_main, NULL);
+
+	pthread_mutex_lock(&gui_mutex);
+	while (!gui_wanted && !worker_done)
+		pthread_cond_wait(&gui_cond, &gui_mutex);
+
+	if (worker_done) {	// never plotted - exit without Qt
+		pthread_mutex_unlock(&gui_mutex);
+		pthread_join(worker_thread, NULL);
 		return;
+	}
+
+	// first plot request: construct the Qt machinery on this (main) thread,
+	// wake the command thread and hand the thread to the Qt event loop
+	gui = new ProxGuiQT(gui_argc, gui_argv, NULL);
+	pthread_cond_broadcast(&gui_cond);
+	pthread_mutex_unlock(&gui_mutex);
 
 	gui->MainLoop();
+	pthread_join(worker_thread, NULL);
 }
 
 extern "C" void InitGraphics(int argc, char **argv, char *script_cmds_file, char *script_cmd, bool usb_present)
 {
-#ifdef Q_WS_X11
-	if (getenv("DISPLAY") == NULL)
-		return;
-#endif
-
-	main_loop_thread = new WorkerThread(script_cmds_file, script_cmd, usb_present);
-	gui = new ProxGuiQT(argc, argv, main_loop_thread);
+	// no Qt yet - just keep what a deferred startup will need
+	gui_argc = argc;
+	gui_argv = argv;
+	worker_script_cmds_file = script_cmds_file;
+	worker_script_cmd = script_cmd;
+	worker_usb_present = usb_present;
 }
 
 extern "C" void ExitGraphics(void)
@@ -27,6 +27,12 @@ extern int GraphBuffer[MAX_GRAPH_TRACE_LEN];
 extern int GraphTraceLen;
 extern int s_Buff[MAX_GRAPH_TRACE_LEN];
 
+// seqlock-published graph snapshot: the plot renders from a consistent copy
+// while demods mutate the live buffers (see graph.c)
+void GraphSnapshotPublish(void);
+unsigned int GraphSnapshotSeq(void);
+unsigned int GraphSnapshotRead(int *graph, int *overlay, int *len);
+
 extern double CursorScaleFactor;
 extern int PlotGridX, PlotGridY, PlotGridXdefault, PlotGridYdefault, CursorCPos, CursorDPos, GridOffset;
 extern int CommandFinished;
@@ -25,6 +25,7 @@
 #include <QHBoxLayout>
 #include <string.h>
 #include "proxgui.h"
+#include "spectrogram.h"
 #include <QtGui>
 
 extern "C" {
@@ -33,24 +34,41 @@ extern "C" {
 //#include <ctime>
 
 bool g_useOverlays = false;
+static bool g_showSpectrogram = false;
 int g_absVMax = 0;
 int startMax;  // Maximum offset in the graph (right side of graph)
 int PageWidth; // How many samples are currently visible on this 'page' / graph
 int unlockStart = 0;
 
+// Producer side of the op queue, called from the command thread. Never
+// blocks: if the ring is full the op is dropped, which is safe because a
+// repaint only tells the consumer to look at the latest snapshot and
+// show/hide are idempotent - the surviving ops leave the same end state.
+void ProxGuiQT::enqueueOp(int op)
+{
+	unsigned int head = __atomic_load_n(&opHead, __ATOMIC_RELAXED);
+	unsigned int tail = __atomic_load_n(&opTail, __ATOMIC_ACQUIRE);
+	if (head - tail >= PLOT_OP_QUEUE_LEN)
+		return;
+	opQueue[head & (PLOT_OP_QUEUE_LEN - 1)] = op;
+	__atomic_store_n(&opHead, head + 1, __ATOMIC_RELEASE);
+}
+
 void ProxGuiQT::ShowGraphWindow(void)
 {
-	emit ShowGraphWindowSignal();
+	enqueueOp(PLOT_OP_SHOW);
 }
 
 void ProxGuiQT::RepaintGraphWindow(void)
 {
-	emit RepaintGraphWindowSignal();
+	// the caller published a fresh snapshot; the plot thread picks it up
+	// (and invalidates its pyramid cache) on the next paint
+	enqueueOp(PLOT_OP_REPAINT);
 }
 
 void ProxGuiQT::HideGraphWindow(void)
 {
-	emit HideGraphWindowSignal();
+	enqueueOp(PLOT_OP_HIDE);
 }
 
 void ProxGuiQT::Exit(void)
@@ -90,6 +108,35 @@ void ProxGuiQT::_HideGraphWindow(void)
 	plotwidget->hide();
 }
 
+// Consumer side, runs in the Qt thread at roughly vsync cadence. Drains
+// everything queued since the last tick; repaints are coalesced into a
+// single update so a streaming command enqueueing hundreds of refreshes
+// per second costs one paint per tick.
+void ProxGuiQT::_ConsumeOps(void)
+{
+	bool repaint = false;
+	unsigned int tail = __atomic_load_n(&opTail, __ATOMIC_RELAXED);
+	while (tail != __atomic_load_n(&opHead, __ATOMIC_ACQUIRE)) {
+		int op = opQueue[tail & (PLOT_OP_QUEUE_LEN - 1)];
+		tail++;
+		__atomic_store_n(&opTail, tail, __ATOMIC_RELEASE);
+		switch (op) {
+			case PLOT_OP_SHOW:
+				_ShowGraphWindow();
+				break;
+			case PLOT_OP_HIDE:
+				repaint = false;	// nothing to see anymore
+				_HideGraphWindow();
+				break;
+			case PLOT_OP_REPAINT:
+				repaint = true;
+				break;
+		}
+	}
+	if (repaint)
+		_RepaintGraphWindow();
+}
+
 void ProxGuiQT::_Exit(void) {
 	delete this;
 }
@@ -109,10 +156,10 @@ void ProxGuiQT::MainLoop()
 {
 	plotapp = new QApplication(argc, argv);
 
-	connect(this, SIGNAL(ShowGraphWindowSignal()), this, SLOT(_ShowGraphWindow()));
-	connect(this, SIGNAL(RepaintGraphWindowSignal()), this, SLOT(_RepaintGraphWindow()));
-	connect(this, SIGNAL(HideGraphWindowSignal()), this, SLOT(_HideGraphWindow()));
-	connect(this, SIGNAL(ExitSignal()), this, SLOT(_Exit()));
+	// drain the plot op queue at vsync cadence
+	opTimer = new QTimer(this);
+	connect(opTimer, SIGNAL(timeout()), this, SLOT(_ConsumeOps()));
+	opTimer->start(16);
 
 	//start proxmark thread after starting event loop
 	QTimer::singleShot(200, this, SLOT(_StartProxmarkThread()));
@@ -126,8 +173,11 @@ void ProxGuiQT::MainLoop()
 }
 
 ProxGuiQT::ProxGuiQT(int argc, char **argv, WorkerThread *wthread) : plotapp(NULL), plotwidget(NULL),
-	argc(argc), argv(argv), proxmarkThread(wthread)
+	argc(argc), argv(argv), proxmarkThread(wthread), opHead(0), opTail(0), opTimer(NULL)
 {
+	// connected here (not in MainLoop) so Exit() may be called as soon as
+	// the object exists; a queued emit is delivered once the loop runs
+	connect(this, SIGNAL(ExitSignal()), this, SLOT(_Exit()));
 }
 
 ProxGuiQT::~ProxGuiQT(void)
@@ -268,6 +318,124 @@ void ProxWidget::showEvent(QShowEvent *event) {
 
 //----------- Plotting
 
+// Render-side copy of the published graph snapshot. The plot never touches
+// the live GraphBuffer/s_Buff - it pulls the latest seqlock snapshot at the
+// start of a paint, so demods can mutate the live buffers concurrently and
+// the frame stays internally consistent.
+static int plotGraphBuffer[MAX_GRAPH_TRACE_LEN];
+static int plotOverlayBuffer[MAX_GRAPH_TRACE_LEN];
+static int plotTraceLen = 0;
+static unsigned int plotSeq = (unsigned int)-1;
+
+// Multi-resolution min/max pyramid over the graph buffers. Level l caches
+// min/max (and the sum, for the mean) per bucket of 2^(l+1) samples, so a
+// zoomed out repaint touches roughly one bucket per pixel instead of every
+// sample. The cache is invalidated by RepaintGraphWindow() and rebuilt
+// lazily on the next paint.
+
+#define PYRAMID_LEVELS 8	// largest bucket covers 2^8 = 256 samples
+
+typedef struct {
+	int min;
+	int max;
+	int64_t sum;
+} bucket_t;
+
+typedef struct {
+	const int *source;
+	int len;
+	bool valid;
+	bucket_t *level[PYRAMID_LEVELS];
+} pyramid_t;
+
+static pyramid_t pyramids[2] = {
+	{plotGraphBuffer, 0, false, {NULL}},
+	{plotOverlayBuffer, 0, false, {NULL}}
+};
+
+static void pyramid_invalidate(void)
+{
+	pyramids[0].valid = false;
+	pyramids[1].valid = false;
+}
+
+static void pyramid_build(pyramid_t *p)
+{
+	int len = plotTraceLen;
+
+	for (int l = 0; l < PYRAMID_LEVELS; l++) {
+		if (p->level[l] == NULL) {
+			p->level[l] = (bucket_t *)malloc((MAX_GRAPH_TRACE_LEN >> (l+1)) * sizeof(bucket_t));
+			if (p->level[l] == NULL) return;	// stays invalid, callers fall back to scanning
+		}
+	}
+
+	// level 0 from the samples, every further level from the one below
+	const int *src = p->source;
+	int n = len >> 1;
+	for (int i = 0; i < n; i++) {
+		int a = src[2*i], b = src[2*i + 1];
+		p->level[0][i].min = (a < b) ? a : b;
+		p->level[0][i].max = (a > b) ? a : b;
+		p->level[0][i].sum = (int64_t)a + b;
+	}
+	for (int l = 1; l < PYRAMID_LEVELS; l++) {
+		n = len >> (l+1);
+		for (int i = 0; i < n; i++) {
+			bucket_t *lo = &p->level[l-1][2*i], *hi = &p->level[l-1][2*i + 1];
+			p->level[l][i].min = (lo->min < hi->min) ? lo->min : hi->min;
+			p->level[l][i].max = (lo->max > hi->max) ? lo->max : hi->max;
+			p->level[l][i].sum = lo->sum + hi->sum;
+		}
+	}
+	p->len = len;
+	p->valid = true;
+}
+
+// pyramid for one of the cached buffers, rebuilt if stale. NULL for buffers
+// we don't cache.
+static pyramid_t *pyramid_for(const int *buffer)
+{
+	for (int i = 0; i < 2; i++) {
+		if (pyramids[i].source == buffer) {
+			if (!pyramids[i].valid || pyramids[i].len != plotTraceLen)
+				pyramid_build(&pyramids[i]);
+			return pyramids[i].valid ? &pyramids[i] : NULL;
+		}
+	}
+	return NULL;
+}
+
+// accumulate min/max/sum of buffer[start, start+count) using the largest
+// cached buckets that fit and are aligned
+static void pyramid_minmax(pyramid_t *p, const int *buffer, int start, int count, int *min, int *max, int64_t *sum)
+{
+	while (count > 0) {
+		int lvl = -1;
+		for (int l = 0; l < PYRAMID_LEVELS; l++) {
+			int bucket = 2 << l;
+			if (bucket > count || (start & (bucket - 1)) != 0)
+				break;
+			lvl = l;
+		}
+		if (lvl < 0) {
+			int v = buffer[start];
+			if (v < *min) *min = v;
+			if (v > *max) *max = v;
+			*sum += v;
+			start++;
+			count--;
+		} else {
+			bucket_t *b = &p->level[lvl][start >> (lvl+1)];
+			if (b->min < *min) *min = b->min;
+			if (b->max > *max) *max = b->max;
+			*sum += b->sum;
+			start += 2 << lvl;
+			count -= 2 << lvl;
+		}
+	}
+}
+
 int Plot::xCoordOf(int i, QRect r )
 {
 	return r.left() + (int)((i - GraphStart)*GraphPixelsPerPoint);
@@ -312,12 +480,20 @@ void Plot::setMaxAndStart(int *buffer, int len, QRect plotRect)
 	}
 	if (GraphStart > len) return;
 	int vMin = INT_MAX, vMax = INT_MIN, v = 0;
-	int sample_index = GraphStart ;
-	for( ; sample_index < len && xCoordOf(sample_index,plotRect) < plotRect.right() ; sample_index++) {
-
-		v = buffer[sample_index];
-		if(v < vMin) vMin = v;
-		if(v > vMax) vMax = v;
+	pyramid_t *pyr = pyramid_for(buffer);
+	int count = (int)((plotRect.right() - plotRect.left()) / GraphPixelsPerPoint);
+	if (count > len - GraphStart) count = len - GraphStart;
+	if (pyr != NULL && count > 0) {
+		int64_t sum = 0;
+		pyramid_minmax(pyr, buffer, GraphStart, count, &vMin, &vMax, &sum);
+	} else {
+		int sample_index = GraphStart ;
+		for( ; sample_index < len && xCoordOf(sample_index,plotRect) < plotRect.right() ; sample_index++) {
+
+			v = buffer[sample_index];
+			if(v < vMin) vMin = v;
+			if(v > vMax) vMax = v;
+		}
 	}
 
 	g_absVMax = 0;
@@ -388,28 +564,57 @@ void Plot::PlotGraph(int *buffer, int len, QRect plotRect, QRect annotationRect,
 	//clock_t begin = clock();
 	QPainterPath penPath;
 	int vMin = INT_MAX, vMax = INT_MIN, vMean = 0, v = 0, i = 0;
-	int x = xCoordOf(GraphStart, plotRect);
-	int y = yCoordOf(buffer[GraphStart],plotRect,g_absVMax);
-	penPath.moveTo(x, y);
-	for(i = GraphStart; i < len && xCoordOf(i, plotRect) < plotRect.right(); i++) {
+	int x, y;
+	pyramid_t *pyr = pyramid_for(buffer);
+	if (pyr != NULL && GraphPixelsPerPoint <= 0.5) {
+		// zoomed out (at least two samples per pixel): draw one min/max
+		// column per pixel from the cached pyramid
+		int64_t sum = 0;
+		int count = 0;
+		i = GraphStart;
+		for (x = plotRect.left(); x < plotRect.right() && i < len; x++) {
+			int next = GraphStart + (int)((x + 1 - plotRect.left()) / GraphPixelsPerPoint);
+			if (next > len) next = len;
+			if (next <= i) next = i + 1;
+			int bMin = INT_MAX, bMax = INT_MIN;
+			int64_t bSum = 0;
+			pyramid_minmax(pyr, buffer, i, next - i, &bMin, &bMax, &bSum);
+			if (x == plotRect.left())
+				penPath.moveTo(x, yCoordOf(bMax, plotRect, g_absVMax));
+			penPath.lineTo(x, yCoordOf(bMax, plotRect, g_absVMax));
+			penPath.lineTo(x, yCoordOf(bMin, plotRect, g_absVMax));
+			//catch stats
+			if (bMin < vMin) vMin = bMin;
+			if (bMax > vMax) vMax = bMax;
+			sum += bSum;
+			count += next - i;
+			i = next;
+		}
+		if (count > 0) vMean = sum / count;
+	} else {
+		x = xCoordOf(GraphStart, plotRect);
+		y = yCoordOf(buffer[GraphStart],plotRect,g_absVMax);
+		penPath.moveTo(x, y);
+		for(i = GraphStart; i < len && xCoordOf(i, plotRect) < plotRect.right(); i++) {
 
-		x = xCoordOf(i, plotRect);
-		v = buffer[i];
+			x = xCoordOf(i, plotRect);
+			v = buffer[i];
 
-		y = yCoordOf( v, plotRect, g_absVMax);
+			y = yCoordOf( v, plotRect, g_absVMax);
 
-		penPath.lineTo(x, y);
+			penPath.lineTo(x, y);
 
-		if(GraphPixelsPerPoint > 10) {
-			QRect f(QPoint(x - 3, y - 3),QPoint(x + 3, y + 3));
-			painter->fillRect(f, QColor(100, 255, 100));
+			if(GraphPixelsPerPoint > 10) {
+				QRect f(QPoint(x - 3, y - 3),QPoint(x + 3, y + 3));
+				painter->fillRect(f, QColor(100, 255, 100));
+			}
+			//catch stats
+			if(v < vMin) vMin = v;
+			if(v > vMax) vMax = v;
+			vMean += v;
 		}
-		//catch stats
-		if(v < vMin) vMin = v;
-		if(v > vMax) vMax = v;
-		vMean += v;
+		vMean /= (i - GraphStart);
 	}
-	vMean /= (i - GraphStart);
 
 	painter->setPen(getColor(graphNum));
 
@@ -496,17 +701,25 @@ void Plot::paintEvent(QPaintEvent *event)
 
 	painter.setFont(QFont("Courier New", 10));
 
+	// pull the latest published snapshot; skip the copy (and keep the
+	// pyramid cache) when nothing was republished since the last frame
+	unsigned int seq = GraphSnapshotSeq();
+	if (seq != plotSeq) {
+		plotSeq = GraphSnapshotRead(plotGraphBuffer, plotOverlayBuffer, &plotTraceLen);
+		pyramid_invalidate();
+	}
+
 	if(GraphStart < 0) {
 		GraphStart = 0;
 	}
 
-	if (CursorAPos > GraphTraceLen)
+	if (CursorAPos > plotTraceLen)
 		CursorAPos= 0;
-	if(CursorBPos > GraphTraceLen)
+	if(CursorBPos > plotTraceLen)
 		CursorBPos= 0;
-	if(CursorCPos > GraphTraceLen)
+	if(CursorCPos > plotTraceLen)
 		CursorCPos= 0;
-	if(CursorDPos > GraphTraceLen)
+	if(CursorDPos > plotTraceLen)
 		CursorDPos= 0;
 
 	QRect plotRect(WIDTH_AXES, 0, width() - WIDTH_AXES, height() - HEIGHT_INFO);
@@ -518,8 +731,25 @@ void Plot::paintEvent(QPaintEvent *event)
 	//Black foreground
 	painter.fillRect(plotRect, QColor(0, 0, 0));
 
+	if (g_showSpectrogram) {
+		// frequency view: draw the worker-rendered waterfall instead of the
+		// time-domain trace. Pixel rows are stored at the grid stride.
+		static uint32_t specPixels[SPECTROGRAM_MAX_PIXELS];
+		int sw = 0, sh = 0;
+		SpectrogramRead(specPixels, &sw, &sh);
+		if (sw > 0) {
+			QImage spec((const uchar *)specPixels, sw, sh, SPECTROGRAM_MAX_COLS * 4, QImage::Format_RGB32);
+			painter.drawImage(plotRect, spec);
+		}
+		painter.setPen(QColor(255, 255, 255));
+		char specstr[100];
+		sprintf(specstr, "spectrogram: %d windows of %d samples | DC at bottom, fs/2 at top | F: back to samples", sw, SPECTROGRAM_FFT_SIZE);
+		painter.drawText(infoRect.left() + 10, infoRect.top() + 14, specstr);
+		return;
+	}
+
 	//init graph variables
-	setMaxAndStart(GraphBuffer,GraphTraceLen,plotRect);
+	setMaxAndStart(plotGraphBuffer,plotTraceLen,plotRect);
 
 	// center line
 	int zeroHeight = plotRect.top() + (plotRect.bottom() - plotRect.top()) / 2;
@@ -529,14 +759,14 @@ void Plot::paintEvent(QPaintEvent *event)
 	plotGridLines(&painter, plotRect);
 
 	//Start painting graph
-	PlotGraph(GraphBuffer, GraphTraceLen,plotRect,infoRect,&painter,0);
+	PlotGraph(plotGraphBuffer, plotTraceLen,plotRect,infoRect,&painter,0);
 	if (showDemod && DemodBufferLen > 8) {
 		PlotDemod(DemodBuffer, DemodBufferLen,plotRect,infoRect,&painter,2,g_DemodStartIdx);
 	}
 	if (g_useOverlays) {
 		//init graph variables
-		setMaxAndStart(s_Buff,GraphTraceLen,plotRect);
-		PlotGraph(s_Buff, GraphTraceLen,plotRect,infoRect,&painter,1);
+		setMaxAndStart(plotOverlayBuffer,plotTraceLen,plotRect);
+		PlotGraph(plotOverlayBuffer, plotTraceLen,plotRect,infoRect,&painter,1);
 	}
 	// End graph drawing
 
@@ -659,6 +889,11 @@ void Plot::keyPressEvent(QKeyEvent *event)
 			}
 			break;
 
+		case Qt::Key_F:
+			g_showSpectrogram = !g_showSpectrogram;
+			SpectrogramSetActive(g_showSpectrogram);
+			break;
+
 		case Qt::Key_G:
 			if(PlotGridX || PlotGridY) {
 				PlotGridX= 0;
@@ -674,6 +909,7 @@ void Plot::keyPressEvent(QKeyEvent *event)
 			puts(" Key                      Action\n");
 			puts(" UP                       Zoom out");
 			puts(" DOWN                     Zoom in");
+			puts(" F                        Toggle spectrogram (frequency) view");
 			puts(" G                        Toggle grid display");
 			puts(" H                        Show help");
 			puts(" L                        Toggle lock grid relative to samples");
@@ -101,6 +101,16 @@ class WorkerThread : public QThread {
 		bool usb_present;
 };
 
+// plot operations queued from the command thread to the Qt thread
+enum PlotOp {
+	PLOT_OP_NONE = 0,
+	PLOT_OP_SHOW,
+	PLOT_OP_HIDE,
+	PLOT_OP_REPAINT,	// snapshot already published, refresh the view
+};
+
+#define PLOT_OP_QUEUE_LEN 64	// power of two
+
 class ProxGuiQT : public QObject
 {
 	Q_OBJECT;
@@ -111,6 +121,15 @@ class ProxGuiQT : public QObject
 		int argc;
 		char **argv;
 		WorkerThread *proxmarkThread;
+		// single-producer (command thread) / single-consumer (Qt thread)
+		// lock-free ring; the consumer drains it at vsync cadence and
+		// coalesces repaints, so a streaming command can enqueue faster
+		// than the GUI paints without blocking either side
+		int opQueue[PLOT_OP_QUEUE_LEN];
+		volatile unsigned int opHead;	// producer index
+		volatile unsigned int opTail;	// consumer index
+		QTimer *opTimer;
+		void enqueueOp(int op);
 
 	public:
 		ProxGuiQT(int argc, char **argv, WorkerThread *wthread);
@@ -124,12 +143,10 @@ class ProxGuiQT : public QObject
 		void _ShowGraphWindow(void);
 		void _RepaintGraphWindow(void);
 		void _HideGraphWindow(void);
+		void _ConsumeOps(void);
 		void _Exit(void);
 		void _StartProxmarkThread(void);
 	signals:
-		void ShowGraphWindowSignal(void);
-		void RepaintGraphWindowSignal(void);
-		void HideGraphWindowSignal(void);
 		void ExitSignal(void);
 };
 
@@ -18,6 +18,7 @@
 #include <unistd.h>
 #include <readline/readline.h>
 #include <readline/history.h>
+#include <dirent.h>
 
 #include "util_posix.h"
 #include "proxgui.h"
@@ -28,6 +29,8 @@
 #include "cmdhw.h"
 #include "whereami.h"
 #include "comms.h"
+#include "daemon.h"
+#include "workqueue.h"
 
 
 void
@@ -45,6 +48,8 @@ main_loop(char *script_cmds_file, char *script_cmd, bool usb_present) {
 		SetOffline(false);
 		// cache Version information now:
 		CmdVersion(NULL);
+		// switch to variable-length response frames when the firmware supports them
+		TryExtendedFraming();
 	} else {
 		SetOffline(true);
 	}
@@ -178,6 +183,54 @@ static void set_my_executable_path(void)
 	}
 }
 
+// Read the big read-only assets once so they are warm in the OS page
+// cache before the first command needs them. Runs on a detached thread
+// kicked off while the USB negotiation proceeds (see comms.c). The first
+// 'hf mf hardnested' after launch otherwise pays for faulting in the
+// bitflip tables serially, and that latency lands exactly when the
+// operator has only seconds of tag access.
+static void preload_read_file(const char *path)
+{
+	char buf[1 << 16];
+	FILE *f = fopen(path, "rb");
+	if (f == NULL)
+		return;
+	while (fread(buf, 1, sizeof(buf), f) == sizeof(buf))
+		;
+	fclose(f);
+}
+
+static void warm_asset_preload(void)
+{
+	static const char *assets[] = {
+		"default_keys.dic",
+		"default_pwd.dic",
+		"emv/defparams.json",
+	};
+	const char *dir = get_my_executable_directory();
+	if (dir == NULL)
+		return;
+	char path[FILE_PATH_SIZE];
+	for (size_t i = 0; i < sizeof(assets) / sizeof(assets[0]); i++) {
+		snprintf(path, sizeof(path), "%s%s", dir, assets[i]);
+		preload_read_file(path);
+	}
+	// the hardnested tables dominate: the mmap()able cache when present,
+	// otherwise the compressed per-sum tables it gets built from
+	snprintf(path, sizeof(path), "%shardnested/tables", dir);
+	DIR *d = opendir(path);
+	if (d == NULL)
+		return;
+	struct dirent *de;
+	while ((de = readdir(d)) != NULL) {
+		if (de->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "%shardnested/tables/%s", dir, de->d_name);
+		preload_read_file(path);
+	}
+	closedir(d);
+}
+
 static void show_help(bool showFullHelp, char *command_line){
 	printf("syntax: %s <port> [-h|-help|-m|-f|-flush|-w|-wait|-c|-command|-l|-lua] [cmd_script_file_name] [command][lua_script_name]\n", command_line);
 	printf("\texample: %s "SERIAL_PORT_H"\n\n", command_line);
@@ -197,6 +250,10 @@ static void show_help(bool showFullHelp, char *command_line){
 		printf("\t%s "SERIAL_PORT_H" -command \"hf mf nested 1 *\"\n\n", command_line);
 		printf("lua: <-l|-lua> Execute lua script.\n");
 		printf("\t%s "SERIAL_PORT_H" -l hf_read\n\n", command_line);
+		printf("daemon: <-d|-daemon> Keep the session resident and serve commands from a local socket.\n");
+		printf("\t%s "SERIAL_PORT_H" -d /tmp/proxmark3.sock\n\n", command_line);
+		printf("send: <-s|-send> Forward one command to a running daemon and print its output.\n");
+		printf("\t%s -s /tmp/proxmark3.sock \"hf mf chk 1* ?\"\n\n", command_line);
 	}
 }
 
@@ -209,6 +266,12 @@ int main(int argc, char* argv[]) {
 	bool addLuaExec = false;
 	char *script_cmds_file = NULL;
 	char *script_cmd = NULL;
+	char *daemon_socket = NULL;
+
+	// forwarding to a running daemon needs no port or session of its own
+	if (argc == 4 && (strcmp(argv[1], "-s") == 0 || strcmp(argv[1], "-send") == 0)) {
+		return daemon_send(argv[2], argv[3]);
+	}
 
 	if (argc < 2) {
 		show_help(true, argv[0]);
@@ -244,10 +307,14 @@ int main(int argc, char* argv[]) {
 			executeCommand = true;
 			addLuaExec = true;
 		}
+
+		if((strcmp(argv[i],"-d") == 0 || strcmp(argv[i],"-daemon") == 0) && i + 1 < argc){
+			daemon_socket = argv[++i];
+		}
 	}
 
 	// If the user passed the filename of the 'script' to execute, get it from last parameter
-	if (argc > 2 && argv[argc - 1] && argv[argc - 1][0] != '-') {
+	if (daemon_socket == NULL && argc > 2 && argv[argc - 1] && argv[argc - 1][0] != '-') {
 		if (executeCommand){
 			script_cmd = argv[argc - 1];
 			
@@ -285,9 +352,18 @@ int main(int argc, char* argv[]) {
 	// set global variables
 	set_my_executable_path();
 
+	// overlap asset preloading with the USB negotiation below
+	SetConnectPreloadHook(warm_asset_preload);
+
 	// try to open USB connection to Proxmark
 	usb_present = OpenProxmark(argv[1], waitCOMPort, 20, false);
 
+	if (daemon_socket) {
+		daemon_loop(daemon_socket, usb_present);
+		SessionCloseAll();
+		exit(0);
+	}
+
 #ifdef HAVE_GUI
 #ifdef _WIN32
 	InitGraphics(argc, argv, script_cmds_file, script_cmd, usb_present);
@@ -309,10 +385,9 @@ int main(int argc, char* argv[]) {
 	main_loop(script_cmds_file, script_cmd, usb_present);
 #endif	
 
-	// Clean up the port
-	if (usb_present) {
-		CloseProxmark();
-	}
+	// Clean up the port(s), including any extra sessions opened with 'hw session'
+	workqueue_shutdown();
+	SessionCloseAll();
 
 	exit(0);
 }
@@ -18,6 +18,9 @@
 #include "comms.h"
 #include "usb_cmd.h"
 #include "cmdmain.h"
+#include "cmddata.h"
+#include "graph.h"
+#include "sigkernel.h"
 #include "util.h"
 #include "mifare/mifarehost.h"
 #include "../common/iso15693tools.h"
@@ -392,6 +395,387 @@ static int l_sha1(lua_State *L)
 	return 1;
 }
 
+/**
+ * Sample buffer userdata: a bounds-checked view over sample memory, so
+ * scripts can work on GraphBuffer or a BigBuf download without shuttling
+ * every sample through a Lua string or table. Views point directly at
+ * GraphBuffer (zero copy); buffers from the device own their samples,
+ * stored right behind the header and garbage collected with it.
+ */
+#define SAMPLEBUF_MT "pm3.samplebuf"
+
+typedef struct {
+	int *data;
+	uint32_t size;
+} samplebuf_t;
+
+static samplebuf_t *samplebuf_check(lua_State *L)
+{
+	return (samplebuf_t *)luaL_checkudata(L, 1, SAMPLEBUF_MT);
+}
+
+// optional [from, to] range arguments (1-based, default the whole buffer)
+static void samplebuf_checkrange(lua_State *L, samplebuf_t *b, int arg, uint32_t *from, uint32_t *to)
+{
+	lua_Unsigned f = luaL_optunsigned(L, arg, 1);
+	lua_Unsigned t = luaL_optunsigned(L, arg + 1, b->size);
+	if (f < 1 || t > b->size || f > t)
+		luaL_error(L, "range [%d, %d] out of bounds (buffer holds %d samples)", (int)f, (int)t, b->size);
+	*from = (uint32_t)f - 1;
+	*to = (uint32_t)t - 1;
+}
+
+static int l_samplebuf_len(lua_State *L)
+{
+	lua_pushunsigned(L, samplebuf_check(L)->size);
+	return 1;
+}
+
+static int l_samplebuf_get(lua_State *L)
+{
+	samplebuf_t *b = samplebuf_check(L);
+	lua_Unsigned i = luaL_checkunsigned(L, 2);
+	if (i < 1 || i > b->size)
+		return luaL_error(L, "index %d out of bounds (buffer holds %d samples)", (int)i, b->size);
+	lua_pushinteger(L, b->data[i - 1]);
+	return 1;
+}
+
+static int l_samplebuf_set(lua_State *L)
+{
+	samplebuf_t *b = samplebuf_check(L);
+	lua_Unsigned i = luaL_checkunsigned(L, 2);
+	if (i < 1 || i > b->size)
+		return luaL_error(L, "index %d out of bounds (buffer holds %d samples)", (int)i, b->size);
+	b->data[i - 1] = luaL_checkint(L, 3);
+	return 0;
+}
+
+// min/max over a range, returning the value and its (1-based) index
+static int samplebuf_extremum(lua_State *L, bool wantmax)
+{
+	samplebuf_t *b = samplebuf_check(L);
+	uint32_t from, to;
+	samplebuf_checkrange(L, b, 2, &from, &to);
+
+	uint32_t best = from;
+	for (uint32_t i = from + 1; i <= to; i++) {
+		if (wantmax ? (b->data[i] > b->data[best]) : (b->data[i] < b->data[best]))
+			best = i;
+	}
+	lua_pushinteger(L, b->data[best]);
+	lua_pushunsigned(L, best + 1);
+	return 2;
+}
+
+static int l_samplebuf_min(lua_State *L)
+{
+	return samplebuf_extremum(L, false);
+}
+
+static int l_samplebuf_max(lua_State *L)
+{
+	return samplebuf_extremum(L, true);
+}
+
+static int l_samplebuf_sum(lua_State *L)
+{
+	samplebuf_t *b = samplebuf_check(L);
+	uint32_t from, to;
+	samplebuf_checkrange(L, b, 2, &from, &to);
+
+	lua_Number sum = 0;
+	for (uint32_t i = from; i <= to; i++) {
+		sum += b->data[i];
+	}
+	lua_pushnumber(L, sum);
+	return 1;
+}
+
+// fold(fn, acc [, from, to]): acc = fn(acc, sample, index) over the range.
+// The C loop spares the per-sample table indexing, only the call remains
+static int l_samplebuf_fold(lua_State *L)
+{
+	samplebuf_t *b = samplebuf_check(L);
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+	luaL_checkany(L, 3);
+	uint32_t from, to;
+	samplebuf_checkrange(L, b, 4, &from, &to);
+
+	lua_pushvalue(L, 3);	// the accumulator
+	for (uint32_t i = from; i <= to; i++) {
+		lua_pushvalue(L, 2);
+		lua_insert(L, -2);	// fn below the accumulator
+		lua_pushinteger(L, b->data[i]);
+		lua_pushunsigned(L, i + 1);
+		lua_call(L, 3, 1);
+	}
+	return 1;
+}
+
+// pack(bits [, from, to]) -> string: bit-packed export of the range, MSB
+// first, for passing samples to other scripts, files or commands as one
+// native byte array instead of a Lua table. bits must be 1, 2, 4 or 8;
+// samples are clamped to the signed range of the field (1 bit packs
+// sample > 0), so SampleBufUnpack round-trips the values.
+static int l_samplebuf_pack(lua_State *L)
+{
+	samplebuf_t *b = samplebuf_check(L);
+	int bits = luaL_checkint(L, 2);
+	uint32_t from, to;
+	samplebuf_checkrange(L, b, 3, &from, &to);
+	if (bits != 1 && bits != 2 && bits != 4 && bits != 8)
+		return luaL_error(L, "bits per sample must be 1, 2, 4 or 8");
+
+	uint32_t count = to - from + 1;
+	size_t bytes = ((size_t)count * bits + 7) / 8;
+	uint8_t *out = calloc(bytes, 1);
+	if (out == NULL)
+		return returnToLuaWithError(L, "Allocating %d bytes failed", (int)bytes);
+
+	int lo = -(1 << (bits - 1));
+	int hi = (1 << (bits - 1)) - 1;
+	uint32_t bitpos = 0;
+	for (uint32_t i = from; i <= to; i++) {
+		int v = b->data[i];
+		uint8_t field;
+		if (bits == 1) {
+			field = v > 0;
+		} else {
+			if (v < lo) v = lo;
+			if (v > hi) v = hi;
+			field = (uint8_t)v & ((1 << bits) - 1);
+		}
+		out[bitpos >> 3] |= field << (8 - bits - (bitpos & 7));
+		bitpos += bits;
+	}
+	lua_pushlstring(L, (const char *)out, bytes);
+	free(out);
+	return 1;
+}
+
+static const luaL_Reg samplebuf_methods[] = {
+	{"get",     l_samplebuf_get},
+	{"set",     l_samplebuf_set},
+	{"min",     l_samplebuf_min},
+	{"max",     l_samplebuf_max},
+	{"sum",     l_samplebuf_sum},
+	{"fold",    l_samplebuf_fold},
+	{"pack",    l_samplebuf_pack},
+	{NULL, NULL}
+};
+
+static void register_samplebuf_metatable(lua_State *L)
+{
+	luaL_newmetatable(L, SAMPLEBUF_MT);
+	lua_pushcfunction(L, l_samplebuf_len);
+	lua_setfield(L, -2, "__len");
+	lua_newtable(L);
+	luaL_setfuncs(L, samplebuf_methods, 0);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+}
+
+/**
+ * @brief Returns a zero-copy view over GraphBuffer, sized to the current
+ * GraphTraceLen. The view stays valid for the whole script run (the storage
+ * is static), but samples changed by commands show through it.
+ */
+static int l_GetGraphBuffer(lua_State *L)
+{
+	samplebuf_t *b = lua_newuserdata(L, sizeof(samplebuf_t));
+	b->data = GraphBuffer;
+	b->size = GraphTraceLen > 0 ? (uint32_t)GraphTraceLen : 0;
+	if (b->size > MAX_GRAPH_TRACE_LEN) {
+		b->size = MAX_GRAPH_TRACE_LEN;
+	}
+	luaL_setmetatable(L, SAMPLEBUF_MT);
+	return 1;
+}
+
+/**
+ * @brief Downloads a BigBuf region from the device into a sample buffer.
+ * The following params expected:
+ * uint32_t start_index
+ * uint32_t count (number of bytes/samples)
+ */
+static int l_GetFromBigBuf(lua_State *L)
+{
+	uint32_t startindex = luaL_checkunsigned(L, 1);
+	uint32_t count = luaL_checkunsigned(L, 2);
+	if (count == 0)
+		return returnToLuaWithError(L, "Zero samples requested");
+
+	uint8_t *tmp = malloc(count);
+	if (tmp == NULL)
+		return returnToLuaWithError(L, "Allocating %u bytes failed", count);
+
+	if (!GetFromBigBuf(tmp, count, startindex, NULL, -1, false)) {
+		free(tmp);
+		return returnToLuaWithError(L, "command execution time out");
+	}
+
+	samplebuf_t *b = lua_newuserdata(L, sizeof(samplebuf_t) + count * sizeof(int));
+	b->data = (int *)(b + 1);
+	b->size = count;
+	for (uint32_t i = 0; i < count; i++) {
+		b->data[i] = tmp[i];
+	}
+	free(tmp);
+	luaL_setmetatable(L, SAMPLEBUF_MT);
+	return 1;
+}
+
+/**
+ * @brief Decodes a string produced by samplebuf:pack() back into an owning
+ * sample buffer (the bulk import counterpart). The following params expected:
+ * const char *packed - the bit-packed sample string
+ * int bits - bits per sample (1, 2, 4 or 8), fields are sign-extended
+ * uint32_t count - number of samples (optional, default: all that fit)
+ */
+static int l_SampleBufUnpack(lua_State *L)
+{
+	size_t len;
+	const char *packed = luaL_checklstring(L, 1, &len);
+	int bits = luaL_checkint(L, 2);
+	if (bits != 1 && bits != 2 && bits != 4 && bits != 8)
+		return luaL_error(L, "bits per sample must be 1, 2, 4 or 8");
+
+	uint32_t maxcount = (uint32_t)(len * 8 / bits);
+	lua_Unsigned count = luaL_optunsigned(L, 3, maxcount);
+	if (count > maxcount)
+		return luaL_error(L, "%d samples requested, the string holds %d", (int)count, maxcount);
+
+	samplebuf_t *b = lua_newuserdata(L, sizeof(samplebuf_t) + count * sizeof(int));
+	b->data = (int *)(b + 1);
+	b->size = (uint32_t)count;
+
+	uint32_t bitpos = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		uint8_t field = ((uint8_t)packed[bitpos >> 3] >> (8 - bits - (bitpos & 7))) & ((1 << bits) - 1);
+		if (bits > 1 && (field & (1 << (bits - 1))))
+			b->data[i] = (int)field - (1 << bits);	// sign-extend
+		else
+			b->data[i] = field;
+		bitpos += bits;
+	}
+	luaL_setmetatable(L, SAMPLEBUF_MT);
+	return 1;
+}
+
+/**
+ * @brief Runs a chain of graph filters fused into a single pass over the
+ * graph buffer, with one repaint. The following params expected:
+ * const char *spec - space-separated chain of 'hpf', 'norm' and 'dec'
+ */
+static int l_GraphChain(lua_State *L)
+{
+	const char *spec = luaL_checkstring(L, 1);
+	if (GraphChain(spec) != 0)
+		return returnToLuaWithError(L, "Bad filter chain '%s'", spec);
+	return 0;
+}
+
+/**
+ * @brief Signal statistics of the GraphBuffer via the analytics kernels in
+ * sigkernel.c (threaded/vectorized). The following params expected:
+ * int threshold for edge/run analysis (optional, default 0)
+ * Returns five values: number of threshold crossings, RMS, minimum sample,
+ * maximum sample, dominant run length in samples
+ */
+static int l_sigstat(lua_State *L)
+{
+	int threshold = (int)luaL_optinteger(L, 1, 0);
+
+	if (GraphTraceLen == 0)
+		return returnToLuaWithError(L, "No samples in GraphBuffer");
+
+	uint32_t hist[SIG_HIST_BINS];
+	sig_histogram(GraphBuffer, GraphTraceLen, hist);
+	int min = 127, max = -128;
+	for (int b = 0; b < SIG_HIST_BINS; b++) {
+		if (hist[b] == 0) continue;
+		if (b - 128 < min) min = b - 128;
+		if (b - 128 > max) max = b - 128;
+	}
+
+	uint32_t dominant = 0;
+	uint32_t *runs = malloc(GraphTraceLen * sizeof(uint32_t));
+	if (runs != NULL) {
+		size_t numruns = sig_run_lengths(GraphBuffer, GraphTraceLen, threshold, runs, GraphTraceLen);
+		uint32_t runhist[512] = {0};
+		for (size_t i = 0; i < numruns; i++) {
+			if (runs[i] < 512)
+				runhist[runs[i]]++;
+		}
+		uint32_t best = 0;
+		for (uint32_t r = 1; r < 512; r++) {
+			if (runhist[r] > best) {
+				best = runhist[r];
+				dominant = r;
+			}
+		}
+		free(runs);
+	}
+
+	lua_pushunsigned(L, sig_count_edges(GraphBuffer, GraphTraceLen, threshold));
+	lua_pushnumber(L, sig_rms(GraphBuffer, GraphTraceLen));
+	lua_pushinteger(L, min);
+	lua_pushinteger(L, max);
+	lua_pushunsigned(L, dominant);
+	return 5;
+}
+
+/**
+ * @brief Tunes the pacing of the incremental garbage collector. Long-running
+ * scripts can shrink the collector pause ratio and grow the step multiplier
+ * so garbage is reclaimed in many small steps instead of full-collection
+ * pauses that desync timed card exchanges. The following params expected:
+ * int pause ratio in percent (0 = leave unchanged)
+ * int step multiplier in percent (0 = leave unchanged)
+ * Returns the previous values of both knobs. An explicit full collection
+ * between loop iterations is already available as collectgarbage('collect'),
+ * and collectgarbage('step', kb) drives a single bounded step.
+ */
+static int l_gcpace(lua_State *L)
+{
+	int pause = (int)luaL_optinteger(L, 1, 0);
+	int stepmul = (int)luaL_optinteger(L, 2, 0);
+
+	int oldpause = lua_gc(L, LUA_GCSETPAUSE, pause);
+	int oldstepmul = lua_gc(L, LUA_GCSETSTEPMUL, stepmul);
+	// lua_gc always swaps in the new value, so restore untouched knobs
+	if (pause == 0)
+		lua_gc(L, LUA_GCSETPAUSE, oldpause);
+	if (stepmul == 0)
+		lua_gc(L, LUA_GCSETSTEPMUL, oldstepmul);
+
+	lua_pushinteger(L, oldpause);
+	lua_pushinteger(L, oldstepmul);
+	return 2;
+}
+
+/**
+ * @brief Reports the heap accounting kept by the counting allocator that
+ * cmdscript.c installs around the script's lua_State.
+ * Returns four values, all in bytes except the last:
+ * current live size, peak size, total allocated, number of allocations
+ */
+static int l_memstats(lua_State *L)
+{
+	lua_getfield(L, LUA_REGISTRYINDEX, LUA_ALLOC_STATS_KEY);
+	lua_alloc_stats_t *stats = lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	if (stats == NULL)
+		return returnToLuaWithError(L, "No allocation stats for this lua state");
+
+	lua_pushunsigned(L, (lua_Unsigned)stats->cur);
+	lua_pushunsigned(L, (lua_Unsigned)stats->peak);
+	lua_pushunsigned(L, (lua_Unsigned)stats->total);
+	lua_pushunsigned(L, (lua_Unsigned)stats->count);
+	return 4;
+}
+
 /**
  * @brief Sets the lua path to include "./lualibs/?.lua", in order for a script to be
  * able to do "require('foobar')" if foobar.lua is within lualibs folder.
@@ -438,9 +822,18 @@ int set_pm3_libraries(lua_State *L)
 		{"crc16",                       l_crc16},
 		{"crc64",                       l_crc64},
 		{"sha1",                        l_sha1},
+		{"GetGraphBuffer",              l_GetGraphBuffer},
+		{"GetFromBigBuf",               l_GetFromBigBuf},
+		{"SampleBufUnpack",             l_SampleBufUnpack},
+		{"GraphChain",                  l_GraphChain},
+		{"sigstat",                     l_sigstat},
+		{"gcpace",                      l_gcpace},
+		{"memstats",                    l_memstats},
 		{NULL, NULL}
 	};
 
+	register_samplebuf_metatable(L);
+
 	lua_pushglobaltable(L);
 	// Core library is in this table. Contains '
 	//this is 'pm3' table
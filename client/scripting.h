@@ -11,11 +11,28 @@
 #define SCRIPTING_H__
 
 #include <lua.h>
+#include <stdint.h>
 
 #define LUA_LIBRARIES_DIRECTORY 	"lualibs/"
 #define LUA_SCRIPTS_DIRECTORY 		"scripts/"
 #define LUA_LIBRARIES_WILDCARD 		"?.lua"
 
+/**
+ * Per-script heap accounting, kept by a counting allocator wrapped around
+ * the stock Lua allocator. A pointer to it is stashed in the Lua registry
+ * under LUA_ALLOC_STATS_KEY so core.memstats() can reach it from scripts.
+ */
+#define LUA_ALLOC_STATS_KEY "pm3.alloc_stats"
+
+typedef struct {
+	lua_Alloc base;     // the allocator we forward to
+	void *base_ud;
+	size_t cur;         // bytes currently live
+	size_t peak;        // high-water mark
+	uint64_t total;     // bytes allocated over the script lifetime
+	uint64_t count;     // number of growing (re)allocations
+} lua_alloc_stats_t;
+
 /**
  * @brief set_libraries loads the core components of pm3 into the 'pm3'
  *  namespace within the given lua_State
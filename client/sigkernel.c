@@ -0,0 +1,166 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Analytics kernels over sample buffers. The reductions (edge count,
+// histogram, sum of squares) run through the per-instruction-set cores in
+// sigstat_core.c and are threaded over buffer segments on the shared worker
+// pool when the buffer is large enough to pay for it. Run lengths produce
+// ordered output and stay serial.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sigkernel.h"
+#include "sigstat_core.h"
+#include "workqueue.h"
+
+// below this length the submit/join overhead beats any parallel win
+#define SIG_PARALLEL_MIN (1 << 16)
+
+typedef struct {
+	const int *buf;
+	size_t start;			// segment [start, end); the edge kernel also
+	size_t end;			// looks at buf[start - 1] when start > 0
+	int threshold;
+	uint32_t edges;
+	uint64_t sumsq;
+	uint32_t hist[SIG_HIST_BINS];
+} sig_task_t;
+
+static void sig_edges_task(void *arg)
+{
+	sig_task_t *t = arg;
+	t->edges = sigstat_edges_core(t->buf, t->start, t->end, t->threshold);
+}
+
+static void sig_hist_task(void *arg)
+{
+	sig_task_t *t = arg;
+	sigstat_hist_core(t->buf, t->start, t->end, t->hist);
+}
+
+static void sig_sumsq_task(void *arg)
+{
+	sig_task_t *t = arg;
+	t->sumsq = sigstat_sumsq_core(t->buf, t->start, t->end);
+}
+
+// run func over the buffer in one segment per worker and return the task
+// array for the caller to merge, or NULL when a serial call is the better
+// (or only) option
+static sig_task_t *sig_run_parallel(workqueue_task_t func, const int *buf,
+                                    size_t len, int threshold, size_t *num_tasks)
+{
+	int workers = workqueue_num_workers();
+	if (len < SIG_PARALLEL_MIN || workers < 2)
+		return NULL;
+
+	sig_task_t *tasks = calloc(workers, sizeof(sig_task_t));
+	if (tasks == NULL)
+		return NULL;
+
+	for (int i = 0; i < workers; i++) {
+		tasks[i].buf = buf;
+		tasks[i].start = len * i / workers;
+		tasks[i].end = len * (i + 1) / workers;
+		tasks[i].threshold = threshold;
+		workqueue_submit(func, &tasks[i]);
+	}
+	workqueue_join();
+	*num_tasks = workers;
+	return tasks;
+}
+
+uint32_t sig_count_edges(const int *buf, size_t len, int threshold)
+{
+	if (len < 2)
+		return 0;
+
+	size_t num_tasks;
+	sig_task_t *tasks = sig_run_parallel(sig_edges_task, buf, len, threshold, &num_tasks);
+	if (tasks != NULL) {
+		uint32_t edges = 0;
+		for (size_t i = 0; i < num_tasks; i++)
+			edges += tasks[i].edges;
+		free(tasks);
+		return edges;
+	}
+
+	return sigstat_edges_core(buf, 0, len, threshold);
+}
+
+size_t sig_run_lengths(const int *buf, size_t len, int threshold,
+                       uint32_t *runs, size_t maxruns)
+{
+	if (len == 0 || maxruns == 0)
+		return 0;
+
+	size_t num = 0;
+	uint32_t cur = 1;
+	for (size_t i = 1; i < len; i++) {
+		if ((buf[i] >= threshold) == (buf[i - 1] >= threshold)) {
+			cur++;
+			continue;
+		}
+		runs[num++] = cur;
+		cur = 1;
+		if (num == maxruns)
+			return num;
+	}
+	runs[num++] = cur;
+	return num;
+}
+
+void sig_histogram(const int *buf, size_t len, uint32_t hist[SIG_HIST_BINS])
+{
+	memset(hist, 0, SIG_HIST_BINS * sizeof(uint32_t));
+
+	size_t num_tasks;
+	sig_task_t *tasks = sig_run_parallel(sig_hist_task, buf, len, 0, &num_tasks);
+	if (tasks != NULL) {
+		for (size_t i = 0; i < num_tasks; i++) {
+			for (int b = 0; b < SIG_HIST_BINS; b++)
+				hist[b] += tasks[i].hist[b];
+		}
+		free(tasks);
+		return;
+	}
+
+	sigstat_hist_core(buf, 0, len, hist);
+}
+
+double sig_rms(const int *buf, size_t len)
+{
+	if (len == 0)
+		return 0.0;
+
+	uint64_t sumsq = 0;
+	size_t num_tasks;
+	sig_task_t *tasks = sig_run_parallel(sig_sumsq_task, buf, len, 0, &num_tasks);
+	if (tasks != NULL) {
+		for (size_t i = 0; i < num_tasks; i++)
+			sumsq += tasks[i].sumsq;
+		free(tasks);
+	} else {
+		sumsq = sigstat_sumsq_core(buf, 0, len);
+	}
+	return sqrt((double)sumsq / len);
+}
+
+size_t sig_rms_windows(const int *buf, size_t len, size_t window,
+                       double *out, size_t maxout)
+{
+	if (window == 0)
+		return 0;
+
+	size_t num = 0;
+	for (size_t off = 0; off + window <= len && num < maxout; off += window) {
+		uint64_t sumsq = sigstat_sumsq_core(buf, off, off + window);
+		out[num++] = sqrt((double)sumsq / window);
+	}
+	return num;
+}
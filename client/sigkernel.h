@@ -0,0 +1,41 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Analytics kernels over sample buffers: threshold crossings, run lengths,
+// histogram, RMS. Large buffers are processed in segments on the shared
+// worker pool (workqueue.c); the loops are written so the compiler can
+// vectorize them. Used by 'data sigstat', demod prefilters and the Lua
+// bindings.
+//-----------------------------------------------------------------------------
+
+#ifndef SIGKERNEL_H__
+#define SIGKERNEL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SIG_HIST_BINS 256
+
+// number of crossings of the threshold level between adjacent samples
+extern uint32_t sig_count_edges(const int *buf, size_t len, int threshold);
+
+// lengths of consecutive sample runs on the same side of the threshold,
+// in order; returns the number of runs written (at most maxruns)
+extern size_t sig_run_lengths(const int *buf, size_t len, int threshold,
+                              uint32_t *runs, size_t maxruns);
+
+// sample value histogram; values are clamped to [-128, 127] and counted
+// into hist[value + 128]
+extern void sig_histogram(const int *buf, size_t len, uint32_t hist[SIG_HIST_BINS]);
+
+// root mean square of the whole buffer
+extern double sig_rms(const int *buf, size_t len);
+
+// RMS per non-overlapping window; returns the number of windows written
+// (at most maxout)
+extern size_t sig_rms_windows(const int *buf, size_t len, size_t window,
+                              double *out, size_t maxout);
+
+#endif
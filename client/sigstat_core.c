@@ -0,0 +1,206 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Reduction kernels for the signal analytics in sigkernel.c.
+//
+// This file is compiled several times, once per instruction set (see
+// MULTIARCHSRCS in the Makefile), and the widest set the CPU supports is
+// selected at runtime - the same scheme as hardnested_bf_core. The loops
+// are branch-light so the compiler can auto-vectorize them for each target.
+//-----------------------------------------------------------------------------
+
+#include "sigstat_core.h"
+
+#include "hardnested/hardnested_bf_core.h"		// SIMDExecInstr, GetSIMDInstrAuto()
+
+// For each instruction set, define dedicated function names:
+#if defined (__AVX512F__)
+#define SIGSTAT_EDGES sigstat_edges_AVX512
+#define SIGSTAT_HIST sigstat_hist_AVX512
+#define SIGSTAT_SUMSQ sigstat_sumsq_AVX512
+#elif defined (__AVX2__)
+#define SIGSTAT_EDGES sigstat_edges_AVX2
+#define SIGSTAT_HIST sigstat_hist_AVX2
+#define SIGSTAT_SUMSQ sigstat_sumsq_AVX2
+#elif defined (__AVX__)
+#define SIGSTAT_EDGES sigstat_edges_AVX
+#define SIGSTAT_HIST sigstat_hist_AVX
+#define SIGSTAT_SUMSQ sigstat_sumsq_AVX
+#elif defined (__SSE2__)
+#define SIGSTAT_EDGES sigstat_edges_SSE2
+#define SIGSTAT_HIST sigstat_hist_SSE2
+#define SIGSTAT_SUMSQ sigstat_sumsq_SSE2
+#elif defined (__MMX__)
+#define SIGSTAT_EDGES sigstat_edges_MMX
+#define SIGSTAT_HIST sigstat_hist_MMX
+#define SIGSTAT_SUMSQ sigstat_sumsq_MMX
+#else
+#define SIGSTAT_EDGES sigstat_edges_NOSIMD
+#define SIGSTAT_HIST sigstat_hist_NOSIMD
+#define SIGSTAT_SUMSQ sigstat_sumsq_NOSIMD
+#endif
+
+// typedefs and declaration of functions:
+typedef uint32_t sigstat_edges_t(const int*, size_t, size_t, int);
+sigstat_edges_t sigstat_edges_AVX512;
+sigstat_edges_t sigstat_edges_AVX2;
+sigstat_edges_t sigstat_edges_AVX;
+sigstat_edges_t sigstat_edges_SSE2;
+sigstat_edges_t sigstat_edges_MMX;
+sigstat_edges_t sigstat_edges_NOSIMD;
+
+typedef void sigstat_hist_t(const int*, size_t, size_t, uint32_t*);
+sigstat_hist_t sigstat_hist_AVX512;
+sigstat_hist_t sigstat_hist_AVX2;
+sigstat_hist_t sigstat_hist_AVX;
+sigstat_hist_t sigstat_hist_SSE2;
+sigstat_hist_t sigstat_hist_MMX;
+sigstat_hist_t sigstat_hist_NOSIMD;
+
+typedef uint64_t sigstat_sumsq_t(const int*, size_t, size_t);
+sigstat_sumsq_t sigstat_sumsq_AVX512;
+sigstat_sumsq_t sigstat_sumsq_AVX2;
+sigstat_sumsq_t sigstat_sumsq_AVX;
+sigstat_sumsq_t sigstat_sumsq_SSE2;
+sigstat_sumsq_t sigstat_sumsq_MMX;
+sigstat_sumsq_t sigstat_sumsq_NOSIMD;
+
+uint32_t SIGSTAT_EDGES(const int *buf, size_t start, size_t end, int threshold)
+{
+	uint32_t edges = 0;
+	size_t i = (start == 0) ? 1 : start;
+	for (; i < end; i++) {
+		edges += (buf[i] >= threshold) != (buf[i - 1] >= threshold);
+	}
+	return edges;
+}
+
+void SIGSTAT_HIST(const int *buf, size_t start, size_t end, uint32_t *hist)
+{
+	for (size_t i = start; i < end; i++) {
+		int v = buf[i];
+		if (v < -128) v = -128;
+		if (v > 127) v = 127;
+		hist[v + 128]++;
+	}
+}
+
+uint64_t SIGSTAT_SUMSQ(const int *buf, size_t start, size_t end)
+{
+	uint64_t sumsq = 0;
+	for (size_t i = start; i < end; i++) {
+		int64_t v = buf[i];
+		sumsq += v * v;
+	}
+	return sumsq;
+}
+
+
+#ifndef __MMX__
+
+// determine the available instruction set at runtime and call the correct function
+uint32_t sigstat_edges_core(const int *buf, size_t start, size_t end, int threshold)
+{
+	sigstat_edges_t *f;
+
+	switch(GetSIMDInstrAuto()) {
+#if defined (__i386__) || defined (__x86_64__)
+#if !defined(__APPLE__) || (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1))
+#if (__GNUC__ >= 5) && (__GNUC__ > 5 || __GNUC_MINOR__ > 2)
+		case SIMD_AVX512:
+			f = &sigstat_edges_AVX512;
+			break;
+#endif
+		case SIMD_AVX2:
+			f = &sigstat_edges_AVX2;
+			break;
+		case SIMD_AVX:
+			f = &sigstat_edges_AVX;
+			break;
+		case SIMD_SSE2:
+			f = &sigstat_edges_SSE2;
+			break;
+		case SIMD_MMX:
+			f = &sigstat_edges_MMX;
+			break;
+#endif
+#endif
+		default:
+			f = &sigstat_edges_NOSIMD;
+			break;
+	}
+
+	return (*f)(buf, start, end, threshold);
+}
+
+void sigstat_hist_core(const int *buf, size_t start, size_t end, uint32_t hist[SIG_HIST_BINS])
+{
+	sigstat_hist_t *f;
+
+	switch(GetSIMDInstrAuto()) {
+#if defined (__i386__) || defined (__x86_64__)
+#if !defined(__APPLE__) || (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1))
+#if (__GNUC__ >= 5) && (__GNUC__ > 5 || __GNUC_MINOR__ > 2)
+		case SIMD_AVX512:
+			f = &sigstat_hist_AVX512;
+			break;
+#endif
+		case SIMD_AVX2:
+			f = &sigstat_hist_AVX2;
+			break;
+		case SIMD_AVX:
+			f = &sigstat_hist_AVX;
+			break;
+		case SIMD_SSE2:
+			f = &sigstat_hist_SSE2;
+			break;
+		case SIMD_MMX:
+			f = &sigstat_hist_MMX;
+			break;
+#endif
+#endif
+		default:
+			f = &sigstat_hist_NOSIMD;
+			break;
+	}
+
+	(*f)(buf, start, end, hist);
+}
+
+uint64_t sigstat_sumsq_core(const int *buf, size_t start, size_t end)
+{
+	sigstat_sumsq_t *f;
+
+	switch(GetSIMDInstrAuto()) {
+#if defined (__i386__) || defined (__x86_64__)
+#if !defined(__APPLE__) || (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1))
+#if (__GNUC__ >= 5) && (__GNUC__ > 5 || __GNUC_MINOR__ > 2)
+		case SIMD_AVX512:
+			f = &sigstat_sumsq_AVX512;
+			break;
+#endif
+		case SIMD_AVX2:
+			f = &sigstat_sumsq_AVX2;
+			break;
+		case SIMD_AVX:
+			f = &sigstat_sumsq_AVX;
+			break;
+		case SIMD_SSE2:
+			f = &sigstat_sumsq_SSE2;
+			break;
+		case SIMD_MMX:
+			f = &sigstat_sumsq_MMX;
+			break;
+#endif
+#endif
+		default:
+			f = &sigstat_sumsq_NOSIMD;
+			break;
+	}
+
+	return (*f)(buf, start, end);
+}
+
+#endif
@@ -0,0 +1,29 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Reduction kernels for sigkernel.c, compiled per instruction set with
+// runtime CPU dispatch (same scheme as autocorr_core / hardnested_bf_core).
+//-----------------------------------------------------------------------------
+
+#ifndef SIGSTAT_CORE_H__
+#define SIGSTAT_CORE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sigkernel.h"	// SIG_HIST_BINS
+
+// crossings of the threshold level in buf[start .. end); when start > 0 the
+// sample before the segment is included so segment joins count correctly
+extern uint32_t sigstat_edges_core(const int *buf, size_t start, size_t end, int threshold);
+
+// add the clamped sample values of buf[start .. end) to hist[]
+extern void sigstat_hist_core(const int *buf, size_t start, size_t end,
+                              uint32_t hist[SIG_HIST_BINS]);
+
+// sum of squared sample values of buf[start .. end)
+extern uint64_t sigstat_sumsq_core(const int *buf, size_t start, size_t end);
+
+#endif
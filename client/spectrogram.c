@@ -0,0 +1,212 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Incremental spectrogram over the graph buffer, for the plot window's
+// frequency view ('F' key). A worker thread follows the seqlock graph
+// snapshot, runs a Hann-windowed radix-2 FFT over half-overlapping sliding
+// windows and renders magnitude columns into a pixel grid that it publishes
+// through a seqlock of its own. When new samples are appended to an
+// otherwise unchanged buffer - the streaming acquisition case - only the
+// columns whose window touches the new data are recomputed, so a live
+// waterfall stays cheap no matter how long the capture gets.
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "spectrogram.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include "proxgui.h"	// graph snapshot, RepaintGraphWindow
+#include "util_posix.h"	// msleep
+
+// worker-side copy of the graph snapshot
+static int spec_samples[MAX_GRAPH_TRACE_LEN];
+static int spec_overlay[MAX_GRAPH_TRACE_LEN];	// unused, GraphSnapshotRead fills both
+static int spec_incoming[MAX_GRAPH_TRACE_LEN];
+static int spec_len = 0;
+
+// published pixel grid (seqlock, like the graph snapshot)
+static uint32_t spec_pixels[SPECTROGRAM_MAX_PIXELS];
+static int spec_cols = 0;
+static unsigned int spec_seq = 0;
+
+static pthread_mutex_t spec_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t spec_cond = PTHREAD_COND_INITIALIZER;
+static bool spec_active = false;
+static bool spec_thread_started = false;
+
+static float hann_window[SPECTROGRAM_FFT_SIZE];
+static uint16_t bit_reverse[SPECTROGRAM_FFT_SIZE];
+
+static void spectrogram_init_tables(void)
+{
+	int bits = 0;
+	while ((1 << bits) < SPECTROGRAM_FFT_SIZE)
+		bits++;
+
+	for (int i = 0; i < SPECTROGRAM_FFT_SIZE; i++) {
+		hann_window[i] = 0.5f * (1.0f - cosf(2.0f * M_PI * i / (SPECTROGRAM_FFT_SIZE - 1)));
+		uint16_t r = 0;
+		for (int b = 0; b < bits; b++)
+			if (i & (1 << b))
+				r |= 1 << (bits - 1 - b);
+		bit_reverse[i] = r;
+	}
+}
+
+// iterative radix-2 FFT, in place
+static void fft(float *re, float *im)
+{
+	for (int i = 0; i < SPECTROGRAM_FFT_SIZE; i++) {
+		int j = bit_reverse[i];
+		if (j > i) {
+			float t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+
+	for (int size = 2; size <= SPECTROGRAM_FFT_SIZE; size *= 2) {
+		float angle = -2.0f * M_PI / size;
+		float wr = cosf(angle), wi = sinf(angle);
+		for (int start = 0; start < SPECTROGRAM_FFT_SIZE; start += size) {
+			float cr = 1.0f, ci = 0.0f;
+			for (int k = 0; k < size / 2; k++) {
+				int a = start + k, b = start + k + size / 2;
+				float tr = cr * re[b] - ci * im[b];
+				float ti = cr * im[b] + ci * re[b];
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+				float ncr = cr * wr - ci * wi;
+				ci = cr * wi + ci * wr;
+				cr = ncr;
+			}
+		}
+	}
+}
+
+// -90dBFS..0dBFS mapped onto a black-blue-cyan-yellow-white ramp
+static uint32_t colormap(float db)
+{
+	float t = (db + 90.0f) / 90.0f;
+	if (t < 0.0f) t = 0.0f;
+	if (t > 1.0f) t = 1.0f;
+
+	int r, g, b;
+	if (t < 0.25f) {            // black -> blue
+		r = 0; g = 0; b = (int)(t * 4 * 255);
+	} else if (t < 0.5f) {      // blue -> cyan
+		r = 0; g = (int)((t - 0.25f) * 4 * 255); b = 255;
+	} else if (t < 0.75f) {     // cyan -> yellow
+		r = (int)((t - 0.5f) * 4 * 255); g = 255; b = 255 - r;
+	} else {                    // yellow -> white
+		r = 255; g = 255; b = (int)((t - 0.75f) * 4 * 255);
+	}
+	return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+// FFT one window and render it as pixel column 'col' (row 0 = fs/2)
+static void compute_column(int col)
+{
+	float re[SPECTROGRAM_FFT_SIZE], im[SPECTROGRAM_FFT_SIZE];
+	const int *src = spec_samples + col * SPECTROGRAM_HOP;
+
+	for (int i = 0; i < SPECTROGRAM_FFT_SIZE; i++) {
+		re[i] = src[i] * hann_window[i];
+		im[i] = 0.0f;
+	}
+	fft(re, im);
+
+	// full scale = +/-128 samples coherently in one bin
+	const float fullscale = 128.0f * SPECTROGRAM_FFT_SIZE / 2;
+	for (int bin = 0; bin < SPECTROGRAM_BINS; bin++) {
+		float mag = sqrtf(re[bin] * re[bin] + im[bin] * im[bin]);
+		float db = 20.0f * log10f(mag / fullscale + 1e-10f);
+		spec_pixels[(SPECTROGRAM_BINS - 1 - bin) * SPECTROGRAM_MAX_COLS + col] = colormap(db);
+	}
+}
+
+static void *spectrogram_thread(void *arg)
+{
+	unsigned int last_graph_seq = (unsigned int)-1;
+
+	for (;;) {
+		pthread_mutex_lock(&spec_mutex);
+		while (!spec_active)
+			pthread_cond_wait(&spec_cond, &spec_mutex);
+		pthread_mutex_unlock(&spec_mutex);
+
+		unsigned int graph_seq = GraphSnapshotSeq();
+		if (graph_seq != last_graph_seq) {
+			int new_len = 0;
+			last_graph_seq = GraphSnapshotRead(spec_incoming, spec_overlay, &new_len);
+
+			// if the old samples are an unchanged prefix (streaming append),
+			// recompute only the columns whose window reaches the new data
+			int start_col = 0;
+			int common = (new_len < spec_len) ? new_len : spec_len;
+			if (common == spec_len && memcmp(spec_samples, spec_incoming, common * sizeof(int)) == 0) {
+				if (spec_len >= SPECTROGRAM_FFT_SIZE)
+					start_col = (spec_len - SPECTROGRAM_FFT_SIZE) / SPECTROGRAM_HOP + 1;
+			}
+			memcpy(spec_samples, spec_incoming, new_len * sizeof(int));
+			spec_len = new_len;
+
+			int ncols = 0;
+			if (spec_len >= SPECTROGRAM_FFT_SIZE)
+				ncols = (spec_len - SPECTROGRAM_FFT_SIZE) / SPECTROGRAM_HOP + 1;
+
+			__atomic_fetch_add(&spec_seq, 1, __ATOMIC_ACQ_REL);
+			for (int col = start_col; col < ncols; col++)
+				compute_column(col);
+			spec_cols = ncols;
+			__atomic_fetch_add(&spec_seq, 1, __ATOMIC_ACQ_REL);
+
+			RepaintGraphWindow();
+		}
+
+		msleep(100);
+	}
+	return NULL;
+}
+
+void SpectrogramSetActive(bool active)
+{
+	pthread_mutex_lock(&spec_mutex);
+	if (active && !spec_thread_started) {
+		spectrogram_init_tables();
+		pthread_t thread;
+		pthread_create(&thread, NULL, spectrogram_thread, NULL);
+		pthread_detach(thread);
+		spec_thread_started = true;
+	}
+	spec_active = active;
+	pthread_cond_signal(&spec_cond);
+	pthread_mutex_unlock(&spec_mutex);
+}
+
+unsigned int SpectrogramRead(uint32_t *dst, int *width, int *height)
+{
+	for (;;) {
+		unsigned int seq = __atomic_load_n(&spec_seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		int cols = spec_cols;
+		memcpy(dst, spec_pixels, sizeof(spec_pixels));
+		if (__atomic_load_n(&spec_seq, __ATOMIC_ACQUIRE) == seq) {
+			*width = cols;
+			*height = SPECTROGRAM_BINS;
+			return seq;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Incremental spectrogram over the graph buffer (see spectrogram.c)
+//-----------------------------------------------------------------------------
+
+#ifndef SPECTROGRAM_H__
+#define SPECTROGRAM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "graph.h"	// MAX_GRAPH_TRACE_LEN
+
+#define SPECTROGRAM_FFT_SIZE 512
+#define SPECTROGRAM_BINS (SPECTROGRAM_FFT_SIZE / 2)
+// windows overlap by half, one pixel column per window
+#define SPECTROGRAM_HOP SPECTROGRAM_BINS
+#define SPECTROGRAM_MAX_COLS (MAX_GRAPH_TRACE_LEN / SPECTROGRAM_HOP)
+#define SPECTROGRAM_MAX_PIXELS (SPECTROGRAM_MAX_COLS * SPECTROGRAM_BINS)
+
+// start/stop the worker thread that follows the graph snapshot
+void SpectrogramSetActive(bool active);
+
+// copy the latest rendered spectrogram (0xRRGGBB pixels, row 0 = fs/2,
+// bottom row = DC) into dst; returns the publish sequence number
+unsigned int SpectrogramRead(uint32_t *dst, int *width, int *height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -124,19 +124,30 @@ static const manufacturerName_t manufacturerMapping[] = {
 	{ 0x6A, "SEVENEY France"},
 	{ 0x6B, "ISSM France"},
 	{ 0x6C, "Wisesec Ltd Israel"},
+	{ 0x7C, "DB HiTek Co Ltd Korea"},
+	{ 0x7D, "SATO Vicinity Australia"},
 	{ 0x7E, "Holtek Taiwan"},
 	{ 0x00, "Unknown" } // must be the last entry
 };
 
-// get manufacturer's name and country based on the manufacturer byte
+// get manufacturer's name and country based on the manufacturer byte.
+// The table is kept sorted by manufacturer byte, so a binary search does -
+// this runs on every card selection display.
 char *getManufacturerName(uint8_t vendorID)
 {
-	int i;
 	int len = sizeof(manufacturerMapping) / sizeof(manufacturerName_t);
+	int lo = 0;
+	int hi = len - 2;	// exclude the default entry at the end
 
-	for (i = 0; i < len; ++i)
-		if (vendorID == manufacturerMapping[i].manufacturer_byte)
-			return manufacturerMapping[i].desc;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (manufacturerMapping[mid].manufacturer_byte < vendorID)
+			lo = mid + 1;
+		else if (manufacturerMapping[mid].manufacturer_byte > vendorID)
+			hi = mid - 1;
+		else
+			return manufacturerMapping[mid].desc;
+	}
 
 	//No match, return default
 	return manufacturerMapping[len-1].desc;
@@ -227,25 +238,33 @@ const chipinfo_t chipIDmapping[] = {
 
 // get a product description based on the UID
 //      uid[8]  tag uid
-// returns description of the best match
+// returns description of the best match.
+// The table is grouped by manufacturer in ascending order: binary search the
+// start of the manufacturer's group, then only its entries are checked for
+// the best (most specific mask) match.
 char *getChipInfo(uint8_t vendorID, uint8_t chipID) {
-	int i = 0;
+	int count = sizeof(chipIDmapping) / sizeof(chipinfo_t) - 1;	// exclude the default entry
+	int lo = 0;
+	int hi = count;
 	int best = -1;
-	while (chipIDmapping[i].mask > 0) {
-		if (vendorID == chipIDmapping[i].manufacturer
-		    && (chipID & chipIDmapping[i].mask) == chipIDmapping[i].chipID) {
-			if (best == -1) {
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (chipIDmapping[mid].manufacturer < vendorID)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (int i = lo; i < count && chipIDmapping[i].manufacturer == vendorID; i++) {
+		if ((chipID & chipIDmapping[i].mask) == chipIDmapping[i].chipID) {
+			if (best == -1 || chipIDmapping[i].mask > chipIDmapping[best].mask) {
 				best = i;
-			} else {
-				if (chipIDmapping[i].mask > chipIDmapping[best].mask) {
-					best = i;
-				}
 			}
 		}
-		i++;
 	}
 
 	if (best >= 0) return chipIDmapping[best].desc;
 
-	return chipIDmapping[i].desc;
+	return chipIDmapping[count].desc;
 }
@@ -0,0 +1,204 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Binary trace containers (see tracefile.h for the layout)
+//-----------------------------------------------------------------------------
+
+#include "tracefile.h"
+
+#include <stdlib.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+uint32_t traceIndex(uint8_t *trace, uint32_t traceLen, tracefile_idx_t **index_out)
+{
+	uint32_t pos = 0, count = 0, capacity = 256;
+
+	*index_out = NULL;
+	tracefile_idx_t *index = malloc(capacity * sizeof(tracefile_idx_t));
+	if (index == NULL) return 0;
+
+	while (pos + sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint16_t) <= traceLen) {
+		uint32_t timestamp = *((uint32_t *)(trace + pos));
+		uint16_t data_len = *((uint16_t *)(trace + pos + 6));
+		bool isResponse = data_len & 0x8000;
+		data_len &= 0x7fff;
+		uint16_t parity_len = (data_len-1)/8 + 1;
+		if (pos + 8 + data_len + parity_len > traceLen) break;
+		if (count == capacity) {
+			capacity *= 2;
+			tracefile_idx_t *p = realloc(index, capacity * sizeof(tracefile_idx_t));
+			if (p == NULL) {
+				free(index);
+				return 0;
+			}
+			index = p;
+		}
+		index[count].pos = pos;
+		index[count].timestamp = timestamp;
+		index[count].data_len = data_len;
+		index[count].cmd = (data_len > 0) ? trace[pos + 8] : 0;
+		index[count].isResponse = isResponse ? 1 : 0;
+		count++;
+		pos += 8 + data_len + parity_len;
+	}
+
+	*index_out = index;
+	return count;
+}
+
+FILE *traceWriteOpen(const char *path)
+{
+	FILE *f = fopen(path, "wb+");
+	if (f == NULL) return NULL;
+
+	tracefile_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRACEFILE_MAGIC, TRACEFILE_MAGIC_LEN);
+	if (fwrite(&header, sizeof(header), 1, f) != 1) {
+		fclose(f);
+		return NULL;
+	}
+	return f;
+}
+
+bool traceWriteChunk(FILE *f, const uint8_t *data, uint32_t len)
+{
+	return fwrite(data, 1, len, f) == len;
+}
+
+int traceWriteClose(FILE *f)
+{
+	long end = ftell(f);
+	if (end < (long)sizeof(tracefile_header_t)) {
+		fclose(f);
+		return 1;
+	}
+	uint32_t traceLen = end - sizeof(tracefile_header_t);
+
+	// read the data back to build the index - during a streamed download it
+	// was never in memory as one block
+	int result = 1;
+	tracefile_idx_t *index = NULL;
+	uint32_t frames = 0;
+	uint8_t *trace = malloc(traceLen);
+	if (trace != NULL
+			&& fseek(f, sizeof(tracefile_header_t), SEEK_SET) == 0
+			&& fread(trace, 1, traceLen, f) == traceLen) {
+		frames = traceIndex(trace, traceLen, &index);
+	}
+	if (index != NULL
+			&& fseek(f, 0, SEEK_END) == 0
+			&& (frames == 0 || fwrite(index, sizeof(tracefile_idx_t), frames, f) == frames)) {
+		tracefile_header_t header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, TRACEFILE_MAGIC, TRACEFILE_MAGIC_LEN);
+		header.traceLen = traceLen;
+		header.frames = frames;
+		if (fseek(f, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, f) == 1) {
+			result = 0;
+		}
+	}
+
+	free(index);
+	free(trace);
+	fclose(f);
+	return result;
+}
+
+tracefile_t *traceOpen(const char *path)
+{
+	tracefile_t *tf = calloc(1, sizeof(tracefile_t));
+	if (tf == NULL) return NULL;
+
+#if !defined(_WIN32)
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		free(tf);
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		free(tf);
+		return NULL;
+	}
+	if (st.st_size == 0) {		// empty capture
+		close(fd);
+		return tf;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		free(tf);
+		return NULL;
+	}
+	tf->mapped = true;
+	tf->map = map;
+	tf->maplen = st.st_size;
+#else
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		free(tf);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (size == 0) {		// empty capture
+		fclose(f);
+		return tf;
+	}
+	if (size > 0) {
+		tf->map = malloc(size);
+		if (tf->map != NULL && fread(tf->map, 1, size, f) == (size_t)size) {
+			tf->maplen = size;
+		} else {
+			free(tf->map);
+			tf->map = NULL;
+		}
+	}
+	fclose(f);
+	if (tf->map == NULL) {
+		free(tf);
+		return NULL;
+	}
+#endif
+
+	tracefile_header_t *header = (tracefile_header_t *)tf->map;
+	if (tf->maplen >= sizeof(tracefile_header_t)
+			&& memcmp(header->magic, TRACEFILE_MAGIC, TRACEFILE_MAGIC_LEN) == 0
+			&& sizeof(tracefile_header_t) + header->traceLen
+				+ (size_t)header->frames * sizeof(tracefile_idx_t) <= tf->maplen) {
+		tf->trace = (uint8_t *)tf->map + sizeof(tracefile_header_t);
+		tf->traceLen = header->traceLen;
+		tf->index = (tracefile_idx_t *)(tf->trace + tf->traceLen);
+		tf->frames = header->frames;
+	} else {
+		// legacy raw capture, no index
+		tf->trace = (uint8_t *)tf->map;
+		tf->traceLen = tf->maplen;
+	}
+	return tf;
+}
+
+void traceClose(tracefile_t *tf)
+{
+	if (tf == NULL) return;
+#if !defined(_WIN32)
+	if (tf->mapped) {
+		munmap(tf->map, tf->maplen);
+	} else
+#endif
+	{
+		free(tf->map);
+	}
+	free(tf);
+}
@@ -0,0 +1,70 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Binary trace containers. A container is the raw trace bytes as they come
+// out of BigBuf, prefixed by a small header and followed by a frame index,
+// so a saved sniff can be memory-mapped and single frames addressed without
+// re-parsing the whole capture. Files without the magic are loaded as legacy
+// raw captures. The same layout is read by lualibs/tracelib.lua.
+//-----------------------------------------------------------------------------
+
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define TRACEFILE_MAGIC		"TRC1"
+#define TRACEFILE_MAGIC_LEN	4
+
+typedef struct {
+	char magic[TRACEFILE_MAGIC_LEN];
+	uint32_t traceLen;	// length of the raw trace data following the header
+	uint32_t frames;	// entries in the frame index following the data
+	uint32_t reserved;
+} tracefile_header_t;	// 16 bytes, fixed layout, little endian
+
+// one frame of the trace. Written to disk as the frame index and used in
+// memory to select frames without annotating them
+typedef struct {
+	uint32_t pos;		// offset of the frame within the raw trace data
+	uint32_t timestamp;
+	uint16_t data_len;
+	uint8_t cmd;		// first data byte, 0 for empty frames
+	uint8_t isResponse;
+} tracefile_idx_t;		// 12 bytes, fixed layout, little endian
+
+typedef struct {
+	uint8_t *trace;			// raw trace bytes
+	uint32_t traceLen;
+	tracefile_idx_t *index;	// frame index, NULL for legacy raw captures
+	uint32_t frames;
+	bool mapped;			// true: release with munmap, false: with free
+	void *map;				// the whole file, as mapped or read
+	size_t maplen;
+} tracefile_t;
+
+// walk a raw trace once and record where every frame starts. Returns the
+// number of frames; *index_out gets the malloc'd index (NULL on failure)
+extern uint32_t traceIndex(uint8_t *trace, uint32_t traceLen, tracefile_idx_t **index_out);
+
+// streaming writer: traceWriteOpen() writes a placeholder header,
+// traceWriteChunk() appends raw trace bytes as they arrive (the capture
+// never needs to be in memory in one piece), traceWriteClose() builds the
+// frame index and patches the header. Abort a failed write with fclose().
+extern FILE *traceWriteOpen(const char *path);
+extern bool traceWriteChunk(FILE *f, const uint8_t *data, uint32_t len);
+extern int traceWriteClose(FILE *f);
+
+// load a saved capture, memory-mapped where the platform allows it.
+// Returns NULL if the file cannot be opened.
+extern tracefile_t *traceOpen(const char *path);
+
+// release the capture
+extern void traceClose(tracefile_t *tf);
+
+#endif
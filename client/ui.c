@@ -14,9 +14,16 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 #include <readline/readline.h>
 #include <pthread.h>
 #include "util.h"
+#include "util_posix.h"
 #endif
 
 #include "ui.h"
@@ -32,6 +39,139 @@ static char *logfilename = "proxmark3.log";
 
 #ifndef EXTERNAL_PRINTANDLOG
 static pthread_mutex_t print_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *logfile = NULL;
+static int logging = 1;
+
+// Logfile persistence runs on a dedicated writer thread so that a slow disk
+// (network share, spun-down drive) never stalls the thread producing output -
+// an active attack loop must not be backpressured by log IO. Producers append
+// finished lines to a bounded ring buffer while holding print_lock, so the
+// ring carries lines in the same order they reached the console. The writer
+// owns the FILE*, flushes once per drained block and fsyncs at most every
+// couple of seconds. When the ring is full the new data is dropped (and
+// counted) rather than blocking; a marker line records the loss once the
+// writer catches up.
+#define LOG_RING_SIZE (1 << 20)
+#define LOG_SYNC_INTERVAL_MS 2000
+static char log_ring[LOG_RING_SIZE];
+static size_t log_head = 0;		// producer writes here
+static size_t log_tail = 0;		// writer reads here
+static size_t log_dropped = 0;
+static bool log_thread_started = false;
+static bool log_thread_stop = false;
+static pthread_t log_thread;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_cond = PTHREAD_COND_INITIALIZER;
+
+// copy into the ring at log_head; caller holds log_lock and checked space
+static void LogRingPut(const char *data, size_t len)
+{
+	size_t first = LOG_RING_SIZE - log_head;
+	if (first > len) first = len;
+	memcpy(&log_ring[log_head], data, first);
+	memcpy(log_ring, data + first, len - first);
+	log_head = (log_head + len) % LOG_RING_SIZE;
+}
+
+static void *LogWriter(void *arg)
+{
+	(void) arg;
+	uint64_t last_sync = msclock();
+
+	pthread_mutex_lock(&log_lock);
+	for (;;) {
+		while (log_head == log_tail && !log_thread_stop) {
+			pthread_cond_wait(&log_cond, &log_lock);
+		}
+		bool stopping = log_thread_stop;
+		size_t head = log_head;
+		size_t tail = log_tail;
+		pthread_mutex_unlock(&log_lock);
+
+		if (logging && !logfile) {
+			logfile = fopen(logfilename, "a");
+			if (!logfile) {
+				fprintf(stderr, "Can't open logfile, logging disabled!\n");
+				logging = 0;
+			}
+		}
+
+		while (tail != head) {
+			size_t chunk = (head > tail) ? head - tail : LOG_RING_SIZE - tail;
+			if (logfile) {
+				fwrite(&log_ring[tail], 1, chunk, logfile);
+			}
+			tail = (tail + chunk) % LOG_RING_SIZE;
+		}
+
+		if (logfile) {
+			fflush(logfile);
+			if (stopping || msclock() - last_sync >= LOG_SYNC_INTERVAL_MS) {
+#ifdef _WIN32
+				_commit(_fileno(logfile));
+#else
+				fsync(fileno(logfile));
+#endif
+				last_sync = msclock();
+			}
+		}
+
+		pthread_mutex_lock(&log_lock);
+		log_tail = tail;
+		if (stopping && log_head == log_tail)
+			break;
+	}
+	pthread_mutex_unlock(&log_lock);
+	return NULL;
+}
+
+// atexit: drain what is queued so the tail of a session makes it to disk
+static void LogShutdown(void)
+{
+	pthread_mutex_lock(&log_lock);
+	log_thread_stop = true;
+	pthread_cond_signal(&log_cond);
+	pthread_mutex_unlock(&log_lock);
+	pthread_join(log_thread, NULL);
+}
+
+// called with print_lock held - that serialization is what keeps the log in
+// console order. Never blocks: on a full ring the data is dropped instead.
+static void LogAppend(const char *data, size_t len)
+{
+	pthread_mutex_lock(&log_lock);
+
+	if (!log_thread_started) {
+		if (pthread_create(&log_thread, NULL, LogWriter, NULL) != 0) {
+			fprintf(stderr, "Can't start log writer, logging disabled!\n");
+			logging = 0;
+			pthread_mutex_unlock(&log_lock);
+			return;
+		}
+		log_thread_started = true;
+		atexit(LogShutdown);
+	}
+
+	size_t space = (log_tail + LOG_RING_SIZE - log_head - 1) % LOG_RING_SIZE;
+
+	if (log_dropped) {
+		char marker[64];
+		int n = snprintf(marker, sizeof(marker), "[log writer dropped %lu bytes]\n", (unsigned long)log_dropped);
+		if (n > 0 && (size_t)n + len <= space) {
+			LogRingPut(marker, n);
+			space -= n;
+			log_dropped = 0;
+		}
+	}
+
+	if (len > space) {
+		log_dropped += len;
+	} else {
+		LogRingPut(data, len);
+		pthread_cond_signal(&log_cond);
+	}
+	pthread_mutex_unlock(&log_lock);
+}
 
 void PrintAndLogEx(logLevel_t level, char *fmt, ...) {
 
@@ -109,19 +249,9 @@ void PrintAndLog(char *fmt, ...)
 	char *saved_line;
 	int saved_point;
 	va_list argptr, argptr2;
-	static FILE *logfile = NULL;
-	static int logging=1;
 
 	// lock this section to avoid interlacing prints from different threads
 	pthread_mutex_lock(&print_lock);
-  
-	if (logging && !logfile) {
-		logfile=fopen(logfilename, "a");
-		if (!logfile) {
-			fprintf(stderr, "Can't open logfile, logging disabled!\n");
-			logging=0;
-		}
-	}
 
 	// If there is an incoming message from the hardware (eg: lf hid read) in
 	// the background (while the prompt is displayed and accepting user input),
@@ -157,10 +287,15 @@ void PrintAndLog(char *fmt, ...)
 	}
 #endif
 	
-	if (logging && logfile) {
-		vfprintf(logfile, fmt, argptr2);
-		fprintf(logfile,"\n");
-		fflush(logfile);
+	if (logging) {
+		char logline[MAX_PRINT_BUFFER + 1];
+		int n = vsnprintf(logline, sizeof(logline) - 1, fmt, argptr2);
+		if (n >= 0) {
+			if (n > (int)sizeof(logline) - 2)
+				n = sizeof(logline) - 2;
+			logline[n] = '\n';
+			LogAppend(logline, n + 1);
+		}
 	}
 	va_end(argptr2);
 
@@ -169,10 +304,148 @@ void PrintAndLog(char *fmt, ...)
 		fflush(NULL);
 	}
 	//release lock
-	pthread_mutex_unlock(&print_lock);  
+	pthread_mutex_unlock(&print_lock);
+}
+
+
+// Buffered batch output for high volume listings. Every PrintAndLog line
+// pays for varargs formatting, a possible readline prompt stash and a
+// flushed logfile write - per-line costs that dominate a command printing
+// tens of thousands of lines. A batch collects finished lines in one buffer
+// and writes console and logfile in large blocks instead: reserve space for
+// one line, fill it, commit, and PrintBatchEnd() flushes what is left.
+// Output from other threads can interleave only at flush points.
+#define PRINT_BATCH_SIZE (256*1024)
+static char *print_batch_buf = NULL;
+static size_t print_batch_len = 0;
+static bool print_batch_active = false;
+static bool print_batch_fallback = false;
+static char print_batch_line[MAX_PRINT_BUFFER];
+
+static void PrintBatchFlush(void)
+{
+	if (print_batch_len == 0) return;
+
+	char *saved_line;
+	int saved_point;
+
+	pthread_mutex_lock(&print_lock);
+
+#ifdef RL_STATE_READCMD
+	// We are using GNU readline. libedit (OSX) doesn't support this flag.
+	int need_hack = (rl_readline_state & RL_STATE_READCMD) > 0;
+
+	if (need_hack) {
+		saved_point = rl_point;
+		saved_line = rl_copy_text(0, rl_end);
+		rl_save_prompt();
+		rl_replace_line("", 0);
+		rl_redisplay();
+	}
+#endif
+
+	fwrite(print_batch_buf, 1, print_batch_len, stdout);
+
+#ifdef RL_STATE_READCMD
+	// We are using GNU readline. libedit (OSX) doesn't support this flag.
+	if (need_hack) {
+		rl_restore_prompt();
+		rl_replace_line(saved_line, 0);
+		rl_point = saved_point;
+		rl_redisplay();
+		free(saved_line);
+	}
+#endif
+
+	if (logging) {
+		LogAppend(print_batch_buf, print_batch_len);
+	}
+
+	if (flushAfterWrite)  //buzzy
+	{
+		fflush(NULL);
+	}
+
+	print_batch_len = 0;
+	pthread_mutex_unlock(&print_lock);
+}
+
+void PrintBatchBegin(void)
+{
+	if (print_batch_buf == NULL) {
+		print_batch_buf = malloc(PRINT_BATCH_SIZE);	// kept allocated for the next batch
+	}
+	print_batch_active = (print_batch_buf != NULL);
+}
+
+// returns a buffer good for maxlen characters plus NUL. Without an active
+// batch (or for oversized lines) a per-line fallback through PrintAndLog
+// keeps the API usable everywhere.
+char *PrintBatchReserve(size_t maxlen)
+{
+	if (!print_batch_active || maxlen + 2 > sizeof(print_batch_line)) {
+		print_batch_fallback = true;
+		print_batch_line[0] = '\0';
+		return print_batch_line;
+	}
+	print_batch_fallback = false;
+	if (print_batch_len + maxlen + 2 > PRINT_BATCH_SIZE) {
+		PrintBatchFlush();
+	}
+	print_batch_buf[print_batch_len] = '\0';
+	return print_batch_buf + print_batch_len;
+}
+
+void PrintBatchCommit(void)
+{
+	if (print_batch_fallback) {
+		PrintAndLog("%s", print_batch_line);
+		return;
+	}
+	print_batch_len += strlen(print_batch_buf + print_batch_len);
+	print_batch_buf[print_batch_len++] = '\n';
+}
+
+void PrintBatchEnd(void)
+{
+	PrintBatchFlush();
+	print_batch_active = false;
 }
 #endif
 
+// Shared renderer for CMD_PROGRESS_REPORT messages from long-running
+// firmware loops (see SendProgress in armsrc). Goes through PrintAndLog so
+// reports land in the log and play nicely with the readline prompt.
+void PrintProgress(uint64_t done, uint64_t total, uint64_t elapsed_ms)
+{
+	uint64_t elapsed_s = elapsed_ms / 1000;
+	if (total == 0 || done > total) {
+		PrintAndLog("progress: %llu done, elapsed %llu:%02llu",
+			(unsigned long long)done,
+			(unsigned long long)(elapsed_s / 60), (unsigned long long)(elapsed_s % 60));
+		return;
+	}
+
+	char bar[22];
+	int filled = (int)(done * 20 / total);
+	for (int i = 0; i < 20; i++)
+		bar[i] = (i < filled) ? '=' : ' ';
+	bar[20] = '\0';
+
+	if (done > 0) {
+		uint64_t eta_s = elapsed_ms * (total - done) / done / 1000;
+		PrintAndLog("progress: [%s] %llu%% %llu/%llu, elapsed %llu:%02llu, eta %llu:%02llu",
+			bar, (unsigned long long)(done * 100 / total),
+			(unsigned long long)done, (unsigned long long)total,
+			(unsigned long long)(elapsed_s / 60), (unsigned long long)(elapsed_s % 60),
+			(unsigned long long)(eta_s / 60), (unsigned long long)(eta_s % 60));
+	} else {
+		PrintAndLog("progress: [%s] 0%% 0/%llu, elapsed %llu:%02llu",
+			bar, (unsigned long long)total,
+			(unsigned long long)(elapsed_s / 60), (unsigned long long)(elapsed_s % 60));
+	}
+}
+
 void SetLogFilename(char *fn)
 {
   logfilename = fn;
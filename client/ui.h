@@ -13,6 +13,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #define MAX_PRINT_BUFFER 2048
 typedef enum logLevel {NORMAL, SUCCESS, INFO, FAILED, WARNING, ERR, DEBUG} logLevel_t;
@@ -23,7 +24,14 @@ void ShowGraphWindow(void);
 void RepaintGraphWindow(void);
 void PrintAndLog(char *fmt, ...);
 void PrintAndLogEx(logLevel_t level, char *fmt, ...);
+
+// buffered batch output for high volume listings - see ui.c
+void PrintBatchBegin(void);
+char *PrintBatchReserve(size_t maxlen);
+void PrintBatchCommit(void);
+void PrintBatchEnd(void);
 void SetLogFilename(char *fn);
+void PrintProgress(uint64_t done, uint64_t total, uint64_t elapsed_ms);
 void SetFlushAfterWrite(bool flush_after_write);
 
 extern double CursorScaleFactor;
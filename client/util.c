@@ -193,6 +193,20 @@ void hex_to_buffer(const uint8_t *buf, const uint8_t *hex_data, const size_t hex
 
 // printing and converting functions
 
+const char hex_digits_lower[] = "0123456789abcdef";
+
+// table driven "ab cd ef " hex fill for high volume output paths like the
+// batch printing API - no per-byte sprintf, no NUL termination. Returns the
+// position after the last written character.
+char *hex_fill(char *dst, const uint8_t *data, const size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		*dst++ = hex_digits_lower[data[i] >> 4];
+		*dst++ = hex_digits_lower[data[i] & 0x0f];
+		*dst++ = ' ';
+	}
+	return dst;
+}
+
 char *sprint_hex(const uint8_t *data, const size_t len) {
 	static char buf[4097] = {0};
 
@@ -98,9 +98,11 @@ extern void FillFileNameByUID(char *fileName, uint8_t * uid, char *ext, int byte
 extern int FillBuffer(uint8_t *data, size_t maxDataLength, size_t *dataLength, ...);
 
 extern bool CheckStringIsHEXValue(const char *value);
-extern void hex_to_buffer(const uint8_t *buf, const uint8_t *hex_data, const size_t hex_len, 
+extern void hex_to_buffer(const uint8_t *buf, const uint8_t *hex_data, const size_t hex_len,
 	const size_t hex_max_len, const size_t min_str_len, const size_t spaces_between, bool uppercase);
 
+extern const char hex_digits_lower[];
+extern char *hex_fill(char *dst, const uint8_t *data, const size_t len);
 extern char *sprint_hex(const uint8_t * data, const size_t len);
 extern char *sprint_hex_inrow(const uint8_t *data, const size_t len);
 extern char *sprint_hex_inrow_ex(const uint8_t *data, const size_t len, const size_t min_str_len);
@@ -0,0 +1,131 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Shared worker thread pool for parallel client commands
+//
+// Every parallel command used to roll its own pthread_create arrays and
+// ad-hoc mutexes. This module owns one pool of num_CPUs() workers, started
+// lazily on the first submit and kept for the lifetime of the session. Idle
+// workers pull the next pending task off a single shared list, so submitting
+// several small tasks per core gets load balancing for free: fast tasks
+// finish early and their workers pick up whatever is still queued.
+//-----------------------------------------------------------------------------
+
+#include "workqueue.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "util.h"
+
+typedef struct workqueue_entry {
+	workqueue_task_t func;
+	void *arg;
+	struct workqueue_entry *next;
+} workqueue_entry_t;
+
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_nonempty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_idle = PTHREAD_COND_INITIALIZER;
+static workqueue_entry_t *queue_head = NULL;
+static workqueue_entry_t *queue_tail = NULL;
+static pthread_t *worker_ids = NULL;
+static int num_workers = 0;
+static int num_unfinished = 0;		// queued plus currently running tasks
+static bool shutting_down = false;
+
+static void *worker_thread(void *arg)
+{
+	(void)arg;
+	pthread_mutex_lock(&queue_mutex);
+	while (true) {
+		while (queue_head == NULL && !shutting_down) {
+			pthread_cond_wait(&queue_nonempty, &queue_mutex);
+		}
+		if (queue_head == NULL) break;		// shutting down and queue drained
+
+		workqueue_entry_t *entry = queue_head;
+		queue_head = entry->next;
+		if (queue_head == NULL) queue_tail = NULL;
+
+		pthread_mutex_unlock(&queue_mutex);
+		entry->func(entry->arg);
+		free(entry);
+		pthread_mutex_lock(&queue_mutex);
+
+		num_unfinished--;
+		if (num_unfinished == 0) {
+			pthread_cond_broadcast(&queue_idle);
+		}
+	}
+	pthread_mutex_unlock(&queue_mutex);
+	return NULL;
+}
+
+// called with queue_mutex held
+static void start_workers(void)
+{
+	num_workers = num_CPUs();
+	worker_ids = calloc(num_workers, sizeof(pthread_t));
+	for (int i = 0; i < num_workers; i++) {
+		pthread_create(&worker_ids[i], NULL, worker_thread, NULL);
+	}
+}
+
+int workqueue_num_workers(void)
+{
+	return num_CPUs();
+}
+
+int workqueue_submit(workqueue_task_t func, void *arg)
+{
+	workqueue_entry_t *entry = malloc(sizeof(workqueue_entry_t));
+	if (entry == NULL) return 1;
+	entry->func = func;
+	entry->arg = arg;
+	entry->next = NULL;
+
+	pthread_mutex_lock(&queue_mutex);
+	if (worker_ids == NULL) start_workers();
+	if (queue_tail == NULL) {
+		queue_head = entry;
+	} else {
+		queue_tail->next = entry;
+	}
+	queue_tail = entry;
+	num_unfinished++;
+	pthread_cond_signal(&queue_nonempty);
+	pthread_mutex_unlock(&queue_mutex);
+	return 0;
+}
+
+void workqueue_join(void)
+{
+	pthread_mutex_lock(&queue_mutex);
+	while (num_unfinished > 0) {
+		pthread_cond_wait(&queue_idle, &queue_mutex);
+	}
+	pthread_mutex_unlock(&queue_mutex);
+}
+
+void workqueue_shutdown(void)
+{
+	pthread_mutex_lock(&queue_mutex);
+	if (worker_ids == NULL) {
+		pthread_mutex_unlock(&queue_mutex);
+		return;
+	}
+	shutting_down = true;
+	pthread_cond_broadcast(&queue_nonempty);
+	pthread_mutex_unlock(&queue_mutex);
+
+	for (int i = 0; i < num_workers; i++) {
+		pthread_join(worker_ids[i], NULL);
+	}
+	free(worker_ids);
+	worker_ids = NULL;
+	num_workers = 0;
+	shutting_down = false;
+}
@@ -0,0 +1,19 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Shared worker thread pool for parallel client commands
+//-----------------------------------------------------------------------------
+
+#ifndef WORKQUEUE_H__
+#define WORKQUEUE_H__
+
+typedef void (*workqueue_task_t)(void *arg);
+
+extern int workqueue_num_workers(void);				// number of worker threads (num_CPUs())
+extern int workqueue_submit(workqueue_task_t func, void *arg);	// queue a task, returns 0 on success
+extern void workqueue_join(void);					// wait until every submitted task has finished
+extern void workqueue_shutdown(void);				// stop the workers (client exit)
+
+#endif
@@ -34,6 +34,27 @@
 #include "string.h"
 #include "proxmark3.h"
 
+// The main firmware queues response frames so timing-sensitive code doesn't
+// stall while the host drains the IN endpoint; the bootloader has no queue
+// and keeps the synchronous path.
+#ifdef ON_DEVICE
+#define cmd_usb_write usb_write_async
+#else
+#define cmd_usb_write usb_write
+#endif
+
+// Whether the client negotiated variable-length response frames
+// (CMD_FRAME_NEGOTIATE). Off by default so old clients keep working.
+static bool ng_frames_enabled = false;
+
+void cmd_ng_enable(bool enable) {
+  ng_frames_enabled = enable;
+}
+
+size_t cmd_max_payload_size(void) {
+  return ng_frames_enabled ? USB_CMD_DATA_SIZE_EXT : USB_CMD_DATA_SIZE;
+}
+
 bool cmd_receive(UsbCommand* cmd) {
  
   // Check if there is a usb packet available
@@ -71,8 +92,35 @@ bool cmd_send(uint32_t cmd, uint32_t arg0, uint32_t arg1, uint32_t arg2, void* d
   }
   
   // Send frame and make sure all bytes are transmitted
-  if (usb_write((byte_t*)&txcmd,sizeof(UsbCommand)) != 0) return false;
-  
+  if (cmd_usb_write((byte_t*)&txcmd,sizeof(UsbCommand)) != 0) return false;
+
+  return true;
+}
+
+bool cmd_send_ng(uint32_t cmd, uint32_t arg0, uint32_t arg1, uint32_t arg2, void* data, size_t len) {
+  UsbFrameNGHeader header;
+
+  // Fall back to the fixed-size format when the client didn't negotiate
+  if (!ng_frames_enabled) {
+    return cmd_send(cmd,arg0,arg1,arg2,data,len);
+  }
+
+  len = MIN(len,USB_CMD_DATA_SIZE_EXT);
+
+  // Compose the outgoing frame header
+  header.magic = USB_FRAME_NG_MAGIC;
+  header.datalen = len;
+  header.cmd = cmd;
+  header.arg[0] = arg0;
+  header.arg[1] = arg1;
+  header.arg[2] = arg2;
+
+  // Send header and payload straight from the source buffer - no bounce copy
+  if (cmd_usb_write((byte_t*)&header,sizeof(UsbFrameNGHeader)) != 0) return false;
+  if (data && len) {
+    if (cmd_usb_write((byte_t*)data,len) != 0) return false;
+  }
+
   return true;
 }
 
@@ -40,5 +40,10 @@
 bool cmd_receive(UsbCommand* cmd);
 bool cmd_send(uint32_t cmd, uint32_t arg0, uint32_t arg1, uint32_t arg2, void* data, size_t len);
 
+// Variable-length framing, negotiated by the client via CMD_FRAME_NEGOTIATE.
+void cmd_ng_enable(bool enable);
+size_t cmd_max_payload_size(void);
+bool cmd_send_ng(uint32_t cmd, uint32_t arg0, uint32_t arg1, uint32_t arg2, void* data, size_t len);
+
 #endif // _PROXMARK_CMD_H_
 
@@ -22,6 +22,30 @@
 #include <stdlib.h>
 #include "parity.h"
 
+#ifdef CRAPTO1_MULTIARCH
+// The client compiles this file once per instruction set (see MULTIARCHSRCS
+// in the client Makefile) and lfsr_recovery32() dispatches at runtime to the
+// variant for the widest set the CPU supports - the same scheme as
+// hardnested_bf_core. The wider objects contain only the recovery engine;
+// everything else is compiled into the NOSIMD object alone. Builds without
+// CRAPTO1_MULTIARCH (firmware, tools) are unaffected.
+#if defined (__AVX512F__)
+#define LFSR_RECOVERY32 lfsr_recovery32_AVX512
+#elif defined (__AVX2__)
+#define LFSR_RECOVERY32 lfsr_recovery32_AVX2
+#elif defined (__AVX__)
+#define LFSR_RECOVERY32 lfsr_recovery32_AVX
+#elif defined (__SSE2__)
+#define LFSR_RECOVERY32 lfsr_recovery32_SSE2
+#elif defined (__MMX__)
+#define LFSR_RECOVERY32 lfsr_recovery32_MMX
+#else
+#define LFSR_RECOVERY32 lfsr_recovery32_NOSIMD
+#endif
+#else
+#define LFSR_RECOVERY32 lfsr_recovery32
+#endif
+
 #if !defined LOWMEM && defined __GNUC__
 static uint8_t filterlut[1 << 20];
 static void __attribute__((constructor)) fill_lut()
@@ -215,7 +239,7 @@ recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
  * additionally you can use the in parameter to specify the value
  * that was fed into the lfsr at the time the keystream was generated
  */
-struct Crypto1State* lfsr_recovery32(uint32_t ks2, uint32_t in)
+struct Crypto1State* LFSR_RECOVERY32(uint32_t ks2, uint32_t in)
 {
 	struct Crypto1State *statelist;
 	uint32_t *odd_head = 0, *odd_tail = 0, oks = 0;
@@ -274,6 +298,58 @@ out:
 	return statelist;
 }
 
+// everything below is independent of the instruction set and is only needed once
+#if !defined(CRAPTO1_MULTIARCH) || !defined(__MMX__)
+
+#ifdef CRAPTO1_MULTIARCH
+
+#include "hardnested/hardnested_bf_core.h"	// SIMDExecInstr, GetSIMDInstrAuto()
+
+typedef struct Crypto1State* lfsr_recovery32_t(uint32_t, uint32_t);
+lfsr_recovery32_t lfsr_recovery32_AVX512;
+lfsr_recovery32_t lfsr_recovery32_AVX2;
+lfsr_recovery32_t lfsr_recovery32_AVX;
+lfsr_recovery32_t lfsr_recovery32_SSE2;
+lfsr_recovery32_t lfsr_recovery32_MMX;
+lfsr_recovery32_t lfsr_recovery32_NOSIMD;
+
+// determine the available instruction set at runtime and call the correct variant
+struct Crypto1State* lfsr_recovery32(uint32_t ks2, uint32_t in)
+{
+	lfsr_recovery32_t *lfsr_recovery32_function_p;
+
+	switch(GetSIMDInstrAuto()) {
+#if defined (__i386__) || defined (__x86_64__)
+#if !defined(__APPLE__) || (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1))
+#if (__GNUC__ >= 5) && (__GNUC__ > 5 || __GNUC_MINOR__ > 2)
+		case SIMD_AVX512:
+			lfsr_recovery32_function_p = &lfsr_recovery32_AVX512;
+			break;
+#endif
+		case SIMD_AVX2:
+			lfsr_recovery32_function_p = &lfsr_recovery32_AVX2;
+			break;
+		case SIMD_AVX:
+			lfsr_recovery32_function_p = &lfsr_recovery32_AVX;
+			break;
+		case SIMD_SSE2:
+			lfsr_recovery32_function_p = &lfsr_recovery32_SSE2;
+			break;
+		case SIMD_MMX:
+			lfsr_recovery32_function_p = &lfsr_recovery32_MMX;
+			break;
+#endif
+#endif
+		default:
+			lfsr_recovery32_function_p = &lfsr_recovery32_NOSIMD;
+			break;
+	}
+
+	return (*lfsr_recovery32_function_p)(ks2, in);
+}
+
+#endif // CRAPTO1_MULTIARCH
+
 static const uint32_t S1[] = {     0x62141, 0x310A0, 0x18850, 0x0C428, 0x06214,
 	0x0310A, 0x85E30, 0xC69AD, 0x634D6, 0xB5CDE, 0xDE8DA, 0x6F46D, 0xB3C83,
 	0x59E41, 0xA8995, 0xD027F, 0x6813F, 0x3409F, 0x9E6FA};
@@ -531,3 +607,5 @@ out:
 	free(even);
 	return statelist;
 }
+
+#endif // !defined(CRAPTO1_MULTIARCH) || !defined(__MMX__)
@@ -66,10 +66,42 @@ void crypto1_get_lfsr(struct Crypto1State *state, uint64_t *lfsr)
 		*lfsr = *lfsr << 1 | BIT(state->even, i ^ 3);
 	}
 }
+/* Table-accelerated filter. filter() in crapto1.h derives a 5-bit index
+ * from five nibbles of the state with five dependent shift/mask chains;
+ * here the nibble pairs are folded into three small lookup tables so one
+ * evaluation is three loads and an or. The tables (528 bytes) are built
+ * lazily on first use; entries are idempotent, so a concurrent first call
+ * from another thread at worst redoes the same stores.
+ */
+static uint8_t filt_lo[1 << 8];		// index bits 4..3 from state bits 0..7
+static uint8_t filt_mid[1 << 8];	// index bits 2..1 from state bits 8..15
+static uint8_t filt_hi[1 << 4];		// index bit  0    from state bits 16..19
+static int filt_init = 0;
+
+static void filter_tables_init(void)
+{
+	uint32_t i;
+	for (i = 0; i < (1 << 8); i++) {
+		filt_lo[i]  = (0xf22c0 >> (i      & 0xf) & 16) | (0x6c9c0 >> (i >> 4 & 0xf) & 8);
+		filt_mid[i] = (0x3c8b0 >> (i      & 0xf) &  4) | (0x1e458 >> (i >> 4 & 0xf) & 2);
+	}
+	for (i = 0; i < (1 << 4); i++)
+		filt_hi[i]  =  0x0d938 >> i & 1;
+	filt_init = 1;
+}
+
+static inline uint8_t filter_fast(uint32_t x)
+{
+	return BIT(0xEC57E80A, filt_lo[x & 0xff] | filt_mid[x >> 8 & 0xff] | filt_hi[x >> 16 & 0xf]);
+}
+
 uint8_t crypto1_bit(struct Crypto1State *s, uint8_t in, int is_encrypted)
 {
 	uint32_t feedin, t;
-	uint8_t ret = filter(s->odd);
+	uint8_t ret;
+
+	if (!filt_init) filter_tables_init();
+	ret = filter_fast(s->odd);
 
 	feedin  = ret & !!is_encrypted;
 	feedin ^= !!in;
@@ -81,33 +113,125 @@ uint8_t crypto1_bit(struct Crypto1State *s, uint8_t in, int is_encrypted)
 
 	return ret;
 }
+/* byte/word keep the whole state in registers across the unrolled bit loop
+ * instead of going through crypto1_bit()'s per-bit loads, stores and
+ * odd/even swap - these two run per encrypted block in MifareSim on the ARM
+ * and per candidate key in the client attacks.
+ */
 uint8_t crypto1_byte(struct Crypto1State *s, uint8_t in, int is_encrypted)
 {
-	uint8_t i, ret = 0;
-
-	for (i = 0; i < 8; ++i)
-		ret |= crypto1_bit(s, BIT(in, i), is_encrypted) << i;
+	uint32_t odd = s->odd, even = s->even, feedin, t;
+	uint8_t i, b, ret = 0;
+
+	if (!filt_init) filter_tables_init();
+
+	for (i = 0; i < 8; ++i) {
+		b = filter_fast(odd);
+		ret |= b << i;
+
+		feedin  = b & !!is_encrypted;
+		feedin ^= BIT(in, i);
+		feedin ^= LF_POLY_ODD & odd;
+		feedin ^= LF_POLY_EVEN & even;
+		t = even << 1 | evenparity32(feedin);
+		even = odd;
+		odd = t;
+	}
 
+	s->odd = odd;
+	s->even = even;
 	return ret;
 }
 uint32_t crypto1_word(struct Crypto1State *s, uint32_t in, int is_encrypted)
 {
-	uint32_t i, ret = 0;
-
-	for (i = 0; i < 32; ++i)
-		ret |= crypto1_bit(s, BEBIT(in, i), is_encrypted) << (i ^ 24);
+	uint32_t odd = s->odd, even = s->even, feedin, t, i, ret = 0;
+	uint8_t b;
+
+	if (!filt_init) filter_tables_init();
+
+	for (i = 0; i < 32; ++i) {
+		b = filter_fast(odd);
+		ret |= (uint32_t)b << (i ^ 24);
+
+		feedin  = b & !!is_encrypted;
+		feedin ^= BEBIT(in, i);
+		feedin ^= LF_POLY_ODD & odd;
+		feedin ^= LF_POLY_EVEN & even;
+		t = even << 1 | evenparity32(feedin);
+		even = odd;
+		odd = t;
+	}
 
+	s->odd = odd;
+	s->even = even;
 	return ret;
 }
 
+/* The tag prng is a 16-bit maximal LFSR (taps 16,14,13,11) observed through
+ * a 32-bit shift window: every step is linear over GF(2), so stepping by
+ * 2^k is a fixed 16x16 bit matrix. prng_jump[k][b] is the image of unit
+ * vector b under 2^k steps; level 0 is the single-step matrix and each
+ * further level is the previous one squared. 512 bytes, built lazily like
+ * the filter tables above.
+ */
+static uint16_t prng_jump[16][16];
+static int prng_jump_init = 0;
+
+static inline uint16_t prng16_apply(const uint16_t *m, uint16_t h)
+{
+	uint16_t r = 0;
+	int b;
+	for (b = 0; b < 16; b++)
+		if (h >> b & 1)
+			r ^= m[b];
+	return r;
+}
+
+static void prng_jump_tables_init(void)
+{
+	int k, b;
+	for (b = 0; b < 16; b++) {
+		uint16_t h = 1 << b;
+		prng_jump[0][b] = h >> 1 | ((h ^ h >> 2 ^ h >> 3 ^ h >> 5) & 1) << 15;
+	}
+	for (k = 1; k < 16; k++)
+		for (b = 0; b < 16; b++)
+			prng_jump[k][b] = prng16_apply(prng_jump[k - 1], prng_jump[k - 1][b]);
+	prng_jump_init = 1;
+}
+
 /* prng_successor
  * helper used to obscure the keystream during authentication
+ * O(log n): darkside resync and nonce distance checks walk this with
+ * counts in the tens of thousands.
  */
 uint32_t prng_successor(uint32_t x, uint32_t n)
 {
+	int i, k;
+	uint16_t h, h2;
+	uint32_t r;
+
 	SWAPENDIAN(x);
-	while(n--)
+	if (n < 32) {		// cheaper than the matrix walk, and keeps the
+		while(n--)	// window semantics for arbitrary low 16 bits
+			x = x >> 1 | (x >> 16 ^ x >> 18 ^ x >> 19 ^ x >> 21) << 31;
+		return SWAPENDIAN(x);
+	}
+
+	if (!prng_jump_init)
+		prng_jump_tables_init();
+
+	// 16 plain steps flush the original low half; from here on the top
+	// 16 bits are a pure LFSR state and the full window is two of them
+	for (i = 0; i < 16; i++)
 		x = x >> 1 | (x >> 16 ^ x >> 18 ^ x >> 19 ^ x >> 21) << 31;
+	h = x >> 16;				// state after 16 steps
+	r = (n - 32) % 65535;			// LFSR period (h == 0 is fixed anyway)
+	for (k = 0; r; ++k, r >>= 1)
+		if (r & 1)
+			h = prng16_apply(prng_jump[k], h);
+	h2 = prng16_apply(prng_jump[4], h);	// 16 more steps: upper half of the window
+	x = h | (uint32_t)h2 << 16;
 
 	return SWAPENDIAN(x);
 }
@@ -9,6 +9,7 @@
 
 #ifndef __CRC16_H
 #define __CRC16_H
+extern const uint16_t crc16_table_8408[256];	// reflected CCITT, shared with iso14443crc.c
 unsigned short update_crc16(unsigned short crc, unsigned char c);
 uint16_t crc16(uint8_t const *message, int length, uint16_t remainder, uint16_t polynomial);
 uint16_t crc16_ccitt(uint8_t const *message, int length);
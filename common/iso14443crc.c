@@ -7,27 +7,20 @@
 //-----------------------------------------------------------------------------
 
 #include "iso14443crc.h"
+#include "crc16.h"
 
-static unsigned short UpdateCrc14443(unsigned char ch, unsigned short *lpwCrc)
-{
-    ch = (ch ^ (unsigned char) ((*lpwCrc) & 0x00FF));
-    ch = (ch ^ (ch << 4));
-    *lpwCrc = (*lpwCrc >> 8) ^ ((unsigned short) ch << 8) ^
-              ((unsigned short) ch << 3) ^ ((unsigned short) ch >> 4);
-    return (*lpwCrc);
-}
-
+// Both 14443 CRC flavours step the bit-reflected CCITT polynomial 0x8408
+// and differ only in preset and final complement, so the table in crc16.c
+// replaces the closed-form bitfiddling from the spec.
 void ComputeCrc14443(int CrcType,
                      const unsigned char *Data, int Length,
                      unsigned char *TransmitFirst,
                      unsigned char *TransmitSecond)
 {
-    unsigned char chBlock;
     unsigned short wCrc=CrcType;
 
   do {
-        chBlock = *Data++;
-        UpdateCrc14443(chBlock, &wCrc);
+        wCrc = (wCrc >> 8) ^ crc16_table_8408[(wCrc ^ *Data++) & 0xff];
     } while (--Length);
 
     if (CrcType == CRC_14443_B)
@@ -39,3 +39,15 @@ uint8_t legic_prng_get_bit() {
   uint8_t idx = 7 - ( (lfsr.a & 4) | (lfsr.a >> 2 & 2) | (lfsr.a >> 4 & 1) );
   return lfsr.b >> idx & 1;
 }
+
+// draw the next count (max 32) keystream bits in one call, lsb first, and
+// advance the lfsr accordingly. Lets callers obfuscate a whole frame up
+// front instead of mixing prng math into their bit timing loops.
+uint32_t legic_prng_get_bits(uint8_t count) {
+  uint32_t bits = 0;
+  for(uint8_t i = 0; i < count; ++i) {
+    bits |= (uint32_t)legic_prng_get_bit() << i;
+    legic_prng_forward(1);
+  }
+  return bits;
+}
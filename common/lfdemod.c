@@ -43,42 +43,180 @@
 //**********************************************************************************************
 #define LOWEST_DEFAULT_CLOCK 32
 #define FSK_PSK_THRESHOLD   123
+// consecutive weak-ask modulation errors before askdemod_ext re-syncs
+#define ASK_RESYNC_BURST      4
 
 //to allow debug print calls when used not on device
 void dummy(char *fmt, ...){}
 #ifndef ON_DEVICE
+#include <stdlib.h> // for the demod intermediate cache below
 #include "ui.h"
 #include "cmdparser.h"
 #include "cmddata.h"
+#include "fskcorr_core.h"
+#include "lfprep_core.h"
 #define prnt PrintAndLog
-#else 
+#else
 	uint8_t g_debugMode=0;
 #define prnt dummy
 #endif
 
+#ifndef ON_DEVICE
+// Demod intermediate cache (client side only) - by caching the hi/lo envelope
+// and the threshold crossing positions of the sample buffer, re-running a demod
+// with a tweaked clock/invert only redoes the final decode stage instead of
+// rescanning the whole capture on every keystroke.
+//
+// Buffers are identified by a sampled fingerprint rather than an explicit
+// invalidation hook, so a fresh getFromGraphBuf() copy naturally misses and
+// rebuilds. Lookups additionally verify the sample at the returned position,
+// falling back to the linear scan on any mismatch.
+
+static uint32_t demodFingerprint(const uint8_t *buf, size_t size) {
+	uint32_t fp = 5381;
+	size_t step = size/64 + 1;
+	for (size_t i = 0; i < size; i += step)
+		fp = fp*33 + buf[i];
+	return fp;
+}
+
+static struct {
+	uint32_t fp;
+	size_t size;
+	uint8_t fuzzHi;
+	uint8_t fuzzLo;
+	int high;
+	int low;
+	int ret;
+	bool valid;
+} hiLoCache = {0};
+
+typedef struct {
+	uint32_t fp;
+	size_t size;
+	int threshold;
+	size_t *idx;    // sorted positions crossing the threshold
+	size_t count;
+	size_t alloced;
+	bool valid;
+} edgecache_t;
+
+static edgecache_t lowEdgeCache = {0};
+static edgecache_t highEdgeCache = {0};
+
+// rebuild the list of positions where cmp(samples[i], threshold) holds
+static void edgeCacheBuild(edgecache_t *c, uint8_t samples[], size_t size, int threshold, bool isLow) {
+	c->valid = false;
+	if (c->alloced < size) {
+		free(c->idx);
+		c->idx = malloc(size * sizeof(size_t));
+		if (c->idx == NULL) {
+			c->alloced = 0;
+			return;
+		}
+		c->alloced = size;
+	}
+	c->count = 0;
+	for (size_t i = 0; i < size; i++) {
+		if (isLow ? (samples[i] <= threshold) : (samples[i] >= threshold))
+			c->idx[c->count++] = i;
+	}
+	c->fp = demodFingerprint(samples, size);
+	c->size = size;
+	c->threshold = threshold;
+	c->valid = true;
+}
+
+// advance *i to the first cached crossing at or after it, returns false to
+// fall back to the linear scan
+static bool edgeCacheSeek(edgecache_t *c, uint8_t samples[], size_t size, int threshold, size_t *i, bool isLow) {
+	if (size < 512)
+		return false; // not worth caching
+	if (!c->valid || c->size != size || c->threshold != threshold || c->fp != demodFingerprint(samples, size)) {
+		edgeCacheBuild(c, samples, size, threshold, isLow);
+		if (!c->valid)
+			return false;
+	}
+	// binary search for the first crossing >= *i
+	size_t lo = 0, hi = c->count;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (c->idx[mid] < *i)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == c->count) {
+		*i = size;
+		return true;
+	}
+	size_t found = c->idx[lo];
+	// paranoia: the fingerprint is sampled, so verify the hit before trusting it
+	if (isLow ? (samples[found] > threshold) : (samples[found] < threshold)) {
+		c->valid = false;
+		return false;
+	}
+	*i = found;
+	return true;
+}
+#endif // ON_DEVICE
+
 uint8_t justNoise(uint8_t *BitStream, size_t size) {
 	//test samples are not just noise
+#ifndef ON_DEVICE
+	int high, low;
+	lf_minmax_core(BitStream, size, &high, &low);
+	return high < FSK_PSK_THRESHOLD;
+#else
 	uint8_t justNoise1 = 1;
 	for(size_t idx=0; idx < size && justNoise1 ;idx++){
 		justNoise1 = BitStream[idx] < FSK_PSK_THRESHOLD;
 	}
 	return justNoise1;
+#endif
 }
 
 //by marshmellow
 //get high and low values of a wave with passed in fuzz factor. also return noise test = 1 for passed or 0 for only noise
 int getHiLo(uint8_t *BitStream, size_t size, int *high, int *low, uint8_t fuzzHi, uint8_t fuzzLo) {
+#ifndef ON_DEVICE
+	uint32_t fp = demodFingerprint(BitStream, size);
+	if (hiLoCache.valid && hiLoCache.fp == fp && hiLoCache.size == size &&
+	    hiLoCache.fuzzHi == fuzzHi && hiLoCache.fuzzLo == fuzzLo) {
+		*high = hiLoCache.high;
+		*low = hiLoCache.low;
+		return hiLoCache.ret;
+	}
+#endif
+	// get high and low thresholds
+#ifndef ON_DEVICE
+	lf_minmax_core(BitStream, size, high, low);
+#else
 	*high=0;
 	*low=255;
-	// get high and low thresholds 
 	for (size_t i=0; i < size; i++){
 		if (BitStream[i] > *high) *high = BitStream[i];
 		if (BitStream[i] < *low) *low = BitStream[i];
 	}
-	if (*high < FSK_PSK_THRESHOLD) return -1; // just noise
-	*high = ((*high-128)*fuzzHi + 12800)/100;
-	*low = ((*low-128)*fuzzLo + 12800)/100;
-	return 1;
+#endif
+	int ret = 1;
+	if (*high < FSK_PSK_THRESHOLD) {
+		ret = -1; // just noise
+	} else {
+		*high = ((*high-128)*fuzzHi + 12800)/100;
+		*low = ((*low-128)*fuzzLo + 12800)/100;
+	}
+#ifndef ON_DEVICE
+	hiLoCache.fp = fp;
+	hiLoCache.size = size;
+	hiLoCache.fuzzHi = fuzzHi;
+	hiLoCache.fuzzLo = fuzzLo;
+	hiLoCache.high = *high;
+	hiLoCache.low = *low;
+	hiLoCache.ret = ret;
+	hiLoCache.valid = true;
+#endif
+	return ret;
 }
 
 // by marshmellow
@@ -164,12 +302,7 @@ uint32_t bytebits_to_byteLSBF(uint8_t *src, size_t numbits) {
 	return num;
 }
 
-// search for given preamble in given BitStream and return success=1 or fail=0 and startIndex (where it was found) and length if not fineone 
-// fineone does not look for a repeating preamble for em4x05/4x69 sends preamble once, so look for it once in the first pLen bits
-bool preambleSearchEx(uint8_t *BitStream, uint8_t *preamble, size_t pLen, size_t *size, size_t *startIdx, bool findone) {
-	// Sanity check.  If preamble length is bigger than bitstream length.
-	if ( *size <= pLen ) return false;
-
+static bool preambleSearchScalar(uint8_t *BitStream, uint8_t *preamble, size_t pLen, size_t *size, size_t *startIdx, bool findone) {
 	uint8_t foundCnt = 0;
 	for (size_t idx = 0; idx < *size - pLen; idx++) {
 		if (memcmp(BitStream+idx, preamble, pLen) == 0) {
@@ -188,6 +321,78 @@ bool preambleSearchEx(uint8_t *BitStream, uint8_t *preamble, size_t pLen, size_t
 	return false;
 }
 
+#ifndef ON_DEVICE
+// Bit-packed preamble scan (client side only). The byte-per-bit stream is
+// packed 64 bits per word once, then every window is a couple of shifts and
+// an XOR against the packed pattern instead of a byte-wise memcmp - the long
+// Indala/Cotag preambles benefit the most. Some demodulators leave error
+// marker bytes (e.g. 7) in the stream; those are packed as neither-0-nor-1
+// via a second validity plane so they mismatch just like in the byte compare.
+static bool preambleSearchPacked(uint8_t *BitStream, uint8_t *preamble, size_t pLen, size_t *size, size_t *startIdx, bool findone) {
+	size_t n = *size;
+	size_t words = n/64 + 2;	// +1 pad word so window extraction never reads past the end
+	uint64_t *ones = calloc(words * 2, sizeof(uint64_t));
+	if (!ones)
+		return preambleSearchScalar(BitStream, preamble, pLen, size, startIdx, findone);
+	uint64_t *valid = ones + words;
+
+	for (size_t i = 0; i < n; i++) {
+		uint64_t bit = 1ULL << (63 - (i & 63));
+		if (BitStream[i] == 1) {
+			ones[i >> 6] |= bit;
+			valid[i >> 6] |= bit;
+		} else if (BitStream[i] == 0) {
+			valid[i >> 6] |= bit;
+		}
+	}
+
+	// pattern and mask live in the high pLen bits
+	uint64_t pat = 0;
+	for (size_t i = 0; i < pLen; i++)
+		pat |= (uint64_t)(preamble[i] & 1) << (63 - i);
+	uint64_t mask = (pLen == 64) ? ~0ULL : (~0ULL << (64 - pLen));
+
+	uint8_t foundCnt = 0;
+	for (size_t idx = 0; idx < n - pLen; idx++) {
+		size_t q = idx >> 6;
+		size_t r = idx & 63;
+		uint64_t w_ones = ones[q];
+		uint64_t w_valid = valid[q];
+		if (r) {
+			w_ones = (w_ones << r) | (ones[q+1] >> (64 - r));
+			w_valid = (w_valid << r) | (valid[q+1] >> (64 - r));
+		}
+		if (((w_ones ^ pat) & mask) == 0 && (w_valid & mask) == mask) {
+			foundCnt++;
+			if (foundCnt == 1) {
+				if (g_debugMode) prnt("DEBUG: preamble found at %u", idx);
+				*startIdx = idx;
+				if (findone) break;
+			} else if (foundCnt == 2) {
+				*size = idx - *startIdx;
+				break;
+			}
+		}
+	}
+	free(ones);
+	if (findone) return foundCnt >= 1;
+	return foundCnt >= 2;
+}
+#endif
+
+// search for given preamble in given BitStream and return success=1 or fail=0 and startIndex (where it was found) and length if not fineone
+// fineone does not look for a repeating preamble for em4x05/4x69 sends preamble once, so look for it once in the first pLen bits
+bool preambleSearchEx(uint8_t *BitStream, uint8_t *preamble, size_t pLen, size_t *size, size_t *startIdx, bool findone) {
+	// Sanity check.  If preamble length is bigger than bitstream length.
+	if ( *size <= pLen ) return false;
+
+#ifndef ON_DEVICE
+	if (pLen <= 64)
+		return preambleSearchPacked(BitStream, preamble, pLen, size, startIdx, findone);
+#endif
+	return preambleSearchScalar(BitStream, preamble, pLen, size, startIdx, findone);
+}
+
 //by marshmellow
 //search for given preamble in given BitStream and return success=1 or fail=0 and startIndex and length
 uint8_t preambleSearch(uint8_t *BitStream, uint8_t *preamble, size_t pLen, size_t *size, size_t *startIdx) {
@@ -231,11 +436,19 @@ int getClosestClock(int testclk) {
 }
 
 void getNextLow(uint8_t samples[], size_t size, int low, size_t *i) {
+#ifndef ON_DEVICE
+	if (edgeCacheSeek(&lowEdgeCache, samples, size, low, i, true))
+		return;
+#endif
 	while ((samples[*i] > low) && (*i < size))
 		*i+=1;
 }
 
 void getNextHigh(uint8_t samples[], size_t size, int high, size_t *i) {
+#ifndef ON_DEVICE
+	if (edgeCacheSeek(&highEdgeCache, samples, size, high, i, false))
+		return;
+#endif
 	while ((samples[*i] < high) && (*i < size))
 		*i+=1;
 }
@@ -308,6 +521,9 @@ size_t pskFindFirstPhaseShift(uint8_t samples[], size_t size, uint8_t *curPhase,
 //by marshmellow
 //amplify based on ask edge detection  -  not accurate enough to use all the time
 void askAmp(uint8_t *BitStream, size_t size) {
+#ifndef ON_DEVICE
+	lf_askamp_core(BitStream, size);
+#else
 	uint8_t Last = 128;
 	for(size_t i = 1; i<size; i++){
 		if (BitStream[i]-BitStream[i-1]>=30) //large jump up
@@ -317,6 +533,7 @@ void askAmp(uint8_t *BitStream, size_t size) {
 
 		BitStream[i-1] = Last;
 	}
+#endif
 	return;
 }
 
@@ -443,6 +660,24 @@ int DetectASKClock(uint8_t dest[], size_t size, int *clock, int maxErr) {
 	size_t errCnt = 0;
 	size_t arrLoc, loopEnd;
 
+#ifndef ON_DEVICE
+	// One vectorized pass (lfprep_core.c) classifies every sample as peak
+	// or not, with the ±1 tolerance neighbourhood folded into a second
+	// array. The clock/offset scoring below then reads only these
+	// predicates, so the sample buffer is walked once instead of once per
+	// clock and offset. Results are bit-exact with the inline comparisons,
+	// which remain as the device (and allocation-failure) path.
+	uint8_t *isPeak = malloc(size + 2);
+	uint8_t *isPeakTol = malloc(size + 2);
+	if (isPeak == NULL || isPeakTol == NULL) {
+		free(isPeak);
+		free(isPeakTol);
+		isPeak = isPeakTol = NULL;
+	} else {
+		lf_peakclass_core(dest, size + 2, peak, low, isPeak, isPeakTol);
+	}
+#endif
+
 	if (clockFnd>0) {
 		clkCnt = clockFnd;
 		clkEnd = clockFnd+1;
@@ -459,6 +694,9 @@ int DetectASKClock(uint8_t dest[], size_t size, int *clock, int maxErr) {
 		//if no errors allowed - keep start within the first clock
 		if (!maxErr && size > clk[clkCnt]*2 + tol && clk[clkCnt]<128) loopCnt=clk[clkCnt]*2;
 		bestErr[clkCnt]=1000;
+#ifndef ON_DEVICE
+		const uint8_t *pk = (isPeak != NULL) ? (tol ? isPeakTol : isPeak) : NULL;
+#endif
 		//try lining up the peaks by moving starting point (try first few clocks)
 		for (ii=0; ii < loopCnt; ii++){
 			if (dest[ii] < peak && dest[ii] > low) continue;
@@ -466,20 +704,34 @@ int DetectASKClock(uint8_t dest[], size_t size, int *clock, int maxErr) {
 			errCnt=0;
 			// now that we have the first one lined up test rest of wave array
 			loopEnd = ((size-ii-tol) / clk[clkCnt]) - 1;
+#ifndef ON_DEVICE
+			if (pk != NULL) {
+				for (i=0; i < loopEnd; ++i){
+					if (!pk[ii + (i * clk[clkCnt])]) {
+						//no point finishing: this offset can no longer beat the best
+						if (++errCnt > bestErr[clkCnt]) break;
+					}
+				}
+			} else
+#endif
 			for (i=0; i < loopEnd; ++i){
 				arrLoc = ii + (i * clk[clkCnt]);
 				if (dest[arrLoc] >= peak || dest[arrLoc] <= low){
 				}else if (dest[arrLoc-tol] >= peak || dest[arrLoc-tol] <= low){
 				}else if (dest[arrLoc+tol] >= peak || dest[arrLoc+tol] <= low){
 				}else{  //error no peak detected
-					errCnt++;
+					if (++errCnt > bestErr[clkCnt]) break;
 				}
 			}
 			//if we found no errors then we can stop here and a low clock (common clocks)
 			//  this is correct one - return this clock
 			if (g_debugMode == 2) prnt("DEBUG ASK: clk %d, err %d, startpos %d, endpos %d",clk[clkCnt],errCnt,ii,i);
-			if(errCnt==0 && clkCnt<7) { 
+			if(errCnt==0 && clkCnt<7) {
 				if (!clockFnd) *clock = clk[clkCnt];
+#ifndef ON_DEVICE
+				free(isPeak);
+				free(isPeakTol);
+#endif
 				return ii;
 			}
 			//if we found errors see if it is lowest so far and save it as best run
@@ -489,6 +741,10 @@ int DetectASKClock(uint8_t dest[], size_t size, int *clock, int maxErr) {
 			}
 		}
 	}
+#ifndef ON_DEVICE
+	free(isPeak);
+	free(isPeakTol);
+#endif
 	uint8_t iii;
 	uint8_t best=0;
 	for (iii=1; iii<clkEnd; ++iii){
@@ -772,7 +1028,7 @@ int DetectPSKClock(uint8_t dest[], size_t size, int clock, size_t *firstPhaseShi
 	size_t waveStart=0, waveEnd=0, firstFullWave=0, lastClkBit=0;
 
 	uint8_t clkCnt, tol=1;
-	uint16_t peakcnt=0, errCnt=0, waveLenCnt=0, fullWaveLen=0;
+	uint16_t waveLenCnt=0, fullWaveLen=0;
 	uint16_t bestErr[]={1000,1000,1000,1000,1000,1000,1000,1000,1000};
 	uint16_t peaksdet[]={0,0,0,0,0,0,0,0,0};
 
@@ -789,49 +1045,53 @@ int DetectPSKClock(uint8_t dest[], size_t size, int clock, size_t *firstPhaseShi
 
 	*firstPhaseShift = firstFullWave;
 	if (g_debugMode ==2) prnt("DEBUG PSK: firstFullWave: %d, waveLen: %d",firstFullWave,fullWaveLen);
-	//test each valid clock from greatest to smallest to see which lines up
-	for(clkCnt=7; clkCnt >= 1 ; clkCnt--) {
-		tol = *fc/2;
-		lastClkBit = firstFullWave; //set end of wave as clock align
-		waveStart = 0;
-		errCnt=0;
-		peakcnt=0;
-		if (g_debugMode == 2) prnt("DEBUG PSK: clk: %d, lastClkBit: %d",clk[clkCnt],lastClkBit);
-
-		for (i = firstFullWave+fullWaveLen-1; i < loopCnt-2; i++){
-			//top edge of wave = start of new wave 
-			if (dest[i] < dest[i+1] && dest[i+1] >= dest[i+2]){
-				if (waveStart == 0) {
-					waveStart = i+1;
-					waveLenCnt=0;
-				} else { //waveEnd
-					waveEnd = i+1;
-					waveLenCnt = waveEnd-waveStart;
-					if (waveLenCnt > *fc){ 
+	//test all valid clocks in a single pass over the samples: the wave top
+	//positions and wave lengths don't depend on the clock candidate, so the
+	//scan is shared and only the small per-clock bookkeeping runs per top
+	size_t lastClkBits[9];
+	tol = *fc/2;
+	for (clkCnt = 1; clkCnt <= 7; clkCnt++) {
+		lastClkBits[clkCnt] = firstFullWave; //set end of wave as clock align
+		bestErr[clkCnt] = 0;
+	}
+
+	for (i = firstFullWave+fullWaveLen-1; i < loopCnt-2; i++){
+		//top edge of wave = start of new wave
+		if (dest[i] < dest[i+1] && dest[i+1] >= dest[i+2]){
+			if (waveStart == 0) {
+				waveStart = i+1;
+				waveLenCnt=0;
+			} else { //waveEnd
+				waveEnd = i+1;
+				waveLenCnt = waveEnd-waveStart;
+				for (clkCnt=7; clkCnt >= 1 ; clkCnt--) {
+					lastClkBit = lastClkBits[clkCnt];
+					if (waveLenCnt > *fc){
 						//if this wave is a phase shift
-						if (g_debugMode == 2) prnt("DEBUG PSK: phase shift at: %d, len: %d, nextClk: %d, i: %d, fc: %d",waveStart,waveLenCnt,lastClkBit+clk[clkCnt]-tol,i+1,*fc);
 						if (i+1 >= lastClkBit + clk[clkCnt] - tol){ //should be a clock bit
-							peakcnt++;
-							lastClkBit+=clk[clkCnt];
+							peaksdet[clkCnt]++;
+							lastClkBits[clkCnt] = lastClkBit + clk[clkCnt];
 						} else if (i<lastClkBit+8){
 							//noise after a phase shift - ignore
 						} else { //phase shift before supposed to based on clock
-							errCnt++;
+							bestErr[clkCnt]++;
 						}
 					} else if (i+1 > lastClkBit + clk[clkCnt] + tol + *fc){
-						lastClkBit+=clk[clkCnt]; //no phase shift but clock bit
+						lastClkBits[clkCnt] = lastClkBit + clk[clkCnt]; //no phase shift but clock bit
 					}
-					waveStart=i+1;
 				}
+				waveStart=i+1;
 			}
 		}
-		if (errCnt == 0){
+	}
+	//an errorfree clock lines up - take the largest one
+	for (clkCnt=7; clkCnt >= 1 ; clkCnt--) {
+		if (g_debugMode == 2) prnt("DEBUG PSK: clk: %d, peaks: %d, errs: %d",clk[clkCnt],peaksdet[clkCnt],bestErr[clkCnt]);
+		if (bestErr[clkCnt] == 0){
 			return clk[clkCnt];
 		}
-		if (errCnt <= bestErr[clkCnt]) bestErr[clkCnt]=errCnt;
-		if (peakcnt > peaksdet[clkCnt]) peaksdet[clkCnt]=peakcnt;
-	} 
-	//all tested with errors 
+	}
+	//all tested with errors
 	//return the highest clk with the most peaks found
 	uint8_t best=7;
 	for (i=7; i>=1; i--){
@@ -857,6 +1117,45 @@ uint8_t detectFSKClk(uint8_t *BitStream, size_t size, uint8_t fcHigh, uint8_t fc
 	size_t i;
 	if (size == 0) return 0;
 
+#ifndef ON_DEVICE
+	// matched-filter front end (see fsk_wave_demod): measure the distance
+	// between frequency switches directly from the winning-template marks
+	// instead of hunting for per-sample peaks
+	uint8_t *marks = (size > 200) ? malloc(size) : NULL;
+	if (marks != NULL && !fsk_correlate_core(BitStream, size, fcHigh, fcLow, marks)) {
+		free(marks);
+		marks = NULL;
+	}
+	if (marks != NULL) {
+		size_t last_switch = 160;
+		for (i = 161; i < size-20; i++) {
+			if (marks[i] == marks[i-1])
+				continue;
+			rfCounter = i - last_switch;
+			last_switch = i;
+			if (firstBitFnd <= 1) { //skip first wave change - probably not a complete bit
+				*firstClockEdge = i;
+				firstBitFnd++;
+				continue;
+			}
+			for (int ii=0; ii<15; ii++){
+				if (rfLens[ii] >= (rfCounter-4) && rfLens[ii] <= (rfCounter+4)){
+					rfCnts[ii]++;
+					rfCounter = 0;
+					break;
+				}
+			}
+			if (rfCounter > 0 && rfLensFnd < 15){
+				rfCnts[rfLensFnd]++;
+				rfLens[rfLensFnd++] = rfCounter;
+			}
+		}
+		free(marks);
+	} else
+#endif
+	{
+	// scratch buffer allocation failed (or running on device):
+	// sample-by-sample peak counting
 	uint8_t fcTol = ((fcHigh*100 - fcLow*100)/2 + 50)/100; //(uint8_t)(0.5+(float)(fcHigh-fcLow)/2);
 	rfLensFnd=0;
 	fcCounter=0;
@@ -872,14 +1171,14 @@ uint8_t detectFSKClk(uint8_t *BitStream, size_t size, uint8_t fcHigh, uint8_t fc
 		fcCounter++;
 		rfCounter++;
 
-		if (BitStream[i] <= BitStream[i-1] || BitStream[i] < BitStream[i+1]) 
-			continue;		
-		// else new peak 
+		if (BitStream[i] <= BitStream[i-1] || BitStream[i] < BitStream[i+1])
+			continue;
+		// else new peak
 		// if we got less than the small fc + tolerance then set it to the small fc
 		// if it is inbetween set it to the last counter
 		if (fcCounter < fcHigh && fcCounter > fcLow)
 			fcCounter = lastFCcnt;
-		else if (fcCounter < fcLow+fcTol) 
+		else if (fcCounter < fcLow+fcTol)
 			fcCounter = fcLow;
 		else //set it to the large fc
 			fcCounter = fcHigh;
@@ -909,6 +1208,7 @@ uint8_t detectFSKClk(uint8_t *BitStream, size_t size, uint8_t fcHigh, uint8_t fc
 		}
 		fcCounter=0;
 	}
+	}
 	uint8_t rfHighest=15, rfHighest2=15, rfHighest3=15;
 
 	for (i=0; i<15; i++){
@@ -1140,6 +1440,59 @@ int millerRawDecode(uint8_t *BitStream, size_t *size, int invert) {
 //take 01 or 10 = 1 and 11 or 00 = 0
 //check for phase errors - should never have 111 or 000 should be 01001011 or 10110100 for 1010
 //decodes biphase or if inverted it is AKA conditional dephase encoding AKA differential manchester encoding
+// --- bit-parallel helpers for the wide Manchester/biphase decode paths ---
+// The symbol streams these decoders consume hold one value per byte (0, 1,
+// or 7 for an upstream error), so eight symbols fit in one uint64_t and the
+// pair comparisons collapse into XOR/AND reductions. The equality trick
+// assumes byte values <= 0x7f; the wide loops test each block for that (and
+// for anything else they cannot classify) and fall back to the scalar code,
+// which stays the single source of truth for the edge cases.
+
+#define LF_SWAR_LO01 0x0101010101010101ULL
+#define LF_SWAR_HI80 0x8080808080808080ULL
+#define LF_SWAR_PAIR 0x0001000100010001ULL
+
+static uint64_t swar_load8(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+// high bit set in every byte lane of x that equals val (lanes must be <= 0x7f)
+static uint64_t swar_eq_byte(uint64_t x, uint8_t val)
+{
+	uint64_t z = x ^ (LF_SWAR_LO01 * val);
+	return ~(z + 0x7f7f7f7f7f7f7f7fULL) & LF_SWAR_HI80;
+}
+
+static uint32_t swar_popcount(uint64_t v)
+{
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (uint32_t)((v * LF_SWAR_LO01) >> 56);
+}
+
+// gather the low byte of each 16-bit lane into one packed 32-bit value
+static uint32_t swar_pack_lanes(uint64_t v)
+{
+	return (uint32_t)((v & 0xff) | ((v >> 8) & 0xff00) |
+			((v >> 16) & 0xff0000) | ((v >> 24) & 0xff000000));
+}
+
+// classify the four Manchester pairs held in one little-endian word:
+// (1,0) -> invert, (0,1) -> invert^1, anything else -> 7
+static uint32_t swar_man_decode4(uint64_t x, uint8_t invert)
+{
+	uint64_t m1 = swar_eq_byte(x, 1);
+	uint64_t m0 = swar_eq_byte(x, 0);
+	uint64_t t10 = ((m1 >> 7) & (m0 >> 15)) & LF_SWAR_PAIR;
+	uint64_t t01 = ((m0 >> 7) & (m1 >> 15)) & LF_SWAR_PAIR;
+	uint64_t out = (LF_SWAR_PAIR * 7) ^ (t10 * (7 ^ invert)) ^ (t01 * (7 ^ (invert ^ 1)));
+	return swar_pack_lanes(out);
+}
+
 int BiphaseRawDecode(uint8_t *BitStream, size_t *size, int *offset, int invert) {
 	uint16_t bitnum = 0;
 	uint16_t errCnt = 0;
@@ -1154,7 +1507,31 @@ int BiphaseRawDecode(uint8_t *BitStream, size_t *size, int *offset, int invert)
 		if (BitStream[i+2]==BitStream[i+3]) offsetB=0;					
 	}
 	if (!offsetA && offsetB) *offset+=1;
-	for (i=*offset; i<*size-3; i+=2){
+	//wide path - eight pairs per iteration while the block is clean 0/1
+	//data with no phase faults; anything else drops to the scalar loop
+	//below, which keeps the error accounting
+	i = *offset;
+	while (i + 18 <= *size && bitnum + 8 <= MaxBits) {
+		uint64_t x0 = swar_load8(BitStream + i);
+		uint64_t x1 = swar_load8(BitStream + i + 8);
+		if ((x0 | x1) & ~LF_SWAR_LO01)
+			break;
+		//phase fault = BitStream[p+1]==BitStream[p+2] for a pair at p;
+		//u0/u1 hold bytes i+1.. so those are their adjacent lane pairs
+		uint64_t u0 = swar_load8(BitStream + i + 1);
+		uint64_t u1 = swar_load8(BitStream + i + 9);
+		if (((u0 ^ (u0 >> 8)) & LF_SWAR_PAIR) != LF_SWAR_PAIR ||
+		    ((u1 ^ (u1 >> 8)) & LF_SWAR_PAIR) != LF_SWAR_PAIR)
+			break;
+		//pairs that differ decode to 1^invert, equal pairs to invert
+		uint64_t inv = (uint64_t)(invert & 1) * LF_SWAR_PAIR;
+		uint64_t out8 = (uint64_t)swar_pack_lanes(((x0 ^ (x0 >> 8)) & LF_SWAR_PAIR) ^ inv) |
+				((uint64_t)swar_pack_lanes(((x1 ^ (x1 >> 8)) & LF_SWAR_PAIR) ^ inv) << 32);
+		memcpy(BitStream + bitnum, &out8, 8);
+		bitnum += 8;
+		i += 16;
+	}
+	for (; i<*size-3; i+=2){
 		//check for phase error
 		if (BitStream[i+1]==BitStream[i+2]) {
 			BitStream[bitnum++]=7;
@@ -1183,20 +1560,49 @@ int manrawdecode(uint8_t * BitStream, size_t *size, uint8_t invert, uint8_t *ali
 	uint16_t bestErr = 1000, bestRun = 0;
 	if (*size < 16) return -1;
 	//find correct start position [alignment]
+	//one bit-parallel pass counts the adjacent-equal pairs for both phases
+	//at once, eight positions per step
+	uint16_t phaseErr[2] = {0, 0};
+	size_t n = *size - 3;
+	i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t x = swar_load8(BitStream + i);
+		uint64_t y = swar_load8(BitStream + i + 1);
+		if ((x | y) & LF_SWAR_HI80)
+			break;	//unexpected symbol - let the scalar tail count it
+		uint64_t eq = swar_eq_byte(x ^ y, 0);
+		uint32_t evenCnt = swar_popcount(eq & (LF_SWAR_PAIR << 7));
+		phaseErr[0] += evenCnt;
+		phaseErr[1] += swar_popcount(eq) - evenCnt;
+	}
+	for (; i < n; i++)
+		if (BitStream[i]==BitStream[i+1])
+			phaseErr[i & 1]++;
 	for (ii=0;ii<2;++ii){
-		for (i=ii; i<*size-3; i+=2)
-			if (BitStream[i]==BitStream[i+1])
-				errCnt++;
-
+		errCnt = phaseErr[ii];
 		if (bestErr>errCnt){
 			bestErr=errCnt;
 			bestRun=ii;
 		}
-		errCnt=0;
 	}
 	*alignPos=bestRun;
 	//decode
-	for (i=bestRun; i < *size-3; i+=2){
+	//wide path - eight pairs per iteration, classified in-register; the
+	//scalar loop below finishes the tail and keeps the historic
+	//one-past-MaxBits cutoff
+	i = bestRun;
+	while (i + 18 <= *size && bitnum + 8 <= MaxBits) {
+		uint64_t x0 = swar_load8(BitStream + i);
+		uint64_t x1 = swar_load8(BitStream + i + 8);
+		if ((x0 | x1) & LF_SWAR_HI80)
+			break;
+		uint64_t out8 = (uint64_t)swar_man_decode4(x0, invert) |
+				((uint64_t)swar_man_decode4(x1, invert) << 32);
+		memcpy(BitStream + bitnum, &out8, 8);
+		bitnum += 8;
+		i += 16;
+	}
+	for (; i < *size-3; i+=2){
 		if(BitStream[i] == 1 && (BitStream[i+1] == 0)){
 			BitStream[bitnum++]=invert;
 		} else if((BitStream[i] == 0) && BitStream[i+1] == 1){
@@ -1303,6 +1709,8 @@ int askdemod_ext(uint8_t *BinStream, size_t *size, int *clk, int *invert, int ma
 	int lastBit;              //set first clock check - can go negative
 	size_t i, bitnum = 0;     //output counter
 	uint8_t midBit = 0;
+	uint8_t burst = 0;        //consecutive modulation errors - see re-sync below
+	uint16_t segment = 1;
 	uint8_t tol = 0;          //clock tolerance adjust - waves will be accepted as within the clock if they fall + or - this value + clock from last valid wave
 	if (*clk <= 32) tol = 1;  //clock tolerance may not be needed anymore currently set to + or - 1 but could be increased for poor waves or removed entirely
 	size_t MaxBits = 3072;    //max bits to collect
@@ -1312,14 +1720,71 @@ int askdemod_ext(uint8_t *BinStream, size_t *size, int *clk, int *invert, int ma
 		if (i-lastBit >= *clk-tol){
 			if (BinStream[i] >= high) {
 				BinStream[bitnum++] = *invert;
+				burst = 0;
 			} else if (BinStream[i] <= low) {
 				BinStream[bitnum++] = *invert ^ 1;
+				burst = 0;
 			} else if (i-lastBit >= *clk+tol) {
 				if (bitnum > 0) {
 					if (g_debugMode==2) prnt("DEBUG ASK: Modulation Error at: %u", i);
 					BinStream[bitnum++]=7;
-					errCnt++;						
-				} 
+					errCnt++;
+					// A burst of errors may mean the clock phase slipped, but
+					// it can just as well be a stretch of dead air or
+					// interference the free-running clock will ride out on its
+					// own. Peek at the next full wave in a small window: only
+					// if its edge disagrees with the extrapolated clock grid
+					// has the phase genuinely slipped, and only then re-acquire
+					// from that edge as a new segment. The gap is padded with
+					// 7s so bit counts and downstream offsets match what the
+					// free-running clock would have produced.
+					if (++burst >= ASK_RESYNC_BURST) {
+						burst = 0;
+						size_t winEnd = i + 16 * (size_t)*clk;
+						if (winEnd > *size) winEnd = *size;
+						// prime on a high-to-low edge like DetectStrongAskClock,
+						// deliberately not via getNextHigh/getNextLow: their edge
+						// cache is not safe on a buffer we rewrite in place
+						size_t j = i;
+						while (j < winEnd && BinStream[j] < high) j++;
+						while (j < winEnd && BinStream[j] > low) j++;
+						int phase = ((int)j - lastBit) % *clk;
+						// a slipped edge alone is not proof. Genuine desync
+						// means the wave died out: the burst region must be
+						// mid-level throughout, not just at the clock ticks -
+						// a wrong-clock or wrong-modulation signal also piles
+						// up tick errors, but stays saturated in between and
+						// the free-running clock must be left alone there.
+						// And the new grid must actually decode: hard high/low
+						// samples at the next few clock ticks.
+						bool relocked = (j < winEnd && phase > tol && phase < *clk - tol);
+						size_t gapStart = (i > (size_t)(ASK_RESYNC_BURST * *clk)) ? i - ASK_RESYNC_BURST * *clk : start;
+						for (size_t k = gapStart; relocked && k < i; k++) {
+							if (BinStream[k] >= high || BinStream[k] <= low)
+								relocked = false;
+						}
+						for (uint8_t k = 0; relocked && k < ASK_RESYNC_BURST; k++) {
+							size_t chk = j + k * (size_t)*clk;
+							if (chk >= *size || (BinStream[chk] < high && BinStream[chk] > low))
+								relocked = false;
+						}
+						if (relocked) {
+							segment++;
+							if (g_debugMode) prnt("DEBUG ASK: re-synced at %u (segment %u, %u bits so far)", j, segment, bitnum);
+							while (lastBit + 2 * *clk <= (int)j && bitnum < MaxBits) {
+								BinStream[bitnum++] = 7;
+								errCnt++;
+								lastBit += *clk;
+							}
+							lastBit = (int)j - *clk;
+							i = j - 1;
+							midBit = 0;
+							continue;
+						}
+						// edge is on the extrapolated grid (or none found) -
+						// keep free-running, the wave will line back up
+					}
+				}
 			} else { //in tolerance - looking for peak
 				continue;
 			}
@@ -1389,17 +1854,57 @@ int nrzRawDemod(uint8_t *dest, size_t *size, int *clk, int *invert, int *startId
 
 //translate wave to 11111100000 (1 for each short wave [higher freq] 0 for each long wave [lower freq])
 size_t fsk_wave_demod(uint8_t * dest, size_t size, uint8_t fchigh, uint8_t fclow, int *startIdx) {
-	size_t last_transition = 0;
-	size_t idx = 1;
 	if (fchigh==0) fchigh=10;
 	if (fclow==0) fclow=8;
+	if ( size < 1024 ) return 0; // not enough samples
+
+#ifndef ON_DEVICE
+	// matched-filter front end: fsk_correlate_core marks every sample with
+	// the field clock whose template correlates stronger, so runs of equal
+	// marks are whole waves. This replaces the per-sample threshold
+	// crossing hunt below, which is fragile on noisy captures.
+	uint8_t *marks = malloc(size);
+	if (marks != NULL && !fsk_correlate_core(dest, size, fchigh, fclow, marks)) {
+		free(marks);
+		marks = NULL;
+	}
+	if (marks != NULL) {
+		size_t numBits = 0;
+		size_t run_start = findModStart(dest, size, fchigh);
+		uint8_t curr = marks[run_start];
+		for (size_t i = run_start + 1; i <= size; i++) {
+			if (i < size && marks[i] == curr)
+				continue;
+			// round the run to a whole number of carrier waves; runt
+			// runs from noise round to zero waves and vanish
+			uint8_t fc = curr ? fclow : fchigh;
+			size_t waves = (i - run_start + fc / 2) / fc;
+			if (waves > 0) {
+				if (numBits == 0 && *startIdx == 0)
+					*startIdx = run_start;
+				memset(dest + numBits, curr, waves);
+				numBits += waves;
+			}
+			if (i < size) {
+				run_start = i;
+				curr = marks[i];
+			}
+		}
+		free(marks);
+		return numBits;
+	}
+	// scratch buffer allocation failed - fall through to the
+	// sample-by-sample demod
+#endif
+
+	size_t last_transition = 0;
+	size_t idx = 1;
 	//set the threshold close to 0 (graph) or 128 std to avoid static
 	size_t preLastSample = 0;
 	size_t LastSample = 0;
 	size_t currSample = 0;
-	if ( size < 1024 ) return 0; // not enough samples
 
-	//find start of modulating data in trace 
+	//find start of modulating data in trace
 	idx = findModStart(dest, size, fchigh);
 	// Need to threshold first sample
 	if(dest[idx] < FSK_PSK_THRESHOLD) dest[0] = 0;
@@ -1540,23 +2045,40 @@ void psk2TOpsk1(uint8_t *BitStream, size_t size) {
 	return;
 }
 
-//by marshmellow - demodulate PSK1 wave 
-//uses wave lengths (# Samples) 
-int pskRawDemod_ext(uint8_t dest[], size_t *size, int *clock, int *invert, int *startIdx) {
+// emit one demodulated bit, converting psk1 to psk2 on the fly when asked
+// (same mapping as psk1TOpsk2: first bit kept, then only transitions are 1s,
+// error markers pass through without affecting the transition tracking)
+static void pskPutBit(uint8_t *dest, size_t *numBits, uint8_t *prevBit, bool psk2, uint8_t bit) {
+	if (psk2 && bit != 7) {
+		if (*numBits == 0) {
+			*prevBit = bit;
+		} else if (bit != *prevBit) {
+			*prevBit = bit;
+			bit = 1;
+		} else {
+			bit = 0;
+		}
+	}
+	dest[(*numBits)++] = bit;
+}
+
+//by marshmellow - demodulate PSK1 wave
+//uses wave lengths (# Samples)
+static int pskRawDemodInt(uint8_t dest[], size_t *size, int *clock, int *invert, int *startIdx, bool psk2) {
 	if (*size < 170) return -1;
 
 	uint8_t curPhase = *invert;
-	uint8_t fc=0;
+	uint8_t fc=0, prevBit=0, prefixBit;
 	size_t i=0, numBits=0, waveStart=1, waveEnd=0, firstFullWave=0, lastClkBit=0;
 	uint16_t fullWaveLen=0, waveLenCnt=0, avgWaveVal;
 	uint16_t errCnt=0, errCnt2=0;
-	
+
 	*clock = DetectPSKClock(dest, *size, *clock, &firstFullWave, &curPhase, &fc);
 	if (*clock <= 0) return -1;
 	//if clock detect found firstfullwave...
 	uint16_t tol = fc/2;
 	if (firstFullWave == 0) {
-		//find start of modulating data in trace 
+		//find start of modulating data in trace
 		i = findModStart(dest, *size, fc);
 		//find first phase shift
 		firstFullWave = pskFindFirstPhaseShift(dest, *size, &curPhase, i, fc, &fullWaveLen);
@@ -1564,24 +2086,25 @@ int pskRawDemod_ext(uint8_t dest[], size_t *size, int *clock, int *invert, int *
 			// no phase shift detected - could be all 1's or 0's - doesn't matter where we start
 			// so skip a little to ensure we are past any Start Signal
 			firstFullWave = 160;
-			memset(dest, curPhase, firstFullWave / *clock);
+			prefixBit = curPhase;
 		} else {
-			memset(dest, curPhase^1, firstFullWave / *clock);
+			prefixBit = curPhase^1;
 		}
 	} else {
-		memset(dest, curPhase^1, firstFullWave / *clock);
+		prefixBit = curPhase^1;
 	}
 	//advance bits
-	numBits += (firstFullWave / *clock);
+	for (i = 0; i < firstFullWave / *clock; i++)
+		pskPutBit(dest, &numBits, &prevBit, psk2, prefixBit);
 	*startIdx = firstFullWave - (*clock * numBits)+2;
 	//set start of wave as clock align
 	lastClkBit = firstFullWave;
 	if (g_debugMode==2) prnt("DEBUG PSK: firstFullWave: %u, waveLen: %u, startIdx %i",firstFullWave,fullWaveLen, *startIdx);
 	if (g_debugMode==2) prnt("DEBUG PSK: clk: %d, lastClkBit: %u, fc: %u", *clock, lastClkBit,(unsigned int) fc);
 	waveStart = 0;
-	dest[numBits++] = curPhase; //set first read bit
+	pskPutBit(dest, &numBits, &prevBit, psk2, curPhase); //set first read bit
 	for (i = firstFullWave + fullWaveLen - 1; i < *size-3; i++) {
-		//top edge of wave = start of new wave 
+		//top edge of wave = start of new wave
 		if (dest[i]+fc < dest[i+1] && dest[i+1] >= dest[i+2]) {
 			if (waveStart == 0) {
 				waveStart = i+1;
@@ -1595,17 +2118,17 @@ int pskRawDemod_ext(uint8_t dest[], size_t *size, int *clock, int *invert, int *
 					//PrintAndLog("DEBUG: phase shift at: %d, len: %d, nextClk: %d, i: %d, fc: %d",waveStart,waveLenCnt,lastClkBit+*clock-tol,i+1,fc);
 					if (i+1 >= lastClkBit + *clock - tol) { //should be a clock bit
 						curPhase ^= 1;
-						dest[numBits++] = curPhase;
+						pskPutBit(dest, &numBits, &prevBit, psk2, curPhase);
 						lastClkBit += *clock;
 					} else if (i < lastClkBit+10+fc) {
 						//noise after a phase shift - ignore
 					} else { //phase shift before supposed to based on clock
 						errCnt++;
-						dest[numBits++] = 7;
+						pskPutBit(dest, &numBits, &prevBit, psk2, 7);
 					}
 				} else if (i+1 > lastClkBit + *clock + tol + fc) {
 					lastClkBit += *clock; //no phase shift but clock bit
-					dest[numBits++] = curPhase;
+					pskPutBit(dest, &numBits, &prevBit, psk2, curPhase);
 				} else if (waveLenCnt < fc - 1) { //wave is smaller than field clock (shouldn't happen often)
 					errCnt2++;
 					if(errCnt2 > 101) return errCnt2;
@@ -1622,9 +2145,19 @@ int pskRawDemod_ext(uint8_t dest[], size_t *size, int *clock, int *invert, int *
 	return errCnt;
 }
 
+int pskRawDemod_ext(uint8_t dest[], size_t *size, int *clock, int *invert, int *startIdx) {
+	return pskRawDemodInt(dest, size, clock, invert, startIdx, false);
+}
+
+//demodulate a psk1 wave and convert it to psk2 in the same output pass,
+//saving the extra psk1TOpsk2 walk over the bitstream
+int psk2RawDemod_ext(uint8_t dest[], size_t *size, int *clock, int *invert, int *startIdx) {
+	return pskRawDemodInt(dest, size, clock, invert, startIdx, true);
+}
+
 int pskRawDemod(uint8_t dest[], size_t *size, int *clock, int *invert) {
 	int startIdx = 0;
-	return pskRawDemod_ext(dest, size, clock, invert, &startIdx);
+	return pskRawDemodInt(dest, size, clock, invert, &startIdx, false);
 }
 
 //**********************************************************************************************
@@ -0,0 +1,180 @@
+/*
+ *  AES-NI support functions
+ *
+ *  Copyright (C) 2006-2015, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: GPL-2.0
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+
+/*
+ * [AES-WP] http://software.intel.com/en-us/articles/intel-advanced-encryption-standard-aes-instructions-set
+ *
+ * This implementation uses the compiler's AES intrinsics (per-function
+ * target attribute, so no global -maes is needed); which code path runs
+ * is decided at runtime with CPUID.
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_AESNI_C)
+
+#include "mbedtls/aesni.h"
+
+#include <string.h>
+
+#if defined(MBEDTLS_HAVE_X86_64)
+
+#include <wmmintrin.h>
+
+/*
+ * AES-NI support detection routine
+ */
+int mbedtls_aesni_has_support( unsigned int what )
+{
+    static int done = 0;
+    static unsigned int c = 0;
+
+    if( ! done )
+    {
+        asm( "movl  $1, %%eax   \n\t"
+             "cpuid             \n\t"
+             : "=c" (c)
+             :
+             : "eax", "ebx", "edx" );
+        done = 1;
+    }
+
+    return( ( c & what ) != 0 );
+}
+
+/*
+ * AES-NI AES-ECB block en(de)cryption
+ */
+__attribute__((target("aes")))
+int mbedtls_aesni_crypt_ecb( mbedtls_aes_context *ctx,
+                             int mode,
+                             const unsigned char input[16],
+                             unsigned char output[16] )
+{
+    const __m128i *rk = (const __m128i *) ctx->rk;
+    __m128i state = _mm_loadu_si128( (const __m128i *) input );
+    int i;
+
+    state = _mm_xor_si128( state, _mm_loadu_si128( rk++ ) );
+
+    if( mode == MBEDTLS_AES_ENCRYPT )
+    {
+        for( i = ctx->nr - 1; i > 0; i-- )
+            state = _mm_aesenc_si128( state, _mm_loadu_si128( rk++ ) );
+        state = _mm_aesenclast_si128( state, _mm_loadu_si128( rk ) );
+    }
+    else
+    {
+        for( i = ctx->nr - 1; i > 0; i-- )
+            state = _mm_aesdec_si128( state, _mm_loadu_si128( rk++ ) );
+        state = _mm_aesdeclast_si128( state, _mm_loadu_si128( rk ) );
+    }
+
+    _mm_storeu_si128( (__m128i *) output, state );
+
+    return( 0 );
+}
+
+/*
+ * Compute decryption round keys from encryption round keys
+ */
+__attribute__((target("aes")))
+void mbedtls_aesni_inverse_key( unsigned char *invkey,
+                                const unsigned char *fwdkey, int nr )
+{
+    __m128i *ik = (__m128i *) invkey;
+    const __m128i *fk = (const __m128i *) fwdkey + nr;
+
+    _mm_storeu_si128( ik++, _mm_loadu_si128( fk-- ) );
+
+    while( fk > (const __m128i *) fwdkey )
+        _mm_storeu_si128( ik++, _mm_aesimc_si128( _mm_loadu_si128( fk-- ) ) );
+
+    _mm_storeu_si128( ik, _mm_loadu_si128( fk ) );
+}
+
+/*
+ * SubWord and RotWord(SubWord) of one key schedule word, done with
+ * AESKEYGENASSIST (rcon is applied by the caller; the immediate is 0 here
+ * so a single helper covers every round and key size)
+ */
+__attribute__((target("aes")))
+static void aesni_subwords( uint32_t x, uint32_t *sub, uint32_t *subrot )
+{
+    __m128i t = _mm_aeskeygenassist_si128( _mm_set1_epi32( (int) x ), 0 );
+
+    *sub = (uint32_t) _mm_cvtsi128_si32( t );
+    *subrot = (uint32_t) _mm_cvtsi128_si32( _mm_srli_si128( t, 4 ) );
+}
+
+/*
+ * Key expansion, generic for 128, 192 and 256-bit keys ([AES-WP] unrolls
+ * per key size instead; the schedule is not performance critical)
+ */
+int mbedtls_aesni_setkey_enc( unsigned char *rk,
+                              const unsigned char *key,
+                              size_t bits )
+{
+    static const uint32_t rcon[] =
+        { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+    uint32_t *RK = (uint32_t *) rk;
+    size_t i, nk, nr;
+
+    switch( bits )
+    {
+        case 128: nk = 4; nr = 10; break;
+        case 192: nk = 6; nr = 12; break;
+        case 256: nk = 8; nr = 14; break;
+        default : return( MBEDTLS_ERR_AES_INVALID_KEY_LENGTH );
+    }
+
+    memcpy( RK, key, nk * 4 );
+
+    for( i = nk; i < 4 * ( nr + 1 ); i++ )
+    {
+        uint32_t sub, subrot, t = RK[i-1];
+
+        if( i % nk == 0 )
+        {
+            aesni_subwords( t, &sub, &subrot );
+            t = subrot ^ rcon[i / nk - 1];
+        }
+        else if( nk == 8 && i % nk == 4 )
+        {
+            aesni_subwords( t, &sub, &subrot );
+            t = sub;
+        }
+
+        RK[i] = RK[i-nk] ^ t;
+    }
+
+    return( 0 );
+}
+
+#endif /* MBEDTLS_HAVE_X86_64 */
+
+#endif /* MBEDTLS_AESNI_C */
@@ -19,19 +19,50 @@ extern const uint8_t OddByteParity[256];
 
 
 static inline bool oddparity8(const uint8_t x) {
+#if !defined __GNUC__
 	return OddByteParity[x];
+#else
+	return !__builtin_parity(x);	// branch-free and no table load
+#endif
+}
+
+static inline bool evenparity8(const uint8_t x) {
+#if !defined __GNUC__
+	return !OddByteParity[x];
+#else
+	return __builtin_parity(x);
+#endif
+}
+
+/* Batch variant: the odd parities of four bytes at once, branch-free.
+ * The result carries the parity of x[k] in bit 8*k.
+ */
+static inline uint32_t oddparity8x4(const uint8_t *x) {
+	uint32_t w = (uint32_t)x[0] | (uint32_t)x[1] << 8 | (uint32_t)x[2] << 16 | (uint32_t)x[3] << 24;
+	w ^= w >> 4;
+	w ^= w >> 2;
+	w ^= w >> 1;
+	return ~w & 0x01010101;
+}
+
+/* Gather the four parity bits of oddparity8x4() into bits 3..0, the parity
+ * of the first byte ending up in bit 3.
+ */
+static inline uint8_t paritybits8x4(uint32_t p) {
+	return (p * 0x08040201) >> 24 & 0x0f;
 }
 
 static inline void oddparitybuf(const uint8_t *x, size_t len, uint8_t *parity) {
 	memset(parity, 0x00, (len - 1) / 8 + 1);
-	for (int i = 0; i < len; i++) 
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {		// each group of 8 bytes fills one parity byte
+		parity[i / 8] = paritybits8x4(oddparity8x4(x + i)) << 4
+		              | paritybits8x4(oddparity8x4(x + i + 4));
+	}
+	for (; i < len; i++)
 		parity[i / 8] |= oddparity8(x[i]) << (7 - (i % 8));
 }
 
-static inline bool evenparity8(const uint8_t x) {
-	return !OddByteParity[x];
-}
-
 
 static inline bool evenparity32(uint32_t x) 
 {
@@ -0,0 +1,91 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// PackBits-style run-length codec for sample buffers.
+//
+// Encoding: a control byte c is followed by
+//   c in 0x00..0x7f : c+1 literal bytes
+//   c in 0x81..0xff : one byte, repeated 257-c times (runs of 2..128)
+//   c == 0x80       : no operation
+// LF captures spend most of their time near the idle level, so runs
+// dominate and typical captures shrink considerably.
+//-----------------------------------------------------------------------------
+
+#include "rle.h"
+
+size_t rle_encode(const uint8_t *in, size_t inlen, uint8_t *out, size_t outmax)
+{
+	size_t ipos = 0;
+	size_t opos = 0;
+
+	while (ipos < inlen) {
+		// measure the run starting here (cap at 128, the longest encodable)
+		size_t run = 1;
+		while (run < 128 && ipos + run < inlen && in[ipos + run] == in[ipos]) {
+			run++;
+		}
+
+		if (run >= 3) {
+			if (opos + 2 > outmax) return 0;
+			out[opos++] = (uint8_t)(257 - run);
+			out[opos++] = in[ipos];
+			ipos += run;
+		} else {
+			// collect literals until the next worthwhile run (or 128 bytes)
+			size_t lit_start = ipos;
+			size_t lit = 0;
+			while (lit < 128 && ipos < inlen) {
+				run = 1;
+				while (run < 128 && ipos + run < inlen && in[ipos + run] == in[ipos]) {
+					run++;
+				}
+				if (run >= 3) break;
+				ipos += run;
+				lit += run;
+			}
+			if (lit > 128) {
+				// the last short run may have pushed us past the cap
+				ipos -= lit - 128;
+				lit = 128;
+			}
+			if (opos + 1 + lit > outmax) return 0;
+			out[opos++] = (uint8_t)(lit - 1);
+			for (size_t i = 0; i < lit; i++) {
+				out[opos++] = in[lit_start + i];
+			}
+		}
+	}
+
+	return opos;
+}
+
+size_t rle_decode(const uint8_t *in, size_t inlen, uint8_t *out, size_t outmax)
+{
+	size_t ipos = 0;
+	size_t opos = 0;
+
+	while (ipos < inlen && opos < outmax) {
+		uint8_t control = in[ipos++];
+		if (control == 0x80) {
+			continue;
+		} else if (control & 0x80) {
+			// run: repeat the next byte 257-control times
+			if (ipos >= inlen) break;
+			size_t run = 257 - control;
+			uint8_t value = in[ipos++];
+			while (run-- && opos < outmax) {
+				out[opos++] = value;
+			}
+		} else {
+			// literals: copy control+1 bytes
+			size_t lit = control + 1;
+			while (lit-- && ipos < inlen && opos < outmax) {
+				out[opos++] = in[ipos++];
+			}
+		}
+	}
+
+	return opos;
+}
@@ -0,0 +1,28 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// PackBits-style run-length codec for sample buffers. Used to compress
+// ADC captures on the device before they cross USB; cheap enough for the
+// ARM side and with a bounded worst case (1 extra byte per 128 input bytes).
+//-----------------------------------------------------------------------------
+
+#ifndef RLE_H__
+#define RLE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Worst-case encoded size for inlen input bytes
+#define RLE_MAX_ENCODED(inlen) ((inlen) + ((inlen) + 127) / 128)
+
+// Encode inlen bytes from in into out (capacity outmax).
+// Returns the encoded length, or 0 if out is too small.
+size_t rle_encode(const uint8_t *in, size_t inlen, uint8_t *out, size_t outmax);
+
+// Decode inlen encoded bytes from in into out (capacity outmax).
+// Returns the decoded length; output is truncated at outmax.
+size_t rle_decode(const uint8_t *in, size_t inlen, uint8_t *out, size_t outmax);
+
+#endif
@@ -334,11 +334,18 @@ void usb_enable() {
 //* \fn    usb_check
 //* \brief Test if the device is configured and handle enumeration
 //*----------------------------------------------------------------------------
+#ifdef ON_DEVICE
+static void usb_tx_queue_reset(void);
+#endif
+
 bool usb_check() {
 	AT91_REG isr = pUdp->UDP_ISR;
 
 	if (isr & AT91C_UDP_ENDBUSRES) {
 		pUdp->UDP_ICR = AT91C_UDP_ENDBUSRES;
+#ifdef ON_DEVICE
+		usb_tx_queue_reset();	// endpoints are reset, drop queued TX data
+#endif
 		// reset all endpoints
 		pUdp->UDP_RSTEP  = (unsigned int)-1;
 		pUdp->UDP_RSTEP  = 0;
@@ -354,9 +361,112 @@ bool usb_check() {
 }
 
 
+#ifdef ON_DEVICE
+// Asynchronous IN endpoint queue (main firmware only - the bootloader keeps
+// the small fully synchronous path). Writers append to a ring buffer which
+// is drained opportunistically from usb_poll()/usb_read()/usb_write_flush(),
+// keeping both banks of the dual-bank IN endpoint filled (ping-pong) instead
+// of busy-waiting in the caller until the host has drained everything.
+#define USB_TX_RING_SIZE 1024	// must be a power of two
+
+static byte_t tx_ring[USB_TX_RING_SIZE];
+static volatile uint32_t tx_ring_head = 0;	// write position
+static volatile uint32_t tx_ring_tail = 0;	// read position
+static bool tx_bank_busy = false;			// TXPKTRDY set, a bank is transmitting
+static bool tx_bank_queued = false;			// the other bank is filled, waits for TXCOMP
+
+static uint32_t usb_tx_ring_level(void) {
+	return tx_ring_head - tx_ring_tail;
+}
+
+static void usb_tx_queue_reset(void) {
+	tx_ring_tail = tx_ring_head;
+	tx_bank_busy = false;
+	tx_bank_queued = false;
+}
+
+static void usb_fill_in_bank(void) {
+	uint32_t cpt = MIN(usb_tx_ring_level(), AT91C_EP_IN_SIZE);
+	while (cpt--) {
+		pUdp->UDP_FDR[AT91C_EP_IN] = tx_ring[tx_ring_tail++ & (USB_TX_RING_SIZE-1)];
+	}
+}
+
+//*----------------------------------------------------------------------------
+//* \fn    usb_write_pump
+//* \brief Make progress on the IN endpoint without blocking: complete a
+//*        transmitted bank and (re)fill free banks from the ring buffer
+//*----------------------------------------------------------------------------
+void usb_write_pump(void) {
+	if (tx_bank_busy && (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP)) {
+		UDP_CLEAR_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXCOMP);
+		while (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP);
+		if (tx_bank_queued) {
+			UDP_SET_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXPKTRDY);
+			tx_bank_queued = false;
+		} else {
+			tx_bank_busy = false;
+		}
+	}
+	if (!usb_tx_ring_level()) return;
+	if (!tx_bank_busy) {
+		usb_fill_in_bank();
+		UDP_SET_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXPKTRDY);
+		tx_bank_busy = true;
+	} else if (!tx_bank_queued) {
+		usb_fill_in_bank();
+		tx_bank_queued = true;
+	}
+}
+
+//*----------------------------------------------------------------------------
+//* \fn    usb_write_async
+//* \brief Queue data for the IN endpoint. Only blocks (pumping) when the
+//*        ring buffer is full, i.e. more than USB_TX_RING_SIZE bytes are
+//*        already in flight
+//*----------------------------------------------------------------------------
+uint32_t usb_write_async(const byte_t* data, const size_t len) {
+	size_t i = 0;
+
+	if (!len) return 0;
+	if (!usb_check()) return 0;
+
+	while (i < len) {
+		if (usb_tx_ring_level() < USB_TX_RING_SIZE) {
+			tx_ring[tx_ring_head++ & (USB_TX_RING_SIZE-1)] = data[i++];
+		} else {
+			usb_write_pump();
+			if (!usb_check()) return len - i;
+		}
+	}
+	usb_write_pump();
+	return 0;
+}
+
+//*----------------------------------------------------------------------------
+//* \fn    usb_write_flush
+//* \brief Wait until all queued data has been handed to the host
+//*----------------------------------------------------------------------------
+void usb_write_flush(void) {
+	while (usb_tx_ring_level() || tx_bank_busy || tx_bank_queued) {
+		if (!usb_check()) {	// disconnected: drop whatever is left
+			tx_ring_tail = tx_ring_head;
+			tx_bank_busy = false;
+			tx_bank_queued = false;
+			return;
+		}
+		usb_write_pump();
+	}
+}
+#endif // ON_DEVICE
+
+
 bool usb_poll()
 {
 	if (!usb_check()) return false;
+#ifdef ON_DEVICE
+	usb_write_pump();
+#endif
 	return (pUdp->UDP_CSR[AT91C_EP_OUT] & btReceiveBank);
 }
 
@@ -372,6 +482,9 @@ bool usb_poll()
 bool usb_poll_validate_length()
 {
 	if (!usb_check()) return false;
+#ifdef ON_DEVICE
+	usb_write_pump();
+#endif
 	if (!(pUdp->UDP_CSR[AT91C_EP_OUT] & btReceiveBank)) return false;
 	return (pUdp->UDP_CSR[AT91C_EP_OUT] >> 16) >  0;
 }
@@ -413,6 +526,13 @@ uint32_t usb_read(byte_t* data, size_t len) {
 //* \brief Send through endpoint 2
 //*----------------------------------------------------------------------------
 uint32_t usb_write(const byte_t* data, const size_t len) {
+#ifdef ON_DEVICE
+	// route through the async queue so queued and synchronous writes can't
+	// overtake each other, then wait until everything has been handed over
+	uint32_t left = usb_write_async(data, len);
+	usb_write_flush();
+	return left;
+#else
 	size_t length = len;
 	uint32_t cpt = 0;
 
@@ -452,6 +572,7 @@ uint32_t usb_write(const byte_t* data, const size_t len) {
 	while (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP);
 
 	return length;
+#endif // ON_DEVICE
 }
 
 
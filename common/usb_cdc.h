@@ -45,5 +45,10 @@ bool usb_poll_validate_length();
 uint32_t usb_read(byte_t* data, size_t len);
 uint32_t usb_write(const byte_t* data, const size_t len);
 
+// asynchronous TX queue, main firmware (ON_DEVICE) only
+uint32_t usb_write_async(const byte_t* data, const size_t len);
+void usb_write_pump(void);
+void usb_write_flush(void);
+
 #endif // _USB_CDC_H_
 
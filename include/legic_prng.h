@@ -14,6 +14,7 @@ extern void legic_prng_init(uint8_t init);
 extern void legic_prng_forward(int count);
 extern int  legic_prng_count();
 extern uint8_t legic_prng_get_bit();
+extern uint32_t legic_prng_get_bits(uint8_t count);
 
 #endif
 
@@ -43,7 +43,8 @@ typedef enum ISO14A_COMMAND {
 	ISO14A_TOPAZMODE =			(1 << 8),
 	ISO14A_NO_RATS =			(1 << 9),
 	ISO14A_SEND_CHAINING =      (1 << 10),
-	ISO14A_CLEAR_TRACE =		(1 << 11)
+	ISO14A_CLEAR_TRACE =		(1 << 11),
+	ISO14A_APDU_FULL =			(1 << 12)
 } iso14a_command_t;
 
 typedef struct {
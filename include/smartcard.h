@@ -25,7 +25,8 @@ typedef enum SMARTCARD_COMMAND {
 	SC_NO_DISCONNECT = (1 << 1),
 	SC_RAW =           (1 << 2),
 	SC_SELECT =        (1 << 3),
- 	SC_RAW_T0 =	       (1 << 4)
+ 	SC_RAW_T0 =	       (1 << 4),
+	SC_T0_GETRESP =    (1 << 5)   // let the device drive 61xx/6Cxx procedure bytes
 } smartcard_command_t;
 
 
@@ -34,6 +34,23 @@ typedef struct {
   } d;
 } PACKED UsbCommand;
 
+// Variable-length framing (device -> client), negotiated via CMD_FRAME_NEGOTIATE.
+// A frame is a UsbFrameNGHeader followed by datalen payload bytes. The header
+// starts with a magic dword which can never appear at the start of a fixed-size
+// UsbCommand (there the first dword is the low half of cmd, always <= 0xFFFF),
+// so a client can distinguish both formats on the wire. Devices and clients
+// which don't know about CMD_FRAME_NEGOTIATE simply keep using fixed-size
+// UsbCommand frames.
+#define USB_CMD_DATA_SIZE_EXT 2048
+#define USB_FRAME_NG_MAGIC    0x62334d50  // "PM3b"
+
+typedef struct {
+  uint32_t magic;    // USB_FRAME_NG_MAGIC
+  uint16_t datalen;  // number of payload bytes following this header
+  uint16_t cmd;      // all CMD_* values fit in 16 bits
+  uint64_t arg[3];
+} PACKED UsbFrameNGHeader;
+
 // A struct used to send sample-configs over USB
 typedef struct{
 	uint8_t decimation;
@@ -50,6 +67,22 @@ typedef struct{
 #define CMD_FINISH_WRITE                                                  0x0003
 #define CMD_HARDWARE_RESET                                                0x0004
 #define CMD_START_FLASH                                                   0x0005
+#define CMD_FLASH_CRC                                                     0x0006
+/* Streamed compressed flash writes. The payload is a slice of an LZSS
+   stream covering one run of 0x200 byte blocks; the bootrom inflates it
+   incrementally and programs each block as it completes.
+   arg[0] = destination address (first frame of a run)
+   arg[1] = number of compressed bytes in this frame
+   arg[2] = WRITE_LZ_* flags
+   Stream format, tokens gated by control bytes (LSB first, 1 = literal):
+   literal = 1 byte; match = 2 bytes, offset = b0 | ((b1 & 0xF0) << 4)
+   (1..4095 back), length = (b1 & 0x0F) + LZSS_MIN_MATCH. */
+#define CMD_WRITE_LZ                                                      0x0007
+#define WRITE_LZ_FIRST                  (1<<0)	// reset decoder, take dest address
+#define WRITE_LZ_LAST                   (1<<1)	// flush, pad last block with 0xFF
+#define LZSS_WIN_SIZE                   4096
+#define LZSS_MIN_MATCH                  3
+#define LZSS_MAX_MATCH                  18
 #define CMD_NACK                                                          0x00fe
 #define CMD_ACK                                                           0x00ff
 
@@ -64,6 +97,118 @@ typedef struct{
 #define CMD_VERSION                                                       0x0107
 #define CMD_STATUS                                                        0x0108
 #define CMD_PING                                                          0x0109
+// Persistent key-value store in the last 16kB of on-chip flash (armsrc/flashstore.c)
+// WRITE: arg0 = id, arg1 = chunk offset, arg2 = total length << 16 | chunk length
+// READ:  arg0 = id, arg1 = offset; response arg1 = total length, data = chunk
+// INFO:  arg0 = op (0 status, 1 delete id in arg1, 2 save emulator memory,
+//        3 load emulator memory, 4 load mifare key cache from the store)
+#define CMD_FLASHSTORE_WRITE                                              0x010D
+#define CMD_FLASHSTORE_READ                                               0x010E
+#define CMD_FLASHSTORE_INFO                                               0x010F
+// well-known flashstore value ids
+#define FLASHSTORE_ID_MFKEYS            1	// mifare key dictionary, n*6 bytes
+#define FLASHSTORE_ID_EMIMAGE           2	// emulator memory image
+// Negotiate variable-length response frames: arg[0] = 1 enable / 0 disable.
+// Device ACKs with its maximum frame payload size in arg[0].
+#define CMD_FRAME_NEGOTIATE                                               0x010A
+
+// Background tag presence polling: arg[0] = poll period in ms, 0 disables.
+// The device reports transitions with unsolicited CMD_TAG_POLL_EVENT
+// messages: arg[0] = 1 arrival / 0 departure, arg[1] = timestamp in ms,
+// arg[2] = UID length, data = UID.
+#define CMD_TAG_POLL_CONFIG                                               0x010B
+#define CMD_TAG_POLL_EVENT                                                0x010C
+
+// Execute a short sequence of sub-commands back-to-back without returning to
+// the USB wait loop in between. arg[0] = number of sub-commands; the data
+// holds one packed record per sub-command:
+//   uint16_t cmd, uint16_t data_len, uint64_t arg[3], uint8_t data[data_len]
+// Each sub-command sends its usual responses; the batch is terminated by a
+// final CMD_ACK with arg[0] = number of sub-commands actually executed.
+#define CMD_EXEC_BATCH                                                    0x0110
+
+// Unsolicited progress report from long-running firmware loops, emitted at
+// a low rate by SendProgress() and rendered by the client's shared progress
+// printer: arg[0] = items done, arg[1] = items total (0 when unknown),
+// arg[2] = elapsed ms since SendProgressStart()
+#define CMD_PROGRESS_REPORT                                               0x0112
+
+// Per-block CRC32 of emulator memory (shared by the mifare, iClass and
+// ISO15693 emulators), so eload can sync only blocks that changed:
+// arg[0] = byte offset (16-aligned), arg[1] = number of 16-byte blocks.
+// Response: arg[0] = blocks hashed, data = 4 bytes CRC32 per block.
+#define CMD_EML_GET_HASHES                                                0x0111
+
+// Stand-alone operation sequencer (armsrc/standalone_seq.c). PROG uploads a
+// table of 8 byte ops (arg[0] = op count, arg[1] = repeat count); the
+// sequence runs untethered on a long button press and RESULT fetches the log
+// of [step][op][status][len][data] entries afterwards (resp arg[0] = log
+// bytes, arg[1] = completed runs)
+#define CMD_STANDALONE_PROG                                               0x0113
+#define CMD_STANDALONE_RESULT                                             0x0114
+#define SEQ_OP_READ_14A                 1	// arg32 = give-up timeout ms, 0 = wait
+#define SEQ_OP_CHK_KEYS                 2	// arg16 = sectors | key type << 8 (2 = both)
+#define SEQ_OP_SIM_14A                  3	// simulate last read card until button press
+#define SEQ_OP_DELAY                    4	// arg32 = delay ms
+#define SEQ_OP_LOG                      5	// arg32 = marker value for the log
+
+// Field-event journal (armsrc/eventjournal.c). Protocol code drops compact
+// timestamped records into a circular buffer instead of relying on whatever
+// Dbprintf output survives a failed session; the client downloads the whole
+// journal afterwards. Request arg[0] = 1 clears the journal after download.
+// The journal comes back as CMD_ACK frames of packed entries (arg[0] = first
+// entry index, arg[1] = entries in this frame, arg[2] = total), terminated
+// by a frame with arg[1] = 0.
+#define CMD_EVENT_JOURNAL                                                 0x0115
+typedef struct {
+	uint32_t ts;	// SSP carrier clock when the event was recorded
+	uint32_t arg;	// event specific, see below
+	uint16_t id;
+	uint16_t seq;	// monotonic sequence number, exposes journal wraps
+} PACKED event_journal_entry_t;
+#define EVT_FIELD_ON                    1	// arg = FPGA major mode
+#define EVT_FIELD_OFF                   2
+#define EVT_14A_SELECT                  3	// arg = cuid
+#define EVT_14A_SELECT_FAIL             4	// arg = stage reached
+#define EVT_MF_AUTH_START               5	// arg = block | key type << 8
+#define EVT_MF_AUTH_FAIL                6	// arg = block | key type << 8
+#define EVT_MF_AUTH_OK                  7	// arg = block | key type << 8
+#define EVT_SIM_START                   8	// arg = tag type
+#define EVT_SIM_STOP                    9	// arg = reader frames handled
+#define EVT_SIM_HALT                    10	// arg = cuid (HLTA received)
+
+// Scripted deviations for the MIFARE emulator ('hf mf simhooks'): per-command
+// action overrides with precompiled response frames, applied by table lookup
+// in MifareSim's dispatch so reader-fuzzing runs at full field rate without a
+// firmware rebuild per experiment. Request arg[0] = entries in the payload
+// (0 clears the table), entries are appended up to MFSIM_MAX_HOOKS; the ACK
+// returns the resulting table size in arg[0].
+#define CMD_MIFARE_SIM_HOOKS                                              0x0116
+#define MFSIM_MAX_HOOKS                 8
+#define MFSIM_HOOK_PASS                 0	// normal behavior (delay still applies)
+#define MFSIM_HOOK_SILENT               1	// no response at all
+#define MFSIM_HOOK_NACK                 2	// 4-bit NACK
+#define MFSIM_HOOK_ACK                  3	// 4-bit ACK
+#define MFSIM_HOOK_RESPONSE             4	// send the precompiled frame in resp
+typedef struct {
+	uint8_t cmd;		// first byte of the (decrypted) reader frame to match
+	uint8_t action;		// MFSIM_HOOK_*
+	uint8_t resp_len;
+	uint8_t resp[18];	// precompiled response frame, CRC included
+	uint16_t after_n;	// apply only after this many matching frames (0 = always)
+	uint16_t delay_us;	// stall this long before acting
+} PACKED mfsim_hook_t;
+
+// Time-sliced LF/HF triage scan for unknown tags ('auto'): the device
+// alternates a short ISO14443a wakeup+select with a brief 125 kHz acquisition
+// until one side sees a tag, arg[0] = max rounds (0 = default). The ACK
+// carries arg[0] = ISCAN_FOUND_*, arg[1] = rounds used; for a 14a hit the
+// data holds the iso14a_card_select_t, for an LF hit arg[2] = captured
+// samples, left in the big buffer for download.
+#define CMD_INTERLEAVED_SCAN                                              0x0117
+#define ISCAN_FOUND_NOTHING             0
+#define ISCAN_FOUND_14A                 1
+#define ISCAN_FOUND_LF                  2
 
 // controlling the ADC input multiplexer
 #define CMD_SET_ADC_MUX                                                   0x020F
@@ -117,13 +262,44 @@ typedef struct{
 #define CMD_T55XX_WAKEUP                                                  0x0224
 #define CMD_COTAG                                                         0x0225
 #define CMD_PARADOX_CLONE_TAG                                             0x0226
+// On-device batched T55xx password check:
+// arg[0] = downlink mode bits, arg[1] = number of candidates, d.asBytes = candidates (4 bytes each, MSB first)
+#define CMD_T55XX_CHK_PWDS                                                0x022F
 #define CMD_EM4X_PROTECT                                                  0x0228
+// RLE-compressed variant of CMD_DOWNLOADED_RAW_ADC_SAMPLES_125K:
+// arg[0] = decoded offset, arg[1] = encoded length, arg[2] = decoded length
+#define CMD_DOWNLOADED_COMPRESSED_ADC_SAMPLES_125K                        0x0229
+#define CMD_LF_STREAM_RAW_ADC_SAMPLES                                     0x022A
+#define CMD_LF_SNOOP_SMART_ADC_SAMPLES                                    0x022B
+// On-device LF waveform synthesis with optional per-repetition mutation:
+// arg[0] = modulation | clock<<8 | carrier<<16 | invert<<24
+//          (modulation 0=ask/man 1=ask/raw 2=biphase 3=psk 4=fsk; carrier is
+//          the psk wave length, or fcHigh<<4|fcLow for fsk)
+// arg[1] = bit count | mutating field bit offset<<16, arg[2] = PRNG seed
+// d.asBytes[0] = mutating field width in bits (0 = static),
+// bit template packed MSB first from d.asBytes[4]
+#define CMD_LF_SYNTH_SIM                                                  0x022C
+// Multi-block T55xx write in one field session with read-back check:
+// arg[0] = flags (same bit layout as single writes), arg[1] = number of blocks,
+// arg[2] = password, d.asBytes = blocks (1 byte block number + 4 bytes data each)
+#define CMD_T55XX_WRITE_BLOCK_BULK                                        0x0230
+// Continuous on-device HID decode: the device FSK-demods HID frames,
+// deduplicates repeated transmissions and pushes each distinct read as an
+// unsolicited CMD_HID_BEACON_EVENT (arg0 = ms timestamp, arg1 = hi2:hi,
+// arg2 = lo) until the button is pressed or the client sends a command.
+#define CMD_HID_BEACON                                                    0x022D
+#define CMD_HID_BEACON_EVENT                                              0x022E
 
 // For the 13.56 MHz tags
 #define CMD_ACQUIRE_RAW_ADC_SAMPLES_ISO_15693                             0x0300
 #define CMD_READ_SRI512_TAG                                               0x0303
 #define CMD_READ_SRIX4K_TAG                                               0x0304
 #define CMD_ISO_14443B_COMMAND                                            0x0305
+// On-device 14443B slot-marker anticollision. arg[0] = max number of tags
+// (0 = as many as fit in one response), arg[1]&1 = leave the first tag
+// ATTRIB'ed with the field on. Response: arg[0] entries of
+// [4 byte PUPI][4 byte App Data][3 byte Prot Info][1 pad], arg[1] = session up
+#define CMD_READER_ISO_14443B_INVENTORY                                   0x0306
 #define CMD_READER_ISO_15693                                              0x0310
 #define CMD_SIMTAG_ISO_15693                                              0x0311
 #define CMD_SNOOP_ISO_15693                                               0x0312
@@ -135,6 +311,7 @@ typedef struct{
 #define CMD_CSETUID_ISO_15693                                             0x0318
 #define CMD_ISO_15693_EML_MEMSET                                          0x0320
 #define CMD_ISO_15693_EML_MEMGET                                          0x0321
+#define CMD_ISO_15693_INVENTORY                                           0x0322
 
 // For Hitag2 transponders
 #define CMD_SNOOP_HITAG                                                   0x0370
@@ -152,11 +329,26 @@ typedef struct{
 #define CMD_SNOOP_ISO_14443a                                              0x0383
 #define CMD_SIMULATE_TAG_ISO_14443a                                       0x0384
 #define CMD_READER_ISO_14443a                                             0x0385
+#define CMD_READER_ISO_14443A_APDU_BATCH                                  0x038D
+#define CMD_READER_ISO_14443A_INVENTORY                                   0x038E
+#define CMD_READER_ISO_14443A_TIMING                                      0x038F
+// Topaz (NFC Type 1) bulk read: READ8 of block 0x0f plus RSEG of every
+// remaining segment in one field session. arg[0] = tag memory size in bytes,
+// datain = the 4 uid bytes every Topaz command carries. Answers with the
+// concatenated dynamic memory (arg[0] = byte count, 0 on error). The field
+// must already be up (select + RALL) and is left up afterwards
+#define CMD_TOPAZ_READ_ALL                                                0x03A0
+#define CMD_DOWNLOADED_TRACE                                              0x038C
 #define CMD_SIMULATE_TAG_LEGIC_RF                                         0x0387
 #define CMD_READER_LEGIC_RF                                               0x0388
 #define CMD_WRITER_LEGIC_RF                                               0x0389
 #define CMD_EPA_PACE_COLLECT_NONCE                                        0x038A
 #define CMD_EPA_PACE_REPLAY                                               0x038B
+// Batched PACE nonce collection. arg[0] = nonce size, arg[1] = number of
+// reset-collect cycles, arg[2] = pause between cycles in seconds. The device
+// streams CMD_ACK packets of [1 byte nonce length][nonce] records (arg[0] =
+// record count) and finishes with arg[2] = 1, arg[0]/arg[1] = ok/failed totals
+#define CMD_EPA_PACE_COLLECT_NONCE_BATCH                                  0x0386
 
 #define CMD_ICLASS_CLONE                                                  0x0390
 #define CMD_ICLASS_DUMP                                                   0x0391
@@ -173,6 +365,12 @@ typedef struct{
 // For measurements of the antenna tuning
 #define CMD_MEASURE_ANTENNA_TUNING                                        0x0400
 #define CMD_MEASURE_ANTENNA_TUNING_HF                                     0x0401
+// Continuous antenna telemetry. arg[0] = sample period ms (0 = stop),
+// arg[1] = 1 for HF / 0 for LF, arg[2] = LF divisor (19-255, default 95).
+// The device pushes unsolicited SAMPLE messages: arg[0] = antenna voltage
+// in mV, arg[1] = HF flag, arg[2] = device timestamp ms
+#define CMD_ANTENNA_TELEMETRY                                             0x0402
+#define CMD_ANTENNA_TELEMETRY_SAMPLE                                      0x0411
 #define CMD_MEASURED_ANTENNA_TUNING                                       0x0410
 #define CMD_LISTEN_READER_FIELD                                           0x0420
 
@@ -185,6 +383,16 @@ typedef struct{
 #define CMD_MIFARE_EML_MEMSET                                             0x0602
 #define CMD_MIFARE_EML_MEMGET                                             0x0603
 #define CMD_MIFARE_EML_CARDLOAD                                           0x0604
+#define CMD_MIFARE_EML_LOAD                                               0x0609
+// copy-on-write persona slots over the emulator memory
+// (arg0: 0 = store, 1 = restore, 2 = status; arg1: slot)
+#define CMD_MIFARE_EML_PERSONA                                            0x060a
+#define EM_PERSONA_SLOTS                                                  4
+
+// flags for CMD_MIFARE_EML_LOAD (arg0)
+#define EML_LOAD_COMPRESSED                                               0x01	// payload is part of one zlib stream
+#define EML_LOAD_FIRST                                                    0x02	// first chunk of the upload
+#define EML_LOAD_FINAL                                                    0x04	// last chunk, device acks with bytes written
 
 // magic chinese card commands
 #define CMD_MIFARE_CSETBLOCK                                              0x0605
@@ -203,7 +411,11 @@ typedef struct{
 #define CMD_MIFARE_WRITEBL                                                0x0622
 #define CMD_MIFARE_CHKKEYS                                                0x0623
 #define CMD_MIFARE_PERSONALIZE_UID                                        0x0624
+#define CMD_MIFARE_CHKKEYS_LOAD                                           0x0625
+#define CMD_MIFARE_CHKKEYS_CACHED                                         0x0626
+#define CMD_MIFARE_READCARD                                               0x0627
 #define CMD_MIFARE_SNIFFER                                                0x0630
+#define CMD_MIFARE_COMM_STATS                                             0x0631
 
 //ultralightC
 #define CMD_MIFAREU_READBL                                                0x0720
@@ -223,6 +435,9 @@ typedef struct{
 #define CMD_MIFARE_DES_READER                                             0x072c
 #define CMD_MIFARE_DESFIRE_INFO                                           0x072d
 #define CMD_MIFARE_DESFIRE                                                0x072e
+// Batched UL-EV1/NTAG PWD_AUTH candidate check: arg[0] = number of 4-byte
+// passwords in the data
+#define CMD_MIFAREU_EV1_PWD_CHECK                                         0x072f
 
 #define CMD_HF_SNIFFER                                                    0x0800
 #define CMD_HF_PLOT                                                       0x0801
@@ -234,6 +449,7 @@ typedef struct{
 #define FLAG_INTERACTIVE                (1<<0)
 #define FLAG_4B_UID_IN_DATA             (1<<1)
 #define FLAG_7B_UID_IN_DATA             (1<<2)
+#define FLAG_EML_FROM_FLASH             (1<<3)	// preload emulator memory from the flash store
 #define FLAG_NR_AR_ATTACK               (1<<4)
 #define FLAG_RANDOM_NONCE               (1<<5)
 
@@ -254,6 +470,10 @@ typedef struct{
 #define ICLASS_SIM_MODE_EXIT_AFTER_MAC        5  // note: device internal only
 
 
+// arg[2] flags for CMD_DOWNLOAD_RAW_ADC_SAMPLES_125K
+// the device may send chunks RLE-compressed when they shrink
+#define FLAG_DOWNLOAD_COMPRESS          (1<<0)
+
 // hw tune args
 #define FLAG_TUNE_LF   1
 #define FLAG_TUNE_HF   2
@@ -280,6 +500,14 @@ typedef struct{
 /* Set if this device understands the extend start flash command */
 #define DEVICE_INFO_FLAG_UNDERSTANDS_START_FLASH 	(1<<4)
 
+/* Set if this device understands CMD_FLASH_CRC, i.e. can report CRCs of the
+   current flash contents so the flasher may skip identical blocks */
+#define DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC   	(1<<5)
+
+/* Set if this device understands CMD_WRITE_LZ, i.e. accepts LZSS-compressed
+   flash write streams */
+#define DEVICE_INFO_FLAG_UNDERSTANDS_WRITE_LZ    	(1<<6)
+
 /* CMD_START_FLASH may have three arguments: start of area to flash,
    end of area to flash, optional magic.
    The bootrom will not allow to overwrite itself unless this magic
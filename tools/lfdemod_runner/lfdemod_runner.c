@@ -0,0 +1,284 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Trace-driven regression runner for the lfdemod decoders.
+//
+// Replays every *.pm3 sample file from the given directories (or individual
+// files) through the main LF decoders, fingerprints each demod result and
+// compares it against a recorded corpus file, so decoder optimizations can
+// be checked for silent decode regressions:
+//
+//    lfdemod_runner [-r] <corpus file> <trace dir or file>...
+//
+// Without -r the results are checked against the corpus file (exit code 1 on
+// any mismatch); with -r the corpus file is (re)written. Per-decoder
+// throughput is reported either way. `make check` / `make record` run this
+// against the traces/ directory in the source tree.
+//-----------------------------------------------------------------------------
+
+#define _POSIX_C_SOURCE 200809L	// clock_gettime, strdup
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <dirent.h>
+#include <time.h>
+
+#include "lfdemod.h"
+#include "hardnested/hardnested_bf_core.h"	// SIMDExecInstr, for the kernel dispatch
+
+// lfdemod.c client-side stubs
+uint8_t g_debugMode = 0;
+void PrintAndLog(char *fmt, ...) {}
+
+// The multiarch kernels dispatch through GetSIMDInstrAuto(), which lives in
+// hardnested_bf_core.c in the client; that file drags in the whole cracker,
+// so redo the (small) CPU detection here instead of linking it.
+SIMDExecInstr GetSIMDInstrAuto(void)
+{
+#if defined (__i386__) || defined (__x86_64__)
+	if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+	if (__builtin_cpu_supports("avx")) return SIMD_AVX;
+	if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+	if (__builtin_cpu_supports("mmx")) return SIMD_MMX;
+#endif
+	return SIMD_NONE;
+}
+
+#define MAX_SAMPLES (1024 * 1024)
+#define MAX_LINE 512
+
+typedef struct {
+	const char *name;
+	uint64_t bytes_in;	// samples fed through this decoder
+	double seconds;		// time spent in the decoder proper
+} decoder_stat_t;
+
+enum {
+	DEC_ASK_MAN = 0,
+	DEC_ASK_BI,
+	DEC_NRZ,
+	DEC_PSK2,
+	DEC_FSK_10_8,
+	DEC_FSK_8_5,
+	NUM_DECODERS
+};
+
+static decoder_stat_t decoder_stats[NUM_DECODERS] = {
+	{"ask/man"},
+	{"ask/bi"},
+	{"nrz"},
+	{"psk2"},
+	{"fsk/10-8"},
+	{"fsk/8-5"},
+};
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// FNV-1a over the demodulated bit buffer - a compact decode fingerprint
+static uint32_t fingerprint(const uint8_t *bits, size_t size)
+{
+	uint32_t hash = 0x811c9dc5;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bits[i];
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+// Load a .pm3 sample file (one signed sample value per line) and convert it
+// the way the client's getFromGraphBuf() feeds the decoders: clamped to
+// +/-127 and shifted to unsigned.
+static size_t load_trace(const char *path, uint8_t *samples)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return 0;
+	}
+
+	size_t count = 0;
+	char line[80];
+	while (fgets(line, sizeof(line), f) && count < MAX_SAMPLES) {
+		int v;
+		if (sscanf(line, "%i", &v) != 1)
+			continue;
+		if (v > 127) v = 127;
+		else if (v < -127) v = -127;
+		samples[count++] = (uint8_t)(v + 128);
+	}
+
+	fclose(f);
+	return count;
+}
+
+// Run one decoder over a scratch copy of the samples and format a corpus
+// line: <decoder> <ret> <size> <clk> <invert> <hash> <file>
+static void run_decoder(int dec, const uint8_t *samples, size_t nsamples,
+                        const char *name, char *out, size_t outlen)
+{
+	static uint8_t buf[MAX_SAMPLES];
+	size_t size = nsamples;
+	int clk = 0, invert = 0, start_idx = 0;
+	int ret = 0;
+
+	memcpy(buf, samples, nsamples);
+
+	double start = now_seconds();
+	switch (dec) {
+		case DEC_ASK_MAN:
+			ret = askdemod_ext(buf, &size, &clk, &invert, 100, 0, 1, &start_idx);
+			break;
+		case DEC_ASK_BI:
+			ret = askdemod_ext(buf, &size, &clk, &invert, 100, 0, 0, &start_idx);
+			break;
+		case DEC_NRZ:
+			ret = nrzRawDemod(buf, &size, &clk, &invert, &start_idx);
+			break;
+		case DEC_PSK2:
+			ret = pskRawDemod_ext(buf, &size, &clk, &invert, &start_idx);
+			if (ret >= 0)
+				psk1TOpsk2(buf, size);
+			break;
+		case DEC_FSK_10_8:	// HID style, field clocks 10/8
+			clk = 50;
+			ret = fskdemod(buf, size, 50, 0, 10, 8, &start_idx);
+			size = (ret > 0) ? (size_t)ret : 0;
+			break;
+		case DEC_FSK_8_5:	// AWID/ioProx style, field clocks 8/5
+			clk = 50;
+			ret = fskdemod(buf, size, 50, 0, 8, 5, &start_idx);
+			size = (ret > 0) ? (size_t)ret : 0;
+			break;
+	}
+	decoder_stats[dec].seconds += now_seconds() - start;
+	decoder_stats[dec].bytes_in += nsamples;
+
+	uint32_t hash = (ret >= 0 && size) ? fingerprint(buf, size) : 0;
+	snprintf(out, outlen, "%s %d %zu %d %d %08x %s",
+	         decoder_stats[dec].name, ret, size, clk, invert, hash, name);
+}
+
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+// Collect the .pm3 files of a directory (sorted, for a stable corpus order),
+// or the argument itself when it's a plain file.
+static int collect_traces(const char *arg, char **files, int max_files)
+{
+	int count = 0;
+	DIR *dir = opendir(arg);
+
+	if (!dir) {
+		files[0] = strdup(arg);
+		return 1;
+	}
+
+	struct dirent *ent;
+	while ((ent = readdir(dir)) && count < max_files) {
+		size_t len = strlen(ent->d_name);
+		if (len < 4 || strcmp(ent->d_name + len - 4, ".pm3") != 0)
+			continue;
+		char *path = malloc(strlen(arg) + len + 2);
+		sprintf(path, "%s/%s", arg, ent->d_name);
+		files[count++] = path;
+	}
+	closedir(dir);
+
+	qsort(files, count, sizeof(char *), compare_names);
+	return count;
+}
+
+int main(int argc, char *argv[])
+{
+	bool record = false;
+	int argi = 1;
+
+	if (argi < argc && strcmp(argv[argi], "-r") == 0) {
+		record = true;
+		argi++;
+	}
+	if (argc - argi < 2) {
+		fprintf(stderr, "syntax: %s [-r] <corpus file> <trace dir or file>...\n", argv[0]);
+		return 2;
+	}
+
+	const char *corpus_path = argv[argi++];
+	FILE *corpus = fopen(corpus_path, record ? "w" : "r");
+	if (!corpus) {
+		fprintf(stderr, "cannot open corpus file %s\n", corpus_path);
+		return 2;
+	}
+
+	static uint8_t samples[MAX_SAMPLES];
+	char *files[1024];
+	int failures = 0, checked = 0;
+
+	for (; argi < argc; argi++) {
+		int nfiles = collect_traces(argv[argi], files, 1024);
+
+		for (int i = 0; i < nfiles; i++) {
+			// strip the directory for stable corpus entries
+			const char *name = strrchr(files[i], '/');
+			name = name ? name + 1 : files[i];
+
+			size_t nsamples = load_trace(files[i], samples);
+			if (!nsamples) {
+				failures++;
+				continue;
+			}
+
+			for (int dec = 0; dec < NUM_DECODERS; dec++) {
+				char actual[MAX_LINE];
+				run_decoder(dec, samples, nsamples, name, actual, sizeof(actual));
+				checked++;
+
+				if (record) {
+					fprintf(corpus, "%s\n", actual);
+					continue;
+				}
+
+				char expected[MAX_LINE];
+				if (!fgets(expected, sizeof(expected), corpus)) {
+					fprintf(stderr, "FAIL: corpus file ends before %s %s\n",
+					        decoder_stats[dec].name, name);
+					failures++;
+					continue;
+				}
+				expected[strcspn(expected, "\n")] = '\0';
+				if (strcmp(expected, actual) != 0) {
+					fprintf(stderr, "FAIL: expected '%s'\n      got      '%s'\n",
+					        expected, actual);
+					failures++;
+				}
+			}
+			free(files[i]);
+		}
+	}
+
+	fclose(corpus);
+
+	printf("%d decoder runs %s, %d failure%s\n", checked,
+	       record ? "recorded" : "checked", failures, failures == 1 ? "" : "s");
+	for (int dec = 0; dec < NUM_DECODERS; dec++) {
+		decoder_stat_t *st = &decoder_stats[dec];
+		if (st->seconds > 0)
+			printf("%10s: %6.1f MB/s\n", st->name,
+			       st->bytes_in / st->seconds / 1e6);
+	}
+
+	return (failures && !record) ? 1 : 0;
+}
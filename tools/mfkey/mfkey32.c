@@ -2,11 +2,39 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "crapto1/crapto1.h"
 #include "mifare/mfkey.h"
+#include "mfkey_batch.h"
 #include "util_posix.h"
 
 
+// parse one batch line: <uid> <nt0> <{nr_0}> <{ar_0}> [<nt1>] <{nr_1}> <{ar_1}>
+static bool parse_tuple(const char *line, nonces_t *data, int *type) {
+	uint32_t f4, f5, f6;
+	int fields = sscanf(line, "%x %x %x %x %x %x %x", &data->cuid, &data->nonce, &data->nr, &data->ar, &f4, &f5, &f6);
+	if (fields == 7) {        // nt1 given: moebius attack
+		data->nonce2 = f4;
+		data->nr2 = f5;
+		data->ar2 = f6;
+		*type = 1;
+	} else if (fields == 6) { // nt1 omitted: same tag challenge twice
+		data->nonce2 = data->nonce;
+		data->nr2 = f4;
+		data->ar2 = f5;
+		*type = 0;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static bool recover_tuple(nonces_t data, int type, uint64_t *key) {
+	if (type)
+		return mfkey32_moebius(data, key);
+	return mfkey32(data, key);
+}
+
 // 32 bit recover key from 2 nonces
 int main (int argc, char *argv[]) {
 
@@ -17,9 +45,15 @@ int main (int argc, char *argv[]) {
   printf("MIFARE Classic key recovery - based on 32 bits of keystream\n");
   printf("Recover key from two 32-bit reader authentication answers only!\n\n");
 
+  if (argc >= 3 && strcmp(argv[1], "-f") == 0) {
+    return batch_run(argv[2], (argc > 3) ? argv[3] : NULL, parse_tuple, recover_tuple);
+  }
+
   if (argc != 7 && argc != 8) {
     printf(" syntax: %s <uid> <nt0> <{nr_0}> <{ar_0}> [<nt1>] <{nr_1}> <{ar_1}>\n", argv[0]);
 	printf("         (you may omit nt1 if it is equal to nt0)\n\n");
+	printf("   batch: %s -f <tuple_file> [<dictionary_file>]\n", argv[0]);
+	printf("         (one tuple per line, same field order as above, '#' comments)\n\n");
     return 1;
   }
 
@@ -2,9 +2,23 @@
 #include <string.h>
 #include <inttypes.h>
 #include "crapto1/crapto1.h"
+#include "mifare/mfkey.h"
+#include "mfkey_batch.h"
 #include "util_posix.h"
 
-int main (int argc, char *argv[]) 
+
+// parse one batch line: <uid> <nt> <{nr}> <{ar}> <{at}>
+static bool parse_tuple(const char *line, nonces_t *data, int *type) {
+	*type = 0;
+	return sscanf(line, "%x %x %x %x %x", &data->cuid, &data->nonce, &data->nr, &data->ar, &data->at) == 5;
+}
+
+static bool recover_tuple(nonces_t data, int type, uint64_t *key) {
+	(void)type;
+	return mfkey64(data, key) == 0;
+}
+
+int main (int argc, char *argv[])
 {
 	uint32_t uid;     // serial numDber
 	uint32_t nt;      // tag challenge
@@ -19,8 +33,14 @@ int main (int argc, char *argv[])
 	printf("MIFARE Classic key recovery - based on 64 bits of keystream\n");
 	printf("Recover key from only one complete authentication!\n\n");
 
+	if (argc >= 3 && strcmp(argv[1], "-f") == 0) {
+		return batch_run(argv[2], (argc > 3) ? argv[3] : NULL, parse_tuple, recover_tuple);
+	}
+
 	if (argc < 6 ) {
-		printf(" syntax: %s <uid> <nt> <{nr}> <{ar}> <{at}> [enc] [enc...]\n\n", argv[0]);
+		printf(" syntax: %s <uid> <nt> <{nr}> <{ar}> <{at}> [enc] [enc...]\n", argv[0]);
+		printf("   batch: %s -f <tuple_file> [<dictionary_file>]\n", argv[0]);
+		printf("         (one '<uid> <nt> <{nr}> <{ar}> <{at}>' tuple per line, '#' comments)\n\n");
 		return 1;
 	}
 
@@ -0,0 +1,175 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Batch driver shared by mfkey32 and mfkey64. Reads a file with one nonce
+// tuple per line (same field order as the command line of the tool),
+// distributes the recoveries over all cores, deduplicates the keys and
+// writes them out as a dictionary usable with 'hf mf chk' (one key of
+// 12 hex digits per line, like default_keys.dic).
+//-----------------------------------------------------------------------------
+
+#include "mfkey_batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "util_posix.h"
+
+
+typedef struct {
+	nonces_t data;
+	int type;
+	int lineno;
+	bool success;
+	uint64_t key;
+} batch_job_t;
+
+static batch_job_t *batch_jobs = NULL;
+static int batch_num_jobs = 0;
+static int batch_cursor = 0;
+static batch_recover_fn batch_recover = NULL;
+
+
+static int batch_num_cores(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return (cores < 1) ? 1 : (int)cores;
+#endif
+}
+
+
+static void *batch_worker(void *arg)
+{
+	(void)arg;
+	int i;
+	while ((i = __sync_fetch_and_add(&batch_cursor, 1)) < batch_num_jobs) {
+		batch_job_t *job = &batch_jobs[i];
+		job->success = batch_recover(job->data, job->type, &job->key);
+	}
+	return NULL;
+}
+
+
+static int compare_keys(const void *a, const void *b)
+{
+	uint64_t ka = *(const uint64_t *)a;
+	uint64_t kb = *(const uint64_t *)b;
+	if (ka < kb) return -1;
+	if (ka > kb) return 1;
+	return 0;
+}
+
+
+int batch_run(const char *infile, const char *outfile, batch_parse_fn parse, batch_recover_fn recover)
+{
+	FILE *fin = fopen(infile, "r");
+	if (fin == NULL) {
+		fprintf(stderr, "Could not open %s\n", infile);
+		return 1;
+	}
+
+	// collect the jobs
+	char line[256];
+	int capacity = 64;
+	int lineno = 0;
+	batch_jobs = calloc(capacity, sizeof(batch_job_t));
+	batch_num_jobs = 0;
+	while (fgets(line, sizeof(line), fin) != NULL) {
+		lineno++;
+		char *comment = strchr(line, '#');
+		if (comment != NULL) *comment = '\0';
+		if (strspn(line, " \t\r\n") == strlen(line)) continue;  // blank line
+		if (batch_num_jobs == capacity) {
+			capacity *= 2;
+			batch_jobs = realloc(batch_jobs, capacity * sizeof(batch_job_t));
+		}
+		batch_job_t *job = &batch_jobs[batch_num_jobs];
+		memset(job, 0, sizeof(*job));
+		job->lineno = lineno;
+		if (!parse(line, &job->data, &job->type)) {
+			fprintf(stderr, "Skipping malformed line %d of %s\n", lineno, infile);
+			continue;
+		}
+		batch_num_jobs++;
+	}
+	fclose(fin);
+
+	if (batch_num_jobs == 0) {
+		fprintf(stderr, "No nonce tuples found in %s\n", infile);
+		free(batch_jobs);
+		return 1;
+	}
+
+	// run the recoveries
+	int num_threads = batch_num_cores();
+	if (num_threads > batch_num_jobs) num_threads = batch_num_jobs;
+	printf("Recovering %d tuple(s) on %d thread(s)...\n", batch_num_jobs, num_threads);
+	uint64_t start_time = msclock();
+	batch_recover = recover;
+	batch_cursor = 0;
+	pthread_t threads[num_threads];
+	for (int i = 0; i < num_threads; i++) {
+		pthread_create(&threads[i], NULL, batch_worker, NULL);
+	}
+	for (int i = 0; i < num_threads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	printf("Time spent: %1.2f seconds\n\n", (float)(msclock() - start_time)/1000.0);
+
+	// report per tuple, then deduplicate the keys
+	uint64_t *keys = calloc(batch_num_jobs, sizeof(uint64_t));
+	int num_keys = 0;
+	for (int i = 0; i < batch_num_jobs; i++) {
+		batch_job_t *job = &batch_jobs[i];
+		if (job->success) {
+			printf("line %3d: uid %08x nt %08x -> key %012" PRIx64 "\n", job->lineno, job->data.cuid, job->data.nonce, job->key);
+			keys[num_keys++] = job->key;
+		} else {
+			printf("line %3d: uid %08x nt %08x -> no key\n", job->lineno, job->data.cuid, job->data.nonce);
+		}
+	}
+	qsort(keys, num_keys, sizeof(uint64_t), compare_keys);
+	int num_unique = 0;
+	for (int i = 0; i < num_keys; i++) {
+		if (i == 0 || keys[i] != keys[i-1])
+			keys[num_unique++] = keys[i];
+	}
+
+	// write the dictionary
+	FILE *fout = stdout;
+	if (outfile != NULL) {
+		fout = fopen(outfile, "w");
+		if (fout == NULL) {
+			fprintf(stderr, "Could not create %s\n", outfile);
+			free(keys);
+			free(batch_jobs);
+			return 1;
+		}
+	}
+	for (int i = 0; i < num_unique; i++) {
+		fprintf(fout, "%012" PRIx64 "\n", keys[i]);
+	}
+	if (outfile != NULL) {
+		fclose(fout);
+		printf("\nWrote %d unique key(s) to %s\n", num_unique, outfile);
+	}
+
+	free(keys);
+	free(batch_jobs);
+	batch_jobs = NULL;
+	return 0;
+}
@@ -0,0 +1,30 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Batch driver shared by mfkey32 and mfkey64: process a whole file of nonce
+// tuples on all cores and emit the recovered keys as a dictionary.
+//-----------------------------------------------------------------------------
+
+#ifndef MFKEY_BATCH_H
+#define MFKEY_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mifare/mfkey.h"
+
+// parse one input line into a nonce tuple. type is tool specific (mfkey32
+// uses it to flag the moebius variant). Return false to skip the line.
+typedef bool (*batch_parse_fn)(const char *line, nonces_t *data, int *type);
+
+// recover one key from a parsed tuple
+typedef bool (*batch_recover_fn)(nonces_t data, int type, uint64_t *key);
+
+// Read infile line by line ('#' starts a comment), spread the recoveries
+// over all cores, deduplicate the keys and write them as a dictionary
+// (12 hex digits per line, the default_keys.dic format) to outfile, or to
+// stdout if outfile is NULL. Returns 0 on success.
+int batch_run(const char *infile, const char *outfile, batch_parse_fn parse, batch_recover_fn recover);
+
+#endif
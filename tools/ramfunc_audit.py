@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Verify that the hot sniffer/DMA paths of the firmware run from RAM.
+
+The AT91SAM7S flash needs a wait state at our clock rate, so a hot
+function that silently drops out of the .ramfunc overlay costs roughly
+one extra cycle per fetched word - enough to break the tight DMA drain
+loops. This has bitten us before as hard-to-diagnose timing bugs.
+
+Reads the symbol table of armsrc/obj/fullimage.stage1.elf with
+${CROSS}nm, checks every function on the hot list against the RAM
+address range, and prints a size/penalty report for everything in
+.ramfunc. Exits non-zero if a hot function ends up in flash, so the
+build can fail loudly instead.
+
+Usage: ramfunc_audit.py [path/to/fullimage.stage1.elf] [--nm NM]
+"""
+
+import argparse
+import subprocess
+import sys
+
+FLASH_BASE = 0x00100000
+RAM_BASE = 0x00200000
+RAM_SIZE = 64 * 1024
+
+# Functions that sit inside DMA drain loops or tight bit-banging paths.
+# Statics are visible in nm output too, but their names are per-file, so
+# entries are (symbol, containing object or '' for any).
+HOT_FUNCS = [
+    ("MillerDecoding", "iso14443a"),
+    ("ManchesterDecoding", "iso14443a"),
+    ("SnoopIso14443a", "iso14443a"),
+    ("SniffMifare", "iso14443a"),
+    ("Handle14443bUartBit", "iso14443b"),
+    ("Handle14443bSamplesDemod", "iso14443b"),
+    ("SnoopIso14443b", "iso14443b"),
+    ("OutOfNDecoding", "iclass"),
+    ("ManchesterDecoding", "iclass"),
+    ("SnoopIClass", "iclass"),
+    ("MfSniffLogic", "mifaresniff"),
+    ("MfSniffSend", "mifaresniff"),
+    ("LogTrace", "BigBuf"),
+    ("optimizedSnoop", "hfsnoop"),
+    ("memcpy", "string"),
+    ("GetTickCount", "util"),
+    ("GetCountUS", "util"),
+    ("GetDeltaCountUS", "util"),
+]
+
+
+def read_symbols(elf, nm):
+    """Return [(addr, size, name)] for all function symbols, statics included."""
+    out = subprocess.check_output([nm, "-S", "--size-sort", elf],
+                                  universal_newlines=True)
+    syms = []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 4 or parts[2].lower() not in ("t", "w"):
+            continue
+        syms.append((int(parts[0], 16), int(parts[1], 16), parts[3]))
+    return syms
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("elf", nargs="?", default="obj/fullimage.stage1.elf")
+    ap.add_argument("--nm", default="arm-none-eabi-nm")
+    args = ap.parse_args()
+
+    try:
+        syms = read_symbols(args.elf, args.nm)
+    except (OSError, subprocess.CalledProcessError) as e:
+        print("ramfunc_audit: cannot read %s: %s" % (args.elf, e))
+        return 2
+
+    in_ram = [s for s in syms if RAM_BASE <= s[0] < RAM_BASE + RAM_SIZE]
+    by_name = {}
+    for s in syms:
+        by_name.setdefault(s[2], []).append(s)
+
+    print("== .ramfunc residents (largest first) ==")
+    total = 0
+    for addr, size, name in sorted(in_ram, key=lambda s: -s[1]):
+        # one wait state per 32-bit fetch; ARM-mode code fetches one
+        # word per instruction, so this approximates the cycles a full
+        # uncached pass through the function would lose in flash
+        print("  %08x %6d B  ~%5d cycles/pass saved  %s"
+              % (addr, size, size // 4, name))
+        total += size
+    print("  total: %d bytes of RAM code" % total)
+
+    failed = []
+    for name, obj in HOT_FUNCS:
+        cands = by_name.get(name, [])
+        if not cands:
+            # statics may be optimized away entirely in some configs
+            continue
+        for addr, size, _ in cands:
+            if addr >= FLASH_BASE and addr < RAM_BASE:
+                failed.append((name, obj, addr))
+
+    if failed:
+        print("== FAIL: hot functions placed in flash (wait-state penalty) ==")
+        for name, obj, addr in failed:
+            print("  %s (%s.c) at %08x - missing RAMFUNC?" % (name, obj, addr))
+        return 1
+
+    print("All hot functions verified in RAM.")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -94,6 +94,13 @@ bool uart_receive(const serial_port sp, uint8_t* pbtRx, size_t pszMaxRxLen, size
  */
 bool uart_send(const serial_port sp, const uint8_t* pbtTx, const size_t szTxLen);
 
+/* Wakes a uart_receive() call blocked on this port before its timeout
+ * expires, making it return to the caller right away - used to hand the
+ * communication thread a queued command without waiting out the receive
+ * timeout. A no-op on platforms without support.
+ */
+void uart_wakeup(const serial_port sp);
+
 /* Sets the current speed of the serial port, in baud.
  */
 bool uart_set_speed(serial_port sp, const uint32_t uiPortSpeed);
@@ -47,6 +47,7 @@
 #include <sys/stat.h>
 #include <limits.h>
 #include <sys/time.h>
+#include <time.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -54,6 +55,7 @@
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <sys/un.h>
 
 // Fix missing definition on OS X.
 // Taken from https://github.com/unbit/uwsgi/commit/b608eb1772641d525bfde268fe9d6d8d0d5efde7
@@ -61,11 +63,20 @@
 #define SOL_TCP IPPROTO_TCP
 #endif
 
+// OS X has no MSG_NOSIGNAL; SO_NOSIGPIPE set at connect time covers it there.
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 typedef struct termios term_info;
 typedef struct {
-  int fd;           // Serial port file descriptor
-  term_info tiOld;  // Terminal info before using the port
-  term_info tiNew;  // Terminal info during the transaction
+  int fd;             // Serial port file descriptor
+  term_info tiOld;    // Terminal info before using the port
+  term_info tiNew;    // Terminal info during the transaction
+  bool is_socket;     // TCP or unix-domain socket rather than a tty
+  char *socket_name;  // full "tcp:..."/"unix:..." string, kept for reconnects
+  int wake_rd;        // self-pipe: uart_wakeup() writes wake_wr to make a
+  int wake_wr;        // blocked uart_receive() return immediately
 } serial_port_unix;
 
 // Set time-out on 30 miliseconds
@@ -74,67 +85,159 @@ struct timeval timeout = {
   .tv_usec = 30000  // 30000 micro seconds
 };
 
-serial_port uart_open(const char* pcPortName)
+// Connect a stream socket to a "tcp:host[:port]" or "unix:path" destination.
+// Returns the connected file descriptor, or -1 on failure.
+static int socket_connect(const char* pcPortName)
 {
-  serial_port_unix* sp = malloc(sizeof(serial_port_unix));
-  if (sp == 0) return INVALID_SERIAL_PORT;
-  
-  if (memcmp(pcPortName, "tcp:", 4) == 0) {
-    struct addrinfo *addr = NULL, *rp;
-    char *addrstr = strdup(pcPortName + 4);
-    if (addrstr == NULL) {
-      printf("Error: strdup\n");
-      return INVALID_SERIAL_PORT;
+  if (memcmp(pcPortName, "unix:", 5) == 0) {
+    struct sockaddr_un sun;
+    if (strlen(pcPortName + 5) >= sizeof(sun.sun_path)) {
+      printf("Error: socket path too long\n");
+      return -1;
     }
-    char *colon = strrchr(addrstr, ':');
-    char *portstr;
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, pcPortName + 5);
 
-    // Set time-out to 300 miliseconds only for TCP port
-    timeout.tv_usec = 300000;
+    int sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sfd == -1) {
+      return -1;
+    }
+    if (connect(sfd, (struct sockaddr *)&sun, sizeof(sun)) == -1) {
+      printf("Error: Could not connect to %s\n", pcPortName);
+      close(sfd);
+      return -1;
+    }
+#ifdef SO_NOSIGPIPE
+    int off = 1;
+    setsockopt(sfd, SOL_SOCKET, SO_NOSIGPIPE, &off, sizeof(off));
+#endif
+    return sfd;
+  }
 
-    if (colon) {
-      portstr = colon + 1;
-      *colon = '\0';
-    } else
-      portstr = "7901";
+  struct addrinfo *addr = NULL, *rp;
+  char *addrstr = strdup(pcPortName + 4);
+  if (addrstr == NULL) {
+    printf("Error: strdup\n");
+    return -1;
+  }
+  char *colon = strrchr(addrstr, ':');
+  char *portstr;
 
-    struct addrinfo info;
+  if (colon) {
+    portstr = colon + 1;
+    *colon = '\0';
+  } else
+    portstr = "7901";
 
-    memset (&info, 0, sizeof(info));
+  struct addrinfo info;
 
-    info.ai_socktype = SOCK_STREAM;
+  memset (&info, 0, sizeof(info));
 
-    int s = getaddrinfo(addrstr, portstr, &info, &addr);
-    if (s != 0) {
-      printf("Error: getaddrinfo: %s\n", gai_strerror(s));
-      return INVALID_SERIAL_PORT;
-    }
+  info.ai_socktype = SOCK_STREAM;
 
-    int sfd;
-    for (rp = addr; rp != NULL; rp = rp->ai_next) {
-      sfd = socket(rp->ai_family, rp->ai_socktype,
-		   rp->ai_protocol);
-      if (sfd == -1)
-	continue;
+  int s = getaddrinfo(addrstr, portstr, &info, &addr);
+  if (s != 0) {
+    printf("Error: getaddrinfo: %s\n", gai_strerror(s));
+    free(addrstr);
+    return -1;
+  }
 
-      if (connect(sfd, rp->ai_addr, rp->ai_addrlen) != -1)
-	break;
+  int sfd;
+  for (rp = addr; rp != NULL; rp = rp->ai_next) {
+    sfd = socket(rp->ai_family, rp->ai_socktype,
+	   rp->ai_protocol);
+    if (sfd == -1)
+      continue;
 
-      close(sfd);
-    }
+    if (connect(sfd, rp->ai_addr, rp->ai_addrlen) != -1)
+      break;
 
-    if (rp == NULL) {               /* No address succeeded */
-      printf("Error: Could not connect\n");
-      return INVALID_SERIAL_PORT;
-    }
+    close(sfd);
+  }
 
-    freeaddrinfo(addr);
-    free(addrstr);
+  freeaddrinfo(addr);
+  free(addrstr);
+
+  if (rp == NULL) {               /* No address succeeded */
+    printf("Error: Could not connect\n");
+    return -1;
+  }
+
+  int one = 1;
+  setsockopt(sfd, SOL_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+  setsockopt(sfd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  return sfd;
+}
+
+// Try to re-establish a dropped socket connection in place. The caller's
+// read loop resets its frame state on failure, so a fresh connection simply
+// resumes at the next frame boundary.
+static bool socket_reconnect(serial_port_unix* sp)
+{
+  if (!sp->is_socket) {
+    return false;
+  }
+
+  // Don't hammer a dead peer: the polling loop retries every read, so
+  // limit actual connection attempts to one every two seconds.
+  static time_t last_attempt = 0;
+  time_t now = time(NULL);
+  if (now - last_attempt < 2) {
+    return false;
+  }
+  last_attempt = now;
 
-    sp->fd = sfd;
+  printf("Connection to %s lost, reconnecting...\n", sp->socket_name);
+  if (sp->fd != -1) {
+    close(sp->fd);
+  }
+  sp->fd = socket_connect(sp->socket_name);
+  return sp->fd != -1;
+}
+
+serial_port uart_open(const char* pcPortName)
+{
+  serial_port_unix* sp = malloc(sizeof(serial_port_unix));
+  if (sp == 0) return INVALID_SERIAL_PORT;
+  sp->is_socket = false;
+  sp->socket_name = NULL;
+
+  // Self-pipe so uart_wakeup() can interrupt a blocked uart_receive().
+  // If the pipe can't be made we just fall back to plain timeouts.
+  int wakefds[2];
+  if (pipe(wakefds) == 0) {
+    fcntl(wakefds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakefds[1], F_SETFL, O_NONBLOCK);
+    sp->wake_rd = wakefds[0];
+    sp->wake_wr = wakefds[1];
+  } else {
+    sp->wake_rd = sp->wake_wr = -1;
+  }
+
+  if (memcmp(pcPortName, "tcp:", 4) == 0 || memcmp(pcPortName, "unix:", 5) == 0) {
+    // Remote links are allowed to batch reads for longer than a local tty:
+    // 300 ms by default, tunable with PM3_SOCKET_BATCH_MS. Smaller values
+    // trade syscall overhead for snappier response delivery.
+    timeout.tv_usec = 300000;
+    const char *batch = getenv("PM3_SOCKET_BATCH_MS");
+    if (batch != NULL) {
+      long ms = strtol(batch, NULL, 10);
+      if (ms >= 1 && ms <= 1000) {
+        timeout.tv_sec = ms / 1000;
+        timeout.tv_usec = (ms % 1000) * 1000;
+      }
+    }
 
-    int one = 1;
-    setsockopt(sp->fd, SOL_TCP, TCP_NODELAY, &one, sizeof(one));
+    sp->fd = socket_connect(pcPortName);
+    if (sp->fd == -1) {
+      free(sp);
+      return INVALID_SERIAL_PORT;
+    }
+    sp->is_socket = true;
+    sp->socket_name = strdup(pcPortName);
     return sp;
   }
 
@@ -194,6 +297,16 @@ serial_port uart_open(const char* pcPortName)
 
 void uart_close(const serial_port sp) {
   serial_port_unix* spu = (serial_port_unix*)sp;
+  if (spu->wake_rd != -1) {
+    close(spu->wake_rd);
+    close(spu->wake_wr);
+  }
+  if (spu->is_socket) {
+    close(spu->fd);
+    free(spu->socket_name);
+    free(sp);
+    return;
+  }
   tcflush(spu->fd,TCIOFLUSH);
   tcsetattr(spu->fd,TCSANOW,&(spu->tiOld));
   struct flock fl;
@@ -212,22 +325,35 @@ bool uart_receive(const serial_port sp, uint8_t* pbtRx, size_t pszMaxRxLen, size
   int byteCount;
   fd_set rfds;
   struct timeval tv;
-  
+
   // Reset the output count
   *pszRxLen = 0;
-  
+
+  if (((serial_port_unix*)sp)->fd == -1) {
+    // a previous reconnect attempt failed; try again
+    if (!socket_reconnect((serial_port_unix*)sp)) {
+      return false;
+    }
+  }
+
   do {
-    // Reset file descriptor
+    // Reset file descriptors: the port itself plus the wakeup pipe
+    serial_port_unix* spu = (serial_port_unix*)sp;
+    int nfds = spu->fd;
     FD_ZERO(&rfds);
-    FD_SET(((serial_port_unix*)sp)->fd,&rfds);
+    FD_SET(spu->fd,&rfds);
+    if (spu->wake_rd != -1) {
+      FD_SET(spu->wake_rd,&rfds);
+      if (spu->wake_rd > nfds) nfds = spu->wake_rd;
+    }
     tv = timeout;
-    res = select(((serial_port_unix*)sp)->fd+1, &rfds, NULL, NULL, &tv);
-    
+    res = select(nfds+1, &rfds, NULL, NULL, &tv);
+
     // Read error
     if (res < 0) {
       return false;
     }
- 
+
     // Read time-out
     if (res == 0) {
       if (*pszRxLen == 0) {
@@ -238,7 +364,17 @@ bool uart_receive(const serial_port sp, uint8_t* pbtRx, size_t pszMaxRxLen, size
         return true;
       }
     }
- 
+
+    // Woken up by uart_wakeup(): drain the pipe, and if no port data came
+    // along with it, hand control back to the caller right away
+    if (spu->wake_rd != -1 && FD_ISSET(spu->wake_rd,&rfds)) {
+      char dummy[32];
+      while (read(spu->wake_rd, dummy, sizeof(dummy)) > 0);
+      if (!FD_ISSET(spu->fd,&rfds)) {
+        return *pszRxLen != 0;
+      }
+    }
+
     // Retrieve the count of the incoming bytes
     res = ioctl(((serial_port_unix*)sp)->fd, FIONREAD, &byteCount);
     if (res < 0) return false;
@@ -251,9 +387,16 @@ bool uart_receive(const serial_port sp, uint8_t* pbtRx, size_t pszMaxRxLen, size
     // There is something available, read the data
     res = read(((serial_port_unix*)sp)->fd, pbtRx+(*pszRxLen), byteCount);
 
-    // Stop if the OS has some troubles reading the data
-    if (res <= 0) return false;
- 
+    // Stop if the OS has some troubles reading the data. On a socket this
+    // means the peer went away - try to pick the link back up; the caller
+    // resets its frame state, so the next frame resyncs cleanly.
+    if (res <= 0) {
+      if (((serial_port_unix*)sp)->is_socket) {
+        socket_reconnect((serial_port_unix*)sp);
+      }
+      return false;
+    }
+
     *pszRxLen += res;
 
     if (*pszRxLen == pszMaxRxLen) {
@@ -266,12 +409,28 @@ bool uart_receive(const serial_port sp, uint8_t* pbtRx, size_t pszMaxRxLen, size
   return true;
 }
 
+void uart_wakeup(const serial_port sp) {
+  serial_port_unix* spu = (serial_port_unix*)sp;
+  if (spu->wake_wr != -1) {
+    if (write(spu->wake_wr, "w", 1) < 0) {
+      // pipe full - a wakeup is already pending, which is all we need
+    }
+  }
+}
+
 bool uart_send(const serial_port sp, const uint8_t* pbtTx, const size_t szTxLen) {
   int32_t res;
   size_t szPos = 0;
   fd_set rfds;
   struct timeval tv;
-  
+
+  if (((serial_port_unix*)sp)->fd == -1) {
+    // a previous reconnect attempt failed; try again
+    if (!socket_reconnect((serial_port_unix*)sp)) {
+      return false;
+    }
+  }
+
   while (szPos < szTxLen) {
     // Reset file descriptor
     FD_ZERO(&rfds);
@@ -289,12 +448,23 @@ bool uart_send(const serial_port sp, const uint8_t* pbtTx, const size_t szTxLen)
       return false;
     }
     
-    // Send away the bytes
-    res = write(((serial_port_unix*)sp)->fd,pbtTx+szPos,szTxLen-szPos);
-    
-    // Stop if the OS has some troubles sending the data
-    if (res <= 0) return false;
-    
+    // Send away the bytes. MSG_NOSIGNAL keeps a dropped peer from raising
+    // SIGPIPE; we want the error code and a reconnect, not a dead client.
+    if (((serial_port_unix*)sp)->is_socket)
+      res = send(((serial_port_unix*)sp)->fd,pbtTx+szPos,szTxLen-szPos,MSG_NOSIGNAL);
+    else
+      res = write(((serial_port_unix*)sp)->fd,pbtTx+szPos,szTxLen-szPos);
+
+    // Stop if the OS has some troubles sending the data. On a dropped
+    // socket, re-establish the link for the caller's next attempt - this
+    // frame is not resent, a partial command must not hit the device twice.
+    if (res <= 0) {
+      if (((serial_port_unix*)sp)->is_socket) {
+        socket_reconnect((serial_port_unix*)sp);
+      }
+      return false;
+    }
+
     szPos += res;
   }
   return true;
@@ -0,0 +1,241 @@
+/*
+ * Replay "serial port": re-runs a recorded command/response session behind
+ * the uart.h interface, at zero device latency. See uart_replay.h for the
+ * file format and the overall idea.
+ */
+
+#include "uart_replay.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+#include "util_posix.h"		// msleep()
+
+#define REPLAY_PORT_MAGIC	0x33524d50	// "PMR3", identifies our ports behind the void*
+
+// distinct command ids tracked in the timing report
+#define REPLAY_MAX_CMDS		64
+
+typedef struct {
+	uint64_t cmd;
+	uint32_t count;
+	uint64_t recorded_ms;	// wall time spent in the original session
+	uint64_t replay_cpu_ms;	// CPU time the replayed client spent
+} replay_cmd_stats_t;
+
+typedef struct {
+	uint32_t magic;
+	uint8_t *file;		// whole recording, owned
+	size_t size;
+	size_t pos;		// offset of the next unconsumed record
+
+	// the RX record currently being handed out
+	const uint8_t *rx_data;
+	size_t rx_len;
+	size_t rx_off;
+
+	// command in flight: recorded duration fixed at send time, CPU time
+	// measured from the send to the consumption of its last response byte
+	bool inflight;
+	uint64_t inflight_cmd;
+	uint64_t inflight_recorded_ms;
+	clock_t inflight_start;
+	clock_t inflight_done;
+
+	replay_cmd_stats_t stats[REPLAY_MAX_CMDS];
+	size_t stats_len;
+	uint32_t mismatches;
+} replay_port_t;
+
+bool uart_replay_is_port_name(const char *pcPortName)
+{
+	return memcmp(pcPortName, PM3_REPLAY_PREFIX, strlen(PM3_REPLAY_PREFIX)) == 0;
+}
+
+bool uart_replay_is(const serial_port sp)
+{
+	return sp != NULL && sp != INVALID_SERIAL_PORT && sp != CLAIMED_SERIAL_PORT
+			&& ((replay_port_t *)sp)->magic == REPLAY_PORT_MAGIC;
+}
+
+// header of the record at offset 'at', or NULL at end of recording
+static const pm3_rec_hdr_t *replay_peek(const replay_port_t *p, size_t at)
+{
+	if (at + sizeof(pm3_rec_hdr_t) > p->size)
+		return NULL;
+	const pm3_rec_hdr_t *hdr = (const pm3_rec_hdr_t *)(p->file + at);
+	if (at + sizeof(pm3_rec_hdr_t) + hdr->len > p->size)
+		return NULL;
+	return hdr;
+}
+
+static size_t replay_next(const pm3_rec_hdr_t *hdr, size_t at)
+{
+	return at + sizeof(pm3_rec_hdr_t) + hdr->len;
+}
+
+static void replay_account(replay_port_t *p)
+{
+	if (!p->inflight)
+		return;
+	p->inflight = false;
+
+	clock_t done = (p->inflight_done > p->inflight_start) ? p->inflight_done : p->inflight_start;
+	uint64_t cpu_ms = (uint64_t)(done - p->inflight_start) * 1000 / CLOCKS_PER_SEC;
+
+	for (size_t i = 0; i < p->stats_len; i++) {
+		if (p->stats[i].cmd == p->inflight_cmd) {
+			p->stats[i].count++;
+			p->stats[i].recorded_ms += p->inflight_recorded_ms;
+			p->stats[i].replay_cpu_ms += cpu_ms;
+			return;
+		}
+	}
+	if (p->stats_len < REPLAY_MAX_CMDS) {
+		replay_cmd_stats_t *st = &p->stats[p->stats_len++];
+		st->cmd = p->inflight_cmd;
+		st->count = 1;
+		st->recorded_ms = p->inflight_recorded_ms;
+		st->replay_cpu_ms = cpu_ms;
+	}
+}
+
+serial_port uart_replay_open(const char *pcPortName)
+{
+	const char *path = pcPortName + strlen(PM3_REPLAY_PREFIX);
+
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		printf("replay: can't open recording %s\n", path);
+		return INVALID_SERIAL_PORT;
+	}
+
+	replay_port_t *p = calloc(1, sizeof(replay_port_t));
+	if (p == NULL) {
+		fclose(f);
+		return INVALID_SERIAL_PORT;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (size < PM3_REC_MAGIC_LEN || (p->file = malloc(size)) == NULL
+			|| fread(p->file, 1, size, f) != (size_t)size
+			|| memcmp(p->file, PM3_REC_MAGIC, PM3_REC_MAGIC_LEN) != 0) {
+		printf("replay: %s is not a session recording\n", path);
+		fclose(f);
+		free(p->file);
+		free(p);
+		return INVALID_SERIAL_PORT;
+	}
+	fclose(f);
+
+	p->magic = REPLAY_PORT_MAGIC;
+	p->size = size;
+	p->pos = PM3_REC_MAGIC_LEN;
+	printf("replay: loaded %s (%ld bytes)\n", path, size);
+	return p;
+}
+
+void uart_replay_close(const serial_port sp)
+{
+	replay_port_t *p = (replay_port_t *)sp;
+
+	replay_account(p);
+
+	printf("\nreplay: per-command timing (recorded wall vs replayed CPU)\n");
+	printf("%-18s %7s %14s %16s\n", "command", "count", "recorded (ms)", "replay cpu (ms)");
+	for (size_t i = 0; i < p->stats_len; i++) {
+		printf("0x%016" PRIx64 " %7u %14" PRIu64 " %16" PRIu64 "\n",
+				p->stats[i].cmd, p->stats[i].count,
+				p->stats[i].recorded_ms, p->stats[i].replay_cpu_ms);
+	}
+	if (p->mismatches > 0)
+		printf("replay: %u command(s) differed from the recording, timings may be off\n", p->mismatches);
+
+	free(p->file);
+	free(p);
+}
+
+bool uart_replay_receive(const serial_port sp, uint8_t *pbtRx, size_t pszMaxRxLen, size_t *pszRxLen)
+{
+	replay_port_t *p = (replay_port_t *)sp;
+	*pszRxLen = 0;
+
+	// load the next pending RX record, if that's what comes next
+	if (p->rx_off >= p->rx_len) {
+		const pm3_rec_hdr_t *hdr = replay_peek(p, p->pos);
+		if (hdr == NULL || hdr->dir != PM3_REC_DIR_RX) {
+			// nothing to deliver until the client sends the next command;
+			// don't let the communication thread spin at full speed
+			msleep(1);
+			return false;
+		}
+		p->rx_data = p->file + p->pos + sizeof(pm3_rec_hdr_t);
+		p->rx_len = hdr->len;
+		p->rx_off = 0;
+		p->pos = replay_next(hdr, p->pos);
+	}
+
+	size_t chunk = p->rx_len - p->rx_off;
+	if (chunk > pszMaxRxLen)
+		chunk = pszMaxRxLen;
+	memcpy(pbtRx, p->rx_data + p->rx_off, chunk);
+	p->rx_off += chunk;
+	*pszRxLen = chunk;
+
+	p->inflight_done = clock();
+	return true;
+}
+
+bool uart_replay_send(const serial_port sp, const uint8_t *pbtTx, const size_t szTxLen)
+{
+	replay_port_t *p = (replay_port_t *)sp;
+
+	// the previous command is over once the next one goes on the wire
+	replay_account(p);
+
+	uint64_t sent_cmd = 0;
+	memcpy(&sent_cmd, pbtTx, (szTxLen < sizeof(sent_cmd)) ? szTxLen : sizeof(sent_cmd));
+
+	// find the next recorded outgoing frame, skipping responses a diverging
+	// session left unconsumed
+	const pm3_rec_hdr_t *hdr;
+	while ((hdr = replay_peek(p, p->pos)) != NULL && hdr->dir != PM3_REC_DIR_TX)
+		p->pos = replay_next(hdr, p->pos);
+	if (hdr == NULL) {
+		printf("replay: recording exhausted, dropping command 0x%" PRIx64 "\n", sent_cmd);
+		p->mismatches++;
+		return true;
+	}
+
+	uint64_t rec_cmd = 0;
+	memcpy(&rec_cmd, p->file + p->pos + sizeof(pm3_rec_hdr_t),
+			(hdr->len < sizeof(rec_cmd)) ? hdr->len : sizeof(rec_cmd));
+	if (rec_cmd != sent_cmd) {
+		printf("replay: sent command 0x%" PRIx64 " but recording has 0x%" PRIx64 ", responses may not match\n",
+				sent_cmd, rec_cmd);
+		p->mismatches++;
+	}
+
+	// recorded duration: from this frame to the last response before the
+	// next outgoing frame
+	uint64_t t_start = hdr->t_ms;
+	uint64_t t_end = hdr->t_ms;
+	size_t at = replay_next(hdr, p->pos);
+	const pm3_rec_hdr_t *scan;
+	while ((scan = replay_peek(p, at)) != NULL && scan->dir == PM3_REC_DIR_RX) {
+		t_end = scan->t_ms;
+		at = replay_next(scan, at);
+	}
+
+	p->pos = replay_next(hdr, p->pos);
+	p->inflight = true;
+	p->inflight_cmd = sent_cmd;
+	p->inflight_recorded_ms = t_end - t_start;
+	p->inflight_start = clock();
+	p->inflight_done = p->inflight_start;
+	p->rx_len = p->rx_off = 0;
+
+	return true;
+}
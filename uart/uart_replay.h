@@ -0,0 +1,50 @@
+/*
+ * Replay "serial port": re-runs a recorded command/response session behind
+ * the uart.h interface, at zero device latency.
+ *
+ * Recordings are produced by the client's session recorder ('hw record',
+ * client/comms.c) and consist of the 8-byte PM3_REC_MAGIC followed by packed
+ * records, each a pm3_rec_hdr_t and the raw frame bytes as they appeared on
+ * the wire. Opening a port named "replay:<file>" loads such a recording;
+ * every frame the client sends is matched against the next recorded outgoing
+ * frame and answered with the recorded responses immediately. On close the
+ * engine prints, per command id, the recorded wall time next to the CPU time
+ * the replayed client code actually spent, which makes any recorded session
+ * a reproducible benchmark for the client stack.
+ *
+ * @file uart_replay.h
+ */
+
+#ifndef _PM3_UART_REPLAY_H_
+#define _PM3_UART_REPLAY_H_
+
+#include "uart.h"
+
+#define PM3_REC_MAGIC		"PM3SESS1"
+#define PM3_REC_MAGIC_LEN	8
+
+#define PM3_REC_DIR_TX	0	// client -> device
+#define PM3_REC_DIR_RX	1	// device -> client
+
+typedef struct {
+	uint32_t len;	// frame bytes following this header
+	uint32_t dir;	// PM3_REC_DIR_*
+	uint64_t t_ms;	// milliseconds since the recording started
+} pm3_rec_hdr_t;
+
+/* Port names with this prefix are routed to the replay engine instead of a
+ * real serial port; the rest of the name is the recording file path.
+ */
+#define PM3_REPLAY_PREFIX	"replay:"
+
+bool uart_replay_is_port_name(const char *pcPortName);
+
+/* True if sp was returned by uart_replay_open(). */
+bool uart_replay_is(const serial_port sp);
+
+serial_port uart_replay_open(const char *pcPortName);
+void uart_replay_close(const serial_port sp);
+bool uart_replay_receive(const serial_port sp, uint8_t *pbtRx, size_t pszMaxRxLen, size_t *pszRxLen);
+bool uart_replay_send(const serial_port sp, const uint8_t *pbtTx, const size_t szTxLen);
+
+#endif // _PM3_UART_REPLAY_H_
@@ -116,6 +116,11 @@ bool uart_send(const serial_port sp, const uint8_t* pbtTx, const size_t szTxLen)
   return WriteFile(((serial_port_windows*)sp)->hPort, pbtTx, szTxLen, &dwTxLen, NULL);
 }
 
+void uart_wakeup(const serial_port sp) {
+  // ReadFile() returns on its own comm timeouts; nothing to wake here.
+  (void)sp;
+}
+
 bool uart_set_speed(serial_port sp, const uint32_t uiPortSpeed) {
   serial_port_windows* spw;
   spw = (serial_port_windows*)sp;